@@ -0,0 +1,618 @@
+
+/*
+ * PHSPBenchmark - Phase Space Reader and Writer Benchmarks
+ *
+ * PURPOSE:
+ * This application measures how fast phase space files are written and read in every
+ * registered format, so that performance regressions can be caught between versions and
+ * hardware can be sized for a workload. The files are synthetic phase spaces generated from a
+ * fixed seed, so that runs on different machines or versions measure the same work.
+ *
+ * BENCHMARKS (for every format variant):
+ * - write:      write the synthetic particles with PhaseSpaceFileWriter::writeParticles()
+ * - read:       read the file sequentially with PhaseSpaceFileReader::getNextParticle()
+ * - readBlock:  read the file sequentially with PhaseSpaceFileReader::readParticleBlock()
+ * - random:     read single particles at random positions with moveToParticle()
+ * - convert:    the conversion loop of PHSPConvert, converting the file to another format and
+ *               back (IAEA, or EGS MODE0 for the IAEA variants)
+ * - particleBalanced, historyBalanced, chunked:
+ *               read the file with each parallel reader on 1, 2, 4, ... up to --maxThreads
+ *               threads, including the time taken to set up the reader
+ *
+ * FORMAT VARIANTS:
+ * EGS MODE0 and MODE2, IAEA with and without extra longs and floats, TOPAS binary, ASCII and
+ * limited, penEasy, the native PZ format with each available codec, ROOT if compiled with ROOT
+ * support, and any other registered format with its default options.
+ *
+ * OUTPUT:
+ * One result per line is written to standard output (or to --output) as CSV, or as a JSON array
+ * with --json, with the particles and bytes processed, the time taken and the resulting rates.
+ * Progress and a readable summary are written to standard error.
+ *
+ * USAGE EXAMPLES:
+ *   # Benchmark every format with the default one million particles
+ *   PHSPBenchmark
+ *
+ *   # Benchmark the EGS and IAEA formats only, with ten million particles, up to 16 threads
+ *   PHSPBenchmark --particles 10000000 --maxThreads 16 --cases EGS,IAEA
+ *
+ *   # Keep the best of three runs of each benchmark and save the results as JSON
+ *   PHSPBenchmark --repetitions 3 --json --output results.json
+ *
+ *   # Benchmark memory mapped reads (any reader or writer option applies to every benchmark)
+ *   PHSPBenchmark --mmap
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <vector>
+#include <span>
+#include <thread>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cctype>
+#include <utility>
+#include <exception>
+
+#include "particlezoo/utilities/argParse.h"
+#include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/compression.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/ParticleBlock.h"
+#include "particlezoo/egs/egsphspFile.h"
+#include "particlezoo/IAEA/IAEAphspFile.h"
+#include "particlezoo/TOPAS/TOPASphspFile.h"
+#include "particlezoo/pz/PZphspFile.h"
+#include "particlezoo/parallel/ParticleBalancedParallelReader.h"
+#include "particlezoo/parallel/HistoryBalancedParallelReader.h"
+#include "particlezoo/parallel/ChunkedParallelReader.h"
+
+
+// Anonymous namespace for internal definitions
+namespace {
+
+    // Use ParticleZoo namespace
+    using namespace ParticleZoo;
+
+    // Usage message
+    constexpr std::string_view usageMessage = "Usage: PHSPBenchmark [OPTIONS]\n"
+                                "\n"
+                                "Measure the speed of writing and reading synthetic phase space files in every registered format:\n"
+                                "sequential writes and reads, random access with moveToParticle(), PHSPConvert round trips to another\n"
+                                "format and back, and the parallel readers on 1 to --maxThreads threads. Results are written to standard\n"
+                                "output as CSV (or JSON with --json), progress to standard error.\n"
+                                "\n"
+                                "Examples:\n"
+                                "  PHSPBenchmark\n"
+                                "  PHSPBenchmark --particles 10000000 --maxThreads 16 --cases EGS,IAEA\n"
+                                "  PHSPBenchmark --repetitions 3 --json --output results.json\n"
+                                "  PHSPBenchmark --formats";
+
+    // Custom command line arguments
+    const CLICommand PARTICLES_COMMAND = CLICommand(NONE, "n", "particles", "Number of particles in each synthetic phase space file", { CLI_UINT }, { 1000000u });
+    const CLICommand MAX_THREADS_COMMAND = CLICommand(NONE, "", "maxThreads", "Largest number of threads to run the parallel readers on (default: the number of hardware threads)", { CLI_UINT });
+    const CLICommand RANDOM_READS_COMMAND = CLICommand(NONE, "", "randomReads", "Number of particles read at random positions in each file", { CLI_UINT }, { 100000u });
+    const CLICommand REPETITIONS_COMMAND = CLICommand(NONE, "r", "repetitions", "Number of times each benchmark is run, the fastest run is reported", { CLI_UINT }, { 1u });
+    const CLICommand CASES_COMMAND = CLICommand(NONE, "", "cases", "Comma separated list of the formats or format variants to benchmark, e.g. EGS,TOPAS-ASCII (default: all)", { CLI_STRING });
+    const CLICommand DIRECTORY_COMMAND = CLICommand(NONE, "", "directory", "Directory to write the synthetic phase space files into (default: the temporary directory)", { CLI_STRING });
+    const CLICommand KEEP_FILES_COMMAND = CLICommand(NONE, "", "keepFiles", "Keep the synthetic phase space files once the benchmarks are complete", { CLI_VALUELESS });
+    const CLICommand JSON_COMMAND = CLICommand(NONE, "", "json", "Write the results as a JSON array instead of CSV", { CLI_VALUELESS });
+    const CLICommand OUTPUT_COMMAND = CLICommand(NONE, "o", "output", "File to write the results into (default: standard output)", { CLI_STRING });
+
+    // Number of particles generated once and written repeatedly to make up the synthetic files
+    constexpr std::size_t PARTICLE_POOL_SIZE = 1 << 16;
+
+    // Number of particles read at a time by the block read benchmark
+    constexpr std::size_t PARTICLES_PER_BLOCK = 4096;
+
+    // Seed of the synthetic phase spaces and of the random reads, fixed so that runs can be compared
+    constexpr std::uint64_t RANDOM_SEED = 20251014;
+
+    // A variant of a registered format to benchmark
+    struct BenchmarkCase
+    {
+        std::string name;                   // name of the variant, such as "EGS-MODE2"
+        std::string format;                 // registered format name
+        UserOptions writerOptions;          // options selecting the variant when writing
+        std::string intermediateFormat;     // format converted to and back from in the conversion round trip
+        UserOptions intermediateOptions;    // options of the intermediate format
+    };
+
+    // The outcome of a single benchmark
+    struct BenchmarkResult
+    {
+        std::string   caseName;
+        std::string   format;
+        std::string   benchmark;
+        std::size_t   threads = 1;
+        std::uint64_t particles = 0;
+        std::uint64_t bytes = 0;
+        double        seconds = 0;
+
+        double particlesPerSecond() const { return seconds > 0 ? static_cast<double>(particles) / seconds : 0; }
+        double megabytesPerSecond() const { return seconds > 0 ? static_cast<double>(bytes) / 1e6 / seconds : 0; }
+    };
+
+    // Accumulates the particles read so that the compiler cannot do away with reading them
+    volatile double particleChecksum = 0;
+
+    // List the variants of every registered format
+    std::vector<BenchmarkCase> BenchmarkCases()
+    {
+        const UserOptions toIAEA = {};
+        const UserOptions toIAEAWithLastPositions = { { IAEAphspFile::IAEAAddXLASTCommand, { true } },
+                                                      { IAEAphspFile::IAEAAddYLASTCommand, { true } },
+                                                      { IAEAphspFile::IAEAAddZLASTCommand, { true } } };
+        const UserOptions toEGS = { { EGSphspFile::EGSModeCommand, { std::string("MODE0") } } };
+
+        std::vector<BenchmarkCase> cases;
+        for (const SupportedFormat & format : FormatRegistry::SupportedFormats()) {
+            if (format.name == "EGS") {
+                cases.push_back({ "EGS-MODE0", format.name, { { EGSphspFile::EGSModeCommand, { std::string("MODE0") } } }, "IAEA", toIAEA });
+                cases.push_back({ "EGS-MODE2", format.name, { { EGSphspFile::EGSModeCommand, { std::string("MODE2") } } }, "IAEA", toIAEAWithLastPositions });
+            } else if (format.name == "IAEA") {
+                cases.push_back({ "IAEA", format.name, {}, "EGS", toEGS });
+                cases.push_back({ "IAEA-extras", format.name, { { IAEAphspFile::IAEAAddIncHistNumberCommand, { true } },
+                                                               { IAEAphspFile::IAEAAddEGSLATCHCommand, { true } },
+                                                               { IAEAphspFile::IAEAAddXLASTCommand, { true } },
+                                                               { IAEAphspFile::IAEAAddYLASTCommand, { true } },
+                                                               { IAEAphspFile::IAEAAddZLASTCommand, { true } } }, "EGS", toEGS });
+            } else if (format.name == "TOPAS") {
+                for (const char * variant : { "BINARY", "ASCII", "LIMITED" }) {
+                    cases.push_back({ "TOPAS-" + std::string(variant), format.name, { { TOPASphspFile::TOPASFormatCommand, { std::string(variant) } } }, "IAEA", toIAEA });
+                }
+            } else if (format.name == "PZ") {
+                for (CompressionCodec codec : { CompressionCodec::NONE, CompressionCodec::LZ4, CompressionCodec::ZSTD }) {
+                    if (!IsCompressionCodecAvailable(codec)) continue;
+                    cases.push_back({ "PZ-" + CompressionCodecName(codec), format.name, { { PZphspFile::PZCompressionCommand, { CompressionCodecName(codec) } } }, "IAEA", toIAEA });
+                }
+            } else if (format.name == "PhaseSpaceSet") {
+                continue; // read only, and made of files of the other formats
+            } else {
+                cases.push_back({ format.name, format.name, {}, "IAEA", toIAEA });
+            }
+        }
+        return cases;
+    }
+
+    // Check if a variant was selected with --cases, by its name or that of its format
+    bool IsCaseSelected(const BenchmarkCase & benchmarkCase, const std::vector<std::string> & selection)
+    {
+        if (selection.empty()) return true;
+        auto equalsIgnoringCase = [](std::string_view a, std::string_view b) {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+            });
+        };
+        return std::any_of(selection.begin(), selection.end(), [&](const std::string & selected) {
+            return equalsIgnoringCase(selected, benchmarkCase.name) || equalsIgnoringCase(selected, benchmarkCase.format);
+        });
+    }
+
+    // Generate the particles the synthetic phase spaces are made of: histories of one to three
+    // photons, electrons and positrons crossing a plane at Z = 0, with some empty histories in between,
+    // and the position of their last interaction needed by EGS MODE2 files
+    std::vector<Particle> GenerateParticles(std::size_t numberOfParticles)
+    {
+        std::mt19937_64 generator(RANDOM_SEED);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        constexpr float twoPi = 6.28318530718f;
+
+        std::vector<Particle> particles;
+        particles.reserve(numberOfParticles);
+        std::size_t particlesLeftInHistory = 0;
+        for (std::size_t i = 0; i < numberOfParticles; i++) {
+            const bool isNewHistory = particlesLeftInHistory == 0;
+            if (isNewHistory) particlesLeftInHistory = 1 + generator() % 3;
+            particlesLeftInHistory--;
+
+            const float typeSample = uniform(generator);
+            const ParticleType type = typeSample < 0.8f ? ParticleType::Photon : (typeSample < 0.95f ? ParticleType::Electron : ParticleType::Positron);
+            const float kineticEnergy = (0.01f + 5.99f * uniform(generator)) * MeV;
+            const float x = (40.f * uniform(generator) - 20.f) * cm;
+            const float y = (40.f * uniform(generator) - 20.f) * cm;
+            const float cosTheta = 0.9f + 0.1f * uniform(generator);
+            const float sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+            const float phi = twoPi * uniform(generator);
+
+            Particle particle(type, kineticEnergy, x, y, 0.f, sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta, isNewHistory, 1.f);
+            if (isNewHistory && generator() % 10 == 0) particle.setIncrementalHistories(static_cast<std::uint32_t>(2 + generator() % 4));
+            particle.setFloatProperty(FloatPropertyType::XLAST, x * uniform(generator));
+            particle.setFloatProperty(FloatPropertyType::YLAST, y * uniform(generator));
+            particle.setFloatProperty(FloatPropertyType::ZLAST, -100.f * uniform(generator) * cm);
+            particles.push_back(std::move(particle));
+        }
+        return particles;
+    }
+
+    // Combine the options given on the command line with those selecting a format variant
+    UserOptions CombineOptions(const UserOptions & userOptions, const UserOptions & variantOptions)
+    {
+        UserOptions options = userOptions;
+        for (const auto & [command, values] : variantOptions) options[command] = values;
+        return options;
+    }
+
+    // Total size of the files making up a phase space
+    std::uint64_t SizeOfFiles(const std::vector<std::string> & fileNames)
+    {
+        std::uint64_t bytes = 0;
+        for (const std::string & fileName : fileNames) {
+            std::error_code error;
+            const std::uintmax_t size = std::filesystem::file_size(fileName, error);
+            if (!error) bytes += size;
+        }
+        return bytes;
+    }
+
+    // Run a benchmark as many times as requested and keep the fastest run
+    template <typename Benchmark>
+    BenchmarkResult RunBenchmark(std::size_t repetitions, Benchmark && benchmark)
+    {
+        BenchmarkResult best;
+        best.seconds = std::numeric_limits<double>::infinity();
+        for (std::size_t repetition = 0; repetition < repetitions; repetition++) {
+            BenchmarkResult result;
+            auto startTime = std::chrono::high_resolution_clock::now();
+            benchmark(result);
+            auto endTime = std::chrono::high_resolution_clock::now();
+            if (result.seconds == 0) result.seconds = std::chrono::duration<double>(endTime - startTime).count(); // unless timed by the benchmark itself
+            if (result.seconds < best.seconds) best = result;
+        }
+        return best;
+    }
+
+    // Write the synthetic particles into a file, returning the names of the files written
+    std::vector<std::string> WritePhaseSpace(const std::string & format, const std::string & fileName, const UserOptions & options, const std::vector<Particle> & pool, std::uint64_t numberOfParticles)
+    {
+        auto writer = FormatRegistry::CreateWriter(format, fileName, options);
+        std::uint64_t particlesWritten = 0;
+        while (particlesWritten < numberOfParticles) {
+            const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(pool.size(), numberOfParticles - particlesWritten));
+            writer->writeParticles(std::span<const Particle>(pool.data(), count));
+            particlesWritten += count;
+        }
+        std::vector<std::string> fileNames = writer->getOutputFileNames();
+        writer->close();
+        return fileNames;
+    }
+
+    // Convert a file the way PHSPConvert does without filters, returning the number of particles converted
+    std::uint64_t ConvertPhaseSpace(const std::string & inputFormat, const std::string & inputFile, const UserOptions & readerOptions,
+                                    const std::string & outputFormat, const std::string & outputFile, const UserOptions & writerOptions)
+    {
+        auto reader = FormatRegistry::CreateReader(inputFormat, inputFile, readerOptions);
+        auto writer = FormatRegistry::CreateWriter(outputFormat, outputFile, writerOptions, reader->getFixedValues());
+        while (reader->hasMoreParticles()) {
+            Particle particle = reader->getNextParticle();
+            writer->writeParticle(std::move(particle));
+        }
+        const std::uint64_t historiesInOriginalFile = reader->getNumberOfOriginalHistories();
+        if (writer->getHistoriesWritten() < historiesInOriginalFile) {
+            writer->addAdditionalHistories(historiesInOriginalFile - writer->getHistoriesWritten());
+        }
+        const std::uint64_t particlesConverted = reader->getParticlesRead();
+        writer->close();
+        reader->close();
+        return particlesConverted;
+    }
+
+    // Read a file with one of the parallel readers on a number of threads, checking that the threads read every particle
+    // found by reading the file sequentially, unless that number is not known
+    template <typename ParallelReader>
+    void ReadInParallel(BenchmarkResult & result, const std::string & fileName, const UserOptions & options, std::size_t numberOfThreads, std::uint64_t particlesInFile)
+    {
+        ParallelReader reader(fileName, options, numberOfThreads);
+        std::vector<double> checksums(numberOfThreads, 0);
+        std::vector<std::exception_ptr> errors(numberOfThreads);
+        std::vector<std::thread> threads;
+        threads.reserve(numberOfThreads);
+        for (std::size_t threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
+            threads.emplace_back([&reader, &checksums, &errors, threadIndex]() {
+                try {
+                    double checksum = 0;
+                    while (reader.hasMoreParticles(threadIndex)) {
+                        checksum += reader.getNextParticle(threadIndex).getKineticEnergy();
+                    }
+                    checksums[threadIndex] = checksum;
+                } catch (...) {
+                    errors[threadIndex] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread & thread : threads) thread.join();
+        for (const std::exception_ptr & error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+        for (double checksum : checksums) particleChecksum = particleChecksum + checksum;
+        result.particles = reader.getTotalParticlesRead();
+        reader.close();
+        if (particlesInFile != 0 && result.particles != particlesInFile) {
+            throw std::runtime_error("the threads read " + std::to_string(result.particles) + " particles of the " + std::to_string(particlesInFile) + " read sequentially");
+        }
+    }
+
+    // Escape a string to be written in a CSV or JSON field
+    std::string Quoted(const std::string & value)
+    {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Write the results in a machine readable form
+    void WriteResults(std::ostream & output, const std::vector<BenchmarkResult> & results, bool asJSON)
+    {
+        output << std::setprecision(6);
+        if (asJSON) {
+            output << "[\n";
+            for (std::size_t i = 0; i < results.size(); i++) {
+                const BenchmarkResult & result = results[i];
+                output << "  { \"case\": " << Quoted(result.caseName) << ", \"format\": " << Quoted(result.format) << ", \"benchmark\": " << Quoted(result.benchmark)
+                       << ", \"threads\": " << result.threads << ", \"particles\": " << result.particles << ", \"bytes\": " << result.bytes
+                       << ", \"seconds\": " << result.seconds << ", \"particlesPerSecond\": " << result.particlesPerSecond()
+                       << ", \"megabytesPerSecond\": " << result.megabytesPerSecond() << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            output << "]\n";
+        } else {
+            output << "case,format,benchmark,threads,particles,bytes,seconds,particlesPerSecond,megabytesPerSecond\n";
+            for (const BenchmarkResult & result : results) {
+                output << result.caseName << "," << result.format << "," << result.benchmark << "," << result.threads << "," << result.particles << ","
+                       << result.bytes << "," << result.seconds << "," << result.particlesPerSecond() << "," << result.megabytesPerSecond() << "\n";
+            }
+        }
+    }
+
+    // Report a result as it is measured
+    void PrintResult(const BenchmarkResult & result)
+    {
+        std::cerr << "  " << std::left << std::setw(18) << result.benchmark << std::right << std::setw(4) << result.threads << (result.threads == 1 ? " thread " : " threads")
+                  << std::setprecision(4) << std::setw(12) << result.particlesPerSecond() / 1e6 << " Mparticles/s"
+                  << std::setw(12) << result.megabytesPerSecond() << " MB/s" << std::endl;
+    }
+
+} // end anonymous namespace
+
+
+int main(int argc, char* argv[]) {
+
+    // Initial setup
+    int errorCode = 0;
+
+    // Register custom command line arguments
+    ArgParser::RegisterCommand(PARTICLES_COMMAND);
+    ArgParser::RegisterCommand(MAX_THREADS_COMMAND);
+    ArgParser::RegisterCommand(ThreadPlacementCommand);
+    ArgParser::RegisterCommand(RANDOM_READS_COMMAND);
+    ArgParser::RegisterCommand(REPETITIONS_COMMAND);
+    ArgParser::RegisterCommand(CASES_COMMAND);
+    ArgParser::RegisterCommand(DIRECTORY_COMMAND);
+    ArgParser::RegisterCommand(KEEP_FILES_COMMAND);
+    ArgParser::RegisterCommand(JSON_COMMAND);
+    ArgParser::RegisterCommand(OUTPUT_COMMAND);
+
+    // Parse command line arguments
+    auto userOptions = ArgParser::ParseArgs(argc, argv, usageMessage);
+
+    // Validate parameters
+    const std::uint64_t numberOfParticles = userOptions.extractUIntOption(PARTICLES_COMMAND, 1000000u);
+    const std::size_t maxThreads = userOptions.contains(MAX_THREADS_COMMAND) ? userOptions.extractUIntOption(MAX_THREADS_COMMAND) : std::max(1u, std::thread::hardware_concurrency());
+    const std::uint64_t randomReads = userOptions.extractUIntOption(RANDOM_READS_COMMAND, 100000u);
+    const std::size_t repetitions = userOptions.extractUIntOption(REPETITIONS_COMMAND, 1u);
+    const bool keepFiles = userOptions.contains(KEEP_FILES_COMMAND);
+    const bool asJSON = userOptions.contains(JSON_COMMAND);
+    const std::string outputFile = userOptions.extractStringOption(OUTPUT_COMMAND);
+
+    if (numberOfParticles == 0) {
+        std::cerr << "Error: Invalid number of particles. Must be a positive integer\n";
+        return 1;
+    }
+    if (maxThreads == 0) {
+        std::cerr << "Error: Invalid maximum number of threads. Must be a positive integer\n";
+        return 1;
+    }
+    if (repetitions == 0) {
+        std::cerr << "Error: Invalid number of repetitions. Must be a positive integer\n";
+        return 1;
+    }
+
+    std::vector<std::string> selection;
+    {
+        std::stringstream casesList(userOptions.extractStringOption(CASES_COMMAND));
+        std::string selected;
+        while (std::getline(casesList, selected, ',')) {
+            if (!selected.empty()) selection.push_back(selected);
+        }
+    }
+
+    std::vector<BenchmarkCase> cases = BenchmarkCases();
+    std::erase_if(cases, [&](const BenchmarkCase & benchmarkCase) { return !IsCaseSelected(benchmarkCase, selection); });
+    if (cases.empty()) {
+        std::cerr << "Error: None of the formats given to --cases is registered\n";
+        return 1;
+    }
+
+    // Thread counts of the parallel reader scaling curves, doubling up to the maximum
+    std::vector<std::size_t> threadCounts;
+    for (std::size_t threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    // The synthetic files are written into a directory of their own
+    const std::filesystem::path baseDirectory = userOptions.contains(DIRECTORY_COMMAND) ? std::filesystem::path(userOptions.extractStringOption(DIRECTORY_COMMAND)) : std::filesystem::temp_directory_path();
+    const std::filesystem::path directory = baseDirectory / "particlezoo-benchmark";
+    try {
+        std::filesystem::create_directories(directory);
+    } catch (const std::exception & e) {
+        std::cerr << "Error: Unable to create the directory " << directory.string() << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Options from the command line (such as --mmap or --prefetch) apply to every reader and writer
+    UserOptions baseOptions = userOptions;
+    for (const CLICommand & command : { PARTICLES_COMMAND, MAX_THREADS_COMMAND, RANDOM_READS_COMMAND, REPETITIONS_COMMAND, CASES_COMMAND,
+                                        DIRECTORY_COMMAND, KEEP_FILES_COMMAND, JSON_COMMAND, OUTPUT_COMMAND }) {
+        baseOptions.erase(command);
+    }
+
+    std::cerr << "Generating " << numberOfParticles << " synthetic particles for " << cases.size() << " format variants in " << directory.string() << std::endl;
+    const std::vector<Particle> pool = GenerateParticles(static_cast<std::size_t>(std::min<std::uint64_t>(numberOfParticles, PARTICLE_POOL_SIZE)));
+
+    std::vector<BenchmarkResult> results;
+    for (const BenchmarkCase & benchmarkCase : cases) {
+        std::cerr << benchmarkCase.name << " (" << benchmarkCase.format << ")" << std::endl;
+
+        const std::string extension = FormatRegistry::ExtensionForFormat(benchmarkCase.format);
+        const std::string fileName = (directory / (benchmarkCase.name + extension)).string();
+        const UserOptions writerOptions = CombineOptions(baseOptions, benchmarkCase.writerOptions);
+        std::uint64_t bytesInFile = 0;
+        std::uint64_t particlesInFile = 0;
+
+        // Run one benchmark of the variant, a failure is reported and the other benchmarks are still run
+        auto measure = [&](const std::string & benchmark, std::size_t threads, auto && function) -> bool {
+            try {
+                BenchmarkResult result = RunBenchmark(repetitions, function);
+                result.caseName = benchmarkCase.name;
+                result.format = benchmarkCase.format;
+                result.benchmark = benchmark;
+                result.threads = threads;
+                PrintResult(result);
+                results.push_back(std::move(result));
+                return true;
+            } catch (const std::exception & e) {
+                std::cerr << "  " << benchmark << " failed: " << e.what() << std::endl;
+                errorCode = 1;
+                return false;
+            }
+        };
+
+        // Sequential write, which also makes the file read by the other benchmarks
+        const bool fileWritten = measure("write", 1, [&](BenchmarkResult & result) {
+            const std::vector<std::string> fileNames = WritePhaseSpace(benchmarkCase.format, fileName, writerOptions, pool, numberOfParticles);
+            result.particles = numberOfParticles;
+            result.bytes = bytesInFile = SizeOfFiles(fileNames);
+        });
+        if (!fileWritten) continue;
+
+        // Sequential reads, one particle at a time and in blocks
+        measure("read", 1, [&](BenchmarkResult & result) {
+            auto reader = FormatRegistry::CreateReader(benchmarkCase.format, fileName, baseOptions);
+            double checksum = 0;
+            while (reader->hasMoreParticles()) checksum += reader->getNextParticle().getKineticEnergy();
+            particleChecksum = particleChecksum + checksum;
+            result.particles = particlesInFile = reader->getParticlesRead();
+            result.bytes = bytesInFile;
+            reader->close();
+        });
+
+        measure("readBlock", 1, [&](BenchmarkResult & result) {
+            auto reader = FormatRegistry::CreateReader(benchmarkCase.format, fileName, baseOptions);
+            ParticleBlock block;
+            double checksum = 0;
+            while (std::size_t count = reader->readParticleBlock(block, PARTICLES_PER_BLOCK)) {
+                std::span<const float> kineticEnergies = std::as_const(block).getKineticEnergies();
+                for (std::size_t i = 0; i < count; i++) checksum += kineticEnergies[i];
+            }
+            particleChecksum = particleChecksum + checksum;
+            result.particles = reader->getParticlesRead();
+            result.bytes = bytesInFile;
+            reader->close();
+        });
+
+        // Random access to single particles
+        if (randomReads > 0) {
+            measure("random", 1, [&](BenchmarkResult & result) {
+                auto reader = FormatRegistry::CreateReader(benchmarkCase.format, fileName, baseOptions);
+                const std::uint64_t entries = reader->getNumberOfParticles();
+                std::mt19937_64 generator(RANDOM_SEED);
+                std::uniform_int_distribution<std::uint64_t> position(0, entries - 1);
+                std::vector<std::uint64_t> positions(static_cast<std::size_t>(randomReads));
+                for (std::uint64_t & p : positions) p = position(generator);
+
+                auto startTime = std::chrono::high_resolution_clock::now();
+                double checksum = 0;
+                for (std::uint64_t p : positions) {
+                    reader->moveToParticle(p);
+                    if (reader->hasMoreParticles()) checksum += reader->getNextParticle().getKineticEnergy();
+                }
+                auto endTime = std::chrono::high_resolution_clock::now();
+                particleChecksum = particleChecksum + checksum;
+                reader->close();
+
+                // Only the reads are timed, not the opening of the file
+                result.particles = randomReads;
+                result.bytes = entries > 0 ? randomReads * bytesInFile / entries : 0;
+                result.seconds = std::chrono::duration<double>(endTime - startTime).count();
+            });
+        }
+
+        // PHSPConvert round trip to another format and back
+        const std::string intermediateFile = (directory / (benchmarkCase.name + "-intermediate" + FormatRegistry::ExtensionForFormat(benchmarkCase.intermediateFormat))).string();
+        const std::string roundTripFile = (directory / (benchmarkCase.name + "-roundtrip" + extension)).string();
+        measure("convert", 1, [&](BenchmarkResult & result) {
+            const UserOptions intermediateOptions = CombineOptions(baseOptions, benchmarkCase.intermediateOptions);
+            std::uint64_t particlesConverted = ConvertPhaseSpace(benchmarkCase.format, fileName, baseOptions, benchmarkCase.intermediateFormat, intermediateFile, intermediateOptions);
+            const std::uint64_t bytesInIntermediateFile = SizeOfFiles({ intermediateFile });
+            particlesConverted += ConvertPhaseSpace(benchmarkCase.intermediateFormat, intermediateFile, baseOptions, benchmarkCase.format, roundTripFile, writerOptions);
+            result.particles = particlesConverted;
+            result.bytes = bytesInFile + bytesInIntermediateFile;
+        });
+
+        // Parallel reader scaling curves
+        for (std::size_t threads : threadCounts) {
+            measure("particleBalanced", threads, [&](BenchmarkResult & result) {
+                ReadInParallel<ParticleBalancedParallelReader>(result, fileName, baseOptions, threads, particlesInFile);
+                result.bytes = bytesInFile;
+            });
+        }
+        for (std::size_t threads : threadCounts) {
+            measure("historyBalanced", threads, [&](BenchmarkResult & result) {
+                ReadInParallel<HistoryBalancedParallelReader>(result, fileName, baseOptions, threads, particlesInFile);
+                result.bytes = bytesInFile;
+            });
+        }
+        for (std::size_t threads : threadCounts) {
+            measure("chunked", threads, [&](BenchmarkResult & result) {
+                ReadInParallel<ChunkedParallelReader>(result, fileName, baseOptions, threads, particlesInFile);
+                result.bytes = bytesInFile;
+            });
+        }
+
+        if (particlesInFile != 0 && particlesInFile < numberOfParticles) {
+            std::cerr << "  Warning: only " << particlesInFile << " of the " << numberOfParticles << " particles written were read back" << std::endl;
+        }
+    }
+
+    // Remove the synthetic files
+    if (!keepFiles) {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    // Write the results
+    if (outputFile.empty()) {
+        WriteResults(std::cout, results, asJSON);
+    } else {
+        std::ofstream output(outputFile);
+        if (!output) {
+            std::cerr << "Error: Unable to open " << outputFile << " for writing" << std::endl;
+            return 1;
+        }
+        WriteResults(output, results, asJSON);
+        std::cerr << "Results written to " << outputFile << std::endl;
+    }
+
+    // Return appropriate error code
+    return errorCode;
+}
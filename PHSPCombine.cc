@@ -51,6 +51,9 @@
  * - Processing stops early if maxParticles limit is reached
  * - History counts are preserved and properly combined from all input files
  * - Files are processed sequentially in the order specified on command line
+ * - Files of the same format and record layout as the output file (e.g. the same EGS mode, the
+ *   same IAEA extra floats, longs and constants, or the same TOPAS columns) have their particle
+ *   records copied unchanged and only their headers merged, other files are decoded and re-encoded
  * - Errors in individual files are reported and prevent the processing of remaining files
  */
 
@@ -109,6 +112,7 @@ int main(int argc, char* argv[]) {
     std::string outputFile = userOptions.contains(OUTPUT_FILE_COMMAND) ? (userOptions.at(OUTPUT_FILE_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(OUTPUT_FILE_COMMAND)[0])) : "";
     std::vector<CLIValue> positionals = userOptions.contains(CLI_POSITIONALS) ? userOptions.at(CLI_POSITIONALS) : std::vector<CLIValue>{};
     bool preserveConstants = userOptions.contains(PRESERVE_CONSTANTS_COMMAND) ? std::get<bool>(userOptions.at(PRESERVE_CONSTANTS_COMMAND)[0]) : false;
+    bool profile = userOptions.contains(ProfileCommand);
     std::vector<std::string> inputFiles(positionals.size());
     for (size_t i = 0; i < positionals.size(); i++) {
         inputFiles[i] = std::get<std::string>(positionals[i]);
@@ -187,44 +191,52 @@ int main(int argc, char* argv[]) {
                     continue; // No particles to read, skip to next file
                 }
 
-                // Initialize counters for this file
-                uint64_t particlesSoFarThisFile = 0;
-                std::uint64_t initialHistoryCount = writer->getHistoriesWritten();
+                // Copy the particle records unchanged if the file is laid out exactly as the output file, only the headers need to be merged
+                if (particlesToRead == particlesInFile && writer->canAppendRecordsFrom(*reader)) {
+                    std::cout << "Copying " << inputFile << "..." << std::flush;
+                    writer->appendRecordsFrom(*reader);
+                    particlesSoFar += particlesInFile;
+                    std::cout << " done. Processed " << writer->getHistoriesWritten() << " histories." << std::endl;
+                } else {
+                    // Initialize counters for this file
+                    uint64_t particlesSoFarThisFile = 0;
+                    std::uint64_t initialHistoryCount = writer->getHistoriesWritten();
 
-                // Determine progress update interval
-                uint64_t onePercentInterval = particlesToRead >= 100 
-                                            ? particlesToRead / 100 
-                                            : 1;
+                    // Determine progress update interval
+                    uint64_t onePercentInterval = particlesToRead >= 100 
+                                                ? particlesToRead / 100 
+                                                : 1;
 
-                // Set up the progress bar for the current file
-                Progress<uint64_t> progress(particlesToRead);
-                progress.Start("Reading " + inputFile);
+                    // Set up the progress bar for the current file
+                    Progress<uint64_t> progress(particlesToRead);
+                    progress.Start("Reading " + inputFile);
 
-                // Read the particles from the current file and write them into the output file
-                while (reader->hasMoreParticles() && particlesSoFar+particlesSoFarThisFile < maxParticles) {
-                    Particle particle = reader->getNextParticle();
-                    writer->writeParticle(particle);
+                    // Read the particles from the current file and write them into the output file
+                    while (reader->hasMoreParticles() && particlesSoFar+particlesSoFarThisFile < maxParticles) {
+                        Particle particle = reader->getNextParticle();
+                        writer->writeParticle(std::move(particle));
 
-                    // Update progress bar every 1% of particles read
-                    particlesSoFarThisFile = reader->getParticlesRead();
-                    if (particlesSoFarThisFile % onePercentInterval == 0) {
-                        progress.Update(particlesSoFarThisFile, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                        // Update progress bar every 1% of particles read
+                        particlesSoFarThisFile = reader->getParticlesRead();
+                        if (particlesSoFarThisFile % onePercentInterval == 0) {
+                            progress.Update(particlesSoFarThisFile, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                        }
                     }
-                }
-                particlesSoFar += particlesSoFarThisFile;
+                    particlesSoFar += particlesSoFarThisFile;
 
-                // Finalize history counts, if the original file contained more histories than have been written then add the difference (this can happen if uneventful histories occurred after the final particle was recorded)
-                std::uint64_t historiesInOriginalFile = particlesToRead < particlesInFile ? reader->getHistoriesRead() : reader->getNumberOfOriginalHistories();
-                std::uint64_t historiesWritten = writer->getHistoriesWritten() - initialHistoryCount;
-                if (historiesWritten < historiesInOriginalFile) {
-                    writer->addAdditionalHistories(historiesInOriginalFile - historiesWritten);
-                } else if (historiesWritten > historiesInOriginalFile) {
-                    progress.Complete("Error occurred.");
-                    throw std::runtime_error("The number of histories written (" + std::to_string(historiesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(historiesInOriginalFile) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
-                }
+                    // Finalize history counts, if the original file contained more histories than have been written then add the difference (this can happen if uneventful histories occurred after the final particle was recorded)
+                    std::uint64_t historiesInOriginalFile = particlesToRead < particlesInFile ? reader->getHistoriesRead() : reader->getNumberOfOriginalHistories();
+                    std::uint64_t historiesWritten = writer->getHistoriesWritten() - initialHistoryCount;
+                    if (historiesWritten < historiesInOriginalFile) {
+                        writer->addAdditionalHistories(historiesInOriginalFile - historiesWritten);
+                    } else if (historiesWritten > historiesInOriginalFile) {
+                        progress.Complete("Error occurred.");
+                        throw std::runtime_error("The number of histories written (" + std::to_string(historiesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(historiesInOriginalFile) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
+                    }
 
-                // Complete the progress bar
-                progress.Complete("done. Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                    // Complete the progress bar
+                    progress.Complete("done. Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                }
             }
             catch (const std::exception& e) {
                 std::cerr << "Error reading file " << inputFile << ": " << e.what() << std::endl;
@@ -233,6 +245,7 @@ int main(int argc, char* argv[]) {
 
             // Ensure that the reader is closed even if an exception occurs
             if (reader) reader->close();
+            if (reader && profile) PrintIOProfile(std::cout, "Read " + inputFile, reader->getIOProfile());
 
             // Stop processing further files if an error occurred
             if (errorCode != 0) break;
@@ -250,6 +263,7 @@ int main(int argc, char* argv[]) {
 
     // Ensure that the writer is closed even if an exception occurs
     if (writer) writer->close();
+    if (writer && profile) PrintIOProfile(std::cout, "Wrote " + outputFile, writer->getIOProfile(), true);
 
     // Return the error code
     return errorCode;
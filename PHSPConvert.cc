@@ -17,9 +17,11 @@
  * 
  * COMMAND LINE OPTIONS:
  * Required Arguments:
- *   inputfile                 Input phase space file to be converted
+ *   inputfile                 Input phase space file to be converted, or - to read it from
+ *                             standard input (requires --inputFormat)
  *   outputfile                Output file path where converted data will be written
- *                             (must be different from input file)
+ *                             (must be different from input file), or - to write it to
+ *                             standard output (requires --outputFormat)
  * 
  * Optional Arguments:
  *   --maxParticles <N>        Limit the maximum number of particles to convert
@@ -30,6 +32,24 @@
  *   --outputFormat <format>   Force a specific output file format instead of auto-detection  
  *                             Valid formats: IAEA, EGS, TOPAS, penEasy, ROOT
  *                             (default: auto-detect format from file extension)
+ *   --threads <N>             Convert with a pipeline of N worker threads that project and
+ *                             filter particles while one thread reads and another writes
+ *                             (default: 1, convert on a single thread)
+ *   --shards <N>              Convert on N threads, each reading its share of the histories and
+ *                             writing them to a shard file of its own named after the output file
+ *                             (e.g. output_shard0.IAEAphsp), cannot be combined with --threads,
+ *                             --maxParticles, --inputFormat or an output to standard output
+ *   --concatenate             Concatenate the shards into the output file once they are written,
+ *                             merging their headers and removing the shard files
+ *   --sample <N>              Convert a random sample of the histories, the fraction of them if
+ *                             below 1 or otherwise their number, with the number of original
+ *                             histories scaled to match, cannot be combined with --threads,
+ *                             --shards, --maxParticles or an input from standard input
+ *   --stratifiedSample        Draw the sample as one history from each of N runs of consecutive
+ *                             histories instead of uniformly
+ *   --sampleSeed <N>          Seed of the random draws of the sample (default: 0)
+ *   --inputHeader <file>      Header file of an IAEA or TOPAS input read from standard input
+ *   --outputHeader <file>     Header file of an IAEA or TOPAS output written to standard output
  *   --formats                 Display a list of all supported file formats and exit
  * 
  * USAGE EXAMPLES:
@@ -39,9 +59,21 @@
  *   # Convert with particle limit (only convert first 500,000 particles)
  *   PHSPConvert --maxParticles 500000 simulation.phsp converted.egsphsp
  * 
+ *   # Preview a one percent random sample of the histories rather than the first particles
+ *   PHSPConvert --sample 0.01 simulation.IAEAphsp preview.IAEAphsp
+ * 
  *   # Force specific input/output formats (useful when extensions are ambiguous)
  *   PHSPConvert --inputFormat TOPAS --outputFormat IAEA input.phsp output.IAEAphsp
  * 
+ *   # Convert using 8 worker threads, reading and writing on background I/O threads as well
+ *   PHSPConvert --threads 8 --prefetch 4 --backgroundFlush 4 input.IAEAphsp output.egsphsp
+ * 
+ *   # Convert on 8 threads writing 8 shards, then combine them into a single output file
+ *   PHSPConvert --shards 8 --concatenate input.egsphsp output.IAEAphsp
+ * 
+ *   # Convert an EGS file as it is decompressed, writing the IAEA output to standard output
+ *   zcat input.egsphsp.gz | PHSPConvert --inputFormat EGS --outputFormat IAEA --outputHeader output.IAEAheader - - > output.IAEAphsp
+ * 
  *   # Show supported formats
  *   PHSPConvert --formats
  * 
@@ -53,6 +85,22 @@
  * - Input and output files must have different names
  * - Conversion maintains basic particle properties (position, direction, energy, etc.)
  * - Time taken for conversion is reported upon completion
+ * - With --threads the output file is identical to a single threaded conversion, particles
+ *   and histories are written in their original order
+ * - With --shards each shard holds whole histories and the histories of all shards add up to
+ *   those of the input file, concatenated shards hold the histories in their original order,
+ *   and the conversion fails if the particles of the shards do not add up to those converted
+ * - When the whole file is converted without --shards, the filters are handed to the reader so
+ *   that rejected particles are passed over as they are decoded (only the particle type, energy
+ *   and generation filters when projecting, since the others apply after projection)
+ * - When the whole file is converted on a single thread without projections or filters, and the
+ *   two formats have a direct transcoder (EGS to and from IAEA, IAEA to and from TOPAS binary),
+ *   the records are converted into one another without decoding them into particles
+ * - A file named - is read from standard input or written to standard output in a single pass.
+ *   IAEA and TOPAS headers are then read from --inputHeader or written to --outputHeader, while
+ *   EGS and penEasy files, whose header is at the start of the file, cannot be written to
+ *   standard output and penEasy files cannot be read from standard input. Progress and
+ *   messages go to standard error when the output is written to standard output
  */
 
 #include <iostream>
@@ -60,12 +108,23 @@
 #include <string_view>
 #include <chrono>
 #include <vector>
+#include <span>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
 
 #include "particlezoo/utilities/argParse.h"
 #include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/transcoders.h"
 #include "particlezoo/utilities/progress.h"
 #include "particlezoo/PhaseSpaceFileReader.h"
 #include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/ParticleFilter.h"
+#include "particlezoo/HistorySampler.h"
+#include "particlezoo/parallel/HistoryBalancedParallelReader.h"
+#include "particlezoo/parallel/ShardedParallelWriter.h"
 
 
 // Anonymous namespace for internal definitions
@@ -80,13 +139,17 @@ namespace {
                                 "Convert particle phase space files between different formats.\n"
                                 "\n"
                                 "Required Arguments:\n"
-                                "  <inputfile>               Input phase space file to convert\n"
-                                "  <outputfile>              Output file path (must be different from input)\n"
+                                "  <inputfile>               Input phase space file to convert, - to read standard input\n"
+                                "  <outputfile>              Output file path (must be different from input), - to write to standard output\n"
                                 "\n"
                                 "Examples:\n"
                                 "  PHSPConvert input.egsphsp output.IAEAphsp\n"
                                 "  PHSPConvert --maxParticles 500000 simulation.phsp converted.egsphsp\n"
+                                "  PHSPConvert --sample 0.01 simulation.IAEAphsp preview.IAEAphsp\n"
                                 "  PHSPConvert --inputFormat TOPAS --outputFormat IAEA input.phsp output.IAEAphsp\n"
+                                "  PHSPConvert --threads 8 input.IAEAphsp output.egsphsp\n"
+                                "  PHSPConvert --shards 8 --concatenate input.egsphsp output.IAEAphsp\n"
+                                "  zcat input.egsphsp.gz | PHSPConvert --inputFormat EGS - output.IAEAphsp\n"
                                 "  PHSPConvert --formats";
 
 
@@ -115,6 +178,12 @@ namespace {
     const CLICommand EXCLUDE_PRIMARIES_COMMAND = CLICommand(NONE, "", "excludePrimaries", "Exclude primary particles from processing", { CLI_VALUELESS });
     const CLICommand GENERATION_FILTER_COMMAND = CLICommand(NONE, "", "generations", "Filter particles by generation range (min and max)", { CLI_INT, CLI_INT });
     const CLICommand ERROR_ON_WARNING_COMMAND = CLICommand(NONE, "", "errorOnWarning", "Treat warnings as errors when returning exit code", { CLI_VALUELESS });
+    const CLICommand THREADS_COMMAND = CLICommand(NONE, "", "threads", "Number of worker threads projecting and filtering particles, reading and writing run on threads of their own (default: 1, convert on a single thread)", { CLI_UINT });
+    const CLICommand SHARDS_COMMAND = CLICommand(NONE, "", "shards", "Number of threads converting in parallel, each writing its share of the histories to a shard file of its own", { CLI_UINT });
+    const CLICommand CONCATENATE_COMMAND = CLICommand(NONE, "", "concatenate", "Concatenate the shards into the output file and remove them once conversion is complete", { CLI_VALUELESS });
+    const CLICommand SAMPLE_COMMAND = CLICommand(NONE, "", "sample", "Convert a random sample of the histories, the fraction of them if below 1, otherwise their number", { CLI_STRING });
+    const CLICommand STRATIFIED_SAMPLE_COMMAND = CLICommand(NONE, "", "stratifiedSample", "Draw the sample of --sample as one history from each run of consecutive histories instead of uniformly", { CLI_VALUELESS });
+    const CLICommand SAMPLE_SEED_COMMAND = CLICommand(NONE, "", "sampleSeed", "Seed of the random draws of --sample, the same seed giving the same sample (default: 0)", { CLI_UINT });
 
     // struct for generation filter
     struct GenerationFilter
@@ -157,6 +226,14 @@ namespace {
         const float         minimumRadius;
         const float         maximumRadius;
         const bool          errorOnWarning;
+        const std::uint32_t numberOfThreads;
+        const std::uint32_t numberOfShards;
+        const bool          concatenateShards;
+        const double        sampleSize;                    // 0 if every history is converted
+        const HistorySampling sampling;
+        const std::uint32_t sampleSeed;
+        const ParticleFilter filter;                       // all of the filters, applied after projection
+        const ParticleFilter projectionInvariantFilter;    // the filters which projection has no effect on
 
         // Constructor to initialize from user options
         AppConfig(const UserOptions & userOptions)
@@ -189,7 +266,15 @@ namespace {
             maximumZ(userOptions.contains(MAXIMUM_Z_COMMAND) ? userOptions.extractFloatOption(MAXIMUM_Z_COMMAND) * cm : std::numeric_limits<float>::max()),
             minimumRadius(userOptions.contains(MINIMUM_RADIUS_COMMAND) ? userOptions.extractFloatOption(MINIMUM_RADIUS_COMMAND) * cm : 0.0f),
             maximumRadius(userOptions.contains(MAXIMUM_RADIUS_COMMAND) ? userOptions.extractFloatOption(MAXIMUM_RADIUS_COMMAND) * cm : std::numeric_limits<float>::max()),
-            errorOnWarning(userOptions.contains(ERROR_ON_WARNING_COMMAND))
+            errorOnWarning(userOptions.contains(ERROR_ON_WARNING_COMMAND)),
+            numberOfThreads(userOptions.extractUIntOption(THREADS_COMMAND, 1)),
+            numberOfShards(userOptions.extractUIntOption(SHARDS_COMMAND, 0)),
+            concatenateShards(userOptions.contains(CONCATENATE_COMMAND)),
+            sampleSize(determineSampleSize(userOptions)),
+            sampling(userOptions.contains(STRATIFIED_SAMPLE_COMMAND) ? HistorySampling::STRATIFIED : HistorySampling::UNIFORM),
+            sampleSeed(userOptions.extractUIntOption(SAMPLE_SEED_COMMAND, 0)),
+            filter(buildFilter(true)),
+            projectionInvariantFilter(buildFilter(false))
         {
             // Validate the configuration
             validate(userOptions);
@@ -201,8 +286,28 @@ namespace {
         bool isFilteringByRadius() const { return filterByRadius; }
         bool isFilteringByParticle() const { return filterByParticle != ParticleType::Unsupported; }
         bool isFilteringByGeneration() const { return generationFilter.useFilter; }
+        bool usePipeline() const { return numberOfThreads > 1; }
+        bool useShards() const { return numberOfShards > 0; }
+        bool useSampling() const { return sampleSize > 0; }
 
     private:
+        // Gather the filters requested, leaving out those on the position if includePosition is false
+        ParticleFilter buildFilter(bool includePosition) const {
+            ParticleFilter particleFilter;
+            if (isFilteringByParticle()) particleFilter.acceptParticleType(filterByParticle);
+            if (filterByEnergy && minimumEnergy <= maximumEnergy) particleFilter.setKineticEnergyRange(minimumEnergy, maximumEnergy);
+            if (includePosition && filterByPosition && minimumX <= maximumX && minimumY <= maximumY && minimumZ <= maximumZ) {
+                particleFilter.setXRange(minimumX, maximumX);
+                particleFilter.setYRange(minimumY, maximumY);
+                particleFilter.setZRange(minimumZ, maximumZ);
+            }
+            if (includePosition && filterByRadius && minimumRadius <= maximumRadius) particleFilter.setRadiusRange(std::max(minimumRadius, 0.0f), maximumRadius);
+            if (generationFilter.useFilter && generationFilter.minimumGeneration <= generationFilter.maximumGeneration && generationFilter.minimumGeneration >= 1) {
+                particleFilter.setGenerationRange(generationFilter.minimumGeneration, generationFilter.maximumGeneration);
+            }
+            return particleFilter; // invalid ranges are left out here and reported by validate()
+        }
+
         ParticleType determineParticleFilter(const UserOptions& userOptions) const {
             if (userOptions.contains(PHOTONS_ONLY_COMMAND)) {
                 return ParticleType::Photon;
@@ -215,6 +320,17 @@ namespace {
             return ParticleType::Unsupported;
         }
 
+        double determineSampleSize(const UserOptions & userOptions) const {
+            if (!userOptions.contains(SAMPLE_COMMAND)) return 0;
+            const std::string value = userOptions.extractStringOption(SAMPLE_COMMAND);
+            try {
+                std::size_t charactersRead = 0;
+                const double size = std::stod(value, &charactersRead);
+                if (charactersRead == value.size() && size > 0) return size;
+            } catch (const std::exception &) {}
+            throw std::runtime_error("Invalid sample size " + value + ", give a fraction below 1 or a number of histories.");
+        }
+
         GenerationFilter determineGenerationFilter(const UserOptions & userOptions) const {
             bool hasPrimariesOnlyCommand = userOptions.contains(PRIMARIES_ONLY_COMMAND);
             bool hasExcludePrimariesCommand = userOptions.contains(EXCLUDE_PRIMARIES_COMMAND);
@@ -242,7 +358,7 @@ namespace {
                     maxGen = std::get<int>(range[1]);
                 }
 
-                return GenerationFilter(false, minGen, maxGen);
+                return GenerationFilter(useFilter, minGen, maxGen);
             }
         }
 
@@ -250,7 +366,7 @@ namespace {
             // Validate parameters
             if (inputFile.empty()) throw std::runtime_error("No input file specified.");
             if (outputFile.empty()) throw std::runtime_error("No output file specified.");
-            if (inputFile == outputFile) throw std::runtime_error("Input and output files must be different.");
+            if (inputFile == outputFile && !IsStandardStream(inputFile)) throw std::runtime_error("Input and output files must be different.");
             if (userOptions.contains(FILTER_BY_PDG_COMMAND) && filterByParticle == ParticleType::Unsupported)
             {
                 throw std::runtime_error("Invalid PDG code specified for particle filter.");
@@ -281,7 +397,24 @@ namespace {
             {
                 throw std::runtime_error("Conflicting particle filter options specified.");
             }
-            if (generationFilter.useFilter && (generationFilter.minimumGeneration < generationFilter.maximumGeneration || generationFilter.minimumGeneration < 1)) throw std::runtime_error("Invalid generation filter range. Ensure that min < max and that min is at least 1.");
+            if (numberOfThreads < 1) throw std::runtime_error("The number of threads must be at least 1.");
+            if (userOptions.contains(SHARDS_COMMAND))
+            {
+                if (numberOfShards < 1) throw std::runtime_error("The number of shards must be at least 1.");
+                if (userOptions.contains(THREADS_COMMAND)) throw std::runtime_error("Cannot specify both --threads and --shards.");
+                if (userOptions.contains(MAX_PARTICLES_COMMAND)) throw std::runtime_error("Cannot limit the number of particles with --maxParticles when writing shards.");
+                if (!inputFormat.empty()) throw std::runtime_error("Cannot force the input format with --inputFormat when writing shards.");
+                if (IsStandardStream(outputFile)) throw std::runtime_error("Cannot write shards to standard output.");
+            }
+            if (useSampling())
+            {
+                if (userOptions.contains(THREADS_COMMAND) || userOptions.contains(SHARDS_COMMAND)) throw std::runtime_error("Cannot convert a sample of the histories with --threads or --shards.");
+                if (userOptions.contains(MAX_PARTICLES_COMMAND)) throw std::runtime_error("Cannot specify both --sample and --maxParticles.");
+                if (IsStandardStream(inputFile)) throw std::runtime_error("Cannot sample the histories of standard input, which can only be read in order.");
+            }
+            if ((userOptions.contains(STRATIFIED_SAMPLE_COMMAND) || userOptions.contains(SAMPLE_SEED_COMMAND)) && !useSampling()) throw std::runtime_error("--stratifiedSample and --sampleSeed can only be used together with --sample.");
+            if (concatenateShards && !userOptions.contains(SHARDS_COMMAND)) throw std::runtime_error("--concatenate can only be used together with --shards.");
+            if (generationFilter.useFilter && (generationFilter.minimumGeneration > generationFilter.maximumGeneration || generationFilter.minimumGeneration < 1)) throw std::runtime_error("Invalid generation filter range. Ensure that min <= max and that min is at least 1.");
         }
     };
 
@@ -289,55 +422,327 @@ namespace {
     // return true if the particle passes all filters, false otherwise
     bool applyFilters(const Particle & particle, const AppConfig & config)
     {
-        // Apply particle type filter if specified
-        if (config.filterByParticle != ParticleType::Unsupported && config.filterByParticle != particle.getType()) {
-            return false;
-        }
+        return config.filter.accepts(particle);
+    }
+
+    // Function to apply the requested projection and filters to a particle
+    // return true if the particle should be written, false if it is rejected
+    bool transformParticle(Particle & particle, const AppConfig & config, bool & rejectedByProjection)
+    {
+        rejectedByProjection = false;
 
-        // Apply energy filters
-        if (config.filterByEnergy) {
-            const float energy = particle.getKineticEnergy();
-            if (energy < config.minimumEnergy || energy > config.maximumEnergy) {
+        // Handle particle projection if requested
+        if (config.useProjection()) {
+            // Project the particle if projection is enabled
+            // If the projection fails (e.g. particle direction is parallel to the projection plane) then skip writing this particle
+            bool projectionSuccess = particle.getType() != ParticleType::PseudoParticle; // Do not project pseudo-particles
+            if (config.projectToX && projectionSuccess) projectionSuccess = particle.projectToXValue(config.projectToXValue);
+            if (config.projectToY && projectionSuccess) projectionSuccess = particle.projectToYValue(config.projectToYValue);
+            if (config.projectToZ && projectionSuccess) projectionSuccess = particle.projectToZValue(config.projectToZValue);
+            if (!projectionSuccess) {
+                // Projection failed, reject the particle
+                rejectedByProjection = true;
                 return false;
             }
         }
 
-        // Apply position filters
-        if (config.filterByPosition) {
-            const float x = particle.getX();
-            const float y = particle.getY();
-            const float z = particle.getZ();
-            if (x < config.minimumX || x > config.maximumX ||
-                y < config.minimumY || y > config.maximumY ||
-                z < config.minimumZ || z > config.maximumZ) {
-                return false;
+        // Apply filters post projection
+        return applyFilters(particle, config);
+    }
+
+    // Function to either write a particle to the output file or account for its rejection
+    void outputParticle(PhaseSpaceFileWriter & writer, Particle & particle, bool particleRejected)
+    {
+        if (particleRejected) {
+            // If this is a new history, account for the missing histories
+            if (particle.isNewHistory()) {
+                uint32_t incrementalHistories = particle.getIncrementalHistories();
+                writer.addAdditionalHistories(incrementalHistories);
             }
+        } else {
+            // Write the particle to the output file
+            writer.writeParticle(std::move(particle));
         }
+    }
 
-        // Apply radius filter
-        if (config.filterByRadius) {
-            const float x = particle.getX();
-            const float y = particle.getY();
-            const float radius = std::sqrt(x*x + y*y);
-            if (radius < config.minimumRadius || radius > config.maximumRadius) {
-                return false;
+    // A batch of consecutive particles passing through the conversion pipeline
+    struct ParticleBatch
+    {
+        std::vector<Particle>     particles;      // storage for the particles, only the first count are in use
+        std::vector<std::uint8_t> rejected;       // whether each particle was rejected by the projection or filters
+        std::size_t               count = 0;
+        std::uint64_t             particlesRejected = 0;
+        std::uint64_t             particlesRejectedByProjection = 0;
+        std::uint64_t             particlesReadAfterBatch = 0;  // reader's particle count once the batch was read, for progress
+    };
+
+    // Multi-threaded conversion pipeline
+    //
+    // One thread reads batches of particles from the input file into a fixed ring of batches, a pool of
+    // worker threads projects and filters the batches as they become available, and the thread calling
+    // nextBatch() writes them out. Batches are handed to the writer strictly in the order they were read,
+    // so particles, history boundaries and incremental history counts reach the output file exactly as in
+    // a single threaded conversion. The ring bounds the memory used and makes the reader wait whenever the
+    // writer falls behind. Any exception raised by the reader or a worker stops the pipeline and is
+    // rethrown on the writer's thread.
+    class ConversionPipeline
+    {
+        public:
+            static constexpr std::size_t PARTICLES_PER_BATCH = 4096;
+            static constexpr std::size_t BATCHES_PER_WORKER = 2;
+
+            // particlesToRead is the number of records to read, or 0 to read until the end of the file
+            // readerFilter, if not null, is given to the reader so that it only returns the particles it accepts
+            ConversionPipeline(PhaseSpaceFileReader & reader, const AppConfig & config, std::size_t numberOfWorkers, std::uint64_t particlesToRead, const ParticleFilter * readerFilter)
+            :   reader_(reader), config_(config), particlesToRead_(particlesToRead), readerFilter_(readerFilter),
+                batches_(numberOfWorkers * BATCHES_PER_WORKER + 2), states_(batches_.size(), BatchState::FREE),
+                nextToRead_(0), nextToProcess_(0), nextToWrite_(0), readingFinished_(false), stopRequested_(false)
+            {
+                for (ParticleBatch & batch : batches_) {
+                    batch.particles.resize(PARTICLES_PER_BATCH);
+                    batch.rejected.resize(PARTICLES_PER_BATCH);
+                }
+                try {
+                    readThread_ = std::thread(&ConversionPipeline::readBatches, this);
+                    workerThreads_.reserve(numberOfWorkers);
+                    for (std::size_t i = 0; i < numberOfWorkers; i++) {
+                        workerThreads_.emplace_back(&ConversionPipeline::processBatches, this);
+                    }
+                } catch (...) {
+                    finish();
+                    throw;
+                }
             }
-        }
 
-        // Apply generation filter
-        if (config.generationFilter.useFilter) {
-            if (particle.hasIntProperty(IntPropertyType::GENERATION)) {
-                const int generation = particle.getIntProperty(IntPropertyType::GENERATION);
-                if (generation < config.generationFilter.minimumGeneration || generation > config.generationFilter.maximumGeneration) {
-                    return false;
+            ~ConversionPipeline() { finish(); }
+
+            ConversionPipeline(const ConversionPipeline &) = delete;
+            ConversionPipeline & operator=(const ConversionPipeline &) = delete;
+
+            // Wait for the next batch in file order, returns nullptr once all batches have been written
+            ParticleBatch * nextBatch()
+            {
+                std::unique_lock lock(mutex_);
+                batchProcessed_.wait(lock, [this] {
+                    return error_ || states_[slot(nextToWrite_)] == BatchState::PROCESSED || (readingFinished_ && nextToWrite_ == nextToRead_);
+                });
+                if (error_) std::rethrow_exception(error_);
+                if (states_[slot(nextToWrite_)] != BatchState::PROCESSED) return nullptr;
+                return &batches_[slot(nextToWrite_)];
+            }
+
+            // Hand the batch returned by nextBatch() back to the reader once it has been written
+            void releaseBatch()
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    states_[slot(nextToWrite_)] = BatchState::FREE;
+                    nextToWrite_++;
+                }
+                batchFreed_.notify_one();
+            }
+
+            // Stop all of the threads and wait for them to exit, after which the reader may be used again
+            void finish()
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    stopRequested_ = true;
+                }
+                batchFreed_.notify_all();
+                batchRead_.notify_all();
+                if (readThread_.joinable()) readThread_.join();
+                for (std::thread & worker : workerThreads_) {
+                    if (worker.joinable()) worker.join();
+                }
+            }
+
+        private:
+            enum class BatchState { FREE, READ, PROCESSING, PROCESSED };
+
+            std::size_t slot(std::uint64_t batchNumber) const { return static_cast<std::size_t>(batchNumber % batches_.size()); }
+
+            void fail(std::exception_ptr error)
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    if (!error_) error_ = error;
+                    stopRequested_ = true;
+                }
+                batchFreed_.notify_all();
+                batchRead_.notify_all();
+                batchProcessed_.notify_all();
+            }
+
+            void readBatches()
+            {
+                try {
+                    for (;;) {
+                        ParticleBatch * batch;
+                        {
+                            std::unique_lock lock(mutex_);
+                            batchFreed_.wait(lock, [this] { return stopRequested_ || states_[slot(nextToRead_)] == BatchState::FREE; });
+                            if (stopRequested_) return;
+                            batch = &batches_[slot(nextToRead_)];
+                        }
+
+                        // Only this thread touches free batches, so the batch can be filled without holding the lock
+                        std::size_t particlesToReadNow = PARTICLES_PER_BATCH;
+                        if (particlesToRead_ > 0) {
+                            const std::uint64_t particlesLeft = particlesToRead_ - std::min(particlesToRead_, reader_.getParticlesRead());
+                            particlesToReadNow = static_cast<std::size_t>(std::min<std::uint64_t>(particlesToReadNow, particlesLeft));
+                        }
+                        const std::span<Particle> particles(batch->particles.data(), particlesToReadNow);
+                        if (particlesToReadNow == 0) {
+                            batch->count = 0;
+                        } else if (readerFilter_) {
+                            batch->count = reader_.readParticles(particles, *readerFilter_);
+                        } else {
+                            batch->count = reader_.readParticles(particles);
+                        }
+                        batch->particlesReadAfterBatch = reader_.getParticlesRead();
+
+                        {
+                            std::lock_guard lock(mutex_);
+                            if (batch->count == 0) {
+                                readingFinished_ = true;
+                            } else {
+                                states_[slot(nextToRead_)] = BatchState::READ;
+                                nextToRead_++;
+                            }
+                        }
+                        if (batch->count == 0) {
+                            batchRead_.notify_all();
+                            batchProcessed_.notify_all();
+                            return;
+                        }
+                        batchRead_.notify_one();
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
                 }
-            } else {
-                // Particle does not have a generation property, filter it by default
-                return false;
             }
+
+            void processBatches()
+            {
+                try {
+                    for (;;) {
+                        std::uint64_t batchNumber;
+                        {
+                            std::unique_lock lock(mutex_);
+                            batchRead_.wait(lock, [this] { return stopRequested_ || readingFinished_ || nextToProcess_ < nextToRead_; });
+                            if (stopRequested_ || nextToProcess_ == nextToRead_) return;
+                            batchNumber = nextToProcess_++;
+                            states_[slot(batchNumber)] = BatchState::PROCESSING;
+                        }
+
+                        ParticleBatch & batch = batches_[slot(batchNumber)];
+                        batch.particlesRejected = 0;
+                        batch.particlesRejectedByProjection = 0;
+                        for (std::size_t i = 0; i < batch.count; i++) {
+                            bool rejectedByProjection = false;
+                            const bool particleRejected = !transformParticle(batch.particles[i], config_, rejectedByProjection);
+                            batch.rejected[i] = particleRejected ? 1 : 0;
+                            if (particleRejected) batch.particlesRejected++;
+                            if (rejectedByProjection) batch.particlesRejectedByProjection++;
+                        }
+
+                        {
+                            std::lock_guard lock(mutex_);
+                            states_[slot(batchNumber)] = BatchState::PROCESSED;
+                        }
+                        batchProcessed_.notify_one();
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+
+            PhaseSpaceFileReader & reader_;
+            const AppConfig & config_;
+            const std::uint64_t particlesToRead_;
+            const ParticleFilter * const readerFilter_;
+
+            std::vector<ParticleBatch> batches_;  // ring of batches, batch number n is kept in slot n % size
+            std::vector<BatchState> states_;
+            std::uint64_t nextToRead_;
+            std::uint64_t nextToProcess_;
+            std::uint64_t nextToWrite_;
+            bool readingFinished_;
+            bool stopRequested_;
+            std::exception_ptr error_;
+
+            std::mutex mutex_;
+            std::condition_variable batchFreed_;
+            std::condition_variable batchRead_;
+            std::condition_variable batchProcessed_;
+            std::thread readThread_;
+            std::vector<std::thread> workerThreads_;
+    };
+
+    // Sharded conversion
+    //
+    // Each thread reads its share of the histories from its own reader and converts them into its own
+    // shard, so no particle passes between threads. The calling thread only reports progress. Any
+    // exception raised on a conversion thread is rethrown once all of the threads have stopped. The
+    // I/O profile of the reader of each thread is returned in readProfiles.
+    void convertInShards(const AppConfig & config, const UserOptions & userOptions, ShardedParallelWriter & writer, Progress<std::uint64_t> & progress, std::uint64_t & particlesRejected, std::uint64_t & particlesRejectedByProjection, std::vector<IOProfile> & readProfiles)
+    {
+        constexpr auto PROGRESS_UPDATE_PERIOD = std::chrono::milliseconds(200);
+
+        const std::size_t numberOfShards = writer.getNumberOfShards();
+        HistoryBalancedParallelReader reader(config.inputFile, userOptions, numberOfShards);
+
+        std::vector<std::uint64_t> rejected(numberOfShards, 0);
+        std::vector<std::uint64_t> rejectedByProjection(numberOfShards, 0);
+        std::vector<std::exception_ptr> errors(numberOfShards);
+        std::atomic<std::size_t> threadsFinished = 0;
+
+        auto convertShard = [&](std::size_t threadIndex) {
+            std::uint64_t shardRejected = 0;
+            std::uint64_t shardRejectedByProjection = 0;
+            try {
+                PhaseSpaceFileWriter & shard = writer.getShard(threadIndex);
+                while (reader.hasMoreParticles(threadIndex)) {
+                    Particle particle = reader.getNextParticle(threadIndex);
+                    bool rejectedByProjection = false;
+                    bool particleRejected = !transformParticle(particle, config, rejectedByProjection);
+                    if (particleRejected) shardRejected++;
+                    if (rejectedByProjection) shardRejectedByProjection++;
+                    outputParticle(shard, particle, particleRejected);
+                }
+            } catch (...) {
+                errors[threadIndex] = std::current_exception();
+            }
+            rejected[threadIndex] = shardRejected;
+            rejectedByProjection[threadIndex] = shardRejectedByProjection;
+            threadsFinished.fetch_add(1, std::memory_order_release);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numberOfShards);
+        for (std::size_t i = 0; i < numberOfShards; i++) {
+            threads.emplace_back(convertShard, i);
+        }
+
+        while (threadsFinished.load(std::memory_order_acquire) < numberOfShards) {
+            std::this_thread::sleep_for(PROGRESS_UPDATE_PERIOD);
+            progress.Update(reader.getTotalParticlesRead(), "Processed " + std::to_string(reader.getTotalHistoriesRead()) + " histories.");
+        }
+        for (std::thread & thread : threads) {
+            thread.join();
         }
 
-        return true;
+        readProfiles.clear();
+        for (std::size_t i = 0; i < numberOfShards; i++) {
+            readProfiles.push_back(reader.getIOProfile(i));
+        }
+
+        for (std::size_t i = 0; i < numberOfShards; i++) {
+            if (errors[i]) std::rethrow_exception(errors[i]);
+            particlesRejected += rejected[i];
+            particlesRejectedByProjection += rejectedByProjection[i];
+        }
     }
 
 } // end anonymous namespace
@@ -380,16 +785,29 @@ int main(int argc, char* argv[]) {
         PRIMARIES_ONLY_COMMAND,
         EXCLUDE_PRIMARIES_COMMAND,
         GENERATION_FILTER_COMMAND,
-        ERROR_ON_WARNING_COMMAND
+        ERROR_ON_WARNING_COMMAND,
+        THREADS_COMMAND,
+        SHARDS_COMMAND,
+        ThreadPlacementCommand,
+        CONCATENATE_COMMAND,
+        SAMPLE_COMMAND,
+        STRATIFIED_SAMPLE_COMMAND,
+        SAMPLE_SEED_COMMAND
     });
     
     // Define usage message and parse command line arguments
     auto userOptions = ArgParser::ParseArgs(argc, argv, usageMessage, MINUMUM_REQUIRED_POSITIONAL_ARGS);
     const AppConfig config(userOptions);
 
+    // Keep the messages out of the phase space data when it is written to standard output
+    if (IsStandardStream(config.outputFile)) std::cout.rdbuf(std::cerr.rdbuf());
+
     // Declare the reader for the input file
     std::unique_ptr<PhaseSpaceFileReader> reader;
     std::unique_ptr<PhaseSpaceFileWriter> writer;
+    std::unique_ptr<ShardedParallelWriter> shardedWriter;
+    std::unique_ptr<HistorySampler> sampler;
+    std::vector<IOProfile> shardReadProfiles;
 
     // Keep a list of errors and warnings encountered during processing
     std::vector<std::string> errorMessages;
@@ -408,30 +826,54 @@ int main(int argc, char* argv[]) {
         // If requested, try to keep the same constant values in the new phase space file if it supports them
         const FixedValues fixedValues = config.preserveConstants ? reader->getFixedValues() : FixedValues{};
 
-        // Create the writer for the output file
-        if (config.outputFormat.empty()) {
+        // Create the writer for the output file, or one for each of its shards
+        if (config.useShards()) {
+            shardedWriter = std::make_unique<ShardedParallelWriter>(config.outputFile, config.numberOfShards, userOptions, fixedValues, config.outputFormat);
+        } else if (config.outputFormat.empty()) {
             writer = FormatRegistry::CreateWriter(config.outputFile, userOptions, fixedValues);
         } else {
             writer = FormatRegistry::CreateWriter(config.outputFormat, config.outputFile, userOptions, fixedValues);
         }
+        auto historiesWrittenSoFar = [&]() { return shardedWriter ? shardedWriter->getHistoriesWritten() : writer->getHistoriesWritten(); };
+        auto particlesWrittenSoFar = [&]() { return shardedWriter ? shardedWriter->getParticlesWritten() : writer->getParticlesWritten(); };
 
         // Report the conversion details
         std::cout << "Converting particles from " 
                   << config.inputFile << " (" << reader->getPHSPFormat() << ") to "
-                  << config.outputFile << " (" << writer->getPHSPFormat() << ")..." << std::endl;
+                  << config.outputFile << " (" << (shardedWriter ? shardedWriter->getShard(0).getPHSPFormat() : writer->getPHSPFormat()) << ")";
+        if (shardedWriter) std::cout << " in " << shardedWriter->getNumberOfShards() << " shards";
+        std::cout << "..." << std::endl;
+
+        // Draw the histories to convert if only a sample of them is wanted, indexing the file first if it has no index
+        if (config.useSampling()) {
+            sampler = std::make_unique<HistorySampler>(*reader, config.sampleSize, config.sampling, config.sampleSeed);
+            std::cout << "Sampling " << sampler->getNumberOfSampledHistories() << " of the " << sampler->getNumberOfRepresentedHistoriesInFile() << " histories with particles, standing for " << sampler->getNumberOfOriginalHistories() << " original histories." << std::endl;
+        }
 
         // Determine how many particles to read - capping out at maxParticles if a limit has been set
+        // The header of standard input may still hold provisional counts, so it is read to its end unless limited
+        const bool readToEndOfInput = IsStandardStream(config.inputFile);
         std::uint64_t particlesInFile = reader->getNumberOfParticles();
-        std::uint64_t particlesToRead = std::min((std::uint64_t)config.maxParticles, particlesInFile);
+        std::uint64_t particlesToRead = readToEndOfInput ? (std::uint64_t)config.maxParticles : std::min((std::uint64_t)config.maxParticles, particlesInFile);
         std::uint64_t particlesRejected = 0;
         std::uint64_t particlesRejectedByProjection = 0;
-        bool readPartialFile = particlesToRead < particlesInFile;
+        bool readPartialFile = readToEndOfInput ? userOptions.contains(MAX_PARTICLES_COMMAND) : particlesToRead < particlesInFile;
 
-        // Determine progress update interval
-        std::uint64_t progressUpdateInterval = particlesToRead >= MAX_PERCENTAGE
-                                    ? particlesToRead / MAX_PERCENTAGE  // Update every 1%
+        // Determine progress update interval, going by the header for standard input and by the histories of a sample
+        const std::uint64_t particlesToShow = sampler ? std::max<std::uint64_t>(sampler->getNumberOfSampledHistories(), 1) : readToEndOfInput ? std::max<std::uint64_t>(std::min(particlesToRead, particlesInFile), 1) : particlesToRead;
+        std::uint64_t progressUpdateInterval = particlesToShow >= MAX_PERCENTAGE
+                                    ? particlesToShow / MAX_PERCENTAGE  // Update every 1%
                                     : 1;
 
+        // Let the reader pass over the particles the filters reject, unless records have to be counted out for --maxParticles
+        // The filters on the position have to wait until the particles have been projected
+        const ParticleFilter & pushedDownFilter = config.useProjection() ? config.projectionInvariantFilter : config.filter;
+        const ParticleFilter * readerFilter = !readPartialFile && !config.useShards() && !sampler && !pushedDownFilter.isEmpty() ? &pushedDownFilter : nullptr;
+
+        // Convert the records directly into one another if nothing is done to the particles on the way
+        const bool convertRecordsOnly = !readPartialFile && !config.useShards() && !sampler && !config.usePipeline() && !config.useProjection() && config.filter.isEmpty();
+        std::unique_ptr<RecordTranscoder> transcoder = convertRecordsOnly ? TranscoderRegistry::CreateTranscoder(*reader, *writer) : nullptr;
+
         // Start the timer
         auto startTime = std::chrono::steady_clock::now();
 
@@ -439,68 +881,127 @@ int main(int argc, char* argv[]) {
         if (particlesToRead > 0) {
 
             // Set up the progress bar for the current file
-            Progress<std::uint64_t> progress(particlesToRead);
+            Progress<std::uint64_t> progress(particlesToShow);
             progress.Start("Converting:");
 
-            // Read the particles from the input file and write them into the output file
-            while (reader->hasMoreParticles() && (!readPartialFile || reader->getParticlesRead() < particlesToRead)) {
-                Particle particle = reader->getNextParticle();
-
-                // Initialize the particle rejection flag
-                bool particleRejected = false;
-
-                // Handle particle projection if requested
-                if (config.useProjection()) {
-                    // Project the particle if projection is enabled
-                    // If the projection fails (e.g. particle direction is parallel to the projection plane) then skip writing this particle
-                    // If we don't write the particle and it is a new history then we need to adjust the history count
-                    bool projectionSuccess = particle.getType() != ParticleType::PseudoParticle; // Do not project pseudo-particles
-                    if (config.projectToX && projectionSuccess) projectionSuccess = particle.projectToXValue(config.projectToXValue);
-                    if (config.projectToY && projectionSuccess) projectionSuccess = particle.projectToYValue(config.projectToYValue);
-                    if (config.projectToZ && projectionSuccess) projectionSuccess = particle.projectToZValue(config.projectToZValue);
-                    if (!projectionSuccess) {
-                        // Projection failed, reject the particle
-                        particleRejected = true;
-                        particlesRejectedByProjection++;
+            if (config.useShards()) {
+                // Convert each share of the histories into a shard of its own on a thread of its own
+                convertInShards(config, userOptions, *shardedWriter, progress, particlesRejected, particlesRejectedByProjection, shardReadProfiles);
+            } else if (config.usePipeline()) {
+                // Read, transform and write the particles on separate threads, writing them in their original order
+                ConversionPipeline pipeline(*reader, config, config.numberOfThreads, readPartialFile ? particlesToRead : 0, readerFilter);
+                std::uint64_t nextProgressUpdate = progressUpdateInterval;
+                while (ParticleBatch * batch = pipeline.nextBatch()) {
+                    for (std::size_t i = 0; i < batch->count; i++) {
+                        outputParticle(*writer, batch->particles[i], batch->rejected[i] != 0);
+                    }
+                    particlesRejected += batch->particlesRejected;
+                    particlesRejectedByProjection += batch->particlesRejectedByProjection;
+
+                    // Update progress bar every 1% of particles read
+                    std::uint64_t particlesSoFar = batch->particlesReadAfterBatch;
+                    pipeline.releaseBatch();
+                    if (particlesSoFar >= nextProgressUpdate) {
+                        progress.Update(particlesSoFar, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                        nextProgressUpdate = (particlesSoFar / progressUpdateInterval + 1) * progressUpdateInterval;
                     }
                 }
+                pipeline.finish();
+            } else if (sampler) {
+                // Read the particles of the sampled histories in batches and write them into the output file
+                std::vector<Particle> particles(ConversionPipeline::PARTICLES_PER_BATCH);
+                std::uint64_t nextProgressUpdate = progressUpdateInterval;
+                while (std::size_t count = sampler->readParticles(particles)) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        // Project and filter the particle, then either write or reject it
+                        bool rejectedByProjection = false;
+                        bool particleRejected = !transformParticle(particles[i], config, rejectedByProjection);
+                        if (particleRejected) particlesRejected++;
+                        if (rejectedByProjection) particlesRejectedByProjection++;
+                        outputParticle(*writer, particles[i], particleRejected);
+                    }
 
-                // Apply filters post projection
-                if (!particleRejected) particleRejected = !applyFilters(particle, config);
+                    // Update progress bar every 1% of histories sampled
+                    std::uint64_t historiesSoFar = sampler->getHistoriesSampled();
+                    if (historiesSoFar >= nextProgressUpdate) {
+                        progress.Update(historiesSoFar, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                        nextProgressUpdate = (historiesSoFar / progressUpdateInterval + 1) * progressUpdateInterval;
+                    }
+                }
+            } else if (transcoder) {
+                // Transcode the records of the input file into records of the output file
+                while (reader->hasMoreParticles()) {
+                    writer->transcodeParticlesFrom(*reader, *transcoder, progressUpdateInterval);
 
-                // Either write or reject the particle
-                if (particleRejected) {
-                    // If this is a new history, account for the missing histories
-                    if (particle.isNewHistory()) {
-                        uint32_t incrementalHistories = particle.getIncrementalHistories();
-                        writer->addAdditionalHistories(incrementalHistories);
+                    // Update progress bar every 1% of particles read
+                    progress.Update(reader->getParticlesRead(), "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                }
+            } else if (readerFilter) {
+                // Read the particles accepted by the filters in batches and write them into the output file
+                std::vector<Particle> particles(ConversionPipeline::PARTICLES_PER_BATCH);
+                std::uint64_t nextProgressUpdate = progressUpdateInterval;
+                while (std::size_t count = reader->readParticles(particles, *readerFilter)) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        // Project and filter the particle, then either write or reject it
+                        bool rejectedByProjection = false;
+                        bool particleRejected = !transformParticle(particles[i], config, rejectedByProjection);
+                        if (particleRejected) particlesRejected++;
+                        if (rejectedByProjection) particlesRejectedByProjection++;
+                        outputParticle(*writer, particles[i], particleRejected);
+                    }
+
+                    // Update progress bar every 1% of particles read
+                    std::uint64_t particlesSoFar = reader->getParticlesRead();
+                    if (particlesSoFar >= nextProgressUpdate) {
+                        progress.Update(particlesSoFar, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                        nextProgressUpdate = (particlesSoFar / progressUpdateInterval + 1) * progressUpdateInterval;
                     }
-                    particlesRejected++;
-                } else {
-                    // Write the particle to the output file
-                    writer->writeParticle(particle);
                 }
+            } else {
+                // Read the particles from the input file and write them into the output file
+                while (reader->hasMoreParticles() && (!readPartialFile || reader->getParticlesRead() < particlesToRead)) {
+                    Particle particle = reader->getNextParticle();
+
+                    // Project and filter the particle, then either write or reject it
+                    bool rejectedByProjection = false;
+                    bool particleRejected = !transformParticle(particle, config, rejectedByProjection);
+                    if (particleRejected) particlesRejected++;
+                    if (rejectedByProjection) particlesRejectedByProjection++;
+                    outputParticle(*writer, particle, particleRejected);
 
-                // Update progress bar every 1% of particles read
-                std::uint64_t particlesSoFar = reader->getParticlesRead();
-                if (particlesSoFar % progressUpdateInterval == 0) {
-                    progress.Update(particlesSoFar, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                    // Update progress bar every 1% of particles read
+                    std::uint64_t particlesSoFar = reader->getParticlesRead();
+                    if (particlesSoFar % progressUpdateInterval == 0) {
+                        progress.Update(particlesSoFar, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                    }
                 }
             }
 
+            // Particles passed over by the reader were rejected all the same
+            if (readerFilter) particlesRejected += reader->getParticlesRejectedByFilter();
+
             // Check that the number of particles written matches the expected number
-            std::uint64_t particlesExpected = particlesToRead - particlesRejected;
-            std::uint64_t particlesWritten = writer->getParticlesWritten();
-            if (particlesWritten != particlesExpected) {
+            std::uint64_t particlesExpected = (sampler ? sampler->getParticlesRead() : particlesToRead) - particlesRejected;
+            std::uint64_t particlesWritten = particlesWrittenSoFar();
+            if (!readToEndOfInput && particlesWritten != particlesExpected) {
+                // Each shard holds a share of the histories, so a shortfall means part of the input is missing from all of them
+                if (shardedWriter) {
+                    throw std::runtime_error("The shards hold " + std::to_string(particlesWritten) + " particles, not the " + std::to_string(particlesExpected) + " expected from the input file.");
+                }
                 warningMessages.push_back("The number of particles written (" + std::to_string(particlesWritten) + ") does not match the number of particles expected (" + std::to_string(particlesExpected) + "). The output file will reflect the number of particles actually written.");
             }
 
             // Finalize history counts, if the original file contained more histories than have been written then add the difference (this can happen if uneventful histories occurred after the final particle was recorded)
-            std::uint64_t historiesInOriginalFile = readPartialFile ? reader->getHistoriesRead() : reader->getNumberOfOriginalHistories();
-            std::uint64_t historiesWritten = writer->getHistoriesWritten();
+            std::uint64_t historiesInOriginalFile = sampler ? sampler->getNumberOfOriginalHistories() : readPartialFile ? reader->getHistoriesRead() : reader->getNumberOfOriginalHistories();
+            std::uint64_t historiesWritten = historiesWrittenSoFar();
             if (historiesWritten < historiesInOriginalFile) {
-                writer->addAdditionalHistories(historiesInOriginalFile - historiesWritten);
-            } else if (historiesWritten > historiesInOriginalFile) {
+                // Trailing empty histories come after the last history of the file, which is in the last shard
+                if (shardedWriter) {
+                    shardedWriter->addAdditionalHistories(shardedWriter->getNumberOfShards() - 1, historiesInOriginalFile - historiesWritten);
+                } else {
+                    writer->addAdditionalHistories(historiesInOriginalFile - historiesWritten);
+                }
+            } else if (historiesWritten > historiesInOriginalFile && !readToEndOfInput) {
                 warningMessages.push_back("The number of histories written (" + std::to_string(historiesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(historiesInOriginalFile) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
             }
 
@@ -508,10 +1009,16 @@ int main(int argc, char* argv[]) {
             progress.Complete("Conversion complete.");
         }
 
+        // Combine the shards into the output file if requested
+        if (shardedWriter && config.concatenateShards) {
+            std::cout << "Concatenating " << shardedWriter->getNumberOfShards() << " shards into " << config.outputFile << "..." << std::endl;
+            shardedWriter->concatenate();
+        }
+
         // Measure elapsed time and report it
         auto endTime = std::chrono::steady_clock::now();
         double elapsed = std::chrono::duration<double>(endTime - startTime).count();
-        std::cout << "Processed " << std::to_string(writer->getHistoriesWritten()) << " histories with " << std::to_string(writer->getParticlesWritten()) << " particles in " << std::to_string(elapsed) << " seconds" << std::endl;
+        std::cout << "Processed " << std::to_string(historiesWrittenSoFar()) << " histories with " << std::to_string(particlesWrittenSoFar()) << " particles in " << std::to_string(elapsed) << " seconds" << std::endl;
 
         // Report any rejected particles
         if (particlesRejected > 0) {
@@ -527,6 +1034,21 @@ int main(int argc, char* argv[]) {
     // Ensure that the reader and writer are closed even if an exception occurs
     try { if (reader) reader->close(); } catch (const std::exception& e) { errorMessages.push_back("Error closing reader: " + std::string(e.what())); }
     try { if (writer) writer->close(); } catch (const std::exception& e) { errorMessages.push_back("Error closing writer: " + std::string(e.what())); }
+    try { if (shardedWriter) shardedWriter->close(); } catch (const std::exception& e) { errorMessages.push_back("Error closing shards: " + std::string(e.what())); }
+
+    // Report where the time went if requested
+    if (userOptions.contains(ProfileCommand)) {
+        if (reader) PrintIOProfile(std::cout, "Read " + config.inputFile, reader->getIOProfile());
+        for (std::size_t i = 0; i < shardReadProfiles.size(); i++) {
+            PrintIOProfile(std::cout, "Read for shard " + std::to_string(i), shardReadProfiles[i]);
+        }
+        if (writer) PrintIOProfile(std::cout, "Wrote " + config.outputFile, writer->getIOProfile(), true);
+        if (shardedWriter) {
+            for (std::size_t i = 0; i < shardedWriter->getNumberOfShards(); i++) {
+                PrintIOProfile(std::cout, "Wrote shard " + std::to_string(i), shardedWriter->getShard(i).getIOProfile(), true);
+            }
+        }
+    }
 
     // Output any error messages
     for (const auto& error : errorMessages) {
@@ -21,8 +21,9 @@
  * 
  * COMMAND LINE OPTIONS:
  * Required Arguments:
- *   inputfile                 Input phase space file
- *   outputfile                Output image file path
+ *   inputfile                 Input phase space file, or - to read it from standard input
+ *                             (requires --inputFormat)
+ *   outputfile                Output image file path (optional when --images is given)
  * 
  * Optional Arguments:
  *   --plane <XY|XZ|YZ>        Imaging plane orientation (default: XY)
@@ -49,6 +50,20 @@
  *   
  *   Processing Options:
  *   --maxParticles <N>             Limit the maximum number of particles to process (default: all)
+ *   --sample <N>                   Score a random sample of the histories, the fraction of them if below 1
+ *                                  or otherwise their number, normalized by the histories they stand for
+ *                                  (cannot be combined with --maxParticles, --threads or standard input)
+ *   --stratifiedSample             Draw the sample as one history from each of N runs of consecutive
+ *                                  histories instead of uniformly
+ *   --sampleSeed <N>               Seed of the random draws of the sample (default: 0)
+ *   --threads <N>                  Score on N threads, each reading its share of the histories into
+ *                                  an image of its own, the images are summed once all are done
+ *                                  (default: 1, cannot be combined with --maxParticles or --inputFormat)
+ *   --images <file>                Score every image listed in the file in the same pass over the
+ *                                  phase space, one image per line given as the options of the image
+ *                                  followed by its output file. The options are applied over those
+ *                                  given on the command line, which set the defaults for every image.
+ *                                  Blank lines and lines starting with '#' are ignored
  *   --energyWeighted <true|false>  Set to true to produce energy fluence instead of particle fluence (default: false)
  *   --normalizeByParticles <true|false>  Normalize by particles instead of histories (default: false)
  *   --inputFormat <format>         Force input file format (default: auto-detect from extension)
@@ -73,10 +88,28 @@
  *   # Project particles to a specific plane location
  *   PHSPImage --projectionType project --projectTo 10.0 beam.phsp projected.tiff
  * 
+ *   # Preview the fluence of a large phase space from 100,000 randomly drawn histories
+ *   PHSPImage --sample 100000 beam.IAEAphsp preview.tiff
+ * 
+ *   # Score a large phase space on 8 threads
+ *   PHSPImage --threads 8 beam.IAEAphsp fluence.tiff
+ * 
+ *   # Score a set of QA images in one pass, qa_images.txt containing for example:
+ *   #     --plane XY xy_count.tiff
+ *   #     --plane XY --score energy xy_energy.tiff
+ *   #     --plane XZ --projectionType none xz_count.tiff
+ *   #     --plane XY --primariesOnly xy_primaries.tiff
+ *   PHSPImage --square 20 --images qa_images.txt beam.IAEAphsp
+ * 
  * BEHAVIOR:
  * - Particles are projected onto the specified 2D plane within the tolerance thickness
  * - Image pixel values represent particle fluence (particles/cm²) or energy fluence (MeV/cm²)
  * - Images are normalized by the total number of histories processed
+ * - With --images the phase space is read once for all of the images, and each particle is projected
+ *   once for each distinct projection (projection type, plane and location) among the images
+ * - With --threads each thread keeps a copy of every image in memory, so N threads need N times
+ *   the memory of the images. Pixel values can differ from a single threaded run by float rounding
+ *   only, as the particles are summed in a different order
  * - Progress is displayed during particle processing
  * - Particles outside the specified spatial boundaries are ignored
  * - Output images use grayscale values proportional to particle density
@@ -84,8 +117,13 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "particlezoo/utilities/argParse.h"
 #include "particlezoo/utilities/formats.h"
@@ -95,6 +133,9 @@
 #include "particlezoo/utilities/progress.h"
 #include "particlezoo/PhaseSpaceFileReader.h"
 #include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/ParticleFilter.h"
+#include "particlezoo/HistorySampler.h"
+#include "particlezoo/parallel/ParallelAnalysis.h"
 #include "particlezoo/egs/EGSLATCH.h"
 
 // Anonymous namespace for internal definitions
@@ -108,14 +149,17 @@ namespace {
                                 "Convert particle phase space files to 2D images of the fluence distributions.\n"
                                 "\n"
                                 "Required Arguments:\n"
-                                "  <inputfile>               Input phase space file to visualize\n"
-                                "  <outputfile>              Output image file path\n"
+                                "  <inputfile>               Input phase space file to visualize, - to read standard input\n"
+                                "  <outputfile>              Output image file path (optional when --images is given)\n"
                                 "\n"
                                 "Examples:\n"
                                 "  PHSPImage beam.egsphsp output.tiff\n"
                                 "  PHSPImage --plane XZ --square 10 beam.IAEAphsp XZ10x10.tiff\n"
                                 "  PHSPImage --energyWeighted --imageWidth 2048 input.phsp hiResEnergyFluence.bmp\n"
-                                "  PHSPImage --projectTo 100.0 beam.phsp projectedAtIso.tiff";
+                                "  PHSPImage --projectTo 100.0 beam.phsp projectedAtIso.tiff\n"
+                                "  PHSPImage --threads 8 beam.IAEAphsp fluence.tiff\n"
+                                "  PHSPImage --sample 0.01 beam.IAEAphsp preview.tiff\n"
+                                "  PHSPImage --images qa_images.txt beam.IAEAphsp";
 
 
     // Default parameter values
@@ -144,6 +188,9 @@ namespace {
     const CLICommand SQUARE_COMMAND = CLICommand(NONE, "", "square", "Side length of square region (centered at 0,0) for imaging in cm (overrides min/max for both dimensions)", { CLI_FLOAT });
     const CLICommand TOLERANCE_COMMAND = CLICommand(NONE, "", "tolerance", "Tolerance in the direction perpendicular to the plane in cm", { CLI_FLOAT }, { DEFAULT_TOLERANCE });
     const CLICommand MAX_PARTICLES_COMMAND = CLICommand(NONE, "", "maxParticles", "Maximum number of particles to process (default: unlimited)", { CLI_UINT });
+    const CLICommand SAMPLE_COMMAND = CLICommand(NONE, "", "sample", "Score a random sample of the histories, the fraction of them if below 1, otherwise their number", { CLI_STRING });
+    const CLICommand STRATIFIED_SAMPLE_COMMAND = CLICommand(NONE, "", "stratifiedSample", "Draw the sample of --sample as one history from each run of consecutive histories instead of uniformly", { CLI_VALUELESS });
+    const CLICommand SAMPLE_SEED_COMMAND = CLICommand(NONE, "", "sampleSeed", "Seed of the random draws of --sample, the same seed giving the same sample (default: 0)", { CLI_UINT });
     const CLICommand ENERGY_WEIGHTED_COMMAND = CLICommand(NONE, "", "energyWeighted", "Score energy fluence (equivalent to --score energy)", { CLI_VALUELESS });
     const CLICommand QUANTITY_TYPE_COMMAND = CLICommand(NONE, "", "score", "Quantity to score (particle weight applies to all quantities and each is normalized by unit area): count, energy, xDir, yDir, zDir", { CLI_STRING }, { "count" });
     const CLICommand PRIMARIES_ONLY_COMMAND = CLICommand(NONE, "", "primariesOnly", "Only process primary particles from the phase space file", { CLI_VALUELESS });
@@ -151,6 +198,8 @@ namespace {
     const CLICommand GENERATION_FILTER_COMMAND = CLICommand(NONE, "", "generations", "Filter particles by generation range (min and max)", { CLI_INT, CLI_INT });
     const CLICommand NORMALIZE_BY_PARTICLES_COMMAND = CLICommand(NONE, "", "normalizeByParticles", "Normalize by particles instead of histories", { CLI_VALUELESS });
     const CLICommand SHOW_DETAILS_COMMAND = CLICommand(NONE, "", "showDetails", "Show detailed info about the parameters being used", { CLI_VALUELESS });
+    const CLICommand THREADS_COMMAND = CLICommand(NONE, "", "threads", "Number of threads scoring in parallel, each reading its share of the histories into an image of its own (default: 1)", { CLI_UINT });
+    const CLICommand IMAGE_LIST_COMMAND = CLICommand(NONE, "", "images", "File listing images to score in the same pass, one per line given as options followed by the output file", { CLI_STRING });
     const CLICommand ERROR_ON_WARNING_COMMAND = CLICommand(NONE, "", "errorOnWarning", "Treat warnings as errors when returning exit code", { CLI_VALUELESS });
     using EGSphspFile::EGSLATCHFilterCommand;
 
@@ -212,6 +261,9 @@ namespace {
             const std::string    inputFormat;
             const ImageFormat    outputFormat;
             const std::uint32_t  maxParticles;
+            const double         sampleSize;    // 0 if every history is scored
+            const HistorySampling sampling;
+            const std::uint32_t  sampleSeed;
             const bool           normalizeByParticles;
             const bool           printDetails;
 
@@ -228,6 +280,9 @@ namespace {
 
             const bool           errorOnWarning;
 
+            const std::uint32_t  numberOfThreads;
+            const std::string    imageListFile;
+
             const bool           useLATCHFilter;
             const std::uint32_t  LATCHFilter;
 
@@ -240,6 +295,9 @@ namespace {
                 inputFormat(userOptions.extractStringOption(INPUT_FORMAT_COMMAND)),
                 outputFormat(determineOutputFormat(userOptions)),
                 maxParticles(userOptions.extractUIntOption(MAX_PARTICLES_COMMAND, DEFAULT_MAX_PARTICLES)),
+                sampleSize(determineSampleSize(userOptions)),
+                sampling(userOptions.contains(STRATIFIED_SAMPLE_COMMAND) ? HistorySampling::STRATIFIED : HistorySampling::UNIFORM),
+                sampleSeed(userOptions.extractUIntOption(SAMPLE_SEED_COMMAND, 0)),
                 normalizeByParticles(userOptions.contains(NORMALIZE_BY_PARTICLES_COMMAND)),
                 printDetails(userOptions.contains(SHOW_DETAILS_COMMAND)),
                 projectionType(determineProjectionType(userOptions)),
@@ -250,6 +308,8 @@ namespace {
                 imageHeight(userOptions.extractIntOption(IMAGE_HEIGHT_COMMAND, DEFAULT_IMAGE_SIDE)),
                 planeLocation(determinePlaneLocation(userOptions)),
                 errorOnWarning(userOptions.contains(ERROR_ON_WARNING_COMMAND)),
+                numberOfThreads(userOptions.extractUIntOption(THREADS_COMMAND, 1)),
+                imageListFile(userOptions.extractStringOption(IMAGE_LIST_COMMAND)),
                 useLATCHFilter(userOptions.contains(EGSLATCHFilterCommand)),
                 LATCHFilter(userOptions.extractUIntOption(EGSLATCHFilterCommand, 0))
             {
@@ -257,6 +317,9 @@ namespace {
                 validate();
             }
 
+            bool  useThreads() const { return numberOfThreads > 1; }
+            bool  useSampling() const { return sampleSize > 0; }
+
             float minDim1() const { return dimensionLimits[0]; }
             float maxDim1() const { return dimensionLimits[1]; }
             float minDim2() const { return dimensionLimits[2]; }
@@ -310,8 +373,13 @@ namespace {
                     ss << "    Maximum Generation: " << generationFilter.maximumGeneration << "\n";
                 }
                 ss << "  Max Particles to Read: " << (maxParticles == DEFAULT_MAX_PARTICLES ? "all" : std::to_string(maxParticles)) << "\n";
+                if (useSampling()) ss << "  Histories Sampled: " << sampleSize << (sampling == HistorySampling::STRATIFIED ? " (stratified" : " (uniform") << ", seed " << sampleSeed << ")\n";
                 // Show normalization mode
                 ss << "  Normalization: by " << (normalizeByParticles ? "particles" : "histories") << "\n";
+                ss << "  Scoring Threads: " << numberOfThreads << "\n";
+                if (!imageListFile.empty()) {
+                    ss << "  Image List File: " << imageListFile << "\n";
+                }
                 // Show error handling preference
                 ss << "  Error on warnings: " << (errorOnWarning ? "true" : "false") << "\n";
                 // Show LATCH filter
@@ -352,6 +420,17 @@ namespace {
                 } else return XY; // default to XY
             }
 
+            double determineSampleSize(const UserOptions & userOptions) const {
+                if (!userOptions.contains(SAMPLE_COMMAND)) return 0;
+                const std::string value = userOptions.extractStringOption(SAMPLE_COMMAND);
+                try {
+                    std::size_t charactersRead = 0;
+                    const double size = std::stod(value, &charactersRead);
+                    if (charactersRead == value.size() && size > 0) return size;
+                } catch (const std::exception &) {}
+                throw std::runtime_error("Invalid sample size " + value + ", give a fraction below 1 or a number of histories.");
+            }
+
             ProjectionType determineProjectionType(const UserOptions & userOptions) const {
                 if (userOptions.contains(PROJECT_TO_COMMAND)) {
                     return ProjectionType::PROJECTION;
@@ -421,7 +500,7 @@ namespace {
                         maxGen = std::get<int>(range[1]);
                     }
 
-                    return GenerationFilter(false, minGen, maxGen);
+                    return GenerationFilter(useFilter, minGen, maxGen);
                 }
             }
 
@@ -483,17 +562,353 @@ namespace {
             void validate() const {
                 // Validate parameters
                 if (inputFile.empty()) throw std::runtime_error("No input file specified.");
-                if (outputFile.empty()) throw std::runtime_error("No output file specified.");
+                if (outputFile.empty() && imageListFile.empty()) throw std::runtime_error("No output file specified.");
                 if (inputFile == outputFile) throw std::runtime_error("Input and output files must be different.");
                 if (minDim1() >= maxDim1()) throw std::runtime_error("Invalid dimensions specified. Ensure that min < max for both dimensions.");
                 if (minDim2() >= maxDim2()) throw std::runtime_error("Invalid dimensions specified. Ensure that min < max for both dimensions.");
                 if (tolerance < 0) throw std::runtime_error("Tolerance cannot be a negative number.");
                 if (imageWidth <= 0) throw std::runtime_error("Image width must be a positive integer.");
                 if (imageHeight <= 0) throw std::runtime_error("Image height must be a positive integer.");
-                if (generationFilter.useFilter && (generationFilter.minimumGeneration < generationFilter.maximumGeneration || generationFilter.minimumGeneration < 1)) throw std::runtime_error("Invalid generation filter range. Ensure that min < max and that min is at least 1.");
+                if (numberOfThreads < 1) throw std::runtime_error("The number of threads must be at least 1.");
+                if (useThreads()) {
+                    if (maxParticles != DEFAULT_MAX_PARTICLES) throw std::runtime_error("Cannot limit the number of particles with --maxParticles when scoring on several threads.");
+                    if (!inputFormat.empty()) throw std::runtime_error("Cannot force the input format with --inputFormat when scoring on several threads.");
+                }
+                if (useSampling()) {
+                    if (useThreads()) throw std::runtime_error("Cannot score a sample of the histories on several threads.");
+                    if (maxParticles != DEFAULT_MAX_PARTICLES) throw std::runtime_error("Cannot specify both --sample and --maxParticles.");
+                    if (IsStandardStream(inputFile)) throw std::runtime_error("Cannot sample the histories of standard input, which can only be read in order.");
+                }
+                if (generationFilter.useFilter && (generationFilter.minimumGeneration > generationFilter.maximumGeneration || generationFilter.minimumGeneration < 1)) throw std::runtime_error("Invalid generation filter range. Ensure that min <= max and that min is at least 1.");
+            }
+    };
+
+
+    // How particles are placed on the scoring plane of an image. Images placing particles the same
+    // way share a projection, so each particle is only projected once for all of them.
+    struct Projection
+    {
+        ProjectionType type;
+        Plane          plane;
+        float          location;
+
+        explicit Projection(const AppConfig & config)
+        :   type(config.projectionType),
+            plane(config.projectionType == ProjectionType::PROJECTION ? config.plane : XY),   // only projection depends on the plane
+            location(config.projectionType == ProjectionType::NONE ? 0.0f : config.planeLocation)
+        {}
+
+        bool operator==(const Projection & other) const { return type == other.type && plane == other.plane && location == other.location; }
+
+        // project particle to the scoring plane based on selected projection scheme
+        void apply(Particle & particle) const
+        {
+            switch (type)
+            {
+                case(ProjectionType::FLATTEN):
+                    particle.setZ(location);
+                    break;
+                case(ProjectionType::PROJECTION):
+                    switch (plane)
+                    {
+                        case(XY): particle.projectToZValue(location); break;
+                        case(XZ): particle.projectToYValue(location); break;
+                        case(YZ): particle.projectToXValue(location); break;
+                    };
+                    break;
+                default:
+                    break;
+            }
+        }
+    };
+
+
+    // An image being scored, along with the pixel mapping worked out from its configuration
+    struct ImageTarget
+    {
+        const AppConfig               config;
+        const float                   pixelArea;    // in cm^2
+        std::size_t                   projection;   // index of the projection shared with other images
+        std::unique_ptr<Image<float>> image;
+
+        explicit ImageTarget(const AppConfig & config)
+        :   config(config),
+            pixelArea((config.maxDim1() - config.minDim1()) * (config.maxDim2() - config.minDim2()) / (config.imageWidth * config.imageHeight) / cm2),
+            projection(0)
+        {
+            // Calculate pixel mapping
+            float xPixelsPerUnitLength = static_cast<float>(config.imageWidth) / (config.maxDim1() - config.minDim1());
+            float yPixelsPerUnitLength = static_cast<float>(config.imageHeight) / (config.maxDim2() - config.minDim2());
+            float xOffset = static_cast<float>(config.minDim1()) * xPixelsPerUnitLength;
+            float yOffset = static_cast<float>(config.minDim2()) * yPixelsPerUnitLength;
+
+            // Create the image object
+            if (config.outputFormat == TIFF) {
+                image = std::make_unique<TiffImage<float>>(config.imageWidth, config.imageHeight, xPixelsPerUnitLength, yPixelsPerUnitLength, xOffset, yOffset);
+            } else if (config.outputFormat == BMP) {
+                image = std::make_unique<BitmapImage<float>>(config.imageWidth, config.imageHeight);
+            } else {
+                throw std::runtime_error("Unsupported output format.");
+            }
+        }
+    };
+
+
+    // Reads the images listed in an image list file. Each line lists the options of one image followed
+    // by its output file, and the options are applied over those given on the command line. Blank lines
+    // and lines starting with '#' are ignored.
+    std::vector<AppConfig> readImageList(const std::string & fileName, const UserOptions & userOptions, const std::string & inputFile)
+    {
+        std::ifstream file(fileName);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open image list file: " + fileName);
+        }
+
+        std::vector<AppConfig> configs;
+        std::string line;
+        std::size_t lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            std::istringstream tokenStream(line);
+            std::vector<std::string> tokens;
+            for (std::string token; tokenStream >> token; ) tokens.push_back(token);
+            if (tokens.empty() || tokens.front()[0] == '#') continue;
+
+            const std::string location = fileName + " line " + std::to_string(lineNumber);
+            try {
+                // Options that apply to the whole run rather than to one image can only be given on the command line
+                const UserOptions lineOptions = ArgParser::ParseArgList(tokens);
+                for (const CLICommand & runCommand : { INPUT_FORMAT_COMMAND, MAX_PARTICLES_COMMAND, THREADS_COMMAND, IMAGE_LIST_COMMAND, SHOW_DETAILS_COMMAND, ERROR_ON_WARNING_COMMAND }) {
+                    if (lineOptions.contains(runCommand)) throw std::runtime_error("--" + runCommand.longName + " can only be given on the command line.");
+                }
+                if (lineOptions.extractValues(CLI_POSITIONALS).size() != 1) throw std::runtime_error("Expected the options of one image followed by its output file.");
+
+                UserOptions imageOptions = ArgParser::ParseArgList(tokens, userOptions);
+                imageOptions[CLI_POSITIONALS] = { inputFile, lineOptions.extractPositional(0) };
+                configs.emplace_back(imageOptions);
+            } catch (const std::exception & e) {
+                throw std::runtime_error(location + ": " + e.what());
+            }
+        }
+        return configs;
+    }
+
+
+    // Filters a particle which has been projected for an image, returning whether it is scored in the
+    // image along with the pixel it falls in and the value to add to that pixel
+    bool scoreProjectedParticle(const Particle & particle, const AppConfig & config, float pixelArea, int & pixelX, int & pixelY, float & value)
+    {
+        // Get the particle's position
+        float x = particle.getX();
+        float y = particle.getY();
+        float z = particle.getZ();
+
+        // Determine pixel coordinates based on the selected plane
+        pixelX = 0;
+        pixelY = 0;
+        bool validPixel = false;
+        if (config.plane == XY && std::abs(z - config.planeLocation) <= config.tolerance && x >= config.minDim1() && x <= config.maxDim1() && y >= config.minDim2() && y <= config.maxDim2()) {
+            pixelX = static_cast<int>((x - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
+            pixelY = static_cast<int>((y - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
+            validPixel = true;
+        } else if (config.plane == XZ && std::abs(y - config.planeLocation) <= config.tolerance && x >= config.minDim1() && x <= config.maxDim1() && z >= config.minDim2() && z <= config.maxDim2()) {
+            pixelX = static_cast<int>((x - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
+            pixelY = static_cast<int>((z - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
+            validPixel = true;
+        } else if (config.plane == YZ && std::abs(x - config.planeLocation) <= config.tolerance && y >= config.minDim1() && y <= config.maxDim1() && z >= config.minDim2() && z <= config.maxDim2()) {
+            pixelX = static_cast<int>((y - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
+            pixelY = static_cast<int>((z - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
+            validPixel = true;
+        }
+        
+        // Process the particle if it falls within the image boundaries
+        validPixel = validPixel && (pixelX >= 0 && pixelX < config.imageWidth && pixelY >= 0 && pixelY < config.imageHeight);
+
+        // Check if the particle is a included based on generation type
+        if (validPixel && config.generationFilter.useFilter) {
+            if (particle.hasIntProperty(IntPropertyType::GENERATION)) {
+                const int generation = particle.getIntProperty(IntPropertyType::GENERATION);
+                validPixel = generation >= config.generationFilter.minimumGeneration && generation <= config.generationFilter.maximumGeneration;
+            } else {
+                // Could not determine particle generation, so throw an error
+                throw std::runtime_error("Could not determine particle generation (primary/secondary) from the phase space file.");
+            }
+        }
+
+        // Check if the particle passes the LATCH filter if enabled
+        if (validPixel && config.useLATCHFilter) {
+            validPixel = EGSphspFile::DoesParticlePassLATCHFilter(particle, config.LATCHFilter);
+        }
+
+        if (!validPixel) return false;
+
+        // Determine the weight to associate with this particle
+        float weight = particle.getWeight();
+        switch (config.quantityType) {
+            case QuantityType::ENERGY_FLUENCE:
+                weight *= particle.getKineticEnergy() / MeV;
+                break;
+            case QuantityType::X_DIRECTIONAL_COSINE:
+                weight *= particle.getDirectionalCosineX();
+                break;
+            case QuantityType::Y_DIRECTIONAL_COSINE:
+                weight *= particle.getDirectionalCosineY();
+                break;
+            case QuantityType::Z_DIRECTIONAL_COSINE:
+                weight *= particle.getDirectionalCosineZ();
+                break;
+            case QuantityType::PARTICLE_FLUENCE:
+            default:
+                // weight remains unchanged
+                break;
+        }
+
+        // Value to add to the pixel based on the particle's weight
+        value = weight / pixelArea; // counts per cm2 or MeV per cm2
+
+        return true;
+    }
+
+
+    // The generation and LATCH filters of the images, which the reader can apply itself as they do not
+    // depend on the projection. Empty unless every image filters the same way, since a particle the
+    // reader passes over cannot be scored in any of them.
+    ParticleFilter sharedReaderFilter(const std::vector<AppConfig> & imageConfigs)
+    {
+        const AppConfig & first = imageConfigs.front();
+        for (const AppConfig & imageConfig : imageConfigs) {
+            if (imageConfig.generationFilter.useFilter != first.generationFilter.useFilter
+                || imageConfig.generationFilter.minimumGeneration != first.generationFilter.minimumGeneration
+                || imageConfig.generationFilter.maximumGeneration != first.generationFilter.maximumGeneration
+                || imageConfig.useLATCHFilter != first.useLATCHFilter
+                || imageConfig.LATCHFilter != first.LATCHFilter) {
+                return ParticleFilter{};
+            }
+        }
+
+        ParticleFilter filter;
+        if (first.generationFilter.useFilter) filter.setGenerationRange(first.generationFilter.minimumGeneration, first.generationFilter.maximumGeneration);
+        if (first.useLATCHFilter) filter.setRequiredLATCHBits(first.LATCHFilter);
+        return filter;
+    }
+
+
+    // Scores a particle in every image, projecting it once for each of the distinct projections. The value
+    // of each pixel hit is passed to addToPixel along with the index of the image.
+    template <typename AddToPixel>
+    void scoreParticle(Particle & particle, const std::vector<ImageTarget> & targets, const std::vector<Projection> & projections, AddToPixel && addToPixel)
+    {
+        if (particle.getType() == ParticleType::Unsupported) {
+            throw std::runtime_error("Encountered unsupported particle type in the input file.");
+        }
+
+        if (particle.getType() == ParticleType::PseudoParticle) return; // Skip pseudo-particles
+
+        auto scoreProjection = [&](Particle & projected, std::size_t projectionIndex) {
+            projections[projectionIndex].apply(projected);
+            for (std::size_t i = 0; i < targets.size(); i++) {
+                if (targets[i].projection != projectionIndex) continue;
+                int pixelX, pixelY;
+                float value;
+                if (scoreProjectedParticle(projected, targets[i].config, targets[i].pixelArea, pixelX, pixelY, value)) {
+                    addToPixel(i, pixelX, pixelY, value);
+                }
+            }
+        };
+
+        // Every projection but the last works on a copy, the last can move the particle itself
+        for (std::size_t p = 0; p + 1 < projections.size(); p++) {
+            Particle projected = particle;
+            scoreProjection(projected, p);
+        }
+        scoreProjection(particle, projections.size() - 1);
+    }
+
+
+    // Private accumulation grid of a scoring thread
+    //
+    // The pixels are stored in whole cache lines, so the grids of different threads never share a
+    // line however their allocations end up placed in memory.
+    class ScoringGrid
+    {
+        public:
+            ScoringGrid(int width, int height)
+            :   width_(static_cast<std::size_t>(width)),
+                lines_((static_cast<std::size_t>(width) * static_cast<std::size_t>(height) + PIXELS_PER_LINE - 1) / PIXELS_PER_LINE)
+            {}
+
+            void  add(int x, int y, float value) { const std::size_t i = index(x, y); lines_[i / PIXELS_PER_LINE].pixels[i % PIXELS_PER_LINE] += value; }
+            float get(int x, int y) const        { const std::size_t i = index(x, y); return lines_[i / PIXELS_PER_LINE].pixels[i % PIXELS_PER_LINE]; }
+
+            void  add(const ScoringGrid & other) {
+                for (std::size_t line = 0; line < lines_.size(); line++) {
+                    for (std::size_t i = 0; i < PIXELS_PER_LINE; i++) lines_[line].pixels[i] += other.lines_[line].pixels[i];
+                }
             }
+
+        private:
+            static constexpr std::size_t PIXELS_PER_LINE = CACHE_LINE_SIZE / sizeof(float);
+
+            struct alignas(CACHE_LINE_SIZE) CacheLine {
+                float pixels[PIXELS_PER_LINE] = {};
+            };
+
+            std::size_t index(int x, int y) const { return static_cast<std::size_t>(y) * width_ + static_cast<std::size_t>(x); }
+
+            std::size_t width_;
+            std::vector<CacheLine> lines_;
     };
 
+
+    // Parallel scoring
+    //
+    // Each thread reads its share of the histories with ParallelReduce() and scores them into grids
+    // of its own, so no two threads write to the same memory. The grids are summed in thread order
+    // once all of the threads have stopped, so that the result does not depend on timing, and then
+    // copied into the images. The I/O profile of the reader of each thread is returned in readProfiles.
+    void scoreInParallel(const AppConfig & config, const UserOptions & userOptions, std::vector<ImageTarget> & targets, const std::vector<Projection> & projections, Progress<std::uint64_t> & progress, std::uint64_t & particlesRead, std::uint64_t & historiesRead, std::vector<IOProfile> & readProfiles)
+    {
+        // One grid for each image on each thread
+        auto makeGrids = [&targets](std::size_t) {
+            std::vector<ScoringGrid> grids;
+            grids.reserve(targets.size());
+            for (const ImageTarget & target : targets) {
+                grids.emplace_back(target.config.imageWidth, target.config.imageHeight);
+            }
+            return grids;
+        };
+        auto scoreIntoGrids = [&targets, &projections](std::vector<ScoringGrid> & grids, Particle & particle) {
+            auto addToGrid = [&grids](std::size_t imageIndex, int pixelX, int pixelY, float value) {
+                grids[imageIndex].add(pixelX, pixelY, value);
+            };
+            scoreParticle(particle, targets, projections, addToGrid);
+        };
+        auto sumGrids = [](std::vector<ScoringGrid> & grids, std::vector<ScoringGrid> && otherGrids) {
+            for (std::size_t imageIndex = 0; imageIndex < grids.size(); imageIndex++) grids[imageIndex].add(otherGrids[imageIndex]);
+        };
+
+        ParallelAnalysisOptions options;
+        options.progress = [&progress](std::uint64_t particles, std::uint64_t histories) {
+            progress.Update(particles, "Processed " + std::to_string(histories) + " histories.");
+        };
+        const auto reduction = ParallelReduce(config.inputFile, userOptions, config.numberOfThreads, makeGrids, scoreIntoGrids, sumGrids, options);
+
+        for (std::size_t imageIndex = 0; imageIndex < targets.size(); imageIndex++) {
+            const AppConfig & imageConfig = targets[imageIndex].config;
+            Image<float> & image = *targets[imageIndex].image;
+            for (int y = 0; y < imageConfig.imageHeight; y++) {
+                for (int x = 0; x < imageConfig.imageWidth; x++) {
+                    image.setGrayscaleValue(x, y, reduction.state[imageIndex].get(x, y));
+                }
+            }
+        }
+
+        // The reader shares the empty histories out between the threads, so between them they account for every original history
+        readProfiles = reduction.readProfiles;
+        particlesRead = reduction.particlesRead;
+        historiesRead = reduction.historiesRead;
+    }
+
 } // end anonymous namespace
 
 
@@ -505,7 +920,7 @@ int main(int argc, char* argv[]) {
     // Define constants
     constexpr int SUCCESS_CODE = 0;
     constexpr int ERROR_CODE = 1;
-    constexpr int MINUMUM_REQUIRED_POSITIONAL_ARGS = 2;
+    constexpr int MINUMUM_REQUIRED_POSITIONAL_ARGS = 1;
     constexpr std::uint64_t MAX_PERCENTAGE = 100;
 
     // Register custom command line arguments
@@ -534,6 +949,12 @@ int main(int argc, char* argv[]) {
         GENERATION_FILTER_COMMAND,
         NORMALIZE_BY_PARTICLES_COMMAND,
         SHOW_DETAILS_COMMAND,
+        THREADS_COMMAND,
+        ThreadPlacementCommand,
+        IMAGE_LIST_COMMAND,
+        SAMPLE_COMMAND,
+        STRATIFIED_SAMPLE_COMMAND,
+        SAMPLE_SEED_COMMAND,
         EGSLATCHFilterCommand
     });
     
@@ -543,6 +964,7 @@ int main(int argc, char* argv[]) {
 
     // Create the reader for the input file
     std::unique_ptr<PhaseSpaceFileReader> reader;
+    std::vector<IOProfile> threadReadProfiles;
     if (config.inputFormat.empty()) {
         reader = FormatRegistry::CreateReader(config.inputFile, userOptions);
     } else {
@@ -553,24 +975,60 @@ int main(int argc, char* argv[]) {
     std::vector<std::string> errorMessages;
     std::vector<std::string> warningMessages;
 
-    if (config.printDetails) {
-        config.details(reader->getPHSPFormat());
-    }
-
     // Error handling for both reader and writer
     try {
+        // Gather the images to score, the one given on the command line followed by any in the image list
+        std::vector<AppConfig> imageConfigs;
+        if (!config.outputFile.empty()) imageConfigs.push_back(config);
+        if (!config.imageListFile.empty()) {
+            for (const AppConfig & imageConfig : readImageList(config.imageListFile, userOptions, config.inputFile)) {
+                imageConfigs.push_back(imageConfig);
+            }
+        }
+        if (imageConfigs.empty()) {
+            throw std::runtime_error("No images listed in image list file: " + config.imageListFile);
+        }
+        for (std::size_t i = 0; i < imageConfigs.size(); i++) {
+            for (std::size_t j = 0; j < i; j++) {
+                if (imageConfigs[i].outputFile == imageConfigs[j].outputFile) throw std::runtime_error("Output file " + imageConfigs[i].outputFile + " is given for more than one image.");
+            }
+        }
+
+        if (config.printDetails) {
+            for (const AppConfig & imageConfig : imageConfigs) {
+                imageConfig.details(reader->getPHSPFormat());
+            }
+        }
+
         // Start the process
         std::cout << "Counting particles from " 
-                  << config.inputFile << " (" << reader->getPHSPFormat() << ") to store in image "
-                  << config.outputFile << "..." << std::endl;
+                  << config.inputFile << " (" << reader->getPHSPFormat() << ") to store in ";
+        if (imageConfigs.size() == 1) {
+            std::cout << "image " << imageConfigs.front().outputFile;
+        } else {
+            std::cout << imageConfigs.size() << " images";
+        }
+        if (config.useThreads()) std::cout << " on " << config.numberOfThreads << " threads";
+        std::cout << "..." << std::endl;
+
+        // Draw the histories to score if only a sample of them is wanted, indexing the file first if it has no index
+        std::unique_ptr<HistorySampler> sampler;
+        if (config.useSampling()) {
+            sampler = std::make_unique<HistorySampler>(*reader, config.sampleSize, config.sampling, config.sampleSeed);
+            std::cout << "Sampling " << sampler->getNumberOfSampledHistories() << " of the " << sampler->getNumberOfRepresentedHistoriesInFile() << " histories with particles, standing for " << sampler->getNumberOfOriginalHistories() << " original histories." << std::endl;
+        }
 
         // Determine how many particles to read - capping out at maxParticles if a limit has been set
+        // The header of standard input may still hold provisional counts, so it is read to its end unless limited
+        const bool readToEndOfInput = IsStandardStream(config.inputFile);
         std::uint64_t particlesInFile = reader->getNumberOfParticles();
-        std::uint64_t particlesToRead = particlesInFile > (std::uint64_t)config.maxParticles ? (std::uint64_t)config.maxParticles : particlesInFile;
-        
-        // Determine progress update interval
-        std::uint64_t onePercentInterval = particlesToRead >= MAX_PERCENTAGE 
-                                    ? particlesToRead / MAX_PERCENTAGE 
+        std::uint64_t particlesToRead = particlesInFile > (std::uint64_t)config.maxParticles || readToEndOfInput ? (std::uint64_t)config.maxParticles : particlesInFile;
+        const bool readPartialFile = readToEndOfInput ? config.maxParticles != DEFAULT_MAX_PARTICLES : particlesToRead < particlesInFile;
+
+        // Determine progress update interval, going by the header for standard input and by the histories of a sample
+        const std::uint64_t particlesToShow = sampler ? std::max<std::uint64_t>(sampler->getNumberOfSampledHistories(), 1) : readToEndOfInput ? std::max<std::uint64_t>(std::min(particlesToRead, particlesInFile), 1) : particlesToRead;
+        std::uint64_t onePercentInterval = particlesToShow >= MAX_PERCENTAGE 
+                                    ? particlesToShow / MAX_PERCENTAGE 
                                     : 1;
 
         // Check if there are particles to read
@@ -578,160 +1036,133 @@ int main(int argc, char* argv[]) {
             throw std::runtime_error("No particles found in the input file.");
         }
 
-        // Calculate pixel mapping
-        float xPixelsPerUnitLength = static_cast<float>(config.imageWidth) / (config.maxDim1() - config.minDim1());
-        float yPixelsPerUnitLength = static_cast<float>(config.imageHeight) / (config.maxDim2() - config.minDim2());
-        float xOffset = static_cast<float>(config.minDim1()) * xPixelsPerUnitLength;
-        float yOffset = static_cast<float>(config.minDim2()) * yPixelsPerUnitLength;
-        float pixelArea = (config.maxDim1() - config.minDim1()) * (config.maxDim2() - config.minDim2()) / (config.imageWidth * config.imageHeight);
-        pixelArea /= cm2; // convert to cm^2
-
         // Start the timer
         auto start_time = std::chrono::steady_clock::now();
 
-        // Create the image object
-        Image<float> * image;
-        if (config.outputFormat == TIFF) {
-            image = new TiffImage<float>(config.imageWidth, config.imageHeight, xPixelsPerUnitLength, yPixelsPerUnitLength, xOffset, yOffset);
-        } else if (config.outputFormat == BMP) {
-            image = new BitmapImage<float>(config.imageWidth, config.imageHeight);
-        } else {
-            throw std::runtime_error("Unsupported output format.");
+        // Create the image objects, and a projection for each of the distinct ways they place particles on their planes
+        std::vector<ImageTarget> targets;
+        std::vector<Projection> projections;
+        targets.reserve(imageConfigs.size());
+        for (const AppConfig & imageConfig : imageConfigs) {
+            ImageTarget & target = targets.emplace_back(imageConfig);
+            const Projection projection(imageConfig);
+            target.projection = static_cast<std::size_t>(std::find(projections.begin(), projections.end(), projection) - projections.begin());
+            if (target.projection == projections.size()) projections.push_back(projection);
         }
 
         // Set up the progress bar for the current file
-        Progress<uint64_t> progress(particlesToRead);
+        Progress<uint64_t> progress(particlesToShow);
         progress.Start("Reading particles:");
 
-        // Read the particles from the input file and build the image data
-        while (reader->hasMoreParticles() && reader->getParticlesRead() < particlesToRead) {
-            Particle particle = reader->getNextParticle();
+        std::uint64_t particlesRead = 0;
+        std::uint64_t historiesRead = 0;
+        if (config.useThreads()) {
+            // Score each share of the histories into images of its own on a thread of its own, then sum them
+            scoreInParallel(config, userOptions, targets, projections, progress, particlesRead, historiesRead, threadReadProfiles);
+        } else if (sampler) {
+            auto addToImage = [&targets](std::size_t imageIndex, int pixelX, int pixelY, float value) {
+                Image<float> & image = *targets[imageIndex].image;
+                float pixelValue = image.getGrayscaleValue(pixelX, pixelY) + value;
+                image.setGrayscaleValue(pixelX, pixelY, pixelValue);
+            };
+
+            // Read the particles of the sampled histories in batches and build the image data
+            constexpr std::size_t PARTICLES_PER_BATCH = 4096;
+            std::vector<Particle> particles(PARTICLES_PER_BATCH);
+            std::uint64_t nextProgressUpdate = onePercentInterval;
+            while (std::size_t count = sampler->readParticles(particles)) {
+                for (std::size_t i = 0; i < count; i++) {
+                    scoreParticle(particles[i], targets, projections, addToImage);
+                }
 
-            if (particle.getType() == ParticleType::Unsupported) {
-                throw std::runtime_error("Encountered unsupported particle type in the input file.");
+                std::uint64_t historiesSoFar = sampler->getHistoriesSampled();
+                // Update progress bar every 1% of histories sampled
+                if (historiesSoFar >= nextProgressUpdate) {
+                    progress.Update(historiesSoFar, "Processed " + std::to_string(sampler->getHistoriesRead()) + " histories.");
+                    nextProgressUpdate = (historiesSoFar / onePercentInterval + 1) * onePercentInterval;
+                }
             }
 
-            if (particle.getType() == ParticleType::PseudoParticle) continue; // Skip pseudo-particles
-
-            // project particle to the scoring plane based on selected projection scheme
-            switch (config.projectionType)
-            {
-                case(ProjectionType::FLATTEN):
-                    particle.setZ(config.planeLocation);
-                    break;
-                case(ProjectionType::PROJECTION):
-                    switch (config.plane)
-                    {
-                        case(XY): particle.projectToZValue(config.planeLocation); break;
-                        case(XZ): particle.projectToYValue(config.planeLocation); break;
-                        case(YZ): particle.projectToXValue(config.planeLocation); break;
-                    };
-                    break;
-                default:
-                    break;
-            }
-            
-            // Get the particle's position
-            float x = particle.getX();
-            float y = particle.getY();
-            float z = particle.getZ();
-
-            // Determine pixel coordinates based on the selected plane
-            int pixelX = 0, pixelY = 0;
-            bool validPixel = false;
-            if (config.plane == XY && std::abs(z - config.planeLocation) <= config.tolerance && x >= config.minDim1() && x <= config.maxDim1() && y >= config.minDim2() && y <= config.maxDim2()) {
-                pixelX = static_cast<int>((x - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
-                pixelY = static_cast<int>((y - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
-                validPixel = true;
-            } else if (config.plane == XZ && std::abs(y - config.planeLocation) <= config.tolerance && x >= config.minDim1() && x <= config.maxDim1() && z >= config.minDim2() && z <= config.maxDim2()) {
-                pixelX = static_cast<int>((x - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
-                pixelY = static_cast<int>((z - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
-                validPixel = true;
-            } else if (config.plane == YZ && std::abs(x - config.planeLocation) <= config.tolerance && y >= config.minDim1() && y <= config.maxDim1() && z >= config.minDim2() && z <= config.maxDim2()) {
-                pixelX = static_cast<int>((y - config.minDim1()) / (config.maxDim1() - config.minDim1()) * config.imageWidth);
-                pixelY = static_cast<int>((z - config.minDim2()) / (config.maxDim2() - config.minDim2()) * config.imageHeight);
-                validPixel = true;
+            // The histories of the sample stand for their share of the original histories of the file
+            particlesRead = sampler->getParticlesRead();
+            historiesRead = sampler->getNumberOfOriginalHistories();
+        } else {
+            auto addToImage = [&targets](std::size_t imageIndex, int pixelX, int pixelY, float value) {
+                Image<float> & image = *targets[imageIndex].image;
+                float pixelValue = image.getGrayscaleValue(pixelX, pixelY) + value;
+                image.setGrayscaleValue(pixelX, pixelY, pixelValue);
+            };
+
+            // Let the reader pass over the particles no image would score, unless records have to be counted out for --maxParticles
+            const ParticleFilter readerFilter = !readPartialFile ? sharedReaderFilter(imageConfigs) : ParticleFilter{};
+            if (readerFilter.usesGeneration() && !reader->peekNextParticle().hasIntProperty(IntPropertyType::GENERATION)) {
+                // The reader would reject every particle, report it the same way scoring would
+                throw std::runtime_error("Could not determine particle generation (primary/secondary) from the phase space file.");
             }
-            
-            // Process the particle if it falls within the image boundaries
-            validPixel = validPixel && (pixelX >= 0 && pixelX < config.imageWidth && pixelY >= 0 && pixelY < config.imageHeight);
-
-            // Check if the particle is a included based on generation type
-            if (validPixel && config.generationFilter.useFilter) {
-                if (particle.hasIntProperty(IntPropertyType::GENERATION)) {
-                    const int generation = particle.getIntProperty(IntPropertyType::GENERATION);
-                    validPixel = generation < config.generationFilter.minimumGeneration || generation > config.generationFilter.maximumGeneration;
-                } else {
-                    // Could not determine particle generation, so throw an error
-                    throw std::runtime_error("Could not determine particle generation (primary/secondary) from the phase space file.");
+
+            if (!readerFilter.isEmpty()) {
+                // Read the particles accepted by the filter in batches and build the image data
+                constexpr std::size_t PARTICLES_PER_BATCH = 4096;
+                std::vector<Particle> particles(PARTICLES_PER_BATCH);
+                std::uint64_t nextProgressUpdate = onePercentInterval;
+                while (std::size_t count = reader->readParticles(particles, readerFilter)) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        scoreParticle(particles[i], targets, projections, addToImage);
+                    }
+
+                    std::uint64_t particlesSoFar = reader->getParticlesRead();
+                    // Update progress bar every 1% of particles read
+                    if (particlesSoFar >= nextProgressUpdate) {
+                        progress.Update(particlesSoFar, "Processed " + std::to_string(reader->getHistoriesRead()) + " histories.");
+                        nextProgressUpdate = (particlesSoFar / onePercentInterval + 1) * onePercentInterval;
+                    }
                 }
             }
 
-            // Check if the particle passes the LATCH filter if enabled
-            if (validPixel && config.useLATCHFilter) {
-                validPixel = EGSphspFile::DoesParticlePassLATCHFilter(particle, config.LATCHFilter);
-            }
+            // Read the particles from the input file and build the image data
+            while (reader->hasMoreParticles() && reader->getParticlesRead() < particlesToRead) {
+                Particle particle = reader->getNextParticle();
+                scoreParticle(particle, targets, projections, addToImage);
 
-            if (validPixel) {
-                // Determine the weight to associate with this particle
-                float weight = particle.getWeight();
-                switch (config.quantityType) {
-                    case QuantityType::ENERGY_FLUENCE:
-                        weight *= particle.getKineticEnergy() / MeV;
-                        break;
-                    case QuantityType::X_DIRECTIONAL_COSINE:
-                        weight *= particle.getDirectionalCosineX();
-                        break;
-                    case QuantityType::Y_DIRECTIONAL_COSINE:
-                        weight *= particle.getDirectionalCosineY();
-                        break;
-                    case QuantityType::Z_DIRECTIONAL_COSINE:
-                        weight *= particle.getDirectionalCosineZ();
-                        break;
-                    case QuantityType::PARTICLE_FLUENCE:
-                    default:
-                        // weight remains unchanged
-                        break;
+                std::uint64_t particlesSoFar = reader->getParticlesRead();
+                // Update progress bar every 1% of particles read
+                if (particlesSoFar % onePercentInterval == 0) {
+                    progress.Update(particlesSoFar, "Processed " + std::to_string(reader->getHistoriesRead()) + " histories.");
                 }
-
-                // Set pixel color based on the particle's weight
-                float weightPerUnitArea = weight / pixelArea; // counts per cm2 or MeV per cm2
-                float pixelValue = image->getGrayscaleValue(pixelX, pixelY) + weightPerUnitArea;
-                image->setGrayscaleValue(pixelX, pixelY, pixelValue);
             }
 
-            std::uint64_t particlesSoFar = reader->getParticlesRead();
-            // Update progress bar every 1% of particles read
-            if (particlesSoFar % onePercentInterval == 0) {
-                progress.Update(particlesSoFar, "Processed " + std::to_string(reader->getHistoriesRead()) + " histories.");
+            uint64_t numberOfHistories = reader->getNumberOfOriginalHistories();
+            particlesRead = reader->getParticlesRead();
+            if (readToEndOfInput) {
+                // A provisional header may count fewer histories than were read
+                historiesRead = readPartialFile ? reader->getHistoriesRead() : std::max(reader->getHistoriesRead(), numberOfHistories);
+            } else {
+                historiesRead = particlesRead < particlesInFile ? reader->getHistoriesRead() : numberOfHistories;
             }
         }
 
-        // Finalize the image by normalizing the data by the number of histories (or particles if specified by the user)
-        uint64_t numberOfHistories = reader->getNumberOfOriginalHistories();
-        uint64_t particlesRead = reader->getParticlesRead();
-        std::uint64_t historiesRead = particlesRead < particlesInFile ? reader->getHistoriesRead() : numberOfHistories;
-        if (config.normalizeByParticles) {
-            image->normalize(static_cast<float>(particlesRead));
-        } else {
-            image->normalize(static_cast<float>(historiesRead));
+        // Finalize the images by normalizing the data by the number of histories (or particles if specified by the user) and save them to their output files
+        for (ImageTarget & target : targets) {
+            if (target.config.normalizeByParticles) {
+                target.image->normalize(static_cast<float>(particlesRead));
+            } else {
+                target.image->normalize(static_cast<float>(historiesRead));
+            }
+            target.image->save(target.config.outputFile);
         }
 
-        // Save the image to the output file
-        image->save(config.outputFile);
-
         // Complete the progress bar
         progress.Complete("Image generation complete. Processed " + std::to_string(historiesRead) + " histories.");
 
-        if (config.normalizeByParticles) {
-            std::cout << "Image normalized by particles (" << particlesRead << " particles read)." << std::endl;
-        } else {
-            std::cout << "Image normalized by histories (" << historiesRead << " histories read)." << std::endl;
+        for (const ImageTarget & target : targets) {
+            if (targets.size() > 1) std::cout << target.config.outputFile << ": ";
+            if (target.config.normalizeByParticles) {
+                std::cout << "Image normalized by particles (" << particlesRead << " particles read)." << std::endl;
+            } else {
+                std::cout << "Image normalized by histories (" << historiesRead << " histories read)." << std::endl;
+            }
         }
 
-        // Clean up resources
-        delete image;
-
         // Measure elapsed time and report it
         auto end_time = std::chrono::steady_clock::now();
         double elapsed = std::chrono::duration<double>(end_time - start_time).count();
@@ -744,6 +1175,14 @@ int main(int argc, char* argv[]) {
     // Ensure that the reader is closed even if an exception occurs
     try { if (reader) reader->close(); } catch (const std::exception& e) { errorMessages.push_back("Error closing reader: " + std::string(e.what())); }
 
+    // Report where the time went if requested
+    if (userOptions.contains(ProfileCommand)) {
+        if (reader) PrintIOProfile(std::cout, "Read " + config.inputFile, reader->getIOProfile());
+        for (std::size_t i = 0; i < threadReadProfiles.size(); i++) {
+            PrintIOProfile(std::cout, "Read on thread " + std::to_string(i), threadReadProfiles[i]);
+        }
+    }
+
     std::cout << std::endl;
 
     // Output any error messages
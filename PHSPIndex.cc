@@ -0,0 +1,92 @@
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <memory>
+
+#include "particlezoo/utilities/argParse.h"
+#include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/historyIndex.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+
+int main(int argc, char* argv[]) {
+
+    // Initial setup
+    using namespace ParticleZoo;
+    int errorCode = 0;
+
+    // Custom command line arguments
+    const CLICommand STRIDE_COMMAND = CLICommand(NONE, "s", "stride", "Number of histories between index entries (default: " + std::to_string(HistoryIndex::DEFAULT_STRIDE) + ")", { CLI_UINT });
+    const CLICommand INPUT_FORMAT_COMMAND = CLICommand(NONE, "", "inputFormat", "Force input file format (default: auto-detect from extension)", { CLI_STRING });
+    ArgParser::RegisterCommand(STRIDE_COMMAND);
+    ArgParser::RegisterCommand(INPUT_FORMAT_COMMAND);
+
+    // Define usage message and parse command line arguments
+    std::string usageMessage = "Usage: PHSPIndex [OPTIONS] <inputfile> [<inputfile> ...]\n"
+                            "\n"
+                            "Build a history index sidecar file (<inputfile>.pzidx) for each phase space file\n"
+                            "The index holds the number of represented histories and where histories start, so that the parallel readers\n"
+                            "and seeking to a history do not have to scan the whole file, and the energy, position and particle type ranges of\n"
+                            "each block of histories, so that filtered reads can pass over blocks without reading them. It is ignored once the\n"
+                            "phase space file changes.\n"
+                            "\n"
+                            "Required Arguments:\n"
+                            "  <inputfile>               Input phase space file to index\n"
+                            "\n"
+                            "Examples:\n"
+                            "  PHSPIndex input.egsphsp\n"
+                            "  PHSPIndex --stride 256 input1.egsphsp input2.egsphsp\n"
+                            "  PHSPIndex --formats";
+    auto userOptions = ArgParser::ParseArgs(argc, argv, usageMessage, 1);
+
+    // Validate parameters
+    std::vector<CLIValue> positionals = userOptions.contains(CLI_POSITIONALS) ? userOptions.at(CLI_POSITIONALS) : std::vector<CLIValue>{};
+    std::string inputFormat = userOptions.contains(INPUT_FORMAT_COMMAND) ? (userOptions.at(INPUT_FORMAT_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(INPUT_FORMAT_COMMAND)[0])) : "";
+    std::uint64_t stride = userOptions.contains(STRIDE_COMMAND) ? (userOptions.at(STRIDE_COMMAND).empty() ? 0 : std::get<unsigned int>(userOptions.at(STRIDE_COMMAND)[0])) : HistoryIndex::DEFAULT_STRIDE;
+
+    if (positionals.empty()) {
+        std::cerr << "Error: No input file specified\n";
+        errorCode = 1;
+        return errorCode;
+    }
+
+    if (stride == 0) {
+        std::cerr << "Error: Invalid stride. Must be a positive integer\n";
+        errorCode = 1;
+        return errorCode;
+    }
+
+    for (const CLIValue & positional : positionals) {
+        const std::string inputFile = std::get<std::string>(positional);
+        std::unique_ptr<PhaseSpaceFileReader> reader;
+
+        try {
+            auto startTime = std::chrono::high_resolution_clock::now();
+
+            if (inputFormat.empty()) {
+                reader = FormatRegistry::CreateReader(inputFile, userOptions);
+            } else {
+                reader = FormatRegistry::CreateReader(inputFormat, inputFile, userOptions);
+            }
+
+            std::cout << "Indexing " << inputFile << " (" << reader->getPHSPFormat() << ")..." << std::endl;
+
+            const HistoryIndex index = reader->buildHistoryIndex(stride);
+            index.save(reader->getFileName());
+
+            auto endTime = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsedSeconds = endTime - startTime;
+            std::cout << index.getNumberOfRepresentedHistories() << " represented histories and " << index.getNumberOfParticles() << " particles indexed in "
+                      << elapsedSeconds.count() << " seconds, written to " << HistoryIndex::GetIndexFileName(reader->getFileName()) << "\n";
+
+        } catch (const std::exception & e) {
+            std::cerr << std::endl << "Error occurred while indexing " << inputFile << ": " << e.what() << std::endl;
+            errorCode = 1;
+        }
+
+        if (reader) reader->close();
+    }
+
+    // Return appropriate error code
+    return errorCode;
+}
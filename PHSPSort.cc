@@ -0,0 +1,195 @@
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "particlezoo/utilities/argParse.h"
+#include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/progress.h"
+#include "particlezoo/utilities/spatialIndex.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/PhaseSpaceFileWriter.h"
+
+int main(int argc, char* argv[]) {
+
+    // Initial setup
+    using namespace ParticleZoo;
+    int errorCode = 0;
+
+    // Custom command line arguments
+    const CLICommand TILE_LEVEL_COMMAND = CLICommand(NONE, "l", "tileLevel", "Base 2 logarithm of the number of tiles on each side of the grid (default: " + std::to_string(SpatialGrid::DEFAULT_LEVEL) + ", at most " + std::to_string(SpatialGrid::MAXIMUM_LEVEL) + ")", { CLI_UINT });
+    const CLICommand INPUT_FORMAT_COMMAND = CLICommand(NONE, "", "inputFormat", "Force input file format (default: auto-detect from extension)", { CLI_STRING });
+    const CLICommand OUTPUT_FORMAT_COMMAND = CLICommand(NONE, "", "outputFormat", "Force output file format (default: auto-detect from extension)", { CLI_STRING });
+    ArgParser::RegisterCommand(TILE_LEVEL_COMMAND);
+    ArgParser::RegisterCommand(INPUT_FORMAT_COMMAND);
+    ArgParser::RegisterCommand(OUTPUT_FORMAT_COMMAND);
+
+    // Define usage message and parse command line arguments
+    std::string usageMessage = "Usage: PHSPSort [OPTIONS] <inputfile> <outputfile>\n"
+                            "\n"
+                            "Reorder the histories of a phase space file so that histories close together on the X-Y plane are close together in the file\n"
+                            "The plane is divided into a square grid of tiles spanning the positions of the particles, and the histories are written tile\n"
+                            "by tile in Z-order (Morton order) of the tile holding their first particle. Histories are kept whole and in their original\n"
+                            "order within each tile, and the empty histories of the input are accounted for in the output.\n"
+                            "Reading a region of interest of the sorted file reads a few contiguous runs of histories, and the filtered reads of the\n"
+                            "library skip more of the file with a history index (see PHSPIndex) since its blocks of histories cover smaller areas.\n"
+                            "A spatial index of the output file is saved next to it (<outputfile>.pzsidx) when the output can be read in any order.\n"
+                            "The input file must be readable in any order, and is memory mapped when it is binary.\n"
+                            "\n"
+                            "Required Arguments:\n"
+                            "  <inputfile>               Input phase space file to sort\n"
+                            "  <outputfile>              Output phase space file\n"
+                            "\n"
+                            "Examples:\n"
+                            "  PHSPSort input.egsphsp sorted.egsphsp\n"
+                            "  PHSPSort --tileLevel 8 input.IAEAphsp sorted.IAEAphsp\n"
+                            "  PHSPSort --outputFormat EGS input.IAEAphsp sorted.egsphsp\n"
+                            "  PHSPSort --formats";
+    auto userOptions = ArgParser::ParseArgs(argc, argv, usageMessage, 2);
+
+    // Validate parameters
+    std::vector<CLIValue> positionals = userOptions.contains(CLI_POSITIONALS) ? userOptions.at(CLI_POSITIONALS) : std::vector<CLIValue>{};
+    std::string inputFile = positionals.size() > 0 ? std::get<std::string>(positionals[0]) : "";
+    std::string outputFile = positionals.size() > 1 ? std::get<std::string>(positionals[1]) : "";
+    std::string inputFormat = userOptions.contains(INPUT_FORMAT_COMMAND) ? (userOptions.at(INPUT_FORMAT_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(INPUT_FORMAT_COMMAND)[0])) : "";
+    std::string outputFormat = userOptions.contains(OUTPUT_FORMAT_COMMAND) ? (userOptions.at(OUTPUT_FORMAT_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(OUTPUT_FORMAT_COMMAND)[0])) : "";
+    unsigned int tileLevel = userOptions.contains(TILE_LEVEL_COMMAND) ? (userOptions.at(TILE_LEVEL_COMMAND).empty() ? SpatialGrid::MAXIMUM_LEVEL + 1 : std::get<unsigned int>(userOptions.at(TILE_LEVEL_COMMAND)[0])) : SpatialGrid::DEFAULT_LEVEL;
+    bool profile = userOptions.contains(ProfileCommand);
+
+    if (inputFile.empty() || outputFile.empty()) {
+        std::cerr << "Error: Both an input and an output file must be specified\n";
+        errorCode = 1;
+        return errorCode;
+    }
+
+    if (tileLevel > SpatialGrid::MAXIMUM_LEVEL) {
+        std::cerr << "Error: Invalid tile level. Must be an integer from 0 to " << SpatialGrid::MAXIMUM_LEVEL << "\n";
+        errorCode = 1;
+        return errorCode;
+    }
+
+    // The histories are read out of order, which costs nothing more than reading them in order from a mapped file
+    UserOptions readerOptions = userOptions;
+    readerOptions[MemoryMapCommand] = {};
+
+    // Start timer
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Create reader and writer pointers
+    std::unique_ptr<PhaseSpaceFileReader> reader;
+    std::unique_ptr<PhaseSpaceFileWriter> writer;
+
+    try {
+
+        // Create the reader for the input file
+        if (inputFormat.empty()) {
+            reader = FormatRegistry::CreateReader(inputFile, readerOptions);
+        } else {
+            reader = FormatRegistry::CreateReader(inputFormat, inputFile, readerOptions);
+        }
+        if (!reader->supportsRandomAccess()) {
+            throw std::runtime_error("The " + reader->getPHSPFormat() + " file " + inputFile + " cannot be read in any order, so it cannot be sorted.");
+        }
+
+        // Try to keep the same constant values in the new phase space file if it supports them
+        FixedValues fixedValues = reader->getFixedValues();
+        if (outputFormat.empty()) {
+            writer = FormatRegistry::CreateWriter(outputFile, userOptions, fixedValues);
+        } else {
+            writer = FormatRegistry::CreateWriter(outputFormat, outputFile, userOptions, fixedValues);
+        }
+
+        std::cout << "Indexing the histories of " << inputFile << " (" << reader->getPHSPFormat() << ") on a "
+                  << (1u << tileLevel) << " x " << (1u << tileLevel) << " grid..." << std::endl;
+        const SpatialIndex index = reader->buildSpatialIndex(tileLevel);
+        const SpatialGrid & grid = index.getGrid();
+        std::cout << "  X from " << grid.minX << " to " << grid.maxX << " cm, Y from " << grid.minY << " to " << grid.maxY << " cm" << std::endl;
+        std::cout << "  " << index.getTiles().size() << " tiles hold histories, in " << index.getNumberOfRecordRanges() << " runs of the file" << std::endl;
+
+        std::uint64_t totalRecords = 0;
+        for (const SpatialTile & tile : index.getTiles()) totalRecords += tile.numberOfRecords;
+        const std::uint64_t onePercentInterval = totalRecords >= 100 ? totalRecords / 100 : 1;
+
+        std::cout << "Writing the histories tile by tile to " << outputFile << " (" << writer->getPHSPFormat() << ")..." << std::endl;
+        Progress<std::uint64_t> progress(totalRecords);
+        progress.Start("Sorting histories");
+
+        // Each range starts at the first record of a history and ends with the last record of a history,
+        // so its particles are read until the reader passes its last record, any records folded into them included
+        std::uint64_t recordsWritten = 0;
+        std::uint64_t nextUpdate = onePercentInterval;
+        for (const SpatialTile & tile : index.getTiles()) {
+            for (const RecordRange & range : tile.recordRanges) {
+                reader->moveToParticle(range.firstRecord);
+                const std::uint64_t endRecord = range.firstRecord + range.numberOfRecords;
+                bool isFirstParticle = true;
+                while (reader->getNextRecordIndex() < endRecord && reader->hasMoreParticles()) {
+                    Particle particle = reader->getNextParticle();
+                    if (isFirstParticle && !particle.isNewHistory()) {
+                        // The records before the first history flagged in the file make up a history of their own
+                        particle.setNewHistory(true);
+                        particle.setIncrementalHistories(std::max<std::uint32_t>(particle.getIncrementalHistories(), 1));
+                    }
+                    isFirstParticle = false;
+                    writer->writeParticle(std::move(particle));
+                }
+                recordsWritten += range.numberOfRecords;
+                if (recordsWritten >= nextUpdate) {
+                    progress.Update(recordsWritten, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                    nextUpdate = recordsWritten + onePercentInterval;
+                }
+            }
+        }
+
+        std::uint64_t totalHistoriesWritten = writer->getHistoriesWritten();
+        std::uint64_t totalOriginalHistories = reader->getNumberOfOriginalHistories();
+        if (totalOriginalHistories > totalHistoriesWritten) {
+            writer->addAdditionalHistories(totalOriginalHistories - totalHistoriesWritten);
+            totalHistoriesWritten = totalOriginalHistories;
+        } else if (totalHistoriesWritten > totalOriginalHistories) {
+            progress.Complete("Error occurred.");
+            throw std::runtime_error("The number of histories written (" + std::to_string(totalHistoriesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(totalOriginalHistories) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
+        }
+        std::uint64_t particlesWritten = writer->getParticlesWritten();
+        if (particlesWritten != reader->getNumberOfParticles()) {
+            progress.Complete("Error occurred.");
+            throw std::runtime_error("The number of particles written (" + std::to_string(particlesWritten) + ") does not match the number of particles in the input file (" + std::to_string(reader->getNumberOfParticles()) + ").");
+        }
+        progress.Complete("Done. Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+
+        writer->close();
+        if (profile) PrintIOProfile(std::cout, "Wrote " + writer->getFileName(), writer->getIOProfile(), true);
+
+        // Index the output over the same grid so that regions of interest can be looked up in it straight away
+        auto sortedReader = outputFormat.empty() ? FormatRegistry::CreateReader(outputFile, userOptions) : FormatRegistry::CreateReader(outputFormat, outputFile, userOptions);
+        if (sortedReader->supportsRandomAccess()) {
+            const SpatialIndex sortedIndex = sortedReader->buildSpatialIndex(grid);
+            sortedIndex.save(outputFile);
+            std::cout << "Saved the spatial index of " << outputFile << " to " << SpatialIndex::GetIndexFileName(outputFile)
+                      << " (" << sortedIndex.getNumberOfRecordRanges() << " runs for " << sortedIndex.getTiles().size() << " tiles)" << std::endl;
+        }
+        sortedReader->close();
+
+        // End timer and print elapsed time
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsedSeconds = endTime - startTime;
+        std::cout << "Sort completed in " << elapsedSeconds.count() << " seconds\n";
+        std::cout << particlesWritten << " particles and " << totalHistoriesWritten << " histories written\n";
+
+    } catch (const std::exception & e) {
+        std::cerr << std::endl << "Error occurred: " << e.what() << std::endl;
+        errorCode = 1;
+    }
+
+    // Close reader
+    if (reader) reader->close();
+    if (writer) writer->close();
+    if (reader && profile) PrintIOProfile(std::cout, "Read " + inputFile, reader->getIOProfile());
+
+    // Return appropriate error code
+    return errorCode;
+}
@@ -6,6 +6,14 @@
 #include <sstream>
 #include <iomanip>
 #include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <exception>
+#include <limits>
 
 #include "particlezoo/utilities/argParse.h"
 #include "particlezoo/utilities/formats.h"
@@ -32,6 +40,8 @@ int main(int argc, char* argv[]) {
                             "\n"
                             "Split a single phase space file into multiple (roughly) equally sized phase space files\n"
                             "History boundaries will be respected so that no history is split across files, this can result in files of marginally different sizes.\n"
+                            "When the output format stores particles exactly as the input file does, the parts are written in parallel by copying the records\n"
+                            "of each part from the input file directly, without decoding and re-encoding every particle.\n"
                             "\n"
                             "Required Arguments:\n"
                             "  --splitNumber             Number of files to split this phase space file into\n"
@@ -50,6 +60,7 @@ int main(int argc, char* argv[]) {
     std::string inputFormat = userOptions.contains(INPUT_FORMAT_COMMAND) ? (userOptions.at(INPUT_FORMAT_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(INPUT_FORMAT_COMMAND)[0])) : "";
     std::string outputFormat = userOptions.contains(OUTPUT_FORMAT_COMMAND) ? (userOptions.at(OUTPUT_FORMAT_COMMAND).empty() ? "" : std::get<std::string>(userOptions.at(OUTPUT_FORMAT_COMMAND)[0])) : "";
     int splitNumber = userOptions.contains(SPLIT_NUMBER_COMMAND) ? (userOptions.at(SPLIT_NUMBER_COMMAND).empty() ? -1 : std::get<int>(userOptions.at(SPLIT_NUMBER_COMMAND)[0])) : -1;
+    bool profile = userOptions.contains(ProfileCommand);
 
     if (inputFile.empty()) {
         std::cerr << "Error: No input file specified\n";
@@ -64,7 +75,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Check file name before extension and get output file extension based on phase space format
-    auto inputPath = std::filesystem::path(inputFile);
+    auto inputPath = std::filesystem::path(StripCompressionSuffix(inputFile)); // the parts of a compressed file are written uncompressed
     auto fileStem = inputPath.stem().string(); // get filename without extension
     auto fileExt = outputFormat.length() == 0 ? inputPath.extension().string() : FormatRegistry::ExtensionForFormat(outputFormat);
 
@@ -86,6 +97,14 @@ int main(int argc, char* argv[]) {
         return (inputPath.parent_path() / numbered).string();
     };
 
+    auto CreateSplitWriter = [&](const std::string & outputFilePath, const FixedValues & fixedValues) {
+        if (outputFormat.empty()) {
+            return FormatRegistry::CreateWriter(outputFilePath, userOptions, fixedValues);
+        } else {
+            return FormatRegistry::CreateWriter(outputFormat, outputFilePath, userOptions, fixedValues);
+        }
+    };
+
     // Start timer
     auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -126,98 +145,210 @@ int main(int argc, char* argv[]) {
         int filesSplit = 0;
 
         std::string outputFilePath = GetSplitFilePath(0);
+        writer = CreateSplitWriter(outputFilePath, fixedValues);
 
-        if (outputFormat.empty()) {
-            writer = FormatRegistry::CreateWriter(outputFilePath, userOptions, fixedValues);
-        } else {
-            writer = FormatRegistry::CreateWriter(outputFormat, outputFilePath, userOptions, fixedValues);
+        std::uint64_t totalHistoriesWritten = 0;
+        std::uint64_t totalParticlesWritten = 0;
+
+        // When the records can be copied as they are, find where each part starts by seeking to its first
+        // record and reading on to the next history boundary. The parts are measured in records rather than
+        // particles, since records holding only metadata (e.g. TOPAS pseudo-particles) are copied along with them.
+        std::vector<std::uint64_t> firstRecords;
+        if (reader->getFormatType() == FormatType::BINARY && reader->supportsRandomAccess() && writer->canAppendRecordsFrom(*reader)) {
+            const std::uint64_t totalRecords = reader->getNumberOfRecords();
+            const std::uint64_t recordsPerSplit = totalRecords / splitNumber;
+            firstRecords.push_back(0);
+            while (firstRecords.size() < static_cast<std::size_t>(splitNumber)) {
+                std::uint64_t target = firstRecords.back() + recordsPerSplit;
+                std::uint64_t historyStart = target < totalRecords ? reader->findHistoryStart(target) : totalRecords;
+                if (historyStart >= totalRecords || !reader->hasMoreParticles()) {
+                    // A history too large for its part would leave the parts after it empty, so split particle by particle as usual
+                    firstRecords.clear();
+                    reader->moveToParticle(0);
+                    break;
+                }
+                firstRecords.push_back(historyStart);
+            }
         }
 
-        // Determine progress update interval
-        uint64_t onePercentInterval = particlesPerSplit >= 100 
-                                    ? particlesPerSplit / 100 
-                                    : 1;
+        if (!firstRecords.empty()) {
+            std::cout << "Copying the records of " << inputFile << " (" << reader->getPHSPFormat() << ") into "
+                      << splitNumber << " parts each with format " << writer->getPHSPFormat() << "..." << std::endl;
 
-        std::cout << "Splitting particles from " 
-                  << inputFile << " (" << reader->getPHSPFormat() << ") into "
-                  << splitNumber << " parts each with format " << writer->getPHSPFormat() << "..." << std::endl;
-
-        std::uint64_t totalHistoriesWritten = 0;
+            std::vector<std::unique_ptr<PhaseSpaceFileWriter>> writers;
+            writers.push_back(std::move(writer));
+            for (int i = 1; i < splitNumber; i++) {
+                writers.push_back(CreateSplitWriter(GetSplitFilePath(i), fixedValues));
+            }
 
-        std::uint64_t particlesWrittenAtStartOfSplit = 0;
-        // Loop over the number of files to create
-        for (filesSplit = 0; filesSplit < splitNumber; filesSplit++) {
-            // Reset counters and flags for this split
-            bool isNewHistory = false;
-            bool belowLimit = true;
-            bool isLastFile = (filesSplit == splitNumber - 1);
-
-            Progress<uint64_t> progress(particlesPerSplit);
-            progress.Start(outputFilePath);
-
-            // Buffer the last particle read so that it can be written to the next file if needed
-            Particle particle;
-            bool hasBufferedParticle = false;
-
-            // Loop until we reach the particle limit for this file, ensuring we don't split a history across files and exceeding the limit for the last file if there are remaining particles
-            for (std::uint64_t j = particlesWrittenAtStartOfSplit; reader->hasMoreParticles() && (belowLimit || !isNewHistory || isLastFile); j++) {
-                // Read the next particle
-                particle = reader->getNextParticle();
-                // Check if this is a new history
-                isNewHistory = particle.isNewHistory();
-                // Write the particle if we are below the limit, or if we're not below the limit but it's not a new history (to avoid splitting histories), or if it's the last file (to write any remaining particles)
-                if (belowLimit || !isNewHistory || isLastFile) {
-                    writer->writeParticle(particle);
-                } else {
-                    // Buffer this particle to write to the next file
-                    hasBufferedParticle = true;
+            // Each thread copies whole parts, claiming the next part not yet started until none are left
+            const std::size_t numberOfParts = writers.size();
+            const std::size_t numberOfThreads = std::min<std::size_t>(numberOfParts, std::max(1u, std::thread::hardware_concurrency()));
+            std::atomic<std::size_t> nextPart = 0;
+            std::atomic<std::size_t> partsCopied = 0;
+            std::size_t threadsFinished = 0;
+            std::mutex threadsFinishedMutex;
+            std::condition_variable partCopied;
+            std::vector<std::exception_ptr> errors(numberOfThreads);
+
+            auto copyParts = [&](std::size_t threadIndex) {
+                try {
+                    auto partReader = inputFormat.empty() ? FormatRegistry::CreateReader(inputFile, userOptions) : FormatRegistry::CreateReader(inputFormat, inputFile, userOptions);
+                    for (std::size_t part = nextPart++; part < numberOfParts; part = nextPart++) {
+                        bool isLastPart = (part == numberOfParts - 1);
+                        std::uint64_t numberOfRecords = isLastPart ? std::numeric_limits<std::uint64_t>::max() : firstRecords[part + 1] - firstRecords[part];
+                        writers[part]->appendRecordsFrom(*partReader, firstRecords[part], numberOfRecords);
+                        // The last part is closed once any remaining empty histories have been added to it
+                        if (!isLastPart) writers[part]->close();
+                        partsCopied++;
+                        partCopied.notify_one();
+                    }
+                    partReader->close();
+                } catch (...) {
+                    errors[threadIndex] = std::current_exception();
+                    nextPart = numberOfParts; // stop the other threads from starting new parts
                 }
-                // Update the below limit flag for the next iteration
-                belowLimit = (j+1 < particlesPerSplit);
-
-                if (j % onePercentInterval == 0) {
-                    progress.Update(j, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                {
+                    std::lock_guard<std::mutex> lock(threadsFinishedMutex);
+                    threadsFinished++;
                 }
+                partCopied.notify_one();
+            };
+
+            Progress<std::size_t> progress(numberOfParts);
+            progress.Start("Copying records");
+            std::vector<std::thread> threads;
+            threads.reserve(numberOfThreads);
+            for (std::size_t i = 0; i < numberOfThreads; i++) {
+                threads.emplace_back(copyParts, i);
             }
-
-            totalHistoriesWritten += writer->getHistoriesWritten();
-            if (isLastFile) {
-                std::uint64_t totalOriginalHistories = reader->getNumberOfOriginalHistories();
-                if (totalOriginalHistories > totalHistoriesWritten) {
-                    writer->addAdditionalHistories(totalOriginalHistories - totalHistoriesWritten);
-                    totalHistoriesWritten = totalOriginalHistories;
-                } else if (totalHistoriesWritten > totalOriginalHistories) {
+            {
+                std::unique_lock<std::mutex> lock(threadsFinishedMutex);
+                while (threadsFinished < numberOfThreads) {
+                    partCopied.wait_for(lock, std::chrono::milliseconds(200));
+                    progress.Update(partsCopied, "Copied " + std::to_string(partsCopied) + " of " + std::to_string(numberOfParts) + " parts.");
+                }
+            }
+            for (std::thread & thread : threads) {
+                thread.join();
+            }
+            for (const std::exception_ptr & error : errors) {
+                if (error) {
                     progress.Complete("Error occurred.");
-                    throw std::runtime_error("The number of histories written (" + std::to_string(totalHistoriesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(totalOriginalHistories) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
+                    std::rethrow_exception(error);
                 }
             }
 
-            // Complete the progress bar for this file
-            progress.Complete("Done. Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
-
-            // Close the current output file
-            writer->close();
-            writer = nullptr;
-
-            // If this is not the last file, create a new writer for the next output file and write the last buffered particle to it
-            if (!isLastFile) {
-                // Prepare for next output file
-                outputFilePath = GetSplitFilePath(filesSplit+1);
-                if (outputFormat.empty()) {
-                    writer = FormatRegistry::CreateWriter(outputFilePath, userOptions, fixedValues);
-                } else {
-                    writer = FormatRegistry::CreateWriter(outputFormat, outputFilePath, userOptions, fixedValues);
+            for (const auto & partWriter : writers) {
+                totalHistoriesWritten += partWriter->getHistoriesWritten();
+                totalParticlesWritten += partWriter->getParticlesWritten();
+            }
+            std::uint64_t totalOriginalHistories = reader->getNumberOfOriginalHistories();
+            if (totalOriginalHistories > totalHistoriesWritten) {
+                writers.back()->addAdditionalHistories(totalOriginalHistories - totalHistoriesWritten);
+                totalHistoriesWritten = totalOriginalHistories;
+            }
+            writers.back()->close();
+            progress.Complete("Done. Copied " + std::to_string(numberOfParts) + " parts.");
+
+            for (const auto & partWriter : writers) {
+                std::cout << "  " << partWriter->getFileName() << ": " << partWriter->getParticlesWritten() << " particles, "
+                          << partWriter->getHistoriesWritten() << " histories" << std::endl;
+                if (profile) PrintIOProfile(std::cout, "    Wrote", partWriter->getIOProfile(), true);
+            }
+
+            if (totalHistoriesWritten > totalOriginalHistories) {
+                throw std::runtime_error("The number of histories written (" + std::to_string(totalHistoriesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(totalOriginalHistories) + "). The metadata may be incorrect. The output files will reflect the number of histories actually written.");
+            }
+            filesSplit = splitNumber;
+        } else {
+            // Determine progress update interval
+            uint64_t onePercentInterval = particlesPerSplit >= 100 
+                                        ? particlesPerSplit / 100 
+                                        : 1;
+
+            std::cout << "Splitting particles from " 
+                      << inputFile << " (" << reader->getPHSPFormat() << ") into "
+                      << splitNumber << " parts each with format " << writer->getPHSPFormat() << "..." << std::endl;
+
+            std::uint64_t particlesWrittenAtStartOfSplit = 0;
+            // Loop over the number of files to create
+            for (filesSplit = 0; filesSplit < splitNumber; filesSplit++) {
+                // Reset counters and flags for this split
+                bool isNewHistory = false;
+                bool belowLimit = true;
+                bool isLastFile = (filesSplit == splitNumber - 1);
+
+                Progress<uint64_t> progress(particlesPerSplit);
+                progress.Start(outputFilePath);
+
+                // Buffer the last particle read so that it can be written to the next file if needed
+                Particle particle;
+                bool hasBufferedParticle = false;
+
+                // Loop until we reach the particle limit for this file, ensuring we don't split a history across files and exceeding the limit for the last file if there are remaining particles
+                for (std::uint64_t j = particlesWrittenAtStartOfSplit; reader->hasMoreParticles() && !hasBufferedParticle; j++) {
+                    // Read the next particle
+                    particle = reader->getNextParticle();
+                    // Check if this is a new history
+                    isNewHistory = particle.isNewHistory();
+                    // Write the particle if we are below the limit, or if we're not below the limit but it's not a new history (to avoid splitting histories), or if it's the last file (to write any remaining particles)
+                    if (belowLimit || !isNewHistory || isLastFile) {
+                        writer->writeParticle(particle);
+                    } else {
+                        // Buffer this particle to write to the next file
+                        hasBufferedParticle = true;
+                    }
+                    // Update the below limit flag for the next iteration
+                    belowLimit = (j+1 < particlesPerSplit);
+
+                    if (j % onePercentInterval == 0) {
+                        progress.Update(j, "Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+                    }
                 }
-                // Write the last buffered particle to the new file
-                if (hasBufferedParticle) {
-                    writer->writeParticle(particle);
-                    particlesWrittenAtStartOfSplit = 1;
-                } else {
-                    particlesWrittenAtStartOfSplit = 0;
+
+                totalHistoriesWritten += writer->getHistoriesWritten();
+                totalParticlesWritten += writer->getParticlesWritten();
+                if (isLastFile) {
+                    std::uint64_t totalOriginalHistories = reader->getNumberOfOriginalHistories();
+                    if (totalOriginalHistories > totalHistoriesWritten) {
+                        writer->addAdditionalHistories(totalOriginalHistories - totalHistoriesWritten);
+                        totalHistoriesWritten = totalOriginalHistories;
+                    } else if (totalHistoriesWritten > totalOriginalHistories) {
+                        progress.Complete("Error occurred.");
+                        throw std::runtime_error("The number of histories written (" + std::to_string(totalHistoriesWritten) + ") exceeds the number of histories in the original file's metadata (" + std::to_string(totalOriginalHistories) + "). The metadata may be incorrect. The output file will reflect the number of histories actually written.");
+                    }
+                }
+
+                // Complete the progress bar for this file
+                progress.Complete("Done. Processed " + std::to_string(writer->getHistoriesWritten()) + " histories.");
+
+                // Close the current output file
+                writer->close();
+                if (profile) PrintIOProfile(std::cout, "Wrote " + writer->getFileName(), writer->getIOProfile(), true);
+                writer = nullptr;
+
+                // If this is not the last file, create a new writer for the next output file and write the last buffered particle to it
+                if (!isLastFile) {
+                    // Prepare for next output file
+                    outputFilePath = GetSplitFilePath(filesSplit+1);
+                    writer = CreateSplitWriter(outputFilePath, fixedValues);
+                    // Write the last buffered particle to the new file
+                    if (hasBufferedParticle) {
+                        writer->writeParticle(particle);
+                        particlesWrittenAtStartOfSplit = 1;
+                    } else {
+                        particlesWrittenAtStartOfSplit = 0;
+                    }
                 }
             }
         }
 
+        // Every particle of the input file belongs to exactly one of the parts
+        if (totalParticlesWritten != totalParticles) {
+            throw std::runtime_error("The parts hold " + std::to_string(totalParticlesWritten) + " particles, not the " + std::to_string(totalParticles) + " of the input file.");
+        }
+
         // End timer and print elapsed time
         auto endTime = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> elapsedSeconds = endTime - startTime;
@@ -232,6 +363,7 @@ int main(int argc, char* argv[]) {
     // Close reader
     if (reader) reader->close();
     if (writer) writer->close();
+    if (reader && profile) PrintIOProfile(std::cout, "Read " + inputFile, reader->getIOProfile());
 
     // Return appropriate error code
     return errorCode;
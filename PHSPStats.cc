@@ -0,0 +1,365 @@
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <numbers>
+
+#include "particlezoo/utilities/argParse.h"
+#include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/progress.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/parallel/ParallelAnalysis.h"
+
+namespace {
+
+    using namespace ParticleZoo;
+
+    // Weighted histogram of kinetic energies from zero
+    //
+    // With a fixed range everything above it is counted as overflow. Otherwise the range starts at
+    // AUTOMATIC_START_RANGE and is doubled, joining pairs of bins, until it holds the largest energy
+    // filled, so that two spectra are merged exactly by doubling the narrower one to the range of
+    // the other. The number of bins is kept even for the pairs to line up.
+    class EnergySpectrum
+    {
+        public:
+            static constexpr double AUTOMATIC_START_RANGE = 0.001; // MeV
+
+            EnergySpectrum(std::size_t numberOfBins, double maximumEnergy)
+            :   bins_(numberOfBins + numberOfBins % 2, 0.0),
+                fixedRange_(maximumEnergy > 0),
+                binWidth_((maximumEnergy > 0 ? maximumEnergy : AUTOMATIC_START_RANGE) / static_cast<double>(numberOfBins + numberOfBins % 2)),
+                overflow_(0)
+            {}
+
+            void fill(double energy, double weight) {
+                if (!(energy >= 0)) energy = 0;
+                if (!fixedRange_) {
+                    while (energy >= getRange()) widen();
+                } else if (energy >= getRange()) {
+                    overflow_ += weight;
+                    return;
+                }
+                bins_[std::min(static_cast<std::size_t>(energy / binWidth_), bins_.size() - 1)] += weight;
+            }
+
+            void merge(EnergySpectrum && other) {
+                while (binWidth_ < other.binWidth_) widen();
+                while (other.binWidth_ < binWidth_) other.widen();
+                for (std::size_t i = 0; i < bins_.size(); i++) bins_[i] += other.bins_[i];
+                overflow_ += other.overflow_;
+            }
+
+            std::size_t getNumberOfBins() const { return bins_.size(); }
+            double      getBinWidth() const     { return binWidth_; }
+            double      getRange() const        { return binWidth_ * static_cast<double>(bins_.size()); }
+            double      getBin(std::size_t i) const { return bins_[i]; }
+            double      getOverflow() const     { return overflow_; }
+
+        private:
+            void widen() {
+                const std::size_t half = bins_.size() / 2;
+                for (std::size_t i = 0; i < half; i++) bins_[i] = bins_[2 * i] + bins_[2 * i + 1];
+                std::fill(bins_.begin() + static_cast<std::ptrdiff_t>(half), bins_.end(), 0.0);
+                binWidth_ *= 2;
+            }
+
+            std::vector<double> bins_;
+            bool fixedRange_;
+            double binWidth_;
+            double overflow_; // weight above a fixed range
+    };
+
+    // Weighted first and second moments of a quantity, with its range
+    struct Moments
+    {
+        double sum{0};
+        double sumOfSquares{0};
+        float minimum{std::numeric_limits<float>::max()};
+        float maximum{std::numeric_limits<float>::lowest()};
+
+        void fill(float value, double weight) {
+            sum += weight * value;
+            sumOfSquares += weight * value * value;
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+
+        void merge(const Moments & other) {
+            sum += other.sum;
+            sumOfSquares += other.sumOfSquares;
+            minimum = std::min(minimum, other.minimum);
+            maximum = std::max(maximum, other.maximum);
+        }
+
+        double mean(double totalWeight) const { return totalWeight != 0 ? sum / totalWeight : 0; }
+        double standardDeviation(double totalWeight) const {
+            if (totalWeight == 0) return 0;
+            const double m = mean(totalWeight);
+            return std::sqrt(std::max(0.0, sumOfSquares / totalWeight - m * m));
+        }
+    };
+
+    // Everything gathered for the particles of one type
+    struct TypeStatistics
+    {
+        TypeStatistics(std::size_t energyBins, double maximumEnergy, std::size_t angleBins)
+        :   energySpectrum(energyBins, maximumEnergy),
+            angularDistribution(angleBins, 0.0)
+        {}
+
+        std::uint64_t particles{0};
+        Moments weight;       // moments of the weights themselves, unweighted
+        double totalWeight{0};
+        Moments energy;
+        Moments x, y, z;
+        Moments u, v, w;
+        Moments polarAngle;   // degrees from the Z axis
+        EnergySpectrum energySpectrum;
+        std::vector<double> angularDistribution; // weight by polar angle over [0, 180] degrees
+
+        void fill(const Particle & particle) {
+            const double particleWeight = particle.getWeight();
+            particles++;
+            weight.fill(particle.getWeight(), 1.0);
+            totalWeight += particleWeight;
+            const float kineticEnergy = particle.getKineticEnergy() / MeV;
+            energy.fill(kineticEnergy, particleWeight);
+            x.fill(particle.getX() / cm, particleWeight);
+            y.fill(particle.getY() / cm, particleWeight);
+            z.fill(particle.getZ() / cm, particleWeight);
+            u.fill(particle.getDirectionalCosineX(), particleWeight);
+            v.fill(particle.getDirectionalCosineY(), particleWeight);
+            w.fill(particle.getDirectionalCosineZ(), particleWeight);
+            const float angle = static_cast<float>(std::acos(std::clamp(static_cast<double>(particle.getDirectionalCosineZ()), -1.0, 1.0)) * 180.0 / std::numbers::pi);
+            polarAngle.fill(angle, particleWeight);
+            energySpectrum.fill(kineticEnergy, particleWeight);
+            const std::size_t angleBin = std::min(static_cast<std::size_t>(angle / 180.0f * static_cast<float>(angularDistribution.size())), angularDistribution.size() - 1);
+            angularDistribution[angleBin] += particleWeight;
+        }
+
+        void merge(TypeStatistics && other) {
+            particles += other.particles;
+            weight.merge(other.weight);
+            totalWeight += other.totalWeight;
+            energy.merge(other.energy);
+            x.merge(other.x);
+            y.merge(other.y);
+            z.merge(other.z);
+            u.merge(other.u);
+            v.merge(other.v);
+            w.merge(other.w);
+            polarAngle.merge(other.polarAngle);
+            energySpectrum.merge(std::move(other.energySpectrum));
+            for (std::size_t i = 0; i < angularDistribution.size(); i++) angularDistribution[i] += other.angularDistribution[i];
+        }
+    };
+
+    // State of a thread, the statistics of each particle type it has read
+    using PhaseSpaceStatistics = std::map<ParticleType, TypeStatistics>;
+
+    struct StatisticsConfig
+    {
+        std::size_t energyBins;
+        double maximumEnergy;
+        std::size_t angleBins;
+    };
+
+    void PrintStatistics(std::ostream & output, const std::string & label, const TypeStatistics & statistics, std::uint64_t histories)
+    {
+        const double totalWeight = statistics.totalWeight;
+        const double particles = static_cast<double>(statistics.particles);
+        output << label << "\n";
+        output << "  Particles:            " << statistics.particles << " (" << (histories > 0 ? particles / static_cast<double>(histories) : 0) << " per history)\n";
+        output << "  Weight:               total " << totalWeight << " (" << (histories > 0 ? totalWeight / static_cast<double>(histories) : 0) << " per history), "
+               << "mean " << statistics.weight.mean(particles) << " +/- " << statistics.weight.standardDeviation(particles)
+               << ", from " << statistics.weight.minimum << " to " << statistics.weight.maximum << "\n";
+        output << "  Energy (MeV):         mean " << statistics.energy.mean(totalWeight) << " +/- " << statistics.energy.standardDeviation(totalWeight)
+               << ", from " << statistics.energy.minimum << " to " << statistics.energy.maximum << "\n";
+        output << "  Position (cm):        X " << statistics.x.mean(totalWeight) << " +/- " << statistics.x.standardDeviation(totalWeight)
+               << ", Y " << statistics.y.mean(totalWeight) << " +/- " << statistics.y.standardDeviation(totalWeight)
+               << ", Z " << statistics.z.mean(totalWeight) << " +/- " << statistics.z.standardDeviation(totalWeight) << "\n";
+        output << "  Direction:            U " << statistics.u.mean(totalWeight) << ", V " << statistics.v.mean(totalWeight) << ", W " << statistics.w.mean(totalWeight)
+               << ", polar angle " << statistics.polarAngle.mean(totalWeight) << " +/- " << statistics.polarAngle.standardDeviation(totalWeight) << " degrees\n";
+    }
+
+    // Write the spectra and angular distributions of every type, each bin as weight per original history
+    void WriteDistributions(const std::string & fileName, const std::vector<std::pair<std::string, const TypeStatistics *>> & types, std::uint64_t histories)
+    {
+        std::ofstream file(fileName);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file for writing: " + fileName);
+        }
+        const double perHistory = histories > 0 ? 1.0 / static_cast<double>(histories) : 0;
+        file << std::setprecision(9);
+        file << "distribution,particle,low,high,weight_per_history\n";
+        for (const auto & [name, statistics] : types) {
+            const EnergySpectrum & spectrum = statistics->energySpectrum;
+            for (std::size_t i = 0; i < spectrum.getNumberOfBins(); i++) {
+                file << "energy," << name << "," << spectrum.getBinWidth() * static_cast<double>(i) << "," << spectrum.getBinWidth() * static_cast<double>(i + 1) << "," << spectrum.getBin(i) * perHistory << "\n";
+            }
+            if (spectrum.getOverflow() > 0) {
+                file << "energy," << name << "," << spectrum.getRange() << ",inf," << spectrum.getOverflow() * perHistory << "\n";
+            }
+        }
+        for (const auto & [name, statistics] : types) {
+            const std::vector<double> & distribution = statistics->angularDistribution;
+            const double binWidth = 180.0 / static_cast<double>(distribution.size());
+            for (std::size_t i = 0; i < distribution.size(); i++) {
+                file << "polar_angle," << name << "," << binWidth * static_cast<double>(i) << "," << binWidth * static_cast<double>(i + 1) << "," << distribution[i] * perHistory << "\n";
+            }
+        }
+        file.close();
+        if (file.fail()) {
+            throw std::runtime_error("Failed to write file: " + fileName);
+        }
+    }
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[]) {
+
+    // Initial setup
+    using namespace ParticleZoo;
+    int errorCode = 0;
+
+    // Custom command line arguments
+    const CLICommand THREADS_COMMAND = CLICommand(NONE, "t", "threads", "Number of threads reading in parallel, each its share of the histories (default: number of hardware threads)", { CLI_UINT });
+    const CLICommand ENERGY_BINS_COMMAND = CLICommand(NONE, "", "energyBins", "Number of bins of the energy spectra, rounded up to an even number (default: 100)", { CLI_UINT });
+    const CLICommand MAX_ENERGY_COMMAND = CLICommand(NONE, "", "maxEnergy", "Upper end of the energy spectra in MeV (default: found from the particles)", { CLI_FLOAT });
+    const CLICommand ANGLE_BINS_COMMAND = CLICommand(NONE, "", "angleBins", "Number of bins of the polar angle distributions over 0 to 180 degrees (default: 90)", { CLI_UINT });
+    const CLICommand OUTPUT_COMMAND = CLICommand(NONE, "o", "output", "CSV file to write the energy spectra and polar angle distributions of each particle type to", { CLI_STRING });
+    ArgParser::RegisterCommand(THREADS_COMMAND);
+    ArgParser::RegisterCommand(ThreadPlacementCommand);
+    ArgParser::RegisterCommand(ENERGY_BINS_COMMAND);
+    ArgParser::RegisterCommand(MAX_ENERGY_COMMAND);
+    ArgParser::RegisterCommand(ANGLE_BINS_COMMAND);
+    ArgParser::RegisterCommand(OUTPUT_COMMAND);
+
+    // Define usage message and parse command line arguments
+    std::string usageMessage = "Usage: PHSPStats [OPTIONS] <inputfile>\n"
+                            "\n"
+                            "Summarize the particles of a phase space file by particle type: counts and weights, energy, position and\n"
+                            "direction moments, energy spectra and polar angle distributions. The file is read on several threads, each\n"
+                            "reading whole histories, and the per history figures are normalized by the original histories of the file,\n"
+                            "empty histories included.\n"
+                            "Energy spectra start at zero and, unless --maxEnergy is given, their range is doubled from 1 keV until it\n"
+                            "holds the largest energy, so the same file always gives the same bins.\n"
+                            "\n"
+                            "Required Arguments:\n"
+                            "  <inputfile>               Input phase space file, or a set of files (.pzset)\n"
+                            "\n"
+                            "Examples:\n"
+                            "  PHSPStats input.egsphsp\n"
+                            "  PHSPStats --threads 8 --output spectra.csv input.IAEAphsp\n"
+                            "  PHSPStats --energyBins 200 --maxEnergy 6 --output spectra.csv input.IAEAphsp\n"
+                            "  PHSPStats --formats";
+    auto userOptions = ArgParser::ParseArgs(argc, argv, usageMessage, 1);
+
+    // Validate parameters
+    std::vector<CLIValue> positionals = userOptions.contains(CLI_POSITIONALS) ? userOptions.at(CLI_POSITIONALS) : std::vector<CLIValue>{ "" };
+    std::string inputFile = std::get<std::string>(positionals[0]);
+    std::string outputFile = userOptions.contains(OUTPUT_COMMAND) ? userOptions.extractStringOption(OUTPUT_COMMAND) : "";
+    bool profile = userOptions.contains(ProfileCommand);
+
+    if (inputFile.empty()) {
+        std::cerr << "Error: No input file specified\n";
+        errorCode = 1;
+        return errorCode;
+    }
+
+    // Start timer
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    try {
+        const std::size_t numberOfThreads = userOptions.contains(THREADS_COMMAND) ? userOptions.extractUIntOption(THREADS_COMMAND) : std::max(1u, std::thread::hardware_concurrency());
+        StatisticsConfig config;
+        config.energyBins = userOptions.extractUIntOption(ENERGY_BINS_COMMAND, 100);
+        config.maximumEnergy = userOptions.extractFloatOption(MAX_ENERGY_COMMAND, 0.0f);
+        config.angleBins = userOptions.extractUIntOption(ANGLE_BINS_COMMAND, 90);
+        if (numberOfThreads < 1) throw std::runtime_error("The number of threads must be at least 1.");
+        if (config.energyBins < 1 || config.angleBins < 1) throw std::runtime_error("The number of bins must be at least 1.");
+        if (userOptions.contains(MAX_ENERGY_COMMAND) && !(config.maximumEnergy > 0)) throw std::runtime_error("The maximum energy must be positive.");
+
+        HistoryBalancedParallelReader reader(inputFile, userOptions, numberOfThreads);
+        std::cout << "Reading " << inputFile << " on " << numberOfThreads << " thread" << (numberOfThreads > 1 ? "s" : "") << "..." << std::endl;
+
+        Progress<std::uint64_t> progress(reader.getNumberOfParticles());
+        progress.Start("Reading particles:");
+        ParallelAnalysisOptions options;
+        options.progress = [&progress](std::uint64_t particles, std::uint64_t histories) {
+            progress.Update(particles, "Processed " + std::to_string(histories) + " histories.");
+        };
+
+        auto makeStatistics = [](std::size_t) { return PhaseSpaceStatistics{}; };
+        auto countParticle = [&config](PhaseSpaceStatistics & statistics, const Particle & particle) {
+            if (particle.getType() == ParticleType::PseudoParticle) return;
+            auto entry = statistics.find(particle.getType());
+            if (entry == statistics.end()) {
+                entry = statistics.emplace(particle.getType(), TypeStatistics(config.energyBins, config.maximumEnergy, config.angleBins)).first;
+            }
+            entry->second.fill(particle);
+        };
+        auto mergeStatistics = [](PhaseSpaceStatistics & statistics, PhaseSpaceStatistics && otherStatistics) {
+            for (auto & [type, typeStatistics] : otherStatistics) {
+                auto entry = statistics.find(type);
+                if (entry == statistics.end()) {
+                    statistics.emplace(type, std::move(typeStatistics));
+                } else {
+                    entry->second.merge(std::move(typeStatistics));
+                }
+            }
+        };
+        const auto reduction = ParallelReduce(reader, makeStatistics, countParticle, mergeStatistics, options);
+        progress.Complete("Done. Processed " + std::to_string(reduction.historiesRead) + " histories.");
+        reader.close();
+
+        // The statistics of all of the particles together, in the same order whatever the number of threads
+        TypeStatistics allParticles(config.energyBins, config.maximumEnergy, config.angleBins);
+        std::vector<std::pair<std::string, const TypeStatistics *>> types;
+        for (const auto & [type, typeStatistics] : reduction.state) {
+            TypeStatistics copy = typeStatistics;
+            allParticles.merge(std::move(copy));
+            types.emplace_back(std::string(getParticleTypeName(type)), &typeStatistics);
+        }
+        types.emplace_back("All", &allParticles);
+
+        std::cout << "\nPhase space: " << inputFile << "\n";
+        std::cout << "  Particles read:       " << reduction.particlesRead << "\n";
+        std::cout << "  Original histories:   " << reduction.historiesRead << "\n\n";
+        for (const auto & [name, statistics] : types) {
+            PrintStatistics(std::cout, name, *statistics, reduction.historiesRead);
+        }
+
+        if (!outputFile.empty()) {
+            WriteDistributions(outputFile, types, reduction.historiesRead);
+            std::cout << "\nDistributions written to " << outputFile << "\n";
+        }
+
+        if (profile) {
+            for (std::size_t i = 0; i < reduction.readProfiles.size(); i++) {
+                PrintIOProfile(std::cout, "Read on thread " + std::to_string(i), reduction.readProfiles[i]);
+            }
+        }
+
+        // End timer and print elapsed time
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsedSeconds = endTime - startTime;
+        std::cout << "\nStatistics completed in " << elapsedSeconds.count() << " seconds\n";
+
+    } catch (const std::exception & e) {
+        std::cerr << std::endl << "Error occurred: " << e.what() << std::endl;
+        errorCode = 1;
+    }
+
+    // Return appropriate error code
+    return errorCode;
+}
@@ -35,6 +35,11 @@ if /I "%~1"=="install" (
     shift
     goto :parse_args
 )
+if /I "%~1"=="benchmark" (
+    set DO_BENCHMARK=1
+    shift
+    goto :parse_args
+)
 if /I "%~1"=="-j" (
     set "JOBS=%~2"
     shift
@@ -175,14 +180,36 @@ if "%USE_ROOT%"=="1" (
 REM Common source files
 set COMMON_SRCS=src\PhaseSpaceFileReader.cc ^
 src\PhaseSpaceFileWriter.cc ^
+src\PhaseSpaceSet.cc ^
+src\HistoryReplayer.cc ^
+src\HistorySampler.cc ^
 src\utilities\formats.cc ^
+src\utilities\transcoders.cc ^
 src\utilities\argParse.cc ^
+src\utilities\memoryMap.cc ^
+src\utilities\sharedFileCache.cc ^
+src\utilities\prefetch.cc ^
+src\utilities\backgroundFlush.cc ^
+src\utilities\historyIndex.cc ^
+src\utilities\spatialIndex.cc ^
+src\utilities\threadAffinity.cc ^
+src\utilities\compression.cc ^
+src\utilities\inputFileStream.cc ^
+src\utilities\outputFileStream.cc ^
+src\parallel\ParticleBalancedParallelReader.cc ^
+src\parallel\HistoryBalancedParallelReader.cc ^
+src\parallel\HistoryPartition.cc ^
+src\parallel\ChunkedParallelReader.cc ^
+src\parallel\ThreadPlacement.cc ^
+src\parallel\ConcurrentPhaseSpaceWriter.cc ^
+src\parallel\ShardedParallelWriter.cc ^
 src\egs\egsphspFile.cc ^
 src\peneasy\penEasyphspFile.cc ^
 src\IAEA\IAEAHeader.cc ^
 src\IAEA\IAEAphspFile.cc ^
 src\topas\TOPASHeader.cc ^
-src\topas\TOPASphspFile.cc
+src\topas\TOPASphspFile.cc ^
+src\pz\PZphspFile.cc
 
 REM Add ROOT sources if ROOT is enabled
 if "%USE_ROOT%"=="1" (
@@ -237,6 +264,25 @@ echo Building PHSPSplit.exe ...
 cl.exe %CFLAGS% /Fo"%OBJDIR%\\" %INCLUDES% /c PHSPSplit.cc || goto :build_fail
 link.exe /OUT:"%OUTDIR%\PHSPSplit.exe" !OBJ_LIST! %OBJDIR%\PHSPSplit.obj %ROOT_LIBS% || goto :build_fail
 
+echo Building PHSPIndex.exe ...
+cl.exe %CFLAGS% /Fo"%OBJDIR%\\" %INCLUDES% /c PHSPIndex.cc || goto :build_fail
+link.exe /OUT:"%OUTDIR%\PHSPIndex.exe" !OBJ_LIST! %OBJDIR%\PHSPIndex.obj %ROOT_LIBS% || goto :build_fail
+
+echo Building PHSPSort.exe ...
+cl.exe %CFLAGS% /Fo"%OBJDIR%\\" %INCLUDES% /c PHSPSort.cc || goto :build_fail
+link.exe /OUT:"%OUTDIR%\PHSPSort.exe" !OBJ_LIST! %OBJDIR%\PHSPSort.obj %ROOT_LIBS% || goto :build_fail
+
+echo Building PHSPStats.exe ...
+cl.exe %CFLAGS% /Fo"%OBJDIR%\\" %INCLUDES% /c PHSPStats.cc || goto :build_fail
+link.exe /OUT:"%OUTDIR%\PHSPStats.exe" !OBJ_LIST! %OBJDIR%\PHSPStats.obj %ROOT_LIBS% || goto :build_fail
+
+REM Build the benchmarks if requested
+if defined DO_BENCHMARK (
+    echo Building PHSPBenchmark.exe ...
+    cl.exe %CFLAGS% /Fo"%OBJDIR%\\" %INCLUDES% /c PHSPBenchmark.cc || goto :build_fail
+    link.exe /OUT:"%OUTDIR%\PHSPBenchmark.exe" !OBJ_LIST! %OBJDIR%\PHSPBenchmark.obj %ROOT_LIBS% || goto :build_fail
+)
+
 REM Build dynamic library
 if not exist "%OUTDIR%\bin" mkdir "%OUTDIR%\bin"
 echo Building dynamic library particlezoo.dll ...
@@ -248,6 +294,12 @@ echo Build successful.
 echo Artifacts in %OUTDIR%
 goto :post_build
 
+REM Run the benchmarks if requested, options are passed with the BENCHMARK_ARGS environment variable
+if defined DO_BENCHMARK (
+    echo Running benchmarks...
+    "%OUTDIR%\PHSPBenchmark.exe" %BENCHMARK_ARGS% || exit /b 1
+)
+
 :build_fail
 echo Build failed.
 exit /b 1
@@ -272,6 +324,9 @@ if defined DO_INSTALL (
     copy /Y "%OUTDIR%\PHSPCombine.exe" "%PREFIX%\bin\" >nul
     copy /Y "%OUTDIR%\PHSPImage.exe" "%PREFIX%\bin\" >nul
     copy /Y "%OUTDIR%\PHSPSplit.exe" "%PREFIX%\bin\" >nul
+    copy /Y "%OUTDIR%\PHSPIndex.exe" "%PREFIX%\bin\" >nul
+    copy /Y "%OUTDIR%\PHSPSort.exe" "%PREFIX%\bin\" >nul
+    copy /Y "%OUTDIR%\PHSPStats.exe" "%PREFIX%\bin\" >nul
 	copy /Y "%OUTDIR%\bin\particlezoo.dll" "%PREFIX%\bin\" >nul
     copy /Y "%OUTDIR%\%LIB_NAME%" "%PREFIX%\lib\" >nul
     xcopy /E /I /Y "include\particlezoo" "%PREFIX%\include\particlezoo" >nul
@@ -30,13 +30,160 @@
 #include "G4GlobalConfig.hh"
 #include "G4Event.hh"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <thread>
+
 namespace ParticleZoo
 {
 
     //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+    /**
+     * @brief Queue of the whole histories of one worker thread, read ahead of the event loop.
+     * 
+     * The particles are read in batches through the batch reading of the parallel reader and
+     * split into histories at their new history flags. With a prefetch depth the batches are
+     * read on a helper thread, which sleeps once the queue holds that many histories and wakes
+     * to refill it once half of them have been used. Without one they are read on the worker
+     * thread when the queue is empty. Errors of the helper thread are rethrown on the worker
+     * thread once the histories read before them have been used.
+     */
+    class G4PHSPSourceAction::HistoryQueue
+    {
+        public:
+            HistoryQueue(const ParallelReader & parallelReader, std::size_t threadIndex, std::size_t prefetchDepth)
+            : parallelReader(parallelReader),
+              threadIndex(threadIndex),
+              prefetchDepth(prefetchDepth),
+              particles(PARTICLES_PER_BATCH),
+              exhausted(false),
+              stopping(false)
+            {
+                if (prefetchDepth > 0) helper = std::thread(&HistoryQueue::Prefetch, this);
+            }
+
+            ~HistoryQueue()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                roomAvailable.notify_one();
+                if (helper.joinable()) helper.join();
+            }
+
+            // Take the next history, false once this thread has no more histories
+            bool Pop(std::vector<Particle> & history)
+            {
+                if (prefetchDepth == 0) {
+                    while (histories.empty() && !exhausted) exhausted = ReadBatch(histories);
+                    if (histories.empty()) return false;
+                    history = std::move(histories.front());
+                    histories.pop_front();
+                    return true;
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+                historiesAvailable.wait(lock, [this] { return !histories.empty() || exhausted; });
+                if (histories.empty()) {
+                    if (error) std::rethrow_exception(error);
+                    return false;
+                }
+                history = std::move(histories.front());
+                histories.pop_front();
+                const bool refill = histories.size() <= prefetchDepth / 2;
+                lock.unlock();
+                if (refill) roomAvailable.notify_one();
+                return true;
+            }
+
+        private:
+            static constexpr std::size_t PARTICLES_PER_BATCH = 4096;
+
+            // Body of the helper thread, keeping the queue filled until the histories run out
+            void Prefetch()
+            {
+                try {
+                    std::deque<std::vector<Particle>> batch;
+                    for (;;) {
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            if (histories.size() >= prefetchDepth) {
+                                roomAvailable.wait(lock, [this] { return stopping || histories.size() <= prefetchDepth / 2; });
+                            }
+                            if (stopping) return;
+                        }
+                        const bool finished = ReadBatch(batch);
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            for (auto & history : batch) histories.push_back(std::move(history));
+                            exhausted = finished;
+                        }
+                        batch.clear();
+                        historiesAvailable.notify_one();
+                        if (finished) return;
+                    }
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        error = std::current_exception();
+                        exhausted = true;
+                    }
+                    historiesAvailable.notify_one();
+                }
+            }
+
+            // Read batches of particles until at least one history is complete, true once there are no more
+            bool ReadBatch(std::deque<std::vector<Particle>> & completeHistories)
+            {
+                for (;;) {
+                    const std::size_t count = std::visit([this](const auto & reader) {
+                        return reader->readParticles(threadIndex, std::span<Particle>(particles));
+                    }, parallelReader);
+                    if (count == 0) {
+                        if (!partialHistory.empty()) completeHistories.push_back(std::move(partialHistory));
+                        partialHistory.clear();
+                        return true;
+                    }
+                    for (std::size_t i = 0; i < count; i++) {
+                        if (particles[i].isNewHistory() && !partialHistory.empty()) {
+                            completeHistories.push_back(std::move(partialHistory));
+                            partialHistory.clear();
+                        }
+                        partialHistory.push_back(std::move(particles[i]));
+                    }
+                    if (!completeHistories.empty()) return false;
+                }
+            }
+
+            const ParallelReader parallelReader;
+            const std::size_t threadIndex;
+            const std::size_t prefetchDepth;
+
+            // Used only by the thread reading the particles
+            std::vector<Particle> particles;
+            std::vector<Particle> partialHistory;
+
+            // Shared between the helper thread and the worker thread
+            std::mutex mutex;
+            std::condition_variable historiesAvailable;
+            std::condition_variable roomAvailable;
+            std::deque<std::vector<Particle>> histories;
+            bool exhausted;
+            bool stopping;
+            std::exception_ptr error;
+            std::thread helper;
+    };
+
+    //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
     G4PHSPSourceAction::G4PHSPSourceAction(std::shared_ptr<ParticleZoo::ParticleBalancedParallelReader> parallelReader, std::size_t threadIndex)
     : parallelReader(parallelReader),
+      prefetchDepth(DEFAULT_PREFETCH_DEPTH),
       threadIndex(threadIndex),
       applyTranslation(false),
       globalTranslation(G4ThreeVector(0,0,0)),
@@ -46,8 +193,30 @@ namespace ParticleZoo
       rotationCenter(G4ThreeVector(0,0,0)),
       recycleNumber(0),
       recycleWeightFactor(1.0),
-      historiesToWait(0),
-      historiesWaited(0)
+      historyRecycleNumber(0),
+      historyUsesLeft(0),
+      emptyEventsLeft(0)
+    {
+        G4cout << "ParticleZoo::G4PHSPSourceAction: Initialized for thread index " << threadIndex << G4endl;
+    }
+
+    //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+    G4PHSPSourceAction::G4PHSPSourceAction(std::shared_ptr<ParticleZoo::ChunkedParallelReader> parallelReader, std::size_t threadIndex)
+    : parallelReader(parallelReader),
+      prefetchDepth(DEFAULT_PREFETCH_DEPTH),
+      threadIndex(threadIndex),
+      applyTranslation(false),
+      globalTranslation(G4ThreeVector(0,0,0)),
+      applyRotation(false),
+      globalRotation(),
+      applyCenterOfRotation(false),
+      rotationCenter(G4ThreeVector(0,0,0)),
+      recycleNumber(0),
+      recycleWeightFactor(1.0),
+      historyRecycleNumber(0),
+      historyUsesLeft(0),
+      emptyEventsLeft(0)
     {
         G4cout << "ParticleZoo::G4PHSPSourceAction: Initialized for thread index " << threadIndex << G4endl;
     }
@@ -56,6 +225,8 @@ namespace ParticleZoo
 
     G4PHSPSourceAction::~G4PHSPSourceAction()
     {
+        // Stop the helper thread before the reader it uses can be released
+        historyQueue.reset();
         // Note: parallelReader is shared and will be closed when the last reference is released
     }
 
@@ -64,121 +235,115 @@ namespace ParticleZoo
     void G4PHSPSourceAction::GeneratePrimaries(G4Event* anEvent)
     {
         // Ensure the reader is valid
-        if (!parallelReader) return;
+        if (std::visit([](const auto & reader) { return !reader; }, parallelReader)) return;
 
-        // Handle incremental histories
-        if (historiesToWait > 0 && historiesWaited < historiesToWait) {
-            historiesWaited++;
-            return;
+        // Start reading ahead on the first event, once the settings are final
+        if (!historyQueue) {
+            historyQueue = std::make_unique<HistoryQueue>(parallelReader, threadIndex, prefetchDepth);
         }
 
-        // Check if there are more particles available for this thread
-        bool hasMoreParticles = parallelReader->hasMoreParticles(threadIndex);
+        // Leave the events of the empty histories before the current history without primaries
+        if (emptyEventsLeft > 0) {
+            emptyEventsLeft--;
+            return;
+        }
 
-        // Peek at the next particle to determine incremental histories
-        if (hasMoreParticles) {
-            ParticleZoo::Particle particle = parallelReader->peekNextParticle(threadIndex);
-            std::int32_t incrementalHistories = particle.getIncrementalHistories();
-            if (incrementalHistories > historiesToWait + 1) {
-                historiesToWait = incrementalHistories - 1;
-                historiesWaited = 0;
+        // Take the next history once the current one has been used in all of its events
+        if (historyUsesLeft == 0) {
+            if (!historyQueue->Pop(currentHistory)) {
+                // No more particles available - warn only once
+                thread_local static bool warned = false;
+                if (!warned) {
+                    G4cout << "No more particles available in phase space file for thread index " << threadIndex << G4endl;
+                    warned = true;
+                }
                 return;
-            } else {
-                historiesToWait = 0;
-                historiesWaited = 0;
+            }
+            historyUsesLeft = historyRecycleNumber + 1;
+
+            // An incremental history number of n means n - 1 empty histories came before this one, each used as often as the others
+            const std::int32_t incrementalHistories = currentHistory.front().getIncrementalHistories();
+            if (incrementalHistories > 1) {
+                emptyEventsLeft = static_cast<std::uint64_t>(incrementalHistories - 1) * historyUsesLeft - 1;
+                return; // this event is the first of the empty ones
             }
         }
 
-        // Generate primary vertices if particles are available
-        if (hasMoreParticles) {
-
-            // Lambda to read the next particle and create a G4PrimaryVertex
-            auto ReadNextVertex = [this](const ParticleZoo::Particle & particle, float weightFactor = 1.0) -> G4PrimaryVertex* {
-                // Define some unit conversions
-                constexpr G4double energyUnit = CLHEP::MeV / ParticleZoo::MeV;
-                constexpr G4double lengthUnit = CLHEP::cm / ParticleZoo::cm;
-
-                // Get particle properties
-                G4int pdgCode = static_cast<G4int>(particle.getPDGCode());
-                G4double kineticEnergy = static_cast<G4double>(particle.getKineticEnergy()) * energyUnit;
-                G4double weight = static_cast<G4double>(particle.getWeight()) * weightFactor;
-
-                G4double particleX = static_cast<G4double>(particle.getX()) * lengthUnit;
-                G4double particleY = static_cast<G4double>(particle.getY()) * lengthUnit;
-                G4double particleZ = static_cast<G4double>(particle.getZ()) * lengthUnit;
-
-                G4double directionX = static_cast<G4double>(particle.getDirectionalCosineX());
-                G4double directionY = static_cast<G4double>(particle.getDirectionalCosineY());
-                G4double directionZ = static_cast<G4double>(particle.getDirectionalCosineZ());
-
-                G4ThreeVector position(particleX, particleY, particleZ);
-
-                // Apply global rotation
-                if (applyRotation) {
-                    G4ThreeVector dir(directionX, directionY, directionZ);
-                    if (applyCenterOfRotation) {
-                        // Translate to rotation center
-                        position -= rotationCenter;
-                        // Rotate position and direction
-                        position = globalRotation * position;
-                        dir = globalRotation * dir;
-                        // Translate back
-                        position += rotationCenter;
-                    } else {
-                        // Rotate position and direction directly
-                        position = globalRotation * position;
-                        dir = globalRotation * dir;
-                    }
-                    directionX = dir.x();
-                    directionY = dir.y();
-                    directionZ = dir.z();
-                }
+        // Generate primary vertices for the particles of the current history
+        for (const Particle & particle : currentHistory) {
+            // If recycling is requested, create multiple vertices
+            for (std::uint32_t r = 0; r <= recycleNumber; r++) {
+                anEvent->AddPrimaryVertex(MakeVertex(particle, recycleWeightFactor));
+            }
+        }
+        historyUsesLeft--;
+    }
 
-                // Apply global translation
-                if (applyTranslation) {
-                   position += globalTranslation;
-                }
+    //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-                // Create primary vertex and particle
-                G4PrimaryVertex* vertex = new G4PrimaryVertex(position, 0.0);
-                G4PrimaryParticle* primary = new G4PrimaryParticle(pdgCode,
-                                                                    directionX,
-                                                                    directionY,
-                                                                    directionZ);
-
-                // Set kinetic energy and weight
-                primary->SetKineticEnergy(kineticEnergy);
-                primary->SetWeight(weight);
-
-                // Set the primary particle to the vertex
-                vertex->SetPrimary(primary);
-
-                // Return the created vertex
-                return vertex;
-            };
-
-           do {
-                // Read the next particle from the phase space file
-                Particle particle = parallelReader->getNextParticle(threadIndex);
-                // If recycling is requested, create multiple vertices
-                for (std::uint32_t r = 0; r <= recycleNumber; r++) {
-                    // Create primary vertex and particle
-                    G4PrimaryVertex* vertex = ReadNextVertex(particle, recycleWeightFactor);
-                    // Add the primary vertex to the event
-                    anEvent->AddPrimaryVertex(vertex);
-                }
-            } while (parallelReader->hasMoreParticles(threadIndex) && !parallelReader->peekNextParticle(threadIndex).isNewHistory());
+    G4PrimaryVertex* G4PHSPSourceAction::MakeVertex(const ParticleZoo::Particle & particle, G4double weightFactor) const
+    {
+        // Define some unit conversions
+        constexpr G4double energyUnit = CLHEP::MeV / ParticleZoo::MeV;
+        constexpr G4double lengthUnit = CLHEP::cm / ParticleZoo::cm;
+
+        // Get particle properties
+        G4int pdgCode = static_cast<G4int>(particle.getPDGCode());
+        G4double kineticEnergy = static_cast<G4double>(particle.getKineticEnergy()) * energyUnit;
+        G4double weight = static_cast<G4double>(particle.getWeight()) * weightFactor;
 
-        } else {
+        G4double particleX = static_cast<G4double>(particle.getX()) * lengthUnit;
+        G4double particleY = static_cast<G4double>(particle.getY()) * lengthUnit;
+        G4double particleZ = static_cast<G4double>(particle.getZ()) * lengthUnit;
 
-            // No more particles available - warn only once
-            thread_local static bool warned = false;
-            if (!warned) {
-                G4cout << "No more particles available in phase space file for thread index " << threadIndex << G4endl;
-                warned = true;
+        G4double directionX = static_cast<G4double>(particle.getDirectionalCosineX());
+        G4double directionY = static_cast<G4double>(particle.getDirectionalCosineY());
+        G4double directionZ = static_cast<G4double>(particle.getDirectionalCosineZ());
+
+        G4ThreeVector position(particleX, particleY, particleZ);
+
+        // Apply global rotation
+        if (applyRotation) {
+            G4ThreeVector dir(directionX, directionY, directionZ);
+            if (applyCenterOfRotation) {
+                // Translate to rotation center
+                position -= rotationCenter;
+                // Rotate position and direction
+                position = globalRotation * position;
+                dir = globalRotation * dir;
+                // Translate back
+                position += rotationCenter;
+            } else {
+                // Rotate position and direction directly
+                position = globalRotation * position;
+                dir = globalRotation * dir;
             }
+            directionX = dir.x();
+            directionY = dir.y();
+            directionZ = dir.z();
+        }
 
+        // Apply global translation
+        if (applyTranslation) {
+           position += globalTranslation;
         }
+
+        // Create primary vertex and particle
+        G4PrimaryVertex* vertex = new G4PrimaryVertex(position, 0.0);
+        G4PrimaryParticle* primary = new G4PrimaryParticle(pdgCode,
+                                                            directionX,
+                                                            directionY,
+                                                            directionZ);
+
+        // Set kinetic energy and weight
+        primary->SetKineticEnergy(kineticEnergy);
+        primary->SetWeight(weight);
+
+        // Set the primary particle to the vertex
+        vertex->SetPrimary(primary);
+
+        // Return the created vertex
+        return vertex;
     }
 
-} // namespace ParticleZoo
\ No newline at end of file
+} // namespace ParticleZoo
@@ -34,7 +34,10 @@
 
 #include <memory>
 #include <string>
+#include <variant>
+#include <vector>
 #include <particlezoo/parallel/ParticleBalancedParallelReader.h>
+#include <particlezoo/parallel/ChunkedParallelReader.h>
 
 namespace ParticleZoo
 {
@@ -48,8 +51,13 @@ namespace ParticleZoo
      * 
      * Features:
      * - Handles incremental histories
-     * - Supports multithreading via shared ParticleBalancedParallelReader
+     * - Supports multithreading via a shared ParticleBalancedParallelReader, or a shared
+     *   ChunkedParallelReader when the cost of transporting histories varies enough that
+     *   fixed partitions leave some worker threads idle
      * - Particles can be recycled multiple times with adjusted weights
+     * - Histories can be replayed in several consecutive events without reading them again
+     * - Whole histories are read in batches ahead of the event loop on a helper thread, so that
+     *   worker threads do not wait on phase space I/O
      * 
      * Usage:
      * 1. In your ActionInitialization class constructor (master thread), create a shared
@@ -58,6 +66,11 @@ namespace ParticleZoo
      *    auto reader = std::make_shared<ParticleZoo::ParticleBalancedParallelReader>(
      *        "path/to/phasespace.phsp", numberOfThreads);
      *    @endcode
+     *    or, to have worker threads claim chunks of histories as they go:
+     *    @code
+     *    auto reader = std::make_shared<ParticleZoo::ChunkedParallelReader>(
+     *        "path/to/phasespace.phsp", ParticleZoo::UserOptions{}, numberOfThreads, historiesPerChunk);
+     *    @endcode
      * 
      * 2. Store the shared reader as a member variable in your ActionInitialization class
      *    so it persists for the lifetime of the application.
@@ -75,6 +88,8 @@ namespace ParticleZoo
      *    auto action = new G4PHSPSourceAction(parallelReader, threadIndex);
      *    action->SetTranslation(G4ThreeVector(0, 0, -10*cm));
      *    action->SetRecycleNumber(5);
+     *    action->SetHistoryRecycleNumber(9);  // use each history in 10 consecutive events
+     *    action->SetPrefetchDepth(4096);      // keep 4096 histories read ahead
      *    SetUserAction(action);
      *    @endcode
      * 
@@ -102,6 +117,14 @@ namespace ParticleZoo
              * @param threadIndex Index of the worker thread (0-based).
              */
             G4PHSPSourceAction(std::shared_ptr<ParticleZoo::ParticleBalancedParallelReader> parallelReader, std::size_t threadIndex = 0);
+
+            /**
+             * @brief Constructor.
+             * @param parallelReader Shared pointer to a ChunkedParallelReader created in the master thread.
+             *                       The reader must be configured with the appropriate number of threads.
+             * @param threadIndex Index of the worker thread (0-based).
+             */
+            G4PHSPSourceAction(std::shared_ptr<ParticleZoo::ChunkedParallelReader> parallelReader, std::size_t threadIndex = 0);
             ~G4PHSPSourceAction() override;
 
             /**
@@ -135,9 +158,42 @@ namespace ParticleZoo
              */
             void SetRecycleNumber(std::uint32_t n);
 
+            /**
+             * @brief Set the number of times to replay each history, each time in an event of its own.
+             * 
+             * A history is kept once it has been used and is replayed unchanged in the next n events
+             * instead of being read again. Weights are left as they are since each replay is an event
+             * of its own, and the empty events of empty histories are repeated as well, so that the
+             * number of events stays proportional to the number of original histories.
+             * @param n Number of times to replay each history.
+             */
+            void SetHistoryRecycleNumber(std::uint32_t n);
+
+            /**
+             * @brief Set the number of histories to keep read ahead of the event loop.
+             * 
+             * The histories are read in batches on a helper thread of this worker, which refills them
+             * once half have been used. With 0 the histories are read on the worker thread as they are
+             * needed. Has no effect once the first event has been generated.
+             * @param histories Number of histories to keep read ahead (default: DEFAULT_PREFETCH_DEPTH).
+             */
+            void SetPrefetchDepth(std::size_t histories);
+
+            static constexpr std::size_t DEFAULT_PREFETCH_DEPTH = 1024;
+
         private:
-            // Shared parallel phase space file reader
-            std::shared_ptr<ParticleZoo::ParticleBalancedParallelReader> parallelReader;
+            // Shared parallel phase space file reader, either kind provides the same per-thread interface
+            using ParallelReader = std::variant<std::shared_ptr<ParticleZoo::ParticleBalancedParallelReader>,
+                                                std::shared_ptr<ParticleZoo::ChunkedParallelReader>>;
+            ParallelReader parallelReader;
+
+            // Histories of this thread read ahead of the event loop, defined in the source file
+            class HistoryQueue;
+            std::unique_ptr<HistoryQueue> historyQueue;
+            std::size_t prefetchDepth;
+
+            // Build the primary vertex of a particle, placed by the global rotation and translation
+            G4PrimaryVertex* MakeVertex(const ParticleZoo::Particle & particle, G4double weightFactor) const;
 
             // Thread index for this worker (0-based, aligned with Geant4 worker thread IDs)
             std::size_t threadIndex;
@@ -155,10 +211,14 @@ namespace ParticleZoo
             // Recycling parameters
             std::uint32_t recycleNumber;
             G4double recycleWeightFactor;
+            std::uint32_t historyRecycleNumber;
+
+            // The history being used and the number of events left to use it in
+            std::vector<ParticleZoo::Particle> currentHistory;
+            std::uint32_t historyUsesLeft;
 
-            // Incremental histories handling
-            std::int32_t historiesToWait;
-            std::int32_t historiesWaited;
+            // Empty events left for the empty histories before the current history
+            std::uint64_t emptyEventsLeft;
     };
 
     //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -203,4 +263,22 @@ namespace ParticleZoo
                << recycleNumber << ", weight factor: " << recycleWeightFactor << G4endl;
     }
 
+    //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+    inline void G4PHSPSourceAction::SetHistoryRecycleNumber(std::uint32_t n)
+    {
+        historyRecycleNumber = n;
+        G4cout << "ParticleZoo::G4PHSPSourceAction: Set history recycle number to "
+               << historyRecycleNumber << ", each history is used in " << (historyRecycleNumber + 1) << " events" << G4endl;
+    }
+
+    //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+    inline void G4PHSPSourceAction::SetPrefetchDepth(std::size_t histories)
+    {
+        prefetchDepth = histories;
+        G4cout << "ParticleZoo::G4PHSPSourceAction: Set prefetch depth to "
+               << prefetchDepth << " histories" << G4endl;
+    }
+
 };  // namespace ParticleZoo
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*
+ * Example MPI program converting a phase space file with every rank of a job using ParticleZoo.
+ * Distributed as part of ParticleZoo. https://www.github.com/dobrienphd/ParticleZoo
+ *
+ * MIT License
+ *
+ * Copyright (c) 2025 Daniel O'Brien
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Each rank reads its slice of the histories of the input file on its threads and writes them to
+ * files of its own, which are then written into the output file by all of the ranks with MPI-IO,
+ * or listed in a phase space set with --set. Build the library first, then compile with the MPI
+ * compiler wrapper, for example:
+ *
+ *   mpicxx -std=c++20 -O2 -Iinclude examples/mpi/mpi_convert.cc build/gcc/release/libparticlezoo.a -lpthread -o mpi_convert
+ *   mpirun -np 4 ./mpi_convert input.IAEAphsp output.egsphsp 8
+ *
+ * adding the libraries the library was built with (zlib, zstd and so on) to the link line.
+ */
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/parallel/MPIPartitionedIO.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    using namespace ParticleZoo;
+
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    int numberOfRanks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numberOfRanks);
+
+    if (argc < 3) {
+        if (rank == 0) std::cerr << "Usage: mpirun -np <ranks> " << argv[0] << " <inputfile> <outputfile> [threadsPerRank] [--set]" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    const std::string inputFile = argv[1];
+    const std::string outputFile = argv[2];
+    const std::size_t threadsPerRank = argc > 3 ? static_cast<std::size_t>(std::strtoul(argv[3], nullptr, 10)) : 1;
+    const bool writeSet = argc > 4 && std::string(argv[4]) == "--set";
+
+    try {
+        // The partition is computed by rank 0 alone, the other ranks only open their slice
+        auto reader = CreateRankParallelReader(MPI_COMM_WORLD, inputFile, {}, threadsPerRank);
+        MPIPhaseSpaceWriter writer(MPI_COMM_WORLD, outputFile, threadsPerRank);
+
+        std::vector<std::exception_ptr> errors(threadsPerRank);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < threadsPerRank; t++) {
+            threads.emplace_back([&, t]() {
+                try {
+                    while (reader->hasMoreParticles(t)) {
+                        writer.writeParticle(t, reader->getNextParticle(t));
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread & thread : threads) thread.join();
+        for (std::exception_ptr & error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+
+        // Empty histories after the last particle of the file belong to the last thread of the last rank
+        std::uint64_t historiesRead = reader->getTotalHistoriesRead();
+        std::uint64_t totalHistoriesRead = 0;
+        MPI_Allreduce(&historiesRead, &totalHistoriesRead, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == numberOfRanks - 1 && totalHistoriesRead < reader->getNumberOfOriginalHistories()) {
+            writer.addAdditionalHistories(threadsPerRank - 1, reader->getNumberOfOriginalHistories() - totalHistoriesRead);
+        }
+        reader->close();
+
+        if (writeSet) {
+            writer.close();
+        } else {
+            writer.concatenate();
+        }
+        if (rank == 0) {
+            std::cout << "Wrote " << reader->getNumberOfParticles() << " particles of " << inputFile << " to "
+                      << (writeSet ? MPIPhaseSpaceWriter::SetFileName(outputFile) : outputFile)
+                      << " with " << numberOfRanks << " ranks of " << threadsPerRank << " threads." << std::endl;
+        }
+    } catch (const std::exception & e) {
+        std::cerr << "Rank " << rank << ": " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -4,6 +4,7 @@
 #undef BYTE_ORDER
 #endif
 
+#include <cstdint>
 #include <cstring>
 #include <stdexcept>
 #include <vector>
@@ -12,8 +13,11 @@
 #include <bit>
 #include <algorithm>
 #include <array>
+#include <limits>
 #include <istream>
 #include <ostream>
+#include <string>
+#include <string_view>
 
 namespace ParticleZoo {
 
@@ -85,6 +89,20 @@ namespace ParticleZoo {
              */
             ByteBuffer(const std::span<const byte> data, ByteOrder byteOrder = HOST_BYTE_ORDER);
 
+            /**
+             * @brief Create a read-only ByteBuffer which views existing memory without copying it.
+             * 
+             * The returned buffer reads directly from the provided memory, which must outlive the
+             * buffer (e.g. a memory-mapped file). All read operations and moveTo() behave as for an
+             * owning buffer with the same contents, but operations which would modify the data
+             * (writes, setData, appendData, compact and expand) throw.
+             * 
+             * @param data A span covering the memory to view
+             * @param byteOrder The byte order for multi-byte data types (default: HOST_BYTE_ORDER)
+             * @return ByteBuffer A read-only view of the data
+             */
+            static ByteBuffer view(std::span<const byte> data, ByteOrder byteOrder = HOST_BYTE_ORDER);
+
 
             /**
              * @brief Initialize the buffer with data from a span.
@@ -116,10 +134,11 @@ namespace ParticleZoo {
              * Does not modify the current offset.
              * 
              * @param stream The input stream to read from
+             * @param maxBytes The maximum number of bytes to read, the buffer is filled if it has less space left
              * @return std::size_t The number of bytes appended from the stream
              * @throws std::runtime_error if buffer is full or no data could be read
              */
-            std::size_t appendData(std::istream & stream);
+            std::size_t appendData(std::istream & stream, std::uint64_t maxBytes = std::numeric_limits<std::uint64_t>::max());
 
             /**
              * @brief Append data from another ByteBuffer to this buffer.
@@ -185,6 +204,37 @@ namespace ParticleZoo {
             template<typename T>
             T read();
 
+            /**
+             * @brief Read consecutive values of type T into an array with automatic byte order conversion.
+             * 
+             * Equivalent to calling read<T>() for every element, but copies all the values at once
+             * and converts their byte order in a single pass over the array. Advances the offset by
+             * sizeof(T) for every element.
+             * 
+             * @tparam T The primitive type to read (must be trivially copyable)
+             * @param values The array to fill, its size is the number of values read
+             * @throws std::runtime_error if insufficient data is available
+             */
+            template<typename T>
+            void readArray(std::span<T> values);
+
+            /**
+             * @brief Read the same field of consecutive fixed length records into an array.
+             * 
+             * Gathers the value of type T found fieldOffset bytes into each of values.size()
+             * records of recordLength bytes, the first starting at the current offset, then
+             * converts their byte order in a single pass. Lets record based formats decode a
+             * column at a time. Does not modify the current offset.
+             * 
+             * @tparam T The primitive type of the field (must be trivially copyable)
+             * @param values The array to fill, its size is the number of records
+             * @param fieldOffset The position of the field within each record in bytes
+             * @param recordLength The length of each record in bytes
+             * @throws std::runtime_error if insufficient data is available
+             */
+            template<typename T>
+            void peekColumn(std::span<T> values, std::size_t fieldOffset, std::size_t recordLength) const;
+
             /**
              * @brief Read a null-terminated string from the buffer.
              * 
@@ -220,6 +270,17 @@ namespace ParticleZoo {
              */
             std::string readLine();
 
+            /**
+             * @brief Read a line of ASCII text from the buffer without copying it.
+             * 
+             * As readLine(), but returns a view of the line within the buffer. The view is
+             * only valid until the buffer is next refilled, cleared or written to.
+             * 
+             * @return std::string_view A view of the line (without newline characters)
+             * @throws std::runtime_error if newline is not found or no data is available
+             */
+            std::string_view readLineView();
+
             /**
              * @brief Read a span of bytes from the buffer.
              * 
@@ -257,6 +318,20 @@ namespace ParticleZoo {
             template<typename T>
             void write(const T &value);
 
+            /**
+             * @brief Write an array of values of type T with automatic byte order conversion.
+             * 
+             * Equivalent to calling write<T>() for every element, but converts the byte order of
+             * all the values in a single pass over the buffer once they are copied in. Advances the
+             * offset by sizeof(T) for every element and updates the length if necessary.
+             * 
+             * @tparam T The primitive type to write (must be trivially copyable)
+             * @param values The values to write to the buffer
+             * @throws std::runtime_error if insufficient space is available
+             */
+            template<typename T>
+            void writeArray(std::span<const T> values);
+
             /**
              * @brief Write a string to the buffer.
              * 
@@ -280,6 +355,23 @@ namespace ParticleZoo {
              */
             void writeBytes(std::span<const byte> data);
 
+            /**
+             * @brief Write directly into the buffer with a function that fills it in place.
+             * 
+             * Hands the function a span of up to maxLength bytes of free space at the current
+             * offset, and advances the offset by the number of bytes the function reports
+             * having written. Lets data such as formatted text be produced straight into the
+             * buffer without an intermediate copy.
+             * 
+             * @tparam Function A callable taking std::span<byte> and returning the number of bytes written
+             * @param maxLength The most bytes the function may write
+             * @param fill The function that writes the data
+             * @return std::size_t The number of bytes written
+             * @throws std::runtime_error if insufficient space is available
+             */
+            template<typename Function>
+            std::size_t writeInPlace(std::size_t maxLength, Function && fill);
+
 
             /**
              * @brief Get the length of valid data in the buffer.
@@ -315,6 +407,14 @@ namespace ParticleZoo {
              * @return const byte* Pointer to the beginning of the buffer data
              */
             const byte* data() const;
+
+            /**
+             * @brief Check whether the buffer is a read-only view of memory it does not own.
+             * 
+             * @return true if the buffer was created with view()
+             * @return false if the buffer owns its storage
+             */
+            bool isView() const;
             
             /**
              * @brief Set the byte order for interpreting multi-byte data types.
@@ -336,6 +436,10 @@ namespace ParticleZoo {
             std::size_t offset_;        // current offset
             std::size_t length_;        // length of data written to the buffer
             ByteOrder byteOrder_;       // byte order of the data
+            const byte* view_;          // viewed memory for read-only buffers, nullptr if the buffer owns its storage
+
+            const byte* readPointer() const;
+            void        ensureWritable() const;
 
             /**
              * @brief Reorder bytes of a value to match the target byte order.
@@ -350,6 +454,28 @@ namespace ParticleZoo {
              */
             template<typename T>
             static T reorderBytes(T value, ByteOrder targetByteOrder);
+
+            /**
+             * @brief Reorder bytes of every value of an array in place to match the target byte order.
+             * 
+             * The same conversion as reorderBytes(), written as a plain loop so that the compiler
+             * can vectorize it into byte shuffles.
+             * 
+             * @tparam T The type of the values to reorder (must be trivially copyable)
+             * @param values The values to reorder
+             * @param targetByteOrder The target byte order
+             */
+            template<typename T>
+            static void reorderArrayBytes(std::span<T> values, ByteOrder targetByteOrder);
+
+            /**
+             * @brief Reverse the bytes of an unsigned integer of 2, 4 or 8 bytes.
+             * 
+             * Written with shifts and masks, which compilers turn into a single byte swap
+             * instruction, or a byte shuffle when vectorizing a loop.
+             */
+            template<typename UInt>
+            static constexpr UInt byteSwap(UInt value);
     };
 
 
@@ -358,7 +484,7 @@ namespace ParticleZoo {
 
     // Constructors
 
-    inline ByteBuffer::ByteBuffer(std::size_t bufferSize, ByteOrder byteOrder) : buffer_(bufferSize, 0), capacity_(bufferSize), offset_(0), length_(0), byteOrder_(byteOrder) {
+    inline ByteBuffer::ByteBuffer(std::size_t bufferSize, ByteOrder byteOrder) : buffer_(bufferSize, 0), capacity_(bufferSize), offset_(0), length_(0), byteOrder_(byteOrder), view_(nullptr) {
         if (bufferSize == 0) {
             throw std::runtime_error("Buffer size must be positive.");
         }
@@ -369,9 +495,18 @@ namespace ParticleZoo {
             capacity_(data.size()),
             offset_(0),
             length_(data.size()),
-            byteOrder_(byteOrder)
+            byteOrder_(byteOrder),
+            view_(nullptr)
     { }
 
+    inline ByteBuffer ByteBuffer::view(std::span<const byte> data, ByteOrder byteOrder) {
+        ByteBuffer buffer(std::span<const byte>{}, byteOrder);
+        buffer.view_ = data.data();
+        buffer.capacity_ = data.size();
+        buffer.length_ = data.size();
+        return buffer;
+    }
+
 
     // Accessors
 
@@ -379,11 +514,20 @@ namespace ParticleZoo {
     inline std::size_t ByteBuffer::remainingToRead() const { return length_ - offset_; }
     inline std::size_t ByteBuffer::remainingToWrite() const { return capacity_ - length_; }
     inline std::size_t ByteBuffer::capacity() const { return capacity_; }
-    inline const byte* ByteBuffer::data() const { return buffer_.data(); }
+    inline const byte* ByteBuffer::data() const { return readPointer(); }
+    inline bool ByteBuffer::isView() const { return view_ != nullptr; }
+    inline const byte* ByteBuffer::readPointer() const { return view_ ? view_ : buffer_.data(); }
+
+    inline void ByteBuffer::ensureWritable() const {
+        if (view_) {
+            throw std::runtime_error("Cannot modify a read-only ByteBuffer view.");
+        }
+    }
 
     // Data Operations
 
     inline std::size_t ByteBuffer::setData(std::span<const byte> data) {
+        ensureWritable();
         if (data.size() > buffer_.size()) {
             throw std::runtime_error("Data length exceeds buffer size.");
         }
@@ -394,6 +538,7 @@ namespace ParticleZoo {
     }
     
     inline std::size_t ByteBuffer::setData(std::istream & stream) {
+        ensureWritable();
         stream.read(reinterpret_cast<char*>(buffer_.data()), capacity_);
         std::streamsize rawCount = stream.gcount();
         std::size_t bytesRead = static_cast<std::size_t>(rawCount);
@@ -405,12 +550,14 @@ namespace ParticleZoo {
         return length_;
     }
     
-    inline std::size_t ByteBuffer::appendData(std::istream & stream) {
+    inline std::size_t ByteBuffer::appendData(std::istream & stream, std::uint64_t maxBytes) {
+        ensureWritable();
         std::size_t spaceLeft = capacity_ - length_;
         if (spaceLeft == 0) {
             throw std::runtime_error("Buffer is already full, cannot append more data.");
         }
-        stream.read(reinterpret_cast<char*>(buffer_.data() + length_), spaceLeft);
+        std::size_t bytesToRead = static_cast<std::size_t>(std::min<std::uint64_t>(spaceLeft, maxBytes));
+        stream.read(reinterpret_cast<char*>(buffer_.data() + length_), bytesToRead);
         std::streamsize rawCount = stream.gcount();
         std::size_t bytesRead = static_cast<std::size_t>(rawCount);
         if (bytesRead == 0) {
@@ -421,6 +568,7 @@ namespace ParticleZoo {
     }
 
     inline std::size_t ByteBuffer::appendData(ByteBuffer & src, bool ignoreOffset) {
+        ensureWritable();
         std::size_t srcOffset = ignoreOffset ? 0 : src.offset_;
         std::size_t dataSize;
         if (ignoreOffset)
@@ -430,12 +578,13 @@ namespace ParticleZoo {
         if (length_ + dataSize > capacity_) {
             throw std::runtime_error("Data length exceeds buffer capacity.");
         }
-        std::memcpy(buffer_.data() + length_, src.buffer_.data() + srcOffset, dataSize);
+        std::memcpy(buffer_.data() + length_, src.readPointer() + srcOffset, dataSize);
         length_ += dataSize;
         return dataSize;
     }
 
     inline void ByteBuffer::compact() {
+        ensureWritable();
         std::size_t remainingBytes = remainingToRead();
         if (remainingBytes > 0) {
             std::memmove(buffer_.data(), buffer_.data() + offset_, remainingBytes);
@@ -445,6 +594,7 @@ namespace ParticleZoo {
     }
 
     inline void ByteBuffer::expand() {
+        ensureWritable();
         // write zeros to the rest of the buffer
         std::size_t remainingBytes = capacity_ - length_;
         if (remainingBytes > 0) {
@@ -472,22 +622,48 @@ namespace ParticleZoo {
             throw std::runtime_error("Not enough data to read the requested type.");
         }
         T value;
-        std::memcpy(&value, buffer_.data() + offset_, sizeof(T));
+        std::memcpy(&value, readPointer() + offset_, sizeof(T));
         offset_ += sizeof(T);
         value = reorderBytes(value, byteOrder_);
         return value;
     }
 
+    template<typename T>
+    inline void ByteBuffer::readArray(std::span<T> values) {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+        if (values.size() > remainingToRead() / sizeof(T)) {
+            throw std::runtime_error("Not enough data to read the requested array.");
+        }
+        std::memcpy(values.data(), readPointer() + offset_, values.size_bytes());
+        offset_ += values.size_bytes();
+        reorderArrayBytes(values, byteOrder_);
+    }
+
+    template<typename T>
+    inline void ByteBuffer::peekColumn(std::span<T> values, std::size_t fieldOffset, std::size_t recordLength) const {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+        if (values.empty()) return;
+        if (fieldOffset + sizeof(T) > recordLength || values.size() > remainingToRead() / recordLength) {
+            throw std::runtime_error("Not enough data to read the requested column.");
+        }
+        const byte* field = readPointer() + offset_ + fieldOffset;
+        for (std::size_t i = 0; i < values.size(); i++, field += recordLength) {
+            std::memcpy(&values[i], field, sizeof(T));
+        }
+        reorderArrayBytes(values, byteOrder_);
+    }
+
     inline std::string ByteBuffer::readString() {
         std::size_t start = offset_;
-        while (offset_ < length_ && buffer_[offset_] != '\0') {
+        const byte* data = readPointer();
+        while (offset_ < length_ && data[offset_] != '\0') {
             offset_++;
         }
         if (offset_ >= length_) {
             offset_ = start; // Reset offset to start if null terminator not found
             throw std::runtime_error("Not enough data in buffer to read string.");
         }
-        std::string result(reinterpret_cast<const char*>(buffer_.data() + start), offset_ - start);
+        std::string result(reinterpret_cast<const char*>(data + start), offset_ - start);
         offset_++; // Skip the null terminator
         return result;
     }
@@ -496,38 +672,41 @@ namespace ParticleZoo {
         if (offset_ + stringLength > length_) {
             throw std::runtime_error("Not enough data in buffer to read string.");
         }
-        std::string result(reinterpret_cast<const char*>(buffer_.data() + offset_), stringLength);
+        std::string result(reinterpret_cast<const char*>(readPointer() + offset_), stringLength);
         offset_ += stringLength;
         return result;
     }
 
     inline std::string ByteBuffer::readLine() {
+        return std::string(readLineView());
+    }
+
+    inline std::string_view ByteBuffer::readLineView() {
         std::size_t unread = remainingToRead();
         if (unread == 0) {
             throw std::runtime_error("No data left in buffer to read line.");
         }
         // Search for '\n' using memchr
-        auto startPtr = reinterpret_cast<const char*>(buffer_.data() + offset_);
+        auto startPtr = reinterpret_cast<const char*>(readPointer() + offset_);
         const void* newlinePtr = std::memchr(startPtr, '\n', unread);
         if (!newlinePtr) {
             throw std::runtime_error("Not enough data in buffer to read line.");
         }
         std::size_t lineLength = static_cast<const char*>(newlinePtr) - startPtr;
+        // Advance offset past the newline
+        offset_ += lineLength + 1;
         // Exclude a trailing '\r' if present
         if (lineLength > 0 && startPtr[lineLength - 1] == '\r') {
             lineLength--;
         }
-        std::string result(startPtr, lineLength);
-        // Advance offset past the newline
-        offset_ += lineLength + 1;
-        return result;
+        return std::string_view(startPtr, lineLength);
     }
     
     inline std::span<const byte> ByteBuffer::readBytes(std::size_t len) {
         if (offset_ + len > length_) {
             throw std::runtime_error("Not enough data in buffer.");
         }
-        std::span<const byte> data(buffer_.data() + offset_, len);
+        std::span<const byte> data(readPointer() + offset_, len);
         offset_ += len;
         return data;
     }
@@ -536,7 +715,7 @@ namespace ParticleZoo {
         if (offset_ + len > length_) {
             throw std::runtime_error("Not enough data in buffer.");
         }
-        std::span<const byte> data(buffer_.data() + offset_, len);
+        std::span<const byte> data(readPointer() + offset_, len);
         return data;
     }
 
@@ -545,6 +724,7 @@ namespace ParticleZoo {
     template<typename T>
     inline void ByteBuffer::write(const T &value) {
         static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+        ensureWritable();
         if (offset_ + sizeof(T) > buffer_.size()) {
             throw std::runtime_error("Data length exceeds buffer capacity.");
         }
@@ -556,7 +736,32 @@ namespace ParticleZoo {
         }
     }
 
+    template<typename T>
+    inline void ByteBuffer::writeArray(std::span<const T> values) {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+        ensureWritable();
+        if (offset_ + values.size_bytes() > buffer_.size()) {
+            throw std::runtime_error("Data length exceeds buffer capacity.");
+        }
+        byte* destination = buffer_.data() + offset_;
+        std::memcpy(destination, values.data(), values.size_bytes());
+        if (byteOrder_ != HOST_BYTE_ORDER && sizeof(T) > 1) {
+            // convert the copy in place, the buffer may not be aligned for T so go through the bytes
+            for (std::size_t i = 0; i < values.size(); i++, destination += sizeof(T)) {
+                T value;
+                std::memcpy(&value, destination, sizeof(T));
+                value = reorderBytes(value, byteOrder_);
+                std::memcpy(destination, &value, sizeof(T));
+            }
+        }
+        offset_ += values.size_bytes();
+        if (offset_ > length_) {
+            length_ = offset_;
+        }
+    }
+
     inline void ByteBuffer::writeString(const std::string & str, bool includeNullTerminator) {
+        ensureWritable();
         std::size_t strSize = str.size();
         if (offset_ + strSize + (includeNullTerminator ? 1 : 0) > buffer_.size()) {
             throw std::runtime_error("String length exceeds buffer capacity.");
@@ -573,6 +778,7 @@ namespace ParticleZoo {
     }
 
     inline void ByteBuffer::writeBytes(const std::span<const byte> data) {
+        ensureWritable();
         std::size_t dataSize = data.size();
         if (offset_ + dataSize > buffer_.size()) {
             throw std::runtime_error("Data length exceeds buffer capacity.");
@@ -585,6 +791,24 @@ namespace ParticleZoo {
     }
 
 
+    template<typename Function>
+    inline std::size_t ByteBuffer::writeInPlace(std::size_t maxLength, Function && fill) {
+        ensureWritable();
+        if (offset_ + maxLength > buffer_.size()) {
+            throw std::runtime_error("Data length exceeds buffer capacity.");
+        }
+        const std::size_t written = fill(std::span<byte>(buffer_.data() + offset_, maxLength));
+        if (written > maxLength) {
+            throw std::runtime_error("Data length exceeds the space given to write in place.");
+        }
+        offset_ += written;
+        if (offset_ > length_) {
+            length_ = offset_;
+        }
+        return written;
+    }
+
+
     // Byte Order Management
 
     inline void ByteBuffer::setByteOrder(ByteOrder byteOrder) { byteOrder_ = byteOrder; }
@@ -594,6 +818,14 @@ namespace ParticleZoo {
     inline T ByteBuffer::reorderBytes(T v, ByteOrder target) {
         if (target == HOST_BYTE_ORDER || sizeof(T) == 1) return v;
 
+        if constexpr (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) {
+            if (target == ByteOrder::BigEndian
+            || target == ByteOrder::LittleEndian) {
+                using UInt = std::conditional_t<sizeof(T) == 2, std::uint16_t, std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>>;
+                return std::bit_cast<T>(byteSwap(std::bit_cast<UInt>(v)));
+            }
+        }
+
         auto bytes = std::bit_cast<std::array<byte, sizeof(T)>>(v);
         std::array<byte, sizeof(T)> out;
 
@@ -614,6 +846,28 @@ namespace ParticleZoo {
         return std::bit_cast<T>(out);
     }
 
+    template<typename T>
+    inline void ByteBuffer::reorderArrayBytes(std::span<T> values, ByteOrder target) {
+        if (target == HOST_BYTE_ORDER || sizeof(T) == 1) return;
+        for (T & value : values) {
+            value = reorderBytes(value, target);
+        }
+    }
+
+    template<typename UInt>
+    inline constexpr UInt ByteBuffer::byteSwap(UInt v) {
+        static_assert(std::is_unsigned<UInt>::value && (sizeof(UInt) == 2 || sizeof(UInt) == 4 || sizeof(UInt) == 8), "UInt must be an unsigned integer of 2, 4 or 8 bytes.");
+        if constexpr (sizeof(UInt) == 2) {
+            return static_cast<UInt>((v >> 8) | (v << 8));
+        } else if constexpr (sizeof(UInt) == 4) {
+            return ((v >> 24) & 0x000000FFu) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | ((v << 24) & 0xFF000000u);
+        } else {
+            v = ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+            v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+            return (v >> 32) | (v << 32);
+        }
+    }
+
     inline std::ostream& operator<<(std::ostream &os, ByteOrder byteOrder) {
         switch (byteOrder) {
             case ByteOrder::LittleEndian: os << "Little Endian"; break;
@@ -625,7 +879,7 @@ namespace ParticleZoo {
     }
 
     inline std::ostream& operator<<(std::ostream& os, const ByteBuffer &buffer) {
-        os.write(reinterpret_cast<const char*>(buffer.buffer_.data()), buffer.length_);
+        os.write(reinterpret_cast<const char*>(buffer.readPointer()), buffer.length_);
         return os;
     }
 
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "particlezoo/Particle.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Stage emitting each history of a phase space several times from memory.
+     *
+     * Variance reduction often uses each history of a phase space more than once, splitting its
+     * particles into copies with a share of the weight, or rotating them about the beam axis when
+     * the beam is cylindrically symmetric. A HistoryReplayer reads each history once from a
+     * PhaseSpaceFileReader, from the share of one thread of a parallel reader, or from any other
+     * source of particles, and emits it the given number of times before reading the next, so the
+     * copies after the first come from memory rather than from the file.
+     *
+     * With rotation enabled, each copy is rotated about an axis parallel to the Z axis by an
+     * angle drawn from a random number generator seeded with the seed and the thread index. The
+     * angles of the copies of a history are spread evenly around the axis from a random start,
+     * 2 pi (u + j) / K for copy j of K. The same seed and thread index always give the same angles,
+     * and every thread of a parallel reader draws its own sequence. Positions and directional
+     * cosines are rotated, other properties are left as they are.
+     *
+     * The histories are accounted for in one of two ways, reflected in the incremental history
+     * numbers of the particles (see Particle::getIncrementalHistories()):
+     *  - With the weights divided (the default), the copies all belong to the history of the
+     *    original. Each copy has 1/K of the weight and only the first copy starts a history, so
+     *    the number of histories is that of the source.
+     *  - Without, every copy is a history of its own with the original weights. The empty
+     *    histories before a history are multiplied by K as well, so the number of histories is K
+     *    times that of the source (see getNumberOfHistories()).
+     */
+    class HistoryReplayer
+    {
+        public:
+            /**
+             * @brief Function reading the next particles of a source into an array, returning how many were read, 0 at the end.
+             */
+            using ParticleSource = std::function<std::size_t(std::span<Particle>)>;
+
+            /**
+             * @brief Construct a replayer of the particles of any source.
+             *
+             * @param source The source of the particles, read in order
+             * @param copies The number of times each history is emitted, K
+             * @param seed The seed of the random rotations
+             * @param threadIndex The index of the thread using the replayer, giving it a sequence of random rotations of its own
+             * @throws std::invalid_argument if copies is 0 or the source is empty
+             */
+            HistoryReplayer(ParticleSource source, std::uint32_t copies, std::uint64_t seed = 0, std::size_t threadIndex = 0);
+
+            /**
+             * @brief Construct a replayer of the particles of a reader.
+             *
+             * The particles are read through PhaseSpaceFileReader::readParticles(). The reader
+             * must outlive the replayer.
+             *
+             * @param reader The reader of the phase space
+             * @param copies The number of times each history is emitted, K
+             * @param seed The seed of the random rotations
+             * @param threadIndex The index of the thread using the replayer, giving it a sequence of random rotations of its own
+             * @throws std::invalid_argument if copies is 0
+             */
+            HistoryReplayer(PhaseSpaceFileReader & reader, std::uint32_t copies, std::uint64_t seed = 0, std::size_t threadIndex = 0);
+
+            /**
+             * @brief Construct a replayer of the particles of one thread of a parallel reader.
+             *
+             * The particles are read through the readParticles(threadIndex, particles) of the
+             * ParticleBalancedParallelReader, HistoryBalancedParallelReader or ChunkedParallelReader.
+             * The reader must outlive the replayer, and each thread needs a replayer of its own.
+             *
+             * @param parallelReader The parallel reader of the phase space
+             * @param threadIndex The index of the thread whose particles are read
+             * @param copies The number of times each history is emitted, K
+             * @param seed The seed of the random rotations
+             * @throws std::invalid_argument if copies is 0
+             */
+            template <typename ParallelReader>
+                requires requires(ParallelReader & reader, std::size_t threadIndex, std::span<Particle> particles) {
+                    { reader.readParticles(threadIndex, particles) } -> std::convertible_to<std::size_t>;
+                }
+            HistoryReplayer(ParallelReader & parallelReader, std::size_t threadIndex, std::uint32_t copies, std::uint64_t seed = 0);
+
+            /**
+             * @brief Rotate the copies about an axis parallel to the Z axis.
+             *
+             * @param enable Whether to rotate the copies
+             * @param centerX X coordinate of the axis
+             * @param centerY Y coordinate of the axis
+             */
+            void        setRotation(bool enable, float centerX = 0.f, float centerY = 0.f);
+
+            /**
+             * @brief Choose whether the copies share the history and weight of the original.
+             *
+             * @param divide true to divide the weights by K and keep the histories of the source,
+             *               false to keep the weights and make every copy a history of its own
+             */
+            void        setDividingWeights(bool divide);
+
+            /**
+             * @brief Check if there are more particles to emit.
+             *
+             * Reads the next history from the source once every copy of the current one has been emitted.
+             *
+             * @return true if there are more particles
+             */
+            bool        hasMoreParticles();
+
+            /**
+             * @brief Get the next particle of the current copy.
+             *
+             * @return Particle The particle, rotated and with its weight and history set for its copy
+             * @throws std::runtime_error if there are no more particles
+             */
+            Particle    getNextParticle();
+
+            /**
+             * @brief Read the next particles into a contiguous array.
+             *
+             * @param particles The particles to fill from the front
+             * @return std::size_t The number of particles read, 0 once there are no more
+             */
+            std::size_t readParticles(std::span<Particle> particles);
+
+            /**
+             * @brief Get the number of times each history is emitted.
+             *
+             * @return std::uint32_t K
+             */
+            std::uint32_t getNumberOfCopies() const;
+
+            /**
+             * @brief Get the number of histories emitted for a number of histories of the source.
+             *
+             * @param sourceHistories The number of histories of the source, such as its number of original histories
+             * @return std::uint64_t The number of histories the emitted particles represent
+             */
+            std::uint64_t getNumberOfHistories(std::uint64_t sourceHistories) const;
+
+            /**
+             * @brief Get the number of particles emitted so far.
+             *
+             * @return std::uint64_t The number of particles emitted, counting every copy
+             */
+            std::uint64_t getParticlesRead() const;
+
+            /**
+             * @brief Get the number of histories emitted so far.
+             *
+             * @return std::uint64_t The sum of the incremental history numbers of the particles emitted
+             */
+            std::uint64_t getHistoriesRead() const;
+
+        private:
+            static constexpr std::size_t PARTICLES_PER_BATCH = 4096;
+
+            bool          loadNextHistory();
+            void          startCopy();
+            Particle      emitParticle();
+
+            ParticleSource source_;
+            const std::uint32_t copies_;
+            std::uint64_t randomState_;
+
+            bool   rotate_;
+            double centerX_;
+            double centerY_;
+            bool   divideWeights_;
+
+            std::vector<Particle> batch_;        /// particles read from the source and not yet sorted into histories
+            std::size_t batchPosition_;
+            std::size_t batchSize_;
+            bool sourceExhausted_;
+
+            std::vector<Particle> history_;      /// the history being emitted
+            std::uint32_t copy_;                 /// index of the copy being emitted, copies_ once all have been
+            std::size_t positionInHistory_;
+            double historyAngleOffset_;          /// random start of the angles of the copies of the history, in [0,1)
+            double cosine_;
+            double sine_;
+
+            std::uint64_t particlesRead_;
+            std::uint64_t historiesRead_;
+    };
+
+    // Inline implementations for the HistoryReplayer class
+
+    template <typename ParallelReader>
+        requires requires(ParallelReader & reader, std::size_t threadIndex, std::span<Particle> particles) {
+            { reader.readParticles(threadIndex, particles) } -> std::convertible_to<std::size_t>;
+        }
+    inline HistoryReplayer::HistoryReplayer(ParallelReader & parallelReader, std::size_t threadIndex, std::uint32_t copies, std::uint64_t seed)
+    : HistoryReplayer([&parallelReader, threadIndex](std::span<Particle> particles) { return static_cast<std::size_t>(parallelReader.readParticles(threadIndex, particles)); }, copies, seed, threadIndex)
+    {}
+
+    inline void HistoryReplayer::setRotation(bool enable, float centerX, float centerY) {
+        rotate_ = enable;
+        centerX_ = centerX;
+        centerY_ = centerY;
+    }
+
+    inline void HistoryReplayer::setDividingWeights(bool divide) { divideWeights_ = divide; }
+    inline std::uint32_t HistoryReplayer::getNumberOfCopies() const { return copies_; }
+    inline std::uint64_t HistoryReplayer::getNumberOfHistories(std::uint64_t sourceHistories) const { return divideWeights_ ? sourceHistories : sourceHistories * copies_; }
+    inline std::uint64_t HistoryReplayer::getParticlesRead() const { return particlesRead_; }
+    inline std::uint64_t HistoryReplayer::getHistoriesRead() const { return historiesRead_; }
+
+} // namespace ParticleZoo
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "particlezoo/Particle.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/utilities/historyIndex.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief How the histories of a HistorySampler are drawn.
+     */
+    enum class HistorySampling
+    {
+        UNIFORM,    ///< A uniformly random subset of the given size, every subset being as likely
+        STRATIFIED  ///< One history drawn uniformly from each of the given number of equal runs of consecutive histories
+    };
+
+    /**
+     * @brief Stage reading a random subset of the histories of a phase space.
+     *
+     * Taking the first particles of a file gives a biased preview of it, since the histories of a
+     * phase space are usually stored in the order they were simulated. A HistorySampler instead
+     * draws a random subset of the represented histories, those with at least one particle, and
+     * reads only those, jumping between them with moveToHistory() and a history index. Reading
+     * costs in proportion to the size of the sample, plus up to the stride of the index in
+     * histories read past for each jump. Histories close enough to be reached by reading forward
+     * are read forward.
+     *
+     * The index is the sidecar of the file when there is one (see HistoryIndex::Load() and
+     * PHSPIndex), otherwise it is built by reading the whole file once. Indexing a file with a
+     * small stride beforehand makes sampling it cheaper.
+     *
+     * The incremental history numbers of the sampled particles are rescaled so that they add up
+     * to the original histories of the file times the fraction of the represented histories
+     * sampled (see getNumberOfOriginalHistories()), so quantities normalized per history are the
+     * same as for the whole file. The weights of the particles are left as they are, and
+     * pseudo-particles are dropped since their histories are accounted for by the rescaling.
+     *
+     * Drawing a uniform sample of k of the N histories keeps min(k, N - k) history numbers in
+     * memory, a stratified sample keeps none.
+     */
+    class HistorySampler
+    {
+        public:
+            /**
+             * @brief Construct a sampler of the histories of a reader.
+             *
+             * The reader must support random access (see PhaseSpaceFileReader::supportsRandomAccess())
+             * and outlive the sampler, which moves it around the file.
+             *
+             * @param reader The reader of the phase space
+             * @param sampleSize The fraction of the represented histories to sample if below 1, otherwise their number, capped at the number in the file
+             * @param sampling How to draw the histories
+             * @param seed The seed of the random draws, the same seed always giving the same sample of a file
+             * @throws std::invalid_argument if the sample size is not positive
+             * @throws std::runtime_error if the reader does not support random access
+             */
+            HistorySampler(PhaseSpaceFileReader & reader, double sampleSize, HistorySampling sampling = HistorySampling::UNIFORM, std::uint64_t seed = 0);
+
+            /**
+             * @brief Check if there are more sampled particles to read.
+             *
+             * @return true if there are more particles
+             */
+            bool          hasMoreParticles();
+
+            /**
+             * @brief Get the next particle of the sampled histories.
+             *
+             * @return Particle The particle, with its incremental history number rescaled if it starts a history
+             * @throws std::runtime_error if there are no more particles
+             */
+            Particle      getNextParticle();
+
+            /**
+             * @brief Read the next sampled particles into a contiguous array.
+             *
+             * @param particles The particles to fill from the front
+             * @return std::size_t The number of particles read, 0 once there are no more
+             */
+            std::size_t   readParticles(std::span<Particle> particles);
+
+            /**
+             * @brief Get the number of histories in the sample.
+             *
+             * @return std::uint64_t The number of represented histories drawn
+             */
+            std::uint64_t getNumberOfSampledHistories() const;
+
+            /**
+             * @brief Get the number of histories of the file the sample is drawn from.
+             *
+             * @return std::uint64_t The number of represented histories of the file
+             */
+            std::uint64_t getNumberOfRepresentedHistoriesInFile() const;
+
+            /**
+             * @brief Get the number of original histories the sample stands for.
+             *
+             * @return std::uint64_t The original histories of the file scaled by the fraction of its represented histories sampled
+             */
+            std::uint64_t getNumberOfOriginalHistories() const;
+
+            /**
+             * @brief Get the number of sampled histories read so far.
+             *
+             * @return std::uint64_t The number of histories of the sample read
+             */
+            std::uint64_t getHistoriesSampled() const;
+
+            /**
+             * @brief Get the number of particles read so far.
+             *
+             * @return std::uint64_t The number of particles of the sampled histories read
+             */
+            std::uint64_t getParticlesRead() const;
+
+            /**
+             * @brief Get the number of original histories read so far.
+             *
+             * @return std::uint64_t The sum of the rescaled incremental history numbers of the particles read
+             */
+            std::uint64_t getHistoriesRead() const;
+
+        private:
+            std::uint64_t nextSampledHistory();
+            std::uint64_t randomBelow(std::uint64_t bound);
+            std::uint64_t originalHistoriesUpTo(std::uint64_t sampledHistories) const;
+            bool          readNextSampledHistory();
+            void          readHistory(std::vector<Particle> * particles);
+
+            PhaseSpaceFileReader & reader_;
+            const HistoryIndex index_;
+            const HistorySampling sampling_;
+            std::mt19937_64 random_;
+
+            const std::uint64_t representedHistories_;  /// N, the histories the sample is drawn from
+            const std::uint64_t sampledHistories_;      /// k, the histories in the sample
+            const std::uint64_t originalHistories_;     /// original histories of the file
+
+            std::vector<std::uint64_t> selectedHistories_; /// sorted history numbers drawn for a uniform sample, or left out of it if selectingComplement_
+            bool selectingComplement_;
+            std::size_t selectedPosition_;
+            std::uint64_t nextCandidate_;               /// the history after the last one sampled
+
+            std::uint64_t readerHistory_;               /// number of the history starting at the next particle
+            bool readerPositioned_;
+            std::optional<Particle> nextParticle_;      /// first particle of the next history, read past the end of the last
+
+            std::uint64_t carriedHistories_;            /// histories of sampled histories holding only pseudo-particles, carried to the next
+            std::vector<Particle> history_;             /// particles of the sampled history being read
+            std::size_t positionInHistory_;
+
+            std::uint64_t historiesSampled_;
+            std::uint64_t particlesRead_;
+            std::uint64_t historiesRead_;
+    };
+
+    // Inline implementations for the HistorySampler class
+
+    inline std::uint64_t HistorySampler::getNumberOfSampledHistories() const { return sampledHistories_; }
+    inline std::uint64_t HistorySampler::getNumberOfRepresentedHistoriesInFile() const { return representedHistories_; }
+    inline std::uint64_t HistorySampler::getNumberOfOriginalHistories() const { return originalHistoriesUpTo(sampledHistories_); }
+    inline std::uint64_t HistorySampler::getHistoriesSampled() const { return historiesSampled_; }
+    inline std::uint64_t HistorySampler::getParticlesRead() const { return particlesRead_; }
+    inline std::uint64_t HistorySampler::getHistoriesRead() const { return historiesRead_; }
+
+} // namespace ParticleZoo
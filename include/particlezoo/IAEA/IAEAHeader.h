@@ -9,6 +9,7 @@
 #include <cstdint>
 
 #include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
 #include "particlezoo/ByteBuffer.h"
 
 namespace ParticleZoo::IAEAphspFile
@@ -591,6 +592,38 @@ namespace ParticleZoo::IAEAphspFile
              */
             void                countParticleStats(const Particle & particle);
 
+            /**
+             * @brief Update particle statistics with a block of particles
+             * 
+             * Counts every particle of the block as countParticleStats(const Particle&) would, the
+             * original histories being those of the incremental history column of the particles
+             * starting a new history.
+             * 
+             * @param block Particles to include in statistics calculations, only their basic properties are used
+             */
+            void                countParticleStats(const ParticleBlock & block);
+
+            /**
+             * @brief Add the particle statistics and history count of another header to this one
+             * 
+             * Used when the records of the other header's phase space file are appended to this one.
+             * 
+             * @param other Header of a phase space file with the same record layout
+             * @throws std::runtime_error if the record layouts of the two files differ
+             */
+            void                mergeParticleStats(const IAEAHeader & other);
+
+            /**
+             * @brief Check if the particle records described by another header are laid out as in this one
+             * 
+             * Compares the record length, byte order, which quantities are stored and the extra floats
+             * and longs. Constant values are not compared.
+             * 
+             * @param other Header to compare with
+             * @return true if records of either file can be read using the other header
+             */
+            bool                hasSameRecordLayout(const IAEAHeader & other) const;
+
             /**
              * @brief Set a header section value by name
              * @param sectionName Name of the section to set
@@ -695,9 +728,18 @@ namespace ParticleZoo::IAEAphspFile
              */
             bool                checksumIsValid() const;
 
+            /**
+             * @brief Validate the data integrity checksum against a known data file size
+             * Used when the data file is not stored as it is, such as a compressed data file whose
+             * decompressed size is known from its reader.
+             * @param fileSize Size of the data in bytes
+             * @return true if checksum matches expected value based on file size and record length
+             */
+            bool                checksumIsValid(std::uint64_t fileSize) const;
+
             /**
              * @brief Determine the header file path from a data file name
-             * @param filename Path to the data file (.IAEAphsp)
+             * @param filename Path to the data file (.IAEAphsp, possibly followed by a .gz or .zst compression suffix)
              * @return Path to the corresponding header file (.IAEAheader)
              */
             const static std::string DeterminePathToHeaderFile(const std::string &filename);
@@ -941,6 +983,83 @@ namespace ParticleZoo::IAEAphspFile
         checksum_ = numberOfParticles_ * recordLength_;
     }
 
+    inline void IAEAHeader::countParticleStats(const ParticleBlock &block)
+    {
+        std::span<const ParticleType> types = block.getTypes();
+        std::span<const float> energies = block.getKineticEnergies();
+        std::span<const float> xs = block.getXPositions();
+        std::span<const float> ys = block.getYPositions();
+        std::span<const float> zs = block.getZPositions();
+        std::span<const float> weights = block.getWeights();
+        std::span<const std::uint8_t> isNewHistory = block.getNewHistoryFlags();
+        std::span<const std::uint32_t> incrementalHistories = block.getIncrementalHistories();
+
+        numberOfParticles_ += block.size();
+        for (std::size_t i = 0; i < block.size(); i++)
+        {
+            if (isNewHistory[i]) originalHistories_ += incrementalHistories[i];
+
+            // Update particle statistics.
+            auto &stats = particleStatsTable_[types[i]];
+            stats.count_++;
+            stats.weightSum_    += (double)weights[i];
+            stats.minWeight_     = std::min(stats.minWeight_, weights[i]);
+            stats.maxWeight_     = std::max(stats.maxWeight_, weights[i]);
+            stats.energySum_    += (double)energies[i];
+            stats.minEnergy_     = std::min(stats.minEnergy_, energies[i]);
+            stats.maxEnergy_     = std::max(stats.maxEnergy_, energies[i]);
+
+            // Update global bounds.
+            minX_ = std::min(minX_, xs[i]);
+            maxX_ = std::max(maxX_, xs[i]);
+            minY_ = std::min(minY_, ys[i]);
+            maxY_ = std::max(maxY_, ys[i]);
+            minZ_ = std::min(minZ_, zs[i]);
+            maxZ_ = std::max(maxZ_, zs[i]);
+        }
+
+        checksum_ = numberOfParticles_ * recordLength_;
+    }
+
+    inline bool IAEAHeader::hasSameRecordLayout(const IAEAHeader &other) const
+    {
+        return other.recordLength_ == recordLength_ && other.byteOrder_ == byteOrder_
+            && other.xIsStored_ == xIsStored_ && other.yIsStored_ == yIsStored_ && other.zIsStored_ == zIsStored_
+            && other.uIsStored_ == uIsStored_ && other.vIsStored_ == vIsStored_ && other.wIsStored_ == wIsStored_
+            && other.weightIsStored_ == weightIsStored_
+            && other.extraFloatData_ == extraFloatData_ && other.extraLongData_ == extraLongData_;
+    }
+
+    inline void IAEAHeader::mergeParticleStats(const IAEAHeader &other)
+    {
+        if (!hasSameRecordLayout(other)) {
+            throw std::runtime_error("Cannot merge IAEA headers of phase space files with different record layouts.");
+        }
+
+        numberOfParticles_ += other.numberOfParticles_;
+        originalHistories_ += other.originalHistories_;
+
+        for (const auto & [type, otherStats] : other.particleStatsTable_) {
+            auto &stats = particleStatsTable_[type];
+            stats.count_        += otherStats.count_;
+            stats.weightSum_    += otherStats.weightSum_;
+            stats.minWeight_     = std::min(stats.minWeight_, otherStats.minWeight_);
+            stats.maxWeight_     = std::max(stats.maxWeight_, otherStats.maxWeight_);
+            stats.energySum_    += otherStats.energySum_;
+            stats.minEnergy_     = std::min(stats.minEnergy_, otherStats.minEnergy_);
+            stats.maxEnergy_     = std::max(stats.maxEnergy_, otherStats.maxEnergy_);
+        }
+
+        minX_ = std::min(minX_, other.minX_);
+        maxX_ = std::max(maxX_, other.maxX_);
+        minY_ = std::min(minY_, other.minY_);
+        maxY_ = std::max(maxY_, other.maxY_);
+        minZ_ = std::min(minZ_, other.minZ_);
+        maxZ_ = std::max(maxZ_, other.maxZ_);
+
+        checksum_ = numberOfParticles_ * recordLength_;
+    }
+
 
     // helper function to strip string of white space
     inline std::string IAEAHeader::stripWhiteSpace(const std::string &str)
@@ -84,6 +84,12 @@ namespace ParticleZoo::IAEAphspFile
              */
             static std::vector<CLICommand> getFormatSpecificCLICommands();
 
+            /**
+             * @brief Open another reader of the same file, sharing the header already parsed by this reader
+             * @return The new reader, starting at the first particle
+             */
+            std::unique_ptr<PhaseSpaceFileReader> clone() const override;
+
         protected:
             /**
              * @brief Get the byte offset where particle records start
@@ -105,9 +111,77 @@ namespace ParticleZoo::IAEAphspFile
              */
             Particle      readBinaryParticle(ByteBuffer & buffer) override;
 
+            /**
+             * @brief Test a filter against the fields of an IAEA binary record
+             * 
+             * The type, kinetic energy and position are read from the record, along with the
+             * incremental history number if the file stores one, without building the particle.
+             * Criteria on the direction, generation or LATCH bits are left to the full decoder.
+             * 
+             * @param record Binary buffer containing the particle record
+             * @param filter The filter to test
+             * @param rejected Filled with the history information of the record if it is rejected
+             * @return true if the record is rejected, false if it has to be decoded to be tested
+             */
+            bool          rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected) override;
+
         private:
+            /**
+             * @brief Copy constructor used by clone(), opening the file again without re-reading the header
+             * @param other The reader to open the file of
+             */
+            Reader(const Reader & other) = default;
+
+            /**
+             * @brief Handler applying one extra long value to a particle
+             * @param particle The particle being decoded
+             * @param value The extra long value read from the record
+             * @param type The ParticleZoo property type the extra long translates to
+             * @param latchOption The LATCH interpretation option
+             */
+            using ExtraLongHandler = void (*)(Particle & particle, std::int32_t value, IntPropertyType type, EGSphspFile::EGSLATCHOPTION latchOption);
+
+            /**
+             * @brief Record layout compiled once from the header, so that it is not re-interpreted for every particle
+             */
+            struct RecordPlan {
+                bool  allBasicStored;                           ///< True if x, y, z, u, v, w and weight are all stored in each record
+                bool  xIsStored, yIsStored, zIsStored;          ///< Which positions are stored in each record
+                bool  uIsStored, vIsStored, wIsStored;          ///< Which direction components are stored (w is reconstructed from u and v)
+                bool  weightIsStored;                           ///< True if the weight is stored in each record
+                float constantX, constantY, constantZ;          ///< Positions used when they are not stored
+                float constantU, constantV, constantW;          ///< Direction components used when they are not stored
+                float constantWeight;                           ///< Weight used when it is not stored
+                std::vector<FloatPropertyType> extraFloatTypes; ///< Property type of each extra float, in record order
+
+                /// @brief Handler and target property for one extra long
+                struct ExtraLong {
+                    ExtraLongHandler handler;
+                    IntPropertyType  type;
+                };
+                std::vector<ExtraLong> extraLongs;              ///< Decoder for each extra long, in record order
+                std::size_t incrementalHistoryOffset;           ///< Offset in the record of the incremental history number extra long, 0 if there is none
+            };
+
+            /**
+             * @brief Compile the record layout described by a header into a decoding plan
+             * @param header The header of the phase space file
+             * @return The decoding plan
+             */
+            static RecordPlan compileRecordPlan(const IAEAHeader & header);
+
+            /**
+             * @brief Decode a single particle record according to the plan
+             * @tparam ALL_BASIC_STORED True if every basic quantity is stored, which skips the per-field checks
+             * @param buffer Binary buffer containing particle data
+             * @return Decoded Particle object with all properties
+             */
+            template <bool ALL_BASIC_STORED>
+            Particle      decodeParticle(ByteBuffer & buffer);
+
             const IAEAHeader header_;  ///< Header information for the phase space file
             EGSphspFile::EGSLATCHOPTION EGSlatchOption_; ///< LATCH interpretation option
+            const RecordPlan plan_;    ///< Decoding plan compiled from the header
 
     };
 
@@ -158,6 +232,18 @@ namespace ParticleZoo::IAEAphspFile
              */
             IAEAHeader & getHeader();
 
+            /**
+             * @brief Get the LATCH option used to make the EGS_LATCH extra longs of particles without a LATCH
+             * @return The EGS LATCH option
+             */
+            EGSphspFile::EGSLATCHOPTION getLATCHOption() const;
+
+            /**
+             * @brief Get the paths of the data and header files
+             * @return The .IAEAphsp data file followed by the .IAEAheader file
+             */
+            std::vector<std::string> getOutputFileNames() const override;
+
             /**
              * @brief Get format-specific command-line options
              * @return Vector of CLI commands supported by IAEA writer
@@ -177,6 +263,11 @@ namespace ParticleZoo::IAEAphspFile
              */
             void writeHeaderData(ByteBuffer & buffer) override;
 
+            /**
+             * @brief Write the header file with the statistics so far, before writing to standard output
+             */
+            void writeProvisionalHeader() override;
+
             /**
              * @brief Encode and write a single particle to binary data
              * @param buffer Binary buffer to write particle data to
@@ -235,6 +326,38 @@ namespace ParticleZoo::IAEAphspFile
              */
             void fixedValuesHaveChanged() override;
 
+            /**
+             * @brief Merge the header statistics and history count of another IAEA writer
+             * @param other A closed IAEA writer whose records are being appended to this file
+             * @throws std::runtime_error if the record layouts of the two files differ
+             */
+            void mergeStatisticsFrom(const PhaseSpaceFileWriter & other) override;
+
+            /**
+             * @brief Check if an IAEA file has the same record layout and constant values as this writer
+             * @param reader A reader for the IAEA file
+             * @return true if the file's records can be appended unchanged
+             */
+            bool hasSameRecordLayout(const PhaseSpaceFileReader & reader) const override;
+
+            /**
+             * @brief Merge the statistics and history count in the header of an existing IAEA file
+             * @param reader A reader for the IAEA file whose records are being appended to this file
+             */
+            void mergeStatisticsFrom(const PhaseSpaceFileReader & reader) override;
+
+            /**
+             * @brief Count a particle copied from another IAEA file in the header statistics
+             * @param particle The particle of a copied record
+             */
+            void countParticleStats(const Particle & particle) override;
+
+            /**
+             * @brief Count a block of transcoded particles in the header statistics
+             * @param block The basic properties of the particles of the transcoded records
+             */
+            void countParticleBlockStats(const ParticleBlock & block) override;
+
         private:
             IAEAHeader header_;                        ///< Header configuration
             bool useCustomHistoryCount_{false};        ///< Flag for custom history count override
@@ -254,6 +377,7 @@ namespace ParticleZoo::IAEAphspFile
 
     // Inline implementations for the IAEAphspFileWriter class
     inline IAEAHeader & Writer::getHeader() { return header_; }
+    inline EGSphspFile::EGSLATCHOPTION Writer::getLATCHOption() const { return EGSlatchOption_; }
     inline std::uint64_t Writer::getMaximumSupportedParticles() const { return std::numeric_limits<std::uint64_t>::max(); }
     inline std::size_t Writer::getParticleRecordLength() const { return header_.getRecordLength(); }
     inline void Writer::fixedValuesHaveChanged() {
@@ -1,8 +1,12 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
 #include <string>
 #include <cmath>
+#include <span>
 #include <stdexcept>
 #include <vector>
 #include <cstdint>
@@ -112,6 +116,112 @@ namespace ParticleZoo {
     };
 
 
+    /**
+     * @brief A list of property values stored inline up to a fixed capacity.
+     * 
+     * Values are kept in an inline array until more than N values are added, after which
+     * they are moved to the heap. This keeps particles with few custom properties free of
+     * heap allocations, both when they are created and when they are copied.
+     * 
+     * @tparam T The value type stored in the list
+     * @tparam N The number of values stored inline before falling back to the heap
+     */
+    template <typename T, std::size_t N>
+    class InlinePropertyList {
+        public:
+            InlinePropertyList() = default;
+
+            /**
+             * @brief Copy construct the list, only allocating if the source has overflowed to the heap.
+             * 
+             * @param other The list to copy
+             */
+            InlinePropertyList(const InlinePropertyList & other);
+
+            /**
+             * @brief Copy assign the list, only allocating if the source has overflowed to the heap.
+             * 
+             * @param other The list to copy
+             * @return InlinePropertyList& This list
+             */
+            InlinePropertyList & operator=(const InlinePropertyList & other);
+
+            /**
+             * @brief Move construct the list, leaving the source empty.
+             * 
+             * @param other The list to move from
+             */
+            InlinePropertyList(InlinePropertyList && other) noexcept;
+
+            /**
+             * @brief Move assign the list, leaving the source empty.
+             * 
+             * @param other The list to move from
+             * @return InlinePropertyList& This list
+             */
+            InlinePropertyList & operator=(InlinePropertyList && other) noexcept;
+
+            /**
+             * @brief Append a value to the end of the list.
+             * 
+             * @param value The value to append
+             */
+            void push_back(T value);
+
+            /**
+             * @brief Reserve space for a number of values.
+             * 
+             * Only allocates if the requested size exceeds the inline capacity.
+             * 
+             * @param size The number of values to reserve space for
+             */
+            void reserve(std::size_t size);
+
+            /**
+             * @brief Get the number of values in the list.
+             * 
+             * @return std::size_t The number of values
+             */
+            std::size_t size() const;
+
+            /**
+             * @brief Check if the list is empty.
+             * 
+             * @return true if the list holds no values
+             */
+            bool empty() const;
+
+            /**
+             * @brief Get a pointer to the contiguous values.
+             * 
+             * @return const T* Pointer to the first value
+             */
+            const T* data() const;
+
+            /**
+             * @brief Get a value by index (unchecked).
+             * 
+             * @param index The index of the value
+             * @return const T& The value
+             */
+            const T& operator[](std::size_t index) const;
+
+            /**
+             * @brief View the values as a span.
+             * 
+             * @return std::span<const T> The values
+             */
+            operator std::span<const T>() const;
+
+        private:
+            void growHeap(std::size_t capacity);
+
+            std::array<T, N>     inline_{};
+            std::unique_ptr<T[]> heap_{};
+            std::size_t          heapCapacity_{0};
+            std::size_t          size_{0};
+    };
+
     /* Particle Class Definition */
 
     /**
@@ -125,23 +235,27 @@ namespace ParticleZoo {
      */
     class Particle {
 
+        static constexpr std::size_t NUMBER_OF_INT_PROPERTY_TYPES = static_cast<std::size_t>(IntPropertyType::CUSTOM);
+        static constexpr std::size_t NUMBER_OF_FLOAT_PROPERTY_TYPES = static_cast<std::size_t>(FloatPropertyType::CUSTOM);
+        static constexpr std::size_t NUMBER_OF_BOOL_PROPERTY_TYPES = static_cast<std::size_t>(BoolPropertyType::CUSTOM);
+        static constexpr std::size_t INLINE_CUSTOM_PROPERTIES = 8;
+
+        static_assert(NUMBER_OF_INT_PROPERTY_TYPES <= 32 && NUMBER_OF_FLOAT_PROPERTY_TYPES <= 32 && NUMBER_OF_BOOL_PROPERTY_TYPES <= 32, "Property presence masks are 32 bits wide.");
+
         struct ParticleProperties {
-            // well defined properties
-            std::unordered_map<IntPropertyType, unsigned int> intPropertyTypeIndices;
-            std::unordered_map<FloatPropertyType, unsigned int> floatPropertyTypeIndices;
-            std::unordered_map<BoolPropertyType, unsigned int> boolPropertyTypeIndices;
-            std::vector<BoolPropertyType>   boolPropertyTypes;
-            std::vector<FloatPropertyType>  floatPropertyTypes;
-            std::vector<IntPropertyType>    intPropertyTypes;
-            std::vector<bool>               boolProperties;
-            std::vector<float>              floatProperties;
-            std::vector<std::int32_t>       intProperties;
+            // well defined properties, indexed by their property type and flagged as present in a bitmask
+            std::uint32_t                                          intPropertyMask{0};
+            std::uint32_t                                          floatPropertyMask{0};
+            std::uint32_t                                          boolPropertyMask{0};
+            std::uint32_t                                          boolPropertyValues{0};
+            std::array<std::int32_t, NUMBER_OF_INT_PROPERTY_TYPES> intProperties{};
+            std::array<float, NUMBER_OF_FLOAT_PROPERTY_TYPES>      floatProperties{};
 
             // custom properties
-            std::vector<bool>               customBoolProperties;
-            std::vector<float>              customFloatProperties;
-            std::vector<std::int32_t>       customIntProperties;
-            std::vector<std::string>        customStringProperties;
+            InlinePropertyList<bool, INLINE_CUSTOM_PROPERTIES>         customBoolProperties;
+            InlinePropertyList<float, INLINE_CUSTOM_PROPERTIES>        customFloatProperties;
+            InlinePropertyList<std::int32_t, INLINE_CUSTOM_PROPERTIES> customIntProperties;
+            std::vector<std::string>                                   customStringProperties;
         };
 
         public:
@@ -370,21 +484,30 @@ namespace ParticleZoo {
             // Setters and getters for advanced particle properties
 
             /**
-             * @brief Reserve memory for boolean properties
+             * @brief Reserve memory for custom boolean properties
+             * 
+             * Well defined properties are always stored inline so only custom properties
+             * beyond the inline capacity require memory to be reserved.
              * 
              * @param size The number of boolean properties to reserve space for
              */
             void reserveBoolProperties(unsigned int size);
             
             /**
-             * @brief Reserve memory for float properties
+             * @brief Reserve memory for custom float properties
+             * 
+             * Well defined properties are always stored inline so only custom properties
+             * beyond the inline capacity require memory to be reserved.
              * 
              * @param size The number of float properties to reserve space for
              */
             void reserveFloatProperties(unsigned int size);
             
             /**
-             * @brief Reserve memory for integer properties
+             * @brief Reserve memory for custom integer properties
+             * 
+             * Well defined properties are always stored inline so only custom properties
+             * beyond the inline capacity require memory to be reserved.
              * 
              * @param size The number of integer properties to reserve space for
              */
@@ -505,25 +628,25 @@ namespace ParticleZoo {
             void setStringProperty(std::string value);
 
             /**
-             * @brief Get a reference to all custom boolean properties.
+             * @brief Get a view of all custom boolean properties.
              * 
-             * @return const std::vector<bool>& Reference to the vector of custom boolean properties
+             * @return std::span<const bool> View of the custom boolean properties, valid until the particle is modified
              */
-            const std::vector<bool>& getCustomBoolProperties() const;
+            std::span<const bool> getCustomBoolProperties() const;
             
             /**
-             * @brief Get a reference to all custom float properties.
+             * @brief Get a view of all custom float properties.
              * 
-             * @return const std::vector<float>& Reference to the vector of custom float properties
+             * @return std::span<const float> View of the custom float properties, valid until the particle is modified
              */
-            const std::vector<float>& getCustomFloatProperties() const;
+            std::span<const float> getCustomFloatProperties() const;
             
             /**
-             * @brief Get a reference to all custom integer properties.
+             * @brief Get a view of all custom integer properties.
              * 
-             * @return const std::vector<std::int32_t>& Reference to the vector of custom integer properties
+             * @return std::span<const std::int32_t> View of the custom integer properties, valid until the particle is modified
              */
-            const std::vector<std::int32_t>& getCustomIntProperties() const;
+            std::span<const std::int32_t> getCustomIntProperties() const;
             
             /**
              * @brief Get a reference to all custom string properties.
@@ -584,13 +707,108 @@ namespace ParticleZoo {
             float weight_{0.f};
             ParticleProperties properties_{};
             
-            int  getBoolPropertyIndex(BoolPropertyType type) const;
-            int  getFloatPropertyIndex(FloatPropertyType type) const;
-            int  getIntPropertyIndex(IntPropertyType type) const;
+            static constexpr std::uint32_t propertyBit(std::size_t index);
             void normalizeDirectionalCosines();
     };
 
 
+    /* Implementation of InlinePropertyList class methods */
+
+    template <typename T, std::size_t N>
+    inline InlinePropertyList<T, N>::InlinePropertyList(const InlinePropertyList & other)
+    : inline_(other.inline_)
+    {
+        if (other.size_ > N) {
+            growHeap(other.size_);
+            std::copy(other.heap_.get(), other.heap_.get() + other.size_, heap_.get());
+        }
+        size_ = other.size_;
+    }
+
+    template <typename T, std::size_t N>
+    inline InlinePropertyList<T, N>::InlinePropertyList(InlinePropertyList && other) noexcept
+    : inline_(other.inline_), heap_(std::move(other.heap_)), heapCapacity_(other.heapCapacity_), size_(other.size_)
+    {
+        other.heapCapacity_ = 0;
+        other.size_ = 0;
+    }
+
+    template <typename T, std::size_t N>
+    inline InlinePropertyList<T, N> & InlinePropertyList<T, N>::operator=(const InlinePropertyList & other) {
+        if (this == &other) return *this;
+        inline_ = other.inline_;
+        if (other.size_ > N) {
+            if (heapCapacity_ < other.size_) {
+                size_ = 0; // existing values are about to be overwritten so do not preserve them
+                growHeap(other.size_);
+            }
+            std::copy(other.heap_.get(), other.heap_.get() + other.size_, heap_.get());
+        }
+        size_ = other.size_;
+        return *this;
+    }
+
+    template <typename T, std::size_t N>
+    inline InlinePropertyList<T, N> & InlinePropertyList<T, N>::operator=(InlinePropertyList && other) noexcept {
+        if (this == &other) return *this;
+        inline_ = other.inline_;
+        heap_ = std::move(other.heap_);
+        heapCapacity_ = other.heapCapacity_;
+        size_ = other.size_;
+        other.heapCapacity_ = 0;
+        other.size_ = 0;
+        return *this;
+    }
+
+    template <typename T, std::size_t N>
+    inline void InlinePropertyList<T, N>::growHeap(std::size_t capacity) {
+        std::unique_ptr<T[]> heap = std::make_unique<T[]>(capacity);
+        if (size_ > N) {
+            std::copy(heap_.get(), heap_.get() + size_, heap.get());
+        } else {
+            std::copy(inline_.begin(), inline_.begin() + size_, heap.get());
+        }
+        heap_ = std::move(heap);
+        heapCapacity_ = capacity;
+    }
+
+    template <typename T, std::size_t N>
+    inline void InlinePropertyList<T, N>::push_back(T value) {
+        if (size_ < N) {
+            inline_[size_] = value;
+        } else {
+            // the values live on the heap once the inline capacity is exceeded
+            if (size_ >= heapCapacity_) {
+                growHeap(std::max(2 * N, 2 * size_));
+            } else if (size_ == N) {
+                std::copy(inline_.begin(), inline_.end(), heap_.get()); // heap space was reserved in advance
+            }
+            heap_[size_] = value;
+        }
+        size_++;
+    }
+
+    template <typename T, std::size_t N>
+    inline void InlinePropertyList<T, N>::reserve(std::size_t size) {
+        if (size > N && size > heapCapacity_) growHeap(size);
+    }
+
+    template <typename T, std::size_t N>
+    inline std::size_t InlinePropertyList<T, N>::size() const { return size_; }
+
+    template <typename T, std::size_t N>
+    inline bool InlinePropertyList<T, N>::empty() const { return size_ == 0; }
+
+    template <typename T, std::size_t N>
+    inline const T* InlinePropertyList<T, N>::data() const { return size_ <= N ? inline_.data() : heap_.get(); }
+
+    template <typename T, std::size_t N>
+    inline const T& InlinePropertyList<T, N>::operator[](std::size_t index) const { return data()[index]; }
+
+    template <typename T, std::size_t N>
+    inline InlinePropertyList<T, N>::operator std::span<const T>() const { return std::span<const T>(data(), size_); }
+
+
     /* Implementation of Particle class methods */
 
     inline Particle::Particle(ParticleType type, double kineticEnergy, double x, double y, double z, double px, double py, double pz, bool isNewHistory, double weight)
@@ -651,129 +869,84 @@ namespace ParticleZoo {
 
     inline std::uint32_t Particle::getIncrementalHistories() const {
         if (!isNewHistory_) return 0; // If not a new history, return 0
-        int index = getIntPropertyIndex(IntPropertyType::INCREMENTAL_HISTORY_NUMBER);
-        if (index >= 0) {
-            return static_cast<std::uint32_t>(properties_.intProperties[index]); // Return the set property value
+        if (hasIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER)) {
+            return static_cast<std::uint32_t>(properties_.intProperties[static_cast<std::size_t>(IntPropertyType::INCREMENTAL_HISTORY_NUMBER)]); // Return the set property value
         } else {
             return 1; // Default to 1 if property not set
         }
     }
 
-    inline int Particle::getNumberOfBoolProperties() const { return static_cast<int>(properties_.boolProperties.size()); }
-    inline int Particle::getNumberOfFloatProperties() const { return static_cast<int>(properties_.floatProperties.size()); }
-    inline int Particle::getNumberOfIntProperties() const { return static_cast<int>(properties_.intProperties.size()); }
+    inline constexpr std::uint32_t Particle::propertyBit(std::size_t index) { return std::uint32_t{1} << index; }
+
+    inline int Particle::getNumberOfBoolProperties() const { return std::popcount(properties_.boolPropertyMask); }
+    inline int Particle::getNumberOfFloatProperties() const { return std::popcount(properties_.floatPropertyMask); }
+    inline int Particle::getNumberOfIntProperties() const { return std::popcount(properties_.intPropertyMask); }
 
-    inline const std::vector<bool>& Particle::getCustomBoolProperties() const { return properties_.customBoolProperties; }
-    inline const std::vector<float>& Particle::getCustomFloatProperties() const { return properties_.customFloatProperties; }
-    inline const std::vector<std::int32_t>& Particle::getCustomIntProperties() const { return properties_.customIntProperties; }
+    inline std::span<const bool> Particle::getCustomBoolProperties() const { return properties_.customBoolProperties; }
+    inline std::span<const float> Particle::getCustomFloatProperties() const { return properties_.customFloatProperties; }
+    inline std::span<const std::int32_t> Particle::getCustomIntProperties() const { return properties_.customIntProperties; }
     inline const std::vector<std::string>& Particle::getCustomStringProperties() const { return properties_.customStringProperties; }
 
     inline bool Particle::hasBoolProperty(BoolPropertyType type) const
     {
-        auto it = properties_.boolPropertyTypeIndices.find(type);
-        if (it != properties_.boolPropertyTypeIndices.end()) {
-            return true;
-        } else {
-            return false; // Not found
-        }
+        std::size_t index = static_cast<std::size_t>(type);
+        return index < NUMBER_OF_BOOL_PROPERTY_TYPES && (properties_.boolPropertyMask & propertyBit(index)) != 0;
     }
 
     inline bool Particle::hasFloatProperty(FloatPropertyType type) const
     {
-        auto it = properties_.floatPropertyTypeIndices.find(type);
-        if (it != properties_.floatPropertyTypeIndices.end()) {
-            return true;
-        } else {
-            return false; // Not found
-        }
+        std::size_t index = static_cast<std::size_t>(type);
+        return index < NUMBER_OF_FLOAT_PROPERTY_TYPES && (properties_.floatPropertyMask & propertyBit(index)) != 0;
     }
 
     inline bool Particle::hasIntProperty(IntPropertyType type) const
     {
-        auto it = properties_.intPropertyTypeIndices.find(type);
-        if (it != properties_.intPropertyTypeIndices.end()) {
-            return true;
-        } else {
-            return false; // Not found
-        }
-    }
-
-    inline int Particle::getBoolPropertyIndex(BoolPropertyType type) const {
-        auto it = properties_.boolPropertyTypeIndices.find(type);
-        if (it != properties_.boolPropertyTypeIndices.end()) {
-            return it->second;
-        } else {
-            return -1; // Not found
-        }
-    }
-
-    inline int Particle::getFloatPropertyIndex(FloatPropertyType type) const {
-        auto it = properties_.floatPropertyTypeIndices.find(type);
-        if (it != properties_.floatPropertyTypeIndices.end()) {
-            return it->second;
-        } else {
-            return -1; // Not found
-        }
-    }
-
-    inline int Particle::getIntPropertyIndex(IntPropertyType type) const {
-        auto it = properties_.intPropertyTypeIndices.find(type);
-        if (it != properties_.intPropertyTypeIndices.end()) {
-            return it->second;
-        } else {
-            return -1; // Not found
-        }
+        std::size_t index = static_cast<std::size_t>(type);
+        return index < NUMBER_OF_INT_PROPERTY_TYPES && (properties_.intPropertyMask & propertyBit(index)) != 0;
     }
 
     inline std::int32_t Particle::getIntProperty(IntPropertyType type) const {
-        int index = getIntPropertyIndex(type);
-        if (index == -1) {
+        if (!hasIntProperty(type)) {
             throw std::invalid_argument("Invalid integer property type.");
         }
-        return properties_.intProperties[index];
+        return properties_.intProperties[static_cast<std::size_t>(type)];
     }
 
     inline float Particle::getFloatProperty(FloatPropertyType type) const {
-        int index = getFloatPropertyIndex(type);
-        if (index == -1) {
+        if (!hasFloatProperty(type)) {
             throw std::invalid_argument("Invalid float property type.");
         }
-        return properties_.floatProperties[index];
+        return properties_.floatProperties[static_cast<std::size_t>(type)];
     }
 
     inline bool Particle::getBoolProperty(BoolPropertyType type) const {
-        int index = getBoolPropertyIndex(type);
-        if (index == -1) {
+        if (!hasBoolProperty(type)) {
             throw std::invalid_argument("Invalid boolean property type.");
         }
-        return properties_.boolProperties[index];
+        return (properties_.boolPropertyValues & propertyBit(static_cast<std::size_t>(type))) != 0;
     }
 
     inline void Particle::reserveBoolProperties(unsigned int size) {
-        properties_.boolProperties.reserve(size);
-        properties_.boolPropertyTypes.reserve(size);
+        properties_.customBoolProperties.reserve(size);
     }
 
     inline void Particle::reserveFloatProperties(unsigned int size) {
-        properties_.floatProperties.reserve(size);
-        properties_.floatPropertyTypes.reserve(size);
+        properties_.customFloatProperties.reserve(size);
     }
 
     inline void Particle::reserveIntProperties(unsigned int size) {
-        properties_.intProperties.reserve(size);
-        properties_.intPropertyTypes.reserve(size);
+        properties_.customIntProperties.reserve(size);
     }
 
     inline void Particle::setBoolProperty(BoolPropertyType type, bool value) {
         if (type == BoolPropertyType::INVALID) return;
         if (type != BoolPropertyType::CUSTOM) {
-            int index = getBoolPropertyIndex(type);
-            if (index == -1) {
-                properties_.boolProperties.push_back(value);
-                properties_.boolPropertyTypes.push_back(type);
-                properties_.boolPropertyTypeIndices[type] = static_cast<unsigned int>(properties_.boolProperties.size() - 1);
+            std::uint32_t bit = propertyBit(static_cast<std::size_t>(type));
+            properties_.boolPropertyMask |= bit;
+            if (value) {
+                properties_.boolPropertyValues |= bit;
             } else {
-                properties_.boolProperties[index] = value;
+                properties_.boolPropertyValues &= ~bit;
             }
         } else {
             properties_.customBoolProperties.push_back(value);
@@ -783,14 +956,9 @@ namespace ParticleZoo {
     inline void Particle::setFloatProperty(FloatPropertyType type, float value) {
         if (type == FloatPropertyType::INVALID) return;
         if (type != FloatPropertyType::CUSTOM) {
-            int index = getFloatPropertyIndex(type);
-            if (index == -1) {
-                properties_.floatProperties.push_back(value);
-                properties_.floatPropertyTypes.push_back(type);
-                properties_.floatPropertyTypeIndices[type] = static_cast<unsigned int>(properties_.floatProperties.size() - 1);
-            } else {
-                properties_.floatProperties[index] = value;
-            }
+            std::size_t index = static_cast<std::size_t>(type);
+            properties_.floatPropertyMask |= propertyBit(index);
+            properties_.floatProperties[index] = value;
         } else {
             properties_.customFloatProperties.push_back(value);
         }
@@ -799,14 +967,9 @@ namespace ParticleZoo {
     inline void Particle::setIntProperty(IntPropertyType type, std::int32_t value) {
         if (type == IntPropertyType::INVALID) return;
         if (type != IntPropertyType::CUSTOM) {
-            int index = getIntPropertyIndex(type);
-            if (index == -1) {
-                properties_.intProperties.push_back(value);
-                properties_.intPropertyTypes.push_back(type);
-                properties_.intPropertyTypeIndices[type] = static_cast<unsigned int>(properties_.intProperties.size() - 1);
-            } else {
-                properties_.intProperties[index] = value;
-            }
+            std::size_t index = static_cast<std::size_t>(type);
+            properties_.intPropertyMask |= propertyBit(index);
+            properties_.intProperties[index] = value;
         } else {
             properties_.customIntProperties.push_back(value);
         }
@@ -0,0 +1,784 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "particlezoo/Particle.h"
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Stores a batch of particles as contiguous columns (structure-of-arrays).
+     *
+     * Each basic particle quantity (type, kinetic energy, position, direction, weight and
+     * history information) is kept in its own contiguous array so that passes which only
+     * touch a few quantities over many particles stay cache friendly and can be vectorized.
+     *
+     * Additional properties (e.g. ZLAST, EGS LATCH, PENELOPE ILB values, IAEA extra floats
+     * and longs) are stored in optional columns which are only created once a particle
+     * carrying that property is added. Each optional column records whether the property
+     * was set for every particle in the block, so converting a block back into Particle
+     * objects is lossless.
+     */
+    class ParticleBlock {
+
+        public:
+
+            /**
+             * @brief An optional column holding one property for every particle in the block.
+             *
+             * @tparam T The value type stored in the column
+             * @tparam PropertyType The property enumeration the column corresponds to
+             */
+            template <typename T, typename PropertyType>
+            struct PropertyColumn {
+                PropertyType              type;     ///< The property type stored in this column (CUSTOM for custom columns)
+                std::vector<T>            values;   ///< The property value for each particle (default constructed when not set)
+                std::vector<std::uint8_t> isSet;    ///< Non-zero for each particle where the property was actually set
+            };
+
+            using IntColumn    = PropertyColumn<std::int32_t, IntPropertyType>;
+            using FloatColumn  = PropertyColumn<float, FloatPropertyType>;
+            using BoolColumn   = PropertyColumn<std::uint8_t, BoolPropertyType>;
+            using StringColumn = PropertyColumn<std::string, IntPropertyType>;
+
+            /**
+             * @brief Construct an empty particle block.
+             *
+             * @param capacity Number of particles to reserve storage for in the basic columns
+             */
+            explicit ParticleBlock(std::size_t capacity = 0);
+
+            /**
+             * @brief Get the number of particles in the block.
+             *
+             * @return std::size_t The number of particles
+             */
+            std::size_t size() const;
+
+            /**
+             * @brief Check if the block contains no particles.
+             *
+             * @return true if the block is empty
+             */
+            bool        empty() const;
+
+            /**
+             * @brief Get the number of particles the basic columns can hold without reallocating.
+             *
+             * @return std::size_t The reserved capacity
+             */
+            std::size_t capacity() const;
+
+            /**
+             * @brief Reserve storage in the basic columns for a number of particles.
+             *
+             * @param capacity The number of particles to reserve storage for
+             */
+            void        reserve(std::size_t capacity);
+
+            /**
+             * @brief Remove all particles from the block.
+             *
+             * The storage of the basic columns is kept so the block can be refilled without
+             * reallocating. Optional property columns are removed.
+             */
+            void        clear();
+
+            /**
+             * @brief Append a particle to the end of the block.
+             *
+             * Any property of the particle which does not yet have a column in the block
+             * creates a new column, with the property marked as not set for all particles
+             * already in the block.
+             *
+             * @param particle The particle to append
+             */
+            void        addParticle(const Particle & particle);
+
+            /**
+             * @brief Change the number of particles in the block.
+             *
+             * Intended for bulk decoders which fill the columns directly. Particles added by
+             * growing the block are default initialized in every basic column and marked as not
+             * having any of the optional properties already in the block.
+             *
+             * @param size The new number of particles
+             */
+            void        resize(std::size_t size);
+
+            /**
+             * @brief Keep only the selected particles from a given index on, removing the others.
+             *
+             * The particles before firstParticle are left as they are, and those kept from firstParticle
+             * on are moved down to follow them in their original order. Intended for bulk decoders which
+             * filter the particles after decoding them into the block. Every column is compacted, optional
+             * and custom ones included.
+             *
+             * @param firstParticle Index of the first particle the selection applies to, the particles before it are all kept
+             * @param keep Non-zero for each particle from firstParticle on which is to be kept, one entry for every such particle
+             * @throws std::invalid_argument if keep does not have one entry for every particle from firstParticle on
+             */
+            void        retainParticles(std::size_t firstParticle, std::span<const std::uint8_t> keep);
+
+            /**
+             * @brief Reconstruct the particle at a given index as a Particle object.
+             *
+             * @param index The index of the particle in the block
+             * @return Particle The particle, including all properties that were set for it
+             * @throws std::out_of_range if the index is out of range
+             */
+            Particle    getParticle(std::size_t index) const;
+
+            // Basic columns
+
+            /**
+             * @brief Get the particle type column.
+             *
+             * @return std::span<ParticleType> The particle types
+             */
+            std::span<ParticleType>        getTypes();
+
+            /**
+             * @brief Get the kinetic energy column.
+             *
+             * @return std::span<float> The kinetic energies
+             */
+            std::span<float>               getKineticEnergies();
+
+            /**
+             * @brief Get the X position column.
+             *
+             * @return std::span<float> The X positions
+             */
+            std::span<float>               getXPositions();
+
+            /**
+             * @brief Get the Y position column.
+             *
+             * @return std::span<float> The Y positions
+             */
+            std::span<float>               getYPositions();
+
+            /**
+             * @brief Get the Z position column.
+             *
+             * @return std::span<float> The Z positions
+             */
+            std::span<float>               getZPositions();
+
+            /**
+             * @brief Get the X directional cosine column.
+             *
+             * @return std::span<float> The X directional cosines
+             */
+            std::span<float>               getDirectionalCosinesX();
+
+            /**
+             * @brief Get the Y directional cosine column.
+             *
+             * @return std::span<float> The Y directional cosines
+             */
+            std::span<float>               getDirectionalCosinesY();
+
+            /**
+             * @brief Get the Z directional cosine column.
+             *
+             * @return std::span<float> The Z directional cosines
+             */
+            std::span<float>               getDirectionalCosinesZ();
+
+            /**
+             * @brief Get the statistical weight column.
+             *
+             * @return std::span<float> The weights
+             */
+            std::span<float>               getWeights();
+
+            /**
+             * @brief Get the new history flag column.
+             *
+             * @return std::span<std::uint8_t> Non-zero for each particle that starts a new history
+             */
+            std::span<std::uint8_t>        getNewHistoryFlags();
+
+            /**
+             * @brief Get the incremental history column.
+             *
+             * Holds the number of histories each particle advances the history count by,
+             * which is 0 for particles that do not start a new history.
+             *
+             * @return std::span<std::uint32_t> The incremental history numbers
+             */
+            std::span<std::uint32_t>       getIncrementalHistories();
+
+            std::span<const ParticleType>  getTypes() const;                 ///< @brief Get the particle type column (read-only).
+            std::span<const float>         getKineticEnergies() const;       ///< @brief Get the kinetic energy column (read-only).
+            std::span<const float>         getXPositions() const;            ///< @brief Get the X position column (read-only).
+            std::span<const float>         getYPositions() const;            ///< @brief Get the Y position column (read-only).
+            std::span<const float>         getZPositions() const;            ///< @brief Get the Z position column (read-only).
+            std::span<const float>         getDirectionalCosinesX() const;   ///< @brief Get the X directional cosine column (read-only).
+            std::span<const float>         getDirectionalCosinesY() const;   ///< @brief Get the Y directional cosine column (read-only).
+            std::span<const float>         getDirectionalCosinesZ() const;   ///< @brief Get the Z directional cosine column (read-only).
+            std::span<const float>         getWeights() const;               ///< @brief Get the statistical weight column (read-only).
+            std::span<const std::uint8_t>  getNewHistoryFlags() const;       ///< @brief Get the new history flag column (read-only).
+            std::span<const std::uint32_t> getIncrementalHistories() const;  ///< @brief Get the incremental history column (read-only).
+
+            // Optional property columns
+
+            /**
+             * @brief Check if the block has a column for an integer property.
+             *
+             * @param type The integer property type
+             * @return true if at least one particle in the block has the property
+             */
+            bool               hasIntColumn(IntPropertyType type) const;
+
+            /**
+             * @brief Check if the block has a column for a float property.
+             *
+             * @param type The float property type
+             * @return true if at least one particle in the block has the property
+             */
+            bool               hasFloatColumn(FloatPropertyType type) const;
+
+            /**
+             * @brief Check if the block has a column for a boolean property.
+             *
+             * @param type The boolean property type
+             * @return true if at least one particle in the block has the property
+             */
+            bool               hasBoolColumn(BoolPropertyType type) const;
+
+            /**
+             * @brief Get the column for an integer property.
+             *
+             * @param type The integer property type
+             * @return const IntColumn& The column
+             * @throws std::invalid_argument if the block has no column for the property
+             */
+            const IntColumn&   getIntColumn(IntPropertyType type) const;
+
+            /**
+             * @brief Get the column for a float property.
+             *
+             * @param type The float property type
+             * @return const FloatColumn& The column
+             * @throws std::invalid_argument if the block has no column for the property
+             */
+            const FloatColumn& getFloatColumn(FloatPropertyType type) const;
+
+            /**
+             * @brief Get the column for a boolean property.
+             *
+             * @param type The boolean property type
+             * @return const BoolColumn& The column
+             * @throws std::invalid_argument if the block has no column for the property
+             */
+            const BoolColumn&  getBoolColumn(BoolPropertyType type) const;
+
+            /**
+             * @brief Get the column for a well defined integer property, adding it if necessary.
+             *
+             * A newly added column marks the property as not set for every particle in the block.
+             *
+             * @param type The integer property type (must not be CUSTOM)
+             * @return IntColumn& The column, which may be filled in place
+             * @throws std::invalid_argument if the type is CUSTOM or INVALID
+             */
+            IntColumn&         addIntColumn(IntPropertyType type);
+
+            /**
+             * @brief Get the column for a well defined float property, adding it if necessary.
+             *
+             * A newly added column marks the property as not set for every particle in the block.
+             *
+             * @param type The float property type (must not be CUSTOM)
+             * @return FloatColumn& The column, which may be filled in place
+             * @throws std::invalid_argument if the type is CUSTOM or INVALID
+             */
+            FloatColumn&       addFloatColumn(FloatPropertyType type);
+
+            /**
+             * @brief Get the column for a well defined boolean property, adding it if necessary.
+             *
+             * A newly added column marks the property as not set for every particle in the block.
+             *
+             * @param type The boolean property type (must not be CUSTOM)
+             * @return BoolColumn& The column, which may be filled in place
+             * @throws std::invalid_argument if the type is CUSTOM or INVALID
+             */
+            BoolColumn&        addBoolColumn(BoolPropertyType type);
+
+            /**
+             * @brief Add a custom integer property column after the existing ones.
+             *
+             * For bulk decoders which restore the custom properties of the particles by position.
+             * The new column marks the property as not set for every particle in the block.
+             *
+             * @return IntColumn& The column, which may be filled in place
+             */
+            IntColumn&         addCustomIntColumn();
+
+            /**
+             * @brief Add a custom float property column after the existing ones.
+             *
+             * @return FloatColumn& The column, which may be filled in place
+             */
+            FloatColumn&       addCustomFloatColumn();
+
+            /**
+             * @brief Add a custom boolean property column after the existing ones.
+             *
+             * @return BoolColumn& The column, which may be filled in place
+             */
+            BoolColumn&        addCustomBoolColumn();
+
+            /**
+             * @brief Add a custom string property column after the existing ones.
+             *
+             * @return StringColumn& The column, which may be filled in place
+             */
+            StringColumn&      addCustomStringColumn();
+
+            /**
+             * @brief Get all well defined integer property columns.
+             *
+             * @return const std::vector<IntColumn>& The columns, in the order they were created
+             */
+            const std::vector<IntColumn>&    getIntColumns() const;
+
+            /**
+             * @brief Get all well defined float property columns.
+             *
+             * @return const std::vector<FloatColumn>& The columns, in the order they were created
+             */
+            const std::vector<FloatColumn>&  getFloatColumns() const;
+
+            /**
+             * @brief Get all well defined boolean property columns.
+             *
+             * @return const std::vector<BoolColumn>& The columns, in the order they were created
+             */
+            const std::vector<BoolColumn>&   getBoolColumns() const;
+
+            /**
+             * @brief Get the custom integer property columns.
+             *
+             * Column i holds the i-th custom integer property of each particle.
+             *
+             * @return const std::vector<IntColumn>& The custom columns
+             */
+            const std::vector<IntColumn>&    getCustomIntColumns() const;
+
+            /**
+             * @brief Get the custom float property columns.
+             *
+             * Column i holds the i-th custom float property of each particle.
+             *
+             * @return const std::vector<FloatColumn>& The custom columns
+             */
+            const std::vector<FloatColumn>&  getCustomFloatColumns() const;
+
+            /**
+             * @brief Get the custom boolean property columns.
+             *
+             * Column i holds the i-th custom boolean property of each particle.
+             *
+             * @return const std::vector<BoolColumn>& The custom columns
+             */
+            const std::vector<BoolColumn>&   getCustomBoolColumns() const;
+
+            /**
+             * @brief Get the custom string property columns.
+             *
+             * Column i holds the i-th custom string property of each particle.
+             *
+             * @return const std::vector<StringColumn>& The custom columns
+             */
+            const std::vector<StringColumn>& getCustomStringColumns() const;
+
+        private:
+
+            template <typename Column>
+            static Column & findOrAddColumn(std::vector<Column> & columns, decltype(Column::type) type, std::size_t existingParticles);
+
+            template <typename Column, typename T>
+            static void     appendToColumn(Column & column, const T & value, bool isSet);
+
+            template <typename Column, typename Values>
+            static void     appendCustomValues(std::vector<Column> & columns, const Values & values, decltype(Column::type) customType, std::size_t existingParticles);
+
+            template <typename Column>
+            static Column & addCustomColumn(std::vector<Column> & columns, decltype(Column::type) customType, std::size_t existingParticles);
+
+            template <typename Column>
+            static void     resizeColumns(std::vector<Column> & columns, std::size_t size);
+
+            template <typename T>
+            static void     retainValues(std::vector<T> & values, std::size_t firstParticle, std::span<const std::uint8_t> keep);
+
+            template <typename Column>
+            static void     retainInColumns(std::vector<Column> & columns, std::size_t firstParticle, std::span<const std::uint8_t> keep);
+
+            template <typename Column>
+            static const Column * findColumn(const std::vector<Column> & columns, decltype(Column::type) type);
+
+            std::vector<ParticleType>  types_;
+            std::vector<float>         kineticEnergies_;
+            std::vector<float>         x_;
+            std::vector<float>         y_;
+            std::vector<float>         z_;
+            std::vector<float>         px_;
+            std::vector<float>         py_;
+            std::vector<float>         pz_;
+            std::vector<float>         weights_;
+            std::vector<std::uint8_t>  isNewHistory_;
+            std::vector<std::uint32_t> incrementalHistories_;
+
+            std::vector<IntColumn>     intColumns_;
+            std::vector<FloatColumn>   floatColumns_;
+            std::vector<BoolColumn>    boolColumns_;
+            std::vector<IntColumn>     customIntColumns_;
+            std::vector<FloatColumn>   customFloatColumns_;
+            std::vector<BoolColumn>    customBoolColumns_;
+            std::vector<StringColumn>  customStringColumns_;
+    };
+
+
+    /* Implementation of ParticleBlock class methods */
+
+    inline ParticleBlock::ParticleBlock(std::size_t capacity) {
+        reserve(capacity);
+    }
+
+    inline std::size_t ParticleBlock::size() const { return types_.size(); }
+    inline bool ParticleBlock::empty() const { return types_.empty(); }
+    inline std::size_t ParticleBlock::capacity() const { return types_.capacity(); }
+
+    inline void ParticleBlock::reserve(std::size_t capacity) {
+        types_.reserve(capacity);
+        kineticEnergies_.reserve(capacity);
+        x_.reserve(capacity);
+        y_.reserve(capacity);
+        z_.reserve(capacity);
+        px_.reserve(capacity);
+        py_.reserve(capacity);
+        pz_.reserve(capacity);
+        weights_.reserve(capacity);
+        isNewHistory_.reserve(capacity);
+        incrementalHistories_.reserve(capacity);
+    }
+
+    inline void ParticleBlock::clear() {
+        types_.clear();
+        kineticEnergies_.clear();
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        px_.clear();
+        py_.clear();
+        pz_.clear();
+        weights_.clear();
+        isNewHistory_.clear();
+        incrementalHistories_.clear();
+        intColumns_.clear();
+        floatColumns_.clear();
+        boolColumns_.clear();
+        customIntColumns_.clear();
+        customFloatColumns_.clear();
+        customBoolColumns_.clear();
+        customStringColumns_.clear();
+    }
+
+    template <typename Column>
+    inline Column & ParticleBlock::findOrAddColumn(std::vector<Column> & columns, decltype(Column::type) type, std::size_t existingParticles) {
+        for (Column & column : columns) {
+            if (column.type == type) return column;
+        }
+        // particles already in the block do not have this property
+        Column & column = columns.emplace_back();
+        column.type = type;
+        column.values.resize(existingParticles);
+        column.isSet.resize(existingParticles, 0);
+        return column;
+    }
+
+    template <typename Column, typename T>
+    inline void ParticleBlock::appendToColumn(Column & column, const T & value, bool isSet) {
+        column.values.push_back(value);
+        column.isSet.push_back(isSet ? 1 : 0);
+    }
+
+    template <typename Column, typename Values>
+    inline void ParticleBlock::appendCustomValues(std::vector<Column> & columns, const Values & values, decltype(Column::type) customType, std::size_t existingParticles) {
+        while (columns.size() < values.size()) {
+            addCustomColumn(columns, customType, existingParticles);
+        }
+        for (std::size_t i = 0; i < columns.size(); i++) {
+            if (i < values.size()) {
+                appendToColumn(columns[i], values[i], true);
+            } else {
+                appendToColumn(columns[i], typename decltype(Column::values)::value_type{}, false);
+            }
+        }
+    }
+
+    template <typename Column>
+    inline Column & ParticleBlock::addCustomColumn(std::vector<Column> & columns, decltype(Column::type) customType, std::size_t existingParticles) {
+        Column & column = columns.emplace_back();
+        column.type = customType;
+        column.values.resize(existingParticles);
+        column.isSet.resize(existingParticles, 0);
+        return column;
+    }
+
+    template <typename Column>
+    inline void ParticleBlock::resizeColumns(std::vector<Column> & columns, std::size_t size) {
+        for (Column & column : columns) {
+            column.values.resize(size);
+            column.isSet.resize(size, 0);
+        }
+    }
+
+    template <typename T>
+    inline void ParticleBlock::retainValues(std::vector<T> & values, std::size_t firstParticle, std::span<const std::uint8_t> keep) {
+        std::size_t kept = firstParticle;
+        for (std::size_t i = 0; i < keep.size(); i++) {
+            if (!keep[i]) continue;
+            if (kept != firstParticle + i) values[kept] = std::move(values[firstParticle + i]);
+            kept++;
+        }
+        values.resize(kept);
+    }
+
+    template <typename Column>
+    inline void ParticleBlock::retainInColumns(std::vector<Column> & columns, std::size_t firstParticle, std::span<const std::uint8_t> keep) {
+        for (Column & column : columns) {
+            retainValues(column.values, firstParticle, keep);
+            retainValues(column.isSet, firstParticle, keep);
+        }
+    }
+
+    template <typename Column>
+    inline const Column * ParticleBlock::findColumn(const std::vector<Column> & columns, decltype(Column::type) type) {
+        for (const Column & column : columns) {
+            if (column.type == type) return &column;
+        }
+        return nullptr;
+    }
+
+    inline void ParticleBlock::addParticle(const Particle & particle) {
+        const std::size_t existingParticles = size();
+
+        types_.push_back(particle.getType());
+        kineticEnergies_.push_back(particle.getKineticEnergy());
+        x_.push_back(particle.getX());
+        y_.push_back(particle.getY());
+        z_.push_back(particle.getZ());
+        px_.push_back(particle.getDirectionalCosineX());
+        py_.push_back(particle.getDirectionalCosineY());
+        pz_.push_back(particle.getDirectionalCosineZ());
+        weights_.push_back(particle.getWeight());
+        isNewHistory_.push_back(particle.isNewHistory() ? 1 : 0);
+        incrementalHistories_.push_back(particle.getIncrementalHistories());
+
+        // create columns for any well defined properties of this particle not yet in the block
+        for (int t = static_cast<int>(IntPropertyType::INVALID) + 1; t < static_cast<int>(IntPropertyType::CUSTOM); t++) {
+            IntPropertyType type = static_cast<IntPropertyType>(t);
+            if (particle.hasIntProperty(type)) findOrAddColumn(intColumns_, type, existingParticles);
+        }
+        for (int t = static_cast<int>(FloatPropertyType::INVALID) + 1; t < static_cast<int>(FloatPropertyType::CUSTOM); t++) {
+            FloatPropertyType type = static_cast<FloatPropertyType>(t);
+            if (particle.hasFloatProperty(type)) findOrAddColumn(floatColumns_, type, existingParticles);
+        }
+        for (int t = static_cast<int>(BoolPropertyType::INVALID) + 1; t < static_cast<int>(BoolPropertyType::CUSTOM); t++) {
+            BoolPropertyType type = static_cast<BoolPropertyType>(t);
+            if (particle.hasBoolProperty(type)) findOrAddColumn(boolColumns_, type, existingParticles);
+        }
+
+        // append this particle's value to every well defined property column
+        for (IntColumn & column : intColumns_) {
+            bool isSet = particle.hasIntProperty(column.type);
+            appendToColumn(column, isSet ? particle.getIntProperty(column.type) : 0, isSet);
+        }
+        for (FloatColumn & column : floatColumns_) {
+            bool isSet = particle.hasFloatProperty(column.type);
+            appendToColumn(column, isSet ? particle.getFloatProperty(column.type) : 0.f, isSet);
+        }
+        for (BoolColumn & column : boolColumns_) {
+            bool isSet = particle.hasBoolProperty(column.type);
+            appendToColumn(column, static_cast<std::uint8_t>(isSet && particle.getBoolProperty(column.type) ? 1 : 0), isSet);
+        }
+
+        // append custom properties by position
+        appendCustomValues(customIntColumns_, particle.getCustomIntProperties(), IntPropertyType::CUSTOM, existingParticles);
+        appendCustomValues(customFloatColumns_, particle.getCustomFloatProperties(), FloatPropertyType::CUSTOM, existingParticles);
+        appendCustomValues(customBoolColumns_, particle.getCustomBoolProperties(), BoolPropertyType::CUSTOM, existingParticles);
+        appendCustomValues(customStringColumns_, particle.getCustomStringProperties(), IntPropertyType::CUSTOM, existingParticles);
+    }
+
+    inline void ParticleBlock::resize(std::size_t size) {
+        types_.resize(size, ParticleType::Unsupported);
+        kineticEnergies_.resize(size);
+        x_.resize(size);
+        y_.resize(size);
+        z_.resize(size);
+        px_.resize(size);
+        py_.resize(size);
+        pz_.resize(size);
+        weights_.resize(size);
+        isNewHistory_.resize(size);
+        incrementalHistories_.resize(size);
+        resizeColumns(intColumns_, size);
+        resizeColumns(floatColumns_, size);
+        resizeColumns(boolColumns_, size);
+        resizeColumns(customIntColumns_, size);
+        resizeColumns(customFloatColumns_, size);
+        resizeColumns(customBoolColumns_, size);
+        resizeColumns(customStringColumns_, size);
+    }
+
+    inline void ParticleBlock::retainParticles(std::size_t firstParticle, std::span<const std::uint8_t> keep) {
+        if (firstParticle > size() || keep.size() != size() - firstParticle) {
+            throw std::invalid_argument("ParticleBlock::retainParticles() needs one entry for every particle from the first one selected.");
+        }
+        retainValues(types_, firstParticle, keep);
+        retainValues(kineticEnergies_, firstParticle, keep);
+        retainValues(x_, firstParticle, keep);
+        retainValues(y_, firstParticle, keep);
+        retainValues(z_, firstParticle, keep);
+        retainValues(px_, firstParticle, keep);
+        retainValues(py_, firstParticle, keep);
+        retainValues(pz_, firstParticle, keep);
+        retainValues(weights_, firstParticle, keep);
+        retainValues(isNewHistory_, firstParticle, keep);
+        retainValues(incrementalHistories_, firstParticle, keep);
+        retainInColumns(intColumns_, firstParticle, keep);
+        retainInColumns(floatColumns_, firstParticle, keep);
+        retainInColumns(boolColumns_, firstParticle, keep);
+        retainInColumns(customIntColumns_, firstParticle, keep);
+        retainInColumns(customFloatColumns_, firstParticle, keep);
+        retainInColumns(customBoolColumns_, firstParticle, keep);
+        retainInColumns(customStringColumns_, firstParticle, keep);
+    }
+
+    inline Particle ParticleBlock::getParticle(std::size_t index) const {
+        if (index >= size()) {
+            throw std::out_of_range("Particle index out of range in ParticleBlock.");
+        }
+
+        // The directional cosines are set as they are stored, normalizing them again could change them in the last place
+        Particle particle(types_[index], kineticEnergies_[index], x_[index], y_[index], z_[index], 0.f, 0.f, 0.f, isNewHistory_[index] != 0, weights_[index]);
+        particle.setDirectionalCosineX(px_[index]);
+        particle.setDirectionalCosineY(py_[index]);
+        particle.setDirectionalCosineZ(pz_[index]);
+
+        for (const IntColumn & column : intColumns_) {
+            if (column.isSet[index]) particle.setIntProperty(column.type, column.values[index]);
+        }
+        // the basic incremental history column takes precedence in case it has been modified in place
+        if (isNewHistory_[index] && incrementalHistories_[index] > 0 && incrementalHistories_[index] != particle.getIncrementalHistories()) {
+            particle.setIncrementalHistories(incrementalHistories_[index]);
+        }
+        for (const FloatColumn & column : floatColumns_) {
+            if (column.isSet[index]) particle.setFloatProperty(column.type, column.values[index]);
+        }
+        for (const BoolColumn & column : boolColumns_) {
+            if (column.isSet[index]) particle.setBoolProperty(column.type, column.values[index] != 0);
+        }
+        for (const IntColumn & column : customIntColumns_) {
+            if (column.isSet[index]) particle.setIntProperty(IntPropertyType::CUSTOM, column.values[index]);
+        }
+        for (const FloatColumn & column : customFloatColumns_) {
+            if (column.isSet[index]) particle.setFloatProperty(FloatPropertyType::CUSTOM, column.values[index]);
+        }
+        for (const BoolColumn & column : customBoolColumns_) {
+            if (column.isSet[index]) particle.setBoolProperty(BoolPropertyType::CUSTOM, column.values[index] != 0);
+        }
+        for (const StringColumn & column : customStringColumns_) {
+            if (column.isSet[index]) particle.setStringProperty(column.values[index]);
+        }
+
+        return particle;
+    }
+
+    inline std::span<ParticleType> ParticleBlock::getTypes() { return types_; }
+    inline std::span<float> ParticleBlock::getKineticEnergies() { return kineticEnergies_; }
+    inline std::span<float> ParticleBlock::getXPositions() { return x_; }
+    inline std::span<float> ParticleBlock::getYPositions() { return y_; }
+    inline std::span<float> ParticleBlock::getZPositions() { return z_; }
+    inline std::span<float> ParticleBlock::getDirectionalCosinesX() { return px_; }
+    inline std::span<float> ParticleBlock::getDirectionalCosinesY() { return py_; }
+    inline std::span<float> ParticleBlock::getDirectionalCosinesZ() { return pz_; }
+    inline std::span<float> ParticleBlock::getWeights() { return weights_; }
+    inline std::span<std::uint8_t> ParticleBlock::getNewHistoryFlags() { return isNewHistory_; }
+    inline std::span<std::uint32_t> ParticleBlock::getIncrementalHistories() { return incrementalHistories_; }
+
+    inline std::span<const ParticleType> ParticleBlock::getTypes() const { return types_; }
+    inline std::span<const float> ParticleBlock::getKineticEnergies() const { return kineticEnergies_; }
+    inline std::span<const float> ParticleBlock::getXPositions() const { return x_; }
+    inline std::span<const float> ParticleBlock::getYPositions() const { return y_; }
+    inline std::span<const float> ParticleBlock::getZPositions() const { return z_; }
+    inline std::span<const float> ParticleBlock::getDirectionalCosinesX() const { return px_; }
+    inline std::span<const float> ParticleBlock::getDirectionalCosinesY() const { return py_; }
+    inline std::span<const float> ParticleBlock::getDirectionalCosinesZ() const { return pz_; }
+    inline std::span<const float> ParticleBlock::getWeights() const { return weights_; }
+    inline std::span<const std::uint8_t> ParticleBlock::getNewHistoryFlags() const { return isNewHistory_; }
+    inline std::span<const std::uint32_t> ParticleBlock::getIncrementalHistories() const { return incrementalHistories_; }
+
+    inline bool ParticleBlock::hasIntColumn(IntPropertyType type) const { return findColumn(intColumns_, type) != nullptr; }
+    inline bool ParticleBlock::hasFloatColumn(FloatPropertyType type) const { return findColumn(floatColumns_, type) != nullptr; }
+    inline bool ParticleBlock::hasBoolColumn(BoolPropertyType type) const { return findColumn(boolColumns_, type) != nullptr; }
+
+    inline const ParticleBlock::IntColumn & ParticleBlock::getIntColumn(IntPropertyType type) const {
+        const IntColumn * column = findColumn(intColumns_, type);
+        if (!column) throw std::invalid_argument("ParticleBlock has no column for the requested integer property type.");
+        return *column;
+    }
+
+    inline const ParticleBlock::FloatColumn & ParticleBlock::getFloatColumn(FloatPropertyType type) const {
+        const FloatColumn * column = findColumn(floatColumns_, type);
+        if (!column) throw std::invalid_argument("ParticleBlock has no column for the requested float property type.");
+        return *column;
+    }
+
+    inline const ParticleBlock::BoolColumn & ParticleBlock::getBoolColumn(BoolPropertyType type) const {
+        const BoolColumn * column = findColumn(boolColumns_, type);
+        if (!column) throw std::invalid_argument("ParticleBlock has no column for the requested boolean property type.");
+        return *column;
+    }
+
+    inline ParticleBlock::IntColumn & ParticleBlock::addIntColumn(IntPropertyType type) {
+        if (type == IntPropertyType::INVALID || type == IntPropertyType::CUSTOM) throw std::invalid_argument("ParticleBlock columns can only be added for well defined integer property types.");
+        return findOrAddColumn(intColumns_, type, size());
+    }
+
+    inline ParticleBlock::FloatColumn & ParticleBlock::addFloatColumn(FloatPropertyType type) {
+        if (type == FloatPropertyType::INVALID || type == FloatPropertyType::CUSTOM) throw std::invalid_argument("ParticleBlock columns can only be added for well defined float property types.");
+        return findOrAddColumn(floatColumns_, type, size());
+    }
+
+    inline ParticleBlock::BoolColumn & ParticleBlock::addBoolColumn(BoolPropertyType type) {
+        if (type == BoolPropertyType::INVALID || type == BoolPropertyType::CUSTOM) throw std::invalid_argument("ParticleBlock columns can only be added for well defined boolean property types.");
+        return findOrAddColumn(boolColumns_, type, size());
+    }
+
+    inline ParticleBlock::IntColumn & ParticleBlock::addCustomIntColumn() { return addCustomColumn(customIntColumns_, IntPropertyType::CUSTOM, size()); }
+    inline ParticleBlock::FloatColumn & ParticleBlock::addCustomFloatColumn() { return addCustomColumn(customFloatColumns_, FloatPropertyType::CUSTOM, size()); }
+    inline ParticleBlock::BoolColumn & ParticleBlock::addCustomBoolColumn() { return addCustomColumn(customBoolColumns_, BoolPropertyType::CUSTOM, size()); }
+    inline ParticleBlock::StringColumn & ParticleBlock::addCustomStringColumn() { return addCustomColumn(customStringColumns_, IntPropertyType::CUSTOM, size()); }
+
+    inline const std::vector<ParticleBlock::IntColumn> & ParticleBlock::getIntColumns() const { return intColumns_; }
+    inline const std::vector<ParticleBlock::FloatColumn> & ParticleBlock::getFloatColumns() const { return floatColumns_; }
+    inline const std::vector<ParticleBlock::BoolColumn> & ParticleBlock::getBoolColumns() const { return boolColumns_; }
+    inline const std::vector<ParticleBlock::IntColumn> & ParticleBlock::getCustomIntColumns() const { return customIntColumns_; }
+    inline const std::vector<ParticleBlock::FloatColumn> & ParticleBlock::getCustomFloatColumns() const { return customFloatColumns_; }
+    inline const std::vector<ParticleBlock::BoolColumn> & ParticleBlock::getCustomBoolColumns() const { return customBoolColumns_; }
+    inline const std::vector<ParticleBlock::StringColumn> & ParticleBlock::getCustomStringColumns() const { return customStringColumns_; }
+
+} // namespace ParticleZoo
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
+#include "particlezoo/utilities/historyIndex.h"
+#include "particlezoo/utilities/units.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Criteria selecting the particles returned by a reader.
+     *
+     * A filter combines any number of criteria, all of which a particle must meet to be accepted:
+     * its type, a kinetic energy range, a box in space, a range of radial distances in the XY plane,
+     * a cone of directions, a range of generations and a set of EGS LATCH bits. A default
+     * constructed filter has no criteria and accepts every particle.
+     *
+     * Passing a filter to PhaseSpaceFileReader::readParticles() or
+     * PhaseSpaceFileReader::readParticleBlock() lets the reader test the criteria against the fields
+     * of each record as it is decoded, so that formats able to do so (see
+     * PhaseSpaceFileReader::rejectBinaryRecord()) never build the particles that are rejected. The
+     * field level tests below are what those readers use, so that a record is judged exactly as
+     * the particle decoded from it would be by accepts().
+     *
+     * All ranges are inclusive and in the internal units of the library (see units.h).
+     */
+    class ParticleFilter
+    {
+        public:
+            /**
+             * @brief Construct a filter accepting every particle.
+             */
+            ParticleFilter() = default;
+
+            /**
+             * @brief Accept particles of a given type.
+             *
+             * Once a type has been added only the types added are accepted, so several types can be
+             * accepted by calling this once for each.
+             *
+             * @param type The particle type to accept
+             */
+            void acceptParticleType(ParticleType type);
+
+            /**
+             * @brief Only accept particles with a kinetic energy within a range.
+             *
+             * @param minimum The smallest kinetic energy accepted
+             * @param maximum The largest kinetic energy accepted
+             * @throws std::invalid_argument if minimum is greater than maximum
+             */
+            void setKineticEnergyRange(float minimum, float maximum);
+
+            /**
+             * @brief Only accept particles with an X position within a range.
+             *
+             * @param minimum The smallest X position accepted
+             * @param maximum The largest X position accepted
+             * @throws std::invalid_argument if minimum is greater than maximum
+             */
+            void setXRange(float minimum, float maximum);
+
+            /**
+             * @brief Only accept particles with a Y position within a range.
+             *
+             * @param minimum The smallest Y position accepted
+             * @param maximum The largest Y position accepted
+             * @throws std::invalid_argument if minimum is greater than maximum
+             */
+            void setYRange(float minimum, float maximum);
+
+            /**
+             * @brief Only accept particles with a Z position within a range.
+             *
+             * @param minimum The smallest Z position accepted
+             * @param maximum The largest Z position accepted
+             * @throws std::invalid_argument if minimum is greater than maximum
+             */
+            void setZRange(float minimum, float maximum);
+
+            /**
+             * @brief Only accept particles with a radial distance from the Z axis within a range.
+             *
+             * @param minimum The smallest distance accepted
+             * @param maximum The largest distance accepted
+             * @throws std::invalid_argument if minimum is greater than maximum or negative
+             */
+            void setRadiusRange(float minimum, float maximum);
+
+            /**
+             * @brief Only accept particles travelling within a cone of directions.
+             *
+             * @param u X component of the axis of the cone, need not be normalized
+             * @param v Y component of the axis of the cone
+             * @param w Z component of the axis of the cone
+             * @param halfAngle Largest angle in radians accepted between the direction of a particle and the axis
+             * @throws std::invalid_argument if the axis is a null vector or the angle is negative
+             */
+            void setDirectionCone(float u, float v, float w, float halfAngle);
+
+            /**
+             * @brief Only accept particles with a generation within a range.
+             *
+             * Primary particles are generation 1. Particles of which the generation is not known
+             * (see IntPropertyType::GENERATION) are rejected.
+             *
+             * @param minimum The smallest generation accepted
+             * @param maximum The largest generation accepted
+             * @throws std::invalid_argument if minimum is greater than maximum or less than 1
+             */
+            void setGenerationRange(int minimum, int maximum);
+
+            /**
+             * @brief Only accept particles with all of the given EGS LATCH bits set.
+             *
+             * Particles without a LATCH value (see IntPropertyType::EGS_LATCH) are rejected, as by
+             * EGSphspFile::DoesParticlePassLATCHFilter().
+             *
+             * @param bits The bits which must all be set
+             */
+            void setRequiredLATCHBits(std::uint32_t bits);
+
+            /**
+             * @brief Check if the filter has no criteria.
+             *
+             * @return true if every particle is accepted
+             */
+            bool isEmpty() const;
+
+            bool usesParticleType() const;    ///< @brief Check if particles are selected by type.
+            bool usesKineticEnergy() const;   ///< @brief Check if particles are selected by kinetic energy.
+            bool usesPosition() const;        ///< @brief Check if particles are selected by position, in a box or by radius.
+            bool usesDirection() const;       ///< @brief Check if particles are selected by direction.
+            bool usesGeneration() const;      ///< @brief Check if particles are selected by generation.
+            bool usesLATCH() const;           ///< @brief Check if particles are selected by EGS LATCH bits.
+
+            bool acceptsParticleType(ParticleType type) const;                     ///< @brief Test the type of a particle.
+            bool acceptsKineticEnergy(float kineticEnergy) const;                  ///< @brief Test the kinetic energy of a particle.
+            bool acceptsPosition(float x, float y, float z) const;                 ///< @brief Test the position of a particle, against the box and the radius range.
+            bool acceptsDirection(float u, float v, float w) const;                ///< @brief Test the directional cosines of a particle.
+            bool acceptsGeneration(bool hasGeneration, std::int32_t generation) const; ///< @brief Test the generation of a particle, if it has one.
+            bool acceptsLATCH(bool hasLATCH, std::uint32_t LATCH) const;           ///< @brief Test the EGS LATCH value of a particle, if it has one.
+
+            /**
+             * @brief Test a particle against every criterion.
+             *
+             * @param particle The particle to test
+             * @return true if the particle meets all of the criteria
+             */
+            bool accepts(const Particle & particle) const;
+
+            /**
+             * @brief Test a particle held in a block against every criterion.
+             *
+             * @param block The block holding the particle
+             * @param index The index of the particle in the block
+             * @return true if the particle meets all of the criteria
+             */
+            bool accepts(const ParticleBlock & block, std::size_t index) const;
+
+            /**
+             * @brief Check if any record of a block of histories could be accepted, from its statistics.
+             *
+             * Only the type, kinetic energy and position criteria are tested against the ranges of the
+             * block, the others cannot rule out any record.
+             *
+             * @param statistics The statistics of the records of the block
+             * @return false if the filter is certain to reject every record of the block
+             */
+            bool mayAcceptAnyOf(const HistoryBlockStatistics & statistics) const;
+
+        private:
+            std::vector<ParticleType> particleTypes_;
+
+            bool  useKineticEnergy_{false};
+            float minimumKineticEnergy_{0.f};
+            float maximumKineticEnergy_{std::numeric_limits<float>::max()};
+
+            bool  useBox_{false};
+            float minimumX_{std::numeric_limits<float>::lowest()};
+            float maximumX_{std::numeric_limits<float>::max()};
+            float minimumY_{std::numeric_limits<float>::lowest()};
+            float maximumY_{std::numeric_limits<float>::max()};
+            float minimumZ_{std::numeric_limits<float>::lowest()};
+            float maximumZ_{std::numeric_limits<float>::max()};
+
+            bool  useRadius_{false};
+            float minimumRadius_{0.f};
+            float maximumRadius_{std::numeric_limits<float>::max()};
+
+            bool  useDirection_{false};
+            float axisU_{0.f};
+            float axisV_{0.f};
+            float axisW_{1.f};
+            float minimumCosine_{-1.f};
+
+            bool         useGeneration_{false};
+            std::int32_t minimumGeneration_{1};
+            std::int32_t maximumGeneration_{std::numeric_limits<std::int32_t>::max()};
+
+            bool          useLATCH_{false};
+            std::uint32_t requiredLATCHBits_{0};
+    };
+
+
+    /* Implementation of ParticleFilter class methods */
+
+    inline void ParticleFilter::acceptParticleType(ParticleType type) {
+        if (std::find(particleTypes_.begin(), particleTypes_.end(), type) == particleTypes_.end()) particleTypes_.push_back(type);
+    }
+
+    inline void ParticleFilter::setKineticEnergyRange(float minimum, float maximum) {
+        if (minimum > maximum) throw std::invalid_argument("The minimum kinetic energy of a filter cannot be greater than its maximum.");
+        useKineticEnergy_ = true;
+        minimumKineticEnergy_ = minimum;
+        maximumKineticEnergy_ = maximum;
+    }
+
+    inline void ParticleFilter::setXRange(float minimum, float maximum) {
+        if (minimum > maximum) throw std::invalid_argument("The minimum X position of a filter cannot be greater than its maximum.");
+        useBox_ = true;
+        minimumX_ = minimum;
+        maximumX_ = maximum;
+    }
+
+    inline void ParticleFilter::setYRange(float minimum, float maximum) {
+        if (minimum > maximum) throw std::invalid_argument("The minimum Y position of a filter cannot be greater than its maximum.");
+        useBox_ = true;
+        minimumY_ = minimum;
+        maximumY_ = maximum;
+    }
+
+    inline void ParticleFilter::setZRange(float minimum, float maximum) {
+        if (minimum > maximum) throw std::invalid_argument("The minimum Z position of a filter cannot be greater than its maximum.");
+        useBox_ = true;
+        minimumZ_ = minimum;
+        maximumZ_ = maximum;
+    }
+
+    inline void ParticleFilter::setRadiusRange(float minimum, float maximum) {
+        if (minimum > maximum || minimum < 0.f) throw std::invalid_argument("The radius range of a filter must not be negative and its minimum cannot be greater than its maximum.");
+        useRadius_ = true;
+        minimumRadius_ = minimum;
+        maximumRadius_ = maximum;
+    }
+
+    inline void ParticleFilter::setDirectionCone(float u, float v, float w, float halfAngle) {
+        const float norm = std::sqrt(u*u + v*v + w*w);
+        if (!(norm > 0.f)) throw std::invalid_argument("The axis of the direction cone of a filter cannot be a null vector.");
+        if (halfAngle < 0.f) throw std::invalid_argument("The half angle of the direction cone of a filter cannot be negative.");
+        useDirection_ = true;
+        axisU_ = u / norm;
+        axisV_ = v / norm;
+        axisW_ = w / norm;
+        minimumCosine_ = std::cos(std::min(halfAngle, PI));
+    }
+
+    inline void ParticleFilter::setGenerationRange(int minimum, int maximum) {
+        if (minimum > maximum || minimum < 1) throw std::invalid_argument("Invalid generation range for a filter. Ensure that min <= max and that min is at least 1.");
+        useGeneration_ = true;
+        minimumGeneration_ = minimum;
+        maximumGeneration_ = maximum;
+    }
+
+    inline void ParticleFilter::setRequiredLATCHBits(std::uint32_t bits) {
+        useLATCH_ = true;
+        requiredLATCHBits_ = bits;
+    }
+
+    inline bool ParticleFilter::isEmpty() const {
+        return !usesParticleType() && !useKineticEnergy_ && !usesPosition() && !useDirection_ && !useGeneration_ && !useLATCH_;
+    }
+
+    inline bool ParticleFilter::usesParticleType() const { return !particleTypes_.empty(); }
+    inline bool ParticleFilter::usesKineticEnergy() const { return useKineticEnergy_; }
+    inline bool ParticleFilter::usesPosition() const { return useBox_ || useRadius_; }
+    inline bool ParticleFilter::usesDirection() const { return useDirection_; }
+    inline bool ParticleFilter::usesGeneration() const { return useGeneration_; }
+    inline bool ParticleFilter::usesLATCH() const { return useLATCH_; }
+
+    inline bool ParticleFilter::acceptsParticleType(ParticleType type) const {
+        return particleTypes_.empty() || std::find(particleTypes_.begin(), particleTypes_.end(), type) != particleTypes_.end();
+    }
+
+    inline bool ParticleFilter::acceptsKineticEnergy(float kineticEnergy) const {
+        return !useKineticEnergy_ || (kineticEnergy >= minimumKineticEnergy_ && kineticEnergy <= maximumKineticEnergy_);
+    }
+
+    inline bool ParticleFilter::acceptsPosition(float x, float y, float z) const {
+        if (useBox_ && (x < minimumX_ || x > maximumX_ ||
+                        y < minimumY_ || y > maximumY_ ||
+                        z < minimumZ_ || z > maximumZ_)) {
+            return false;
+        }
+        if (useRadius_) {
+            const float radius = std::sqrt(x*x + y*y);
+            if (radius < minimumRadius_ || radius > maximumRadius_) return false;
+        }
+        return true;
+    }
+
+    inline bool ParticleFilter::acceptsDirection(float u, float v, float w) const {
+        return !useDirection_ || u*axisU_ + v*axisV_ + w*axisW_ >= minimumCosine_;
+    }
+
+    inline bool ParticleFilter::acceptsGeneration(bool hasGeneration, std::int32_t generation) const {
+        return !useGeneration_ || (hasGeneration && generation >= minimumGeneration_ && generation <= maximumGeneration_);
+    }
+
+    inline bool ParticleFilter::acceptsLATCH(bool hasLATCH, std::uint32_t LATCH) const {
+        return !useLATCH_ || (hasLATCH && (LATCH & requiredLATCHBits_) == requiredLATCHBits_);
+    }
+
+    inline bool ParticleFilter::accepts(const Particle & particle) const {
+        if (!acceptsParticleType(particle.getType())) return false;
+        if (!acceptsKineticEnergy(particle.getKineticEnergy())) return false;
+        if (usesPosition() && !acceptsPosition(particle.getX(), particle.getY(), particle.getZ())) return false;
+        if (!acceptsDirection(particle.getDirectionalCosineX(), particle.getDirectionalCosineY(), particle.getDirectionalCosineZ())) return false;
+        if (useGeneration_) {
+            const bool hasGeneration = particle.hasIntProperty(IntPropertyType::GENERATION);
+            if (!acceptsGeneration(hasGeneration, hasGeneration ? particle.getIntProperty(IntPropertyType::GENERATION) : 0)) return false;
+        }
+        if (useLATCH_) {
+            const bool hasLATCH = particle.hasIntProperty(IntPropertyType::EGS_LATCH);
+            if (!acceptsLATCH(hasLATCH, hasLATCH ? static_cast<std::uint32_t>(particle.getIntProperty(IntPropertyType::EGS_LATCH)) : 0)) return false;
+        }
+        return true;
+    }
+
+    inline bool ParticleFilter::accepts(const ParticleBlock & block, std::size_t index) const {
+        if (!acceptsParticleType(block.getTypes()[index])) return false;
+        if (!acceptsKineticEnergy(block.getKineticEnergies()[index])) return false;
+        if (usesPosition() && !acceptsPosition(block.getXPositions()[index], block.getYPositions()[index], block.getZPositions()[index])) return false;
+        if (!acceptsDirection(block.getDirectionalCosinesX()[index], block.getDirectionalCosinesY()[index], block.getDirectionalCosinesZ()[index])) return false;
+        if (useGeneration_) {
+            const ParticleBlock::IntColumn * column = block.hasIntColumn(IntPropertyType::GENERATION) ? &block.getIntColumn(IntPropertyType::GENERATION) : nullptr;
+            const bool hasGeneration = column && column->isSet[index];
+            if (!acceptsGeneration(hasGeneration, hasGeneration ? column->values[index] : 0)) return false;
+        }
+        if (useLATCH_) {
+            const ParticleBlock::IntColumn * column = block.hasIntColumn(IntPropertyType::EGS_LATCH) ? &block.getIntColumn(IntPropertyType::EGS_LATCH) : nullptr;
+            const bool hasLATCH = column && column->isSet[index];
+            if (!acceptsLATCH(hasLATCH, hasLATCH ? static_cast<std::uint32_t>(column->values[index]) : 0)) return false;
+        }
+        return true;
+    }
+
+    inline bool ParticleFilter::mayAcceptAnyOf(const HistoryBlockStatistics & statistics) const {
+        if (usesParticleType()) {
+            std::uint64_t acceptedTypes = 0;
+            for (ParticleType type : particleTypes_) acceptedTypes |= HistoryBlockStatistics::ParticleTypeBit(type);
+            if ((statistics.particleTypes & acceptedTypes) == 0) return false;
+        }
+        if (useKineticEnergy_ && (statistics.maxEnergy < minimumKineticEnergy_ || statistics.minEnergy > maximumKineticEnergy_)) return false;
+        if (useBox_ && (statistics.maxX < minimumX_ || statistics.minX > maximumX_ ||
+                        statistics.maxY < minimumY_ || statistics.minY > maximumY_ ||
+                        statistics.maxZ < minimumZ_ || statistics.minZ > maximumZ_)) {
+            return false;
+        }
+        if (useRadius_) {
+            // The radii of the records lie between those of the nearest and farthest points of the XY bounding box
+            const float nearestX = std::clamp(0.f, statistics.minX, statistics.maxX);
+            const float nearestY = std::clamp(0.f, statistics.minY, statistics.maxY);
+            const float farthestX = std::max(std::abs(statistics.minX), std::abs(statistics.maxX));
+            const float farthestY = std::max(std::abs(statistics.minY), std::abs(statistics.maxY));
+            if (std::sqrt(nearestX*nearestX + nearestY*nearestY) > maximumRadius_) return false;
+            if (std::sqrt(farthestX*farthestX + farthestY*farthestY) < minimumRadius_) return false;
+        }
+        return true;
+    }
+
+} // namespace ParticleZoo
@@ -2,16 +2,35 @@
 
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <cstdint>
-#include <list>
 #include <vector>
+#include <span>
+#include <memory>
+#include <optional>
+#include <limits>
 
 #include "particlezoo/utilities/argParse.h"
 #include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
+#include "particlezoo/ParticleFilter.h"
 #include "particlezoo/ByteBuffer.h"
+#include "particlezoo/utilities/memoryMap.h"
+#include "particlezoo/utilities/prefetch.h"
+#include "particlezoo/utilities/historyIndex.h"
+#include "particlezoo/utilities/spatialIndex.h"
+#include "particlezoo/utilities/inputFileStream.h"
+#include "particlezoo/utilities/ioProfile.h"
 
 namespace ParticleZoo
 {
+    extern CLICommand MemoryMapCommand;
+    extern CLICommand SharedCacheCommand;
+    extern CLICommand SharedCacheDirectoryCommand;
+    extern CLICommand PrefetchCommand;
+    extern CLICommand PrefetchBlockSizeCommand;
+    extern CLICommand ReadBufferSizeCommand;
+    extern CLICommand InputHeaderCommand;
 
     /**
      * @brief Base class for reading phase space files
@@ -21,6 +40,14 @@ namespace ParticleZoo
      * ASCII file formats and provides functionality for particle iteration, statistics tracking,
      * and format-specific optimizations. In cases where I/O must be handled by a third-party
      * library (e.g., ROOT), this class also provides a framework for manually reading particles.
+     * 
+     * A file named "-" is read from standard input, once from start to end. It is neither
+     * memory mapped nor prefetched, moveToParticle() can only stay at the first particle, and
+     * its size is only known once all of it has been read. Formats with a header file of their
+     * own read it from the path given with InputHeaderCommand (--inputHeader) instead, once the
+     * first data has arrived. Since a program writing the input may only complete its header
+     * once it has finished (see PhaseSpaceFileWriter), the counts of the header are taken as
+     * provisional and the particles are read up to the end of the input.
      */
     class PhaseSpaceFileReader
     {
@@ -33,7 +60,8 @@ namespace ParticleZoo
              * @param userOptions User-defined options for reading behavior
              * @param formatType The format type (BINARY, ASCII, or NONE), defaults to BINARY
              * @param fixedValues Pre-defined constant values for certain particle properties
-             * @param bufferSize Size of the internal buffer for reading, defaults to DEFAULT_BUFFER_SIZE
+             * @param bufferSize Size of the internal buffer for reading, defaults to DEFAULT_BUFFER_SIZE unless set with ReadBufferSizeCommand (--readBufferSize)
+             * @throws std::runtime_error if the file cannot be opened or the buffer size set by the user is too small
              */
             PhaseSpaceFileReader(const std::string & phspFormat, const std::string & fileName, const UserOptions & userOptions, FormatType formatType = FormatType::BINARY, const FixedValues fixedValues = FixedValues(), unsigned int bufferSize = DEFAULT_BUFFER_SIZE);
             
@@ -59,12 +87,116 @@ namespace ParticleZoo
              * @brief Peek at the next particle without advancing the file position.
              * 
              * Reads the next particle but does not move the internal file pointer forward.
-             * This allows for inspecting the upcoming particle without consuming it.
+             * This allows for inspecting the upcoming particle without consuming it. Records
+             * read along with the particle, such as TOPAS pseudo-particles folded into it, are
+             * not consumed either.
              * 
              * @return Particle The next particle object containing position, momentum, energy, etc.
              */
             Particle              peekNextParticle();
 
+            /**
+             * @brief Read a batch of particles into caller-owned storage.
+             * 
+             * Fills the provided span with as many of the next particles as are available,
+             * up to the size of the span. For binary formats, all whole records currently held
+             * in the internal buffer are decoded in a single pass and the buffer is only refilled
+             * when it runs out, avoiding the per-particle bookkeeping of getNextParticle().
+             * Every particle returned is counted in the read statistics exactly as if it had been
+             * read with getNextParticle().
+             * 
+             * @param particles The storage to fill with the particles read
+             * @return std::size_t The number of particles actually read (less than particles.size() only at the end of the file)
+             */
+            std::size_t           readParticles(std::span<Particle> particles);
+
+            /**
+             * @brief Read up to a given number of particles from the phase space file.
+             * 
+             * Convenience wrapper around readParticles() which allocates the storage.
+             * 
+             * @param maxParticles The maximum number of particles to read
+             * @return std::vector<Particle> The particles read, which may be fewer than requested at the end of the file
+             */
+            std::vector<Particle> getNextParticles(std::size_t maxParticles);
+
+            /**
+             * @brief Read a batch of particles into a columnar particle block.
+             * 
+             * The block is cleared and then filled with up to maxParticles of the next particles
+             * in the file, following the same rules as readParticles(). Reusing the same block
+             * between calls avoids reallocating its columns.
+             * 
+             * @param block The block to fill
+             * @param maxParticles The maximum number of particles to read into the block
+             * @return std::size_t The number of particles read into the block
+             */
+            std::size_t           readParticleBlock(ParticleBlock & block, std::size_t maxParticles);
+
+            /**
+             * @brief Read a batch of the particles accepted by a filter into caller-owned storage.
+             * 
+             * Reads records until the span is filled with particles accepted by the filter or the end
+             * of the file is reached. Formats which can test the filter against the fields of a record
+             * (see rejectBinaryRecord()) skip the records it rejects without decoding them, the others
+             * decode every record and test the particle.
+             * 
+             * Every record read is counted in the read statistics, rejected or not, so
+             * getParticlesRead() and getHistoriesRead() still describe the whole part of the file read.
+             * The histories started by rejected particles are carried by the next particle accepted,
+             * which is marked as starting a new history with its incremental history number increased
+             * by the number of histories carried. Summing the incremental history numbers of the
+             * particles returned therefore gives the number of histories read up to the last of them,
+             * as if the rejected particles had been given to PhaseSpaceFileWriter::addAdditionalHistories().
+             * Histories of rejected particles after the last particle accepted are carried across calls
+             * until the reader is moved with moveToParticle().
+             * 
+             * If the file has a history index sidecar holding block statistics (see HistoryIndex and
+             * buildHistoryIndex()), binary and ASCII files are moved past whole blocks of histories in
+             * which the filter cannot accept any record, counting their records and histories from the
+             * index without reading them.
+             * 
+             * @param particles The storage to fill with the accepted particles
+             * @param filter The filter selecting the particles to return
+             * @return std::size_t The number of particles returned (less than particles.size() only at the end of the file)
+             */
+            std::size_t           readParticles(std::span<Particle> particles, const ParticleFilter & filter);
+
+            /**
+             * @brief Read up to a given number of the particles accepted by a filter.
+             * 
+             * Convenience wrapper around readParticles(std::span<Particle>, const ParticleFilter &) which allocates the storage.
+             * 
+             * @param maxParticles The maximum number of particles to return
+             * @param filter The filter selecting the particles to return
+             * @return std::vector<Particle> The accepted particles, which may be fewer than requested at the end of the file
+             */
+            std::vector<Particle> getNextParticles(std::size_t maxParticles, const ParticleFilter & filter);
+
+            /**
+             * @brief Read a batch of the particles accepted by a filter into a columnar particle block.
+             * 
+             * The block is cleared and then filled with up to maxParticles accepted particles, following
+             * the same rules as readParticles(std::span<Particle>, const ParticleFilter &). Formats with a
+             * batch decoder decode the records into the block and test the filter against its columns.
+             * 
+             * @param block The block to fill
+             * @param maxParticles The maximum number of particles to return in the block
+             * @param filter The filter selecting the particles to return
+             * @return std::size_t The number of particles returned in the block (less than maxParticles only at the end of the file)
+             */
+            std::size_t           readParticleBlock(ParticleBlock & block, std::size_t maxParticles, const ParticleFilter & filter);
+
+            /**
+             * @brief Get the number of particles rejected by the filters given to the reader.
+             * 
+             * Pseudo-particles are not counted, although their histories are carried like those of
+             * any other rejected record.
+             * 
+             * @return std::uint64_t The number of particles rejected since the file was opened or the reader was last moved
+             */
+            std::uint64_t         getParticlesRejectedByFilter() const;
+
             /**
              * @brief Check if there are more particles to read in the file.
              * 
@@ -152,9 +284,49 @@ namespace ParticleZoo
             /**
              * @brief Get the size of the phase space file in bytes.
              * 
+             * For a compressed file this is the size of the decompressed data. For standard input
+             * this is the largest std::uint64_t until the end of the input has been read.
+             * 
              * @return std::uint64_t The file size in bytes
              */
             std::uint64_t         getFileSize() const;
+
+            /**
+             * @brief Get the compression of the phase space file as a whole.
+             * 
+             * gzip and zstd compressed files are decompressed transparently while they are read,
+             * whatever their name (see InputFileStream).
+             * 
+             * @return StreamCompression The compression of the file, NONE if it is read as it is
+             */
+            StreamCompression     getStreamCompression() const;
+
+            /**
+             * @brief Check if the particle records are read through a memory mapping of the file.
+             * 
+             * Memory mapping is enabled with the MemoryMapCommand user option and is only used for
+             * binary formats that are not compressed. The file is mapped the first time particle data
+             * is needed, and readers of the same file in the process share one mapping (see
+             * MapSharedFile()). With the SharedCacheCommand user option, the file is copied once into
+             * a cache shared by every process of the node, by default in /dev/shm or the directory
+             * given with SharedCacheDirectoryCommand, and the copy is mapped instead (see MapCachedFile()).
+             * 
+             * @return true if the file is (or will be) read through a memory mapping
+             * @return false if the file is read through a buffered stream
+             */
+            bool                  isMemoryMapped() const;
+
+            /**
+             * @brief Check if the file is read ahead on a background I/O thread.
+             * 
+             * Prefetching is enabled with the PrefetchCommand user option, which sets how many blocks
+             * are kept read ahead. The size of each block can be set with PrefetchBlockSizeCommand.
+             * Memory mapped and compressed files are never prefetched.
+             * 
+             * @return true if the file is read through a background prefetcher
+             * @return false if the file is read synchronously
+             */
+            bool                  isPrefetching() const;
             
             /**
              * @brief Get the filename of the phase space file being read.
@@ -163,6 +335,30 @@ namespace ParticleZoo
              */
             const std::string     getFileName() const;
 
+            /**
+             * @brief Get how the particle records of this file are stored.
+             * 
+             * Binary files have fixed length records and can be seeked to any particle directly,
+             * whereas ASCII files have to be read line by line from the start.
+             * 
+             * @return FormatType The storage type of the particle records
+             */
+            FormatType            getFormatType() const;
+
+            /**
+             * @brief Check if moveToParticle() can seek to any particle without reading the ones before it.
+             * 
+             * True for binary and ASCII files. Binary records are seeked to directly. ASCII files
+             * keep a sparse index of the byte offset of every ASCII_INDEX_STRIDE-th record, built
+             * by scanning for line ends the first time a seek goes past what is already indexed,
+             * so reaching a particle only reads the lines after the closest indexed record.
+             * False for files read from standard input, which cannot be seeked at all.
+             * 
+             * @return true if seeking is direct
+             * @return false if seeking has to read through the file
+             */
+            virtual bool          supportsRandomAccess() const;
+
             /**
              * @brief Set comment markers for ASCII format files.
              * 
@@ -301,16 +497,160 @@ namespace ParticleZoo
              */
             static std::vector<CLICommand> getCLICommands();
 
+            /**
+             * @brief Get the path of the header file to read for a phase space file.
+             * 
+             * For use by formats keeping their header in a file of its own (such as IAEA and TOPAS).
+             * A phase space file named "-" is read from standard input, so its header is read from
+             * the file given with InputHeaderCommand (--inputHeader) instead, which is only returned
+             * once the first data of standard input has arrived.
+             * 
+             * @param fileName The path of the phase space file, or "-" for standard input
+             * @param userOptions The user options given to the reader
+             * @return std::string The path from which the header file name is derived
+             * @throws std::runtime_error if the file is "-" and no header file is given
+             */
+            static std::string    getHeaderFileSource(const std::string & fileName, const UserOptions & userOptions);
+
+            /**
+             * @brief Get the counters and timers of the reading of this file so far.
+             * 
+             * The bytes and blocks read and the particles decoded are always counted. The time
+             * blocked reading the file and the time decoding particles are only measured when the
+             * reader is given ProfileCommand (--profile), see IOProfile.
+             * 
+             * @return IOProfile The profile of this reader
+             */
+            virtual IOProfile     getIOProfile() const;
+
             /**
              * @brief Move the file position to a specific particle index.
              * 
              * Allows random access to particles within the file. The next call to
-             * getNextParticle() will return the particle at the specified index.
+             * getNextParticle() will return the particle at the specified index. In ASCII
+             * files the position is found from the sparse line offset index (see
+             * supportsRandomAccess()), which is extended as far as needed first.
              * 
              * @param particleIndex Zero-based index of the particle to move to
+             * @throws std::runtime_error if the file is read from standard input and the reader is not already at the particle
              */
             void                  moveToParticle(std::uint64_t particleIndex);
 
+            /**
+             * @brief Move the file position to the start of a specific history.
+             * 
+             * The next call to getNextParticle() will return the first particle of the given
+             * history. Histories are numbered from zero in file order and only histories with at
+             * least one particle are counted. If a valid history index sidecar exists for the file
+             * it is loaded on the first call and used to seek close to the history, otherwise the
+             * file is read from the start until the history is found.
+             * 
+             * @param historyNumber Zero-based index of the represented history to move to
+             * @throws std::out_of_range if the file has fewer histories than historyNumber + 1
+             */
+            void                  moveToHistory(std::uint64_t historyNumber);
+
+            /**
+             * @brief Move the file position to the start of a specific history using a history index.
+             * 
+             * Same as moveToHistory(std::uint64_t), but uses an index already built or loaded for
+             * this file instead of looking for the sidecar file.
+             * 
+             * @param historyNumber Zero-based index of the represented history to move to
+             * @param index The history index of this file
+             * @throws std::out_of_range if the index has fewer histories than historyNumber + 1
+             */
+            void                  moveToHistory(std::uint64_t historyNumber, const HistoryIndex & index);
+
+            /**
+             * @brief Find the first record at or after a given record that starts a history.
+             * 
+             * Moves to the record and reads forward until the next particle is the first of a
+             * history, leaving the reader positioned at it. Only the records of the history that
+             * was moved into are read, so this is a quick way of finding history boundaries near
+             * any position in the file, for example to split it.
+             * 
+             * @param particleIndex Zero-based index of the record to start looking from
+             * @return std::uint64_t The index of the first record of the history, or the number of records read up to the end of the file if no history starts after the given record
+             */
+            std::uint64_t         findHistoryStart(std::uint64_t particleIndex);
+
+            /**
+             * @brief Get the index of the next record to be read.
+             * 
+             * Counts every record before the current position, pseudo-particles and records skipped
+             * by moveToParticle() included, so that passing it to moveToParticle() returns to the
+             * current position.
+             * 
+             * @return std::uint64_t The zero-based index of the next record
+             */
+            std::uint64_t         getNextRecordIndex() const;
+
+            /**
+             * @brief Get the number of records in the file.
+             * 
+             * Unlike getNumberOfParticles(), records that only hold metadata, such as TOPAS pseudo-particles,
+             * are counted too, so this is the end of the range of record indices accepted by moveToParticle().
+             * 
+             * @return std::uint64_t The number of records in the file
+             */
+            std::uint64_t         getNumberOfRecords() const;
+
+            /**
+             * @brief Get the byte offset of a particle record in a binary file.
+             * 
+             * The records of binary files are of a fixed length and follow the header of the file, so
+             * the offset of any record is known without reading the file. For a compressed file this is
+             * the offset in the decompressed data.
+             * 
+             * @param recordIndex Zero-based index of the record, or the number of records for the end of the last record
+             * @return std::uint64_t The offset of the first byte of the record from the start of the file
+             * @throws std::runtime_error if the file is not a binary file
+             */
+            std::uint64_t         getRecordByteOffset(std::uint64_t recordIndex) const;
+
+            /**
+             * @brief Build a history index for this file.
+             * 
+             * Reads the whole file from the start, recording the number of represented histories,
+             * where every stride-th history starts and the statistics of the records of each block of
+             * stride histories (see HistoryBlockStatistics). The reader is left at the end of the file. The
+             * returned index can be saved with HistoryIndex::save() so that later readers of the same
+             * file, including the parallel readers, can skip their scanning passes.
+             * 
+             * @param stride The number of histories between consecutive index entries
+             * @return HistoryIndex The index of this file
+             * @throws std::invalid_argument if the stride is zero
+             */
+            HistoryIndex          buildHistoryIndex(std::uint64_t stride = HistoryIndex::DEFAULT_STRIDE);
+
+            /**
+             * @brief Build a spatial index of this file over a given grid.
+             * 
+             * Reads the whole file from the start, giving every history the tile of the grid holding
+             * its first particle other than a pseudo-particle and gathering the record ranges and
+             * bounding box of the histories of each tile (see SpatialIndex). The records before the
+             * first particle flagged as starting a history make up a history of their own. The reader
+             * is left at the end of the file. The returned index can be saved with SpatialIndex::save().
+             * 
+             * @param grid The grid of the tiles
+             * @return SpatialIndex The spatial index of this file
+             * @throws std::invalid_argument if the grid level is above SpatialGrid::MAXIMUM_LEVEL
+             */
+            SpatialIndex          buildSpatialIndex(const SpatialGrid & grid);
+
+            /**
+             * @brief Build a spatial index of this file over the X and Y range of its particles.
+             * 
+             * Same as buildSpatialIndex(const SpatialGrid &), with a grid covering the positions of
+             * all the particles other than pseudo-particles, found by reading the file once more first.
+             * 
+             * @param level The base 2 logarithm of the number of tiles on each side of the grid
+             * @return SpatialIndex The spatial index of this file
+             * @throws std::invalid_argument if the level is above SpatialGrid::MAXIMUM_LEVEL
+             */
+            SpatialIndex          buildSpatialIndex(unsigned int level = SpatialGrid::DEFAULT_LEVEL);
+
             /**
              * @brief Close the phase space file and clean up resources.
              * 
@@ -319,8 +659,35 @@ namespace ParticleZoo
              */
             void                  close();
 
+            /**
+             * @brief Open another reader of the same file, starting at its first particle.
+             * 
+             * The new reader opens a file handle and a read buffer of its own, but takes the header
+             * and other metadata already parsed by this reader instead of reading them again, which
+             * is how the parallel readers open a reader for each thread. Formats that do not
+             * override this create the new reader through FormatRegistry::CreateReader(), which
+             * reads the header again.
+             * 
+             * @return std::unique_ptr<PhaseSpaceFileReader> The new reader
+             * @throws std::runtime_error if the file cannot be opened again, such as standard input
+             */
+            virtual std::unique_ptr<PhaseSpaceFileReader> clone() const;
+
         protected:
 
+            /**
+             * @brief Open the file of another reader again, for clone().
+             * 
+             * Takes the options, size and metadata of the other reader as they are, including any
+             * history index and ASCII line index it has loaded, with the reading state of a newly
+             * opened file. Derived classes copy what they have parsed from the header in their own
+             * copy constructors.
+             * 
+             * @param other The reader to open the file of
+             * @throws std::runtime_error if the file cannot be opened, or is standard input
+             */
+            PhaseSpaceFileReader(const PhaseSpaceFileReader & other);
+
             /**
              * @brief Set a constant X coordinate value for all particles.
              * 
@@ -416,7 +783,19 @@ namespace ParticleZoo
              * 
              * @return std::size_t The number of particle entries in the file
              */
-                    std::size_t   getNumberOfEntriesInFile() const;
+            virtual std::size_t   getNumberOfEntriesInFile() const;
+
+            /**
+             * @brief Get the number of records at the end of the file that only hold metadata.
+             * 
+             * A reader moved by moveToParticle() does not know how many metadata-only records, such as
+             * TOPAS pseudo-particles, it passed over, so it cannot count the particles it reads against
+             * getNumberOfParticles(). For formats with such records it reads up to the metadata-only
+             * records closing the file instead. The default implementation returns std::nullopt.
+             * 
+             * @return std::optional<std::uint64_t> The number of metadata-only records closing the file, or std::nullopt if the format has no metadata-only records
+             */
+            virtual std::optional<std::uint64_t> getNumberOfTrailingMetadataRecords() const;
 
             /**
              * @brief Read a particle from binary data.
@@ -429,6 +808,55 @@ namespace ParticleZoo
              * @throws std::runtime_error if not implemented for binary format
              */
             virtual Particle      readBinaryParticle(ByteBuffer & buffer);
+
+            /**
+             * @brief Decode many consecutive binary records directly into a particle block.
+             * 
+             * Derived classes with fixed length records that are decoded independently of each other
+             * can override this to decode a whole batch in one pass, which readParticleBlock() then
+             * uses instead of calling readBinaryParticle() for each record. The decoded particles must
+             * be appended to the block in file order, one per record, except for records which only
+             * add to the particle after them (such as a run of empty histories), which may be folded
+             * into that particle and are then counted as metaparticles. A record the batch decoder
+             * cannot handle ends the batch early: the records before it are kept, and that record is
+             * then decoded by readBinaryParticle() before batch decoding carries on with the records
+             * after it. The default implementation returns BINARY_PARTICLE_BLOCKS_UNSUPPORTED.
+             * 
+             * @param records The byte buffer containing numberOfRecords consecutive particle records
+             * @param numberOfRecords The number of records to decode
+             * @param block The block to append the decoded particles to
+             * @return std::size_t The number of records decoded, numberOfRecords unless a record is left for readBinaryParticle(), or BINARY_PARTICLE_BLOCKS_UNSUPPORTED if batch decoding is not supported at all
+             */
+            virtual std::size_t   readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block);
+
+            /// Returned by readBinaryParticleBlock() when the reader has no batch decoder, every record then goes through readBinaryParticle()
+            static constexpr std::size_t BINARY_PARTICLE_BLOCKS_UNSUPPORTED = std::numeric_limits<std::size_t>::max();
+
+            /**
+             * @brief What the reader needs to know about a binary record rejected without being decoded.
+             */
+            struct RejectedRecord {
+                ParticleType  type{ParticleType::Unsupported}; ///< The type of the particle in the record
+                bool          isNewHistory{false};             ///< Whether the record starts a new history
+                std::uint32_t incrementalHistories{1};        ///< Number of histories started by the record if it starts one
+            };
+
+            /**
+             * @brief Test a filter against the fields of a binary record without decoding the particle.
+             * 
+             * Derived classes able to read the fields used by the filter straight from their records can
+             * override this so that readParticles() and readParticleBlock() skip the records the filter
+             * rejects without building a Particle. A record must only be reported as rejected if
+             * ParticleFilter::accepts() would reject the particle decoded from it, which is best ensured
+             * by testing the fields with the field level tests of ParticleFilter on the values the full
+             * decoder would produce. The default implementation rejects nothing.
+             * 
+             * @param record The byte buffer holding the record, which may be read freely
+             * @param filter The filter to test
+             * @param rejected Filled with the history information of the record if it is rejected
+             * @return true if the record is rejected, false if it has to be decoded to be tested
+             */
+            virtual bool          rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected);
             
             /**
              * @brief Read a particle from ASCII data.
@@ -436,11 +864,11 @@ namespace ParticleZoo
              * Must be implemented by derived classes that support ASCII format.
              * The default implementation throws an exception.
              * 
-             * @param line The ASCII line containing the particle data
+             * @param line The ASCII line containing the particle data, a view into the read buffer which is only valid during the call
              * @return Particle The particle object parsed from ASCII data
              * @throws std::runtime_error if not implemented for ASCII format
              */
-            virtual Particle      readASCIIParticle(const std::string & line); // not pure virtual to allow for binary format
+            virtual Particle      readASCIIParticle(std::string_view line); // not pure virtual to allow for binary format
             
             /**
              * @brief Read a particle manually (for formats requiring third-party I/O).
@@ -469,6 +897,30 @@ namespace ParticleZoo
              * @throws std::runtime_error if not implemented
              */
             virtual Particle      peekParticleManually();
+
+            /**
+             * @brief Seek to a particle record manually (for formats requiring third-party I/O).
+             * 
+             * Called by moveToParticle() for FormatType::NONE once the index has been validated,
+             * after which the read statistics are reset the same as for any other format. The
+             * default implementation throws an exception, so seeking is unsupported unless a
+             * derived class implements it.
+             * 
+             * @param particleIndex Zero-based index of the record to move to
+             * @throws std::runtime_error if not implemented
+             */
+            virtual void          moveToParticleManually(std::uint64_t particleIndex);
+
+            /**
+             * @brief Count particle records that were passed over without being read.
+             * 
+             * For FormatType::NONE readers that jump over records, so that the record index used by
+             * moveToParticle() and history indices stays in step with the records in the file. The
+             * records are counted as skipped and are not included in getParticlesRead().
+             * 
+             * @param numberOfRecords The number of records passed over
+             */
+            void                  skipParticleRecords(std::uint64_t numberOfRecords);
             
             /**
              * @brief Get the maximum line length for ASCII format files.
@@ -538,32 +990,110 @@ namespace ParticleZoo
              */
             const UserOptions&    getUserOptions() const;
 
+            /**
+             * @brief Check whether the time spent reading and decoding is being measured.
+             * 
+             * @return true if the reader was given ProfileCommand
+             */
+            bool                  isProfiling() const;
+
+            /**
+             * @brief Time I/O done by a derived class until the returned timer goes out of scope.
+             * 
+             * For FormatType::NONE readers doing their own I/O, so that it is reported as I/O
+             * rather than as decoding. The timer does nothing unless isProfiling() is true.
+             * 
+             * @return ProfileTimer The running timer
+             */
+            ProfileTimer          timeIO();
+
+            /**
+             * @brief Count a block of data read by a derived class doing its own I/O.
+             * 
+             * @param bytes The number of bytes read
+             */
+            void                  countBlockRead(std::uint64_t bytes);
+
+            /**
+             * @brief Count data read by a derived class doing its own I/O that is not a block of particles, such as a header.
+             * 
+             * @param bytes The number of bytes read
+             */
+            void                  countBytesRead(std::uint64_t bytes);
+
         private:
+            static constexpr std::uint64_t ASCII_INDEX_STRIDE = 1024; /// number of ASCII records between line offset index entries
+
             void                  readNextBlock();
             void                  bufferNextASCIILine();
+            bool                  isASCIIRecordLine(std::string_view line) const;
+            void                  indexASCIIRecordsUpTo(std::uint64_t particleIndex);
+            void                  scanASCIIRecordOffsets(std::size_t entriesNeeded);
+            Particle              readNextBinaryRecord();
+            void                  updateReadStatistics(Particle & particle, bool countParticleInStatistics);
+            void                  updateReadStatistics(ParticleBlock & block, std::size_t firstParticle);
+            void                  skipToHistory(std::uint64_t nextHistory, std::uint64_t historyNumber);
+            std::size_t           readBinaryRecordsIntoBlock(ParticleBlock & block, std::size_t maxParticles);
+            template <typename ParticleSink>
+            std::size_t           readParticleBatch(std::size_t maxParticles, ParticleSink && sink);
+            template <typename ParticleSink>
+            std::size_t           readFilteredParticleBatch(std::size_t maxParticles, const ParticleFilter & filter, ParticleSink && sink);
+            template <typename RecordVisitor>
+            void                  visitRecordPositions(RecordVisitor && visit);
+            void                  countRejectedRecord(const RejectedRecord & record);
+            void                  loadHistoryIndex();
+            std::uint64_t         getParticleLimit() const;
+            void                  skipRejectedHistoryBlocks(const ParticleFilter & filter);
+            void                  rejectParticle(ParticleType type, bool isNewHistory, std::uint32_t incrementalHistories);
+            std::uint32_t         carryRejectedHistories(bool isNewHistory, std::uint32_t incrementalHistories);
 
             const std::string phspFormat_;
             const std::string fileName_;
             const UserOptions userOptions_;
             const FormatType formatType_;
             const int BUFFER_SIZE;
-            std::ifstream file_;
+            const StreamCompression compression_;
+            const bool useMemoryMap_;
+            const std::size_t prefetchDepth_;     /// number of blocks to keep read ahead, 0 if prefetching is disabled
+            const std::size_t prefetchBlockSize_; /// size of each prefetched block
+            const bool profiling_;
+            InputFileStream file_;
+            std::shared_ptr<const MemoryMappedFile> mappedFile_; /// read-only mapping of the whole file when memory mapping is enabled, shared with the other readers of the file
+            std::unique_ptr<BlockPrefetcher> prefetcher_;  /// background reader, started on the first refill after opening or seeking
 
-            std::list<std::string> asciiLineBuffer_;
+            std::string_view asciiLine_;  /// view into buffer_ of the next line to read, valid while hasASCIILine_ is set
+            bool hasASCIILine_;
+            std::vector<std::uint64_t> asciiRecordOffsets_; /// byte offset of records 0, ASCII_INDEX_STRIDE, 2*ASCII_INDEX_STRIDE, ... found so far
+            std::uint64_t asciiIndexScanOffset_;            /// byte offset of the first line not yet scanned for the index
+            std::uint64_t asciiIndexRecordsScanned_;        /// number of records in the lines scanned for the index
             std::vector<std::string> asciiCommentMarkers_;
 
-            const std::uint64_t bytesInFile_;
+            std::uint64_t bytesInFile_;       /// only known once the end of standard input is reached
             std::uint64_t bytesRead_;
             std::uint64_t particlesRead_;     /// counts all particle records even if they are skipped or are only meta-data particles
             std::uint64_t metaparticlesRead_; /// counts all metadata-only particles read which are not counted towards the reported number of particles in the file
             std::uint64_t particlesSkipped_;  /// counts all particles skipped by moveToParticle
             std::uint64_t historiesRead_;
             std::uint64_t numberOfParticlesToRead_;
+            bool readsToParticleRecordsEnd_;  /// set once moved past records that may include metadata-only ones, numberOfParticlesToRead_ alone then ends the particles
             std::size_t particleRecordLength_;
             bool isFirstParticle_;
             ByteBuffer buffer_;
+            ByteBuffer recordBuffer_;         /// reusable view of the current binary particle record
+            unsigned int readParticleDepth_;  /// depth of nested binary record reads, the record buffer is only reused at the top level
+            bool canReadBinaryParticleBlocks_; /// false once readBinaryParticleBlock() has reported that batch decoding is not supported
+            std::uint64_t particlesRejectedByFilter_; /// records rejected by the filters given to readParticles() and readParticleBlock()
+            std::uint64_t rejectedHistoriesToCarry_;  /// histories of rejected records not yet carried by an accepted particle
+            std::vector<byte> standardInputHeader_;   /// header bytes read from standard input, which cannot be read again
+            std::optional<HistoryIndex> historyIndex_; /// sidecar index used by moveToHistory() and filtered reads, loaded on first use
+            bool historyIndexLoaded_;
+            std::uint64_t nextHistoryBlockStart_;     /// record index of the next block of histories a filtered read checks against the index
 
             FixedValues fixedValues_;
+            IOProfile profile_;
+
+            friend class PhaseSpaceSet; // reads its member files through their record level interface
+            friend class PhaseSpaceFileWriter; // copies the records of compatible files, see PhaseSpaceFileWriter::appendRecordsFrom()
     };
 
     /**
@@ -591,10 +1121,25 @@ namespace ParticleZoo
         return getNextParticle(true); // count particle in statistics by default
     }
     inline std::uint64_t PhaseSpaceFileReader::getFileSize() const { return bytesInFile_; }
+    inline StreamCompression PhaseSpaceFileReader::getStreamCompression() const { return compression_; }
+    inline bool PhaseSpaceFileReader::isMemoryMapped() const { return useMemoryMap_; }
+    inline bool PhaseSpaceFileReader::isPrefetching() const { return prefetchDepth_ > 0; }
     inline const std::string PhaseSpaceFileReader::getFileName() const { return fileName_; }
+    inline FormatType PhaseSpaceFileReader::getFormatType() const { return formatType_; }
+    inline bool PhaseSpaceFileReader::supportsRandomAccess() const { return (formatType_ == FormatType::BINARY || formatType_ == FormatType::ASCII) && !file_.isStandardInput(); }
     inline std::size_t PhaseSpaceFileReader::getParticleRecordStartOffset() const { return 0; }
     inline void PhaseSpaceFileReader::setByteOrder(ByteOrder byteOrder) { buffer_.setByteOrder(byteOrder); }
     inline const UserOptions& PhaseSpaceFileReader::getUserOptions() const { return userOptions_; }
+    inline bool PhaseSpaceFileReader::isProfiling() const { return profiling_; }
+    inline ProfileTimer PhaseSpaceFileReader::timeIO() { return ProfileTimer(profile_.ioSeconds, profiling_); }
+    inline void PhaseSpaceFileReader::countBlockRead(std::uint64_t bytes) { profile_.bytes += bytes; profile_.blocks++; }
+    inline void PhaseSpaceFileReader::countBytesRead(std::uint64_t bytes) { profile_.bytes += bytes; }
+
+    inline IOProfile PhaseSpaceFileReader::getIOProfile() const {
+        IOProfile profile = profile_;
+        profile.timed = profiling_;
+        return profile;
+    }
 
     inline bool PhaseSpaceFileReader::isXConstant() const { return fixedValues_.xIsConstant; }
     inline bool PhaseSpaceFileReader::isYConstant() const { return fixedValues_.yIsConstant; }
@@ -632,10 +1177,18 @@ namespace ParticleZoo
     }
 
     inline std::uint64_t PhaseSpaceFileReader::getParticlesRead() { return getParticlesRead(false); }
+    inline std::uint64_t PhaseSpaceFileReader::getParticlesRejectedByFilter() const { return particlesRejectedByFilter_; }
+    inline std::uint64_t PhaseSpaceFileReader::getNextRecordIndex() const { return particlesRead_; }
+    inline std::uint64_t PhaseSpaceFileReader::getNumberOfRecords() const { return static_cast<std::uint64_t>(getNumberOfEntriesInFile()); }
+
     inline std::uint64_t PhaseSpaceFileReader::getParticlesRead(bool includeAllParticleRecords) { return includeAllParticleRecords ? particlesRead_ : particlesRead_ - metaparticlesRead_ - particlesSkipped_; }
 
     inline void PhaseSpaceFileReader::setCommentMarkers(const std::vector<std::string> & commentMarkers) {
         asciiCommentMarkers_ = commentMarkers;
+        // which lines are records depends on the markers, so any index built so far no longer applies
+        asciiRecordOffsets_.clear();
+        asciiIndexScanOffset_ = 0;
+        asciiIndexRecordsScanned_ = 0;
     }
 
     inline std::uint64_t PhaseSpaceFileReader::getNumberOfRepresentedHistories() const {
@@ -658,7 +1211,21 @@ namespace ParticleZoo
         throw std::runtime_error("readBinaryParticle() must be implemented for binary formatted file readers.");
     }
 
-    inline Particle PhaseSpaceFileReader::readASCIIParticle(const std::string & line) {
+    inline std::size_t PhaseSpaceFileReader::readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block) {
+        (void)records;
+        (void)numberOfRecords;
+        (void)block;
+        return BINARY_PARTICLE_BLOCKS_UNSUPPORTED;
+    }
+
+    inline bool PhaseSpaceFileReader::rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected) {
+        (void)record;
+        (void)filter;
+        (void)rejected;
+        return false;
+    }
+
+    inline Particle PhaseSpaceFileReader::readASCIIParticle(std::string_view line) {
         (void)line;
         throw std::runtime_error("readASCIIParticle() must be implemented for ASCII formatted file readers.");
     }
@@ -671,6 +1238,26 @@ namespace ParticleZoo
         throw std::runtime_error("peekParticleManually() must be implemented for manual particle reading.");
     }
 
+    inline void PhaseSpaceFileReader::moveToParticleManually(std::uint64_t particleIndex) {
+        (void)particleIndex;
+        throw std::runtime_error("moveToParticle is not supported for NONE format.");
+    }
+
+    inline std::uint64_t PhaseSpaceFileReader::getParticleLimit() const {
+        // the header of standard input may still be provisional, so it is read to its end instead, as is a file read from
+        // past records that may be metadata-only, which the particles read can no longer be counted from
+        return file_.isStandardInput() || readsToParticleRecordsEnd_ ? std::numeric_limits<std::uint64_t>::max() : getNumberOfParticles();
+    }
+
+    inline void PhaseSpaceFileReader::skipParticleRecords(std::uint64_t numberOfRecords) {
+        particlesRead_ += numberOfRecords;
+        particlesSkipped_ += numberOfRecords;
+    }
+
+    inline std::optional<std::uint64_t> PhaseSpaceFileReader::getNumberOfTrailingMetadataRecords() const {
+        return std::nullopt;
+    }
+
     inline std::size_t PhaseSpaceFileReader::getNumberOfEntriesInFile() const {
         // For binary files, return the number of times the record length fits into the file size minus the header size
         // For other formats, just return getNumberOfParticles()
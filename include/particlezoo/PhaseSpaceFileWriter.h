@@ -1,16 +1,26 @@
 #pragma once
 
-#include <fstream>
 #include <string>
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <span>
+#include <vector>
 
 #include "particlezoo/utilities/argParse.h"
 #include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
 #include "particlezoo/ByteBuffer.h"
+#include "particlezoo/utilities/asciiFields.h"
+#include "particlezoo/utilities/backgroundFlush.h"
+#include "particlezoo/utilities/ioProfile.h"
+#include "particlezoo/utilities/outputFileStream.h"
 
 namespace ParticleZoo
 {
+    class PhaseSpaceFileReader;
+    class RecordTranscoder;
+
     extern CLICommand ConstantXCommand;
     extern CLICommand ConstantYCommand;
     extern CLICommand ConstantZCommand;
@@ -21,6 +31,8 @@ namespace ParticleZoo
     extern CLICommand FlipXDirectionCommand;
     extern CLICommand FlipYDirectionCommand;
     extern CLICommand FlipZDirectionCommand;
+    extern CLICommand BackgroundFlushCommand;
+    extern CLICommand OutputHeaderCommand;
 
     /**
      * @brief Base class for writing phase space files
@@ -30,6 +42,13 @@ namespace ParticleZoo
      * ASCII file formats, provides buffering for efficient I/O, and supports statistics tracking
      * and format-specific optimizations. In cases where I/O must be handled by a third-party
      * library (e.g., ROOT), this class also provides a framework for manually writing particles.
+     * 
+     * A file named "-" is written to standard output. Formats with a header file of their own
+     * then write it to the path given with OutputHeaderCommand (--outputHeader), while formats
+     * with the header at the start of the file cannot be written to standard output, since the
+     * header is only complete once every particle has been written. A first version of the
+     * header file is written before the first records (see writeProvisionalHeader()), so that
+     * the output can be read by another program while it is being written.
      */
     class PhaseSpaceFileWriter
     {
@@ -70,7 +89,35 @@ namespace ParticleZoo
              * 
              * @param particle The particle object to write to the file
              */
-            virtual void                writeParticle(Particle particle);
+            void                        writeParticle(const Particle & particle);
+
+            /**
+             * @brief Write a particle to the phase space file, reusing its storage.
+             * 
+             * Behaves as writeParticle(const Particle&) but applies the constant values and
+             * direction flips to the given particle in place instead of to a copy.
+             * 
+             * @param particle The particle object to write to the file, left in an unspecified state
+             */
+            void                        writeParticle(Particle && particle);
+
+            /**
+             * @brief Write a contiguous range of particles to the phase space file.
+             * 
+             * Equivalent to calling writeParticle() for each particle in the range, in order.
+             * 
+             * @param particles The particles to write
+             */
+            void                        writeParticles(std::span<const Particle> particles);
+
+            /**
+             * @brief Write every particle in a columnar particle block to the phase space file.
+             * 
+             * Equivalent to calling writeParticle() for each particle in the block, in order.
+             * 
+             * @param block The block of particles to write
+             */
+            void                        writeParticleBlock(const ParticleBlock & block);
             
             /**
              * @brief Get the maximum number of particles this writer can support.
@@ -112,6 +159,27 @@ namespace ParticleZoo
              * @return const std::string The filename/path of the output file
              */
             const std::string           getFileName() const;
+
+            /**
+             * @brief Get the paths of all of the files making up the output phase space.
+             * 
+             * Formats that keep their header in a file of its own (such as IAEA and TOPAS) return
+             * the header file as well. The default implementation returns getFileName().
+             * 
+             * @return std::vector<std::string> The paths of the files written by this writer
+             */
+            virtual std::vector<std::string> getOutputFileNames() const;
+
+            /**
+             * @brief Check if full buffers are written to disk on a background I/O thread.
+             * 
+             * Background flushing is enabled with the BackgroundFlushCommand user option, which sets
+             * how many full buffers may be queued for writing before writeParticle() waits.
+             * 
+             * @return true if full buffers are written by a background flusher
+             * @return false if full buffers are written synchronously
+             */
+            bool                        isFlushingInBackground() const;
             
             /**
              * @brief Get the byte order used for binary data writing.
@@ -248,6 +316,31 @@ namespace ParticleZoo
              */
             static std::vector<CLICommand> getCLICommands();
 
+            /**
+             * @brief Get the path of the header file to write for a phase space file.
+             * 
+             * For use by formats keeping their header in a file of its own (such as IAEA and TOPAS).
+             * A phase space file named "-" is written to standard output, so its header is written
+             * to the file given with OutputHeaderCommand (--outputHeader) instead.
+             * 
+             * @param fileName The path of the phase space file, or "-" for standard output
+             * @param userOptions The user options given to the writer
+             * @return std::string The path from which the header file name is derived
+             * @throws std::runtime_error if the file is "-" and no header file is given
+             */
+            static std::string getHeaderFileSource(const std::string & fileName, const UserOptions & userOptions);
+
+            /**
+             * @brief Get the counters and timers of the writing of this file so far.
+             * 
+             * The bytes and blocks written and the particles encoded are always counted. The time
+             * blocked writing the file and the time encoding particles are only measured when the
+             * writer is given ProfileCommand (--profile), see IOProfile.
+             * 
+             * @return IOProfile The profile of this writer
+             */
+            IOProfile                   getIOProfile() const;
+
             /**
              * @brief Close the phase space file and finalize writing.
              * 
@@ -256,6 +349,85 @@ namespace ParticleZoo
              */
             void                        close();
 
+            /**
+             * @brief Append the particle records of a phase space file written by another writer.
+             * 
+             * The records of the other writer's file are copied byte for byte to the end of this
+             * file and its particle, history and header statistics are merged into this writer's,
+             * so that once closed this file holds the particles of both in order. This is how the
+             * shards of a ShardedParallelWriter are concatenated without decoding and re-encoding
+             * every particle.
+             * 
+             * @param other A closed writer of the same format with the same record layout and constant values
+             * @throws std::runtime_error if either writer is closed/open when it should not be, or the files cannot be concatenated
+             */
+            void                        appendRecordsFrom(const PhaseSpaceFileWriter & other);
+
+            /**
+             * @brief Check if the particle records of a file can be copied into this one unchanged.
+             * 
+             * True when the file is of the same format as this writer and its records are laid out
+             * in exactly the same way (for example the same EGS mode, the same IAEA extra floats and
+             * longs and constant values, or the same TOPAS columns), so that appendRecordsFrom()
+             * can copy them without decoding them.
+             * 
+             * @param reader A reader for the file to check
+             * @return true if appendRecordsFrom() can be used for the file
+             */
+            bool                        canAppendRecordsFrom(const PhaseSpaceFileReader & reader) const;
+
+            /**
+             * @brief Append the particle records of an existing phase space file.
+             * 
+             * The records of the reader's file are copied byte for byte to the end of this file
+             * and the particle, history and header statistics stored in its header are merged
+             * into this writer's. Any empty histories waiting to be written are counted before
+             * the copied records. The reader itself is not read from.
+             * 
+             * @param reader A reader for a file for which canAppendRecordsFrom() is true
+             * @throws std::runtime_error if this file is closed or the file's records cannot be copied
+             */
+            void                        appendRecordsFrom(const PhaseSpaceFileReader & reader);
+
+            /**
+             * @brief Append a range of the particle records of an existing phase space file.
+             * 
+             * The records are copied byte for byte to the end of this file, as for
+             * appendRecordsFrom(const PhaseSpaceFileReader&), but only part of the file is copied so
+             * the statistics in its header cannot be used. Instead the records are also read through
+             * the reader, which is left positioned after them, and each particle is counted in this
+             * writer's statistics without being encoded again. The range should start at the first
+             * record of a history (see PhaseSpaceFileReader::findHistoryStart()) so that no history
+             * is split. Only formats with fixed length binary records are supported.
+             * 
+             * @param reader A reader for a file for which canAppendRecordsFrom() is true
+             * @param firstRecord Zero-based index of the first record to copy
+             * @param numberOfRecords The number of records to copy, the copy stops at the end of the file if it is reached first
+             * @throws std::runtime_error if this file is closed, the file's records cannot be copied or are not of fixed length
+             * @throws std::out_of_range if firstRecord is beyond the end of the file
+             */
+            void                        appendRecordsFrom(PhaseSpaceFileReader & reader, std::uint64_t firstRecord, std::uint64_t numberOfRecords);
+
+            /**
+             * @brief Convert the next particle records of a reader directly into records of this file.
+             * 
+             * The records are read from the reader's buffer and handed in batches to a transcoder
+             * (see TranscoderRegistry::CreateTranscoder()), which writes the records of this file
+             * without a Particle object being made for each of them. The particle, history and
+             * header statistics of both files are kept as if every particle had been read with
+             * getNextParticle() and written with writeParticle(). The records the transcoder leaves
+             * to the per-particle path, the first particle of the file, the particles that carry
+             * pending empty histories and, when directions are flipped or set to constants, all of
+             * the particles are read and written one at a time instead.
+             * 
+             * @param reader The reader to read the records from, of a format with fixed length binary records
+             * @param transcoder A transcoder made for the reader and this writer
+             * @param maxRecords The maximum number of records to read, a particle read one at a time may read a few more
+             * @return std::uint64_t The number of records read from the reader
+             * @throws std::runtime_error if this file is closed or either format does not have fixed length binary records
+             */
+            std::uint64_t               transcodeParticlesFrom(PhaseSpaceFileReader & reader, RecordTranscoder & transcoder, std::uint64_t maxRecords = std::numeric_limits<std::uint64_t>::max());
+
         protected:
 
             /**
@@ -392,6 +564,69 @@ namespace ParticleZoo
              */
             virtual void                fixedValuesHaveChanged(){};
 
+            /**
+             * @brief Merge the format-specific statistics of another writer into this one.
+             * 
+             * Called by appendRecordsFrom() before the other writer's records are copied, the particle
+             * and history counts kept by this base class are merged separately. Formats whose headers
+             * hold statistics of their own (counts by particle type, energy ranges and so on) override
+             * this to combine them, and throw if the two files cannot be concatenated for a reason
+             * only the format knows about. The default implementation does nothing.
+             * 
+             * @param other A closed writer of the same class as this one
+             * @throws std::runtime_error if the other file's records cannot be appended to this one
+             */
+            virtual void                mergeStatisticsFrom(const PhaseSpaceFileWriter & other);
+
+            /**
+             * @brief Check if an existing file's records have the same layout as those of this writer.
+             * 
+             * Called by canAppendRecordsFrom() once the format, record length and size of the file
+             * have been checked. Formats that support appending the records of existing files
+             * override this to compare the layout details kept in their headers. The default
+             * implementation returns false.
+             * 
+             * @param reader A reader for a file of the same format as this writer
+             * @return true if the file's records can be copied into this file unchanged
+             */
+            virtual bool                hasSameRecordLayout(const PhaseSpaceFileReader & reader) const;
+
+            /**
+             * @brief Merge the format-specific statistics of an existing file into this writer.
+             * 
+             * Called by appendRecordsFrom() before the file's records are copied, as for the
+             * overload taking a writer. The default implementation does nothing.
+             * 
+             * @param reader A reader for a file for which hasSameRecordLayout() is true
+             */
+            virtual void                mergeStatisticsFrom(const PhaseSpaceFileReader & reader);
+
+            /**
+             * @brief Count a particle in the format-specific statistics without writing it.
+             * 
+             * Called by appendRecordsFrom() for every particle of a range of records copied from
+             * another file, pseudo-particles included, in place of the counting done while the
+             * particle would otherwise have been written. Formats whose headers hold statistics of
+             * their own override this with the same counting their write methods do. The default
+             * implementation does nothing.
+             * 
+             * @param particle The particle of a copied record, as read from the other file
+             */
+            virtual void                countParticleStats(const Particle & particle);
+
+            /**
+             * @brief Count a block of particles in the format-specific statistics without writing it.
+             * 
+             * Called by transcodeParticlesFrom() for every batch of records a transcoder wrote, in
+             * place of the counting done while the particles would otherwise have been written. The
+             * block only holds the basic properties of the particles, their incremental histories
+             * being those getIncrementalHistories() would return. The default implementation counts
+             * each particle of the block with countParticleStats().
+             * 
+             * @param block The basic properties of the particles of the transcoded records
+             */
+            virtual void                countParticleBlockStats(const ParticleBlock & block);
+
             /**
              * @brief Get the byte offset where particle records start in the file.
              * 
@@ -431,6 +666,16 @@ namespace ParticleZoo
              * @param buffer The byte buffer to write header data into
              */
             virtual void                writeHeaderData(ByteBuffer & buffer) = 0;
+
+            /**
+             * @brief Write a first version of a header kept in a file of its own.
+             * 
+             * Called before the first records are written to standard output, so that a program
+             * reading them as they are written finds the record layout in the header file. The
+             * header is written again with the final statistics when the writer is closed. The
+             * default implementation does nothing.
+             */
+            virtual void                writeProvisionalHeader();
             
             /**
              * @brief Write a particle in binary format to a byte buffer.
@@ -445,16 +690,19 @@ namespace ParticleZoo
             virtual void                writeBinaryParticle(ByteBuffer & buffer, Particle & particle);
             
             /**
-             * @brief Write a particle in ASCII format as a string.
+             * @brief Write a particle in ASCII format as a line of text.
              * 
              * Must be implemented by derived classes that support ASCII format.
-             * The default implementation throws an exception.
+             * The default implementation throws an exception. The line, including its
+             * newline, is written straight into the write buffer and may be at most
+             * getMaximumASCIILineLength() characters long. Nothing is written for the
+             * particle if the line is left empty.
              * 
+             * @param line The writer to write the line of the particle with
              * @param particle The particle object to write
-             * @return const std::string The ASCII representation of the particle
-             * @throws std::runtime_error if not implemented for ASCII format
+             * @throws std::runtime_error if not implemented for ASCII format or the line is too long
              */
-            virtual const std::string   writeASCIIParticle(Particle & particle);
+            virtual void                writeASCIIParticle(ASCIILineWriter & line, Particle & particle);
             
             /**
              * @brief Write a particle manually (for formats requiring third-party I/O).
@@ -470,6 +718,33 @@ namespace ParticleZoo
              */
             virtual void                writeParticleManually(Particle & particle);
 
+            /**
+             * @brief Finish writing a file manually (for formats requiring their own I/O).
+             * 
+             * Called by close() for FormatType::NONE writers once any empty histories still
+             * pending have been counted in getHistoriesWritten(), so that the derived class can
+             * write out whatever it still holds and close its file. May be called more than once
+             * and must do nothing once the file is closed. As close() is only dispatched to the
+             * derived class while it is alive, derived classes should call close() from their own
+             * destructor. The default implementation does nothing.
+             */
+            virtual void                closeManually();
+
+            /**
+             * @brief Append the particles of another writer's file manually (for formats requiring their own I/O).
+             * 
+             * Called by appendRecordsFrom() for FormatType::NONE writers in place of copying the
+             * records byte for byte, once the formats and constant values have been checked and the
+             * statistics merged. The derived class copies the particles of the other writer's file
+             * to the end of its own, without decoding them where its file format allows. The default
+             * implementation throws an exception, so appending is unsupported unless a derived class
+             * implements it.
+             * 
+             * @param other A closed writer of the same class as this one
+             * @throws std::runtime_error if not implemented or the particles cannot be appended
+             */
+            virtual void                appendRecordsManually(const PhaseSpaceFileWriter & other);
+
             /**
              * @brief Handle accounting for simulation histories that produced no particles.
              * 
@@ -525,9 +800,42 @@ namespace ParticleZoo
              */
             const UserOptions&          getUserOptions() const;
 
+            /**
+             * @brief Check whether the time spent writing and encoding is being measured.
+             * 
+             * @return true if the writer was given ProfileCommand
+             */
+            bool                        isProfiling() const;
+
+            /**
+             * @brief Time I/O done by a derived class until the returned timer goes out of scope.
+             * 
+             * For FormatType::NONE writers doing their own I/O, so that it is reported as I/O
+             * rather than as encoding. The timer does nothing unless isProfiling() is true.
+             * 
+             * @return ProfileTimer The running timer
+             */
+            ProfileTimer                timeIO();
+
+            /**
+             * @brief Count a block of data written by a derived class doing its own I/O.
+             * 
+             * @param bytes The number of bytes written
+             */
+            void                        countBlockWritten(std::uint64_t bytes);
+
+            /**
+             * @brief Count data written by a derived class doing its own I/O that is not a block of particles, such as a header.
+             * 
+             * @param bytes The number of bytes written
+             */
+            void                        countBytesWritten(std::uint64_t bytes);
+
         private:
+            void                        writeParticleInPlace(Particle & particle);
             void                        writeNextBlock();
             void                        writeHeaderToFile();
+            void                        copyRecordsFrom(const std::string & fileName, std::uint64_t byteOffset, std::uint64_t maxBytes = std::numeric_limits<std::uint64_t>::max());
             ByteBuffer *                getParticleBuffer();
 
             const std::string phspFormat_;
@@ -535,7 +843,10 @@ namespace ParticleZoo
             const UserOptions userOptions_;
             const unsigned int BUFFER_SIZE;
             FormatType formatType_;
-            std::ofstream file_;
+            const std::size_t flushQueueDepth_; /// number of full buffers that may be queued for writing, 0 if background flushing is disabled
+            const bool profiling_;
+            OutputFileStream file_;
+            std::unique_ptr<BackgroundFlusher> flusher_; /// background writer, started on the first flush
             std::uint64_t historiesWritten_;
             std::uint64_t particlesWritten_;
             std::size_t particleRecordLength_;
@@ -550,6 +861,11 @@ namespace ParticleZoo
             bool flipXDirection_;
             bool flipYDirection_;
             bool flipZDirection_;
+            IOProfile profile_;
+            ParticleBlock transcodedParticles_; // basic properties of the last batch of transcoded records
+
+            friend class ConcurrentPhaseSpaceWriter; // encodes the particles of each thread with a writer of its own and writes their buffers itself
+            friend class MPIPhaseSpaceWriter;       // has the ranks of an MPI job copy their records into its file and merges the statistics of their files
     };
 
 
@@ -560,6 +876,7 @@ namespace ParticleZoo
     inline std::uint64_t PhaseSpaceFileWriter::getHistoriesWritten() const { return historiesWritten_ + getPendingHistories(); }
     inline std::uint64_t PhaseSpaceFileWriter::getParticlesWritten() const { return particlesWritten_; }
     inline const std::string PhaseSpaceFileWriter::getFileName() const { return fileName_; }
+    inline bool PhaseSpaceFileWriter::isFlushingInBackground() const { return flushQueueDepth_ > 0; }
     inline ByteOrder PhaseSpaceFileWriter::getByteOrder() const { return buffer_.getByteOrder(); }
     inline std::uint64_t PhaseSpaceFileWriter::getPendingHistories() const { return historiesToAccountFor_; }
 
@@ -605,6 +922,16 @@ namespace ParticleZoo
     }
 
     inline const UserOptions& PhaseSpaceFileWriter::getUserOptions() const { return userOptions_; }
+    inline bool PhaseSpaceFileWriter::isProfiling() const { return profiling_; }
+    inline ProfileTimer PhaseSpaceFileWriter::timeIO() { return ProfileTimer(profile_.ioSeconds, profiling_); }
+    inline void PhaseSpaceFileWriter::countBlockWritten(std::uint64_t bytes) { profile_.bytes += bytes; profile_.blocks++; }
+    inline void PhaseSpaceFileWriter::countBytesWritten(std::uint64_t bytes) { profile_.bytes += bytes; }
+
+    inline IOProfile PhaseSpaceFileWriter::getIOProfile() const {
+        IOProfile profile = profile_;
+        profile.timed = profiling_;
+        return profile;
+    }
 
     inline ByteBuffer * PhaseSpaceFileWriter::getParticleBuffer() {
         if (!particleBuffer_) {
@@ -628,7 +955,8 @@ namespace ParticleZoo
         throw std::runtime_error("writeBinaryParticle() must be implemented for binary formatted file writers.");
     }
 
-    inline const std::string PhaseSpaceFileWriter::writeASCIIParticle(Particle & particle) {
+    inline void PhaseSpaceFileWriter::writeASCIIParticle(ASCIILineWriter & line, Particle & particle) {
+        (void)line;
         (void)particle;
         throw std::runtime_error("writeASCIIParticle() must be implemented for ASCII formatted file writers.");
     }
@@ -638,6 +966,14 @@ namespace ParticleZoo
         throw std::runtime_error("writeParticleManually() must be implemented for manual particle writing.");
     }
 
+    inline void PhaseSpaceFileWriter::closeManually() {}
+
+    inline void PhaseSpaceFileWriter::writeProvisionalHeader() {}
+
+    inline void PhaseSpaceFileWriter::appendRecordsManually(const PhaseSpaceFileWriter &) {
+        throw std::runtime_error("Appending records is not supported for the " + phspFormat_ + " format.");
+    }
+
     inline bool PhaseSpaceFileWriter::accountForAdditionalHistories(std::uint64_t additionalHistories) {
         (void)additionalHistories; // unused in this implementation
         return true;
@@ -653,4 +989,31 @@ namespace ParticleZoo
         return false;
     }
 
+    inline std::vector<std::string> PhaseSpaceFileWriter::getOutputFileNames() const {
+        return { fileName_ };
+    }
+
+    inline void PhaseSpaceFileWriter::mergeStatisticsFrom(const PhaseSpaceFileWriter & other) {
+        (void)other; // nothing to merge beyond the counts kept by the base class
+    }
+
+    inline bool PhaseSpaceFileWriter::hasSameRecordLayout(const PhaseSpaceFileReader & reader) const {
+        (void)reader;
+        return false;
+    }
+
+    inline void PhaseSpaceFileWriter::mergeStatisticsFrom(const PhaseSpaceFileReader & reader) {
+        (void)reader; // nothing to merge beyond the counts kept by the base class
+    }
+
+    inline void PhaseSpaceFileWriter::countParticleStats(const Particle & particle) {
+        (void)particle; // nothing to count beyond the counts kept by the base class
+    }
+
+    inline void PhaseSpaceFileWriter::countParticleBlockStats(const ParticleBlock & block) {
+        for (std::size_t i = 0; i < block.size(); i++) {
+            countParticleStats(block.getParticle(i));
+        }
+    }
+
 } // namespace ParticleZoo
\ No newline at end of file
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Reader presenting an ordered list of phase space files as one phase space.
+     *
+     * Large phase spaces are often produced as many files, one per job or per run (for example
+     * beam.egsphsp1 ... beam.egsphspN, or a set of IAEA file pairs). A PhaseSpaceSet reads the
+     * files one after the other through a reader for each, so that they can be used anywhere a
+     * single PhaseSpaceFileReader can without first being combined into one file. The member files
+     * may be of different formats, each is opened according to its extension.
+     *
+     * The particle, original history and represented history counts of the set are the sums of
+     * those of its files. Records are numbered across the whole set in file order, so
+     * moveToParticle() takes an index into the set and seeks within the file that contains it.
+     * Seeking is direct as long as every file supports it, which lets the parallel readers spread
+     * their threads across the files of a set in the same way as across a single file.
+     *
+     * A set can be constructed from a list of file names, or from a set file (extension .pzset)
+     * listing one file per line. Blank lines and lines starting with '#' are ignored, and
+     * relative paths are relative to the directory of the set file. Set files are registered
+     * with the FormatRegistry, so they can be passed to any tool or parallel reader that takes a
+     * phase space file name.
+     *
+     * @note A history index sidecar (see HistoryIndex) built for a set file is only checked
+     *       against the set file itself, so it must be rebuilt if any of the listed files change.
+     */
+    class PhaseSpaceSet : public PhaseSpaceFileReader
+    {
+        public:
+            /**
+             * @brief Construct a reader for the files listed in a set file.
+             *
+             * @param setFileName The path to the set file
+             * @param userOptions User-defined options, passed on to the reader of each file
+             * @throws std::runtime_error if the set file cannot be read, lists no files, or a file cannot be opened
+             */
+            PhaseSpaceSet(const std::string & setFileName, const UserOptions & userOptions);
+
+            /**
+             * @brief Construct a reader for a list of phase space files.
+             *
+             * The set has no file of its own, so getFileName() returns an empty string.
+             *
+             * @param fileNames The paths to the phase space files, in the order they are to be read
+             * @param userOptions User-defined options, passed on to the reader of each file
+             * @throws std::runtime_error if the list is empty or a file cannot be opened
+             */
+            PhaseSpaceSet(const std::vector<std::string> & fileNames, const UserOptions & userOptions = {});
+
+            /**
+             * @brief Read the list of phase space files from a set file.
+             *
+             * @param setFileName The path to the set file
+             * @return std::vector<std::string> The listed files, with relative paths resolved against the directory of the set file
+             * @throws std::runtime_error if the set file cannot be opened
+             */
+            static std::vector<std::string> ReadSetFile(const std::string & setFileName);
+
+            /**
+             * @brief Write a set file listing phase space files.
+             *
+             * Files in the directory of the set file or below it are listed relative to it, so that
+             * the set and its files can be moved together, and other files by their absolute paths.
+             *
+             * @param setFileName The path to the set file to write
+             * @param fileNames The paths to the phase space files, in the order they are to be read
+             * @throws std::runtime_error if the set file cannot be written
+             */
+            static void WriteSetFile(const std::string & setFileName, const std::vector<std::string> & fileNames);
+
+            /**
+             * @brief Get the total number of particles in all of the files.
+             *
+             * @return std::uint64_t The number of particles in the set
+             */
+            std::uint64_t getNumberOfParticles() const override;
+
+            /**
+             * @brief Get the total number of original histories of all of the files.
+             *
+             * @return std::uint64_t The number of original histories in the set
+             */
+            std::uint64_t getNumberOfOriginalHistories() const override;
+
+            /**
+             * @brief Get the total number of represented histories of all of the files.
+             *
+             * @return std::uint64_t The number of represented histories in the set
+             * @throws std::runtime_error if any of the files does not store its number of represented histories
+             */
+            std::uint64_t getNumberOfRepresentedHistories() const override;
+
+            /**
+             * @brief Check if every file in the set stores its number of represented histories.
+             *
+             * @return true if getNumberOfRepresentedHistories() is available
+             */
+            bool hasNativeRepresentedHistoryCount() const override;
+
+            /**
+             * @brief Check if every file in the set stores incremental history counters.
+             *
+             * @return true if all of the files have native incremental history counters
+             */
+            bool hasNativeIncrementalHistoryCounters() const override;
+
+            /**
+             * @brief Check if there are more particles in the current file or any of the files after it.
+             *
+             * @return true if there are more particles available to read
+             */
+            bool hasMoreParticles() override;
+
+            /**
+             * @brief Check if every file in the set can be seeked directly.
+             *
+             * @return true if moveToParticle() does not have to read through any of the files
+             */
+            bool supportsRandomAccess() const override;
+
+            /**
+             * @brief Get the counters and timers of the reading of the files in the set so far.
+             *
+             * @return IOProfile The sum of the profiles of the readers of the files
+             */
+            IOProfile getIOProfile() const override;
+
+            /**
+             * @brief Get the number of files in the set.
+             *
+             * @return std::size_t The number of files
+             */
+            std::size_t getNumberOfFiles() const;
+
+            /**
+             * @brief Get the path of one of the files in the set.
+             *
+             * @param fileIndex The zero-based position of the file in the set
+             * @return const std::string The path of the file
+             * @throws std::out_of_range if fileIndex is not less than getNumberOfFiles()
+             */
+            const std::string getMemberFileName(std::size_t fileIndex) const;
+
+            /**
+             * @brief Get the position in the set of the file currently being read.
+             *
+             * @return std::size_t The zero-based position of the current file, equal to getNumberOfFiles() once all have been read
+             */
+            std::size_t getCurrentFileIndex() const;
+
+        protected:
+            Particle      readParticleManually() override;
+            Particle      peekParticleManually() override;
+            void          moveToParticleManually(std::uint64_t particleIndex) override;
+            std::size_t   getNumberOfEntriesInFile() const override;
+
+        private:
+            PhaseSpaceSet(const std::string & setFileName, const std::vector<std::string> & fileNames, const UserOptions & userOptions);
+
+            bool          advanceToFileWithParticles();
+
+            std::vector<std::string> fileNames_;
+            std::vector<std::unique_ptr<PhaseSpaceFileReader>> readers_;
+            std::vector<std::uint64_t> firstRecordIndices_;  // index in the set of the first record of each file, plus the total
+            std::size_t currentFile_;
+    };
+
+    // Inline implementations for the PhaseSpaceSet class
+
+    inline std::size_t PhaseSpaceSet::getNumberOfFiles() const { return readers_.size(); }
+
+    inline std::size_t PhaseSpaceSet::getCurrentFileIndex() const { return currentFile_; }
+
+    inline std::size_t PhaseSpaceSet::getNumberOfEntriesInFile() const { return static_cast<std::size_t>(firstRecordIndices_.back()); }
+
+} // namespace ParticleZoo
@@ -5,6 +5,12 @@
 #include "particlezoo/PhaseSpaceFileReader.h"
 #include "particlezoo/PhaseSpaceFileWriter.h"
 
+#include <memory>
+#include <vector>
+
+#include <TBranch.h>
+#include <TBufferFile.h>
+#include <TDataType.h>
 #include <TFile.h>
 #include <TTree.h>
 
@@ -101,6 +107,10 @@ namespace ParticleZoo::ROOT {
     extern CLICommand ROOTDirectionalCosineZIsNegativeCommand;  ///< Z directional cosine sign flag
     extern CLICommand ROOTPDGCodeCommand;                       ///< PDG particle code branch name
     extern CLICommand ROOTHistoryNumberCommand;                 ///< History number branch name
+    extern CLICommand ROOTCompressionCommand;                   ///< Compression algorithm of written files
+    extern CLICommand ROOTCompressionLevelCommand;              ///< Compression level of written files
+    extern CLICommand ROOTBasketSizeCommand;                    ///< Basket size of the branches of written files
+    extern CLICommand ROOTThreadsCommand;                       ///< Threads compressing the baskets of written files
 
     /**
      * @class Reader
@@ -108,6 +118,11 @@ namespace ParticleZoo::ROOT {
      * 
      * Reads particle data from ROOT TTree structures with configurable branch mappings.
      * Supports multiple format presets (TOPAS, OpenGATE) and custom branch configurations.
+     * 
+     * Only the bound branches are read, through a TTreeCache sized for them. Branches holding
+     * a single fundamental value per entry are decompressed a whole basket at a time with ROOT's
+     * bulk I/O into column buffers, other branches are read one entry at a time. Any entry can
+     * be moved to directly, so the parallel readers can split a tree across threads.
      */
 
     class Reader : public ParticleZoo::PhaseSpaceFileReader
@@ -144,6 +159,12 @@ namespace ParticleZoo::ROOT {
              */
             bool hasNativeIncrementalHistoryCounters() const override;
 
+            /**
+             * @brief Check if moveToParticle() can seek to any particle directly.
+             * @return true, TTree entries can be read in any order
+             */
+            bool supportsRandomAccess() const override;
+
             /**
              * @brief Get format-specific CLI commands for ROOT configuration.
              * @return Vector of ROOT-specific CLI commands
@@ -168,7 +189,33 @@ namespace ParticleZoo::ROOT {
              */
             Particle      peekParticleManually() override;
 
+            /**
+             * @brief Move to a TTree entry.
+             * 
+             * Reads the history number of the entry before, if the tree has one, so that the
+             * incremental history count of the first particle read is still exact.
+             * 
+             * @param particleIndex Zero-based index of the entry to move to
+             */
+            void          moveToParticleManually(std::uint64_t particleIndex) override;
+
         private:
+            /**
+             * @brief A bound branch and the buffer of the basket last read from it.
+             */
+            struct Column {
+                enum class Target { DOUBLE, INT, BOOL };
+
+                TBranch * branch;                      ///< The branch, bound to the target
+                void * target;                         ///< The member the value of the current entry is stored in
+                Target targetType;                     ///< The type of the target
+                EDataType leafType;                    ///< The type of the values stored in the branch
+                bool bulk;                             ///< Whether baskets are read with bulk I/O, otherwise single entries are read with GetEntry()
+                std::unique_ptr<TBufferFile> buffer;   ///< The values of the basket last read with bulk I/O
+                Long64_t firstEntry;                   ///< The entry of the first value in the buffer
+                Long64_t numberOfEntries;              ///< The number of values in the buffer
+            };
+
             /**
              * @brief Internal constructor with explicit branch mapping.
              * @param fileName Path to the ROOT file
@@ -180,6 +227,42 @@ namespace ParticleZoo::ROOT {
                 const UserOptions & options
             );
 
+            /**
+             * @brief Bind a branch to the member its values are stored in.
+             * @param branchName Name of the branch, which must exist
+             * @param target The member to store the value of the current entry in
+             */
+            void          bindBranch(const std::string & branchName, double & target);
+            void          bindBranch(const std::string & branchName, int & target);
+            void          bindBranch(const std::string & branchName, bool & target);
+            void          addColumn(TBranch * branch, void * target, Column::Target targetType);
+
+            /**
+             * @brief Store the values of an entry of a column in its target.
+             * @param column The column to read
+             * @param entry The entry to read
+             */
+            void          loadColumn(Column & column, Long64_t entry);
+
+            /**
+             * @brief Store the values of an entry of all bound branches in their targets.
+             * @param entry The entry to read
+             */
+            void          readEntry(std::uint64_t entry);
+
+            /**
+             * @brief Read an entry and make a particle of it.
+             * 
+             * Leaves historyNumber_ at the history number of the entry, for the next increment.
+             * 
+             * @param entry The entry to read
+             * @return Particle The particle of the entry
+             */
+            Particle      particleFromEntry(std::uint64_t entry);
+
+            std::vector<Column> columns_;  ///< The bound branches
+            Long64_t bytesReadFromFile_{}; ///< Bytes read from the file when last counted in the I/O profile
+
             // TTree branch data storage
             double energy_{};          ///< Particle kinetic energy from TTree
             double x_{};               ///< X position from TTree
@@ -216,6 +299,7 @@ namespace ParticleZoo::ROOT {
     inline std::uint64_t Reader::getNumberOfParticles() const { return numberOfParticles_; }
     inline std::uint64_t Reader::getNumberOfOriginalHistories() const { return numberOfOriginalHistories_; }
     inline bool Reader::hasNativeIncrementalHistoryCounters() const { return treeHasHistoryNumber_; }
+    inline bool Reader::supportsRandomAccess() const { return true; }
 
 
     /**
@@ -224,6 +308,13 @@ namespace ParticleZoo::ROOT {
      * 
      * Writes particle data to ROOT TTree structures with configurable branch mappings.
      * Supports multiple format presets (TOPAS, OpenGATE) and custom branch configurations.
+     * 
+     * Files are written uncompressed unless a compression algorithm is chosen with
+     * ROOTCompressionCommand. TTree::Fill() collects the values of each branch in a basket of
+     * ROOTBasketSizeCommand bytes, and with ROOTThreadsCommand ROOT's implicit multithreading
+     * fills the branches and compresses their baskets on a pool of threads. The shards of a
+     * ShardedParallelWriter each write a TTree of their own, which are concatenated by copying
+     * their compressed baskets unless the history numbers have to be renumbered.
      */
 
     class Writer : public ParticleZoo::PhaseSpaceFileWriter
@@ -269,6 +360,23 @@ namespace ParticleZoo::ROOT {
              */
             void          writeHeaderData(ByteBuffer & buffer) override;
 
+            /**
+             * @brief Write the TTree and close the ROOT file.
+             */
+            void          closeManually() override;
+
+            /**
+             * @brief Append the entries of the TTree written by another ROOT writer.
+             * 
+             * The compressed baskets are copied as they are, unless the tree stores history
+             * numbers, in which case the entries are read and filled again so that the history
+             * numbers carry on from those of this file.
+             * 
+             * @param other A closed ROOT writer with the same branch mapping
+             * @throws std::runtime_error if the other file is still open or its TTree cannot be read
+             */
+            void          appendRecordsManually(const PhaseSpaceFileWriter & other) override;
+
         private:
             /**
              * @brief Internal constructor with explicit branch mapping.
@@ -305,6 +413,8 @@ namespace ParticleZoo::ROOT {
             int historyNumber_{0};    ///< Current history number for TTree
 
             bool storeIncrementalHistories_{false}; ///< Whether to store incremental history numbers
+            int compressionSettings_{0};   ///< ROOT compression settings of the file, 100 times the algorithm plus the level
+            Int_t basketSize_{32000};      ///< Size in bytes of the basket of each branch
             TFile * file_{};         ///< ROOT file pointer
             TTree * tree_{};         ///< ROOT TTree pointer
             std::map<std::string, BranchInfo> branchNames_; ///< Branch mapping configuration
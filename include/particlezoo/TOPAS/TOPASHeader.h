@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 
 #include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
 
 namespace ParticleZoo::TOPASphspFile
 {
@@ -318,6 +320,12 @@ namespace ParticleZoo::TOPASphspFile
              */
             std::string    getTOPASFormatName() const;
 
+            /**
+             * @brief Get the path of the .header file
+             * @return Header file path derived from the phase space file name
+             */
+            const std::string & getHeaderFileName() const;
+
             /**
              * @brief Get the length of each particle record in bytes
              * @return Record length based on format and column configuration
@@ -377,6 +385,34 @@ namespace ParticleZoo::TOPASphspFile
              */
             void countParticleStats(const Particle & particle);
 
+            /**
+             * @brief Update particle statistics with a block of particles
+             * 
+             * Counts every particle of the block as countParticleStats(const Particle&) would, the
+             * original histories being those of the incremental history column of the particles
+             * starting a new history.
+             * 
+             * @param block Particles to include in statistics calculations, only their basic properties are used
+             */
+            void countParticleStats(const ParticleBlock & block);
+
+            /**
+             * @brief Add the particle statistics and history counts of another header to this one
+             * 
+             * Used when the records of the other header's phase space file are appended to this one.
+             * 
+             * @param other Header of a phase space file with the same format and columns
+             * @throws std::runtime_error if the format or columns of the two files differ
+             */
+            void mergeParticleStats(const Header & other);
+
+            /**
+             * @brief Check if another header describes the same format and columns as this one
+             * @param other Header to compare with
+             * @return true if records of either file can be read using the other header
+             */
+            bool hasSameColumns(const Header & other) const;
+
             /**
              * @brief Add a new column type to the phase space format
              * @param columnType Type of column to add
@@ -440,6 +476,7 @@ namespace ParticleZoo::TOPASphspFile
     inline std::uint64_t Header::getNumberOfRepresentedHistories() const { return numberOfRepresentedHistories_; }
     inline std::uint64_t Header::getNumberOfParticles() const { return numberOfParticles_; }
     inline TOPASFormat   Header::getTOPASFormat() const { return formatType_; }
+    inline const std::string & Header::getHeaderFileName() const { return headerFileName_; }
 
     inline std::string Header::getTOPASFormatName() const { return getTOPASFormatName(formatType_); }
     inline std::string Header::getTOPASFormatName(TOPASFormat format) {
@@ -495,4 +532,57 @@ namespace ParticleZoo::TOPASphspFile
         numberOfParticles_++;
     }
 
+    inline void Header::countParticleStats(const ParticleBlock & block) {
+        std::span<const ParticleType> types = block.getTypes();
+        std::span<const float> energies = block.getKineticEnergies();
+        std::span<const std::uint8_t> isNewHistory = block.getNewHistoryFlags();
+        std::span<const std::uint32_t> incrementalHistories = block.getIncrementalHistories();
+
+        for (std::size_t i = 0; i < block.size(); i++) {
+            ParticleType particleType = types[i];
+            if (particleType == ParticleType::Unsupported) continue;
+
+            // Capture original history details even for pseudo particles
+            if (isNewHistory[i]) numberOfOriginalHistories_ += incrementalHistories[i];
+
+            // Don't count other statistics for pseudo particles
+            if (particleType == ParticleType::PseudoParticle) continue;
+
+            if (isNewHistory[i]) numberOfRepresentedHistories_++;
+            auto & stats = particleStatsTable_[particleType];
+            stats.count_++;
+            double energy = energies[i];
+            stats.minKineticEnergy_ = std::min(energy, stats.minKineticEnergy_);
+            stats.maxKineticEnergy_ = std::max(energy, stats.maxKineticEnergy_);
+
+            numberOfParticles_++;
+        }
+    }
+
+    inline bool Header::hasSameColumns(const Header & other) const {
+        bool sameColumns = other.formatType_ == formatType_ && other.columnTypes_.size() == columnTypes_.size();
+        for (std::size_t i = 0; sameColumns && i < columnTypes_.size(); i++) {
+            sameColumns = other.columnTypes_[i].columnType_ == columnTypes_[i].columnType_
+                       && other.columnTypes_[i].valueType_ == columnTypes_[i].valueType_;
+        }
+        return sameColumns;
+    }
+
+    inline void Header::mergeParticleStats(const Header & other) {
+        if (!hasSameColumns(other)) {
+            throw std::runtime_error("Cannot merge TOPAS headers of phase space files with different formats or columns.");
+        }
+
+        numberOfOriginalHistories_ += other.numberOfOriginalHistories_;
+        numberOfRepresentedHistories_ += other.numberOfRepresentedHistories_;
+        numberOfParticles_ += other.numberOfParticles_;
+
+        for (const auto & [particleType, otherStats] : other.particleStatsTable_) {
+            auto & stats = particleStatsTable_[particleType];
+            stats.count_ += otherStats.count_;
+            stats.minKineticEnergy_ = std::min(otherStats.minKineticEnergy_, stats.minKineticEnergy_);
+            stats.maxKineticEnergy_ = std::max(otherStats.maxKineticEnergy_, stats.maxKineticEnergy_);
+        }
+    }
+
 } // namespace ParticleZoo::TOPASphspFile
\ No newline at end of file
@@ -94,6 +94,12 @@ namespace ParticleZoo::TOPASphspFile
              */
             static std::vector<CLICommand> getFormatSpecificCLICommands();
 
+            /**
+             * @brief Open another reader of the same file, sharing the header already parsed by this reader
+             * @return The new reader, starting at the first particle
+             */
+            std::unique_ptr<PhaseSpaceFileReader> clone() const override;
+
         protected:
             /**
              * @brief Get the length of each particle record in bytes
@@ -113,6 +119,31 @@ namespace ParticleZoo::TOPASphspFile
              */
             Particle       readBinaryParticle(ByteBuffer & buffer) override;
 
+            /**
+             * @brief Decode consecutive binary records directly into a particle block
+             * 
+             * Uses the decoder of the file's record layout chosen when it was opened. Pseudo-particles
+             * are folded into the particle after them, those ending the records are left to
+             * readBinaryParticle(). Records with custom columns to read are left to readBinaryParticle().
+             * 
+             * @param records Binary buffer containing the particle records
+             * @param numberOfRecords The number of records to decode
+             * @param block The block to append the decoded particles to
+             * @return std::size_t The number of records decoded, or BINARY_PARTICLE_BLOCKS_UNSUPPORTED
+             * @throws std::runtime_error if a particle type code or a pseudo-particle weight is invalid
+             */
+            std::size_t    readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block) override;
+
+            /**
+             * @brief Get the number of pseudo-particles closing a BINARY file
+             * 
+             * Every other pseudo-particle is folded into the particle after it, so only one for the
+             * empty histories at the end of the file is left without a particle to read.
+             * 
+             * @return std::optional<std::uint64_t> 1 if the last record is a pseudo-particle and 0 otherwise, or std::nullopt for ASCII and LIMITED files
+             */
+            std::optional<std::uint64_t> getNumberOfTrailingMetadataRecords() const override;
+
             /**
              * @brief Parse a single ASCII line into a Particle object
              * 
@@ -123,7 +154,7 @@ namespace ParticleZoo::TOPASphspFile
              * @return Parsed Particle object with properties set according to column types
              * @throws std::runtime_error if line cannot be parsed or contains invalid data
              */
-            Particle       readASCIIParticle(const std::string & line) override;
+            Particle       readASCIIParticle(std::string_view line) override;
 
             /**
              * @brief Get the maximum length of ASCII particle lines
@@ -141,6 +172,13 @@ namespace ParticleZoo::TOPASphspFile
              */
             Reader(const std::string &filename, const UserOptions &options, std::pair<FormatType,Header> formatAndHeader);
 
+            /**
+             * @brief Copy constructor used by clone(), opening the file again without re-reading the header
+             * 
+             * @param other The reader to open the file of
+             */
+            Reader(const Reader & other);
+
             /**
              * @brief Read a standard BINARY format particle
              * 
@@ -163,6 +201,22 @@ namespace ParticleZoo::TOPASphspFile
              */
             Particle       readBinaryLimitedParticle(ByteBuffer & buffer);
 
+            /**
+             * @brief Decode records of one of the standard TOPAS binary layouts into a block
+             * 
+             * Instantiated for the BINARY and LIMITED layouts, whose leading columns are fixed, so
+             * that each is decoded without going through the column types of the header. Any
+             * further columns of a BINARY record are passed over.
+             * 
+             * @tparam Layout The TOPAS format of the records
+             * @param records Binary buffer containing the particle records
+             * @param numberOfRecords The number of records to decode
+             * @param block The block to append the decoded particles to
+             * @return std::size_t The number of records decoded, before any pseudo-particles ending the records
+             */
+            template <TOPASFormat Layout>
+            std::size_t    readStandardParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block);
+
             /**
              * @brief Round float to 32-bit integer with "round half away from zero"
              * 
@@ -177,10 +231,19 @@ namespace ParticleZoo::TOPASphspFile
             const std::size_t particleRecordLength_; ///< Length of each particle record in bytes
             bool  readFullDetails_;                  ///< Flag for detailed vs. core-only reading
             std::int32_t emptyHistoriesCount_;       ///< Accumulator for empty history tracking
+            const bool hasCustomColumns_;            ///< True if the records have columns beyond the standard ones
+            bool endsWithPseudoParticle_;            ///< True if the last record of a BINARY file is a pseudo-particle
+            std::size_t (Reader::*blockDecoder_)(ByteBuffer &, std::size_t, ParticleBlock &); ///< Batch decoder for the record layout, nullptr for ASCII files
+            std::vector<std::uint8_t> wIsNegative_;  ///< Signs of the w components of the block being decoded
+            std::vector<std::int32_t> typeCodes_;    ///< Particle type codes of the block being decoded
     };
 
     // Inline implementations for the Reader class
     inline std::uint64_t Reader::getNumberOfParticles() const { return header_.getNumberOfParticles(); }
+    inline std::optional<std::uint64_t> Reader::getNumberOfTrailingMetadataRecords() const {
+        if (formatType_ != TOPASFormat::BINARY) return std::nullopt;
+        return endsWithPseudoParticle_ ? 1 : 0;
+    }
     inline std::uint64_t Reader::getNumberOfOriginalHistories() const { return header_.getNumberOfOriginalHistories(); }
     inline std::uint64_t Reader::getNumberOfRepresentedHistories() const {
         if (formatType_ == TOPASFormat::LIMITED) {
@@ -277,6 +340,12 @@ namespace ParticleZoo::TOPASphspFile
              */
             Header &      getHeader();
 
+            /**
+             * @brief Get the paths of the data and header files
+             * @return The .phsp data file followed by the .header file
+             */
+            std::vector<std::string> getOutputFileNames() const override;
+
             /**
              * @brief Get format-specific command-line options
              * @return Vector of CLI commands supported by TOPAS writer
@@ -306,6 +375,11 @@ namespace ParticleZoo::TOPASphspFile
              */
             void              writeHeaderData(ByteBuffer & buffer) override;
 
+            /**
+             * @brief Write the header file with the statistics so far, before writing to standard output
+             */
+            void              writeProvisionalHeader() override;
+
             /**
              * @brief Encode and write a single particle to binary data
              * 
@@ -324,11 +398,11 @@ namespace ParticleZoo::TOPASphspFile
              * Formats a particle according to TOPAS ASCII specification with
              * configurable columns.
              * 
+             * @param line Writer of the line the particle is written to
              * @param particle Particle object to convert to ASCII
-             * @return ASCII string representation
              * @throws std::runtime_error if particle type is unsupported
              */
-            const std::string writeASCIIParticle(Particle & particle) override;
+            void              writeASCIIParticle(ASCIILineWriter & line, Particle & particle) override;
 
             /**
              * @brief Override base class method to handle additional histories
@@ -356,6 +430,44 @@ namespace ParticleZoo::TOPASphspFile
              */
             bool              canWritePseudoParticlesExplicitly() const override;
 
+            /**
+             * @brief Merge the header statistics and history counts of another TOPAS writer
+             * @param other A closed TOPAS writer whose records are being appended to this file
+             * @throws std::runtime_error if the format or columns of the two files differ
+             */
+            void              mergeStatisticsFrom(const PhaseSpaceFileWriter & other) override;
+
+            /**
+             * @brief Check if a TOPAS file has the same format and columns as this writer
+             * @param reader A reader for the TOPAS file
+             * @return true if the file's records can be appended unchanged
+             */
+            bool              hasSameRecordLayout(const PhaseSpaceFileReader & reader) const override;
+
+            /**
+             * @brief Merge the statistics and history counts in the header of an existing TOPAS file
+             * 
+             * Any empty histories waiting to be written as a pseudo-particle are written first.
+             * 
+             * @param reader A reader for the TOPAS file whose records are being appended to this file
+             */
+            void              mergeStatisticsFrom(const PhaseSpaceFileReader & reader) override;
+
+            /**
+             * @brief Count a particle copied from another TOPAS file in the header statistics
+             * 
+             * Any empty histories waiting to be written as a pseudo-particle are written first.
+             * 
+             * @param particle The particle of a copied record
+             */
+            void              countParticleStats(const Particle & particle) override;
+
+            /**
+             * @brief Count a block of transcoded particles in the header statistics
+             * @param block The basic properties of the particles of the transcoded records
+             */
+            void              countParticleBlockStats(const ParticleBlock & block) override;
+
         private:
             /**
              * @brief Private constructor for format-specific initialization
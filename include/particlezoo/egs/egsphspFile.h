@@ -18,6 +18,7 @@ namespace ParticleZoo
         extern CLICommand EGSModeCommand;               ///< Command to specify EGS file mode (MODE0/MODE2)
 
         constexpr std::size_t MINIMUM_HEADER_DATA_LENGTH = 25;  ///< Minimum header size in bytes
+        constexpr float ELECTRON_REST_MASS_MEV = 0.5109989461f; ///< Electron rest mass, stored explicitly in MeV for operating directly on the energy value in the file before conversion to internal units
         
         /**
          * @brief Enumeration of supported EGS phase space file modes.
@@ -104,6 +105,13 @@ namespace ParticleZoo
                  */
                 static std::vector<CLICommand> getFormatSpecificCLICommands();
 
+                /**
+                 * @brief Open another reader of the same file, sharing the header already read by this reader.
+                 * 
+                 * @return std::unique_ptr<PhaseSpaceFileReader> The new reader, starting at the first particle
+                 */
+                std::unique_ptr<PhaseSpaceFileReader> clone() const override;
+
             protected:
                 /**
                  * @brief Get the length of each particle record in bytes.
@@ -130,7 +138,42 @@ namespace ParticleZoo
                  */
                 Particle readBinaryParticle(ByteBuffer & buffer) override;
 
+                /**
+                 * @brief Decode many EGS binary records directly into a particle block.
+                 * 
+                 * Produces the same particles as readBinaryParticle() but works column by column,
+                 * reconstructing the Z direction components with vector instructions where available.
+                 * 
+                 * @param records The byte buffer containing the particle records
+                 * @param numberOfRecords The number of records to decode
+                 * @param block The block to append the decoded particles to
+                 * @return std::size_t The number of records decoded
+                 * @throws std::runtime_error if particle data is invalid
+                 */
+                std::size_t readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block) override;
+
+                /**
+                 * @brief Test a filter against the fields of an EGS binary record.
+                 * 
+                 * The type, kinetic energy, position, LATCH bits and generation (when the LATCH option
+                 * gives one) are read from the record without building the particle. Direction cones are
+                 * left to the full decoder, which normalizes the directional cosines.
+                 * 
+                 * @param record The byte buffer containing the particle record
+                 * @param filter The filter to test
+                 * @param rejected Filled with the history information of the record if it is rejected
+                 * @return true if the record is rejected, false if it has to be decoded to be tested
+                 */
+                bool rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected) override;
+
             private:
+                /**
+                 * @brief Copy constructor used by clone(), opening the file again without re-reading the header.
+                 * 
+                 * @param other The reader to open the file of
+                 */
+                Reader(const Reader & other) = default;
+
                 EGSMODE mode_;                         ///< File mode (MODE0 or MODE2)
                 EGSLATCHOPTION latchOption_;           ///< LATCH interpretation option
                 unsigned int numberOfParticles_{};     ///< Total number of particles in file
@@ -252,6 +295,45 @@ namespace ParticleZoo
                  */
                 virtual void writeBinaryParticle(ByteBuffer & buffer, Particle & particle) override;
 
+                /**
+                 * @brief Merge the particle counts, energy range and history count of another EGS writer.
+                 * 
+                 * @param other A closed EGS writer whose records are being appended to this file
+                 * @throws std::runtime_error if the other file was written in a different mode
+                 */
+                void mergeStatisticsFrom(const PhaseSpaceFileWriter & other) override;
+
+                /**
+                 * @brief Check if an EGS file is in the same mode as this writer and holds exactly the particles in its header.
+                 * 
+                 * @param reader A reader for the EGS file
+                 * @return true if the file's records can be appended unchanged
+                 */
+                bool hasSameRecordLayout(const PhaseSpaceFileReader & reader) const override;
+
+                /**
+                 * @brief Merge the particle counts, energy range and history count in the header of an existing EGS file.
+                 * 
+                 * @param reader A reader for the EGS file whose records are being appended to this file
+                 */
+                void mergeStatisticsFrom(const PhaseSpaceFileReader & reader) override;
+
+                /**
+                 * @brief Count a particle in the particle counts, energy range and history count of the header.
+                 * 
+                 * Used for every particle written, and for the particles of records copied from another EGS file.
+                 * 
+                 * @param particle The particle to count
+                 */
+                void countParticleStats(const Particle & particle) override;
+
+                /**
+                 * @brief Count a block of transcoded particles in the particle counts, energy range and history count of the header.
+                 * 
+                 * @param block The basic properties of the particles of the transcoded records
+                 */
+                void countParticleBlockStats(const ParticleBlock & block) override;
+
             private:
                 EGSMODE mode_;                                                      ///< File mode (MODE0 or MODE2)
                 EGSLATCHOPTION latchOption_;                                        ///< LATCH interpretation option
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/utilities/historyIndex.h"
+#include "particlezoo/parallel/ThreadCounter.h"
+
+#include <vector>
+#include <span>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <atomic>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Multi-threaded phase space file reader with dynamic load balancing.
+     *
+     * ChunkedParallelReader splits the represented histories of a phase space file into
+     * fixed-size chunks of consecutive histories. Instead of assigning each thread a fixed
+     * share of the file when it is constructed, threads claim the next unread chunk from a
+     * shared atomic cursor whenever they finish their current one. Threads that read histories
+     * which are expensive to process downstream (for example particles transported through
+     * high-Z regions) claim fewer chunks, and no thread sits idle while work remains.
+     *
+     * Each thread has its own PhaseSpaceFileReader. When a thread claims the chunk following
+     * the one it just finished its reader is already in place, otherwise it seeks to the first
+     * history of the chunk using a HistoryIndex. Seeking in ASCII files means reading them from
+     * the start, so for those formats chunks should be large enough that seeks are rare.
+     *
+     * History accounting is exact and matches HistoryBalancedParallelReader: empty histories
+     * are distributed between the represented histories using the global number of each
+     * history rather than the order in which chunks are claimed, so the total of
+     * getHistoriesRead() over all threads is the number of original histories regardless of
+     * how the chunks end up being shared.
+     *
+     * @note Each thread must use its assigned thread index when calling methods.
+     * @note Incremental history counts are derived from represented histories only and do not reflect empty histories counts directly recorded in the phase space file if present.
+     * @note Particle order within a history is preserved, but the order in which a thread
+     *       receives histories depends on when it claims each chunk.
+     */
+    class ChunkedParallelReader {
+
+        enum HasMoreParticlesResult {
+            HAS_MORE_PARTICLES,
+            NO_MORE_PARTICLES,
+            NEEDS_CHECKING
+        };
+
+        public:
+            /**
+             * @brief The default number of represented histories in each chunk.
+             */
+            static constexpr std::uint64_t DEFAULT_HISTORIES_PER_CHUNK = 1024;
+
+            /**
+             * @brief Constructs a multi-threaded phase space reader with dynamic load balancing.
+             *
+             * Creates multiple PhaseSpaceFileReader instances (one per thread). Seeking to the
+             * start of a chunk requires knowing where histories begin in the file. This is taken
+             * from the history index sidecar file if there is one (see HistoryIndex), otherwise
+             * an index with one entry per chunk is built by reading the file once here.
+             *
+             * @param filename Path to the phase space file to read
+             * @param options User options for configuring the reader (format-specific settings)
+             * @param numThreads Number of parallel threads that will read from this file
+             * @param historiesPerChunk Number of represented histories claimed by a thread at a time
+             *
+             * @throws std::invalid_argument If numThreads or historiesPerChunk is zero
+             * @throws std::runtime_error If the file cannot be opened or contains zero histories
+             * @throws std::runtime_error If a PhaseSpaceFileReader cannot be created
+             */
+            ChunkedParallelReader(const std::string& filename, const UserOptions& options = {}, size_t numThreads = 1, std::uint64_t historiesPerChunk = DEFAULT_HISTORIES_PER_CHUNK);
+
+            /**
+             * @brief Destructor that closes all underlying readers.
+             */
+            ~ChunkedParallelReader();
+
+            /**
+             * @brief Peeks at the next particle for a specific thread without consuming it.
+             *
+             * Allows inspection of the next particle that would be returned by getNextParticle()
+             * without advancing the reader's position. Useful for checking history boundaries.
+             *
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @return The next particle for this thread
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If no more particles are available for this thread
+             *
+             * @note Must call hasMoreParticles() first to verify particles are available
+             */
+            Particle peekNextParticle(size_t threadIndex);
+
+            /**
+             * @brief Retrieves the next particle for a specific thread.
+             *
+             * Reads and returns the next particle of the thread's current chunk. Updates internal
+             * counters for history tracking and automatically distributes empty history gaps
+             * when present.
+             *
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @return The next particle for this thread
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If no more particles are available for this thread
+             *
+             * @note Must call hasMoreParticles() first to verify particles are available
+             * @note Sets the INCREMENTAL_HISTORY_NUMBER property on particles
+             */
+            Particle getNextParticle(size_t threadIndex);
+
+            /**
+             * @brief Checks if more particles are available for a specific thread.
+             *
+             * When the thread has finished its current chunk this claims the next unread chunk
+             * for it. Returns false once every chunk has been claimed and the thread has read
+             * all of its own. Uses caching to avoid repeated checks on consecutive calls.
+             *
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @return true if more particles are available, false otherwise
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             *
+             * @note Always call this before getNextParticle() to avoid exceptions
+             */
+            bool     hasMoreParticles(size_t threadIndex);
+
+            /**
+             * @brief Reads the next particles of a specific thread into a contiguous array.
+             *
+             * Equivalent to calling getNextParticle() while hasMoreParticles() is true, claiming
+             * further chunks as needed. The particles are read one at a time, since the end of a
+             * chunk is only found from the history boundaries.
+             *
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @param particles The particles to fill from the front
+             * @return The number of particles read, 0 once the thread has no more particles
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            std::size_t readParticles(size_t threadIndex, std::span<Particle> particles);
+
+            /**
+             * @brief Gets the total number of histories processed by a specific thread.
+             *
+             * Returns the cumulative count of histories (including empty histories)
+             * that have been processed by this thread. This represents the contribution
+             * to the total original history count.
+             *
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return Total number of original histories processed (including empty ones)
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            std::uint64_t getHistoriesRead(size_t threadIndex) const;
+
+            /**
+             * @brief Gets the total number of particles processed by a specific thread.
+             *
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return Total number of particles processed
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            std::uint64_t getParticlesRead(size_t threadIndex) const;
+
+            /**
+             * @brief Gets the total number of particles read across all threads.
+             *
+             * @return Total number of particles read
+             */
+            std::uint64_t getTotalParticlesRead() const;
+
+            /**
+             * @brief Gets the total number of original histories read across all threads.
+             *
+             * @return Total number of original histories read
+             */
+            std::uint64_t getTotalHistoriesRead() const;
+
+            /**
+             * @brief Gets the I/O profile of the reader of a specific thread.
+             *
+             * The ioSeconds of the profile is the time the thread was blocked waiting for its
+             * reader to read the file, see PhaseSpaceFileReader::getIOProfile(). Only call this
+             * from the thread itself or once it has stopped reading.
+             *
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return The profile of the thread's reader
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            IOProfile getIOProfile(size_t threadIndex) const;
+
+            /**
+             * @brief Gets the sum of the I/O profiles of the readers of all threads.
+             *
+             * Only call this once the threads have stopped reading.
+             *
+             * @return The summed profile, with the times added up over the threads
+             */
+            IOProfile getTotalIOProfile() const;
+
+            /**
+             * @brief Gets the total number of particles in the phase space file.
+             *
+             * @return Total particle count in the file
+             */
+            std::uint64_t getNumberOfParticles() const { return numberOfParticlesInPhsp_; }
+
+            /**
+             * @brief Gets the number of original histories in the phase space file.
+             *
+             * @return Number of original histories (including empty ones)
+             */
+            std::uint64_t getNumberOfOriginalHistories() const { return numberOfOriginalHistories_; }
+
+            /**
+             * @brief Gets the number of represented histories in the file.
+             *
+             * @return Number of histories with at least one particle
+             */
+            std::uint64_t getNumberOfRepresentedHistories() const { return numberOfRepresentedHistories_; }
+
+            /**
+             * @brief Gets the number of threads used by this reader.
+             *
+             * @return Number of parallel threads
+             */
+            std::size_t getNumberOfThreads() const { return readers_.size(); }
+
+            /**
+             * @brief Gets the number of represented histories in each chunk.
+             *
+             * The last chunk of the file may contain fewer.
+             *
+             * @return Number of histories per chunk
+             */
+            std::uint64_t getHistoriesPerChunk() const { return historiesPerChunk_; }
+
+            /**
+             * @brief Gets the number of chunks the file is split into.
+             *
+             * @return Number of chunks
+             */
+            std::uint64_t getNumberOfChunks() const { return numberOfChunks_; }
+
+            /**
+             * @brief Checks if the underlying phase space format provides native represented history count.
+             *
+             * @return True if native represented history count is available, false otherwise
+             */
+            bool hasNativeRepresentedHistoryCount() const;
+
+            /**
+             * @brief Checks if the underlying phase space format provides native incremental history counters.
+             *
+             * @return True if native incremental history counters are available, false otherwise
+             */
+            bool hasNativeIncrementalHistoryCounters() const;
+
+            /**
+             * @brief Closes all underlying phase space file readers.
+             *
+             * Should be called when done reading to free file handles and resources.
+             * Automatically called by the destructor.
+             */
+            void     close();
+
+        private:
+            // Written only by the owning thread, aligned so that threads do not share cache lines
+            struct alignas(CACHE_LINE_SIZE) ThreadStatistics {
+                ThreadCounter particlesRead;
+                ThreadCounter totalHistoriesRead;
+                // Per-thread-only fields (no cross-thread access needed)
+                std::uint64_t historiesRead = 0;      // global number of the next history the reader is positioned at
+                std::uint64_t chunkEndHistory = 0;    // first history after the current chunk
+                std::uint64_t emptyHistoryError = 0;
+                HasMoreParticlesResult hasMoreParticlesCache = NEEDS_CHECKING;
+            };
+
+            bool claimNextChunk(size_t threadIndex);
+
+            std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers_;
+            std::vector<std::unique_ptr<ThreadStatistics>> threadStats_;
+            std::optional<HistoryIndex> historyIndex_;
+            alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> nextChunk_;
+
+            bool hasNativeRepresentedHistoryCount_;
+            bool hasNativeIncrementalHistoryCounters_;
+            bool hasGapsBetweenHistories_;
+            std::uint64_t historiesPerChunk_;
+            std::uint64_t numberOfChunks_;
+            std::uint64_t numberOfOriginalHistories_;
+            std::uint64_t numberOfParticlesInPhsp_;
+            std::uint64_t numberOfRepresentedHistories_;
+            std::uint64_t emptyHistoriesBetweenEachHistory_;
+            std::uint64_t perHistoryErrorContribution_;
+    };
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileWriter.h"
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Multi-threaded phase space file writer whose threads all write to the same file.
+     *
+     * ConcurrentPhaseSpaceWriter lets threads that produce particles independently, such as the
+     * worker threads of a Geant4 simulation scoring particles crossing a plane, write them to one
+     * output file without a lock around a shared writer and without shards to combine afterwards.
+     * Each thread encodes its particles with a writer of the format of its own, which keeps the
+     * thread's encode buffer and the statistics its header would hold (particle counts by type,
+     * energy ranges, TOPAS statistics and so on). Once the buffer of a thread is full and its
+     * current history complete, the thread reserves the next range of the file with an atomic
+     * increment of the end offset and writes its histories there through a file handle of its
+     * own, so threads only ever wait for one another in the file system. The statistics and the
+     * history counts of all the threads, empty histories included, are merged into the header of
+     * the file when it is closed.
+     *
+     * Histories are never split between blocks, so every history of the file holds the particles
+     * of a single thread, but the histories of different threads are interleaved in the order
+     * their blocks were written. A history bigger than the buffer of its thread is kept in memory
+     * until it is complete.
+     *
+     * @note Each thread must use its assigned thread index when calling methods, and the first
+     *       particle written by each thread must start a new history.
+     * @note Only formats whose records the library writes itself can be written concurrently, so
+     *       not those of FormatType::NONE such as ROOT, and the file cannot be standard output.
+     */
+    class ConcurrentPhaseSpaceWriter {
+
+        public:
+            /**
+             * @brief Constructs a writer with one encoder for each thread.
+             *
+             * @param fileName Path of the output file
+             * @param numberOfThreads Number of threads that will write
+             * @param options User options for configuring the writers (format-specific settings)
+             * @param fixedValues Constant values of the particles of the file
+             * @param formatName Name of the format to write, or empty to choose it from the file extension
+             *
+             * @throws std::invalid_argument If numberOfThreads is zero
+             * @throws std::runtime_error If a PhaseSpaceFileWriter cannot be created or the format cannot be written concurrently
+             */
+            ConcurrentPhaseSpaceWriter(const std::string& fileName, size_t numberOfThreads, const UserOptions& options = {}, const FixedValues& fixedValues = {}, const std::string& formatName = "");
+
+            /**
+             * @brief Destructor that closes the file.
+             */
+            ~ConcurrentPhaseSpaceWriter();
+
+            /**
+             * @brief Writes a particle from a specific thread.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If the writer is closed or the particle cannot be written
+             */
+            void     writeParticle(size_t threadIndex, const Particle& particle);
+
+            /**
+             * @brief Writes a particle from a specific thread, moving from it.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If the writer is closed or the particle cannot be written
+             */
+            void     writeParticle(size_t threadIndex, Particle&& particle);
+
+            /**
+             * @brief Adds empty histories from a specific thread.
+             *
+             * The histories are accounted for as PhaseSpaceFileWriter::addAdditionalHistories()
+             * does, with the next particle of the thread or in the header once the file is closed.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param additionalHistories The number of additional (empty) histories to account for
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories);
+
+            /**
+             * @brief Gets the path of the output file.
+             *
+             * @return The output file path
+             */
+            const std::string & getFileName() const { return fileName_; }
+
+            /**
+             * @brief Gets the number of threads the writer was made for.
+             *
+             * @return Number of threads
+             */
+            std::size_t getNumberOfThreads() const { return lanes_.size(); }
+
+            /**
+             * @brief Gets the total number of histories written by all threads.
+             *
+             * Only call this once every thread has finished writing.
+             *
+             * @return Total number of histories written
+             */
+            std::uint64_t getHistoriesWritten() const;
+
+            /**
+             * @brief Gets the total number of particles written by all threads.
+             *
+             * Only call this once every thread has finished writing.
+             *
+             * @return Total number of particles written
+             */
+            std::uint64_t getParticlesWritten() const;
+
+            /**
+             * @brief Gets the sum of the I/O profiles of the writers of all threads.
+             *
+             * Only call this once every thread has finished writing.
+             *
+             * @return The summed profile, with the times added up over the threads
+             */
+            IOProfile getIOProfile() const;
+
+            /**
+             * @brief Writes the histories still buffered by the threads and closes the file.
+             *
+             * The statistics of all the threads are merged and the header is written. Must only be
+             * called once every thread has finished writing. Automatically called by the destructor.
+             *
+             * @throws std::runtime_error If the particles or the header cannot be written
+             */
+            void     close();
+
+        private:
+            struct Lane; // the encoder, file handle and buffered histories of a thread
+
+            Lane & getLane(size_t threadIndex, const char * method);
+            void   writeParticleInLane(Lane & lane, Particle & particle);
+            void   writeBlock(Lane & lane);
+
+            std::string fileName_;
+            std::unique_ptr<PhaseSpaceFileWriter> writer_;        /// writer of the file itself, which only writes the header and what close() leaves to it
+            std::vector<std::unique_ptr<Lane>> lanes_;
+            std::size_t maximumRecordLength_;                     /// most bytes a particle can take in a buffer
+            std::atomic<std::uint64_t> endOffset_;                /// offset of the end of the ranges of the file reserved so far
+            bool closed_;
+    };
+
+}
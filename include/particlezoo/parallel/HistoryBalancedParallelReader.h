@@ -2,14 +2,18 @@
 #pragma once
 
 #include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/parallel/HistoryPartition.h"
+#include "particlezoo/parallel/ThreadCounter.h"
+#include "particlezoo/parallel/ThreadPlacement.h"
 
 #include <vector>
+#include <span>
 #include <memory>
 #include <string>
 #include <cstdint>
 #include <limits>
-#include <mutex>
 #include <atomic>
+#include <utility>
 
 namespace ParticleZoo {
 
@@ -33,6 +37,8 @@ namespace ParticleZoo {
      * - History partitioning across threads with proper boundary alignment
      * - Empty history gap distribution for files with empty histories
      * - Thread-safe particle retrieval without locking (each thread has its own reader)
+     * - Opening the reader of each thread on that thread, on the NUMA node it runs on or is placed
+     *   on, when given ThreadPlacementCommand or setThreadPlacement() (see ThreadReaderPlacement)
      * 
      * @note Each thread must use its assigned thread index when calling methods.
      * @note Incremental history counts are derived from represented histories only and do not reflect empty histories counts directly recorded in the phase space file if present.
@@ -56,14 +62,48 @@ namespace ParticleZoo {
              * represented histories evenly across threads, with remainder histories distributed
              * to the first N threads.
              * 
+             * Finding where each thread starts requires knowing where histories begin in the file. This
+             * is taken from the history index sidecar file if there is one (see HistoryIndex), otherwise
+             * files that can be seeked directly are scanned by all of the readers concurrently, each over
+             * its own share of the records, and other files are scanned sequentially (see
+             * HistoryPartition::Compute()).
+             * 
+             * With ThreadPlacementCommand in the options, the readers positioned by the constructor are
+             * closed again and each thread opens a reader of its own at its starting record the first
+             * time it reads, pinned to a NUMA node or CPU as the policy asks, so that its buffers are
+             * allocated on its own node.
+             * 
              * @param filename Path to the phase space file to read
              * @param options User options for configuring the reader (format-specific settings)
              * @param numThreads Number of parallel threads that will read from this file
              * 
              * @throws std::runtime_error If the file cannot be opened or contains zero histories
              * @throws std::runtime_error If a PhaseSpaceFileReader cannot be created
+             * @throws std::invalid_argument If the thread placement policy is unknown
              */
             HistoryBalancedParallelReader(const std::string& filename, const UserOptions& options = {}, size_t numThreads = 1);
+
+            /**
+             * @brief Constructs a multi-threaded phase space reader for a partition computed elsewhere.
+             * 
+             * Each thread reads one part of the partition, so the file is not scanned and the readers
+             * are only positioned at the first records of their parts. The partition may be a slice of
+             * a larger one (see HistoryPartition::slice()), in which case the last thread stops where
+             * the slice ends and the histories read add up to those of the slice, with the empty
+             * histories of the file spread over them in the same way as when every part is read by
+             * one reader. This lets several processes share the reading of one file without each of
+             * them scanning it, see MPIPartitionedIO.h. The file counts returned, such as
+             * getNumberOfRepresentedHistories(), remain those of the whole file.
+             * 
+             * @param filename Path to the phase space file the partition was computed for
+             * @param options User options for configuring the reader (format-specific settings)
+             * @param partition The parts to read, one for each thread
+             * 
+             * @throws std::runtime_error If the file cannot be opened or a PhaseSpaceFileReader cannot be created
+             * @throws std::invalid_argument If the partition was computed for a file with a different number of particles
+             * @throws std::invalid_argument If the thread placement policy is unknown
+             */
+            HistoryBalancedParallelReader(const std::string& filename, const UserOptions& options, const HistoryPartition& partition);
             
             /**
              * @brief Destructor that closes all underlying readers.
@@ -118,6 +158,21 @@ namespace ParticleZoo {
              * @note Always call this before getNextParticle() to avoid exceptions
              */
             bool     hasMoreParticles(size_t threadIndex);
+
+            /**
+             * @brief Reads the next particles of a specific thread into a contiguous array.
+             * 
+             * Equivalent to calling getNextParticle() while hasMoreParticles() is true. The
+             * particles are read one at a time, since the end of the thread's share is only found
+             * from the history boundaries.
+             * 
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @param particles The particles to fill from the front
+             * @return The number of particles read, 0 once the thread has no more particles
+             * 
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            std::size_t readParticles(size_t threadIndex, std::span<Particle> particles);
             
             /**
              * @brief Gets the total number of histories processed by a specific thread.
@@ -159,6 +214,58 @@ namespace ParticleZoo {
              */
             std::uint64_t getTotalHistoriesRead() const;
 
+            /**
+             * @brief Gets the I/O profile of the reader of a specific thread.
+             *
+             * The ioSeconds of the profile is the time the thread was blocked waiting for its
+             * reader to read the file, see PhaseSpaceFileReader::getIOProfile(). Only call this
+             * from the thread itself or once it has stopped reading.
+             *
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return The profile of the thread's reader
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            IOProfile getIOProfile(size_t threadIndex) const;
+
+            /**
+             * @brief Gets the sum of the I/O profiles of the readers of all threads.
+             *
+             * Only call this once the threads have stopped reading.
+             *
+             * @return The summed profile, with the times added up over the threads
+             */
+            IOProfile getTotalIOProfile() const;
+
+            /**
+             * @brief Sets where a specific thread opens its reader, overriding ThreadPlacementCommand.
+             * 
+             * The thread opens a reader of its own the first time it reads, held to the NUMA node or
+             * CPU of the placement so that the buffers of the reader are allocated there, and stays
+             * pinned to it if the placement says so. Must be called before any thread starts reading.
+             * 
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @param placement The node or CPU to open the reader of the thread on
+             * 
+             * @throws std::out_of_range If threadIndex is invalid or the node or CPU does not exist
+             * @throws std::runtime_error If a thread has already read particles
+             */
+            void setThreadPlacement(size_t threadIndex, const ThreadPlacement & placement);
+
+            /**
+             * @brief Gets the bytes of the file holding the share of the histories of a specific thread.
+             * 
+             * Threads read their shares from contiguous, consecutive parts of the file, so the range
+             * can be used to read ahead or advise the operating system about the part of the file a
+             * thread is about to read from the thread itself, on its own NUMA node.
+             * 
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return The offsets of the first byte of the share and of the byte after its last
+             * 
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If the file is not a binary file, whose records are at fixed offsets
+             */
+            std::pair<std::uint64_t, std::uint64_t> getByteRange(size_t threadIndex) const;
+
             /**
              * @brief Gets the total number of particles in the phase space file.
              * 
@@ -217,19 +324,27 @@ namespace ParticleZoo {
             void     close();
 
         private:
-            struct ThreadStatistics {
-                mutable std::mutex mutex; // For thread-safe updates
-                std::atomic<std::uint64_t> particlesRead = 0;
-                std::atomic<std::uint64_t> totalHistoriesRead = 0;
+            // Written only by the owning thread, aligned so that threads do not share cache lines
+            struct alignas(CACHE_LINE_SIZE) ThreadStatistics {
+                ThreadCounter particlesRead;
+                ThreadCounter totalHistoriesRead;
                 // Per-thread-only fields (no cross-thread access needed)
                 std::uint64_t historiesRead = 0;
                 std::uint64_t emptyHistoryError = 0;
                 HasMoreParticlesResult hasMoreParticlesCache = NEEDS_CHECKING;
             };
 
-            std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers_;
+            void createReaders(const std::string& filename, const UserOptions& options, size_t numThreads);
+            void setPartition(const HistoryPartition& partition);
+            PhaseSpaceFileReader & getReader(size_t threadIndex);
+            void releaseReader(size_t threadIndex);
+
+            std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers_;  // null for a thread that has not opened its reader yet
+            std::shared_ptr<PhaseSpaceFileReader> prototype_;             // read by no thread, cloned to open the readers of the threads
+            ThreadReaderPlacement placement_;
             std::vector<std::unique_ptr<ThreadStatistics>> threadStats_;
             std::vector<std::uint64_t> startingHistorys_;
+            std::vector<std::uint64_t> startingRecords_;
 
             bool hasNativeRepresentedHistoryCount_;
             bool hasNativeIncrementalHistoryCounters_;
@@ -237,6 +352,8 @@ namespace ParticleZoo {
             std::uint64_t numberOfOriginalHistories_;
             std::uint64_t numberOfParticlesInPhsp_;
             std::uint64_t numberOfRepresentedHistories_;
+            std::uint64_t endingHistory_;   // the represented history the last thread stops before
+            std::uint64_t endingRecord_;    // the record the last thread stops before, HistoryPartition::END_OF_FILE for the end of the file
             std::uint64_t emptyHistoriesBetweenEachHistory_;
             std::uint64_t perHistoryErrorContribution_;
     };
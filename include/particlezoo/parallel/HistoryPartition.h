@@ -0,0 +1,185 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Division of the represented histories of a phase space file into contiguous parts.
+     *
+     * The histories are divided as evenly as possible, the first parts taking one history more
+     * when they do not divide exactly, and each part records the first history it reads and the
+     * record that history starts at. HistoryBalancedParallelReader computes a partition with one part
+     * per thread when it is constructed, and can also be constructed from a partition computed
+     * elsewhere, so that finding where the parts start is only done once however many readers
+     * share the file. This is how the ranks of an MPI job read one file (see MPIPartitionedIO.h):
+     * one rank computes a partition with a part for every thread of every rank, broadcasts it with
+     * encode() and Decode(), and each rank reads its slice() of consecutive parts.
+     *
+     * Finding the parts takes the history index sidecar if there is one (see HistoryIndex).
+     * Otherwise files that can be seeked directly are scanned by the readers given concurrently,
+     * each over its own share of the records, and other files are scanned sequentially.
+     */
+    class HistoryPartition {
+        public:
+            /**
+             * @brief Value of getEndRecord() for a partition whose last part reads to the end of the file.
+             */
+            static constexpr std::uint64_t END_OF_FILE = std::numeric_limits<std::uint64_t>::max();
+
+            /**
+             * @brief Where a part of the partition starts.
+             */
+            struct Part {
+                std::uint64_t firstHistory{0};  ///< Zero-based number of the first represented history of the part
+                std::uint64_t firstRecord{0};   ///< Index of the record the part starts at, which starts its first history
+            };
+
+            /**
+             * @brief Compute a partition of a phase space file.
+             *
+             * @param fileName Path to the phase space file
+             * @param options User options for configuring the readers (format-specific settings)
+             * @param numberOfParts Number of parts to divide the histories into
+             * @param numberOfScanThreads Number of readers scanning the file at once when it has to be scanned
+             * @return HistoryPartition The partition covering every history of the file
+             *
+             * @throws std::invalid_argument If numberOfParts or numberOfScanThreads is zero
+             * @throws std::runtime_error If the file cannot be read or contains too few histories
+             */
+            static HistoryPartition Compute(const std::string & fileName, const UserOptions & options, std::size_t numberOfParts, std::size_t numberOfScanThreads = 1);
+
+            /**
+             * @brief Compute a partition of a phase space file with readers already open on it.
+             *
+             * The readers are read from and seeked as the file is scanned. When there are as many
+             * readers as parts, reader i is left at the first record of part i where the scan allows
+             * it, the positions of the readers are unspecified otherwise.
+             *
+             * @param readers Readers of the file, one for each thread scanning it
+             * @param numberOfParts Number of parts to divide the histories into
+             * @return HistoryPartition The partition covering every history of the file
+             *
+             * @throws std::invalid_argument If numberOfParts is zero or there is no reader
+             * @throws std::runtime_error If the file contains too few histories
+             */
+            static HistoryPartition Compute(const std::vector<std::shared_ptr<PhaseSpaceFileReader>> & readers, std::size_t numberOfParts);
+
+            /**
+             * @brief Rebuild a partition from the values returned by encode().
+             *
+             * @param values The encoded partition
+             * @return HistoryPartition The partition
+             *
+             * @throws std::invalid_argument If the values are not an encoded partition
+             */
+            static HistoryPartition Decode(std::span<const std::uint64_t> values);
+
+            /**
+             * @brief Encode the partition as a flat list of integers, to be sent to other processes.
+             *
+             * @return std::vector<std::uint64_t> The encoded partition, see Decode()
+             */
+            std::vector<std::uint64_t> encode() const;
+
+            /**
+             * @brief Get consecutive parts of the partition as a partition of their own.
+             *
+             * The slice keeps the history counts of the whole file, so that a HistoryBalancedParallelReader
+             * constructed from it spreads the empty histories of the file in the same way as one reading
+             * every part, and ends where the part after it starts.
+             *
+             * @param firstPart Index of the first part of the slice
+             * @param numberOfParts Number of parts in the slice
+             * @return HistoryPartition The slice
+             *
+             * @throws std::out_of_range If the parts are not all in the partition or numberOfParts is zero
+             */
+            HistoryPartition slice(std::size_t firstPart, std::size_t numberOfParts) const;
+
+            /**
+             * @brief Get the number of parts.
+             *
+             * @return std::size_t The number of parts
+             */
+            std::size_t getNumberOfParts() const;
+
+            /**
+             * @brief Get where a part starts.
+             *
+             * @param partIndex The index of the part
+             * @return const Part & The first history and record of the part
+             *
+             * @throws std::out_of_range If partIndex is invalid
+             */
+            const Part & getPart(std::size_t partIndex) const;
+
+            /**
+             * @brief Get the represented history the partition ends before.
+             *
+             * @return std::uint64_t One past the last history of the last part
+             */
+            std::uint64_t getEndHistory() const;
+
+            /**
+             * @brief Get the record the partition ends before.
+             *
+             * @return std::uint64_t The first record of the part after the last one, END_OF_FILE if the last part reads to the end of the file
+             */
+            std::uint64_t getEndRecord() const;
+
+            /**
+             * @brief Get the number of represented histories in the whole file.
+             *
+             * @return std::uint64_t Number of histories with at least one particle
+             */
+            std::uint64_t getNumberOfRepresentedHistories() const;
+
+            /**
+             * @brief Get the number of original histories in the whole file.
+             *
+             * @return std::uint64_t Number of original histories, including empty ones
+             */
+            std::uint64_t getNumberOfOriginalHistories() const;
+
+            /**
+             * @brief Get the number of particles in the whole file.
+             *
+             * @return std::uint64_t Number of particles, used to check that a partition is used with the file it was computed for
+             */
+            std::uint64_t getNumberOfParticles() const;
+
+        private:
+            HistoryPartition() = default;
+
+            std::vector<Part> parts_;
+            std::uint64_t endHistory_{0};
+            std::uint64_t endRecord_{END_OF_FILE};
+            std::uint64_t numberOfRepresentedHistories_{0};
+            std::uint64_t numberOfOriginalHistories_{0};
+            std::uint64_t numberOfParticles_{0};
+    };
+
+    // Inline implementations for the HistoryPartition class
+
+    inline std::size_t HistoryPartition::getNumberOfParts() const { return parts_.size(); }
+
+    inline std::uint64_t HistoryPartition::getEndHistory() const { return endHistory_; }
+
+    inline std::uint64_t HistoryPartition::getEndRecord() const { return endRecord_; }
+
+    inline std::uint64_t HistoryPartition::getNumberOfRepresentedHistories() const { return numberOfRepresentedHistories_; }
+
+    inline std::uint64_t HistoryPartition::getNumberOfOriginalHistories() const { return numberOfOriginalHistories_; }
+
+    inline std::uint64_t HistoryPartition::getNumberOfParticles() const { return numberOfParticles_; }
+
+}
@@ -0,0 +1,499 @@
+#pragma once
+
+/**
+ * @file MPIPartitionedIO.h
+ * @brief Reading and writing one phase space across the ranks of an MPI job.
+ *
+ * Header only, so that the library itself does not depend on MPI: a program including this header
+ * is compiled with the compiler wrapper of its MPI installation (mpicxx) and linked against the
+ * library as usual.
+ *
+ * For reading, one rank computes a HistoryPartition of the input file with a part for every thread
+ * of every rank, from the history index if there is one and by scanning the file otherwise, and
+ * broadcasts it. Each rank then reads its slice of consecutive parts with a
+ * HistoryBalancedParallelReader, so no rank scans the file and the histories of the slices add up
+ * to those of the file. For writing, MPIPhaseSpaceWriter has every rank write its own files, which
+ * are then either listed in a phase space set or written into a single file by all of the ranks at
+ * once with MPI-IO.
+ */
+
+#include <mpi.h>
+
+#include "particlezoo/PhaseSpaceSet.h"
+#include "particlezoo/parallel/HistoryBalancedParallelReader.h"
+#include "particlezoo/parallel/HistoryPartition.h"
+#include "particlezoo/parallel/ShardedParallelWriter.h"
+#include "particlezoo/utilities/formats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Make every rank of a communicator fail if any of them failed.
+     *
+     * Collective. Every rank passes the error it caught in a step, if any. Ranks that failed rethrow
+     * their own error, the others throw a std::runtime_error, so that no rank goes on to the next
+     * collective call while another one has left.
+     *
+     * @param comm The communicator of the ranks
+     * @param error The error caught by the calling rank, or null if it succeeded
+     * @param operation What the ranks were doing, for the message of the error
+     * @throws std::runtime_error or the error of the calling rank if any rank failed
+     */
+    inline void CheckAllRanksSucceeded(MPI_Comm comm, std::exception_ptr error, const std::string & operation) {
+        int succeeded = error ? 0 : 1;
+        int allSucceeded = 0;
+        MPI_Allreduce(&succeeded, &allSucceeded, 1, MPI_INT, MPI_LAND, comm);
+        if (error) std::rethrow_exception(error);
+        if (!allSucceeded) {
+            throw std::runtime_error(operation + " failed on another rank.");
+        }
+    }
+
+    /**
+     * @brief Compute the history partition of a phase space file on one rank and broadcast it to all.
+     *
+     * Collective. The partition has threadsPerRank parts for every rank of the communicator, rank r
+     * reading parts r * threadsPerRank to (r + 1) * threadsPerRank - 1. The root computes it with
+     * threadsPerRank readers scanning the file at once (see HistoryPartition::Compute()) while the
+     * other ranks wait, so building a history index for the file beforehand (see PHSPIndex) makes
+     * this a matter of reading the index.
+     *
+     * @param comm The communicator of the ranks reading the file
+     * @param fileName Path to the phase space file, which every rank must be able to open
+     * @param options User options for configuring the readers (format-specific settings)
+     * @param threadsPerRank Number of threads reading on each rank, the same on every rank
+     * @param root The rank computing the partition
+     * @return HistoryPartition The partition of the whole file, on every rank
+     *
+     * @throws std::invalid_argument If threadsPerRank is zero
+     * @throws std::runtime_error If the partition could not be computed
+     */
+    inline HistoryPartition BroadcastHistoryPartition(MPI_Comm comm, const std::string & fileName, const UserOptions & options, std::size_t threadsPerRank, int root = 0) {
+        if (threadsPerRank < 1) {
+            throw std::invalid_argument("Number of threads per rank must be at least 1 in BroadcastHistoryPartition");
+        }
+        int rank = 0;
+        int numberOfRanks = 1;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &numberOfRanks);
+
+        std::vector<std::uint64_t> values;
+        std::exception_ptr error;
+        if (rank == root) {
+            try {
+                values = HistoryPartition::Compute(fileName, options, static_cast<std::size_t>(numberOfRanks) * threadsPerRank, threadsPerRank).encode();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        CheckAllRanksSucceeded(comm, error, "Computing the history partition of " + fileName);
+
+        std::uint64_t numberOfValues = values.size();
+        MPI_Bcast(&numberOfValues, 1, MPI_UINT64_T, root, comm);
+        values.resize(static_cast<std::size_t>(numberOfValues));
+        MPI_Bcast(values.data(), static_cast<int>(numberOfValues), MPI_UINT64_T, root, comm);
+        return HistoryPartition::Decode(values);
+    }
+
+    /**
+     * @brief Open the share of a phase space file of the calling rank, divided between its threads.
+     *
+     * Collective, see BroadcastHistoryPartition(). The reader returned has threadsPerRank threads,
+     * each reading one part of the slice of the calling rank, and the thread placement in the options
+     * applies to them as for any HistoryBalancedParallelReader.
+     *
+     * @param comm The communicator of the ranks reading the file
+     * @param fileName Path to the phase space file, which every rank must be able to open
+     * @param options User options for configuring the readers (format-specific settings)
+     * @param threadsPerRank Number of threads reading on each rank, the same on every rank
+     * @return std::unique_ptr<HistoryBalancedParallelReader> The reader of the slice of the calling rank
+     *
+     * @throws std::invalid_argument If threadsPerRank is zero
+     * @throws std::runtime_error If the partition could not be computed or the file cannot be opened
+     */
+    inline std::unique_ptr<HistoryBalancedParallelReader> CreateRankParallelReader(MPI_Comm comm, const std::string & fileName, const UserOptions & options, std::size_t threadsPerRank) {
+        const HistoryPartition partition = BroadcastHistoryPartition(comm, fileName, options, threadsPerRank);
+        int rank = 0;
+        MPI_Comm_rank(comm, &rank);
+        return std::make_unique<HistoryBalancedParallelReader>(fileName, options, partition.slice(static_cast<std::size_t>(rank) * threadsPerRank, threadsPerRank));
+    }
+
+    /**
+     * @brief Phase space writer spread over the ranks of an MPI job.
+     *
+     * Every rank writes its particles to files of its own through a ShardedParallelWriter with a
+     * shard for each of its threads, named after the output file with the rank and the shard index
+     * added to the stem (beam_rank2_shard0.IAEAphsp and so on), so that writing needs no
+     * communication at all. Histories read with CreateRankParallelReader() and written by the same
+     * thread stay whole and in order. Once every rank is done the files are finished in one of two
+     * ways, both collective and neither copying the files through a single rank:
+     *
+     * - close() leaves the files as they are and has the root write a phase space set listing all
+     *   of them in rank order (beam.pzset), whose header counts are the sums of theirs, so it can be
+     *   read as one phase space by any reader or tool.
+     * - concatenate() writes the records of every file into the output file itself with MPI-IO, each
+     *   rank copying its own files to an offset found from the sizes of the files of the ranks before
+     *   it, while the root merges the statistics in their headers into the header of the output
+     *   file as ShardedParallelWriter::concatenate() does.
+     *
+     * The files of all of the ranks must be on a file system that every rank can read.
+     *
+     * @note Each thread must use its assigned thread index when calling methods.
+     * @note concatenate() is only available for formats that support
+     *       PhaseSpaceFileWriter::appendRecordsFrom() and write their files themselves, so not for ROOT.
+     */
+    class MPIPhaseSpaceWriter {
+        public:
+            /**
+             * @brief Constructs the writer of the calling rank.
+             *
+             * Not collective, but every rank of the communicator must construct one for the same file.
+             *
+             * @param comm The communicator of the ranks writing the file
+             * @param fileName Path of the output file, the files of the ranks are written next to it
+             * @param numberOfThreads Number of threads writing on the calling rank
+             * @param options User options for configuring the writers (format-specific settings)
+             * @param fixedValues Constant values shared by all of the files
+             * @param formatName Name of the format to write, or empty to choose it from the file extension
+             *
+             * @throws std::invalid_argument If numberOfThreads is zero
+             * @throws std::runtime_error If a PhaseSpaceFileWriter cannot be created
+             */
+            MPIPhaseSpaceWriter(MPI_Comm comm, const std::string & fileName, size_t numberOfThreads = 1, const UserOptions & options = {}, const FixedValues & fixedValues = {}, const std::string & formatName = "");
+
+            /**
+             * @brief Gets the name of the files of a rank, before the shard index is added.
+             *
+             * @param fileName Path of the output file
+             * @param rank The rank
+             * @return The path with the rank added to the stem of the file name
+             */
+            static std::string RankFileName(const std::string & fileName, int rank);
+
+            /**
+             * @brief Gets the name of the set file written by close().
+             *
+             * @param fileName Path of the output file
+             * @return The path with the extension replaced by .pzset
+             */
+            static std::string SetFileName(const std::string & fileName);
+
+            /**
+             * @brief Writes a particle to the file of a specific thread of the calling rank.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     writeParticle(size_t threadIndex, const Particle & particle);
+
+            /**
+             * @brief Writes a particle to the file of a specific thread of the calling rank, moving from it.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     writeParticle(size_t threadIndex, Particle && particle);
+
+            /**
+             * @brief Adds empty histories to the file of a specific thread of the calling rank.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfThreads-1)
+             * @param additionalHistories The number of additional (empty) histories to account for
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories);
+
+            /**
+             * @brief Gets the writer of the files of the calling rank.
+             *
+             * @return The sharded writer of the rank, with a shard for each of its threads
+             */
+            ShardedParallelWriter & getRankWriter();
+
+            /**
+             * @brief Gets the path of the output file.
+             *
+             * @return The output file path
+             */
+            const std::string & getFileName() const;
+
+            /**
+             * @brief Closes the files of every rank and lists them in a phase space set.
+             *
+             * Collective. The root writes the set to SetFileName() once every rank has closed its
+             * files. Does nothing once the files have been closed or concatenated.
+             *
+             * @throws std::runtime_error If the files of any rank cannot be closed or the set cannot be written
+             */
+            void     close();
+
+            /**
+             * @brief Closes the files of every rank and writes their records into the output file.
+             *
+             * Collective. The records of the files are written in rank and shard order, so the output
+             * file holds the same particles as the set close() would have written, with the statistics
+             * of all of the files merged into its header.
+             *
+             * @param removeShards Whether to delete the files of the ranks once the output file is complete
+             *
+             * @throws std::runtime_error If the format does not support appending records, the files have already been closed or concatenated, or writing fails on any rank
+             */
+            void     concatenate(bool removeShards = true);
+
+        private:
+            static constexpr int ROOT = 0;
+            static constexpr std::size_t COPY_BLOCK_SIZE = 4 * 1024 * 1024; // bytes written by each MPI-IO call
+
+            std::vector<std::string> gatherShardFileNames() const;
+            void writeRecordsAt(MPI_File file, MPI_Offset offset);
+
+            MPI_Comm comm_;
+            int rank_;
+            int numberOfRanks_;
+            std::string fileName_;
+            UserOptions options_;
+            FixedValues fixedValues_;
+            std::string formatName_;
+            ShardedParallelWriter rankWriter_;
+            bool finished_;
+    };
+
+    // Inline implementations for the MPIPhaseSpaceWriter class
+
+    inline MPIPhaseSpaceWriter::MPIPhaseSpaceWriter(MPI_Comm comm, const std::string & fileName, size_t numberOfThreads, const UserOptions & options, const FixedValues & fixedValues, const std::string & formatName)
+    :   comm_(comm),
+        rank_([comm]() { int rank = 0; MPI_Comm_rank(comm, &rank); return rank; }()),
+        numberOfRanks_([comm]() { int size = 1; MPI_Comm_size(comm, &size); return size; }()),
+        fileName_(fileName),
+        options_(options),
+        fixedValues_(fixedValues),
+        formatName_(formatName),
+        rankWriter_(RankFileName(fileName, rank_), numberOfThreads, options, fixedValues, formatName),
+        finished_(false)
+    {}
+
+    inline std::string MPIPhaseSpaceWriter::RankFileName(const std::string & fileName, int rank) {
+        const std::filesystem::path path(fileName);
+        std::filesystem::path rankName = path.stem();
+        rankName += "_rank" + std::to_string(rank);
+        rankName += path.extension();
+        return (path.parent_path() / rankName).string();
+    }
+
+    inline std::string MPIPhaseSpaceWriter::SetFileName(const std::string & fileName) {
+        return std::filesystem::path(fileName).replace_extension(".pzset").string();
+    }
+
+    inline void MPIPhaseSpaceWriter::writeParticle(size_t threadIndex, const Particle & particle) {
+        rankWriter_.writeParticle(threadIndex, particle);
+    }
+
+    inline void MPIPhaseSpaceWriter::writeParticle(size_t threadIndex, Particle && particle) {
+        rankWriter_.writeParticle(threadIndex, std::move(particle));
+    }
+
+    inline void MPIPhaseSpaceWriter::addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories) {
+        rankWriter_.addAdditionalHistories(threadIndex, additionalHistories);
+    }
+
+    inline ShardedParallelWriter & MPIPhaseSpaceWriter::getRankWriter() { return rankWriter_; }
+
+    inline const std::string & MPIPhaseSpaceWriter::getFileName() const { return fileName_; }
+
+    inline std::vector<std::string> MPIPhaseSpaceWriter::gatherShardFileNames() const {
+        // The ranks may have different numbers of threads, the names follow from the number of shards of each
+        std::uint64_t numberOfShards = rankWriter_.getNumberOfShards();
+        std::vector<std::uint64_t> shardsOfRanks(static_cast<std::size_t>(numberOfRanks_));
+        MPI_Gather(&numberOfShards, 1, MPI_UINT64_T, shardsOfRanks.data(), 1, MPI_UINT64_T, ROOT, comm_);
+
+        std::vector<std::string> fileNames;
+        if (rank_ == ROOT) {
+            for (int rank = 0; rank < numberOfRanks_; rank++) {
+                for (std::uint64_t shard = 0; shard < shardsOfRanks[static_cast<std::size_t>(rank)]; shard++) {
+                    fileNames.push_back(ShardedParallelWriter::ShardFileName(RankFileName(fileName_, rank), static_cast<std::size_t>(shard)));
+                }
+            }
+        }
+        return fileNames;
+    }
+
+    inline void MPIPhaseSpaceWriter::close() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        std::exception_ptr error;
+        try {
+            rankWriter_.close();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        CheckAllRanksSucceeded(comm_, error, "Closing the rank files of " + fileName_);
+
+        const std::vector<std::string> fileNames = gatherShardFileNames();
+        if (rank_ == ROOT) {
+            try {
+                PhaseSpaceSet::WriteSetFile(SetFileName(fileName_), fileNames);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        CheckAllRanksSucceeded(comm_, error, "Writing the set file of " + fileName_);
+    }
+
+    inline void MPIPhaseSpaceWriter::concatenate(bool removeShards) {
+        if (finished_) {
+            throw std::runtime_error("The rank files of " + fileName_ + " have already been closed or concatenated.");
+        }
+        finished_ = true;
+
+        // Every file has to be complete, headers included, before the root reads the headers of all of them
+        std::exception_ptr error;
+        try {
+            rankWriter_.close();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        CheckAllRanksSucceeded(comm_, error, "Closing the rank files of " + fileName_);
+        const std::vector<std::string> fileNames = gatherShardFileNames();
+
+        // The root creates the output file and merges the statistics of every file from its header, as appendRecordsFrom() would
+        std::unique_ptr<PhaseSpaceFileWriter> writer;
+        std::uint64_t recordStartOffset = 0;
+
+        // Writers must be closed before they are destroyed, and no partial output file is left behind if a step fails
+        auto checkAllRanksSucceeded = [&](const std::string & operation) {
+            try {
+                CheckAllRanksSucceeded(comm_, error, operation);
+            } catch (...) {
+                if (writer) {
+                    const std::vector<std::string> outputFiles = writer->getOutputFileNames();
+                    try {
+                        writer->close();
+                    } catch (...) {}
+                    writer.reset();
+                    for (const std::string & outputFile : outputFiles) std::filesystem::remove(outputFile);
+                }
+                throw;
+            }
+        };
+        if (rank_ == ROOT) {
+            try {
+                writer = formatName_.empty()
+                       ? FormatRegistry::CreateWriter(fileName_, options_, fixedValues_)
+                       : FormatRegistry::CreateWriter(formatName_, fileName_, options_, fixedValues_);
+                if (!writer) {
+                    throw std::runtime_error("Failed to create PhaseSpaceFileWriter for file: " + fileName_);
+                }
+                if (writer->formatType_ == FormatType::NONE) {
+                    throw std::runtime_error("The " + writer->getPHSPFormat() + " format writes its files through a library of its own, so the rank files of " + fileName_ + " cannot be written into it with MPI-IO. Use close() to list them in a set instead.");
+                }
+                for (const std::string & shardFileName : fileNames) {
+                    auto reader = FormatRegistry::CreateReader(shardFileName, options_);
+                    if (!reader) {
+                        throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + shardFileName);
+                    }
+                    if (!writer->canAppendRecordsFrom(*reader)) {
+                        throw std::runtime_error("The records of " + shardFileName + " cannot be copied into " + fileName_ + " since their formats or record layouts differ.");
+                    }
+                    writer->mergeStatisticsFrom(*reader);
+                    writer->historiesWritten_ += reader->getNumberOfOriginalHistories();
+                    writer->particlesWritten_ += reader->getNumberOfParticles();
+                    reader->close();
+                }
+                if (writer->particlesWritten_ > writer->getMaximumSupportedParticles()) {
+                    throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(writer->getMaximumSupportedParticles()) + ").");
+                }
+                recordStartOffset = writer->getParticleRecordStartOffset();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        checkAllRanksSucceeded("Merging the headers of the rank files of " + fileName_);
+        MPI_Bcast(&recordStartOffset, 1, MPI_UINT64_T, ROOT, comm_);
+
+        // Each rank writes its records after those of the ranks before it
+        std::uint64_t recordBytes = 0;
+        for (size_t shard = 0; shard < rankWriter_.getNumberOfShards(); shard++) {
+            const PhaseSpaceFileWriter & shardWriter = rankWriter_.getShard(shard);
+            recordBytes += std::filesystem::file_size(shardWriter.getFileName()) - shardWriter.getParticleRecordStartOffset();
+        }
+        std::uint64_t rankOffset = 0;
+        std::uint64_t totalRecordBytes = 0;
+        MPI_Exscan(&recordBytes, &rankOffset, 1, MPI_UINT64_T, MPI_SUM, comm_);
+        MPI_Allreduce(&recordBytes, &totalRecordBytes, 1, MPI_UINT64_T, MPI_SUM, comm_);
+        if (rank_ == ROOT) rankOffset = 0; // left undefined by MPI_Exscan
+
+        MPI_File file;
+        if (MPI_File_open(comm_, fileName_.c_str(), MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+            error = std::make_exception_ptr(std::runtime_error("Failed to open file with MPI-IO: " + fileName_));
+        } else {
+            try {
+                writeRecordsAt(file, static_cast<MPI_Offset>(recordStartOffset + rankOffset));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            MPI_File_close(&file);
+        }
+        checkAllRanksSucceeded("Writing the records of the rank files into " + fileName_);
+
+        // The root's writer wrote nothing yet, so closing it only writes the header
+        if (rank_ == ROOT) {
+            try {
+                writer->file_.seekp(static_cast<std::streamoff>(recordStartOffset + totalRecordBytes));
+                writer->close();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        checkAllRanksSucceeded("Writing the header of " + fileName_);
+
+        // Only remove the files once the output file is complete, so nothing is lost if writing fails
+        if (removeShards) {
+            for (size_t shard = 0; shard < rankWriter_.getNumberOfShards(); shard++) {
+                for (const std::string & shardFile : rankWriter_.getShard(shard).getOutputFileNames()) {
+                    std::filesystem::remove(shardFile);
+                }
+            }
+        }
+    }
+
+    inline void MPIPhaseSpaceWriter::writeRecordsAt(MPI_File file, MPI_Offset offset) {
+        std::vector<char> block(COPY_BLOCK_SIZE);
+        for (size_t shard = 0; shard < rankWriter_.getNumberOfShards(); shard++) {
+            const PhaseSpaceFileWriter & shardWriter = rankWriter_.getShard(shard);
+            std::ifstream input(shardWriter.getFileName(), std::ios::binary);
+            if (!input.is_open()) {
+                throw std::runtime_error("Failed to open file: " + shardWriter.getFileName());
+            }
+            input.seekg(static_cast<std::streamoff>(shardWriter.getParticleRecordStartOffset()));
+            while (input) {
+                input.read(block.data(), static_cast<std::streamsize>(block.size()));
+                const int bytesRead = static_cast<int>(input.gcount());
+                if (bytesRead == 0) break;
+                if (MPI_File_write_at(file, offset, block.data(), bytesRead, MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+                    throw std::runtime_error("Failed to write the records of " + shardWriter.getFileName() + " into " + fileName_ + " with MPI-IO.");
+                }
+                offset += bytesRead;
+            }
+        }
+    }
+
+}
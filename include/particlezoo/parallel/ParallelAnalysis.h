@@ -0,0 +1,210 @@
+#pragma once
+
+#include "particlezoo/parallel/HistoryBalancedParallelReader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Totals of a pass of ParallelForEach() or ParallelReduce() over a phase space.
+     */
+    struct ParallelAnalysisSummary {
+        std::uint64_t particlesRead{0};   ///< Particles read by all of the threads
+        std::uint64_t historiesRead{0};   ///< Original histories read by all of the threads, empty histories included, to normalize results by
+        std::vector<IOProfile> readProfiles; ///< I/O profile of the reader of each thread
+    };
+
+    /**
+     * @brief Result of ParallelReduce(), the merged state of the threads with the totals of the pass.
+     */
+    template <typename State>
+    struct ParallelReduction : ParallelAnalysisSummary {
+        State state{};  ///< The states of all of the threads merged in thread order
+    };
+
+    /**
+     * @brief Options of the passes of ParallelForEach() and ParallelReduce().
+     */
+    struct ParallelAnalysisOptions {
+        static constexpr std::size_t DEFAULT_BATCH_SIZE = 4096;
+
+        std::size_t batchSize{DEFAULT_BATCH_SIZE};  ///< Particles each thread reads at a time before visiting them
+        std::chrono::milliseconds progressPeriod{200}; ///< Time between calls of the progress callback
+
+        /// Called on the calling thread every progressPeriod while the threads read, with the particles and histories read so far
+        std::function<void(std::uint64_t particlesRead, std::uint64_t historiesRead)> progress;
+    };
+
+    /**
+     * @brief Visits every particle of a phase space on the threads of a parallel reader.
+     *
+     * Each thread reads its share of the histories from its own reader, in batches of
+     * options.batchSize particles, and calls visit(threadIndex, particle) for each particle of the
+     * batch in file order. The particle is that of the batch of the thread, so visit may change it.
+     * Histories are never split between threads, so anything accumulated per history is complete
+     * within a thread. The calling thread only reports progress until every thread has stopped.
+     * An exception thrown on a thread stops that thread, and the first one in thread order is
+     * rethrown once all of the threads have stopped.
+     *
+     * The histories read returned in the summary account for every original history of the phase
+     * space, empty histories included, as the reader shares them out between the threads, so
+     * results normalized by it are exactly normalized per history.
+     *
+     * @param reader The parallel reader of the phase space, which must not have been read from yet
+     * @param visit Called as visit(std::size_t threadIndex, Particle & particle), concurrently from every thread
+     * @param options The batch size and progress reporting
+     * @return ParallelAnalysisSummary The particles and histories read and the I/O profile of each thread
+     */
+    template <typename Visitor>
+    ParallelAnalysisSummary ParallelForEach(HistoryBalancedParallelReader & reader, Visitor && visit, const ParallelAnalysisOptions & options = {}) {
+        const std::size_t numberOfThreads = reader.getNumberOfThreads();
+        const std::size_t batchSize = options.batchSize > 0 ? options.batchSize : ParallelAnalysisOptions::DEFAULT_BATCH_SIZE;
+        std::vector<std::exception_ptr> errors(numberOfThreads);
+        std::atomic<std::size_t> threadsFinished = 0;
+
+        auto visitShare = [&](std::size_t threadIndex) {
+            try {
+                std::vector<Particle> batch(batchSize);
+                for (std::size_t particlesInBatch = reader.readParticles(threadIndex, batch); particlesInBatch > 0; particlesInBatch = reader.readParticles(threadIndex, batch)) {
+                    for (Particle & particle : std::span<Particle>(batch.data(), particlesInBatch)) {
+                        visit(threadIndex, particle);
+                    }
+                }
+            } catch (...) {
+                errors[threadIndex] = std::current_exception();
+            }
+            threadsFinished.fetch_add(1, std::memory_order_release);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numberOfThreads);
+        for (std::size_t i = 0; i < numberOfThreads; i++) {
+            threads.emplace_back(visitShare, i);
+        }
+        while (threadsFinished.load(std::memory_order_acquire) < numberOfThreads) {
+            std::this_thread::sleep_for(options.progressPeriod);
+            if (options.progress) options.progress(reader.getTotalParticlesRead(), reader.getTotalHistoriesRead());
+        }
+        for (std::thread & thread : threads) {
+            thread.join();
+        }
+
+        ParallelAnalysisSummary summary;
+        for (std::size_t i = 0; i < numberOfThreads; i++) {
+            summary.readProfiles.push_back(reader.getIOProfile(i));
+        }
+        for (std::size_t i = 0; i < numberOfThreads; i++) {
+            if (errors[i]) std::rethrow_exception(errors[i]);
+        }
+        summary.particlesRead = reader.getTotalParticlesRead();
+        summary.historiesRead = reader.getTotalHistoriesRead();
+        return summary;
+    }
+
+    /**
+     * @brief Visits every particle of a phase space file on several threads.
+     *
+     * Same as ParallelForEach(HistoryBalancedParallelReader &, ...), with a reader opened on the
+     * file for the given number of threads. The file can be a set of files such as the shards of
+     * a ShardedParallelWriter listed in a PhaseSpaceSet file (.pzset).
+     *
+     * @param fileName The path to the phase space file
+     * @param userOptions The options of the readers
+     * @param numberOfThreads The number of threads to read on
+     * @param visit Called as visit(std::size_t threadIndex, Particle & particle), concurrently from every thread
+     * @param options The batch size and progress reporting
+     * @return ParallelAnalysisSummary The particles and histories read and the I/O profile of each thread
+     * @throws std::runtime_error if the file cannot be read or holds no histories
+     */
+    template <typename Visitor>
+    ParallelAnalysisSummary ParallelForEach(const std::string & fileName, const UserOptions & userOptions, std::size_t numberOfThreads, Visitor && visit, const ParallelAnalysisOptions & options = {}) {
+        HistoryBalancedParallelReader reader(fileName, userOptions, numberOfThreads);
+        ParallelAnalysisSummary summary = ParallelForEach(reader, std::forward<Visitor>(visit), options);
+        reader.close();
+        return summary;
+    }
+
+    /**
+     * @brief Accumulates a state over every particle of a phase space on the threads of a parallel reader.
+     *
+     * Every thread has a state of its own, made with makeState(threadIndex) before any particle
+     * is read, which it updates with accumulate(state, particle) for each particle of its share of
+     * the histories as ParallelForEach() visits them. No two threads ever touch the same state.
+     * Once every thread has stopped, the states are merged into that of the first thread with
+     * merge(state, std::move(otherState)) in thread order, so the result does not depend on the
+     * timing of the threads, only on their number.
+     *
+     * @param reader The parallel reader of the phase space, which must not have been read from yet
+     * @param makeState Called as makeState(std::size_t threadIndex), returning the initial state of a thread
+     * @param accumulate Called as accumulate(State & state, Particle & particle), which may change the particle
+     * @param merge Called as merge(State & state, State && otherState), adding otherState into state
+     * @param options The batch size and progress reporting
+     * @return ParallelReduction<State> The merged state and the particles and histories read
+     */
+    template <typename MakeState, typename Accumulate, typename Merge>
+    auto ParallelReduce(HistoryBalancedParallelReader & reader, MakeState && makeState, Accumulate && accumulate, Merge && merge, const ParallelAnalysisOptions & options = {})
+        -> ParallelReduction<std::decay_t<std::invoke_result_t<MakeState &, std::size_t>>>
+    {
+        using State = std::decay_t<std::invoke_result_t<MakeState &, std::size_t>>;
+
+        // The states are kept apart in memory so that the threads never write to the same cache line
+        struct alignas(CACHE_LINE_SIZE) ThreadState {
+            State state;
+        };
+        std::vector<ThreadState> states;
+        states.reserve(reader.getNumberOfThreads());
+        for (std::size_t i = 0; i < reader.getNumberOfThreads(); i++) {
+            states.push_back(ThreadState{ makeState(i) });
+        }
+
+        ParallelAnalysisSummary summary = ParallelForEach(reader, [&states, &accumulate](std::size_t threadIndex, Particle & particle) {
+            accumulate(states[threadIndex].state, particle);
+        }, options);
+
+        ParallelReduction<State> reduction;
+        static_cast<ParallelAnalysisSummary &>(reduction) = std::move(summary);
+        reduction.state = std::move(states.front().state);
+        for (std::size_t i = 1; i < states.size(); i++) {
+            merge(reduction.state, std::move(states[i].state));
+        }
+        return reduction;
+    }
+
+    /**
+     * @brief Accumulates a state over every particle of a phase space file on several threads.
+     *
+     * Same as ParallelReduce(HistoryBalancedParallelReader &, ...), with a reader opened on the
+     * file for the given number of threads.
+     *
+     * @param fileName The path to the phase space file, or to a set of files (.pzset)
+     * @param userOptions The options of the readers
+     * @param numberOfThreads The number of threads to read on
+     * @param makeState Called as makeState(std::size_t threadIndex), returning the initial state of a thread
+     * @param accumulate Called as accumulate(State & state, Particle & particle), which may change the particle
+     * @param merge Called as merge(State & state, State && otherState), adding otherState into state
+     * @param options The batch size and progress reporting
+     * @return ParallelReduction<State> The merged state and the particles and histories read
+     * @throws std::runtime_error if the file cannot be read or holds no histories
+     */
+    template <typename MakeState, typename Accumulate, typename Merge>
+    auto ParallelReduce(const std::string & fileName, const UserOptions & userOptions, std::size_t numberOfThreads, MakeState && makeState, Accumulate && accumulate, Merge && merge, const ParallelAnalysisOptions & options = {})
+        -> ParallelReduction<std::decay_t<std::invoke_result_t<MakeState &, std::size_t>>>
+    {
+        HistoryBalancedParallelReader reader(fileName, userOptions, numberOfThreads);
+        auto reduction = ParallelReduce(reader, std::forward<MakeState>(makeState), std::forward<Accumulate>(accumulate), std::forward<Merge>(merge), options);
+        reader.close();
+        return reduction;
+    }
+
+}
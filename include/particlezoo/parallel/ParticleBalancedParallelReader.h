@@ -1,14 +1,17 @@
 #pragma once
 
 #include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/parallel/ThreadCounter.h"
+#include "particlezoo/parallel/ThreadPlacement.h"
 
 #include <vector>
+#include <span>
 #include <memory>
 #include <string>
 #include <cstdint>
 #include <limits>
-#include <mutex>
 #include <atomic>
+#include <utility>
 
 namespace ParticleZoo {
 
@@ -32,6 +35,8 @@ namespace ParticleZoo {
      * - Particle partitioning across threads with proper history boundary alignment
      * - Thread-safe particle retrieval without locking (each thread has its own reader)
      * - Incremental history number tracking across partition boundaries
+     * - Opening the reader of each thread on that thread, on the NUMA node it runs on or is placed
+     *   on, when given ThreadPlacementCommand or setThreadPlacement() (see ThreadReaderPlacement)
      * 
      * @note Each thread must use its assigned thread index when calling methods.
      */
@@ -46,12 +51,18 @@ namespace ParticleZoo {
              * particles evenly across threads, with remainder particles distributed
              * to the first N threads.
              * 
+             * With ThreadPlacementCommand in the options, the readers positioned by the constructor are
+             * closed again and each thread opens a reader of its own at its starting record the first
+             * time it reads, pinned to a NUMA node or CPU as the policy asks, so that its buffers are
+             * allocated on its own node.
+             * 
              * @param filename Path to the phase space file to read
              * @param options User options for configuring the reader (format-specific settings)
              * @param numThreads Number of parallel threads that will read from this file
              * 
              * @throws std::runtime_error If the file cannot be opened or contains zero particles
              * @throws std::runtime_error If a PhaseSpaceFileReader cannot be created
+             * @throws std::invalid_argument If the thread placement policy is unknown
              */
             ParticleBalancedParallelReader(const std::string& filename, const UserOptions& options = {}, size_t numThreads = 1);
             
@@ -107,6 +118,21 @@ namespace ParticleZoo {
              * @note Always call this before getNextParticle() to avoid exceptions
              */
             bool     hasMoreParticles(size_t threadIndex);
+
+            /**
+             * @brief Reads the next particles of a specific thread into a contiguous array.
+             * 
+             * Reads up to particles.size() particles through the batch reading of the thread's
+             * PhaseSpaceFileReader, stopping at the end of the thread's partition. Counts them
+             * the same way as getNextParticle().
+             * 
+             * @param threadIndex The index of the calling thread (0 to numThreads-1)
+             * @param particles The particles to fill from the front
+             * @return The number of particles read, 0 once the thread has no more particles
+             * 
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            std::size_t readParticles(size_t threadIndex, std::span<Particle> particles);
             
             /**
              * @brief Gets the total number of particles processed by a specific thread.
@@ -157,6 +183,58 @@ namespace ParticleZoo {
              */
             std::uint64_t getTotalHistoriesRead() const;
 
+            /**
+             * @brief Gets the I/O profile of the reader of a specific thread.
+             * 
+             * The ioSeconds of the profile is the time the thread was blocked waiting for its
+             * reader to read the file, see PhaseSpaceFileReader::getIOProfile(). Only call this
+             * from the thread itself or once it has stopped reading.
+             * 
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return The profile of the thread's reader
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            IOProfile getIOProfile(size_t threadIndex) const;
+
+            /**
+             * @brief Gets the sum of the I/O profiles of the readers of all threads.
+             * 
+             * Only call this once the threads have stopped reading.
+             * 
+             * @return The summed profile, with the times added up over the threads
+             */
+            IOProfile getTotalIOProfile() const;
+
+            /**
+             * @brief Sets where a specific thread opens its reader, overriding ThreadPlacementCommand.
+             * 
+             * The thread opens a reader of its own the first time it reads, held to the NUMA node or
+             * CPU of the placement so that the buffers of the reader are allocated there, and stays
+             * pinned to it if the placement says so. Must be called before any thread starts reading.
+             * 
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @param placement The node or CPU to open the reader of the thread on
+             * 
+             * @throws std::out_of_range If threadIndex is invalid or the node or CPU does not exist
+             * @throws std::runtime_error If a thread has already read particles
+             */
+            void setThreadPlacement(size_t threadIndex, const ThreadPlacement & placement);
+
+            /**
+             * @brief Gets the bytes of the file holding the share of the particles of a specific thread.
+             * 
+             * Threads read their shares from contiguous, consecutive parts of the file, so the range
+             * can be used to read ahead or advise the operating system about the part of the file a
+             * thread is about to read from the thread itself, on its own NUMA node.
+             * 
+             * @param threadIndex The index of the thread (0 to numThreads-1)
+             * @return The offsets of the first byte of the share and of the byte after its last
+             * 
+             * @throws std::out_of_range If threadIndex is invalid
+             * @throws std::runtime_error If the file is not a binary file, whose records are at fixed offsets
+             */
+            std::pair<std::uint64_t, std::uint64_t> getByteRange(size_t threadIndex) const;
+
             /**
              * @brief Gets the total number of particles in the phase space file.
              * 
@@ -224,15 +302,21 @@ namespace ParticleZoo {
             UserOptions options_;
             std::size_t numThreads_;
 
-            struct ThreadStatistics {
-                mutable std::mutex mutex; // For thread-safe updates
-                std::atomic<std::uint64_t> particlesRead = 0;
-                std::atomic<std::uint64_t> representedHistoriesRead = 0;
-                std::atomic<std::uint64_t> incrementalHistorySum = 0;
+            // Written only by the owning thread, aligned so that threads do not share cache lines
+            struct alignas(CACHE_LINE_SIZE) ThreadStatistics {
+                ThreadCounter particlesRead;
+                ThreadCounter representedHistoriesRead;  // only tracked in RATIO mode
+                ThreadCounter incrementalHistorySum;     // only tracked in INCREMENTAL mode
             };
 
-            std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers_;
+            PhaseSpaceFileReader & getReader(size_t threadIndex);
+            void releaseReader(size_t threadIndex);
+
+            std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers_;  // null for a thread that has not opened its reader yet
+            std::shared_ptr<PhaseSpaceFileReader> prototype_;             // read by no thread, cloned to open the readers of the threads
+            ThreadReaderPlacement placement_;
             std::vector<std::uint64_t> startingParticleIndex_;
+            std::vector<std::uint64_t> startingRecords_;
             std::vector<std::unique_ptr<ThreadStatistics>> threadStats_;
 
             bool hasNativeRepresentedHistoryCount_;
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileWriter.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Multi-threaded phase space file writer producing one output file per thread.
+     *
+     * ShardedParallelWriter is the writing counterpart of the parallel readers. It creates one
+     * PhaseSpaceFileWriter for each thread, each writing its own shard file, so that threads can
+     * write particles without any locking or ordering between them. A thread fed by
+     * HistoryBalancedParallelReader writes whole histories to its shard, and the histories of
+     * all the shards add up to those of the input file.
+     *
+     * Shards are named after the output file with the shard index added to the stem, so the
+     * shards of beam.IAEAphsp are beam_shard0.IAEAphsp, beam_shard1.IAEAphsp and so on. The
+     * shards can be used as they are, for example listed in a PhaseSpaceSet, or concatenated
+     * into the output file once all threads are done. Concatenation copies the particle records
+     * of each shard in shard order and merges the statistics kept in their headers (particle
+     * counts by type, energy and position ranges, history counts), so no particle has to be
+     * decoded again.
+     *
+     * @note Each thread must use its assigned thread index when calling methods.
+     * @note Concatenation is only available for formats that support
+     *       PhaseSpaceFileWriter::appendRecordsFrom().
+     */
+    class ShardedParallelWriter {
+
+        public:
+            /**
+             * @brief Constructs a writer with one shard per thread.
+             *
+             * @param fileName Path of the output file, the shards are written next to it
+             * @param numberOfShards Number of shards, one for each thread that will write
+             * @param options User options for configuring the writers (format-specific settings)
+             * @param fixedValues Constant values shared by all of the shards
+             * @param formatName Name of the format to write, or empty to choose it from the file extension
+             *
+             * @throws std::invalid_argument If numberOfShards is zero
+             * @throws std::runtime_error If a PhaseSpaceFileWriter cannot be created
+             */
+            ShardedParallelWriter(const std::string& fileName, size_t numberOfShards, const UserOptions& options = {}, const FixedValues& fixedValues = {}, const std::string& formatName = "");
+
+            /**
+             * @brief Destructor that closes all of the shards.
+             */
+            ~ShardedParallelWriter();
+
+            /**
+             * @brief Gets the name of a shard of an output file.
+             *
+             * @param fileName Path of the output file
+             * @param shardIndex Index of the shard
+             * @return The path of the shard, the shard index is added to the stem of the file name
+             */
+            static std::string ShardFileName(const std::string& fileName, size_t shardIndex);
+
+            /**
+             * @brief Writes a particle to the shard of a specific thread.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfShards-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     writeParticle(size_t threadIndex, const Particle& particle);
+
+            /**
+             * @brief Writes a particle to the shard of a specific thread, moving from it.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfShards-1)
+             * @param particle The particle to write
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     writeParticle(size_t threadIndex, Particle&& particle);
+
+            /**
+             * @brief Adds empty histories to the shard of a specific thread.
+             *
+             * @param threadIndex The index of the calling thread (0 to numberOfShards-1)
+             * @param additionalHistories The number of additional (empty) histories to account for
+             *
+             * @throws std::out_of_range If threadIndex is invalid
+             */
+            void     addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories);
+
+            /**
+             * @brief Gets the writer of a shard.
+             *
+             * @param shardIndex The index of the shard (0 to numberOfShards-1)
+             * @return The writer of the shard
+             *
+             * @throws std::out_of_range If shardIndex is invalid
+             */
+            PhaseSpaceFileWriter & getShard(size_t shardIndex);
+
+            /**
+             * @brief Gets the path of the file written by a shard.
+             *
+             * @param shardIndex The index of the shard (0 to numberOfShards-1)
+             * @return The path of the shard file
+             *
+             * @throws std::out_of_range If shardIndex is invalid
+             */
+            std::string getShardFileName(size_t shardIndex) const;
+
+            /**
+             * @brief Gets the path of the output file that the shards are concatenated into.
+             *
+             * @return The output file path
+             */
+            const std::string & getFileName() const { return fileName_; }
+
+            /**
+             * @brief Gets the number of shards.
+             *
+             * @return Number of shards, equal to the number of threads writing
+             */
+            std::size_t getNumberOfShards() const { return shards_.size(); }
+
+            /**
+             * @brief Gets the total number of histories written across all shards.
+             *
+             * @return Total number of histories written
+             */
+            std::uint64_t getHistoriesWritten() const;
+
+            /**
+             * @brief Gets the total number of particles written across all shards.
+             *
+             * @return Total number of particles written
+             */
+            std::uint64_t getParticlesWritten() const;
+
+            /**
+             * @brief Gets the sum of the I/O profiles of the writers of all shards.
+             *
+             * The profile of the shard of a single thread is available from getShard(). Only call
+             * this once every thread has finished writing.
+             *
+             * @return The summed profile, with the times added up over the shards
+             */
+            IOProfile getIOProfile() const;
+
+            /**
+             * @brief Closes all of the shards, leaving them as separate files.
+             *
+             * Must only be called once every thread has finished writing. Automatically called
+             * by the destructor.
+             */
+            void     close();
+
+            /**
+             * @brief Closes all of the shards and concatenates them into the output file.
+             *
+             * The particle records of the shards are appended to the output file in shard order
+             * and the statistics in their headers are merged. Must only be called once every
+             * thread has finished writing.
+             *
+             * @param removeShards Whether to delete the shard files once they have been appended
+             *
+             * @throws std::runtime_error If the format does not support appending records, or the shards have already been concatenated
+             */
+            void     concatenate(bool removeShards = true);
+
+        private:
+            std::string fileName_;
+            UserOptions options_;
+            FixedValues fixedValues_;
+            std::string formatName_;
+            std::vector<std::unique_ptr<PhaseSpaceFileWriter>> shards_;
+            bool concatenated_;
+    };
+
+}
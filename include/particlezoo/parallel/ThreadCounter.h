@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ParticleZoo {
+
+    /**
+     * @brief Size to align per-thread state to so that no two threads write to the same cache line.
+     *
+     * 64 bytes covers current x86-64 and most ARM cores. std::hardware_destructive_interference_size
+     * is not used since its value can differ between compilers and compiler flags, which would make
+     * it unsafe to use in the layout of a class in a public header.
+     */
+    inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * @brief A counter that is only ever written by one thread but may be read by any thread.
+     *
+     * Updates are a relaxed load and store rather than an atomic read-modify-write, so they cost
+     * the same as incrementing a plain integer, while reads from other threads are still free of
+     * data races. Readers see a recent value, which is all that progress reporting needs.
+     */
+    class ThreadCounter {
+        public:
+            /**
+             * @brief Add to the counter. Must only be called from the thread that owns the counter.
+             *
+             * @param amount The amount to add
+             */
+            void add(std::uint64_t amount = 1) { value_.store(value_.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+
+            /**
+             * @brief Get the current value of the counter. Safe to call from any thread.
+             *
+             * @return std::uint64_t The value of the counter
+             */
+            std::uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<std::uint64_t> value_ = 0;
+    };
+
+}
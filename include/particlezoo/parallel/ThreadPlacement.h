@@ -0,0 +1,116 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ParticleZoo {
+
+    inline CLICommand ThreadPlacementCommand { READER, "", "threadPlacement", "Open the reader of each thread of a parallel reader on that thread, so that its buffers are on the thread's NUMA node: 'local' leaves the threads where they run, 'spread' pins consecutive threads to different NUMA nodes, 'compact' pins consecutive threads to the same node, 'cpu' pins each thread to a CPU of its own", { CLI_STRING } };
+
+    /**
+     * @brief Where a thread of a parallel reader runs while its reader is opened, and afterwards.
+     *
+     * The reader of a thread allocates its read buffer when it is opened, and the memory is placed
+     * on the NUMA node of the thread that first writes to it. A thread given a node or a CPU is held
+     * to it while its reader is opened, so that the buffers are on that node, and is left pinned to
+     * it afterwards if pinThread is set.
+     */
+    struct ThreadPlacement {
+        static constexpr int ANY = -1;
+
+        int numaNode{ANY};      ///< NUMA node to open the reader on (see GetNUMANodes()), ANY for the node the thread runs on
+        int cpu{ANY};           ///< CPU to open the reader on, ANY for any CPU of the node; takes precedence over the node
+        bool pinThread{false};  ///< Keep the thread on the node or CPU once its reader is open
+    };
+
+    /**
+     * @brief How the readers of the threads of a parallel reader are placed, from ThreadPlacementCommand.
+     */
+    enum class ThreadPlacementPolicy {
+        NONE,     ///< Every reader is opened by the constructor, on the constructing thread
+        LOCAL,    ///< Each reader is opened on its thread the first time it reads, wherever the thread runs
+        SPREAD,   ///< As LOCAL, with thread i pinned to NUMA node i modulo the number of nodes
+        COMPACT,  ///< As LOCAL, with the threads pinned to the nodes in equal groups of consecutive threads
+        CPU       ///< As LOCAL, with thread i pinned to CPU i modulo the number of CPUs the process may use
+    };
+
+    /**
+     * @brief Opens the reader of each thread of a parallel reader where its placement asks for.
+     *
+     * Used by HistoryBalancedParallelReader and ParticleBalancedParallelReader. Without a placement
+     * policy or any placement set, the readers of all threads are opened by their constructors.
+     * Otherwise the constructor still positions a reader for every thread, then closes them and
+     * keeps only where each thread starts, and each thread opens a reader of its own, cloned from
+     * the first one, when it first reads. Its buffers are then allocated and first written on that
+     * thread, on the NUMA node it runs on or was placed on, instead of all being on the node of the
+     * constructing thread.
+     */
+    class ThreadReaderPlacement {
+        public:
+            /**
+             * @brief Construct the placement of the threads of a parallel reader.
+             *
+             * @param options The options of the parallel reader, with the policy in ThreadPlacementCommand if any
+             * @param numberOfThreads The number of threads of the parallel reader
+             * @throws std::invalid_argument if the policy is not one of local, spread, compact or cpu
+             */
+            ThreadReaderPlacement(const UserOptions & options, std::size_t numberOfThreads);
+
+            /**
+             * @brief Check if the readers are opened by their threads rather than by the constructor.
+             *
+             * @return true if there is a placement policy or a thread was given a placement
+             */
+            bool defersReaders() const;
+
+            /**
+             * @brief Get the placement of a thread.
+             *
+             * @param threadIndex The index of the thread
+             * @return ThreadPlacement The placement set for the thread, or the one the policy gives it
+             */
+            ThreadPlacement getPlacement(std::size_t threadIndex) const;
+
+            /**
+             * @brief Set the placement of a thread, overriding the policy.
+             *
+             * @param threadIndex The index of the thread
+             * @param placement The node or CPU to open the reader of the thread on
+             * @throws std::out_of_range if the thread index, node or CPU does not exist
+             */
+            void setPlacement(std::size_t threadIndex, const ThreadPlacement & placement);
+
+            /**
+             * @brief Open the reader of a thread on the calling thread, as placed.
+             *
+             * Clones the prototype reader and moves it to its first record while the calling thread is
+             * held to the node or CPU of the placement. Readers are cloned one at a time, so the threads
+             * may call this concurrently as long as nothing else uses the prototype meanwhile.
+             *
+             * @param threadIndex The index of the calling thread
+             * @param prototype The reader to clone, which must not be read from while threads open their readers
+             * @param firstRecord The record the thread starts reading at
+             * @return std::shared_ptr<PhaseSpaceFileReader> The reader of the thread, positioned at firstRecord
+             */
+            std::shared_ptr<PhaseSpaceFileReader> openReader(std::size_t threadIndex, const PhaseSpaceFileReader & prototype, std::uint64_t firstRecord) const;
+
+        private:
+            ThreadPlacementPolicy policy_;
+            std::vector<ThreadPlacement> placements_;  // set by setPlacement(), ANY everywhere otherwise
+            std::vector<bool> hasPlacement_;
+            mutable std::mutex cloneMutex_;
+    };
+
+    // Inline implementations for the ThreadReaderPlacement class
+
+    inline bool ThreadReaderPlacement::defersReaders() const {
+        return policy_ != ThreadPlacementPolicy::NONE || std::find(hasPlacement_.begin(), hasPlacement_.end(), true) != hasPlacement_.end();
+    }
+
+}
@@ -82,11 +82,11 @@ namespace ParticleZoo
                  * Formats a particle according to the penEasy specification:
                  * KPAR E X Y Z U V W WGHT DeltaN ILB(1..5)
                  * 
+                 * @param line Writer of the line the particle is written to
                  * @param particle Particle object to convert to ASCII
-                 * @return ASCII string representation of the particle
                  * @throws std::runtime_error if particle type is unsupported or data is too long
                  */
-                const std::string writeASCIIParticle(Particle & particle) override;
+                void writeASCIIParticle(ASCIILineWriter & line, Particle & particle) override;
 
                 /**
                  * @brief Get the maximum length of ASCII particle lines, required for buffer sizing
@@ -157,7 +157,7 @@ namespace ParticleZoo
                  * @return Parsed Particle object with all properties set
                  * @throws std::runtime_error if line cannot be parsed or contains invalid data
                  */
-                Particle readASCIIParticle(const std::string & line) override;
+                Particle readASCIIParticle(std::string_view line) override;
 
                 /**
                  * @brief Get the maximum length of ASCII particle lines, required for buffer sizing
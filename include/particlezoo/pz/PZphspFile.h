@@ -0,0 +1,299 @@
+#pragma once
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/PhaseSpaceFileWriter.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
+#include "particlezoo/utilities/compression.h"
+
+namespace ParticleZoo
+{
+    /**
+     * @brief The ParticleZoo native phase space file format.
+     *
+     * A seekable, compressed, columnar container for phase space data. The particles are
+     * written in blocks of a fixed number of particles (the last block may be shorter), each
+     * block holding one section per column: particle types as a bit-packed dictionary, the
+     * new history flags as bits, the incremental history numbers of the particles starting a
+     * history, and the kinetic energies, positions, directional cosines and weights as 32-bit
+     * floats with their bytes shuffled into planes. Columns holding the same value for every
+     * particle in the block are stored as that value. Every property of the particles,
+     * custom ones included, is stored in a column of its own along with which particles have
+     * it, so converting a file to this format and back loses nothing.
+     *
+     * Each section is then compressed with the codec chosen when writing (see
+     * CompressionCodec), unless that would not make it smaller. All values are lossless,
+     * nothing is quantized.
+     *
+     * The file starts with a short header identifying the format and ends with a footer
+     * holding the number of particles and histories, the statistics usually found in IAEA
+     * and TOPAS headers (particle counts, weights and energy ranges by type, position and
+     * weight ranges) and an index of the blocks giving their positions in the file and the
+     * number of particles and histories in each. Seeking to any particle only decodes the
+     * block it is in.
+     *
+     * All values are stored little-endian:
+     *
+     *     header   : magic "PZPHSP\r\n", u32 version, u32 particles per block
+     *     block    : u32 particles, u32 sections, then each section
+     *     section  : u8 column, u8 encoding, u8 codec, u8 reserved, i32 property type,
+     *                u32 encoded size, u32 stored size, stored bytes
+     *     footer   : statistics and block index, see Writer::writeFooter()
+     *     trailer  : u64 footer offset, u64 footer size, magic "PZPHSP\r\n"
+     */
+    namespace PZphspFile {
+
+        extern CLICommand PZCompressionCommand;         ///< Command to choose the compression codec of a written file
+        extern CLICommand PZCompressionLevelCommand;    ///< Command to set the compression level of a written file
+        extern CLICommand PZBlockSizeCommand;           ///< Command to set the number of particles in each block of a written file
+
+        constexpr std::uint32_t FORMAT_VERSION = 1;                      ///< Version of the format written by this library
+        constexpr std::uint32_t DEFAULT_PARTICLES_PER_BLOCK = 65536;     ///< Number of particles in each block unless set with PZBlockSizeCommand
+        constexpr std::array<char, 8> MAGIC = { 'P', 'Z', 'P', 'H', 'S', 'P', '\r', '\n' }; ///< Marks the start and end of every file
+        constexpr std::size_t FILE_HEADER_SIZE = 16;                     ///< Size of the header at the start of the file
+        constexpr std::size_t FILE_TRAILER_SIZE = 24;                    ///< Size of the trailer at the end of the file
+
+        /**
+         * @brief Statistics of the particles of one type in a file.
+         */
+        struct ParticleStatistics {
+            std::uint64_t count{0};                                                ///< Number of particles
+            double        weightSum{0};                                            ///< Sum of the statistical weights
+            double        weightedEnergySum{0};                                    ///< Sum of the kinetic energies multiplied by the weights
+            float         minKineticEnergy{std::numeric_limits<float>::max()};     ///< Smallest kinetic energy
+            float         maxKineticEnergy{std::numeric_limits<float>::lowest()};  ///< Largest kinetic energy
+        };
+
+        /**
+         * @brief Statistics of all of the particles in a file, kept in its footer.
+         */
+        struct FileStatistics {
+            float minX{std::numeric_limits<float>::max()};           ///< Smallest X position
+            float maxX{std::numeric_limits<float>::lowest()};        ///< Largest X position
+            float minY{std::numeric_limits<float>::max()};           ///< Smallest Y position
+            float maxY{std::numeric_limits<float>::lowest()};        ///< Largest Y position
+            float minZ{std::numeric_limits<float>::max()};           ///< Smallest Z position
+            float maxZ{std::numeric_limits<float>::lowest()};        ///< Largest Z position
+            float minWeight{std::numeric_limits<float>::max()};      ///< Smallest statistical weight
+            float maxWeight{std::numeric_limits<float>::lowest()};   ///< Largest statistical weight
+            std::map<ParticleType, ParticleStatistics> byType;       ///< Statistics of each particle type present
+
+            /**
+             * @brief Count a particle in the statistics.
+             *
+             * @param particle The particle to count
+             */
+            void addParticle(const Particle & particle);
+        };
+
+        /**
+         * @brief Entry of the block index kept in the footer of a file.
+         */
+        struct BlockIndexEntry {
+            std::uint64_t offset{0};                ///< Byte offset of the block in the file
+            std::uint32_t size{0};                  ///< Size of the block in bytes
+            std::uint32_t numberOfParticles{0};     ///< Number of particles in the block
+            std::uint64_t representedHistories{0};  ///< Number of particles in the block starting a new history
+            std::uint64_t originalHistories{0};     ///< Sum of the incremental history numbers of the particles in the block
+        };
+
+        /**
+         * @brief Reader class for ParticleZoo native phase space files.
+         *
+         * Reads the footer when opening the file, then decodes one block at a time as the
+         * particles are read. Seeking goes straight to the block holding the particle.
+         */
+        class Reader : public PhaseSpaceFileReader
+        {
+            public:
+                /**
+                 * @brief Construct a new reader of a ParticleZoo native phase space file.
+                 *
+                 * @param fileName Path to the file to read
+                 * @param options User options for configuring the reader
+                 * @throws std::runtime_error if the file cannot be opened or is not a valid file of this format
+                 */
+                Reader(const std::string & fileName, const UserOptions & options = UserOptions{});
+
+                /**
+                 * @brief Get the total number of particles in the file.
+                 *
+                 * @return std::uint64_t Number of particles
+                 */
+                std::uint64_t getNumberOfParticles() const override { return numberOfParticles_; }
+
+                /**
+                 * @brief Get the number of original Monte Carlo histories.
+                 *
+                 * @return std::uint64_t Number of original histories, including those that produced no particles
+                 */
+                std::uint64_t getNumberOfOriginalHistories() const override { return numberOfOriginalHistories_; }
+
+                /**
+                 * @brief Get the number of histories with at least one particle in the file.
+                 *
+                 * @return std::uint64_t Number of represented histories, stored in the footer
+                 */
+                std::uint64_t getNumberOfRepresentedHistories() const override { return numberOfRepresentedHistories_; }
+
+                bool hasNativeRepresentedHistoryCount() const override { return true; }
+                bool hasNativeIncrementalHistoryCounters() const override { return true; }
+                bool supportsRandomAccess() const override { return true; }
+
+                /**
+                 * @brief Get the version of the format the file was written with.
+                 *
+                 * @return std::uint32_t The format version
+                 */
+                std::uint32_t getFormatVersion() const { return formatVersion_; }
+
+                /**
+                 * @brief Get the number of particles in each block, except possibly the last.
+                 *
+                 * @return std::uint32_t Particles per block
+                 */
+                std::uint32_t getParticlesPerBlock() const { return particlesPerBlock_; }
+
+                /**
+                 * @brief Get the codec the file was compressed with.
+                 *
+                 * @return CompressionCodec The codec, sections that would not compress are stored as they are
+                 */
+                CompressionCodec getCompressionCodec() const { return codec_; }
+
+                /**
+                 * @brief Get the statistics of the particles in the file.
+                 *
+                 * @return const FileStatistics& The statistics stored in the footer
+                 */
+                const FileStatistics & getStatistics() const { return statistics_; }
+
+                /**
+                 * @brief Get the block index of the file.
+                 *
+                 * @return const std::vector<BlockIndexEntry>& The blocks, in file order
+                 */
+                const std::vector<BlockIndexEntry> & getBlockIndex() const { return blocks_; }
+
+                /**
+                 * @brief Get the list of format-specific command line interface commands.
+                 *
+                 * @return std::vector<CLICommand> Vector of CLI commands (none for this reader)
+                 */
+                static std::vector<CLICommand> getFormatSpecificCLICommands();
+
+            protected:
+                Particle      readParticleManually() override;
+                Particle      peekParticleManually() override;
+                void          moveToParticleManually(std::uint64_t particleIndex) override;
+
+            private:
+                void          readFooter();
+                void          loadBlock(std::size_t blockNumber);
+                void          ensureParticleInBlock();
+
+                std::ifstream file_;
+                std::uint32_t formatVersion_;
+                std::uint32_t particlesPerBlock_;
+                CompressionCodec codec_;
+                std::uint64_t numberOfParticles_;
+                std::uint64_t numberOfOriginalHistories_;
+                std::uint64_t numberOfRepresentedHistories_;
+                FileStatistics statistics_;
+                std::vector<BlockIndexEntry> blocks_;
+                std::vector<std::uint64_t> blockFirstParticles_; /// index of the first particle of each block, with the total number of particles at the end
+
+                std::size_t currentBlock_;      /// number of the block held in block_, blocks_.size() if none
+                std::size_t positionInBlock_;   /// index in block_ of the next particle to read
+                ParticleBlock block_;
+                std::vector<byte> blockData_;
+                std::vector<byte> sectionData_;
+        };
+
+
+        /**
+         * @brief Writer class for ParticleZoo native phase space files.
+         *
+         * Collects the particles written into a block, encoding and compressing it once it is
+         * full. The footer is written when the writer is closed.
+         */
+        class Writer : public PhaseSpaceFileWriter
+        {
+            public:
+                /**
+                 * @brief Construct a new writer of a ParticleZoo native phase space file.
+                 *
+                 * @param fileName Path of the file to write
+                 * @param options User options, including the codec, compression level and block size
+                 * @throws std::runtime_error if the file cannot be opened or the chosen codec is not available
+                 */
+                Writer(const std::string & fileName, const UserOptions & options = UserOptions{});
+
+                /**
+                 * @brief Destructor, closes the file writing out its last block and footer.
+                 */
+                ~Writer() override;
+
+                /**
+                 * @brief Get the maximum number of particles that can be written.
+                 *
+                 * @return std::uint64_t The maximum number of particles
+                 */
+                std::uint64_t getMaximumSupportedParticles() const override { return std::numeric_limits<std::uint64_t>::max(); }
+
+                /**
+                 * @brief Get the codec the file is compressed with.
+                 *
+                 * @return CompressionCodec The codec
+                 */
+                CompressionCodec getCompressionCodec() const { return codec_; }
+
+                /**
+                 * @brief Get the number of particles in each block.
+                 *
+                 * @return std::uint32_t Particles per block
+                 */
+                std::uint32_t getParticlesPerBlock() const { return particlesPerBlock_; }
+
+                /**
+                 * @brief Get the list of format-specific command line interface commands.
+                 *
+                 * @return std::vector<CLICommand> Vector of CLI commands
+                 */
+                static std::vector<CLICommand> getFormatSpecificCLICommands();
+
+            protected:
+                void          writeHeaderData(ByteBuffer & buffer) override;
+                void          writeParticleManually(Particle & particle) override;
+                void          closeManually() override;
+
+            private:
+                void          writeBlock();
+                void          writeFooter();
+
+                std::ofstream file_;
+                CompressionCodec codec_;
+                int compressionLevel_;
+                std::uint32_t particlesPerBlock_;
+                std::uint64_t bytesWritten_;
+                std::uint64_t representedHistories_;
+                FileStatistics statistics_;
+                std::vector<BlockIndexEntry> blocks_;
+
+                ParticleBlock block_;
+                std::vector<byte> blockData_;
+                std::vector<byte> sectionData_;
+        };
+
+    } // namespace PZphspFile
+
+} // namespace ParticleZoo
@@ -432,6 +432,22 @@ namespace ParticleZoo {
              * @throws Calls PrintUsage() and exits on parsing errors
              */     
             static const UserOptions ParseArgs(int argc, char* argv[], const std::string & usageMessage, std::size_t minimumPositionalArgs = 0);
+
+            /**
+             * @brief Parses a list of arguments based on registered commands.
+             * 
+             * Works like ParseArgs() on arguments that do not come from the command line, such
+             * as options read from a file, so can be called any number of times. Problems are
+             * reported by throwing rather than by printing the usage message and exiting. The
+             * parsed options are added to a copy of the base options, replacing any given again,
+             * and the positional arguments replace those of the base options.
+             * 
+             * @param arguments The arguments to parse, without a program name
+             * @param baseOptions The options that the parsed options are added to (default: none)
+             * @return UserOptions A map of the base and parsed commands and their values
+             * @throws std::runtime_error If an option is unknown or has a missing or invalid value
+             */
+            static UserOptions ParseArgList(const std::vector<std::string>& arguments, const UserOptions& baseOptions = {});
     };
 
 } // namespace ParticleZoo
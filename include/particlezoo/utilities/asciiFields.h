@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Parser for the whitespace separated fields of a line of an ASCII phase space file.
+     *
+     * Fields are parsed with std::from_chars straight from a view of the line, so reading a
+     * particle record allocates nothing and does not depend on the locale of the program. Each
+     * field must be a complete number of the requested type, anything else is reported as an
+     * error naming the field rather than left for the next field to trip over.
+     */
+    class ASCIILineParser
+    {
+        public:
+            /**
+             * @brief Construct a parser for a line.
+             *
+             * @param line The line to parse, which must outlive the parser
+             */
+            explicit ASCIILineParser(std::string_view line);
+
+            /**
+             * @brief Parse the next field as a number.
+             *
+             * Integers and floating point numbers are accepted in the forms written by
+             * printf-style formatting, including an optional leading '+'. A bool is read as an
+             * integer, any non-zero value being true.
+             *
+             * @tparam T The arithmetic type to parse the field as
+             * @return T The value of the field
+             * @throws std::runtime_error if there are no more fields or the field is not a number of type T
+             */
+            template <typename T>
+            T next();
+
+            /**
+             * @brief Get the next field without parsing it.
+             *
+             * @return std::string_view The characters of the field, empty if there are no more fields
+             */
+            std::string_view nextField();
+
+            /**
+             * @brief Get a fixed number of characters following the next separator.
+             *
+             * For text columns of a fixed width which may themselves contain spaces. A single
+             * separating character is skipped before the characters are taken.
+             *
+             * @param count The number of characters to take, fewer are returned if the line ends first
+             * @return std::string_view The characters taken
+             */
+            std::string_view nextChars(std::size_t count);
+
+            /**
+             * @brief Get the line being parsed.
+             *
+             * @return std::string_view The whole line
+             */
+            std::string_view line() const { return line_; }
+
+        private:
+            std::string_view line_;
+            std::size_t      position_;
+    };
+
+
+    /**
+     * @brief Writer of the fields of a line of an ASCII phase space file straight into a buffer.
+     *
+     * Numbers are formatted with std::to_chars into the space given to the writer, so writing a
+     * particle record needs no intermediate string and does not depend on the locale of the
+     * program. Fields can be right-aligned to a minimum width in the same way as with
+     * std::setw() or a printf width.
+     */
+    class ASCIILineWriter
+    {
+        public:
+            /**
+             * @brief Construct a writer filling the given space from its start.
+             *
+             * @param space The space to write the line into
+             */
+            explicit ASCIILineWriter(std::span<char> space);
+
+            /**
+             * @brief Write an integer.
+             *
+             * @param value The value to write
+             * @param width The minimum width of the field, padded with leading spaces (default: none)
+             * @throws std::runtime_error if the line would no longer fit in the space
+             */
+            template <typename T>
+            void writeInteger(T value, std::size_t width = 0);
+
+            /**
+             * @brief Write a floating point number in scientific notation, as printf's %e.
+             *
+             * @param value The value to write
+             * @param precision The number of digits after the decimal point
+             * @param width The minimum width of the field, padded with leading spaces (default: none)
+             * @throws std::runtime_error if the line would no longer fit in the space
+             */
+            template <typename T>
+            void writeScientific(T value, int precision, std::size_t width = 0);
+
+            /**
+             * @brief Write a floating point number in general notation, as printf's %g.
+             *
+             * With the default precision of 6 this is the same as writing to a std::ostream
+             * with its default formatting.
+             *
+             * @param value The value to write
+             * @param precision The number of significant digits (default: 6)
+             * @param width The minimum width of the field, padded with leading spaces (default: none)
+             * @throws std::runtime_error if the line would no longer fit in the space
+             */
+            template <typename T>
+            void writeGeneral(T value, int precision = 6, std::size_t width = 0);
+
+            /**
+             * @brief Write text.
+             *
+             * @param text The text to write
+             * @param width The minimum width of the field, padded with leading spaces (default: none)
+             * @throws std::runtime_error if the line would no longer fit in the space
+             */
+            void write(std::string_view text, std::size_t width = 0);
+
+            /**
+             * @brief Write a single character.
+             *
+             * @param character The character to write
+             * @throws std::runtime_error if the line would no longer fit in the space
+             */
+            void write(char character);
+
+            /**
+             * @brief Get the number of characters written so far.
+             *
+             * @return std::size_t The length of the line
+             */
+            std::size_t length() const { return length_; }
+
+        private:
+            template <typename Format>
+            void writeNumber(std::size_t width, Format && format);
+
+            [[noreturn]] static void throwLineTooLong();
+
+            std::span<char> space_;
+            std::size_t     length_;
+    };
+
+
+    /* Implementation of ASCIILineParser - kept inline for performance */
+
+    inline ASCIILineParser::ASCIILineParser(std::string_view line) : line_(line), position_(0) {}
+
+    inline std::string_view ASCIILineParser::nextField() {
+        const std::size_t start = line_.find_first_not_of(" \t\r\n", position_);
+        if (start == std::string_view::npos) {
+            position_ = line_.size();
+            return {};
+        }
+        std::size_t end = line_.find_first_of(" \t\r\n", start);
+        if (end == std::string_view::npos) end = line_.size();
+        position_ = end;
+        return line_.substr(start, end - start);
+    }
+
+    inline std::string_view ASCIILineParser::nextChars(std::size_t count) {
+        if (position_ < line_.size()) position_++; // the separator before the characters
+        const std::size_t start = position_;
+        position_ = std::min(line_.size(), start + count);
+        return line_.substr(start, position_ - start);
+    }
+
+    template <typename T>
+    inline T ASCIILineParser::next() {
+        static_assert(std::is_arithmetic_v<T>, "ASCIILineParser::next<T>() requires an arithmetic type");
+
+        if constexpr (std::is_same_v<T, bool>) {
+            return next<int>() != 0;
+        } else {
+            std::string_view field = nextField();
+            if (field.empty()) {
+                throw std::runtime_error("Missing field in line: " + std::string(line_));
+            }
+            // std::from_chars does not accept a leading '+', which printf-style formatting may write
+            std::string_view digits = field;
+            if (digits.size() > 1 && digits.front() == '+') digits.remove_prefix(1);
+
+            T value{};
+            std::from_chars_result result;
+            if constexpr (std::is_floating_point_v<T>) {
+                result = std::from_chars(digits.data(), digits.data() + digits.size(), value, std::chars_format::general);
+            } else {
+                result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            }
+            if (result.ec != std::errc() || result.ptr != digits.data() + digits.size()) {
+                throw std::runtime_error("Invalid field '" + std::string(field) + "' in line: " + std::string(line_));
+            }
+            return value;
+        }
+    }
+
+
+    /* Implementation of ASCIILineWriter - kept inline for performance */
+
+    inline ASCIILineWriter::ASCIILineWriter(std::span<char> space) : space_(space), length_(0) {}
+
+    inline void ASCIILineWriter::throwLineTooLong() {
+        throw std::runtime_error("ASCII line length exceeds maximum allowed length.");
+    }
+
+    template <typename Format>
+    inline void ASCIILineWriter::writeNumber(std::size_t width, Format && format) {
+        char * const first = space_.data() + length_;
+        char * const last = space_.data() + space_.size();
+        const std::to_chars_result result = format(first, last);
+        if (result.ec != std::errc()) throwLineTooLong();
+
+        // Right-align the number in its field by moving it along and padding in front
+        const std::size_t written = static_cast<std::size_t>(result.ptr - first);
+        if (written < width) {
+            const std::size_t padding = width - written;
+            if (padding > static_cast<std::size_t>(last - result.ptr)) throwLineTooLong();
+            std::memmove(first + padding, first, written);
+            std::memset(first, ' ', padding);
+            length_ += width;
+        } else {
+            length_ += written;
+        }
+    }
+
+    template <typename T>
+    inline void ASCIILineWriter::writeInteger(T value, std::size_t width) {
+        static_assert(std::is_integral_v<T>, "ASCIILineWriter::writeInteger() requires an integral type");
+        writeNumber(width, [value](char * first, char * last) { return std::to_chars(first, last, value); });
+    }
+
+    template <typename T>
+    inline void ASCIILineWriter::writeScientific(T value, int precision, std::size_t width) {
+        static_assert(std::is_floating_point_v<T>, "ASCIILineWriter::writeScientific() requires a floating point type");
+        writeNumber(width, [value, precision](char * first, char * last) { return std::to_chars(first, last, value, std::chars_format::scientific, precision); });
+    }
+
+    template <typename T>
+    inline void ASCIILineWriter::writeGeneral(T value, int precision, std::size_t width) {
+        static_assert(std::is_floating_point_v<T>, "ASCIILineWriter::writeGeneral() requires a floating point type");
+        writeNumber(width, [value, precision](char * first, char * last) { return std::to_chars(first, last, value, std::chars_format::general, precision); });
+    }
+
+    inline void ASCIILineWriter::write(std::string_view text, std::size_t width) {
+        const std::size_t padding = text.size() < width ? width - text.size() : 0;
+        if (length_ + padding + text.size() > space_.size()) throwLineTooLong();
+        std::memset(space_.data() + length_, ' ', padding);
+        std::memcpy(space_.data() + length_ + padding, text.data(), text.size());
+        length_ += padding + text.size();
+    }
+
+    inline void ASCIILineWriter::write(char character) {
+        if (length_ >= space_.size()) throwLineTooLong();
+        space_[length_++] = character;
+    }
+
+} // namespace ParticleZoo
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "particlezoo/ByteBuffer.h"
+#include "particlezoo/utilities/outputFileStream.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Writes full buffers to a file stream on a background I/O thread.
+     *
+     * The flusher takes ownership of each buffer submitted to it and hands back an empty
+     * buffer of the same capacity, so the producer can keep filling buffers while earlier
+     * ones are written to disk. At most a fixed number of buffers are kept queued; once the
+     * queue is full submit() waits for the oldest buffer to be written. Written buffers are
+     * recycled, so no allocations are made after the queue has been filled for the first time.
+     *
+     * Buffers are written strictly in submission order at the current put position of the
+     * stream, which must not be used by anyone else until drain() has returned or the flusher
+     * has been destroyed. Any error raised by the I/O thread is rethrown to the producer on the
+     * next call to submit() or drain().
+     */
+    class BackgroundFlusher
+    {
+        public:
+            /**
+             * @brief Start the I/O thread for a file stream.
+             *
+             * @param file The open stream to write to, which must outlive the flusher
+             * @param queueDepth The maximum number of buffers to keep queued for writing
+             * @throws std::runtime_error if the queue depth is zero or the stream is not open
+             */
+            BackgroundFlusher(OutputFileStream & file, std::size_t queueDepth);
+
+            /**
+             * @brief Write any queued buffers and stop the I/O thread.
+             *
+             * Errors raised while writing the remaining buffers are discarded, call drain()
+             * first to have them reported.
+             */
+            ~BackgroundFlusher();
+
+            BackgroundFlusher(const BackgroundFlusher &) = delete;
+            BackgroundFlusher & operator=(const BackgroundFlusher &) = delete;
+
+            /**
+             * @brief Queue a buffer to be written and replace it with an empty one.
+             *
+             * The replacement buffer has the same capacity and byte order as the submitted buffer.
+             * Empty buffers are left untouched.
+             *
+             * @param buffer The buffer to write, which is left empty and ready to be filled again
+             * @throws std::runtime_error if the I/O thread failed to write an earlier buffer
+             */
+            void submit(ByteBuffer & buffer);
+
+            /**
+             * @brief Wait until every queued buffer has been written to the stream.
+             *
+             * @throws std::runtime_error if the I/O thread failed to write a buffer
+             */
+            void drain();
+
+        private:
+            void run();
+            void rethrowIfFailed();
+
+            OutputFileStream & file_;
+            const std::size_t queueDepth_;
+
+            std::deque<ByteBuffer> pendingBuffers_; // full buffers waiting to be written, in submission order
+            std::vector<ByteBuffer> freeBuffers_;   // written buffers available for reuse
+            std::size_t buffersInFlight_;           // buffers either queued or being written
+            bool stopRequested_;
+            std::exception_ptr error_;
+            std::mutex mutex_;
+            std::condition_variable bufferPending_;
+            std::condition_variable bufferWritten_;
+            std::thread worker_;
+    };
+
+} // namespace ParticleZoo
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "particlezoo/ByteBuffer.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief General purpose lossless compressors available to the formats of the library.
+     *
+     * The compressors are optional dependencies, enabled by building with USE_ZSTD and USE_LZ4
+     * (see the configure script), so a codec may be known to the library without being
+     * available in a particular build. NONE is always available and stores the data as it is.
+     * The numeric values are stored in files and must not change.
+     */
+    enum class CompressionCodec : std::uint8_t {
+        NONE = 0,   ///< No compression
+        ZSTD = 1,   ///< Zstandard, a good compression ratio with fast decompression
+        LZ4  = 2    ///< LZ4, a lower compression ratio with very fast compression and decompression
+    };
+
+    /**
+     * @brief Check if a codec was enabled when the library was built.
+     *
+     * @param codec The codec to check
+     * @return true if data can be compressed and decompressed with the codec
+     */
+    bool IsCompressionCodecAvailable(CompressionCodec codec);
+
+    /**
+     * @brief Get the name of a codec, as accepted by CompressionCodecFromName().
+     *
+     * @param codec The codec
+     * @return std::string The name of the codec ("none", "zstd" or "lz4")
+     */
+    std::string CompressionCodecName(CompressionCodec codec);
+
+    /**
+     * @brief Get a codec from its name.
+     *
+     * @param name The name of the codec, in any case
+     * @return CompressionCodec The codec
+     * @throws std::runtime_error if the name is not that of a known codec
+     */
+    CompressionCodec CompressionCodecFromName(const std::string & name);
+
+    /**
+     * @brief Get the best codec available in this build.
+     *
+     * @return CompressionCodec ZSTD if available, otherwise LZ4 if available, otherwise NONE
+     */
+    CompressionCodec DefaultCompressionCodec();
+
+    /**
+     * @brief Compress some data, appending the result to a vector.
+     *
+     * @param codec The codec to compress with
+     * @param input The data to compress
+     * @param output The vector to append the compressed data to
+     * @param level The compression level, 0 for the default of the codec (ignored by NONE and LZ4)
+     * @return std::size_t The number of bytes appended to the output
+     * @throws std::runtime_error if the codec is not available or compression fails
+     */
+    std::size_t CompressBytes(CompressionCodec codec, std::span<const byte> input, std::vector<byte> & output, int level = 0);
+
+    /**
+     * @brief Decompress data compressed by CompressBytes().
+     *
+     * The size of the decompressed data must be known in advance, the output is filled
+     * completely or an error is raised.
+     *
+     * @param codec The codec the data was compressed with
+     * @param input The compressed data
+     * @param output The space to decompress the data into, exactly the size of the decompressed data
+     * @throws std::runtime_error if the codec is not available or the data do not decompress to exactly the size of the output
+     */
+    void DecompressBytes(CompressionCodec codec, std::span<const byte> input, std::span<byte> output);
+
+} // namespace ParticleZoo
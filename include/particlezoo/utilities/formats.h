@@ -101,12 +101,15 @@ namespace ParticleZoo
          * @brief Create a reader for a file using automatic format detection.
          * 
          * Determines the appropriate format based on the file extension and creates
-         * a reader instance. Requires a unique format match for the extension.
+         * a reader instance. Requires a unique format match for the extension. A
+         * compression suffix (.gz, .zst or .zstd) after the extension is ignored, the
+         * file being decompressed as it is read (see InputFileStream).
          * 
          * @param filename The path to the file to read (must have a recognized extension)
          * @param options User options for configuring the reader (default: empty)
          * @return std::unique_ptr<PhaseSpaceFileReader> A unique pointer to the created reader
-         * @throws std::runtime_error if no extension found, no format matches, or multiple formats match
+         * @throws std::runtime_error if no extension found, no format matches, multiple formats match,
+         *         or the filename is "-" (standard input, whose format has to be given)
          */
         static std::unique_ptr<PhaseSpaceFileReader> CreateReader(const std::string& filename, const UserOptions & options = {});
         
@@ -116,7 +119,7 @@ namespace ParticleZoo
          * Creates a reader instance for the specified format, bypassing automatic detection.
          * 
          * @param formatName The name of the format to use (must be registered)
-         * @param filename The path to the file to read
+         * @param filename The path to the file to read, or "-" to read standard input
          * @param options User options for configuring the reader (default: empty)
          * @return std::unique_ptr<PhaseSpaceFileReader> A unique pointer to the created reader
          * @throws std::runtime_error if the format is not registered
@@ -133,7 +136,9 @@ namespace ParticleZoo
          * @param options User options for configuring the writer (default: empty)
          * @param fixedValues Fixed values for constant particle properties (default: empty)
          * @return std::unique_ptr<PhaseSpaceFileWriter> A unique pointer to the created writer
-         * @throws std::runtime_error if no extension found, no format matches, or multiple formats match
+         * @throws std::runtime_error if no extension found, no format matches, multiple formats match,
+         *         the filename has a compression suffix (compressed files cannot be written)
+         *         or it is "-" (standard output, whose format has to be given)
          */
         static std::unique_ptr<PhaseSpaceFileWriter> CreateWriter(const std::string& filename, const UserOptions & options = {}, const FixedValues & fixedValues = {});
         
@@ -143,7 +148,7 @@ namespace ParticleZoo
          * Creates a writer instance for the specified format, bypassing automatic detection.
          * 
          * @param formatName The name of the format to use (must be registered)
-         * @param filename The path to the file to write
+         * @param filename The path to the file to write, or "-" to write to standard output
          * @param options User options for configuring the writer (default: empty)
          * @param fixedValues Fixed values for constant particle properties (default: empty)
          * @return std::unique_ptr<PhaseSpaceFileWriter> A unique pointer to the created writer
@@ -155,7 +160,8 @@ namespace ParticleZoo
          * @brief Find all formats that support a given file extension.
          * 
          * Performs case-insensitive matching of file extensions. Also handles formats
-         * that support extensions with numeric suffixes (e.g., ".egsphsp1" matching ".egsphsp").
+         * that support extensions with numeric suffixes (e.g., ".egsphsp1" matching ".egsphsp"),
+         * and ignores a trailing compression suffix (e.g., ".IAEAphsp.gz" matching ".IAEAphsp").
          * 
          * @param extension The file extension to search for (including the dot)
          * @return std::vector<SupportedFormat> Vector of formats supporting the extension
@@ -186,6 +192,7 @@ namespace ParticleZoo
          * - TOPAS format (.phsp)
          * - penEasy format (.dat)
          * - EGS format (.egsphsp with suffixes)
+         * - ParticleZoo native format (.pzphsp)
          * - ROOT format (.root) - if compiled with ROOT support
          * 
          * This method is safe to call multiple times (uses internal flag to prevent duplicate registration).
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <optional>
+#include <utility>
+
+#include "particlezoo/PDGParticleCodes.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Summary of the records in one block of histories of a HistoryIndex.
+     *
+     * Holds the ranges of kinetic energy and position and the particle types of every record in
+     * the block, pseudo-particles included, gathered the same way as the particle statistics of
+     * an IAEA header (see IAEAHeader::countParticleStats()). A filtered read uses these to pass
+     * over a whole block at once when no record in it can be accepted (see
+     * ParticleFilter::mayAcceptAnyOf()), counting the records and histories it holds without
+     * reading them.
+     *
+     * The values are those of the particles as returned by the reader the index was built with,
+     * so an index should only be used with readers opened with the same options.
+     */
+    struct HistoryBlockStatistics
+    {
+        std::uint64_t numberOfRecords{0};           ///< Records in the block, pseudo-particles included
+        std::uint64_t numberOfPseudoParticles{0};   ///< Pseudo-particles among the records
+        std::uint64_t numberOfHistories{0};         ///< Original histories of the block, empty histories counted by incremental history numbers included
+        std::uint64_t particleTypes{0};             ///< Presence bitmap of the types of the records (see ParticleTypeBit())
+        float minEnergy{std::numeric_limits<float>::max()};     ///< Smallest kinetic energy
+        float maxEnergy{std::numeric_limits<float>::lowest()};  ///< Largest kinetic energy
+        float minX{std::numeric_limits<float>::max()};          ///< Smallest X position
+        float maxX{std::numeric_limits<float>::lowest()};       ///< Largest X position
+        float minY{std::numeric_limits<float>::max()};          ///< Smallest Y position
+        float maxY{std::numeric_limits<float>::lowest()};       ///< Largest Y position
+        float minZ{std::numeric_limits<float>::max()};          ///< Smallest Z position
+        float maxZ{std::numeric_limits<float>::lowest()};       ///< Largest Z position
+
+        /**
+         * @brief Get the bit standing for a particle type in the presence bitmap.
+         *
+         * There are far more particle types than bits so some types share a bit, which can only
+         * make a block look like it holds a type it does not. The common types (photons,
+         * electrons, positrons, protons, neutrons and pseudo-particles) have bits of their own.
+         *
+         * @param type The particle type
+         * @return std::uint64_t The bitmap with only the bit of the type set
+         */
+        static std::uint64_t ParticleTypeBit(ParticleType type);
+
+        /**
+         * @brief Add a record to the statistics.
+         *
+         * @param type The type of the particle
+         * @param kineticEnergy The kinetic energy of the particle
+         * @param x The X position of the particle
+         * @param y The Y position of the particle
+         * @param z The Z position of the particle
+         * @param isNewHistory Whether the record starts a new history
+         * @param incrementalHistories The incremental history number of the record, used if it starts a new history
+         */
+        void countRecord(ParticleType type, float kineticEnergy, float x, float y, float z, bool isNewHistory, std::uint32_t incrementalHistories);
+    };
+
+    /**
+     * @brief Sparse index of the history boundaries in a phase space file.
+     *
+     * Formats that do not store the number of represented histories, or where each record cannot
+     * be tied to its history without reading everything before it, otherwise require a full scan
+     * of the file to count histories or to find where a given history starts. A HistoryIndex holds
+     * the number of represented histories and the record index at which every stride-th history
+     * starts, so that any history can be reached by seeking to the closest preceding entry and
+     * reading at most one stride of histories.
+     *
+     * An index is built once with PhaseSpaceFileReader::buildHistoryIndex() and saved to a sidecar
+     * file next to the phase space file (see GetIndexFileName()). The sidecar records the size and
+     * modification time of the phase space file when it was built, and is ignored by Load() if
+     * either no longer matches.
+     *
+     * Histories are numbered from zero in file order. Record indices count every record in the
+     * file, including pseudo-particles, and so can be passed directly to
+     * PhaseSpaceFileReader::moveToParticle().
+     *
+     * Indexes built by PhaseSpaceFileReader::buildHistoryIndex() also hold the statistics of the
+     * records of each block of stride histories, from the first record of one entry up to the
+     * first record of the next (see HistoryBlockStatistics). Sidecars written before these were
+     * added load without them.
+     */
+    class HistoryIndex
+    {
+        public:
+            /**
+             * @brief The default number of histories between consecutive index entries.
+             */
+            static constexpr std::uint64_t DEFAULT_STRIDE = 1024;
+
+            /**
+             * @brief Construct an index from its contents.
+             *
+             * @param stride The number of histories between consecutive entries
+             * @param numberOfRepresentedHistories The number of histories with at least one particle in the file
+             * @param numberOfParticles The number of particles in the file
+             * @param historyStarts The record index of the first particle of histories 0, stride, 2*stride, ...
+             * @param blockStatistics The statistics of the records from each entry up to the next, or nothing if not known
+             * @throws std::invalid_argument if the stride is zero, the number of entries does not match the number of histories or the block statistics are not one per entry
+             */
+            HistoryIndex(std::uint64_t stride, std::uint64_t numberOfRepresentedHistories, std::uint64_t numberOfParticles, std::vector<std::uint64_t> historyStarts, std::vector<HistoryBlockStatistics> blockStatistics = {});
+
+            /**
+             * @brief Get the path of the index sidecar file for a phase space file.
+             *
+             * @param phspFileName The path to the phase space file
+             * @return std::string The phase space file path with ".pzidx" appended
+             */
+            static std::string GetIndexFileName(const std::string & phspFileName);
+
+            /**
+             * @brief Load the index sidecar file for a phase space file if there is a valid one.
+             *
+             * @param phspFileName The path to the phase space file
+             * @return std::optional<HistoryIndex> The index, or nothing if the sidecar does not exist, is
+             *         unreadable, or was built for a different version of the phase space file
+             */
+            static std::optional<HistoryIndex> Load(const std::string & phspFileName);
+
+            /**
+             * @brief Save the index to the sidecar file of a phase space file.
+             *
+             * The current size and modification time of the phase space file are stored with the
+             * index, so it should be saved for the same file it was built from.
+             *
+             * @param phspFileName The path to the phase space file the index was built from
+             * @throws std::runtime_error if the phase space file does not exist or the sidecar cannot be written
+             */
+            void save(const std::string & phspFileName) const;
+
+            /**
+             * @brief Find the closest indexed history at or before a given history.
+             *
+             * @param historyNumber The zero-based history number to look up
+             * @return std::pair<std::uint64_t, std::uint64_t> The indexed history number and the record index at which it starts
+             * @throws std::out_of_range if the history number is not less than the number of represented histories
+             */
+            std::pair<std::uint64_t, std::uint64_t> findClosestHistory(std::uint64_t historyNumber) const;
+
+            /**
+             * @brief Get the number of histories between consecutive index entries.
+             *
+             * @return std::uint64_t The index stride
+             */
+            std::uint64_t getStride() const;
+
+            /**
+             * @brief Get the number of histories with at least one particle in the file.
+             *
+             * @return std::uint64_t The number of represented histories
+             */
+            std::uint64_t getNumberOfRepresentedHistories() const;
+
+            /**
+             * @brief Get the number of particles in the file when the index was built.
+             *
+             * @return std::uint64_t The number of particles, excluding pseudo-particles
+             */
+            std::uint64_t getNumberOfParticles() const;
+
+            /**
+             * @brief Check if the index holds the statistics of its blocks of histories.
+             *
+             * @return true if getBlockStatistics() can be used
+             */
+            bool hasBlockStatistics() const;
+
+            /**
+             * @brief Get the number of blocks of histories, one for each index entry.
+             *
+             * @return std::size_t The number of blocks
+             */
+            std::size_t getNumberOfBlocks() const;
+
+            /**
+             * @brief Get the record index at which a block of histories starts.
+             *
+             * @param block The zero-based block number
+             * @return std::uint64_t The record index of the first particle of history block * stride
+             */
+            std::uint64_t getBlockStart(std::size_t block) const;
+
+            /**
+             * @brief Find the first block of histories starting at or after a record.
+             *
+             * @param recordIndex The record index to look from
+             * @return std::size_t The block number, getNumberOfBlocks() if no block starts at or after the record
+             */
+            std::size_t findBlockStartingFrom(std::uint64_t recordIndex) const;
+
+            /**
+             * @brief Get the statistics of the records of a block of histories.
+             *
+             * @param block The zero-based block number
+             * @return const HistoryBlockStatistics& The statistics of the block
+             * @throws std::logic_error if the index does not hold block statistics
+             */
+            const HistoryBlockStatistics & getBlockStatistics(std::size_t block) const;
+
+        private:
+            std::uint64_t stride_;
+            std::uint64_t numberOfRepresentedHistories_;
+            std::uint64_t numberOfParticles_;
+            std::vector<std::uint64_t> historyStarts_;  // record index of every stride-th history
+            std::vector<HistoryBlockStatistics> blockStatistics_; // one per entry, empty if not known
+    };
+
+    // Inline implementations for the HistoryBlockStatistics struct
+
+    inline std::uint64_t HistoryBlockStatistics::ParticleTypeBit(ParticleType type) {
+        // Fibonacci hashing of the PDG code spreads the common types over distinct bits
+        const std::uint32_t code = static_cast<std::uint32_t>(static_cast<std::int32_t>(type));
+        return std::uint64_t{1} << ((code * 0x9E3779B1u) >> 26);
+    }
+
+    // keeping this function inline for performance reasons
+    inline void HistoryBlockStatistics::countRecord(ParticleType type, float kineticEnergy, float x, float y, float z, bool isNewHistory, std::uint32_t incrementalHistories) {
+        numberOfRecords++;
+        if (type == ParticleType::PseudoParticle) numberOfPseudoParticles++;
+        if (isNewHistory) numberOfHistories += std::max<std::uint32_t>(incrementalHistories, 1);
+
+        particleTypes |= ParticleTypeBit(type);
+        minEnergy = std::min(minEnergy, kineticEnergy);
+        maxEnergy = std::max(maxEnergy, kineticEnergy);
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
+
+    // Inline implementations for the HistoryIndex class
+
+    inline std::string HistoryIndex::GetIndexFileName(const std::string & phspFileName) { return phspFileName + ".pzidx"; }
+
+    inline std::uint64_t HistoryIndex::getStride() const { return stride_; }
+
+    inline std::uint64_t HistoryIndex::getNumberOfRepresentedHistories() const { return numberOfRepresentedHistories_; }
+
+    inline std::uint64_t HistoryIndex::getNumberOfParticles() const { return numberOfParticles_; }
+
+    inline bool HistoryIndex::hasBlockStatistics() const { return !blockStatistics_.empty() || historyStarts_.empty(); }
+
+    inline std::size_t HistoryIndex::getNumberOfBlocks() const { return historyStarts_.size(); }
+
+    inline std::uint64_t HistoryIndex::getBlockStart(std::size_t block) const { return historyStarts_[block]; }
+
+    inline std::size_t HistoryIndex::findBlockStartingFrom(std::uint64_t recordIndex) const {
+        return static_cast<std::size_t>(std::lower_bound(historyStarts_.begin(), historyStarts_.end(), recordIndex) - historyStarts_.begin());
+    }
+
+} // namespace ParticleZoo
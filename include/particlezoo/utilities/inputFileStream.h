@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Compression of a phase space file as a whole, as done by gzip or zstd.
+     *
+     * Files compressed this way are decompressed transparently while they are read (see
+     * InputFileStream). Decompression relies on optional dependencies, enabled by building with
+     * USE_ZLIB and USE_ZSTD (see the configure script).
+     */
+    enum class StreamCompression : std::uint8_t {
+        NONE,   ///< Not compressed
+        GZIP,   ///< gzip (or zlib) compressed, possibly in several members
+        ZSTD    ///< zstd compressed, possibly in several frames or in the seekable zstd format
+    };
+
+    /**
+     * @brief Detect the compression of a file from its first bytes.
+     *
+     * @param fileName Path to the file
+     * @return StreamCompression The compression of the file, NONE if it cannot be opened or is not compressed
+     */
+    StreamCompression DetectStreamCompression(const std::string & fileName);
+
+    /**
+     * @brief Check if files with a compression can be read in this build.
+     *
+     * @param compression The compression to check
+     * @return true if the files can be decompressed
+     */
+    bool IsStreamCompressionAvailable(StreamCompression compression);
+
+    /**
+     * @brief Get the name of a compression.
+     *
+     * @param compression The compression
+     * @return std::string The name of the compression ("none", "gzip" or "zstd")
+     */
+    std::string StreamCompressionName(StreamCompression compression);
+
+    /**
+     * @brief Check if a file name ends with the suffix of a compressed file (.gz, .zst or .zstd).
+     *
+     * @param fileName The file name to check, compared without regard to case
+     * @return true if the file name ends with a compression suffix
+     */
+    bool HasCompressionSuffix(const std::string & fileName);
+
+    /**
+     * @brief Remove the suffix of a compressed file from a file name.
+     *
+     * For example "beam.IAEAphsp.gz" becomes "beam.IAEAphsp".
+     *
+     * @param fileName The file name
+     * @return std::string The file name without its compression suffix, unchanged if it has none
+     */
+    std::string StripCompressionSuffix(const std::string & fileName);
+
+    /**
+     * @brief Check if a file name stands for standard input or output.
+     *
+     * A phase space file named "-" is read from standard input or written to standard output,
+     * such as through a pipe between two programs. It is then read or written once from start to
+     * end, see PhaseSpaceFileReader and PhaseSpaceFileWriter for what that rules out.
+     *
+     * @param fileName The file name to check
+     * @return true if the file name is "-"
+     */
+    bool IsStandardStream(const std::string & fileName);
+
+
+    /**
+     * @brief Input file stream decompressing gzip and zstd compressed files transparently.
+     *
+     * Used in place of std::ifstream to read phase space files. The compression is detected from
+     * the first bytes of the file, so compressed files are read whatever their name. Positions
+     * given to and returned by seekg() and tellg() are those in the decompressed data, and
+     * seeking to the end gives the decompressed size.
+     *
+     * Seeking in a compressed file decompresses it from the start of the frame (zstd) or member
+     * (gzip) holding the position. The frames of a zstd file are found from the seek table of the
+     * seekable zstd format if there is one, otherwise from the frame headers. The members of a
+     * gzip file are only found by decompressing it once, which is done the first time a position
+     * other than the current one is needed, including the end of the file to find its size.
+     * Files in the seekable zstd format, or zstd and gzip files made of many small frames or
+     * members, can therefore be read from anywhere with little wasted work.
+     *
+     * Errors in the compressed data are raised as std::runtime_error by the reading functions
+     * rather than only setting the state of the stream.
+     *
+     * A stream opened with the file name "-" reads standard input as it is, which can only be
+     * read forward: tellg() gives the number of bytes read so far and seekg() fails. Compressed
+     * data is not detected on standard input, it has to be decompressed earlier in the pipe.
+     */
+    class InputFileStream : public std::istream
+    {
+        public:
+            /**
+             * @brief Construct a stream not associated with any file.
+             */
+            InputFileStream();
+
+            /**
+             * @brief Open a file for reading.
+             *
+             * The state of the stream is set to failed if the file cannot be opened.
+             *
+             * @param fileName Path to the file to read, or "-" to read standard input
+             * @throws std::runtime_error if the file is compressed with a compression not available in this build
+             */
+            explicit InputFileStream(const std::string & fileName);
+
+            InputFileStream(InputFileStream && other);
+            InputFileStream & operator=(InputFileStream && other);
+            ~InputFileStream() override;
+
+            /**
+             * @brief Check if a file is open.
+             *
+             * @return true if the stream is associated with an open file
+             */
+            bool is_open() const;
+
+            /**
+             * @brief Close the file.
+             */
+            void close();
+
+            /**
+             * @brief Get the compression of the file being read.
+             *
+             * @return StreamCompression The compression, NONE if the file is read as it is
+             */
+            StreamCompression getCompression() const { return compression_; }
+
+            /**
+             * @brief Check if the stream reads standard input.
+             *
+             * @return true if the stream was opened with the file name "-"
+             */
+            bool isStandardInput() const { return standardInput_ != nullptr; }
+
+        private:
+            std::streambuf * currentBuffer() const;
+
+            std::unique_ptr<std::filebuf>   file_;          /// the file as stored
+            std::unique_ptr<std::streambuf> decompressor_;  /// decompressed view of file_, if compressed
+            std::unique_ptr<std::streambuf> standardInput_; /// buffered reader of standard input, in place of file_
+            StreamCompression               compression_;
+    };
+
+} // namespace ParticleZoo
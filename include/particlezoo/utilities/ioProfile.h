@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+#include "particlezoo/utilities/argParse.h"
+
+namespace ParticleZoo
+{
+
+    inline CLICommand ProfileCommand { BOTH, "", "profile", "Time the reading, writing, decoding and encoding of phase space files and report where the time went", { CLI_VALUELESS } };
+
+    /**
+     * @brief Counters and timers of the reading or writing of a phase space file.
+     *
+     * Kept by every PhaseSpaceFileReader and PhaseSpaceFileWriter (see getIOProfile()) so that a
+     * slow job can be told to be bound by its disk or by decoding the particles. The counters are
+     * always kept, they are only updated once per block or per particle. The times are only
+     * measured when the reader or writer is given ProfileCommand (--profile), otherwise no clock
+     * is read. Measuring them reads the clock around every particle, which slows down the decoding
+     * noticeably, so compare the two times with each other rather than with unprofiled runs.
+     *
+     * The I/O time is the time the caller was blocked reading or writing the file, including
+     * waiting on the background I/O thread of a prefetching reader or a background flushing
+     * writer (whose own I/O then overlaps with decoding). Memory mapped files are read by page
+     * faults while their records are decoded, so that time counts as decoding. Formats doing their
+     * own I/O report it the same way as long as they use the profiling hooks of their base class.
+     */
+    struct IOProfile
+    {
+        std::uint64_t bytes = 0;            ///< Bytes read from or written to the file, header included
+        std::uint64_t blocks = 0;           ///< Blocks read (readNextBlock()) or written (writeNextBlock()), including those handed to background I/O threads
+        std::uint64_t particles = 0;        ///< Particle records decoded or encoded
+        std::uint64_t particleObjects = 0;  ///< Particle objects made: decoded one at a time rather than into a ParticleBlock when reading, copied to be encoded when writing
+        bool          timed = false;        ///< True if the times below were measured
+        double        ioSeconds = 0;        ///< Time blocked reading or writing the file
+        double        codingSeconds = 0;    ///< Time decoding particles (readBinaryParticle(), readASCIIParticle(), ...) or encoding them (writeBinaryParticle(), ...)
+
+        /**
+         * @brief Add the counts and times of another profile, such as that of another thread.
+         *
+         * @param other The profile to add
+         * @return IOProfile& This profile
+         */
+        IOProfile & operator+=(const IOProfile & other)
+        {
+            bytes += other.bytes;
+            blocks += other.blocks;
+            particles += other.particles;
+            particleObjects += other.particleObjects;
+            timed = timed || other.timed;
+            ioSeconds += other.ioSeconds;
+            codingSeconds += other.codingSeconds;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Adds the time until it goes out of scope to a running total, if enabled.
+     *
+     * A disabled timer never reads the clock. Nested timers of the same total are not counted
+     * twice, and time added to another total while the timer runs can be left out, such as the
+     * I/O a reader does in the middle of decoding a record.
+     */
+    class ProfileTimer
+    {
+        public:
+            /**
+             * @brief Start timing.
+             *
+             * @param seconds The total to add the time to
+             * @param enabled Whether to time at all
+             * @param excludedSeconds Another total whose increase while timing is not added, or nullptr
+             */
+            ProfileTimer(double & seconds, bool enabled, const double * excludedSeconds = nullptr)
+            : seconds_(nullptr)
+            {
+                if (enabled) [[unlikely]] start(seconds, excludedSeconds);
+            }
+
+            ~ProfileTimer()
+            {
+                if (seconds_) [[unlikely]] stop();
+            }
+
+            ProfileTimer(const ProfileTimer &) = delete;
+            ProfileTimer & operator=(const ProfileTimer &) = delete;
+
+        private:
+            void start(double & seconds, const double * excludedSeconds)
+            {
+                seconds_ = &seconds;
+                secondsAtStart_ = seconds;
+                excludedSeconds_ = excludedSeconds;
+                excludedAtStart_ = excludedSeconds ? *excludedSeconds : 0;
+                start_ = std::chrono::steady_clock::now();
+            }
+
+            void stop()
+            {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+                if (excludedSeconds_) elapsed -= *excludedSeconds_ - excludedAtStart_;
+                *seconds_ = secondsAtStart_ + elapsed; // replaces the time of any nested timer, which is part of this one
+            }
+
+            double * seconds_;
+            double secondsAtStart_;
+            const double * excludedSeconds_;
+            double excludedAtStart_;
+            std::chrono::steady_clock::time_point start_;
+    };
+
+    /**
+     * @brief Print a profile as a line of text.
+     *
+     * @param output The stream to print to
+     * @param label What the profile is of, such as "Read input.egsphsp"
+     * @param profile The profile to print
+     * @param writing True for the profile of a writer, to name its coding time encoding rather than decoding
+     */
+    inline void PrintIOProfile(std::ostream & output, const std::string & label, const IOProfile & profile, bool writing = false)
+    {
+        const std::ios_base::fmtflags flags = output.flags();
+        const std::streamsize precision = output.precision();
+        output << label << ": " << std::fixed << std::setprecision(1) << static_cast<double>(profile.bytes) / 1e6 << " MB in " << profile.blocks << " blocks, "
+               << profile.particles << " particles " << (writing ? "encoded" : "decoded") << ", " << profile.particleObjects << " Particle objects";
+        if (profile.timed) {
+            output << std::setprecision(3) << ", " << profile.ioSeconds << " s blocked in I/O, " << profile.codingSeconds << " s " << (writing ? "encoding" : "decoding");
+        }
+        output << "\n";
+        output.flags(flags);
+        output.precision(precision);
+    }
+
+} // namespace ParticleZoo
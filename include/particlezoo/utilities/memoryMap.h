@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <span>
+
+#include "particlezoo/ByteBuffer.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Read-only memory mapping of an entire file.
+     *
+     * Maps a file into the address space of the process so that its contents can be
+     * read directly from the operating system page cache, without copying them into a
+     * private buffer. Several processes mapping the same file share the same physical pages.
+     * Uses mmap on POSIX systems and MapViewOfFile on Windows.
+     *
+     * The mapping is released when the object is destroyed, after which any views of the
+     * data are no longer valid.
+     */
+    class MemoryMappedFile
+    {
+        public:
+            /**
+             * @brief Map a file into memory for reading.
+             *
+             * @param fileName The path to the file to map
+             * @throws std::runtime_error if the file cannot be opened or mapped
+             */
+            explicit MemoryMappedFile(const std::string & fileName);
+
+            /**
+             * @brief Unmap the file and release the associated handles.
+             */
+            ~MemoryMappedFile();
+
+            MemoryMappedFile(const MemoryMappedFile &) = delete;
+            MemoryMappedFile & operator=(const MemoryMappedFile &) = delete;
+
+            /**
+             * @brief Get the size of the mapped file.
+             *
+             * @return std::uint64_t The number of bytes in the file
+             */
+            std::uint64_t size() const;
+
+            /**
+             * @brief Get a view of the entire mapped file.
+             *
+             * @return std::span<const byte> A span covering every byte of the file
+             */
+            std::span<const byte> data() const;
+
+            /**
+             * @brief Advise the operating system that the file will be read sequentially.
+             *
+             * Allows more aggressive read-ahead. This is only a hint and has no effect on
+             * platforms which do not support it.
+             */
+            void adviseSequential() const;
+
+            /**
+             * @brief Advise the operating system that the file will be accessed in random order.
+             *
+             * Disables read-ahead, which is preferable after seeking around the file. This is
+             * only a hint and has no effect on platforms which do not support it.
+             */
+            void adviseRandom() const;
+
+        private:
+            const std::string fileName_;
+            const byte* data_;
+            std::uint64_t size_;
+#if defined(_WIN32)
+            void* fileHandle_;
+            void* mappingHandle_;
+#else
+            int fileDescriptor_;
+#endif
+    };
+
+    // Inline implementations for the MemoryMappedFile class
+
+    inline std::uint64_t MemoryMappedFile::size() const { return size_; }
+    inline std::span<const byte> MemoryMappedFile::data() const { return std::span<const byte>(data_, static_cast<std::size_t>(size_)); }
+
+} // namespace ParticleZoo
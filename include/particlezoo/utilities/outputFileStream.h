@@ -0,0 +1,71 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include "particlezoo/utilities/inputFileStream.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Output file stream writing either to a file or to standard output.
+     *
+     * Used in place of std::ofstream to write phase space files, so that a file named "-" (see
+     * IsStandardStream()) is written to standard output, such as into a pipe to another program.
+     * Files are truncated and written in binary mode. Standard output can only be written
+     * forward: tellp() gives the number of bytes written so far and seekp() fails.
+     */
+    class OutputFileStream : public std::ostream
+    {
+        public:
+            /**
+             * @brief Construct a stream not associated with any file.
+             */
+            OutputFileStream();
+
+            /**
+             * @brief Open a file for writing.
+             *
+             * The state of the stream is set to failed if the file cannot be opened.
+             *
+             * @param fileName Path to the file to write, or "-" to write to standard output
+             */
+            explicit OutputFileStream(const std::string & fileName);
+
+            OutputFileStream(OutputFileStream && other);
+            OutputFileStream & operator=(OutputFileStream && other);
+            ~OutputFileStream() override;
+
+            /**
+             * @brief Check if a file is open.
+             *
+             * @return true if the stream is associated with an open file or with standard output
+             */
+            bool is_open() const;
+
+            /**
+             * @brief Flush and close the file.
+             *
+             * Standard output is flushed but stays open for the rest of the program.
+             */
+            void close();
+
+            /**
+             * @brief Check if the stream writes to standard output.
+             *
+             * @return true if the stream was opened with the file name "-"
+             */
+            bool isStandardOutput() const { return standardOutput_ != nullptr; }
+
+        private:
+            std::streambuf * currentBuffer() const;
+
+            std::unique_ptr<std::filebuf>   file_;           /// the file written to
+            std::unique_ptr<std::streambuf> standardOutput_; /// buffered writer of standard output, in place of file_
+    };
+
+} // namespace ParticleZoo
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "particlezoo/ByteBuffer.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Reads a file ahead in fixed size blocks on a background I/O thread.
+     *
+     * The prefetcher opens its own stream on the file and keeps up to a fixed number of
+     * blocks read ahead of the consumer, so that the latency of each read overlaps with the
+     * processing of the previous block. This is most useful on high latency storage such as
+     * network filesystems. Block buffers are recycled once consumed, so no allocations are
+     * made after the queue has been filled for the first time.
+     *
+     * Blocks are delivered strictly in file order. Any error raised by the I/O thread is
+     * rethrown to the consumer on the next call to appendNextBlock().
+     */
+    class BlockPrefetcher
+    {
+        public:
+            /**
+             * @brief Start prefetching a range of a file.
+             *
+             * @param fileName The path to the file to read
+             * @param startOffset The byte offset of the first block
+             * @param endOffset The byte offset at which to stop reading (usually the file size)
+             * @param blockSize The size of each block in bytes
+             * @param queueDepth The maximum number of blocks to keep read ahead
+             * @throws std::runtime_error if the block size or queue depth is zero, or the file cannot be opened
+             */
+            BlockPrefetcher(const std::string & fileName, std::uint64_t startOffset, std::uint64_t endOffset, std::size_t blockSize, std::size_t queueDepth);
+
+            /**
+             * @brief Stop the I/O thread and release the block buffers.
+             */
+            ~BlockPrefetcher();
+
+            BlockPrefetcher(const BlockPrefetcher &) = delete;
+            BlockPrefetcher & operator=(const BlockPrefetcher &) = delete;
+
+            /**
+             * @brief Append the next block in the file to a buffer.
+             *
+             * Waits until the next block has been read if it is not already available.
+             *
+             * @param destination The buffer to append the block to, which must have room for a full block
+             * @return std::size_t The number of bytes appended, or 0 once the end of the range has been reached
+             * @throws std::runtime_error if the destination buffer does not have room for a full block or the I/O thread failed
+             */
+            std::size_t appendNextBlock(ByteBuffer & destination);
+
+            /**
+             * @brief Get the size of the blocks read by the prefetcher.
+             *
+             * @return std::size_t The block size in bytes
+             */
+            std::size_t getBlockSize() const;
+
+        private:
+            void run();
+
+            const std::string fileName_;
+            const std::size_t blockSize_;
+            const std::size_t queueDepth_;
+            std::ifstream file_;
+            std::uint64_t nextOffset_;
+            const std::uint64_t endOffset_;
+
+            std::deque<ByteBuffer> readyBlocks_;  // blocks read and waiting to be consumed, in file order
+            std::vector<ByteBuffer> freeBlocks_;  // consumed blocks available for reuse
+            std::size_t blocksInFlight_;          // blocks either queued or being read
+            bool stopRequested_;
+            bool finished_;
+            std::exception_ptr error_;
+            std::mutex mutex_;
+            std::condition_variable blockReady_;
+            std::condition_variable spaceAvailable_;
+            std::thread worker_;
+    };
+
+    // Inline implementations for the BlockPrefetcher class
+
+    inline std::size_t BlockPrefetcher::getBlockSize() const { return blockSize_; }
+
+} // namespace ParticleZoo
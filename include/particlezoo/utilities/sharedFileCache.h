@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "particlezoo/utilities/memoryMap.h"
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Get a read-only memory mapping of a file shared by every reader of the process.
+     *
+     * Readers mapping the same file share one mapping, which is released when the last of them
+     * lets go of it. Files are told apart by their canonical path, size and modification time,
+     * so a file replaced while the program runs is mapped anew.
+     *
+     * @param fileName The path to the file to map
+     * @return std::shared_ptr<const MemoryMappedFile> The mapping of the file
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    std::shared_ptr<const MemoryMappedFile> MapSharedFile(const std::string & fileName);
+
+    /**
+     * @brief Get a read-only memory mapping of a copy of a file kept in a node-wide cache.
+     *
+     * The first process to ask for a file copies it into the cache directory, and every process
+     * on the node then maps the same copy, so a phase space on network storage is read from it
+     * once per node rather than once per process. Within a process the mapping is shared as
+     * with MapSharedFile(). The cache directory should be on a memory file system such as
+     * /dev/shm, whose pages are then shared by all the processes mapping them. A tmpfs mounted
+     * with huge=within_size backs the copies with huge pages.
+     *
+     * A copy is named after a hash of the canonical path, size and modification time of the
+     * file, so a changed file is copied again under a new name. Copies are written under a
+     * temporary name and renamed once complete, while on POSIX systems a lock file next to the
+     * copy makes other processes wait for it rather than copy the file too. Copies are never
+     * removed by the library, they can be deleted once no job reads them.
+     *
+     * @param fileName The path to the file to map
+     * @param cacheDirectory The directory of the cache, or empty for the default (see GetDefaultSharedCacheDirectory())
+     * @return std::shared_ptr<const MemoryMappedFile> The mapping of the cached copy of the file
+     * @throws std::runtime_error if the file cannot be copied into the cache or mapped
+     */
+    std::shared_ptr<const MemoryMappedFile> MapCachedFile(const std::string & fileName, const std::string & cacheDirectory = "");
+
+    /**
+     * @brief Get the directory the node-wide cache is kept in by default.
+     *
+     * @return std::string /dev/shm where it exists, otherwise the temporary directory of the system
+     */
+    std::string GetDefaultSharedCacheDirectory();
+
+} // namespace ParticleZoo
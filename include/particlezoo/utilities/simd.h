@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) && defined(__FMA__)
+    #include <immintrin.h>
+    #define PARTICLEZOO_SIMD_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define PARTICLEZOO_SIMD_NEON 1
+#endif
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Calculate the third component of many unit vectors from the other two.
+     *
+     * Vectorized equivalent of PhaseSpaceFileReader::calcThirdUnitComponent() applied to every
+     * element of the arrays, producing bit-identical results. Uses AVX2/FMA on x86 and NEON on
+     * AArch64 when the compiler targets them, otherwise falls back to a scalar loop. Where the
+     * two known components have a magnitude greater than one, they are renormalized in place
+     * and the third component is set to zero.
+     *
+     * @param u The first components (may be modified for normalization)
+     * @param v The second components (may be modified for normalization)
+     * @param w The calculated third components, always positive or zero
+     * @param count The number of vectors
+     */
+    inline void CalcThirdUnitComponents(float * u, float * v, float * w, std::size_t count)
+    {
+        std::size_t i = 0;
+
+#if defined(PARTICLEZOO_SIMD_AVX2)
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= count; i += 8) {
+            __m256 U = _mm256_loadu_ps(u + i);
+            __m256 V = _mm256_loadu_ps(v + i);
+            __m256 uuvv = _mm256_fmadd_ps(U, U, _mm256_mul_ps(V, V));
+            __m256 tooLong = _mm256_cmp_ps(uuvv, one, _CMP_GT_OQ);
+            if (!_mm256_testz_ps(tooLong, tooLong)) [[unlikely]] {
+                __m256 normFactor = _mm256_div_ps(one, _mm256_sqrt_ps(uuvv));
+                _mm256_storeu_ps(u + i, _mm256_blendv_ps(U, _mm256_mul_ps(U, normFactor), tooLong));
+                _mm256_storeu_ps(v + i, _mm256_blendv_ps(V, _mm256_mul_ps(V, normFactor), tooLong));
+            }
+            // max() with zero as the first operand keeps NaNs, matching the scalar sqrt(1 - uuvv)
+            _mm256_storeu_ps(w + i, _mm256_sqrt_ps(_mm256_max_ps(zero, _mm256_sub_ps(one, uuvv))));
+        }
+#elif defined(PARTICLEZOO_SIMD_NEON)
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t U = vld1q_f32(u + i);
+            float32x4_t V = vld1q_f32(v + i);
+            float32x4_t uuvv = vfmaq_f32(vmulq_f32(V, V), U, U);
+            uint32x4_t tooLong = vcgtq_f32(uuvv, one);
+            if (vmaxvq_u32(tooLong) != 0) [[unlikely]] {
+                float32x4_t normFactor = vdivq_f32(one, vsqrtq_f32(uuvv));
+                vst1q_f32(u + i, vbslq_f32(tooLong, vmulq_f32(U, normFactor), U));
+                vst1q_f32(v + i, vbslq_f32(tooLong, vmulq_f32(V, normFactor), V));
+            }
+            // vmaxq_f32 propagates NaNs, matching the scalar sqrt(1 - uuvv)
+            vst1q_f32(w + i, vsqrtq_f32(vmaxq_f32(zero, vsubq_f32(one, uuvv))));
+        }
+#endif
+
+        // scalar fallback and remainder
+        for (; i < count; i++) {
+            const float uuvv = std::fma(u[i], u[i], v[i] * v[i]);
+            if (uuvv > 1.f) [[unlikely]] {
+                float normFactor = 1.f / std::sqrt(uuvv);
+                u[i] *= normFactor;
+                v[i] *= normFactor;
+                w[i] = 0.f;
+            } else if (uuvv == 1.f) [[unlikely]] {
+                w[i] = 0.f;
+            } else {
+                w[i] = std::sqrt(1.f - uuvv);
+            }
+        }
+    }
+
+    /**
+     * @brief Normalize many direction vectors to unit length.
+     *
+     * Array equivalent of the normalization Particle applies on construction, producing identical
+     * results. Vectors which are already of unit length or are zero are left unchanged.
+     *
+     * @param u The first components
+     * @param v The second components
+     * @param w The third components
+     * @param count The number of vectors
+     */
+    inline void NormalizeDirectionalCosines(float * u, float * v, float * w, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++) {
+            float magnitude = u[i]*u[i] + v[i]*v[i] + w[i]*w[i];
+            if (magnitude == 0 || magnitude == 1.f) continue;
+            magnitude = std::sqrt(magnitude);
+            u[i] /= magnitude;
+            v[i] /= magnitude;
+            w[i] /= magnitude;
+        }
+    }
+
+} // namespace ParticleZoo
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief A square grid of tiles over the X and Y positions of a phase space, numbered in Z-order.
+     *
+     * The grid covers the rectangle from (minX, minY) to (maxX, maxY) with 2^level tiles on each
+     * side. Tiles are numbered by their Morton code, the bits of their column and row interleaved,
+     * so that tiles with close numbers are also close together on the plane at every scale.
+     * Positions outside of the rectangle belong to the closest tile on its edge.
+     */
+    struct SpatialGrid
+    {
+        static constexpr unsigned int DEFAULT_LEVEL = 6;   ///< 64 by 64 tiles
+        static constexpr unsigned int MAXIMUM_LEVEL = 16;  ///< 65536 by 65536 tiles, the most whose Morton codes fit in 32 bits
+
+        float minX{0};              ///< Smallest X position covered
+        float maxX{0};              ///< Largest X position covered
+        float minY{0};              ///< Smallest Y position covered
+        float maxY{0};              ///< Largest Y position covered
+        unsigned int level{DEFAULT_LEVEL}; ///< Base 2 logarithm of the number of tiles on each side
+
+        /**
+         * @brief Get the number of tiles on each side of the grid.
+         *
+         * @return std::uint32_t 2 to the power of the level
+         */
+        std::uint32_t getTilesPerSide() const;
+
+        /**
+         * @brief Get the tile of a position.
+         *
+         * @param x The X position
+         * @param y The Y position
+         * @return std::uint32_t The Morton code of the tile holding the position
+         */
+        std::uint32_t getTile(float x, float y) const;
+
+        /**
+         * @brief Get the Morton code of a tile from its column and row.
+         *
+         * @param column The column of the tile, counted from minX
+         * @param row The row of the tile, counted from minY
+         * @return std::uint32_t The bits of the column and row interleaved, those of the column in the even positions
+         */
+        static std::uint32_t MortonCode(std::uint32_t column, std::uint32_t row);
+    };
+
+    /**
+     * @brief A run of consecutive records of a phase space file.
+     */
+    struct RecordRange
+    {
+        std::uint64_t firstRecord{0};        ///< Record index of the first record, as passed to PhaseSpaceFileReader::moveToParticle()
+        std::uint64_t numberOfRecords{0};    ///< Records in the range, pseudo-particles included
+        std::uint64_t numberOfHistories{0};  ///< Represented histories in the range, the first starting at its first record
+    };
+
+    /**
+     * @brief The histories of a phase space file whose first particle lies in one tile of a SpatialGrid.
+     */
+    struct SpatialTile
+    {
+        std::uint32_t tile{0};                  ///< Morton code of the tile
+        std::uint64_t numberOfHistories{0};     ///< Represented histories of the tile
+        std::uint64_t numberOfRecords{0};       ///< Records of those histories, pseudo-particles included
+        float minX{std::numeric_limits<float>::max()};     ///< Smallest X position of any particle of the histories
+        float maxX{std::numeric_limits<float>::lowest()};  ///< Largest X position of any particle of the histories
+        float minY{std::numeric_limits<float>::max()};     ///< Smallest Y position of any particle of the histories
+        float maxY{std::numeric_limits<float>::lowest()};  ///< Largest Y position of any particle of the histories
+        std::vector<RecordRange> recordRanges;  ///< Where the histories are in the file, in file order
+    };
+
+    /**
+     * @brief Index of where the histories of a phase space file lie on the X-Y plane.
+     *
+     * Every represented history is given the tile of a SpatialGrid holding its first particle,
+     * pseudo-particles aside, and each tile lists the runs of records of its histories and the
+     * bounding box of all of their particles. A region of interest is read by reading the record
+     * ranges of the tiles whose bounding boxes overlap it (see findRecordRanges()), which are
+     * whole histories since every range starts at the first record of a history. As the bounding
+     * boxes cover every particle of the histories of a tile, no particle in the region is missed
+     * even when the particles of a history are spread over several tiles.
+     *
+     * The histories of a tile are in as many ranges as there are runs of them in the file, so for
+     * a file in simulation order there is about one range per history. Reordering the file by tile
+     * with PHSPSort leaves one range per tile, so that a region of interest is read from a few
+     * contiguous parts of the file and the index stays small.
+     *
+     * An index is built with PhaseSpaceFileReader::buildSpatialIndex() and saved to a sidecar file
+     * next to the phase space file (see GetIndexFileName()), which is ignored by Load() once the
+     * phase space file has changed, as for a HistoryIndex.
+     */
+    class SpatialIndex
+    {
+        public:
+            /**
+             * @brief Construct an index from its contents.
+             *
+             * @param grid The grid the tiles belong to
+             * @param tiles The tiles holding histories, in increasing order of their Morton codes
+             * @throws std::invalid_argument if the grid is invalid or the tiles are not in order
+             */
+            SpatialIndex(const SpatialGrid & grid, std::vector<SpatialTile> tiles);
+
+            /**
+             * @brief Get the path of the spatial index sidecar file for a phase space file.
+             *
+             * @param phspFileName The path to the phase space file
+             * @return std::string The phase space file path with ".pzsidx" appended
+             */
+            static std::string GetIndexFileName(const std::string & phspFileName);
+
+            /**
+             * @brief Load the spatial index sidecar file for a phase space file if there is a valid one.
+             *
+             * @param phspFileName The path to the phase space file
+             * @return std::optional<SpatialIndex> The index, or nothing if the sidecar does not exist, is
+             *         unreadable, or was built for a different version of the phase space file
+             */
+            static std::optional<SpatialIndex> Load(const std::string & phspFileName);
+
+            /**
+             * @brief Save the index to the sidecar file of a phase space file.
+             *
+             * @param phspFileName The path to the phase space file the index was built from
+             * @throws std::runtime_error if the phase space file does not exist or the sidecar cannot be written
+             */
+            void save(const std::string & phspFileName) const;
+
+            /**
+             * @brief Get the grid of the tiles.
+             *
+             * @return const SpatialGrid& The grid
+             */
+            const SpatialGrid & getGrid() const;
+
+            /**
+             * @brief Get the tiles holding histories.
+             *
+             * @return const std::vector<SpatialTile>& The tiles, in increasing order of their Morton codes
+             */
+            const std::vector<SpatialTile> & getTiles() const;
+
+            /**
+             * @brief Get the number of record ranges of all the tiles.
+             *
+             * @return std::uint64_t The number of ranges, the number of tiles for a file sorted by tile
+             */
+            std::uint64_t getNumberOfRecordRanges() const;
+
+            /**
+             * @brief Find the records of the histories that may have particles in a rectangle of the X-Y plane.
+             *
+             * @param minX The smallest X position of the rectangle
+             * @param maxX The largest X position of the rectangle
+             * @param minY The smallest Y position of the rectangle
+             * @param maxY The largest Y position of the rectangle
+             * @return std::vector<RecordRange> The ranges of the tiles whose bounding boxes overlap the rectangle, in file order with adjacent ranges joined
+             */
+            std::vector<RecordRange> findRecordRanges(float minX, float maxX, float minY, float maxY) const;
+
+        private:
+            SpatialGrid grid_;
+            std::vector<SpatialTile> tiles_;
+    };
+
+    // Inline implementations for the SpatialGrid struct
+
+    inline std::uint32_t SpatialGrid::getTilesPerSide() const { return std::uint32_t{1} << level; }
+
+    inline std::uint32_t SpatialGrid::MortonCode(std::uint32_t column, std::uint32_t row) {
+        // Spread the low 16 bits of a value over the even bits
+        auto spread = [](std::uint32_t value) {
+            value &= 0x0000FFFFu;
+            value = (value | (value << 8)) & 0x00FF00FFu;
+            value = (value | (value << 4)) & 0x0F0F0F0Fu;
+            value = (value | (value << 2)) & 0x33333333u;
+            value = (value | (value << 1)) & 0x55555555u;
+            return value;
+        };
+        return spread(column) | (spread(row) << 1);
+    }
+
+    // Inline implementations for the SpatialIndex class
+
+    inline std::string SpatialIndex::GetIndexFileName(const std::string & phspFileName) { return phspFileName + ".pzsidx"; }
+
+    inline const SpatialGrid & SpatialIndex::getGrid() const { return grid_; }
+
+    inline const std::vector<SpatialTile> & SpatialIndex::getTiles() const { return tiles_; }
+
+} // namespace ParticleZoo
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+namespace ParticleZoo
+{
+
+    /**
+     * @brief Get the NUMA nodes of the machine that have CPUs the process may run on.
+     *
+     * Read from /sys/devices/system/node on Linux and from the processor groups on Windows. On
+     * other platforms, or where the topology cannot be read, the machine is one node numbered 0.
+     *
+     * @return std::vector<unsigned int> The node numbers, in increasing order, never empty
+     */
+    std::vector<unsigned int> GetNUMANodes();
+
+    /**
+     * @brief Get the CPUs of a NUMA node that the process may run on.
+     *
+     * @param node The node number, as returned by GetNUMANodes()
+     * @return std::vector<unsigned int> The CPU numbers in increasing order, empty for a node that does not exist
+     */
+    std::vector<unsigned int> GetNUMANodeCPUs(unsigned int node);
+
+    /**
+     * @brief Get the CPUs that the process may run on.
+     *
+     * @return std::vector<unsigned int> The CPU numbers in increasing order, never empty
+     */
+    std::vector<unsigned int> GetAllowedCPUs();
+
+    /**
+     * @brief Restricts the calling thread to a set of CPUs for the lifetime of the object.
+     *
+     * Memory is placed on the NUMA node of the thread that first writes to it under the default
+     * policy of Linux and Windows, so allocating and filling a buffer while the thread is held to
+     * the CPUs of a node places the buffer on that node. The previous affinity of the thread is
+     * restored on destruction unless keep() is called, which leaves the thread pinned.
+     *
+     * Uses sched_setaffinity on Linux and SetThreadGroupAffinity on Windows, where only the CPUs
+     * in the processor group of the first CPU are used. Other platforms cannot pin threads and
+     * the affinity is never applied.
+     */
+    class ScopedThreadAffinity
+    {
+        public:
+            /**
+             * @brief Restrict the calling thread to the given CPUs.
+             *
+             * @param cpus The CPU numbers the thread may run on, none to leave the thread as it is
+             */
+            explicit ScopedThreadAffinity(const std::vector<unsigned int> & cpus);
+
+            /**
+             * @brief Restore the previous affinity of the thread, unless keep() has been called.
+             *
+             * Must be destroyed on the thread that constructed it.
+             */
+            ~ScopedThreadAffinity();
+
+            ScopedThreadAffinity(const ScopedThreadAffinity &) = delete;
+            ScopedThreadAffinity & operator=(const ScopedThreadAffinity &) = delete;
+
+            /**
+             * @brief Check if the thread was restricted to the CPUs.
+             *
+             * @return true if the affinity of the thread was changed
+             * @return false if no CPUs were given, the platform cannot pin threads or the CPUs were rejected
+             */
+            bool isApplied() const;
+
+            /**
+             * @brief Leave the thread restricted to the CPUs once the object is destroyed.
+             */
+            void keep();
+
+        private:
+            std::vector<unsigned int> previousCPUs_;
+            bool applied_;
+            bool kept_;
+    };
+
+    // Inline implementations for the ScopedThreadAffinity class
+
+    inline bool ScopedThreadAffinity::isApplied() const { return applied_; }
+
+    inline void ScopedThreadAffinity::keep() { kept_ = true; }
+
+} // namespace ParticleZoo
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <map>
+#include <utility>
+#include <functional>
+#include <mutex>
+
+#include "particlezoo/ByteBuffer.h"
+#include "particlezoo/ParticleBlock.h"
+
+namespace ParticleZoo
+{
+
+    class PhaseSpaceFileReader;
+    class PhaseSpaceFileWriter;
+
+    /**
+     * @brief Converts the binary particle records of one format directly into those of another.
+     *
+     * A transcoder maps a batch of raw records of the input file to raw records of the output
+     * file without making a Particle object for each of them: it rescales the units, moves the
+     * sign of the w directional cosine between the fields that carry it, maps the particle type
+     * between its encodings (such as the charge bits of an EGS LATCH and an IAEA type code) and
+     * fills in the extra fields the output layout asks for. It is made for a particular reader and
+     * writer by TranscoderRegistry and driven by PhaseSpaceFileWriter::transcodeParticlesFrom(),
+     * which keeps the read and write statistics of both files from the basic properties the
+     * transcoder hands back for every record.
+     */
+    class RecordTranscoder
+    {
+    public:
+        virtual ~RecordTranscoder() = default;
+
+        /**
+         * @brief Transcode a batch of consecutive records.
+         *
+         * Reads up to numberOfRecords records from the start of records and writes one output
+         * record for each of them to the end of output. For every record transcoded the basic
+         * properties of its particle (type, kinetic energy, position, direction, weight, new
+         * history flag and incremental histories) are appended to particles, as they would have
+         * been written by the per-particle path, so that the header statistics of the output
+         * can be kept. The transcoder may stop early at a record it cannot map on its own, such
+         * as one starting a run of empty histories or one of an invalid type, which is then left
+         * to the per-particle path to write or to report. Nothing is written for that record.
+         *
+         * @param records The records to read, starting at the current read position
+         * @param recordLength The length of each input record in bytes
+         * @param numberOfRecords The number of whole records available to transcode
+         * @param output The buffer to write the output records to, with room for all of them
+         * @param particles An empty block to append the basic properties of each particle to
+         * @return std::size_t The number of records transcoded, records is not read past them
+         */
+        virtual std::size_t transcodeRecords(ByteBuffer & records, std::size_t recordLength, std::size_t numberOfRecords, ByteBuffer & output, ParticleBlock & particles) = 0;
+    };
+
+    /**
+     * @brief Singleton registry of the direct record transcoders between pairs of formats.
+     *
+     * Sits next to FormatRegistry: where that one creates the readers and writers of each format,
+     * this one creates a RecordTranscoder for a reader and a writer whose formats have a kernel
+     * converting their records into one another. The pairs are keyed by the names returned by
+     * getPHSPFormat() ("EGS", "IAEA", "TOPAS BINARY", ...). A factory may still decline a pair
+     * whose record layouts it does not handle, in which case the particles are converted one at a
+     * time as before.
+     */
+    class TranscoderRegistry
+    {
+    public:
+        /**
+         * @brief Function type for creating record transcoders.
+         *
+         * @param reader The reader whose records are to be transcoded
+         * @param writer The writer the transcoded records are written to
+         * @return std::unique_ptr<RecordTranscoder> The transcoder, or nullptr if the record layouts are not supported
+         */
+        using TranscoderFactoryFn = std::function<std::unique_ptr<RecordTranscoder>(const PhaseSpaceFileReader& reader, PhaseSpaceFileWriter& writer)>;
+
+        /**
+         * @brief Register a transcoder for a pair of formats.
+         *
+         * @param inputFormat The format name of the reader (see PhaseSpaceFileReader::getPHSPFormat())
+         * @param outputFormat The format name of the writer (see PhaseSpaceFileWriter::getPHSPFormat())
+         * @param factory Factory function for creating transcoders between the two formats
+         * @throws std::invalid_argument if a format name is empty or the factory is not set
+         * @throws std::runtime_error if a transcoder is already registered for the pair
+         */
+        static void RegisterTranscoder(const std::string& inputFormat, const std::string& outputFormat, TranscoderFactoryFn factory);
+
+        /**
+         * @brief Check if a transcoder is registered for a pair of formats.
+         *
+         * @param inputFormat The format name of the reader
+         * @param outputFormat The format name of the writer
+         * @return true if a factory is registered for the pair
+         */
+        static bool HasTranscoder(const std::string& inputFormat, const std::string& outputFormat);
+
+        /**
+         * @brief Create a transcoder for a reader and a writer.
+         *
+         * @param reader The reader whose records are to be transcoded
+         * @param writer The writer the transcoded records are written to
+         * @return std::unique_ptr<RecordTranscoder> The transcoder, or nullptr if there is none for the two formats or their record layouts
+         */
+        static std::unique_ptr<RecordTranscoder> CreateTranscoder(const PhaseSpaceFileReader& reader, PhaseSpaceFileWriter& writer);
+
+        /**
+         * @brief Register the transcoders between the standard built-in formats.
+         *
+         * This method registers kernels for:
+         * - EGS (MODE0 and MODE2) to and from IAEA
+         * - IAEA to and from TOPAS binary
+         *
+         * This method is safe to call multiple times (uses internal flag to prevent duplicate registration).
+         */
+        static void RegisterStandardTranscoders();
+
+    private:
+        /**
+         * @brief Private constructor to enforce singleton pattern.
+         */
+        TranscoderRegistry() = default;
+
+        /**
+         * @brief Get the singleton instance of the TranscoderRegistry.
+         *
+         * @return TranscoderRegistry& Reference to the singleton instance
+         */
+        static TranscoderRegistry& instance();
+
+        std::map<std::pair<std::string, std::string>, TranscoderFactoryFn> factories_;   ///< Map of input and output format names to transcoder factory functions
+        mutable std::mutex mutex_;                                                        ///< Mutex for thread-safe access to registry data
+    };
+
+} // namespace ParticleZoo
@@ -15,8 +15,22 @@ include_dirs = [str(proj / "include")]
 sources = [
     str(Path("..") / "src" / "PhaseSpaceFileReader.cc"),
     str(Path("..") / "src" / "PhaseSpaceFileWriter.cc"),
+    str(Path("..") / "src" / "PhaseSpaceSet.cc"),
+    str(Path("..") / "src" / "HistoryReplayer.cc"),
+    str(Path("..") / "src" / "HistorySampler.cc"),
     str(Path("..") / "src" / "utilities" / "argParse.cc"),
     str(Path("..") / "src" / "utilities" / "formats.cc"),
+    str(Path("..") / "src" / "utilities" / "transcoders.cc"),
+    str(Path("..") / "src" / "utilities" / "memoryMap.cc"),
+    str(Path("..") / "src" / "utilities" / "sharedFileCache.cc"),
+    str(Path("..") / "src" / "utilities" / "prefetch.cc"),
+    str(Path("..") / "src" / "utilities" / "backgroundFlush.cc"),
+    str(Path("..") / "src" / "utilities" / "historyIndex.cc"),
+    str(Path("..") / "src" / "utilities" / "spatialIndex.cc"),
+    str(Path("..") / "src" / "utilities" / "threadAffinity.cc"),
+    str(Path("..") / "src" / "utilities" / "compression.cc"),
+    str(Path("..") / "src" / "utilities" / "inputFileStream.cc"),
+    str(Path("..") / "src" / "utilities" / "outputFileStream.cc"),
     # Formats needed by the registry (non-ROOT)
     str(Path("..") / "src" / "egs" / "egsphspFile.cc"),
     str(Path("..") / "src" / "peneasy" / "penEasyphspFile.cc"),
@@ -24,9 +38,15 @@ sources = [
     str(Path("..") / "src" / "topas" / "TOPASphspFile.cc"),
     str(Path("..") / "src" / "IAEA" / "IAEAHeader.cc"),
     str(Path("..") / "src" / "IAEA" / "IAEAphspFile.cc"),
+    str(Path("..") / "src" / "pz" / "PZphspFile.cc"),
     # Parallel readers
     str(Path("..") / "src" / "parallel" / "HistoryBalancedParallelReader.cc"),
+    str(Path("..") / "src" / "parallel" / "HistoryPartition.cc"),
     str(Path("..") / "src" / "parallel" / "ParticleBalancedParallelReader.cc"),
+    str(Path("..") / "src" / "parallel" / "ChunkedParallelReader.cc"),
+    str(Path("..") / "src" / "parallel" / "ThreadPlacement.cc"),
+    str(Path("..") / "src" / "parallel" / "ConcurrentPhaseSpaceWriter.cc"),
+    str(Path("..") / "src" / "parallel" / "ShardedParallelWriter.cc"),
 ]
 
 define_macros = [("PYBIND11_DETAILED_ERROR_MESSAGES", "1")]
@@ -53,6 +73,13 @@ if config_status.exists():
                 var_name, var_value = match.groups()
                 config_vars[var_name] = var_value.strip()
     
+    # Optional compression libraries for the ParticleZoo native format and compressed files
+    for codec in ("ZSTD", "LZ4", "ZLIB"):
+        if config_vars.get(f"USE_{codec}") == "1":
+            print(f"{codec.lower()} compression enabled (from config.status)")
+            define_macros.append((f"USE_{codec}", "1"))
+            extra_link_args.extend(config_vars.get(f"{codec}_LIBS", "").split())
+
     if config_vars.get("USE_ROOT") == "1":
         use_root = True
         root_cflags = config_vars.get("ROOT_CFLAGS", "").split()
@@ -5,6 +5,7 @@ from ._pz import (
     ParticleType,
     HistoryBalancedParallelReader,
     ParticleBalancedParallelReader,
+    ChunkedParallelReader,
     IntPropertyType,
     FloatPropertyType,
     BoolPropertyType,
@@ -81,6 +82,7 @@ __all__ = [
     "ParticleType",
     "HistoryBalancedParallelReader",
     "ParticleBalancedParallelReader",
+    "ChunkedParallelReader",
     "IntPropertyType",
     "FloatPropertyType",
     "BoolPropertyType",
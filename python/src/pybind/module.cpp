@@ -1,7 +1,15 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
 
 #include "particlezoo/Particle.h"
+#include "particlezoo/ParticleBlock.h"
 #include "particlezoo/PDGParticleCodes.h"
 #include "particlezoo/PhaseSpaceFileReader.h"
 #include "particlezoo/PhaseSpaceFileWriter.h"
@@ -11,12 +19,286 @@
 #include "particlezoo/utilities/version.h"
 #include "particlezoo/parallel/HistoryBalancedParallelReader.h"
 #include "particlezoo/parallel/ParticleBalancedParallelReader.h"
+#include "particlezoo/parallel/ChunkedParallelReader.h"
 #include "particlezoo/egs/EGSLATCH.h"
 #include "particlezoo/penelope/ILBArray.h"
 
 namespace py = pybind11;
 using namespace ParticleZoo;
 
+namespace {
+
+    // Number of particles decoded or encoded at a time by the NumPy column functions
+    constexpr std::size_t COLUMN_BLOCK_SIZE = 65536;
+
+    // Hands a column over to NumPy without copying it, the array keeps the column alive
+    template <typename T>
+    py::array ToNumPyArray(std::vector<T> && column, const py::dtype & dtype) {
+        auto * owned = new std::vector<T>(std::move(column));
+        py::capsule owner(owned, [](void * p) { delete static_cast<std::vector<T>*>(p); });
+        return py::array(dtype, { owned->size() }, { sizeof(T) }, owned->data(), owner);
+    }
+
+    template <typename T>
+    py::array ToNumPyArray(std::vector<T> && column) {
+        return ToNumPyArray(std::move(column), py::dtype::of<T>());
+    }
+
+    template <typename T, typename U>
+    void AppendColumn(std::vector<T> & column, std::span<const U> values) {
+        column.insert(column.end(), values.begin(), values.end());
+    }
+
+    // Appends the values of a property column of a block, or zeros if no particle in the block has the property
+    template <typename T, typename Column>
+    void AppendPropertyColumn(std::vector<T> & column, const Column * blockColumn, std::size_t blockSize) {
+        if (blockColumn) {
+            column.insert(column.end(), blockColumn->values.begin(), blockColumn->values.begin() + blockSize);
+        } else {
+            column.resize(column.size() + blockSize, T{});
+        }
+    }
+
+    // The number of particles left to read according to the file, used to size the columns up front
+    std::size_t RemainingParticles(PhaseSpaceFileReader & reader) {
+        const std::uint64_t numberOfParticles = reader.getNumberOfParticles();
+        const std::uint64_t particlesRead = reader.getParticlesRead(true);
+        return static_cast<std::size_t>(numberOfParticles > particlesRead ? numberOfParticles - particlesRead : 0);
+    }
+
+    template <typename PropertyType>
+    void CheckColumnProperties(const std::vector<PropertyType> & properties) {
+        for (PropertyType property : properties) {
+            if (property == PropertyType::INVALID || property == PropertyType::CUSTOM) {
+                throw py::value_error("Only well defined properties can be used as columns, not INVALID or CUSTOM.");
+            }
+        }
+    }
+
+    // Reads up to maxParticles particles into one NumPy array per field, decoding them in blocks with
+    // the GIL released so that no Python object is created for any particle. Property columns hold 0
+    // (or False) for particles where the property is not set. readBlock(block, n) fills the block with
+    // up to n particles and returns how many it read.
+    template <typename ReadBlock>
+    py::dict ReadParticleColumns(ReadBlock && readBlock, std::uint64_t maxParticles, std::size_t expectedParticles,
+                                 const std::vector<IntPropertyType> & intProperties,
+                                 const std::vector<FloatPropertyType> & floatProperties,
+                                 const std::vector<BoolPropertyType> & boolProperties)
+    {
+        CheckColumnProperties(intProperties);
+        CheckColumnProperties(floatProperties);
+        CheckColumnProperties(boolProperties);
+
+        std::vector<std::int32_t> types;
+        std::vector<float> kineticEnergies, xPositions, yPositions, zPositions, directionsX, directionsY, directionsZ, weights;
+        std::vector<std::uint8_t> isNewHistory;
+        std::vector<std::uint32_t> incrementalHistories;
+        std::vector<std::vector<std::int32_t>> intColumns(intProperties.size());
+        std::vector<std::vector<float>> floatColumns(floatProperties.size());
+        std::vector<std::vector<std::uint8_t>> boolColumns(boolProperties.size());
+
+        {
+            py::gil_scoped_release release;
+
+            for (auto * column : { &kineticEnergies, &xPositions, &yPositions, &zPositions, &directionsX, &directionsY, &directionsZ, &weights }) column->reserve(expectedParticles);
+            types.reserve(expectedParticles);
+            isNewHistory.reserve(expectedParticles);
+            incrementalHistories.reserve(expectedParticles);
+            for (auto & column : intColumns) column.reserve(expectedParticles);
+            for (auto & column : floatColumns) column.reserve(expectedParticles);
+            for (auto & column : boolColumns) column.reserve(expectedParticles);
+
+            ParticleBlock block;
+            std::uint64_t particlesRead = 0;
+            while (particlesRead < maxParticles) {
+                const std::size_t particlesToRead = static_cast<std::size_t>(std::min<std::uint64_t>(COLUMN_BLOCK_SIZE, maxParticles - particlesRead));
+                const std::size_t blockSize = readBlock(block, particlesToRead);
+                if (blockSize == 0) break;
+
+                const ParticleBlock & columns = block;
+                std::span<const ParticleType> blockTypes = columns.getTypes();
+                for (ParticleType type : blockTypes) types.push_back(static_cast<std::int32_t>(type));
+                AppendColumn(kineticEnergies, columns.getKineticEnergies());
+                AppendColumn(xPositions, columns.getXPositions());
+                AppendColumn(yPositions, columns.getYPositions());
+                AppendColumn(zPositions, columns.getZPositions());
+                AppendColumn(directionsX, columns.getDirectionalCosinesX());
+                AppendColumn(directionsY, columns.getDirectionalCosinesY());
+                AppendColumn(directionsZ, columns.getDirectionalCosinesZ());
+                AppendColumn(weights, columns.getWeights());
+                AppendColumn(isNewHistory, columns.getNewHistoryFlags());
+                AppendColumn(incrementalHistories, columns.getIncrementalHistories());
+                for (std::size_t i = 0; i < intProperties.size(); i++) {
+                    AppendPropertyColumn(intColumns[i], columns.hasIntColumn(intProperties[i]) ? &columns.getIntColumn(intProperties[i]) : nullptr, blockSize);
+                }
+                for (std::size_t i = 0; i < floatProperties.size(); i++) {
+                    AppendPropertyColumn(floatColumns[i], columns.hasFloatColumn(floatProperties[i]) ? &columns.getFloatColumn(floatProperties[i]) : nullptr, blockSize);
+                }
+                for (std::size_t i = 0; i < boolProperties.size(); i++) {
+                    AppendPropertyColumn(boolColumns[i], columns.hasBoolColumn(boolProperties[i]) ? &columns.getBoolColumn(boolProperties[i]) : nullptr, blockSize);
+                }
+                particlesRead += blockSize;
+            }
+        }
+
+        const py::dtype boolType = py::dtype::of<bool>();
+        py::dict result;
+        result["type"] = ToNumPyArray(std::move(types));
+        result["kinetic_energy"] = ToNumPyArray(std::move(kineticEnergies));
+        result["x"] = ToNumPyArray(std::move(xPositions));
+        result["y"] = ToNumPyArray(std::move(yPositions));
+        result["z"] = ToNumPyArray(std::move(zPositions));
+        result["px"] = ToNumPyArray(std::move(directionsX));
+        result["py"] = ToNumPyArray(std::move(directionsY));
+        result["pz"] = ToNumPyArray(std::move(directionsZ));
+        result["weight"] = ToNumPyArray(std::move(weights));
+        result["is_new_history"] = ToNumPyArray(std::move(isNewHistory), boolType);
+        result["incremental_histories"] = ToNumPyArray(std::move(incrementalHistories));
+        for (std::size_t i = 0; i < intProperties.size(); i++) {
+            result[py::str(py::cast(intProperties[i]).attr("name"))] = ToNumPyArray(std::move(intColumns[i]));
+        }
+        for (std::size_t i = 0; i < floatProperties.size(); i++) {
+            result[py::str(py::cast(floatProperties[i]).attr("name"))] = ToNumPyArray(std::move(floatColumns[i]));
+        }
+        for (std::size_t i = 0; i < boolProperties.size(); i++) {
+            result[py::str(py::cast(boolProperties[i]).attr("name"))] = ToNumPyArray(std::move(boolColumns[i]), boolType);
+        }
+        return result;
+    }
+
+    // Reads a particle block from the reader of one thread of a parallel reader, one particle at a time
+    template <typename ParallelReader>
+    std::size_t ReadParallelBlock(ParallelReader & reader, std::size_t threadIndex, ParticleBlock & block, std::size_t maxParticles) {
+        block.clear();
+        while (block.size() < maxParticles && reader.hasMoreParticles(threadIndex)) {
+            block.addParticle(reader.getNextParticle(threadIndex));
+        }
+        return block.size();
+    }
+
+    // A column given to write_batch(), converted to a C contiguous array of the type it is stored as
+    template <typename T>
+    py::array_t<T, py::array::c_style | py::array::forcecast> GetColumn(const py::dict & columns, const char * name, std::size_t numberOfParticles) {
+        auto column = py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(py::object(columns[name]));
+        if (!column || column.ndim() != 1 || static_cast<std::size_t>(column.shape(0)) != numberOfParticles) {
+            throw py::value_error(std::string("Column '") + name + "' must be a one dimensional array with one value per particle.");
+        }
+        return column;
+    }
+
+    // Writes the particles held in a dict of NumPy arrays, the same layout as read_batch() returns. The
+    // particle types are taken either from a "type" array of ParticleType values or from a "pdg" array
+    // of PDG codes. The particles are encoded in blocks with the GIL released.
+    void WriteParticleColumns(PhaseSpaceFileWriter & writer, const py::dict & columns,
+                              const std::vector<IntPropertyType> & intProperties,
+                              const std::vector<FloatPropertyType> & floatProperties,
+                              const std::vector<BoolPropertyType> & boolProperties)
+    {
+        CheckColumnProperties(intProperties);
+        CheckColumnProperties(floatProperties);
+        CheckColumnProperties(boolProperties);
+
+        const bool hasPDGCodes = columns.contains("pdg");
+        const char * const typeColumn = hasPDGCodes ? "pdg" : "type";
+        for (const char * name : { typeColumn, "kinetic_energy", "x", "y", "z", "px", "py", "pz" }) {
+            if (!columns.contains(name)) {
+                throw py::value_error(std::string("Missing column '") + name + "'.");
+            }
+        }
+        const std::size_t numberOfParticles = static_cast<std::size_t>(py::len(columns[typeColumn]));
+
+        // The weights, history flags and incremental histories are optional
+        const auto types = GetColumn<std::int32_t>(columns, typeColumn, numberOfParticles);
+        const auto kineticEnergies = GetColumn<float>(columns, "kinetic_energy", numberOfParticles);
+        const auto xPositions = GetColumn<float>(columns, "x", numberOfParticles);
+        const auto yPositions = GetColumn<float>(columns, "y", numberOfParticles);
+        const auto zPositions = GetColumn<float>(columns, "z", numberOfParticles);
+        const auto directionsX = GetColumn<float>(columns, "px", numberOfParticles);
+        const auto directionsY = GetColumn<float>(columns, "py", numberOfParticles);
+        const auto directionsZ = GetColumn<float>(columns, "pz", numberOfParticles);
+        const bool hasWeights = columns.contains("weight");
+        const bool hasNewHistoryFlags = columns.contains("is_new_history");
+        const bool hasIncrementalHistories = columns.contains("incremental_histories");
+        const auto weights = hasWeights ? GetColumn<float>(columns, "weight", numberOfParticles) : py::array_t<float, py::array::c_style | py::array::forcecast>();
+        const auto isNewHistory = hasNewHistoryFlags ? GetColumn<bool>(columns, "is_new_history", numberOfParticles) : py::array_t<bool, py::array::c_style | py::array::forcecast>();
+        const auto incrementalHistories = hasIncrementalHistories ? GetColumn<std::uint32_t>(columns, "incremental_histories", numberOfParticles) : py::array_t<std::uint32_t, py::array::c_style | py::array::forcecast>();
+
+        std::vector<py::array_t<std::int32_t, py::array::c_style | py::array::forcecast>> intColumns;
+        std::vector<py::array_t<float, py::array::c_style | py::array::forcecast>> floatColumns;
+        std::vector<py::array_t<bool, py::array::c_style | py::array::forcecast>> boolColumns;
+        for (IntPropertyType property : intProperties) {
+            intColumns.push_back(GetColumn<std::int32_t>(columns, py::str(py::cast(property).attr("name")).cast<std::string>().c_str(), numberOfParticles));
+        }
+        for (FloatPropertyType property : floatProperties) {
+            floatColumns.push_back(GetColumn<float>(columns, py::str(py::cast(property).attr("name")).cast<std::string>().c_str(), numberOfParticles));
+        }
+        for (BoolPropertyType property : boolProperties) {
+            boolColumns.push_back(GetColumn<bool>(columns, py::str(py::cast(property).attr("name")).cast<std::string>().c_str(), numberOfParticles));
+        }
+
+        py::gil_scoped_release release;
+
+        auto copyInto = [](auto destination, const auto & column, std::size_t first) {
+            std::copy_n(column.data() + first, destination.size(), destination.begin());
+        };
+
+        ParticleBlock block;
+        for (std::size_t first = 0; first < numberOfParticles; first += COLUMN_BLOCK_SIZE) {
+            const std::size_t blockSize = std::min(COLUMN_BLOCK_SIZE, numberOfParticles - first);
+            block.clear();
+            block.resize(blockSize);
+
+            std::span<ParticleType> blockTypes = block.getTypes();
+            for (std::size_t i = 0; i < blockSize; i++) {
+                const std::int32_t type = types.data()[first + i];
+                blockTypes[i] = hasPDGCodes ? getParticleTypeFromPDGID(type) : static_cast<ParticleType>(type);
+            }
+            copyInto(block.getKineticEnergies(), kineticEnergies, first);
+            copyInto(block.getXPositions(), xPositions, first);
+            copyInto(block.getYPositions(), yPositions, first);
+            copyInto(block.getZPositions(), zPositions, first);
+            copyInto(block.getDirectionalCosinesX(), directionsX, first);
+            copyInto(block.getDirectionalCosinesY(), directionsY, first);
+            copyInto(block.getDirectionalCosinesZ(), directionsZ, first);
+            if (hasWeights) {
+                copyInto(block.getWeights(), weights, first);
+            } else {
+                std::ranges::fill(block.getWeights(), 1.0f);
+            }
+            if (hasNewHistoryFlags) {
+                copyInto(block.getNewHistoryFlags(), isNewHistory, first);
+            } else {
+                std::ranges::fill(block.getNewHistoryFlags(), std::uint8_t{1});
+            }
+            std::span<std::uint32_t> blockIncrementalHistories = block.getIncrementalHistories();
+            std::span<const std::uint8_t> blockNewHistoryFlags = std::as_const(block).getNewHistoryFlags();
+            for (std::size_t i = 0; i < blockSize; i++) {
+                const std::uint32_t incremental = hasIncrementalHistories ? incrementalHistories.data()[first + i] : 1;
+                blockIncrementalHistories[i] = blockNewHistoryFlags[i] ? incremental : 0;
+            }
+
+            for (std::size_t c = 0; c < intColumns.size(); c++) {
+                ParticleBlock::IntColumn & column = block.addIntColumn(intProperties[c]);
+                std::copy_n(intColumns[c].data() + first, blockSize, column.values.begin());
+                std::ranges::fill(column.isSet, std::uint8_t{1});
+            }
+            for (std::size_t c = 0; c < floatColumns.size(); c++) {
+                ParticleBlock::FloatColumn & column = block.addFloatColumn(floatProperties[c]);
+                std::copy_n(floatColumns[c].data() + first, blockSize, column.values.begin());
+                std::ranges::fill(column.isSet, std::uint8_t{1});
+            }
+            for (std::size_t c = 0; c < boolColumns.size(); c++) {
+                ParticleBlock::BoolColumn & column = block.addBoolColumn(boolProperties[c]);
+                std::copy_n(boolColumns[c].data() + first, blockSize, column.values.begin());
+                std::ranges::fill(column.isSet, std::uint8_t{1});
+            }
+
+            writer.writeParticleBlock(block);
+        }
+    }
+
+}
+
 PYBIND11_MODULE(_pz, m) {
     m.doc() = "Python bindings for ParticleZoo core and IAEA reader";
 
@@ -294,11 +576,14 @@ PYBIND11_MODULE(_pz, m) {
         .def("reserve_int_properties", &Particle::reserveIntProperties, py::arg("size"),
              "Reserve memory for integer properties.")
         // Custom property getters
-        .def("get_custom_bool_properties", &Particle::getCustomBoolProperties,
+        .def("get_custom_bool_properties",
+             [](const Particle &p) { auto v = p.getCustomBoolProperties(); return std::vector<bool>(v.begin(), v.end()); },
              "Get a list of all custom boolean properties.")
-        .def("get_custom_float_properties", &Particle::getCustomFloatProperties,
+        .def("get_custom_float_properties",
+             [](const Particle &p) { auto v = p.getCustomFloatProperties(); return std::vector<float>(v.begin(), v.end()); },
              "Get a list of all custom float properties.")
-        .def("get_custom_int_properties", &Particle::getCustomIntProperties,
+        .def("get_custom_int_properties",
+             [](const Particle &p) { auto v = p.getCustomIntProperties(); return std::vector<std::int32_t>(v.begin(), v.end()); },
              "Get a list of all custom integer properties.")
         .def("get_custom_string_properties", &Particle::getCustomStringProperties,
              "Get a list of all custom string properties.")
@@ -368,6 +653,12 @@ PYBIND11_MODULE(_pz, m) {
              "Get the phase space file format identifier (e.g., 'IAEA', 'EGS', 'TOPAS').")
         .def("move_to_particle", &PhaseSpaceFileReader::moveToParticle, py::arg("index"),
              "Move the file position to a specific particle index (0-based). Useful for random access.")
+        .def("move_to_history", py::overload_cast<std::uint64_t>(&PhaseSpaceFileReader::moveToHistory), py::arg("history"),
+             "Move the file position to the first particle of a specific represented history (0-based). Uses the history index sidecar file if one exists.")
+        .def("build_history_index", [](PhaseSpaceFileReader &self, std::uint64_t stride) {
+            self.buildHistoryIndex(stride).save(self.getFileName());
+        }, py::arg("stride") = HistoryIndex::DEFAULT_STRIDE,
+             "Scan the whole file and save a history index sidecar file next to it, used by move_to_history() and the parallel readers. The reader is left at the end of the file.")
         .def("is_x_constant", &PhaseSpaceFileReader::isXConstant,
              "Check if X coordinate is constant for all particles.")
         .def("is_y_constant", &PhaseSpaceFileReader::isYConstant,
@@ -396,6 +687,18 @@ PYBIND11_MODULE(_pz, m) {
              "Get the constant Z directional cosine value (when is_pz_constant returns True).")
         .def("get_constant_weight", &PhaseSpaceFileReader::getConstantWeight,
              "Get the constant statistical weight value (when is_weight_constant returns True).")
+        .def("read_batch", [](PhaseSpaceFileReader &self, std::size_t n, const std::vector<IntPropertyType>& intProperties, const std::vector<FloatPropertyType>& floatProperties, const std::vector<BoolPropertyType>& boolProperties) {
+            auto readBlock = [&self](ParticleBlock & block, std::size_t maxParticles) { return self.readParticleBlock(block, maxParticles); };
+            return ReadParticleColumns(readBlock, n, std::min(n, RemainingParticles(self)), intProperties, floatProperties, boolProperties);
+        }, py::arg("n"), py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Read up to n particles into a dict of NumPy arrays, one per field: type (PDG code), kinetic_energy, x, y, z, px, py, pz, weight, is_new_history and incremental_histories. "
+             "Each requested property adds an array named after it, holding 0 (or False) where the property is not set. "
+             "The particles are decoded without creating a Python object for each one. Fewer than n are returned at the end of the file.")
+        .def("read_all", [](PhaseSpaceFileReader &self, const std::vector<IntPropertyType>& intProperties, const std::vector<FloatPropertyType>& floatProperties, const std::vector<BoolPropertyType>& boolProperties) {
+            auto readBlock = [&self](ParticleBlock & block, std::size_t maxParticles) { return self.readParticleBlock(block, maxParticles); };
+            return ReadParticleColumns(readBlock, std::numeric_limits<std::uint64_t>::max(), RemainingParticles(self), intProperties, floatProperties, boolProperties);
+        }, py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Read all of the remaining particles into a dict of NumPy arrays, with the same columns as read_batch().")
         .def("close", &PhaseSpaceFileReader::close,
              "Close the phase space file and release associated resources.")
         .def("__iter__", [](PhaseSpaceFileReader &self) -> PhaseSpaceFileReader& { return self; }, py::return_value_policy::reference_internal,
@@ -411,8 +714,15 @@ PYBIND11_MODULE(_pz, m) {
         "Writer for phase space files to various Monte Carlo simulation formats (EGS, IAEA, TOPAS, etc.). "
         "Provides unified interface for writing particle data to different file formats. "
         "Create using create_writer() or create_writer_for_format() factory functions.")
-        .def("write_particle", &PhaseSpaceFileWriter::writeParticle, py::arg("particle"),
+        .def("write_particle", py::overload_cast<const Particle &>(&PhaseSpaceFileWriter::writeParticle), py::arg("particle"),
              "Write a particle to the phase space file. Automatically buffers and applies constant values.")
+        .def("write_batch", &WriteParticleColumns,
+             py::arg("arrays"), py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Write the particles held in a dict of NumPy arrays, laid out as returned by PhaseSpaceFileReader.read_batch(). "
+             "The type (ParticleType values, or a pdg array of PDG codes instead), kinetic_energy, x, y, z, px, py and pz "
+             "arrays are required. The weight (default 1), "
+             "is_new_history (default True) and incremental_histories (default 1) arrays are optional, and each requested "
+             "property is taken from the array named after it. The particles are written without creating a Python object for each one.")
         .def("get_particles_written", &PhaseSpaceFileWriter::getParticlesWritten,
              "Get the number of particles written to the file (excludes pseudo-particles).")
         .def("get_histories_written", &PhaseSpaceFileWriter::getHistoriesWritten,
@@ -506,14 +816,26 @@ PYBIND11_MODULE(_pz, m) {
              "Create a history-balanced parallel reader. "
              "Partitions represented histories evenly across the specified number of threads.")
         .def("peek_next_particle", &HistoryBalancedParallelReader::peekNextParticle,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Peek at the next particle for a thread without consuming it.")
         .def("get_next_particle", &HistoryBalancedParallelReader::getNextParticle,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Read and return the next particle for a thread.")
         .def("has_more_particles", &HistoryBalancedParallelReader::hasMoreParticles,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Check if more particles are available for a thread.")
+        .def("read_batch", [](HistoryBalancedParallelReader & self, std::size_t threadIndex, std::uint64_t n,
+                              const std::vector<IntPropertyType> & intProperties,
+                              const std::vector<FloatPropertyType> & floatProperties,
+                              const std::vector<BoolPropertyType> & boolProperties) {
+            if (threadIndex >= self.getNumberOfThreads()) {
+                throw py::index_error("Thread index out of range in read_batch()");
+            }
+            auto readBlock = [&self, threadIndex](ParticleBlock & block, std::size_t maxParticles) { return ReadParallelBlock(self, threadIndex, block, maxParticles); };
+            return ReadParticleColumns(readBlock, n, static_cast<std::size_t>(std::min<std::uint64_t>(n, COLUMN_BLOCK_SIZE)), intProperties, floatProperties, boolProperties);
+        }, py::arg("thread_index"), py::arg("n"), py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Read up to n of the particles of a thread into a dict of NumPy arrays, as PhaseSpaceFileReader.read_batch(). "
+             "The GIL is released while the particles are read, so each Python thread can drain its own thread index in parallel.")
         .def("get_histories_read", &HistoryBalancedParallelReader::getHistoriesRead,
              py::arg("thread_index"),
              "Get the number of original histories processed by a thread (including empty ones).")
@@ -543,14 +865,26 @@ PYBIND11_MODULE(_pz, m) {
              "Create a particle-balanced parallel reader. "
              "Partitions particles evenly across the specified number of threads.")
         .def("peek_next_particle", &ParticleBalancedParallelReader::peekNextParticle,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Peek at the next particle for a thread without consuming it.")
         .def("get_next_particle", &ParticleBalancedParallelReader::getNextParticle,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Read and return the next particle for a thread.")
         .def("has_more_particles", &ParticleBalancedParallelReader::hasMoreParticles,
-             py::arg("thread_index"),
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
              "Check if more particles are available for a thread.")
+        .def("read_batch", [](ParticleBalancedParallelReader & self, std::size_t threadIndex, std::uint64_t n,
+                              const std::vector<IntPropertyType> & intProperties,
+                              const std::vector<FloatPropertyType> & floatProperties,
+                              const std::vector<BoolPropertyType> & boolProperties) {
+            if (threadIndex >= self.getNumberOfThreads()) {
+                throw py::index_error("Thread index out of range in read_batch()");
+            }
+            auto readBlock = [&self, threadIndex](ParticleBlock & block, std::size_t maxParticles) { return ReadParallelBlock(self, threadIndex, block, maxParticles); };
+            return ReadParticleColumns(readBlock, n, static_cast<std::size_t>(std::min<std::uint64_t>(n, COLUMN_BLOCK_SIZE)), intProperties, floatProperties, boolProperties);
+        }, py::arg("thread_index"), py::arg("n"), py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Read up to n of the particles of a thread into a dict of NumPy arrays, as PhaseSpaceFileReader.read_batch(). "
+             "The GIL is released while the particles are read, so each Python thread can drain its own thread index in parallel.")
         .def("get_particles_read", &ParticleBalancedParallelReader::getParticlesRead,
              py::arg("thread_index"),
              "Get the number of particles processed by a thread.")
@@ -571,6 +905,62 @@ PYBIND11_MODULE(_pz, m) {
              "Close all underlying readers and release resources.")
         ;
 
+    py::class_<ChunkedParallelReader>(m, "ChunkedParallelReader",
+        "Multi-threaded phase space file reader that balances work dynamically. "
+        "The file is split into chunks of consecutive histories and each thread claims the next unread chunk "
+        "whenever it finishes its current one, so threads that process histories quickly read more of the file.")
+        .def(py::init<const std::string&, const UserOptions&, size_t, std::uint64_t>(),
+             py::arg("filename"), py::arg("options") = UserOptions{}, py::arg("num_threads") = 1,
+             py::arg("histories_per_chunk") = ChunkedParallelReader::DEFAULT_HISTORIES_PER_CHUNK,
+             "Create a chunked parallel reader. "
+             "Threads claim histories_per_chunk represented histories at a time.")
+        .def("peek_next_particle", &ChunkedParallelReader::peekNextParticle,
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
+             "Peek at the next particle for a thread without consuming it.")
+        .def("get_next_particle", &ChunkedParallelReader::getNextParticle,
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
+             "Read and return the next particle for a thread.")
+        .def("has_more_particles", &ChunkedParallelReader::hasMoreParticles,
+             py::arg("thread_index"), py::call_guard<py::gil_scoped_release>(),
+             "Check if more particles are available for a thread, claiming another chunk if needed.")
+        .def("read_batch", [](ChunkedParallelReader & self, std::size_t threadIndex, std::uint64_t n,
+                              const std::vector<IntPropertyType> & intProperties,
+                              const std::vector<FloatPropertyType> & floatProperties,
+                              const std::vector<BoolPropertyType> & boolProperties) {
+            if (threadIndex >= self.getNumberOfThreads()) {
+                throw py::index_error("Thread index out of range in read_batch()");
+            }
+            auto readBlock = [&self, threadIndex](ParticleBlock & block, std::size_t maxParticles) { return ReadParallelBlock(self, threadIndex, block, maxParticles); };
+            return ReadParticleColumns(readBlock, n, static_cast<std::size_t>(std::min<std::uint64_t>(n, COLUMN_BLOCK_SIZE)), intProperties, floatProperties, boolProperties);
+        }, py::arg("thread_index"), py::arg("n"), py::arg("int_properties") = std::vector<IntPropertyType>{}, py::arg("float_properties") = std::vector<FloatPropertyType>{}, py::arg("bool_properties") = std::vector<BoolPropertyType>{},
+             "Read up to n of the particles of a thread into a dict of NumPy arrays, as PhaseSpaceFileReader.read_batch(). "
+             "The GIL is released while the particles are read, so each Python thread can drain its own thread index in parallel.")
+        .def("get_histories_read", &ChunkedParallelReader::getHistoriesRead,
+             py::arg("thread_index"),
+             "Get the number of original histories processed by a thread (including empty ones).")
+        .def("get_particles_read", &ChunkedParallelReader::getParticlesRead,
+             py::arg("thread_index"),
+             "Get the number of particles processed by a thread.")
+        .def("get_total_particles_read", &ChunkedParallelReader::getTotalParticlesRead,
+             "Get the total number of particles read across all threads.")
+        .def("get_total_histories_read", &ChunkedParallelReader::getTotalHistoriesRead,
+             "Get the total number of original histories read across all threads.")
+        .def("get_number_of_particles", &ChunkedParallelReader::getNumberOfParticles,
+             "Get the total number of particles in the phase space file.")
+        .def("get_number_of_original_histories", &ChunkedParallelReader::getNumberOfOriginalHistories,
+             "Get the number of original histories in the file (including empty ones).")
+        .def("get_number_of_represented_histories", &ChunkedParallelReader::getNumberOfRepresentedHistories,
+             "Get the number of histories that produced at least one particle.")
+        .def("get_number_of_threads", &ChunkedParallelReader::getNumberOfThreads,
+             "Get the number of threads used by this reader.")
+        .def("get_histories_per_chunk", &ChunkedParallelReader::getHistoriesPerChunk,
+             "Get the number of represented histories in each chunk.")
+        .def("get_number_of_chunks", &ChunkedParallelReader::getNumberOfChunks,
+             "Get the number of chunks the file is split into.")
+        .def("close", &ChunkedParallelReader::close,
+             "Close all underlying readers and release resources.")
+        ;
+
     // Expose a simple alias to create a Particle by PDG code
     m.def("particle_from_pdg", [](int pdg, float kineticEnergy, float x, float y, float z, float px, float py, float pz, bool isNewHistory, float weight){
         ParticleType t = getParticleTypeFromPDGID(static_cast<std::int32_t>(pdg));
@@ -0,0 +1,165 @@
+#include "particlezoo/HistoryReplayer.h"
+
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+namespace ParticleZoo
+{
+
+    namespace {
+
+        // SplitMix64, which gives the same sequence on every platform unlike the distributions of <random>
+        std::uint64_t NextRandom(std::uint64_t & state) {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0,1) from the top 53 bits
+        double NextUniform(std::uint64_t & state) {
+            return static_cast<double>(NextRandom(state) >> 11) * 0x1.0p-53;
+        }
+
+        // Starting state of the sequence of a thread, scrambled so that nearby seeds and threads give unrelated sequences
+        std::uint64_t SeedState(std::uint64_t seed, std::size_t threadIndex) {
+            std::uint64_t state = seed;
+            std::uint64_t threadState = static_cast<std::uint64_t>(threadIndex);
+            return NextRandom(state) ^ NextRandom(threadState);
+        }
+
+    }
+
+    HistoryReplayer::HistoryReplayer(ParticleSource source, std::uint32_t copies, std::uint64_t seed, std::size_t threadIndex)
+    :   source_(std::move(source)),
+        copies_(copies),
+        randomState_(SeedState(seed, threadIndex)),
+        rotate_(false),
+        centerX_(0),
+        centerY_(0),
+        divideWeights_(true),
+        batch_(PARTICLES_PER_BATCH),
+        batchPosition_(0),
+        batchSize_(0),
+        sourceExhausted_(false),
+        copy_(copies),
+        positionInHistory_(0),
+        historyAngleOffset_(0),
+        cosine_(1),
+        sine_(0),
+        particlesRead_(0),
+        historiesRead_(0)
+    {
+        if (copies_ == 0) {
+            throw std::invalid_argument("The number of copies of each history must be at least 1.");
+        }
+        if (!source_) {
+            throw std::invalid_argument("A history replayer needs a source of particles.");
+        }
+    }
+
+    HistoryReplayer::HistoryReplayer(PhaseSpaceFileReader & reader, std::uint32_t copies, std::uint64_t seed, std::size_t threadIndex)
+    :   HistoryReplayer([&reader](std::span<Particle> particles) { return reader.readParticles(particles); }, copies, seed, threadIndex)
+    {}
+
+    bool HistoryReplayer::hasMoreParticles() {
+        while (positionInHistory_ >= history_.size()) {
+            if (copy_ + 1 < copies_) {
+                copy_++;
+            } else if (loadNextHistory()) {
+                copy_ = 0;
+            } else {
+                return false;
+            }
+            startCopy();
+        }
+        return true;
+    }
+
+    Particle HistoryReplayer::getNextParticle() {
+        if (!hasMoreParticles()) {
+            throw std::runtime_error("No more particles to read in the history replayer.");
+        }
+        return emitParticle();
+    }
+
+    std::size_t HistoryReplayer::readParticles(std::span<Particle> particles) {
+        std::size_t particlesRead = 0;
+        while (particlesRead < particles.size() && hasMoreParticles()) {
+            particles[particlesRead++] = emitParticle();
+        }
+        return particlesRead;
+    }
+
+    bool HistoryReplayer::loadNextHistory() {
+        // A history runs up to the next particle starting a new one, which may be in a later batch
+        history_.clear();
+        for (;;) {
+            if (batchPosition_ == batchSize_) {
+                if (sourceExhausted_) break;
+                batchSize_ = source_(std::span<Particle>(batch_));
+                batchPosition_ = 0;
+                if (batchSize_ == 0) {
+                    sourceExhausted_ = true;
+                    break;
+                }
+            }
+            if (!history_.empty() && batch_[batchPosition_].isNewHistory()) break;
+            history_.push_back(std::move(batch_[batchPosition_++]));
+        }
+        if (history_.empty()) return false;
+
+        historyAngleOffset_ = NextUniform(randomState_);
+        return true;
+    }
+
+    void HistoryReplayer::startCopy() {
+        positionInHistory_ = 0;
+        if (rotate_) {
+            const double angle = 2. * std::numbers::pi * (historyAngleOffset_ + copy_) / copies_;
+            cosine_ = std::cos(angle);
+            sine_ = std::sin(angle);
+        }
+    }
+
+    Particle HistoryReplayer::emitParticle() {
+        Particle particle = history_[positionInHistory_];
+
+        if (rotate_) {
+            const double x = particle.getX() - centerX_;
+            const double y = particle.getY() - centerY_;
+            const double u = particle.getDirectionalCosineX();
+            const double v = particle.getDirectionalCosineY();
+            particle.setX(static_cast<float>(centerX_ + x * cosine_ - y * sine_));
+            particle.setY(static_cast<float>(centerY_ + x * sine_ + y * cosine_));
+            particle.setDirectionalCosineX(static_cast<float>(u * cosine_ - v * sine_));
+            particle.setDirectionalCosineY(static_cast<float>(u * sine_ + v * cosine_));
+        }
+
+        if (divideWeights_) {
+            particle.setWeight(particle.getWeight() / static_cast<float>(copies_));
+            if (positionInHistory_ == 0 && copy_ > 0) {
+                // The copies after the first continue the history of the original
+                particle.setNewHistory(false);
+                if (particle.hasIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER)) particle.setIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER, 0);
+            }
+        } else if (positionInHistory_ == 0) {
+            if (copy_ == 0) {
+                // Each empty history before the original stands for as many histories as the original does
+                if (particle.isNewHistory() && copies_ > 1) {
+                    particle.setIncrementalHistories((particle.getIncrementalHistories() - 1) * copies_ + 1);
+                }
+            } else {
+                particle.setIncrementalHistories(1);
+            }
+        }
+
+        positionInHistory_++;
+        particlesRead_++;
+        historiesRead_ += particle.getIncrementalHistories();
+        return particle;
+    }
+
+} // namespace ParticleZoo
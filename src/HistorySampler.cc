@@ -0,0 +1,186 @@
+#include "particlezoo/HistorySampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace ParticleZoo
+{
+
+    namespace {
+
+        HistoryIndex LoadOrBuildHistoryIndex(PhaseSpaceFileReader & reader) {
+            if (!reader.supportsRandomAccess()) {
+                throw std::runtime_error("Histories can only be sampled from files that can be read in any order, which " + reader.getFileName() + " cannot.");
+            }
+            if (std::optional<HistoryIndex> index = HistoryIndex::Load(reader.getFileName())) {
+                return std::move(*index);
+            }
+            return reader.buildHistoryIndex();
+        }
+
+        std::uint64_t GetSampledHistories(double sampleSize, std::uint64_t representedHistories) {
+            if (!(sampleSize > 0)) {
+                throw std::invalid_argument("The number or fraction of histories to sample must be positive.");
+            }
+            if (sampleSize < 1) {
+                // Any sample of a file with histories holds at least one of them
+                const std::uint64_t sampledHistories = static_cast<std::uint64_t>(std::llround(sampleSize * static_cast<double>(representedHistories)));
+                return std::min(representedHistories, std::max<std::uint64_t>(sampledHistories, 1));
+            }
+            if (sampleSize >= static_cast<double>(representedHistories)) return representedHistories;
+            return static_cast<std::uint64_t>(sampleSize);
+        }
+
+    }
+
+    HistorySampler::HistorySampler(PhaseSpaceFileReader & reader, double sampleSize, HistorySampling sampling, std::uint64_t seed)
+    :   reader_(reader),
+        index_(LoadOrBuildHistoryIndex(reader)),
+        sampling_(sampling),
+        random_(seed),
+        representedHistories_(index_.getNumberOfRepresentedHistories()),
+        sampledHistories_(GetSampledHistories(sampleSize, representedHistories_)),
+        originalHistories_(std::max(reader.getNumberOfOriginalHistories(), representedHistories_)),
+        selectingComplement_(false),
+        selectedPosition_(0),
+        nextCandidate_(0),
+        readerHistory_(0),
+        readerPositioned_(false),
+        carriedHistories_(0),
+        positionInHistory_(0),
+        historiesSampled_(0),
+        particlesRead_(0),
+        historiesRead_(0)
+    {
+        if (sampling_ == HistorySampling::UNIFORM) {
+            // Floyd's algorithm draws every subset of the same size with the same probability, drawing
+            // the histories left out instead when they are fewer
+            selectingComplement_ = sampledHistories_ > representedHistories_ / 2;
+            const std::uint64_t historiesToSelect = selectingComplement_ ? representedHistories_ - sampledHistories_ : sampledHistories_;
+            std::unordered_set<std::uint64_t> selected;
+            selected.reserve(static_cast<std::size_t>(historiesToSelect));
+            for (std::uint64_t j = representedHistories_ - historiesToSelect; j < representedHistories_; j++) {
+                if (!selected.insert(randomBelow(j + 1)).second) selected.insert(j);
+            }
+            selectedHistories_.assign(selected.begin(), selected.end());
+            std::sort(selectedHistories_.begin(), selectedHistories_.end());
+        }
+    }
+
+    bool HistorySampler::hasMoreParticles() {
+        return positionInHistory_ < history_.size() || readNextSampledHistory();
+    }
+
+    Particle HistorySampler::getNextParticle() {
+        if (!hasMoreParticles()) {
+            throw std::runtime_error("No more particles to read in the history sampler.");
+        }
+        const Particle & particle = history_[positionInHistory_++];
+        particlesRead_++;
+        historiesRead_ += particle.getIncrementalHistories();
+        return particle;
+    }
+
+    std::size_t HistorySampler::readParticles(std::span<Particle> particles) {
+        std::size_t particlesRead = 0;
+        while (particlesRead < particles.size() && hasMoreParticles()) {
+            particles[particlesRead++] = getNextParticle();
+        }
+        return particlesRead;
+    }
+
+    std::uint64_t HistorySampler::randomBelow(std::uint64_t bound) {
+        // Reject the lowest draws that would make the remainders uneven
+        const std::uint64_t threshold = (0 - bound) % bound;
+        for (;;) {
+            const std::uint64_t draw = random_();
+            if (draw >= threshold) return draw % bound;
+        }
+    }
+
+    std::uint64_t HistorySampler::nextSampledHistory() {
+        if (historiesSampled_ >= sampledHistories_) return representedHistories_;
+
+        if (sampling_ == HistorySampling::STRATIFIED) {
+            // The i-th stratum runs from floor(i N / k) up to floor((i + 1) N / k)
+            const std::uint64_t quotient = representedHistories_ / sampledHistories_;
+            const std::uint64_t remainder = representedHistories_ % sampledHistories_;
+            auto stratumStart = [&](std::uint64_t stratum) { return stratum * quotient + stratum * remainder / sampledHistories_; };
+            const std::uint64_t start = stratumStart(historiesSampled_);
+            return start + randomBelow(stratumStart(historiesSampled_ + 1) - start);
+        }
+
+        if (!selectingComplement_) {
+            return selectedHistories_[selectedPosition_++];
+        }
+        std::uint64_t candidate = nextCandidate_;
+        while (selectedPosition_ < selectedHistories_.size() && selectedHistories_[selectedPosition_] == candidate) {
+            candidate++;
+            selectedPosition_++;
+        }
+        nextCandidate_ = candidate + 1;
+        return candidate;
+    }
+
+    std::uint64_t HistorySampler::originalHistoriesUpTo(std::uint64_t sampledHistories) const {
+        // i M / N for the original histories M of the N represented histories, in integers to stay exact for large files
+        if (representedHistories_ == 0) return 0;
+        const std::uint64_t quotient = originalHistories_ / representedHistories_;
+        const std::uint64_t remainder = originalHistories_ % representedHistories_;
+        return sampledHistories * quotient + static_cast<std::uint64_t>(std::llround(static_cast<long double>(sampledHistories) * remainder / representedHistories_));
+    }
+
+    void HistorySampler::readHistory(std::vector<Particle> * particles) {
+        if (!nextParticle_) {
+            if (!reader_.hasMoreParticles()) return;
+            nextParticle_ = reader_.getNextParticle();
+        }
+        if (particles) particles->push_back(std::move(*nextParticle_));
+        nextParticle_.reset();
+        while (reader_.hasMoreParticles()) {
+            Particle particle = reader_.getNextParticle();
+            if (particle.isNewHistory()) {
+                nextParticle_ = std::move(particle);
+                break;
+            }
+            if (particles) particles->push_back(std::move(particle));
+        }
+    }
+
+    bool HistorySampler::readNextSampledHistory() {
+        for (;;) {
+            const std::uint64_t historyNumber = nextSampledHistory();
+            if (historyNumber >= representedHistories_) return false;
+            historiesSampled_++;
+
+            // Jump to the history unless it is closer to read up to than the index entry before it
+            if (!readerPositioned_ || index_.findClosestHistory(historyNumber).first > readerHistory_) {
+                reader_.moveToHistory(historyNumber, index_);
+                nextParticle_.reset();
+            } else {
+                for (; readerHistory_ < historyNumber; readerHistory_++) readHistory(nullptr);
+            }
+            history_.clear();
+            positionInHistory_ = 0;
+            readHistory(&history_);
+            readerHistory_ = historyNumber + 1;
+            readerPositioned_ = true;
+
+            // The history stands for its share of the original histories of the file
+            std::uint64_t incrementalHistories = originalHistoriesUpTo(historiesSampled_) - originalHistoriesUpTo(historiesSampled_ - 1) + carriedHistories_;
+            std::erase_if(history_, [](const Particle & particle) { return particle.getType() == ParticleType::PseudoParticle; });
+            if (history_.empty()) {
+                carriedHistories_ = incrementalHistories;
+                continue;
+            }
+            carriedHistories_ = 0;
+            history_.front().setIncrementalHistories(static_cast<std::uint32_t>(std::min<std::uint64_t>(incrementalHistories, std::numeric_limits<std::uint32_t>::max())));
+            return true;
+        }
+    }
+
+} // namespace ParticleZoo
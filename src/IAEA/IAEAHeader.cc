@@ -6,6 +6,8 @@
 #include <stdexcept>
 #include <iomanip>
 
+#include "particlezoo/utilities/inputFileStream.h"
+
 namespace ParticleZoo::IAEAphspFile
 {
 
@@ -88,7 +90,9 @@ namespace ParticleZoo::IAEAphspFile
     const std::string IAEAHeader::DeterminePathToHeaderFile(const std::string & filename)
     {
         // The header file is the same as the data file, but with the extension changed to .IAEAheader
-        std::string headerFileName = filename.substr(0, filename.find_last_of('.')) + ".IAEAheader";
+        // (a compressed data file such as beam.IAEAphsp.gz has its header stored as beam.IAEAheader)
+        const std::string dataFileName = StripCompressionSuffix(filename);
+        std::string headerFileName = dataFileName.substr(0, dataFileName.find_last_of('.')) + ".IAEAheader";
         return headerFileName;
     }
 
@@ -120,14 +124,6 @@ namespace ParticleZoo::IAEAphspFile
 
     bool IAEAHeader::checksumIsValid() const
     {
-        unsigned int minimumRecordLength = calculateMinimumRecordLength();
-
-        std::size_t recordLength = getRecordLength();
-        std::uint64_t numberOfParticles = getNumberOfParticles();
-
-        std::uint64_t expectedChecksum = recordLength * numberOfParticles;
-        std::uint64_t checksum = getChecksum();
-
         // get the file size in bytes
         std::string dataFilePath = getDataFilePath();
         std::ifstream check_file(dataFilePath, std::ios::binary | std::ios::ate);
@@ -142,6 +138,19 @@ namespace ParticleZoo::IAEAphspFile
             throw std::runtime_error("Failed to open file for checksum validation: " + dataFilePath);
         }
 
+        return checksumIsValid(fileSize);
+    }
+
+    bool IAEAHeader::checksumIsValid(std::uint64_t fileSize) const
+    {
+        unsigned int minimumRecordLength = calculateMinimumRecordLength();
+
+        std::size_t recordLength = getRecordLength();
+        std::uint64_t numberOfParticles = getNumberOfParticles();
+
+        std::uint64_t expectedChecksum = recordLength * numberOfParticles;
+        std::uint64_t checksum = getChecksum();
+
         bool checksumEqualsFileSize = (checksum == fileSize);
         bool recordLengthValid = (recordLength >= minimumRecordLength);
         bool expectedChecksumValue = (expectedChecksum == checksum);
@@ -1,8 +1,6 @@
 
 #include "particlezoo/IAEA/IAEAphspFile.h"
 
-#include <filesystem>
-
 #include "particlezoo/penelope/ILBArray.h"
 
 namespace ParticleZoo::IAEAphspFile
@@ -29,18 +27,19 @@ namespace ParticleZoo::IAEAphspFile
 
     // Implementations for the IAEAphspFileReader class
 
-    const IAEAHeader initializeHeader(const UserOptions & options, const std::string & filename) {
-        IAEAHeader header_ = IAEAHeader(IAEAHeader::DeterminePathToHeaderFile(filename));
-        std::string phspPath = header_.getDataFilePath();
+    const IAEAHeader initializeHeader(const UserOptions & options, const std::string & filename, std::uint64_t fileSize) {
+        IAEAHeader header_ = IAEAHeader(IAEAHeader::DeterminePathToHeaderFile(PhaseSpaceFileReader::getHeaderFileSource(filename, options)));
+        if (IsStandardStream(filename)) {
+            return header_; // the size of standard input is not known before it is read, so the checksum cannot be checked
+        }
         bool ignoreChecksum = options.contains(IAEAIgnoreChecksumCommand);
-        if (!header_.checksumIsValid()) {
+        if (!header_.checksumIsValid(fileSize)) { // the size given by the reader, decompressed if the file is compressed
             if (ignoreChecksum) {
                 // try to do some repair on these values
                 std::uint64_t checksum = header_.getChecksum();
                 std::uint64_t particleCount = header_.getNumberOfParticles();
 
                 const std::size_t   recordLength = header_.getRecordLength();
-                const std::size_t   fileSize = static_cast<std::size_t>(std::filesystem::file_size(phspPath));
 
                 // Check that the checksum matches the file size, if not update it
                 if (checksum != fileSize) {
@@ -61,7 +60,7 @@ namespace ParticleZoo::IAEAphspFile
     }
 
     Reader::Reader(const std::string & filename, const UserOptions & options)
-        : PhaseSpaceFileReader("IAEA", filename, options), header_(initializeHeader(options, filename)), EGSlatchOption_(EGSphspFile::EGSLATCHOPTION::LATCH_OPTION_2)
+        : PhaseSpaceFileReader("IAEA", filename, options), header_(initializeHeader(options, filename, getFileSize())), EGSlatchOption_(EGSphspFile::EGSLATCHOPTION::LATCH_OPTION_2), plan_(compileRecordPlan(header_))
     {
         if (!header_.xIsStored()) setConstantX(header_.getConstantX());
         if (!header_.yIsStored()) setConstantY(header_.getConstantY());
@@ -93,7 +92,150 @@ namespace ParticleZoo::IAEAphspFile
         return { IAEAIgnoreChecksumCommand, EGSphspFile::EGSLATCHOptionCommand };
     }
 
+    std::unique_ptr<PhaseSpaceFileReader> Reader::clone() const {
+        return std::unique_ptr<PhaseSpaceFileReader>(new Reader(*this));
+    }
+
+    namespace {
+
+        void ApplyILB1(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION) { Penelope::ApplyILB1ToParticle(particle, value); }
+        void ApplyILB2(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION) { Penelope::ApplyILB2ToParticle(particle, value); }
+        void ApplyILB3(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION) { Penelope::ApplyILB3ToParticle(particle, value); }
+        void ApplyILB4(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION) { Penelope::ApplyILB4ToParticle(particle, value); }
+        void ApplyILB5(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION) { Penelope::ApplyILB5ToParticle(particle, value); }
+
+        void ApplyLATCH(Particle & particle, std::int32_t value, IntPropertyType, EGSphspFile::EGSLATCHOPTION latchOption) {
+            EGSphspFile::ApplyLATCHToParticle(particle, value, latchOption);
+        }
+
+        void ApplyIncrementalHistoryNumber(Particle & particle, std::int32_t value, IntPropertyType type, EGSphspFile::EGSLATCHOPTION) {
+            if (value > 0 && !particle.isNewHistory()) {
+                particle.setNewHistory(true);
+            }
+            particle.setIntProperty(type, value);
+        }
+
+        void ApplyIntProperty(Particle & particle, std::int32_t value, IntPropertyType type, EGSphspFile::EGSLATCHOPTION) {
+            particle.setIntProperty(type, value);
+        }
+
+    } // namespace
+
+    Reader::RecordPlan Reader::compileRecordPlan(const IAEAHeader & header)
+    {
+        RecordPlan plan;
+        plan.xIsStored = header.xIsStored();
+        plan.yIsStored = header.yIsStored();
+        plan.zIsStored = header.zIsStored();
+        plan.uIsStored = header.uIsStored();
+        plan.vIsStored = header.vIsStored();
+        plan.wIsStored = header.wIsStored();
+        plan.weightIsStored = header.weightIsStored();
+        plan.allBasicStored = plan.xIsStored && plan.yIsStored && plan.zIsStored && plan.uIsStored && plan.vIsStored && plan.wIsStored && plan.weightIsStored;
+        plan.constantX = plan.xIsStored ? 0.f : header.getConstantX();
+        plan.constantY = plan.yIsStored ? 0.f : header.getConstantY();
+        plan.constantZ = plan.zIsStored ? 0.f : header.getConstantZ();
+        plan.constantU = plan.uIsStored ? 0.f : header.getConstantU();
+        plan.constantV = plan.vIsStored ? 0.f : header.getConstantV();
+        plan.constantW = plan.wIsStored ? 0.f : header.getConstantW();
+        plan.constantWeight = plan.weightIsStored ? 0.f : header.getConstantWeight();
+
+        unsigned int N_extraFloats = header.getNumberOfExtraFloats();
+        plan.extraFloatTypes.reserve(N_extraFloats);
+        for (unsigned int i = 0; i < N_extraFloats; i++)
+        {
+            plan.extraFloatTypes.push_back(IAEAHeader::translateExtraFloatType(header.getExtraFloatType(i)));
+        }
+
+        unsigned int N_extraLongs = header.getNumberOfExtraLongs();
+        plan.extraLongs.reserve(N_extraLongs);
+        for (unsigned int i = 0; i < N_extraLongs; i++)
+        {
+            IAEAHeader::EXTRA_LONG_TYPE IAEAextraLongType = header.getExtraLongType(i);
+            IntPropertyType extraLongType = IAEAHeader::translateExtraLongType(IAEAextraLongType);
+
+            ExtraLongHandler handler;
+            switch (IAEAextraLongType) {
+                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB1: handler = ApplyILB1; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB2: handler = ApplyILB2; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB3: handler = ApplyILB3; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB4: handler = ApplyILB4; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB5: handler = ApplyILB5; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::EGS_LATCH: handler = ApplyLATCH; break;
+                case IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER: handler = ApplyIncrementalHistoryNumber; break;
+                default: handler = ApplyIntProperty; break;
+            }
+            plan.extraLongs.push_back({ handler, extraLongType });
+        }
+
+        // The type byte and energy come first in every record, followed by the stored basic quantities and the extra floats
+        plan.incrementalHistoryOffset = 0;
+        for (unsigned int i = 0; i < N_extraLongs; i++)
+        {
+            if (header.getExtraLongType(i) != IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER) continue;
+            const std::size_t storedFloats = static_cast<std::size_t>(plan.xIsStored) + plan.yIsStored + plan.zIsStored + plan.uIsStored + plan.vIsStored + plan.weightIsStored;
+            plan.incrementalHistoryOffset = sizeof(signed_byte) + sizeof(float) * (1 + storedFloats + N_extraFloats) + sizeof(std::int32_t) * i;
+            break;
+        }
+
+        return plan;
+    }
+
     Particle Reader::readBinaryParticle(ByteBuffer & buffer)
+    {
+        return plan_.allBasicStored ? decodeParticle<true>(buffer) : decodeParticle<false>(buffer);
+    }
+
+    bool Reader::rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected)
+    {
+        // Work out the fields exactly as decodeParticle() does, but only as far as the filter needs them
+        signed_byte typeCode = record.read<signed_byte>();
+        if (typeCode < 0) typeCode = -typeCode;
+
+        ParticleType particleType;
+        switch (typeCode)
+        {
+            case 1: particleType = ParticleType::Photon; break;
+            case 2: particleType = ParticleType::Electron; break;
+            case 3: particleType = ParticleType::Positron; break;
+            case 4: particleType = ParticleType::Neutron; break;
+            case 5: particleType = ParticleType::Proton; break;
+            default: return false; // leave it to the full decoder to report
+        }
+
+        float kineticEnergy = record.read<float>();
+        bool isNewHistory = kineticEnergy < 0;
+        if (isNewHistory) kineticEnergy = -kineticEnergy;
+        kineticEnergy *= energyUnits;
+
+        bool accepted = filter.acceptsParticleType(particleType) && filter.acceptsKineticEnergy(kineticEnergy);
+        if (accepted && filter.usesPosition()) {
+            const float x = plan_.xIsStored ? record.read<float>() * distanceUnits : plan_.constantX;
+            const float y = plan_.yIsStored ? record.read<float>() * distanceUnits : plan_.constantY;
+            const float z = plan_.zIsStored ? record.read<float>() * distanceUnits : plan_.constantZ;
+            accepted = filter.acceptsPosition(x, y, z);
+        }
+        if (accepted) return false;
+
+        // A positive incremental history number also marks a new history, see ApplyIncrementalHistoryNumber()
+        std::uint32_t incrementalHistories = 1;
+        if (plan_.incrementalHistoryOffset > 0) {
+            record.moveTo(plan_.incrementalHistoryOffset);
+            const std::int32_t value = record.read<std::int32_t>();
+            if (value > 0) {
+                isNewHistory = true;
+                incrementalHistories = static_cast<std::uint32_t>(value);
+            }
+        }
+
+        rejected.type = particleType;
+        rejected.isNewHistory = isNewHistory;
+        rejected.incrementalHistories = incrementalHistories;
+        return true;
+    }
+
+    template <bool ALL_BASIC_STORED>
+    Particle Reader::decodeParticle(ByteBuffer & buffer)
     {
         signed_byte typeCode = buffer.read<signed_byte>();
 
@@ -126,13 +268,23 @@ namespace ParticleZoo::IAEAphspFile
         kineticEnergy *= energyUnits;
 
         float x, y, z, u, v, w, weight;
-        if (header_.xIsStored()) x = buffer.read<float>() * distanceUnits; else x = header_.getConstantX();
-        if (header_.yIsStored()) y = buffer.read<float>() * distanceUnits; else y = header_.getConstantY();
-        if (header_.zIsStored()) z = buffer.read<float>() * distanceUnits; else z = header_.getConstantZ();
-        if (header_.uIsStored()) u = buffer.read<float>(); else u = header_.getConstantU();
-        if (header_.vIsStored()) v = buffer.read<float>(); else v = header_.getConstantV();
-        if (header_.wIsStored()) w = is * calcThirdUnitComponent(u, v); else w = header_.getConstantW();
-        if (header_.weightIsStored()) weight = buffer.read<float>(); else weight = header_.getConstantWeight();
+        if constexpr (ALL_BASIC_STORED) {
+            x = buffer.read<float>() * distanceUnits;
+            y = buffer.read<float>() * distanceUnits;
+            z = buffer.read<float>() * distanceUnits;
+            u = buffer.read<float>();
+            v = buffer.read<float>();
+            w = is * calcThirdUnitComponent(u, v);
+            weight = buffer.read<float>();
+        } else {
+            if (plan_.xIsStored) x = buffer.read<float>() * distanceUnits; else x = plan_.constantX;
+            if (plan_.yIsStored) y = buffer.read<float>() * distanceUnits; else y = plan_.constantY;
+            if (plan_.zIsStored) z = buffer.read<float>() * distanceUnits; else z = plan_.constantZ;
+            if (plan_.uIsStored) u = buffer.read<float>(); else u = plan_.constantU;
+            if (plan_.vIsStored) v = buffer.read<float>(); else v = plan_.constantV;
+            if (plan_.wIsStored) w = is * calcThirdUnitComponent(u, v); else w = plan_.constantW;
+            if (plan_.weightIsStored) weight = buffer.read<float>(); else weight = plan_.constantWeight;
+        }
 
         if (weight < 0) {
             throw std::runtime_error("Negative particle weight read from IAEA phase space file, which is not allowed.");
@@ -140,50 +292,14 @@ namespace ParticleZoo::IAEAphspFile
 
         Particle particle(particleType, kineticEnergy, x, y, z, u, v, w, isNewHistory, weight);
 
-        unsigned int N_extraFloats = header_.getNumberOfExtraFloats();
-        for (unsigned int i = 0; i < N_extraFloats; i++)
+        for (FloatPropertyType extraFloatType : plan_.extraFloatTypes)
         {
-            float extraFloat = buffer.read<float>();
-            IAEAHeader::EXTRA_FLOAT_TYPE IAEAextraFloatType = header_.getExtraFloatType(i);
-            FloatPropertyType extraFloatType = IAEAHeader::translateExtraFloatType(IAEAextraFloatType);
-            particle.setFloatProperty(extraFloatType, extraFloat);
+            particle.setFloatProperty(extraFloatType, buffer.read<float>());
         }
 
-        unsigned int N_extraLongs = header_.getNumberOfExtraLongs();
-        for (unsigned int i = 0; i < N_extraLongs; i++)
+        for (const RecordPlan::ExtraLong & extraLong : plan_.extraLongs)
         {
-            std::int32_t extraLong = buffer.read<std::int32_t>();
-            IAEAHeader::EXTRA_LONG_TYPE IAEAextraLongType = header_.getExtraLongType(i);
-
-            switch (IAEAextraLongType) {
-                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB1:
-                    Penelope::ApplyILB1ToParticle(particle, extraLong);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB2:
-                    Penelope::ApplyILB2ToParticle(particle, extraLong);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB3:
-                    Penelope::ApplyILB3ToParticle(particle, extraLong);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB4:
-                    Penelope::ApplyILB4ToParticle(particle, extraLong);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB5:
-                    Penelope::ApplyILB5ToParticle(particle, extraLong);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::EGS_LATCH:
-                    EGSphspFile::ApplyLATCHToParticle(particle, extraLong, EGSlatchOption_);
-                    break;
-                case IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER:
-                    if (extraLong > 0 && !isNewHistory) {
-                        isNewHistory = true;
-                        particle.setNewHistory(true);
-                    }
-                default:
-                    IntPropertyType extraLongType = IAEAHeader::translateExtraLongType(IAEAextraLongType);
-                    particle.setIntProperty(extraLongType, extraLong);
-                    break;
-            }
+            extraLong.handler(particle, buffer.read<std::int32_t>(), extraLong.type, EGSlatchOption_);
         }
 
         return particle;
@@ -201,12 +317,14 @@ namespace ParticleZoo::IAEAphspFile
 
             std::string headerFileTemplatePath = std::get<std::string>(headerFileTemplateValue);
 
+            const std::string headerFilePath = IAEAHeader::DeterminePathToHeaderFile(getHeaderFileSource(filename, userOptions));
+
             IAEAHeader header = headerFileTemplatePath.length() > 0 ? 
-                IAEAHeader(IAEAHeader(headerFileTemplatePath), IAEAHeader::DeterminePathToHeaderFile(filename)) : 
-                IAEAHeader(IAEAHeader::DeterminePathToHeaderFile(filename), true);
+                IAEAHeader(IAEAHeader(headerFileTemplatePath), headerFilePath) : 
+                IAEAHeader(headerFilePath, true);
 
             if (headerFileTemplatePath.length() > 0) {
-                header.setFilePath(IAEAHeader::DeterminePathToHeaderFile(filename));
+                header.setFilePath(headerFilePath);
             }
 
             if (userOptions.contains(IAEAIndexCommand)) {
@@ -374,7 +492,7 @@ namespace ParticleZoo::IAEAphspFile
 
         unsigned int N_extraFloats = header_.getNumberOfExtraFloats();
         unsigned int customFloatIndex = 0;
-        const std::vector<float> & customFloatProperties = particle.getCustomFloatProperties();
+        std::span<const float> customFloatProperties = particle.getCustomFloatProperties();
         for (unsigned int i = 0; i < N_extraFloats; i++)
         {
             float extraFloatValue;
@@ -398,7 +516,7 @@ namespace ParticleZoo::IAEAphspFile
 
         unsigned int N_extraLongs = header_.getNumberOfExtraLongs();
         unsigned int customLongIndex = 0;
-        const std::vector<std::int32_t> & customLongProperties = particle.getCustomIntProperties();
+        std::span<const std::int32_t> customLongProperties = particle.getCustomIntProperties();
         for (unsigned int i = 0; i < N_extraLongs; i++)
         {
             std::int32_t extraLongValue;
@@ -448,6 +566,42 @@ namespace ParticleZoo::IAEAphspFile
         header_.countParticleStats(particle);
     }
 
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileWriter & other) {
+        const Writer & otherWriter = dynamic_cast<const Writer &>(other);
+        // The other header already holds the final history count of its file, see writeHeaderData()
+        header_.mergeParticleStats(otherWriter.header_);
+        if (useCustomHistoryCount_ || otherWriter.useCustomHistoryCount_) {
+            useCustomHistoryCount_ = true;
+            custumNumberOfHistories_ = header_.getOriginalHistories();
+        }
+    }
+
+    bool Writer::hasSameRecordLayout(const PhaseSpaceFileReader & reader) const {
+        const Reader * iaeaReader = dynamic_cast<const Reader *>(&reader);
+        // Constant values are stored in the header rather than in the records, so they must match as well
+        return iaeaReader && iaeaReader->getFixedValues() == getFixedValues() && header_.hasSameRecordLayout(iaeaReader->getHeader());
+    }
+
+    void Writer::countParticleStats(const Particle & particle) {
+        header_.countParticleStats(particle);
+    }
+
+    void Writer::countParticleBlockStats(const ParticleBlock & block) {
+        header_.countParticleStats(block);
+    }
+
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileReader & reader) {
+        const Reader & iaeaReader = dynamic_cast<const Reader &>(reader);
+        header_.mergeParticleStats(iaeaReader.getHeader());
+        if (useCustomHistoryCount_) {
+            custumNumberOfHistories_ += iaeaReader.getNumberOfOriginalHistories();
+        }
+    }
+
+    std::vector<std::string> Writer::getOutputFileNames() const {
+        return { getFileName(), header_.getHeaderFilePath() };
+    }
+
     void Writer::writeHeaderData(ByteBuffer & buffer) {
         (void)buffer; // unused in this implementation
         if (useCustomHistoryCount_) {
@@ -461,4 +615,8 @@ namespace ParticleZoo::IAEAphspFile
         }
         header_.writeHeader();
     }
+
+    void Writer::writeProvisionalHeader() {
+        header_.writeHeader();
+    }
 }
\ No newline at end of file
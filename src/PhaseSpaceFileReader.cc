@@ -1,11 +1,46 @@
 
 #include "particlezoo/PhaseSpaceFileReader.h"
 
+#include "particlezoo/utilities/formats.h"
+#include "particlezoo/utilities/sharedFileCache.h"
+
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
 namespace ParticleZoo
 {
 
+    CLICommand MemoryMapCommand{ READER, "", "mmap", "Memory-map binary input phase space files instead of reading them through a buffered stream", { CLI_VALUELESS } };
+    CLICommand SharedCacheCommand{ READER, "", "sharedCache", "Copy binary input phase space files once into a cache shared by every process of the node and memory-map the copy", { CLI_VALUELESS } };
+    CLICommand SharedCacheDirectoryCommand{ READER, "", "sharedCacheDir", "Directory of the cache of --sharedCache, preferably on a memory file system (default: /dev/shm)", { CLI_STRING } };
+    CLICommand PrefetchCommand{ READER, "", "prefetch", "Read input phase space files ahead on a background I/O thread, keeping up to this many blocks queued", { CLI_UINT } };
+    CLICommand PrefetchBlockSizeCommand{ READER, "", "prefetchBlockSize", "Size in bytes of each block read ahead when prefetching (default: same as the read buffer)", { CLI_UINT } };
+    CLICommand ReadBufferSizeCommand{ READER, "", "readBufferSize", "Size in bytes of the buffer each reader reads its file through (default: 1048576)", { CLI_UINT } };
+    CLICommand InputHeaderCommand{ READER, "", "inputHeader", "Path of the header file to read when the input phase space is read from standard input (-)", { CLI_STRING } };
+
+    namespace {
+        constexpr unsigned int MINIMUM_READ_BUFFER_SIZE = 4096; // holds the longest record or ASCII line of any format
+    }
+
     std::vector<CLICommand> PhaseSpaceFileReader::getCLICommands() {
-        return {};
+        return { MemoryMapCommand, SharedCacheCommand, SharedCacheDirectoryCommand, PrefetchCommand, PrefetchBlockSizeCommand, ReadBufferSizeCommand, InputHeaderCommand, ProfileCommand }; // ProfileCommand applies to writers too but can only be registered once
+    }
+
+    std::string PhaseSpaceFileReader::getHeaderFileSource(const std::string & fileName, const UserOptions & userOptions) {
+        if (!IsStandardStream(fileName)) {
+            return fileName;
+        }
+        if (!userOptions.contains(InputHeaderCommand)) {
+            throw std::runtime_error("A header file must be given with --" + InputHeaderCommand.longName + " to read this format from standard input.");
+        }
+        // Wait for the first data, by which time a program writing the input has written a first version of the header
+        const int firstByte = std::getc(stdin);
+        if (firstByte != EOF) std::ungetc(firstByte, stdin);
+        return std::get<std::string>(userOptions.at(InputHeaderCommand).front());
     }
 
     PhaseSpaceFileReader::PhaseSpaceFileReader(const std::string & phspFormat, const std::string & fileName, const UserOptions & userOptions, FormatType formatType, const FixedValues fixedValues, unsigned int bufferSize)
@@ -13,22 +48,51 @@ namespace ParticleZoo
         fileName_(fileName),
         userOptions_(userOptions),
         formatType_(formatType),
-        BUFFER_SIZE(bufferSize),
+        BUFFER_SIZE([&]() -> int {
+                if (!userOptions_.contains(ReadBufferSizeCommand)) return static_cast<int>(bufferSize);
+                unsigned int size = std::get<unsigned int>(userOptions_.at(ReadBufferSizeCommand).front());
+                if (size < MINIMUM_READ_BUFFER_SIZE || size > static_cast<unsigned int>(std::numeric_limits<int>::max())) {
+                    throw std::runtime_error("Read buffer size must be between " + std::to_string(MINIMUM_READ_BUFFER_SIZE) + " and " + std::to_string(std::numeric_limits<int>::max()) + " bytes.");
+                }
+                return static_cast<int>(size);
+            }()),
+        compression_(formatType_ == FormatType::NONE ? StreamCompression::NONE : DetectStreamCompression(fileName_)),
+        useMemoryMap_(formatType_ == FormatType::BINARY && compression_ == StreamCompression::NONE && !IsStandardStream(fileName_) && (userOptions_.contains(MemoryMapCommand) || userOptions_.contains(SharedCacheCommand))), // mapping and prefetching read the file as stored
+        prefetchDepth_([&]() -> std::size_t {
+                if (formatType_ == FormatType::NONE || compression_ != StreamCompression::NONE || IsStandardStream(fileName_) || useMemoryMap_ || !userOptions_.contains(PrefetchCommand)) return 0;
+                return std::get<unsigned int>(userOptions_.at(PrefetchCommand).front());
+            }()),
+        prefetchBlockSize_([&]() -> std::size_t {
+                if (!userOptions_.contains(PrefetchBlockSizeCommand)) return BUFFER_SIZE;
+                unsigned int blockSize = std::get<unsigned int>(userOptions_.at(PrefetchBlockSizeCommand).front());
+                if (blockSize == 0) throw std::runtime_error("Prefetch block size must be positive.");
+                return blockSize;
+            }()),
+        profiling_(userOptions_.contains(ProfileCommand)),
         file_([&]() {
                 if (formatType_ == FormatType::NONE)
-                    return std::ifstream{};
+                    return InputFileStream{};
                 else
-                    return std::ifstream(fileName_, std::ios::binary);
+                    return InputFileStream(fileName_);
             }()),
+        hasASCIILine_(false),
+        asciiIndexScanOffset_(0),
+        asciiIndexRecordsScanned_(0),
         asciiCommentMarkers_({"#", "//"}),
         bytesInFile_([this]() -> std::uint64_t {
                 if (formatType_ == FormatType::NONE) {
+                    if (IsStandardStream(fileName_)) {
+                        throw std::runtime_error("The " + phspFormat_ + " format cannot be read from standard input.");
+                    }
                     return 0; // For NONE format, we assume no data to read
                 }
                 if (!file_.is_open())
                 {
                     throw std::runtime_error("Failed to open file: " + fileName_);
                 }
+                if (file_.isStandardInput()) {
+                    return std::numeric_limits<std::uint64_t>::max(); // set once the end of the input is reached
+                }
                 file_.seekg(0, std::ios::end);
                 auto size = file_.tellg();
                 if (size < 0)
@@ -43,39 +107,135 @@ namespace ParticleZoo
         particlesSkipped_(0),
         historiesRead_(0),
         numberOfParticlesToRead_(0),
+        readsToParticleRecordsEnd_(false),
         particleRecordLength_(0),
         isFirstParticle_(true),
-        buffer_(BUFFER_SIZE),
+        buffer_(useMemoryMap_ ? 1 : BUFFER_SIZE + (prefetchDepth_ > 0 ? prefetchBlockSize_ : 0)), // a memory mapped file is read in place so no read buffer is needed, a prefetched block must fit after any unread data
+        recordBuffer_(1),
+        readParticleDepth_(0),
+        canReadBinaryParticleBlocks_(true),
+        particlesRejectedByFilter_(0),
+        rejectedHistoriesToCarry_(0),
+        historyIndexLoaded_(false),
+        nextHistoryBlockStart_(0),
         fixedValues_(fixedValues)
     {
-        if (formatType != FormatType::NONE) {
+        if (formatType != FormatType::NONE && !file_.isStandardInput()) {
             file_.seekg(0);
         }
     }
 
+    PhaseSpaceFileReader::PhaseSpaceFileReader(const PhaseSpaceFileReader & other)
+    :   phspFormat_(other.phspFormat_),
+        fileName_(other.fileName_),
+        userOptions_(other.userOptions_),
+        formatType_(other.formatType_),
+        BUFFER_SIZE(other.BUFFER_SIZE),
+        compression_(other.compression_),
+        useMemoryMap_(other.useMemoryMap_),
+        prefetchDepth_(other.prefetchDepth_),
+        prefetchBlockSize_(other.prefetchBlockSize_),
+        profiling_(other.profiling_),
+        file_([&]() {
+                if (formatType_ == FormatType::NONE)
+                    return InputFileStream{};
+                if (other.file_.isStandardInput()) {
+                    throw std::runtime_error("Standard input cannot be opened by more than one reader.");
+                }
+                return InputFileStream(fileName_);
+            }()),
+        hasASCIILine_(false),
+        asciiRecordOffsets_(other.asciiRecordOffsets_),
+        asciiIndexScanOffset_(other.asciiIndexScanOffset_),
+        asciiIndexRecordsScanned_(other.asciiIndexRecordsScanned_),
+        asciiCommentMarkers_(other.asciiCommentMarkers_),
+        bytesInFile_(other.bytesInFile_),
+        bytesRead_(0),
+        particlesRead_(0),
+        metaparticlesRead_(0),
+        particlesSkipped_(0),
+        historiesRead_(0),
+        numberOfParticlesToRead_(0),
+        readsToParticleRecordsEnd_(false),
+        particleRecordLength_(other.particleRecordLength_),
+        isFirstParticle_(true),
+        buffer_(useMemoryMap_ ? 1 : BUFFER_SIZE + (prefetchDepth_ > 0 ? prefetchBlockSize_ : 0), other.buffer_.getByteOrder()),
+        recordBuffer_(1),
+        readParticleDepth_(0),
+        canReadBinaryParticleBlocks_(true),
+        particlesRejectedByFilter_(0),
+        rejectedHistoriesToCarry_(0),
+        historyIndex_(other.historyIndex_),
+        historyIndexLoaded_(other.historyIndexLoaded_),
+        nextHistoryBlockStart_(0),
+        fixedValues_(other.fixedValues_)
+    {
+        if (formatType_ != FormatType::NONE && !file_.is_open()) {
+            throw std::runtime_error("Failed to open file: " + fileName_);
+        }
+    }
+
     PhaseSpaceFileReader::~PhaseSpaceFileReader() {
         close();
     }
 
+    std::unique_ptr<PhaseSpaceFileReader> PhaseSpaceFileReader::clone() const {
+        if (file_.isStandardInput()) {
+            throw std::runtime_error("Standard input cannot be opened by more than one reader.");
+        }
+        return FormatRegistry::CreateReader(phspFormat_, fileName_, userOptions_);
+    }
+
     void PhaseSpaceFileReader::close() {
+        prefetcher_.reset();
         if (file_.is_open()) {
             file_.close();
         }
+        if (mappedFile_) {
+            buffer_.clear(); // the buffer is a view of the mapping, make sure it is never read after unmapping
+            hasASCIILine_ = false;
+            mappedFile_.reset();
+        }
     }
 
     void PhaseSpaceFileReader::moveToParticle(std::uint64_t particleIndex) {
         // Validate input
-        if (formatType_ == FormatType::NONE) {
-            throw std::runtime_error("moveToParticle is not supported for NONE format.");
-        }
         if (particleIndex >= getNumberOfEntriesInFile()) {
             throw std::out_of_range("Particle index out of range.");
         }
 
+        if (file_.isStandardInput()) {
+            if (particleIndex == 0 && particlesRead_ == 0) return; // nothing has been read yet
+            throw std::runtime_error("Cannot move to particle " + std::to_string(particleIndex) + " in standard input, which can only be read forward.");
+        }
+
+        if (mappedFile_ && formatType_ == FormatType::BINARY) {
+            // The whole file is already in view, so seeking is just moving the offset
+            std::size_t particleRecordStartOffset = getParticleRecordStartOffset();
+            std::size_t particleRecordLength = getParticleRecordLength();
+            std::uint64_t bytesToSkip = particleRecordStartOffset + particleIndex * particleRecordLength;
+            if (bytesToSkip + particleRecordLength > bytesInFile_) {
+                throw std::out_of_range("Attempted to seek beyond end of file.");
+            }
+            mappedFile_->adviseRandom();
+            buffer_.moveTo(static_cast<std::size_t>(bytesToSkip));
+            numberOfParticlesToRead_ = 0;
+            particlesRead_ = particleIndex;
+            particlesSkipped_ = particleIndex;
+            metaparticlesRead_ = 0;
+            historiesRead_ = 0;
+            isFirstParticle_ = particleIndex == 0;
+            particlesRejectedByFilter_ = 0;
+            rejectedHistoriesToCarry_ = 0;
+            nextHistoryBlockStart_ = 0;
+            return;
+        }
+
         // Reset reading state
+        prefetcher_.reset(); // restarted from the new position on the next refill
         file_.clear(); // Clear any EOF or fail flags
         buffer_.clear();
-        asciiLineBuffer_.clear();
+        hasASCIILine_ = false;
         numberOfParticlesToRead_ = 0;
 
         if (formatType_ == FormatType::BINARY) {
@@ -95,26 +255,292 @@ namespace ParticleZoo
 
             bytesRead_ = bytesToSkip;
         } else if (formatType_ == FormatType::ASCII) {
-            // For ASCII, we need to read lines until we reach the desired particle index
-            file_.seekg(0, std::ios::beg);
+            // Seek to the closest indexed record at or before the particle, then skip the lines in between
+            indexASCIIRecordsUpTo(particleIndex);
+            const std::size_t entry = static_cast<std::size_t>(std::min<std::uint64_t>(particleIndex / ASCII_INDEX_STRIDE, asciiRecordOffsets_.size() - 1));
+            const std::uint64_t recordOffset = asciiRecordOffsets_[entry];
+            file_.seekg(static_cast<std::streamoff>(recordOffset), std::ios::beg);
             if (file_.fail()) {
-                throw std::runtime_error("Failed to seek to beginning of file: " + fileName_);
+                throw std::runtime_error("Failed to seek to particle index " + std::to_string(particleIndex) + " in file: " + fileName_);
             }
-            // reset counters
-            bytesRead_  = 0;
-            particlesRead_ = 0;
-            historiesRead_ = 0;
-            for (std::size_t p = 0 ; p < particleIndex ; p++) {
-                getNextParticle(false); // Read without counting in statistics
+            bytesRead_ = recordOffset;
+            for (std::uint64_t p = entry * ASCII_INDEX_STRIDE ; p < particleIndex ; p++) {
+                bufferNextASCIILine();
+                if (!hasASCIILine_) {
+                    throw std::out_of_range("Attempted to seek beyond end of file.");
+                }
+                hasASCIILine_ = false; // skipped without being parsed
             }
         } else {
-            throw std::runtime_error("Unsupported format type for moveToParticle."); // Just for safety
+            // For NONE format, seeking has to be implemented manually by the subclass
+            moveToParticleManually(particleIndex);
         }
 
         particlesRead_ = particleIndex;
         particlesSkipped_ = particleIndex;
         metaparticlesRead_ = 0;
         historiesRead_ = 0;
+        isFirstParticle_ = particleIndex == 0;
+        particlesRejectedByFilter_ = 0;
+        rejectedHistoriesToCarry_ = 0;
+        nextHistoryBlockStart_ = 0;
+    }
+
+    void PhaseSpaceFileReader::loadHistoryIndex() {
+        if (!historyIndexLoaded_) {
+            if (!file_.isStandardInput()) historyIndex_ = HistoryIndex::Load(fileName_); // standard input has no sidecar files
+            historyIndexLoaded_ = true;
+        }
+    }
+
+    void PhaseSpaceFileReader::moveToHistory(std::uint64_t historyNumber) {
+        loadHistoryIndex();
+        if (historyIndex_) {
+            moveToHistory(historyNumber, *historyIndex_);
+            return;
+        }
+
+        // Without an index the only way to find the history is to count them from the start
+        moveToParticle(0);
+        skipToHistory(0, historyNumber);
+    }
+
+    void PhaseSpaceFileReader::moveToHistory(std::uint64_t historyNumber, const HistoryIndex & index) {
+        auto [indexedHistory, recordIndex] = index.findClosestHistory(historyNumber);
+        moveToParticle(recordIndex);
+        if (indexedHistory != historyNumber) {
+            skipToHistory(indexedHistory, historyNumber);
+        }
+    }
+
+    void PhaseSpaceFileReader::skipToHistory(std::uint64_t nextHistory, std::uint64_t historyNumber) {
+        // Read forward until the next particle is the first of the requested history, without
+        // seeking back afterwards since that would mean reading ASCII files from the start again
+        while (hasMoreParticles()) {
+            const Particle particle = peekNextParticle();
+            const bool startsHistory = particle.isNewHistory() || (isFirstParticle_ && particle.getType() != ParticleType::PseudoParticle);
+            if (startsHistory) {
+                if (nextHistory == historyNumber) {
+                    // Count everything before this particle as skipped, the same as moveToParticle() does
+                    particlesSkipped_ = particlesRead_;
+                    metaparticlesRead_ = 0;
+                    historiesRead_ = 0;
+                    numberOfParticlesToRead_ = 0; // the particle limit is worked out again for the records skipped
+                    return;
+                }
+                nextHistory++;
+            }
+            getNextParticle();
+        }
+        throw std::out_of_range("History " + std::to_string(historyNumber) + " is beyond the end of the file.");
+    }
+
+    std::uint64_t PhaseSpaceFileReader::getRecordByteOffset(std::uint64_t recordIndex) const {
+        if (formatType_ != FormatType::BINARY) {
+            throw std::runtime_error("The records of " + fileName_ + " are not at fixed byte offsets, only those of binary files are.");
+        }
+        return getParticleRecordStartOffset() + recordIndex * getParticleRecordLength();
+    }
+
+    std::uint64_t PhaseSpaceFileReader::findHistoryStart(std::uint64_t particleIndex) {
+        moveToParticle(particleIndex);
+        while (hasMoreParticles()) {
+            const Particle particle = peekNextParticle();
+            if (particle.isNewHistory() || (isFirstParticle_ && particle.getType() != ParticleType::PseudoParticle)) {
+                break;
+            }
+            getNextParticle();
+        }
+        return particlesRead_;
+    }
+
+    HistoryIndex PhaseSpaceFileReader::buildHistoryIndex(std::uint64_t stride) {
+        if (stride == 0) {
+            throw std::invalid_argument("History index stride must be positive.");
+        }
+        if (particlesRead_ > 0) {
+            moveToParticle(0);
+        }
+
+        // Every record, pseudo-particles included, occupies one slot in the block
+        constexpr std::size_t HISTORY_INDEX_BLOCK_SIZE = 65536;
+        ParticleBlock block(HISTORY_INDEX_BLOCK_SIZE);
+        std::vector<std::uint64_t> historyStarts;
+        std::vector<HistoryBlockStatistics> blockStatistics;
+        std::uint64_t numberOfRepresentedHistories = 0;
+        std::uint64_t numberOfParticles = 0;
+
+        // Account for a particle read from the given record index
+        auto indexParticle = [&](std::uint64_t recordIndex, ParticleType type, float kineticEnergy, float x, float y, float z, bool isNewHistory, std::uint32_t incrementalHistories) {
+            if (type != ParticleType::PseudoParticle) numberOfParticles++;
+            if (isNewHistory) {
+                if (numberOfRepresentedHistories % stride == 0) {
+                    historyStarts.push_back(recordIndex);
+                    blockStatistics.emplace_back();
+                }
+                numberOfRepresentedHistories++;
+            }
+            // Records before the first history belong to no block
+            if (!blockStatistics.empty()) {
+                blockStatistics.back().countRecord(type, kineticEnergy, x, y, z, isNewHistory, incrementalHistories);
+            }
+        };
+
+        bool oneRecordPerParticle = true;
+        while (oneRecordPerParticle && hasMoreParticles()) {
+            const std::uint64_t firstRecordIndex = particlesRead_;
+            const std::size_t particlesInBlock = readParticleBlock(block, HISTORY_INDEX_BLOCK_SIZE);
+            if (particlesInBlock == 0) break;
+            if (particlesRead_ - firstRecordIndex != particlesInBlock) {
+                // Some particles were read along with other records, such as the TOPAS pseudo-particles
+                // standing for empty histories, so the record index of each has to be followed
+                moveToParticle(firstRecordIndex);
+                oneRecordPerParticle = false;
+                break;
+            }
+            const ParticleBlock & particles = block;
+            std::span<const ParticleType> types = particles.getTypes();
+            std::span<const float> energies = particles.getKineticEnergies();
+            std::span<const float> xs = particles.getXPositions();
+            std::span<const float> ys = particles.getYPositions();
+            std::span<const float> zs = particles.getZPositions();
+            std::span<const std::uint8_t> isNewHistory = particles.getNewHistoryFlags();
+            std::span<const std::uint32_t> incrementalHistories = particles.getIncrementalHistories();
+            for (std::size_t i = 0; i < particlesInBlock; i++) {
+                indexParticle(firstRecordIndex + i, types[i], energies[i], xs[i], ys[i], zs[i], isNewHistory[i] != 0, incrementalHistories[i]);
+            }
+        }
+
+        while (!oneRecordPerParticle && hasMoreParticles()) {
+            const std::uint64_t recordIndex = particlesRead_;
+            const std::uint64_t metaparticlesRead = metaparticlesRead_;
+            const Particle particle = getNextParticle();
+            indexParticle(recordIndex, particle.getType(), particle.getKineticEnergy(), particle.getX(), particle.getY(), particle.getZ(), particle.isNewHistory(), particle.getIncrementalHistories());
+            if (!blockStatistics.empty()) {
+                // Count the other records read with the particle in its block
+                HistoryBlockStatistics & statistics = blockStatistics.back();
+                statistics.numberOfRecords += particlesRead_ - recordIndex - 1;
+                statistics.numberOfPseudoParticles += metaparticlesRead_ - metaparticlesRead - (particle.getType() == ParticleType::PseudoParticle ? 1 : 0);
+            }
+        }
+
+        return HistoryIndex(stride, numberOfRepresentedHistories, numberOfParticles, std::move(historyStarts), std::move(blockStatistics));
+    }
+
+    template <typename RecordVisitor>
+    void PhaseSpaceFileReader::visitRecordPositions(RecordVisitor && visit) {
+        if (particlesRead_ > 0) {
+            moveToParticle(0);
+        }
+
+        constexpr std::size_t SPATIAL_INDEX_BLOCK_SIZE = 65536;
+        ParticleBlock block(SPATIAL_INDEX_BLOCK_SIZE);
+        bool oneRecordPerParticle = true;
+        while (oneRecordPerParticle && hasMoreParticles()) {
+            const std::uint64_t firstRecordIndex = particlesRead_;
+            const std::size_t particlesInBlock = readParticleBlock(block, SPATIAL_INDEX_BLOCK_SIZE);
+            if (particlesInBlock == 0) break;
+            if (particlesRead_ - firstRecordIndex != particlesInBlock) {
+                // Follow the record index of each particle instead, as buildHistoryIndex() does
+                moveToParticle(firstRecordIndex);
+                oneRecordPerParticle = false;
+                break;
+            }
+            const ParticleBlock & particles = block;
+            std::span<const ParticleType> types = particles.getTypes();
+            std::span<const float> xs = particles.getXPositions();
+            std::span<const float> ys = particles.getYPositions();
+            std::span<const std::uint8_t> isNewHistory = particles.getNewHistoryFlags();
+            for (std::size_t i = 0; i < particlesInBlock; i++) {
+                visit(firstRecordIndex + i, types[i], xs[i], ys[i], isNewHistory[i] != 0);
+            }
+        }
+
+        while (!oneRecordPerParticle && hasMoreParticles()) {
+            const std::uint64_t recordIndex = particlesRead_;
+            const Particle particle = getNextParticle();
+            visit(recordIndex, particle.getType(), particle.getX(), particle.getY(), particle.isNewHistory());
+        }
+    }
+
+    SpatialIndex PhaseSpaceFileReader::buildSpatialIndex(const SpatialGrid & grid) {
+        if (grid.level > SpatialGrid::MAXIMUM_LEVEL) {
+            throw std::invalid_argument("Spatial index grid level " + std::to_string(grid.level) + " is above the maximum of " + std::to_string(SpatialGrid::MAXIMUM_LEVEL) + ".");
+        }
+
+        std::unordered_map<std::uint32_t, SpatialTile> tiles;
+        bool inHistory = false;
+        std::uint64_t historyStart = 0;
+        bool hasParticle = false;   // whether the history has a particle other than a pseudo-particle yet
+        std::uint32_t historyTile = 0;
+        SpatialTile historyBounds;
+
+        // Add the history ending before the given record to the tile of its first particle
+        auto finishHistory = [&](std::uint64_t historyEnd) {
+            SpatialTile & tile = tiles[historyTile];
+            tile.tile = historyTile;
+            tile.numberOfHistories++;
+            tile.numberOfRecords += historyEnd - historyStart;
+            tile.minX = std::min(tile.minX, historyBounds.minX);
+            tile.maxX = std::max(tile.maxX, historyBounds.maxX);
+            tile.minY = std::min(tile.minY, historyBounds.minY);
+            tile.maxY = std::max(tile.maxY, historyBounds.maxY);
+            if (!tile.recordRanges.empty() && tile.recordRanges.back().firstRecord + tile.recordRanges.back().numberOfRecords == historyStart) {
+                tile.recordRanges.back().numberOfRecords += historyEnd - historyStart;
+                tile.recordRanges.back().numberOfHistories++;
+            } else {
+                tile.recordRanges.push_back({ historyStart, historyEnd - historyStart, 1 });
+            }
+        };
+
+        visitRecordPositions([&](std::uint64_t recordIndex, ParticleType type, float x, float y, bool isNewHistory) {
+            if (!inHistory || isNewHistory) {
+                if (inHistory) finishHistory(recordIndex);
+                inHistory = true;
+                historyStart = recordIndex;
+                hasParticle = false;
+                historyTile = grid.getTile(x, y); // until a particle other than a pseudo-particle is found
+                historyBounds = SpatialTile();
+            }
+            if (type == ParticleType::PseudoParticle) return;
+            if (!hasParticle) {
+                historyTile = grid.getTile(x, y);
+                hasParticle = true;
+            }
+            historyBounds.minX = std::min(historyBounds.minX, x);
+            historyBounds.maxX = std::max(historyBounds.maxX, x);
+            historyBounds.minY = std::min(historyBounds.minY, y);
+            historyBounds.maxY = std::max(historyBounds.maxY, y);
+        });
+        if (inHistory) finishHistory(particlesRead_);
+
+        std::vector<SpatialTile> sortedTiles;
+        sortedTiles.reserve(tiles.size());
+        for (auto & [code, tile] : tiles) sortedTiles.push_back(std::move(tile));
+        std::sort(sortedTiles.begin(), sortedTiles.end(), [](const SpatialTile & a, const SpatialTile & b) { return a.tile < b.tile; });
+        return SpatialIndex(grid, std::move(sortedTiles));
+    }
+
+    SpatialIndex PhaseSpaceFileReader::buildSpatialIndex(unsigned int level) {
+        if (level > SpatialGrid::MAXIMUM_LEVEL) {
+            throw std::invalid_argument("Spatial index grid level " + std::to_string(level) + " is above the maximum of " + std::to_string(SpatialGrid::MAXIMUM_LEVEL) + ".");
+        }
+
+        SpatialGrid grid;
+        grid.level = level;
+        grid.minX = grid.minY = std::numeric_limits<float>::max();
+        grid.maxX = grid.maxY = std::numeric_limits<float>::lowest();
+        visitRecordPositions([&grid](std::uint64_t, ParticleType type, float x, float y, bool) {
+            if (type == ParticleType::PseudoParticle) return;
+            grid.minX = std::min(grid.minX, x);
+            grid.maxX = std::max(grid.maxX, x);
+            grid.minY = std::min(grid.minY, y);
+            grid.maxY = std::max(grid.maxY, y);
+        });
+        if (grid.minX > grid.maxX) {
+            grid.minX = grid.maxX = grid.minY = grid.maxY = 0; // no particles
+        }
+        return buildSpatialIndex(grid);
     }
 
     const ByteBuffer PhaseSpaceFileReader::getHeaderData() {
@@ -132,13 +558,38 @@ namespace ParticleZoo
             throw std::runtime_error("File is not open when attempting to read header data.");
         }
 
+        if (file_.isStandardInput()) {
+            // Standard input cannot be read again, so the header is kept as it is read
+            if (headerSize > standardInputHeader_.size()) {
+                if (bytesRead_ != standardInputHeader_.size()) {
+                    throw std::runtime_error("The header of standard input can no longer be read once its particles are.");
+                }
+                ProfileTimer timer(profile_.ioSeconds, profiling_);
+                const std::size_t bytesCached = standardInputHeader_.size();
+                standardInputHeader_.resize(headerSize);
+                file_.read(reinterpret_cast<char*>(standardInputHeader_.data() + bytesCached), static_cast<std::streamsize>(headerSize - bytesCached));
+                const std::size_t bytesThisRead = static_cast<std::size_t>(file_.gcount());
+                standardInputHeader_.resize(bytesCached + bytesThisRead);
+                countBytesRead(bytesThisRead);
+                bytesRead_ += bytesThisRead;
+                if (standardInputHeader_.size() < headerSize) {
+                    throw std::runtime_error("Insufficient header data: expected " +
+                                             std::to_string(headerSize) + " bytes, got " +
+                                             std::to_string(standardInputHeader_.size()) + " bytes.");
+                }
+            }
+            return ByteBuffer(std::span<const byte>(standardInputHeader_.data(), headerSize), buffer_.getByteOrder());
+        }
+
         std::streampos currentPos = file_.tellg();
 
+        ProfileTimer timer(profile_.ioSeconds, profiling_);
         file_.seekg(0);
         ByteBuffer firstBlock(headerSize, buffer_.getByteOrder());
         
         // Attempt to read header data and capture actual bytes read.
         std::size_t bytesReadHeader = firstBlock.appendData(file_);
+        countBytesRead(bytesReadHeader);
         if (bytesReadHeader < headerSize) {
             throw std::runtime_error("Insufficient header data: expected " +
                                      std::to_string(headerSize) + " bytes, got " +
@@ -157,6 +608,49 @@ namespace ParticleZoo
         }
 
         std::size_t particleRecordStartOffset = getParticleRecordStartOffset();
+        ProfileTimer timer(profile_.ioSeconds, profiling_);
+
+        if (useMemoryMap_) {
+            // Map the whole file once, or share the mapping of another reader, and view it in place, it never needs to be refilled
+            std::uint64_t startOffset = std::max<std::uint64_t>(bytesRead_, particleRecordStartOffset);
+            ByteOrder byteOrder = buffer_.getByteOrder();
+            if (userOptions_.contains(SharedCacheCommand)) {
+                const std::string cacheDirectory = userOptions_.contains(SharedCacheDirectoryCommand) ? std::get<std::string>(userOptions_.at(SharedCacheDirectoryCommand).front()) : std::string{};
+                mappedFile_ = MapCachedFile(fileName_, cacheDirectory);
+            } else {
+                mappedFile_ = MapSharedFile(fileName_);
+            }
+            if (mappedFile_->size() != bytesInFile_) {
+                throw std::runtime_error("File size changed while opening memory mapping for: " + fileName_);
+            }
+            buffer_ = ByteBuffer::view(mappedFile_->data(), byteOrder);
+            buffer_.moveTo(static_cast<std::size_t>(startOffset));
+            countBlockRead(bytesInFile_ - startOffset); // the pages are only read when the records are decoded
+            bytesRead_ = bytesInFile_;
+            return;
+        }
+
+        if (file_.isStandardInput()) {
+            if (bytesRead_ < particleRecordStartOffset) {
+                // Pass over the rest of the header, which cannot be seeked past
+                file_.ignore(static_cast<std::streamsize>(particleRecordStartOffset - bytesRead_));
+                bytesRead_ += static_cast<std::uint64_t>(file_.gcount());
+                if (bytesRead_ < particleRecordStartOffset) {
+                    throw std::runtime_error("Standard input ended before the start of the particle records.");
+                }
+            }
+            buffer_.compact();
+            if (buffer_.remainingToWrite() > 0 && file_.peek() != std::char_traits<char>::eof()) {
+                std::size_t bytesThisRead = buffer_.appendData(file_);
+                countBlockRead(bytesThisRead);
+                bytesRead_ += bytesThisRead;
+            }
+            if (file_.eof()) {
+                bytesInFile_ = bytesRead_; // the size is now known, so reading stops at the end of the data
+                file_.clear();
+            }
+            return;
+        }
 
         if (bytesRead_ < particleRecordStartOffset) {
             // Skip to the start of the next particle record
@@ -166,24 +660,50 @@ namespace ParticleZoo
             }
             bytesRead_ = particleRecordStartOffset;
             buffer_.clear();
+            prefetcher_.reset();
         }
 
         // shift any unread data to the front of the buffer
         buffer_.compact();
 
+        if (prefetchDepth_ > 0) {
+            // Take the next block already read by the background thread, starting it if necessary
+            if (!prefetcher_) {
+                prefetcher_ = std::make_unique<BlockPrefetcher>(fileName_, bytesRead_, bytesInFile_, prefetchBlockSize_, prefetchDepth_);
+            }
+            std::size_t bytesThisRead = prefetcher_->appendNextBlock(buffer_);
+            if (bytesThisRead == 0) {
+                throw std::runtime_error("Failed to read any data from file: " + fileName_);
+            }
+            countBlockRead(bytesThisRead);
+            bytesRead_ += bytesThisRead;
+            return;
+        }
+
         // Read blockSize bytes (or less at EOF) directly into buffer_
         std::size_t bytesThisRead = buffer_.appendData(file_);
         if (bytesThisRead == 0) {
             throw std::runtime_error("Failed to read any data from file: " + fileName_);
         }
+        countBlockRead(bytesThisRead);
         bytesRead_ += bytesThisRead;
     }
 
     bool PhaseSpaceFileReader::hasMoreParticles() {
-        if (numberOfParticlesToRead_ == 0) numberOfParticlesToRead_ = getNumberOfEntriesInFile();
+        if (numberOfParticlesToRead_ == 0) {
+            numberOfParticlesToRead_ = file_.isStandardInput() ? std::numeric_limits<std::uint64_t>::max() : getNumberOfEntriesInFile();
+            // The records skipped to get here may include metadata-only ones, in which case the particles are read up to those closing the file
+            readsToParticleRecordsEnd_ = false;
+            if (particlesSkipped_ > 0) {
+                if (std::optional<std::uint64_t> trailingMetadataRecords = getNumberOfTrailingMetadataRecords()) {
+                    numberOfParticlesToRead_ -= std::min(*trailingMetadataRecords, numberOfParticlesToRead_);
+                    readsToParticleRecordsEnd_ = true;
+                }
+            }
+        }
 
         std::uint64_t legitParticlesRead = particlesRead_ - metaparticlesRead_;
-        std::uint64_t nominalTotalParticles = getNumberOfParticles();
+        std::uint64_t nominalTotalParticles = getParticleLimit();
 
         if (legitParticlesRead >= nominalTotalParticles || particlesRead_ >= numberOfParticlesToRead_) {
             return false; // No more particles to read
@@ -192,15 +712,98 @@ namespace ParticleZoo
             case FormatType::BINARY:
                 return bytesInFile_ - bytesRead_ + buffer_.remainingToRead() >= getParticleRecordLength();
             case FormatType::ASCII:
-                if (asciiLineBuffer_.empty()) {
+                if (!hasASCIILine_) {
                     bufferNextASCIILine();
                 }
-                return !asciiLineBuffer_.empty();
+                return hasASCIILine_;
             default:
                 return true; // For NONE format, previous check of particlesRead_ >= numberOfParticlesToRead_ is sufficient
         }
     }
 
+    bool PhaseSpaceFileReader::isASCIIRecordLine(std::string_view line) const {
+        const std::size_t pos = line.find_first_not_of(" \t");
+        if (pos == std::string_view::npos) {
+            return false; // Empty line
+        }
+        for (auto& marker : asciiCommentMarkers_) {
+            auto mlen = marker.size();
+            if (line.size() >= pos + mlen &&
+                std::memcmp(line.data() + pos, marker.data(), mlen) == 0)
+            {
+                return false; // Comment line
+            }
+        }
+        return true;
+    }
+
+    void PhaseSpaceFileReader::indexASCIIRecordsUpTo(std::uint64_t particleIndex) {
+        const std::size_t entriesNeeded = static_cast<std::size_t>(particleIndex / ASCII_INDEX_STRIDE) + 1;
+        if (asciiRecordOffsets_.size() < entriesNeeded && asciiIndexScanOffset_ < bytesInFile_) {
+            scanASCIIRecordOffsets(entriesNeeded);
+        }
+        if (asciiRecordOffsets_.empty()) {
+            throw std::out_of_range("Attempted to seek beyond end of file.");
+        }
+    }
+
+    void PhaseSpaceFileReader::scanASCIIRecordOffsets(std::size_t entriesNeeded) {
+        // Only line ends are looked for, so this is far cheaper than reading the records. Records are
+        // told apart from blank and comment lines the same way as bufferNextASCIILine() does it.
+        if (asciiIndexScanOffset_ < getParticleRecordStartOffset()) {
+            asciiIndexScanOffset_ = getParticleRecordStartOffset();
+        }
+        file_.clear();
+        file_.seekg(static_cast<std::streamoff>(asciiIndexScanOffset_), std::ios::beg);
+        if (file_.fail()) {
+            throw std::runtime_error("Failed to seek while indexing file: " + fileName_);
+        }
+
+        std::vector<char> block(std::max<std::size_t>(static_cast<std::size_t>(BUFFER_SIZE), 2 * getMaximumASCIILineLength()));
+        std::size_t blockLength = 0;
+        std::uint64_t blockOffset = asciiIndexScanOffset_; // file offset of the start of the block
+        while (asciiRecordOffsets_.size() < entriesNeeded && blockOffset + blockLength < bytesInFile_) {
+            if (blockLength == block.size()) {
+                block.resize(block.size() * 2); // a single line longer than the block
+            }
+            {
+                ProfileTimer timer(profile_.ioSeconds, profiling_);
+                file_.read(block.data() + blockLength, static_cast<std::streamsize>(block.size() - blockLength));
+            }
+            const std::size_t bytesThisRead = static_cast<std::size_t>(file_.gcount());
+            if (bytesThisRead == 0) {
+                throw std::runtime_error("Failed to read any data while indexing file: " + fileName_);
+            }
+            countBlockRead(bytesThisRead);
+            blockLength += bytesThisRead;
+
+            std::size_t lineStart = 0;
+            while (asciiRecordOffsets_.size() < entriesNeeded) {
+                const char * newline = static_cast<const char*>(std::memchr(block.data() + lineStart, '\n', blockLength - lineStart));
+                if (!newline) break; // the rest of the line is in the next block
+                std::size_t lineLength = static_cast<std::size_t>(newline - block.data()) - lineStart;
+                const std::size_t nextLineStart = lineStart + lineLength + 1;
+                if (lineLength > 0 && block[lineStart + lineLength - 1] == '\r') {
+                    lineLength--;
+                }
+                if (isASCIIRecordLine(std::string_view(block.data() + lineStart, lineLength))) {
+                    if (asciiIndexRecordsScanned_ % ASCII_INDEX_STRIDE == 0) {
+                        asciiRecordOffsets_.push_back(blockOffset + lineStart);
+                    }
+                    asciiIndexRecordsScanned_++;
+                }
+                lineStart = nextLineStart;
+            }
+
+            // keep any partial line for the next block
+            std::memmove(block.data(), block.data() + lineStart, blockLength - lineStart);
+            blockLength -= lineStart;
+            blockOffset += lineStart;
+        }
+        asciiIndexScanOffset_ = asciiRecordOffsets_.size() >= entriesNeeded ? blockOffset : bytesInFile_; // a last line without a newline is not a record
+        file_.clear(); // reading the last block may have hit the end of the file
+    }
+
     void PhaseSpaceFileReader::bufferNextASCIILine() {
         std::size_t remainingToRead = buffer_.remainingToRead();
         std::size_t maxASCIILength = getMaximumASCIILineLength();
@@ -209,33 +812,21 @@ namespace ParticleZoo
             readNextBlock();
         }
 
-        std::string line;
-        size_t pos;
-        bool isComment = false;
-        while (buffer_.remainingToRead() > 0 && (line.empty() || isComment)) {
+        // The line is left in the buffer and only viewed, this is safe because the buffer is not
+        // refilled again until the line has been read and the next one is needed
+        std::string_view line;
+        bool isRecord = false;
+        while (buffer_.remainingToRead() > 0 && !isRecord) {
             if (buffer_.remainingToRead() < maxASCIILength && bytesRead_ < bytesInFile_) {
                 readNextBlock();
             }
-            line = buffer_.readLine();
-            pos = line.find_first_not_of(" \t");
-            if (pos == std::string::npos) {
-                line.clear(); // Empty line, continue to next iteration
-                continue;
-            }
-            isComment = false;
-            for (auto& marker : asciiCommentMarkers_) {
-                auto mlen = marker.size();
-                if (line.size() >= pos + mlen &&
-                    std::memcmp(line.data() + pos, marker.data(), mlen) == 0)
-                {
-                    isComment = true;
-                    break;
-                }
-            }
+            line = buffer_.readLineView();
+            isRecord = isASCIIRecordLine(line);
         }
 
-        if (!line.empty()) {
-            asciiLineBuffer_.push_back(line);
+        if (isRecord) {
+            asciiLine_ = line;
+            hasASCIILine_ = true;
         }
     }
 
@@ -248,26 +839,18 @@ namespace ParticleZoo
                 case (FormatType::BINARY): // Binary format
                     {                        
                         if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
-                        // Read the next block of data if necessary
-                        if (buffer_.length() == 0 || buffer_.remainingToRead() < particleRecordLength_) {
-                            readNextBlock();
-                        }
-
-                        // Get a view of the next particle record in the buffer
-                        std::span<const ParticleZoo::byte> recordView = buffer_.readBytes(particleRecordLength_);
-                        ByteBuffer particleData(recordView, buffer_.getByteOrder());
-                        
-                        // Read the next particle from the buffer
-                        return readBinaryParticle(particleData);
+                        return readNextBinaryRecord();
                     }
                     break;
                 case (FormatType::ASCII): // ASCII format
                     {
+                        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+                        profile_.particles++;
+                        profile_.particleObjects++;
                         try {
-                            if (asciiLineBuffer_.empty()) bufferNextASCIILine();
-                            std::string line = std::move(asciiLineBuffer_.front());
-                            asciiLineBuffer_.pop_front();
-                            return readASCIIParticle(line);
+                            if (!hasASCIILine_) bufferNextASCIILine();
+                            hasASCIILine_ = false;
+                            return readASCIIParticle(asciiLine_);
                         } catch (const std::runtime_error &e) {
                             throw std::runtime_error("Error reading line from file: " + std::string(e.what()));
                         }
@@ -276,12 +859,389 @@ namespace ParticleZoo
                 default: // NONE format
                     {
                         // For NONE format, all I/O needs to be implemented manually by the subclass.
+                        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+                        profile_.particles++;
+                        profile_.particleObjects++;
                         return readParticleManually();
                     }
                     break;
             }
         }();
 
+        updateReadStatistics(particle, countParticleInStatistics);
+
+        return particle;
+    }
+
+    template <typename ParticleSink>
+    std::size_t PhaseSpaceFileReader::readParticleBatch(std::size_t maxParticles, ParticleSink && sink) {
+        std::size_t particlesDecoded = 0;
+
+        if (formatType_ != FormatType::BINARY) {
+            // Records are not of a fixed size so they have to be parsed one at a time
+            while (particlesDecoded < maxParticles && hasMoreParticles()) {
+                sink(getNextParticle(true), particlesDecoded++);
+            }
+            return particlesDecoded;
+        }
+
+        if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
+
+        while (particlesDecoded < maxParticles && hasMoreParticles()) {
+            // Decode every whole record already in the buffer before going back through hasMoreParticles()
+            const std::uint64_t nominalTotalParticles = getParticleLimit();
+            do {
+                Particle particle = readNextBinaryRecord();
+                updateReadStatistics(particle, true);
+                sink(std::move(particle), particlesDecoded++);
+            } while (particlesDecoded < maxParticles
+                     && buffer_.remainingToRead() >= particleRecordLength_
+                     && particlesRead_ < numberOfParticlesToRead_
+                     && particlesRead_ - metaparticlesRead_ < nominalTotalParticles);
+        }
+
+        return particlesDecoded;
+    }
+
+    std::size_t PhaseSpaceFileReader::readParticles(std::span<Particle> particles) {
+        return readParticleBatch(particles.size(), [&particles](Particle && particle, std::size_t index) {
+            particles[index] = std::move(particle);
+        });
+    }
+
+    std::vector<Particle> PhaseSpaceFileReader::getNextParticles(std::size_t maxParticles) {
+        std::vector<Particle> particles(maxParticles);
+        std::size_t particlesDecoded = readParticles(particles);
+        particles.resize(particlesDecoded);
+        return particles;
+    }
+
+    std::size_t PhaseSpaceFileReader::readParticleBlock(ParticleBlock & block, std::size_t maxParticles) {
+        block.clear();
+        block.reserve(maxParticles);
+
+        std::size_t particlesDecoded = 0;
+        if (formatType_ == FormatType::BINARY && canReadBinaryParticleBlocks_ && readParticleDepth_ == 0) {
+            particlesDecoded = readBinaryRecordsIntoBlock(block, maxParticles);
+        }
+
+        // Formats without a batch decoder go through the per-particle path
+        if (particlesDecoded < maxParticles) {
+            particlesDecoded += readParticleBatch(maxParticles - particlesDecoded, [&block](Particle && particle, std::size_t) {
+                block.addParticle(particle);
+            });
+        }
+
+        return particlesDecoded;
+    }
+
+    template <typename ParticleSink>
+    std::size_t PhaseSpaceFileReader::readFilteredParticleBatch(std::size_t maxParticles, const ParticleFilter & filter, ParticleSink && sink) {
+        std::size_t particlesAccepted = 0;
+
+        // Count a decoded particle, which is already in the read statistics, as accepted or rejected
+        auto offerParticle = [&](Particle && particle) {
+            if (filter.accepts(particle)) {
+                if (rejectedHistoriesToCarry_ > 0) {
+                    particle.setIncrementalHistories(carryRejectedHistories(particle.isNewHistory(), particle.getIncrementalHistories()));
+                }
+                sink(std::move(particle), particlesAccepted++);
+            } else {
+                rejectParticle(particle.getType(), particle.isNewHistory(), particle.getIncrementalHistories());
+            }
+        };
+
+        if (formatType_ != FormatType::BINARY) {
+            // Records are not of a fixed size so they have to be parsed one at a time
+            while (particlesAccepted < maxParticles && hasMoreParticles()) {
+                if (particlesRead_ >= nextHistoryBlockStart_) {
+                    const std::uint64_t recordIndex = particlesRead_;
+                    skipRejectedHistoryBlocks(filter);
+                    if (particlesRead_ != recordIndex) continue; // moved past rejected blocks, check for the end of the file again
+                }
+                offerParticle(getNextParticle(true));
+            }
+            return particlesAccepted;
+        }
+
+        if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
+
+        RejectedRecord rejected;
+        while (particlesAccepted < maxParticles && hasMoreParticles()) {
+            // Go through every whole record already in the buffer before going back through hasMoreParticles()
+            const std::uint64_t nominalTotalParticles = getParticleLimit();
+            do {
+                if (particlesRead_ >= nextHistoryBlockStart_) {
+                    const std::uint64_t recordIndex = particlesRead_;
+                    skipRejectedHistoryBlocks(filter);
+                    if (particlesRead_ != recordIndex) break; // moved past rejected blocks, the buffer has to be refilled
+                }
+                if (buffer_.length() == 0 || buffer_.remainingToRead() < particleRecordLength_) {
+                    readNextBlock();
+                }
+
+                // Records the format can reject from their raw fields are passed over without being decoded
+                ByteBuffer record = ByteBuffer::view(buffer_.peekBytes(particleRecordLength_), buffer_.getByteOrder());
+                if (readParticleDepth_ == 0 && rejectBinaryRecord(record, filter, rejected)) {
+                    buffer_.readBytes(particleRecordLength_);
+                    countRejectedRecord(rejected);
+                    continue;
+                }
+
+                Particle particle = readNextBinaryRecord();
+                updateReadStatistics(particle, true);
+                offerParticle(std::move(particle));
+            } while (particlesAccepted < maxParticles
+                     && buffer_.remainingToRead() >= particleRecordLength_
+                     && particlesRead_ < numberOfParticlesToRead_
+                     && particlesRead_ - metaparticlesRead_ < nominalTotalParticles);
+        }
+
+        return particlesAccepted;
+    }
+
+    std::size_t PhaseSpaceFileReader::readParticles(std::span<Particle> particles, const ParticleFilter & filter) {
+        return readFilteredParticleBatch(particles.size(), filter, [&particles](Particle && particle, std::size_t index) {
+            particles[index] = std::move(particle);
+        });
+    }
+
+    std::vector<Particle> PhaseSpaceFileReader::getNextParticles(std::size_t maxParticles, const ParticleFilter & filter) {
+        std::vector<Particle> particles(maxParticles);
+        std::size_t particlesAccepted = readParticles(particles, filter);
+        particles.resize(particlesAccepted);
+        return particles;
+    }
+
+    std::size_t PhaseSpaceFileReader::readParticleBlock(ParticleBlock & block, std::size_t maxParticles, const ParticleFilter & filter) {
+        block.clear();
+        block.reserve(maxParticles);
+
+        std::size_t particlesAccepted = 0;
+        if (formatType_ == FormatType::BINARY && readParticleDepth_ == 0) {
+            // Decode the records in bulk, then drop the rows the filter rejects
+            std::vector<std::uint8_t> keep;
+            while (particlesAccepted < maxParticles && canReadBinaryParticleBlocks_) {
+                // Decode no further than the next block of histories, which may be passed over
+                if (particlesRead_ >= nextHistoryBlockStart_) skipRejectedHistoryBlocks(filter);
+                const std::uint64_t recordsBeforeNextHistoryBlock = nextHistoryBlockStart_ - particlesRead_;
+                const std::size_t firstParticle = block.size();
+                const std::size_t particlesDecoded = readBinaryRecordsIntoBlock(block, static_cast<std::size_t>(std::min<std::uint64_t>(maxParticles - particlesAccepted, recordsBeforeNextHistoryBlock)));
+                if (particlesDecoded == 0) break;
+
+                std::span<std::uint8_t> isNewHistory = block.getNewHistoryFlags();
+                std::span<std::uint32_t> incrementalHistories = block.getIncrementalHistories();
+                keep.assign(particlesDecoded, 0);
+                for (std::size_t i = 0; i < particlesDecoded; i++) {
+                    const std::size_t index = firstParticle + i;
+                    if (filter.accepts(block, index)) {
+                        if (rejectedHistoriesToCarry_ > 0) {
+                            incrementalHistories[index] = carryRejectedHistories(isNewHistory[index] != 0, incrementalHistories[index]);
+                            isNewHistory[index] = 1;
+                        }
+                        keep[i] = 1;
+                        particlesAccepted++;
+                    } else {
+                        rejectParticle(block.getTypes()[index], isNewHistory[index] != 0, incrementalHistories[index]);
+                    }
+                }
+                block.retainParticles(firstParticle, keep);
+            }
+        }
+
+        // Formats without a batch decoder go through the per-particle path
+        if (particlesAccepted < maxParticles) {
+            particlesAccepted += readFilteredParticleBatch(maxParticles - particlesAccepted, filter, [&block](Particle && particle, std::size_t) {
+                block.addParticle(particle);
+            });
+        }
+
+        return particlesAccepted;
+    }
+
+    void PhaseSpaceFileReader::countRejectedRecord(const RejectedRecord & record) {
+        // The same bookkeeping as updateReadStatistics() does for a decoded particle
+        bool isNewHistory = record.isNewHistory;
+        if (record.type == ParticleType::PseudoParticle) metaparticlesRead_++;
+        else if (isFirstParticle_) {
+            isNewHistory = true; // First real particle read always starts a new history
+            isFirstParticle_ = false;
+        }
+
+        if (isNewHistory) {
+            historiesRead_ += std::max<std::uint32_t>(record.incrementalHistories, 1);
+        }
+        particlesRead_++;
+
+        rejectParticle(record.type, isNewHistory, record.incrementalHistories);
+    }
+
+    void PhaseSpaceFileReader::skipRejectedHistoryBlocks(const ParticleFilter & filter) {
+        constexpr std::uint64_t NO_HISTORY_BLOCK = std::numeric_limits<std::uint64_t>::max();
+        loadHistoryIndex();
+        if (!historyIndex_ || !historyIndex_->hasBlockStatistics() || (formatType_ != FormatType::BINARY && formatType_ != FormatType::ASCII)) {
+            nextHistoryBlockStart_ = NO_HISTORY_BLOCK; // formats without a generic moveToParticle() read every record
+            return;
+        }
+
+        const HistoryIndex & index = *historyIndex_;
+        const std::size_t numberOfBlocks = index.getNumberOfBlocks();
+        std::size_t block = index.findBlockStartingFrom(particlesRead_);
+        if (block < numberOfBlocks && index.getBlockStart(block) == particlesRead_) {
+            // Gather the consecutive blocks from here in which the filter rejects every record
+            std::uint64_t recordsToSkip = 0;
+            std::uint64_t pseudoParticlesToSkip = 0;
+            std::uint64_t historiesToSkip = 0;
+            while (block < numberOfBlocks && index.getBlockStart(block) == particlesRead_ + recordsToSkip && !filter.mayAcceptAnyOf(index.getBlockStatistics(block))) {
+                const HistoryBlockStatistics & statistics = index.getBlockStatistics(block);
+                recordsToSkip += statistics.numberOfRecords;
+                pseudoParticlesToSkip += statistics.numberOfPseudoParticles;
+                historiesToSkip += statistics.numberOfHistories;
+                block++;
+            }
+
+            if (recordsToSkip > 0) {
+                // Count the records passed over as read and rejected, the same as reading them one by one would
+                const std::uint64_t recordIndex = particlesRead_ + recordsToSkip;
+                const std::uint64_t particlesSkipped = particlesSkipped_;
+                const std::uint64_t metaparticlesRead = metaparticlesRead_;
+                const std::uint64_t historiesRead = historiesRead_;
+                const bool isFirstParticle = isFirstParticle_ && recordsToSkip == pseudoParticlesToSkip;
+                const std::uint64_t particlesRejectedByFilter = particlesRejectedByFilter_;
+                const std::uint64_t rejectedHistoriesToCarry = rejectedHistoriesToCarry_;
+
+                if (numberOfParticlesToRead_ == 0) numberOfParticlesToRead_ = getNumberOfEntriesInFile();
+                if (recordIndex < numberOfParticlesToRead_) {
+                    moveToParticle(recordIndex);
+                } // otherwise the blocks run to the end of the file and there is nowhere to move to
+
+                particlesRead_ = recordIndex;
+                particlesSkipped_ = particlesSkipped;
+                metaparticlesRead_ = metaparticlesRead + pseudoParticlesToSkip;
+                historiesRead_ = historiesRead + historiesToSkip;
+                isFirstParticle_ = isFirstParticle;
+                particlesRejectedByFilter_ = particlesRejectedByFilter + recordsToSkip - pseudoParticlesToSkip;
+                rejectedHistoriesToCarry_ = rejectedHistoriesToCarry + historiesToSkip;
+            }
+
+            // The block now at the read position may hold accepted records, so it is read
+            if (block < numberOfBlocks && index.getBlockStart(block) == particlesRead_) block++;
+        }
+        nextHistoryBlockStart_ = block < numberOfBlocks ? index.getBlockStart(block) : NO_HISTORY_BLOCK;
+    }
+
+    void PhaseSpaceFileReader::rejectParticle(ParticleType type, bool isNewHistory, std::uint32_t incrementalHistories) {
+        if (type != ParticleType::PseudoParticle) particlesRejectedByFilter_++;
+        if (isNewHistory) {
+            rejectedHistoriesToCarry_ += std::max<std::uint32_t>(incrementalHistories, 1);
+        }
+    }
+
+    std::uint32_t PhaseSpaceFileReader::carryRejectedHistories(bool isNewHistory, std::uint32_t incrementalHistories) {
+        // The accepted particle starts a new history standing for its own history, if it starts one, and those rejected before it
+        const std::uint64_t histories = (isNewHistory ? std::max<std::uint32_t>(incrementalHistories, 1) : 0) + rejectedHistoriesToCarry_;
+        const std::uint32_t historiesCarried = static_cast<std::uint32_t>(std::min<std::uint64_t>(histories, std::numeric_limits<std::uint32_t>::max()));
+        rejectedHistoriesToCarry_ = histories - historiesCarried; // anything beyond what one particle can carry goes to the next
+        return historiesCarried;
+    }
+
+    std::size_t PhaseSpaceFileReader::readBinaryRecordsIntoBlock(ParticleBlock & block, std::size_t maxParticles) {
+        if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
+
+        std::size_t particlesDecoded = 0;
+        while (particlesDecoded < maxParticles && hasMoreParticles()) {
+            if (buffer_.length() == 0 || buffer_.remainingToRead() < particleRecordLength_) {
+                readNextBlock();
+            }
+
+            // Decode every whole record in the buffer at once, without going past the end of the particles to read
+            const std::uint64_t nominalTotalParticles = getParticleLimit();
+            const std::uint64_t recordsLeftToRead = std::min<std::uint64_t>(numberOfParticlesToRead_ - particlesRead_, nominalTotalParticles - (particlesRead_ - metaparticlesRead_));
+            const std::size_t numberOfRecords = static_cast<std::size_t>(std::min<std::uint64_t>({ maxParticles - particlesDecoded, buffer_.remainingToRead() / particleRecordLength_, recordsLeftToRead }));
+            if (numberOfRecords == 0) break;
+
+            ByteBuffer records = ByteBuffer::view(buffer_.peekBytes(numberOfRecords * particleRecordLength_), buffer_.getByteOrder());
+            const std::size_t firstParticle = block.size();
+            std::size_t recordsDecoded;
+            {
+                ProfileTimer timer(profile_.codingSeconds, profiling_);
+                recordsDecoded = readBinaryParticleBlock(records, numberOfRecords, block);
+            }
+            if (recordsDecoded == BINARY_PARTICLE_BLOCKS_UNSUPPORTED) {
+                // Not supported by this format, leave the records for the per-particle path
+                block.resize(firstParticle);
+                canReadBinaryParticleBlocks_ = false;
+                break;
+            }
+            const std::size_t particlesAppended = block.size() - firstParticle;
+            if (recordsDecoded > numberOfRecords || particlesAppended > recordsDecoded) {
+                throw std::runtime_error("readBinaryParticleBlock() must append at most one particle per record decoded.");
+            }
+
+            buffer_.readBytes(recordsDecoded * particleRecordLength_);
+            profile_.particles += recordsDecoded;
+            updateReadStatistics(block, firstParticle);
+            // records folded into the particles after them count as metaparticles, as when readBinaryParticle() reads on
+            particlesRead_ += recordsDecoded - particlesAppended;
+            metaparticlesRead_ += recordsDecoded - particlesAppended;
+            particlesDecoded += particlesAppended;
+
+            if (recordsDecoded < numberOfRecords) {
+                // The format left the next record to readBinaryParticle(), which may read further records
+                Particle particle = readNextBinaryRecord();
+                updateReadStatistics(particle, true);
+                block.addParticle(particle);
+                particlesDecoded++;
+            }
+        }
+
+        return particlesDecoded;
+    }
+
+    Particle PhaseSpaceFileReader::readNextBinaryRecord() {
+        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+        profile_.particles++;
+        profile_.particleObjects++;
+
+        // Read the next block of data if necessary
+        if (buffer_.length() == 0 || buffer_.remainingToRead() < particleRecordLength_) {
+            readNextBlock();
+        }
+
+        // Get a view of the next particle record in the buffer
+        std::span<const ParticleZoo::byte> recordView = buffer_.readBytes(particleRecordLength_);
+
+        readParticleDepth_++;
+
+        ByteBuffer * particleData;
+        std::unique_ptr<ByteBuffer> temporaryParticleData;
+        ByteBuffer mappedParticleData = ByteBuffer::view(recordView, buffer_.getByteOrder());
+        if (mappedFile_) {
+            // the mapped file is never refilled, so even nested reads can use the record in place
+            particleData = &mappedParticleData;
+        } else if (readParticleDepth_ == 1) {
+            // avoid allocating a new buffer for every record by reusing the record buffer
+            if (recordBuffer_.capacity() < particleRecordLength_) {
+                recordBuffer_ = ByteBuffer(particleRecordLength_, buffer_.getByteOrder());
+            }
+            recordBuffer_.setByteOrder(buffer_.getByteOrder());
+            recordBuffer_.setData(recordView);
+            particleData = &recordBuffer_;
+        } else {
+            // a nested read (e.g. a format skipping over a pseudo-particle) must not overwrite the record still in use
+            temporaryParticleData = std::make_unique<ByteBuffer>(recordView, buffer_.getByteOrder());
+            particleData = temporaryParticleData.get();
+        }
+
+        // Read the next particle from the buffer
+        Particle particle = readBinaryParticle(*particleData);
+
+        readParticleDepth_--;
+
+        return particle;
+    }
+
+    void PhaseSpaceFileReader::updateReadStatistics(Particle & particle, bool countParticleInStatistics) {
         if (countParticleInStatistics) {
             if (particle.getType() == ParticleType::PseudoParticle) metaparticlesRead_++;
             else if (isFirstParticle_) {
@@ -305,8 +1265,32 @@ namespace ParticleZoo
             metaparticlesRead_++;
         }
         particlesRead_++;
+    }
 
-        return particle;
+    void PhaseSpaceFileReader::updateReadStatistics(ParticleBlock & block, std::size_t firstParticle) {
+        std::span<const ParticleType> types = std::as_const(block).getTypes();
+        std::span<std::uint8_t> isNewHistory = block.getNewHistoryFlags();
+        std::span<std::uint32_t> incrementalHistories = block.getIncrementalHistories();
+
+        for (std::size_t i = firstParticle; i < block.size(); i++) {
+            if (types[i] == ParticleType::PseudoParticle) metaparticlesRead_++;
+            else if (isFirstParticle_) {
+                // First real particle read always starts a new history
+                isNewHistory[i] = 1;
+                if (incrementalHistories[i] == 0) incrementalHistories[i] = 1;
+                isFirstParticle_ = false;
+            }
+
+            if (isNewHistory[i]) {
+                int deltaN = (int) incrementalHistories[i];
+                if (deltaN > 0) {
+                    historiesRead_ += static_cast<std::uint64_t>(deltaN);
+                } else {
+                    historiesRead_++;
+                }
+            }
+            particlesRead_++;
+        }
     }
 
     Particle PhaseSpaceFileReader::peekNextParticle() {
@@ -318,25 +1302,55 @@ namespace ParticleZoo
                 case (FormatType::BINARY): // Binary format
                     {                        
                         if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
-                        // Read the next block of data if necessary
-                        if (buffer_.length() == 0 || buffer_.remainingToRead() < particleRecordLength_) {
+                        // Read the next block of data if necessary, keeping a record after the next one in the buffer
+                        // so that a record folded into the particle (e.g. a TOPAS pseudo-particle) does not refill it
+                        if (buffer_.length() == 0 || (buffer_.remainingToRead() < 2 * particleRecordLength_ && bytesRead_ < bytesInFile_)) {
                             readNextBlock();
                         }
 
-                        // Get a view of the next particle record in the buffer without advancing the read position
-                        std::span<const ParticleZoo::byte> recordView = buffer_.peekBytes(particleRecordLength_);
-                        ByteBuffer particleData(recordView, buffer_.getByteOrder());
-                        
-                        // Read the next particle from the buffer
-                        return readBinaryParticle(particleData);
+                        // Read the particle as getNextParticle() would, along with any records folded into it, then go back to it.
+                        // The particle is only counted in the profile once it is consumed.
+                        const std::uint64_t recordFileOffset = bytesRead_ - buffer_.remainingToRead();
+                        const std::uint64_t profiledParticles = profile_.particles;
+                        const std::uint64_t profiledParticleObjects = profile_.particleObjects;
+                        const std::uint64_t particlesRead = particlesRead_;
+                        const std::uint64_t metaparticlesRead = metaparticlesRead_;
+                        const std::uint64_t historiesRead = historiesRead_;
+                        const bool isFirstParticle = isFirstParticle_;
+
+                        Particle particle = readNextBinaryRecord();
+
+                        particlesRead_ = particlesRead;
+                        metaparticlesRead_ = metaparticlesRead;
+                        historiesRead_ = historiesRead;
+                        isFirstParticle_ = isFirstParticle;
+                        profile_.particles = profiledParticles;
+                        profile_.particleObjects = profiledParticleObjects;
+                        const std::uint64_t bufferFileOffset = bytesRead_ - buffer_.length();
+                        if (recordFileOffset >= bufferFileOffset) {
+                            buffer_.moveTo(static_cast<std::size_t>(recordFileOffset - bufferFileOffset));
+                        } else if (file_.isStandardInput()) {
+                            throw std::runtime_error("Cannot peek at a particle read along with records beyond the read buffer in standard input.");
+                        } else {
+                            // The buffer was refilled past the record, so read it from the file again
+                            prefetcher_.reset();
+                            file_.clear();
+                            file_.seekg(static_cast<std::streamoff>(recordFileOffset), std::ios::beg);
+                            if (file_.fail()) {
+                                throw std::runtime_error("Failed to seek back to the peeked particle in file: " + fileName_);
+                            }
+                            buffer_.clear();
+                            bytesRead_ = recordFileOffset;
+                        }
+                        return particle;
                     }
                     break;
                 case (FormatType::ASCII): // ASCII format
                     {
+                        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
                         try {
-                            if (asciiLineBuffer_.empty()) bufferNextASCIILine();
-                            std::string line = asciiLineBuffer_.front(); // Peek without popping
-                            return readASCIIParticle(line);
+                            if (!hasASCIILine_) bufferNextASCIILine();
+                            return readASCIIParticle(asciiLine_); // Peek, the line stays pending
                         } catch (const std::runtime_error &e) {
                             throw std::runtime_error("Error reading line from file: " + std::string(e.what()));
                         }
@@ -345,6 +1359,7 @@ namespace ParticleZoo
                 default: // NONE format
                     {
                         // For NONE format, all I/O needs to be implemented manually by the subclass.
+                        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
                         return peekParticleManually();
                     }
                     break;
@@ -1,4 +1,9 @@
 #include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/utilities/transcoders.h"
+
+#include <algorithm>
+#include <utility>
 
 namespace ParticleZoo
 {
@@ -13,6 +18,8 @@ namespace ParticleZoo
     CLICommand FlipXDirectionCommand{ WRITER, "", "flipX", "Flip the X direction of all particles", {} };
     CLICommand FlipYDirectionCommand{ WRITER, "", "flipY", "Flip the Y direction of all particles", {} };
     CLICommand FlipZDirectionCommand{ WRITER, "", "flipZ", "Flip the Z direction of all particles", {} };
+    CLICommand BackgroundFlushCommand{ WRITER, "", "backgroundFlush", "Write output phase space files on a background I/O thread, keeping up to this many full buffers queued", { CLI_UINT } };
+    CLICommand OutputHeaderCommand{ WRITER, "", "outputHeader", "Path of the header file to write when the output phase space is written to standard output (-)", { CLI_STRING } };
 
 
     std::vector<CLICommand> PhaseSpaceFileWriter::getCLICommands() {
@@ -20,22 +27,40 @@ namespace ParticleZoo
                  ConstantXCommand, ConstantYCommand, ConstantZCommand,
                  ConstantPxCommand, ConstantPyCommand, ConstantPzCommand,
                  ConstantWeightCommand,
-                 FlipXDirectionCommand, FlipYDirectionCommand, FlipZDirectionCommand
+                 FlipXDirectionCommand, FlipYDirectionCommand, FlipZDirectionCommand,
+                 BackgroundFlushCommand,
+                 OutputHeaderCommand
                };
     }
 
 
+    std::string PhaseSpaceFileWriter::getHeaderFileSource(const std::string & fileName, const UserOptions & userOptions) {
+        if (!IsStandardStream(fileName)) {
+            return fileName;
+        }
+        if (!userOptions.contains(OutputHeaderCommand)) {
+            throw std::runtime_error("A header file must be given with --" + OutputHeaderCommand.longName + " to write this format to standard output.");
+        }
+        return std::get<std::string>(userOptions.at(OutputHeaderCommand).front());
+    }
+
+
     PhaseSpaceFileWriter::PhaseSpaceFileWriter(const std::string & phspFormat, const std::string & fileName, const UserOptions & userOptions, FormatType formatType, const FixedValues fixedValues, unsigned int bufferSize)
     : phspFormat_(phspFormat),
       fileName_(fileName),
       userOptions_(userOptions),
       BUFFER_SIZE(bufferSize),
       formatType_(formatType),
+      flushQueueDepth_([&]() -> std::size_t {
+            if (formatType_ == FormatType::NONE || !userOptions_.contains(BackgroundFlushCommand)) return 0;
+            return std::get<unsigned int>(userOptions_.at(BackgroundFlushCommand).front());
+        }()),
+      profiling_(userOptions_.contains(ProfileCommand)),
       file_([&]() {
             if (formatType_ == FormatType::NONE) {
-                return std::ofstream{};
+                return OutputFileStream{};
             } else {
-                return std::ofstream(fileName, std::ios::binary);
+                return OutputFileStream(fileName);
             }
         }()),
       historiesWritten_(0),
@@ -49,6 +74,9 @@ namespace ParticleZoo
       flipYDirection_(false),
       flipZDirection_(false)
     {
+        if (formatType == FormatType::NONE && IsStandardStream(fileName_)) {
+            throw std::runtime_error("The " + phspFormat_ + " format cannot be written to standard output.");
+        }
         if (formatType != FormatType::NONE && !file_.is_open())
         {
             throw std::runtime_error("Failed to open file: " + fileName_);
@@ -101,8 +129,17 @@ namespace ParticleZoo
     void PhaseSpaceFileWriter::close() {
         historiesWritten_ += historiesToAccountFor_;
         historiesToAccountFor_ = 0;
+        if (formatType_ == FormatType::NONE) {
+            closeManually();
+        }
         if (file_.is_open()) {
             writeNextBlock();
+            if (flusher_) {
+                // the header is written by seeking the stream, so every queued buffer must be written first
+                ProfileTimer timer(profile_.ioSeconds, profiling_);
+                flusher_->drain();
+                flusher_.reset();
+            }
             writeHeaderToFile();
             file_.flush();
             file_.close();
@@ -110,6 +147,263 @@ namespace ParticleZoo
     }
 
 
+    void PhaseSpaceFileWriter::appendRecordsFrom(const PhaseSpaceFileWriter & other) {
+        if (other.phspFormat_ != phspFormat_ || other.formatType_ != formatType_) {
+            throw std::runtime_error("Cannot append a " + other.phspFormat_ + " file to a " + phspFormat_ + " file.");
+        }
+        if (formatType_ != FormatType::NONE) { // writers doing their own I/O check their files in appendRecordsManually()
+            if (other.file_.is_open()) {
+                throw std::runtime_error("The writer of " + other.fileName_ + " must be closed before its records can be appended.");
+            }
+            if (!file_.is_open()) {
+                throw std::runtime_error("File is not open when attempting to append records.");
+            }
+        }
+        if (other.fixedValues_ != fixedValues_) {
+            throw std::runtime_error("Cannot append " + other.fileName_ + " to " + fileName_ + " since their constant values differ.");
+        }
+        if (formatType_ == FormatType::BINARY && other.getParticleRecordLength() != getParticleRecordLength()) {
+            throw std::runtime_error("Cannot append " + other.fileName_ + " to " + fileName_ + " since their record lengths differ.");
+        }
+        if (other.particlesWritten_ > getMaximumSupportedParticles() - std::min(particlesWritten_, getMaximumSupportedParticles())) {
+            throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(getMaximumSupportedParticles()) + ").");
+        }
+
+        // The copied records cannot carry pending empty histories, so they are counted ahead of them
+        historiesWritten_ += historiesToAccountFor_;
+        historiesToAccountFor_ = 0;
+
+        mergeStatisticsFrom(other);
+        if (formatType_ == FormatType::NONE) {
+            appendRecordsManually(other);
+        } else {
+            copyRecordsFrom(other.fileName_, other.getParticleRecordStartOffset());
+        }
+
+        historiesWritten_ += other.historiesWritten_;
+        particlesWritten_ += other.particlesWritten_;
+    }
+
+
+    bool PhaseSpaceFileWriter::canAppendRecordsFrom(const PhaseSpaceFileReader & reader) const {
+        if (formatType_ == FormatType::NONE || reader.getPHSPFormat() != phspFormat_ || reader.getFormatType() != formatType_) {
+            return false;
+        }
+        // The records are copied by opening the file again, which standard input cannot be
+        if (IsStandardStream(reader.getFileName())) {
+            return false;
+        }
+        // Directions are flipped as particles are written, which copied records would miss
+        if (flipXDirection_ || flipYDirection_ || flipZDirection_) {
+            return false;
+        }
+        if (formatType_ == FormatType::BINARY) {
+            // Every byte after the header must belong to a record of the same length as this writer's
+            const std::size_t recordLength = reader.getParticleRecordLength();
+            if (recordLength != getParticleRecordLength()) {
+                return false;
+            }
+            const std::uint64_t recordBytes = static_cast<std::uint64_t>(reader.getNumberOfEntriesInFile()) * recordLength;
+            if (reader.getFileSize() != reader.getParticleRecordStartOffset() + recordBytes) {
+                return false;
+            }
+        }
+        return hasSameRecordLayout(reader);
+    }
+
+
+    void PhaseSpaceFileWriter::appendRecordsFrom(const PhaseSpaceFileReader & reader) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("File is not open when attempting to append records.");
+        }
+        if (!canAppendRecordsFrom(reader)) {
+            throw std::runtime_error("The records of " + reader.getFileName() + " cannot be copied into " + fileName_ + " since their formats or record layouts differ.");
+        }
+        if (reader.getNumberOfParticles() > getMaximumSupportedParticles() - std::min(particlesWritten_, getMaximumSupportedParticles())) {
+            throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(getMaximumSupportedParticles()) + ").");
+        }
+
+        // The copied records cannot carry pending empty histories, so they are counted ahead of them
+        historiesWritten_ += historiesToAccountFor_;
+        historiesToAccountFor_ = 0;
+
+        mergeStatisticsFrom(reader);
+        copyRecordsFrom(reader.getFileName(), reader.getParticleRecordStartOffset());
+
+        historiesWritten_ += reader.getNumberOfOriginalHistories();
+        particlesWritten_ += reader.getNumberOfParticles();
+    }
+
+
+    void PhaseSpaceFileWriter::appendRecordsFrom(PhaseSpaceFileReader & reader, std::uint64_t firstRecord, std::uint64_t numberOfRecords) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("File is not open when attempting to append records.");
+        }
+        if (!canAppendRecordsFrom(reader)) {
+            throw std::runtime_error("The records of " + reader.getFileName() + " cannot be copied into " + fileName_ + " since their formats or record layouts differ.");
+        }
+        if (formatType_ != FormatType::BINARY) {
+            throw std::runtime_error("Ranges of records can only be copied for formats with fixed length binary records.");
+        }
+        const std::uint64_t recordsInFile = reader.getNumberOfEntriesInFile();
+        if (firstRecord > recordsInFile) {
+            throw std::out_of_range("Record index " + std::to_string(firstRecord) + " is beyond the end of " + reader.getFileName() + ".");
+        }
+        const std::uint64_t endRecord = firstRecord + std::min(numberOfRecords, recordsInFile - firstRecord);
+        if (endRecord == firstRecord) {
+            return;
+        }
+
+        // The copied records cannot carry pending empty histories, so they are counted ahead of them
+        historiesWritten_ += historiesToAccountFor_;
+        historiesToAccountFor_ = 0;
+
+        // The header statistics of a part of a file are not known, so the particles are read to count them
+        reader.moveToParticle(firstRecord);
+        while (reader.getNextRecordIndex() < endRecord && reader.hasMoreParticles()) {
+            const Particle particle = reader.getNextParticle();
+            if (particle.getType() != ParticleType::PseudoParticle) {
+                if (particlesWritten_ >= getMaximumSupportedParticles()) {
+                    throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(getMaximumSupportedParticles()) + ").");
+                }
+                particlesWritten_++;
+            }
+            if (particle.isNewHistory()) {
+                historiesWritten_ += particle.getIncrementalHistories();
+            }
+            countParticleStats(particle);
+        }
+
+        // Records folded into the last particle may run past the range, and metadata-only records closing the file are not read at all
+        const std::uint64_t recordsCopied = std::max(reader.getNextRecordIndex(), endRecord) - firstRecord;
+        const std::uint64_t recordLength = getParticleRecordLength();
+        copyRecordsFrom(reader.getFileName(), reader.getParticleRecordStartOffset() + firstRecord * recordLength, recordsCopied * recordLength);
+    }
+
+
+    std::uint64_t PhaseSpaceFileWriter::transcodeParticlesFrom(PhaseSpaceFileReader & reader, RecordTranscoder & transcoder, std::uint64_t maxRecords) {
+        if (!file_.is_open()) {
+            throw std::runtime_error("File is not open when attempting to transcode particles.");
+        }
+        if (formatType_ != FormatType::BINARY || reader.formatType_ != FormatType::BINARY) {
+            throw std::runtime_error("Records can only be transcoded between formats with fixed length binary records.");
+        }
+
+        // Directions changed by this writer have to be checked or flipped particle by particle
+        const bool writeOneAtATime = flipXDirection_ || flipYDirection_ || flipZDirection_
+                                  || fixedValues_.pxIsConstant || fixedValues_.pyIsConstant || fixedValues_.pzIsConstant;
+
+        if (particleRecordLength_ == 0) particleRecordLength_ = getParticleRecordLength();
+        if (reader.particleRecordLength_ == 0) reader.particleRecordLength_ = reader.getParticleRecordLength();
+        const std::size_t inputRecordLength = reader.particleRecordLength_;
+
+        // Batches start small and double while the transcoder takes all of them, so that one stopping early every few records does not decode the whole buffer each time
+        constexpr std::size_t MINIMUM_BATCH_RECORDS = 64;
+        std::size_t batchRecords = MINIMUM_BATCH_RECORDS;
+
+        const std::uint64_t firstRecordRead = reader.particlesRead_;
+        while (reader.particlesRead_ - firstRecordRead < maxRecords && reader.hasMoreParticles()) {
+            // The first particle is made to start a history and pending empty histories are added to the next particle
+            if (writeOneAtATime || reader.isFirstParticle_ || getPendingHistories() > 0) {
+                writeParticle(reader.getNextParticle());
+                continue;
+            }
+
+            if (reader.buffer_.length() == 0 || reader.buffer_.remainingToRead() < inputRecordLength) {
+                reader.readNextBlock();
+            }
+            if (buffer_.remainingToWrite() < particleRecordLength_) {
+                writeNextBlock();
+            }
+
+            // Transcode every whole record in the reader's buffer that fits in the write buffer, without going past the end of the particles to read
+            const std::uint64_t nominalTotalParticles = reader.getParticleLimit();
+            const std::uint64_t recordsLeftToRead = std::min<std::uint64_t>(reader.numberOfParticlesToRead_ - reader.particlesRead_, nominalTotalParticles - (reader.particlesRead_ - reader.metaparticlesRead_));
+            const std::size_t numberOfRecords = static_cast<std::size_t>(std::min<std::uint64_t>({ maxRecords - (reader.particlesRead_ - firstRecordRead),
+                                                                                                  batchRecords,
+                                                                                                  reader.buffer_.remainingToRead() / inputRecordLength,
+                                                                                                  buffer_.remainingToWrite() / particleRecordLength_,
+                                                                                                  recordsLeftToRead,
+                                                                                                  getMaximumSupportedParticles() - particlesWritten_ }));
+            if (numberOfRecords == 0) {
+                writeParticle(reader.getNextParticle());
+                continue;
+            }
+
+            ByteBuffer records = ByteBuffer::view(reader.buffer_.peekBytes(numberOfRecords * inputRecordLength), reader.buffer_.getByteOrder());
+            // The write buffer is appended to, so its offset is moved to the end of its data while the transcoder writes there
+            const std::size_t lengthBefore = buffer_.length();
+            const std::size_t offsetBefore = lengthBefore - buffer_.remainingToRead();
+            transcodedParticles_.clear();
+            std::size_t recordsTranscoded;
+            {
+                ProfileTimer timer(profile_.codingSeconds, profiling_);
+                buffer_.moveTo(lengthBefore);
+                recordsTranscoded = transcoder.transcodeRecords(records, inputRecordLength, numberOfRecords, buffer_, transcodedParticles_);
+                buffer_.moveTo(offsetBefore);
+            }
+            if (recordsTranscoded > numberOfRecords || transcodedParticles_.size() != recordsTranscoded || buffer_.length() - lengthBefore != recordsTranscoded * particleRecordLength_) {
+                throw std::runtime_error("transcodeRecords() must write one record and describe one particle per record transcoded.");
+            }
+
+            // Count the records as read, as readBinaryRecordsIntoBlock() does
+            reader.buffer_.readBytes(recordsTranscoded * inputRecordLength);
+            reader.profile_.particles += recordsTranscoded;
+            reader.updateReadStatistics(transcodedParticles_, 0);
+
+            // Count the particles as written, with the constant values of this writer as writeParticle() sets them
+            std::span<float> xs = transcodedParticles_.getXPositions();
+            std::span<float> ys = transcodedParticles_.getYPositions();
+            std::span<float> zs = transcodedParticles_.getZPositions();
+            std::span<float> weights = transcodedParticles_.getWeights();
+            for (std::size_t i = 0; i < recordsTranscoded; i++) {
+                if (fixedValues_.xIsConstant) xs[i] = fixedValues_.constantX;
+                if (fixedValues_.yIsConstant) ys[i] = fixedValues_.constantY;
+                if (fixedValues_.zIsConstant) zs[i] = fixedValues_.constantZ;
+                if (fixedValues_.weightIsConstant) weights[i] = fixedValues_.constantWeight;
+            }
+            profile_.particles += recordsTranscoded;
+            countParticleBlockStats(transcodedParticles_);
+
+            std::span<const ParticleType> types = std::as_const(transcodedParticles_).getTypes();
+            std::span<const std::uint8_t> isNewHistory = std::as_const(transcodedParticles_).getNewHistoryFlags();
+            std::span<const std::uint32_t> incrementalHistories = std::as_const(transcodedParticles_).getIncrementalHistories();
+            for (std::size_t i = 0; i < recordsTranscoded; i++) {
+                if (types[i] != ParticleType::PseudoParticle) particlesWritten_++;
+                if (isNewHistory[i]) historiesWritten_ += incrementalHistories[i];
+            }
+
+            if (recordsTranscoded < numberOfRecords) {
+                // The transcoder left the next record to the per-particle path, which may read further records
+                writeParticle(reader.getNextParticle());
+                batchRecords = MINIMUM_BATCH_RECORDS;
+            } else if (numberOfRecords == batchRecords) {
+                batchRecords *= 2;
+            }
+        }
+
+        return reader.particlesRead_ - firstRecordRead;
+    }
+
+
+    void PhaseSpaceFileWriter::copyRecordsFrom(const std::string & fileName, std::uint64_t byteOffset, std::uint64_t maxBytes) {
+        InputFileStream input(fileName); // the offsets are those of the decompressed data if the file is compressed
+        if (!input.is_open()) {
+            throw std::runtime_error("Failed to open file: " + fileName);
+        }
+        input.seekg(static_cast<std::streamoff>(byteOffset));
+
+        // Copy through the write buffer so that the header offset and any background flusher are handled as for particles
+        std::uint64_t bytesLeft = maxBytes;
+        while (bytesLeft > 0 && input.peek() != InputFileStream::traits_type::eof()) {
+            if (buffer_.length() == buffer_.capacity()) {
+                writeNextBlock();
+            }
+            bytesLeft -= buffer_.appendData(input, bytesLeft);
+        }
+    }
+
+
     void PhaseSpaceFileWriter::writeHeaderToFile() {
         if (formatType_ == FormatType::NONE) {
             return; // No header to write for NONE format
@@ -131,6 +425,11 @@ namespace ParticleZoo
             throw std::runtime_error("File is not open when attempting to write header data.");
         }
 
+        if (file_.isStandardOutput()) {
+            file_.close();
+            throw std::runtime_error("The " + phspFormat_ + " format cannot be written to standard output since its header is at the start of the file.");
+        }
+
         if (headerBuffer.length() > headerSize) {
             throw std::runtime_error("Header data exceeds particle record start offset.");
         }
@@ -139,10 +438,12 @@ namespace ParticleZoo
             throw std::runtime_error("Header data byte order does not match particle record byte order.");
         }
 
+        ProfileTimer timer(profile_.ioSeconds, profiling_);
         std::streampos currentPos = file_.tellp();
 
         file_.seekp(0);
         file_.write(reinterpret_cast<const char*>(headerBuffer.data()), headerBuffer.length());
+        countBytesWritten(headerSize);
 
         // Pad the header data with zeros to the start of the particle record
         std::size_t padding = headerSize - headerBuffer.length();
@@ -159,7 +460,29 @@ namespace ParticleZoo
     }
 
 
-    void PhaseSpaceFileWriter::writeParticle(Particle particle) {
+    void PhaseSpaceFileWriter::writeParticle(const Particle & particle) {
+        Particle particleToWrite = particle;
+        profile_.particleObjects++;
+        writeParticleInPlace(particleToWrite);
+    }
+
+
+    void PhaseSpaceFileWriter::writeParticle(Particle && particle) {
+        writeParticleInPlace(particle);
+    }
+
+
+    void PhaseSpaceFileWriter::writeParticles(std::span<const Particle> particles) {
+        Particle particleToWrite;
+        for (const Particle & particle : particles) {
+            particleToWrite = particle;
+            profile_.particleObjects++;
+            writeParticleInPlace(particleToWrite);
+        }
+    }
+
+
+    void PhaseSpaceFileWriter::writeParticleInPlace(Particle & particle) {
         if (getParticlesWritten() >= getMaximumSupportedParticles()) {
             throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(getMaximumSupportedParticles()) + ").");
         }
@@ -223,7 +546,11 @@ namespace ParticleZoo
                         particleBuffer = temporaryParticleBuffer.get();
                     }
 
-                    writeBinaryParticle(*particleBuffer, particle);
+                    {
+                        ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+                        profile_.particles++;
+                        writeBinaryParticle(*particleBuffer, particle);
+                    }
 
                     if (particleBuffer->length() < particleRecordLength_) {
                         particleBuffer->expand();
@@ -244,17 +571,19 @@ namespace ParticleZoo
                         writeNextBlock();
                     }
 
-                    std::string asciiLine = writeASCIIParticle(particle);
-
-                    if (asciiLine.length() > getMaximumASCIILineLength()) {
-                        throw std::runtime_error("ASCII line length exceeds maximum allowed length.");
-                    }
-
-                    buffer_.writeString(asciiLine);
+                    ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+                    profile_.particles++;
+                    buffer_.writeInPlace(getMaximumASCIILineLength(), [&](std::span<byte> space) {
+                        ASCIILineWriter line(std::span<char>(reinterpret_cast<char*>(space.data()), space.size()));
+                        writeASCIIParticle(line, particle);
+                        return line.length();
+                    });
                 }
                 break;
             default: // NONE format
                 {
+                    ProfileTimer timer(profile_.codingSeconds, profiling_, &profile_.ioSeconds);
+                    profile_.particles++;
                     writeParticleManually(particle);
                 }
                 break;
@@ -273,6 +602,14 @@ namespace ParticleZoo
     }
 
 
+    void PhaseSpaceFileWriter::writeParticleBlock(const ParticleBlock & block) {
+        profile_.particleObjects += block.size();
+        for (std::size_t i = 0; i < block.size(); i++) {
+            writeParticle(block.getParticle(i));
+        }
+    }
+
+
     void PhaseSpaceFileWriter::writeNextBlock() {
         if (formatType_ == FormatType::NONE) return;
         if (!file_.is_open()) {
@@ -281,11 +618,33 @@ namespace ParticleZoo
         if (buffer_.length() == 0) {
             return;
         }
+        ProfileTimer timer(profile_.ioSeconds, profiling_);
+        countBlockWritten(buffer_.length());
+        if (flusher_) {
+            // the stream position belongs to the flusher until it has been drained
+            flusher_->submit(buffer_);
+            return;
+        }
+
         std::size_t particleRecordStartOffset = getParticleRecordStartOffset();
+        if (particleRecordStartOffset > 0 && file_.isStandardOutput()) {
+            // the header goes in front of the records once they are all written, which standard output cannot do
+            file_.close(); // nothing more is written, not even when the writer is destroyed
+            throw std::runtime_error("The " + phspFormat_ + " format cannot be written to standard output since its header is at the start of the file.");
+        }
         std::size_t currentPos = (std::size_t) file_.tellp();
         if (currentPos < particleRecordStartOffset) {
             file_.seekp(particleRecordStartOffset);
         }
+        if (currentPos == 0 && file_.isStandardOutput()) {
+            writeProvisionalHeader();
+        }
+
+        if (flushQueueDepth_ > 0) {
+            flusher_ = std::make_unique<BackgroundFlusher>(file_, flushQueueDepth_);
+            flusher_->submit(buffer_);
+            return;
+        }
 
         file_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.length());
 
@@ -0,0 +1,183 @@
+#include "particlezoo/PhaseSpaceSet.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "particlezoo/utilities/formats.h"
+
+namespace ParticleZoo
+{
+
+    PhaseSpaceSet::PhaseSpaceSet(const std::string & setFileName, const UserOptions & userOptions)
+    : PhaseSpaceSet(setFileName, ReadSetFile(setFileName), userOptions)
+    {}
+
+    PhaseSpaceSet::PhaseSpaceSet(const std::vector<std::string> & fileNames, const UserOptions & userOptions)
+    : PhaseSpaceSet("", fileNames, userOptions)
+    {}
+
+    PhaseSpaceSet::PhaseSpaceSet(const std::string & setFileName, const std::vector<std::string> & fileNames, const UserOptions & userOptions)
+    :   PhaseSpaceFileReader("PhaseSpaceSet", setFileName, userOptions, FormatType::NONE, FixedValues(), 1), // all reading is done by the readers of the files
+        fileNames_(fileNames),
+        currentFile_(0)
+    {
+        if (fileNames_.empty()) {
+            throw std::runtime_error(setFileName.empty() ? "A phase space set must contain at least one file." : "Phase space set file lists no files: " + setFileName);
+        }
+
+        readers_.reserve(fileNames_.size());
+        firstRecordIndices_.reserve(fileNames_.size() + 1);
+        firstRecordIndices_.push_back(0);
+        for (const std::string & fileName : fileNames_) {
+            auto reader = FormatRegistry::CreateReader(fileName, userOptions);
+            if (!reader) {
+                throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + fileName);
+            }
+            firstRecordIndices_.push_back(firstRecordIndices_.back() + reader->getNumberOfEntriesInFile());
+            readers_.push_back(std::move(reader));
+        }
+    }
+
+    std::vector<std::string> PhaseSpaceSet::ReadSetFile(const std::string & setFileName) {
+        std::ifstream file(setFileName);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open phase space set file: " + setFileName);
+        }
+
+        const std::filesystem::path setDirectory = std::filesystem::path(setFileName).parent_path();
+        std::vector<std::string> fileNames;
+        std::string line;
+        while (std::getline(file, line)) {
+            const std::size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') continue;
+            const std::size_t last = line.find_last_not_of(" \t\r");
+            const std::filesystem::path path(line.substr(first, last - first + 1));
+            fileNames.push_back((path.is_relative() ? setDirectory / path : path).string());
+        }
+        return fileNames;
+    }
+
+    void PhaseSpaceSet::WriteSetFile(const std::string & setFileName, const std::vector<std::string> & fileNames) {
+        std::ofstream file(setFileName);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open phase space set file for writing: " + setFileName);
+        }
+
+        const std::filesystem::path setDirectory = std::filesystem::absolute(std::filesystem::path(setFileName).parent_path()).lexically_normal();
+        file << "# Phase space set written by ParticleZoo\n";
+        for (const std::string & fileName : fileNames) {
+            const std::filesystem::path path = std::filesystem::absolute(fileName).lexically_normal();
+            const std::filesystem::path relativePath = path.lexically_relative(setDirectory);
+            const bool isBelowSet = !relativePath.empty() && *relativePath.begin() != "..";
+            file << (isBelowSet ? relativePath : path).string() << '\n';
+        }
+        if (!file) {
+            throw std::runtime_error("Failed to write phase space set file: " + setFileName);
+        }
+    }
+
+    std::uint64_t PhaseSpaceSet::getNumberOfParticles() const {
+        std::uint64_t numberOfParticles = 0;
+        for (const auto & reader : readers_) numberOfParticles += reader->getNumberOfParticles();
+        return numberOfParticles;
+    }
+
+    std::uint64_t PhaseSpaceSet::getNumberOfOriginalHistories() const {
+        std::uint64_t numberOfOriginalHistories = 0;
+        for (const auto & reader : readers_) numberOfOriginalHistories += reader->getNumberOfOriginalHistories();
+        return numberOfOriginalHistories;
+    }
+
+    std::uint64_t PhaseSpaceSet::getNumberOfRepresentedHistories() const {
+        if (!hasNativeRepresentedHistoryCount()) {
+            return PhaseSpaceFileReader::getNumberOfRepresentedHistories(); // throws the usual unsupported error
+        }
+        std::uint64_t numberOfRepresentedHistories = 0;
+        for (const auto & reader : readers_) numberOfRepresentedHistories += reader->getNumberOfRepresentedHistories();
+        return numberOfRepresentedHistories;
+    }
+
+    bool PhaseSpaceSet::hasNativeRepresentedHistoryCount() const {
+        return std::all_of(readers_.begin(), readers_.end(), [](const auto & reader) { return reader->hasNativeRepresentedHistoryCount(); });
+    }
+
+    bool PhaseSpaceSet::hasNativeIncrementalHistoryCounters() const {
+        return std::all_of(readers_.begin(), readers_.end(), [](const auto & reader) { return reader->hasNativeIncrementalHistoryCounters(); });
+    }
+
+    bool PhaseSpaceSet::supportsRandomAccess() const {
+        return std::all_of(readers_.begin(), readers_.end(), [](const auto & reader) { return reader->supportsRandomAccess(); });
+    }
+
+    const std::string PhaseSpaceSet::getMemberFileName(std::size_t fileIndex) const {
+        if (fileIndex >= fileNames_.size()) {
+            throw std::out_of_range("File index " + std::to_string(fileIndex) + " is out of range for a phase space set of " + std::to_string(fileNames_.size()) + " files.");
+        }
+        return fileNames_[fileIndex];
+    }
+
+    bool PhaseSpaceSet::hasMoreParticles() {
+        // Each file's reader knows where its own particles end, so the totals in the base class are not checked
+        return advanceToFileWithParticles();
+    }
+
+    bool PhaseSpaceSet::advanceToFileWithParticles() {
+        while (currentFile_ < readers_.size()) {
+            PhaseSpaceFileReader & reader = *readers_[currentFile_];
+            if (reader.hasMoreParticles()) {
+                return true;
+            }
+
+            // Count any records the reader stopped short of (e.g. trailing records beyond the count in the
+            // header) so that record indices in the set keep matching those used by moveToParticle()
+            const std::uint64_t recordsInFile = firstRecordIndices_[currentFile_ + 1] - firstRecordIndices_[currentFile_];
+            const std::uint64_t recordsRead = reader.getParticlesRead(true);
+            if (recordsRead < recordsInFile) {
+                skipParticleRecords(recordsInFile - recordsRead);
+            }
+
+            // Start the next file from its beginning, it may have been left elsewhere by an earlier seek
+            currentFile_++;
+            if (currentFile_ < readers_.size()) {
+                PhaseSpaceFileReader & nextReader = *readers_[currentFile_];
+                if (nextReader.getParticlesRead(true) > 0 && nextReader.getNumberOfEntriesInFile() > 0) {
+                    nextReader.moveToParticle(0);
+                }
+            }
+        }
+        return false;
+    }
+
+    IOProfile PhaseSpaceSet::getIOProfile() const {
+        // The set only hands on the particles its files decode, so their readers have done all of the work
+        IOProfile profile;
+        for (const auto & reader : readers_) {
+            profile += reader->getIOProfile();
+        }
+        return profile;
+    }
+
+    Particle PhaseSpaceSet::readParticleManually() {
+        if (!advanceToFileWithParticles()) {
+            throw std::runtime_error("No more particles to read.");
+        }
+        return readers_[currentFile_]->getNextParticle();
+    }
+
+    Particle PhaseSpaceSet::peekParticleManually() {
+        if (!advanceToFileWithParticles()) {
+            throw std::runtime_error("No more particles to read.");
+        }
+        return readers_[currentFile_]->peekNextParticle();
+    }
+
+    void PhaseSpaceSet::moveToParticleManually(std::uint64_t particleIndex) {
+        // The last file whose first record is at or before the index, which skips over any empty files
+        const std::size_t fileIndex = static_cast<std::size_t>(std::upper_bound(firstRecordIndices_.begin(), firstRecordIndices_.end(), particleIndex) - firstRecordIndices_.begin()) - 1;
+        readers_[fileIndex]->moveToParticle(particleIndex - firstRecordIndices_[fileIndex]);
+        currentFile_ = fileIndex;
+    }
+
+} // namespace ParticleZoo
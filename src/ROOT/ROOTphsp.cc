@@ -2,9 +2,15 @@
 
 #include "particlezoo/ROOT/ROOTphsp.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <RVersion.h>
 #include <TKey.h>
 #include <TClass.h>
+#include <TMath.h>
+#include <TROOT.h>
 #include <TSystem.h>
 
 namespace ParticleZoo::ROOT {
@@ -22,6 +28,10 @@ namespace ParticleZoo::ROOT {
     CLICommand ROOTDirectionalCosineZIsNegativeCommand{ BOTH, "", "ROOT-cosine-z-sign", "Name of the ROOT branch containing the flag to indicate if the particle Z directional cosine is negative.", { CLI_STRING } };
     CLICommand ROOTPDGCodeCommand{ BOTH, "", "ROOT-pdg-code", "Name of the ROOT branch containing the particle PDG code.", { CLI_STRING } };
     CLICommand ROOTHistoryNumberCommand{ BOTH, "", "ROOT-history-number", "Name of the ROOT branch containing the particle history number.", { CLI_STRING } };
+    CLICommand ROOTCompressionCommand{ WRITER, "", "ROOT-compression", "Compression algorithm of written ROOT files, options are 'none', 'zlib', 'lzma', 'lz4' or 'zstd'.", { CLI_STRING }, { std::string("none") } };
+    CLICommand ROOTCompressionLevelCommand{ WRITER, "", "ROOT-compression-level", "Compression level of written ROOT files from 1 to 9, 0 for the default of the algorithm.", { CLI_INT }, { 0 } };
+    CLICommand ROOTBasketSizeCommand{ WRITER, "", "ROOT-basket-size", "Size in bytes of the basket each branch of written ROOT files is filled in before it is compressed.", { CLI_UINT }, { 32000u } };
+    CLICommand ROOTThreadsCommand{ WRITER, "", "ROOT-threads", "Enable ROOT's implicit multithreading with this many threads to fill and compress the baskets of written ROOT files, 0 for as many as there are cores.", { CLI_UINT } };
 
     inline std::string extractStringFromMap(const std::map<std::string, BranchInfo> & branchNames, const std::string & key) {
         auto it = branchNames.find(key);
@@ -32,6 +42,30 @@ namespace ParticleZoo::ROOT {
         }
     }
 
+    inline int getCompressionSettingsFromUserOptions(const UserOptions & options) {
+        // ROOT compression settings are 100 times the algorithm plus the level, a level of 0 is uncompressed
+        const std::string algorithmName = options.contains(ROOTCompressionCommand) ? options.extractStringOption(ROOTCompressionCommand) : "none";
+        int algorithm, defaultLevel;
+        if (algorithmName == "none") {
+            return 0;
+        } else if (algorithmName == "zlib") {
+            algorithm = 1; defaultLevel = 1;
+        } else if (algorithmName == "lzma") {
+            algorithm = 2; defaultLevel = 7;
+        } else if (algorithmName == "lz4") {
+            algorithm = 4; defaultLevel = 4;
+        } else if (algorithmName == "zstd") {
+            algorithm = 5; defaultLevel = 5;
+        } else {
+            throw std::runtime_error("Unsupported ROOT compression algorithm: " + algorithmName);
+        }
+        const int level = options.extractIntOption(ROOTCompressionLevelCommand, 0);
+        if (level < 0 || level > 9) {
+            throw std::runtime_error("ROOT compression level must be between 0 and 9, got " + std::to_string(level));
+        }
+        return algorithm * 100 + (level == 0 ? defaultLevel : level);
+    }
+
     inline const std::map<std::string,BranchInfo> getBranchDetailsFromUserOptions(const UserOptions & options) {
         std::map<std::string,BranchInfo> branchNames;
 
@@ -91,6 +125,8 @@ namespace ParticleZoo::ROOT {
                     const UserOptions & options)
     : ParticleZoo::PhaseSpaceFileReader("ROOT", fileName, options, FormatType::NONE)
     {
+        ::ROOT::EnableThreadSafety(); // the parallel readers open the file once for each thread
+
         file = TFile::Open(fileName.c_str(), "READ");
         if (!file || !file->IsOpen() || file->IsZombie()) {
             int err = gSystem->GetErrno();
@@ -138,64 +174,64 @@ namespace ParticleZoo::ROOT {
 
         // mandatory branches
         if (energyBranchName.length()>0 && tree->GetBranch(energyBranchName.c_str())) {
-            tree->SetBranchAddress(energyBranchName.c_str(),    &energy_);
+            bindBranch(energyBranchName, energy_);
             energyUnits_ = branchNames.at("energy").unitFactor; // Set the units for energy
         } else 
             throw std::runtime_error("Branch '" + energyBranchName + "' not found in TTree: " + treeName);
 
         if (positionXBranchName.length()>0 && tree->GetBranch(positionXBranchName.c_str())) {
-            tree->SetBranchAddress(positionXBranchName.c_str(), &x_);
+            bindBranch(positionXBranchName, x_);
             xUnits_ = branchNames.at("positionX").unitFactor; // Set the units for x
         } else
             throw std::runtime_error("Branch '" + positionXBranchName + "' not found in TTree: " + treeName);
 
         if (positionYBranchName.length()>0 && tree->GetBranch(positionYBranchName.c_str())) {
-            tree->SetBranchAddress(positionYBranchName.c_str(), &y_);
+            bindBranch(positionYBranchName, y_);
             yUnits_ = branchNames.at("positionY").unitFactor; // Set the units for y
         } else
             throw std::runtime_error("Branch '" + positionYBranchName + "' not found in TTree: " + treeName);
 
         if (positionZBranchName.length()>0 && tree->GetBranch(positionZBranchName.c_str())) {
-            tree->SetBranchAddress(positionZBranchName.c_str(), &z_);
+            bindBranch(positionZBranchName, z_);
             zUnits_ = branchNames.at("positionZ").unitFactor; // Set the units for z
         } else
             throw std::runtime_error("Branch '" + positionZBranchName + "' not found in TTree: " + treeName);
 
         if (directionalCosineXBranchName.length()>0 && tree->GetBranch(directionalCosineXBranchName.c_str()))
-            tree->SetBranchAddress(directionalCosineXBranchName.c_str(), &px_);
+            bindBranch(directionalCosineXBranchName, px_);
         else
             throw std::runtime_error("Branch '" + directionalCosineXBranchName + "' not found in TTree: " + treeName);
 
         if (directionalCosineYBranchName.length()>0 && tree->GetBranch(directionalCosineYBranchName.c_str()))
-            tree->SetBranchAddress(directionalCosineYBranchName.c_str(), &py_);
+            bindBranch(directionalCosineYBranchName, py_);
         else
             throw std::runtime_error("Branch '" + directionalCosineYBranchName + "' not found in TTree: " + treeName);
 
         if (pdgCodeBranchName.length()>0 && tree->GetBranch(pdgCodeBranchName.c_str()))
-            tree->SetBranchAddress(pdgCodeBranchName.c_str(),   &pdgCode_);
+            bindBranch(pdgCodeBranchName, pdgCode_);
         else
             throw std::runtime_error("Branch '" + pdgCodeBranchName + "' not found in TTree: " + treeName);
 
         // optional branches
         if (isNewHistoryBranchName.length()>0 && tree->GetBranch(isNewHistoryBranchName.c_str())) {
             treeHasNewHistoryMarker_ = true;
-            tree->SetBranchAddress(isNewHistoryBranchName.c_str(), &isNewHistory_);
+            bindBranch(isNewHistoryBranchName, isNewHistory_);
         } else if (isNewHistoryBranchName.length()>0) {
             treeHasNewHistoryMarker_ = false;
             std::cerr << "Warning: Branch '" << isNewHistoryBranchName << "' not found in TTree: " << treeName << ". All particles will be assumed to be new histories." << std::endl;
         }
 
         if (weightBranchName.length()>0 && tree->GetBranch(weightBranchName.c_str()))
-            tree->SetBranchAddress(weightBranchName.c_str(),    &weight_);
+            bindBranch(weightBranchName, weight_);
         else if (weightBranchName.length()>0)
             std::cerr << "Warning: Branch '" << weightBranchName << "' not found in TTree: " << treeName << ". All particles will be assumed to have a weight of 1." << std::endl;
 
         if (directionalCosineZBranchName.length()>0 && tree->GetBranch(directionalCosineZBranchName.c_str())) {
-            tree->SetBranchAddress(directionalCosineZBranchName.c_str(), &pz_);
+            bindBranch(directionalCosineZBranchName, pz_);
             pzIsStored_ = true; // Indicate that pz is stored in the tree
         } else if (directionalCosineZBranchName.length()>0) {
             if (directionalCosineZIsNegativeBranchName.length()>0 && tree->GetBranch(directionalCosineZIsNegativeBranchName.c_str())) {
-                tree->SetBranchAddress(directionalCosineZIsNegativeBranchName.c_str(), &pzIsNegative_);                
+                bindBranch(directionalCosineZIsNegativeBranchName, pzIsNegative_);                
                 std::cerr << "Warning: Branch '" << directionalCosineZBranchName << "' not found in TTree: " << treeName << ". Z directional cosine value will be calculated from the X and Y directional cosines." << std::endl;
             } else {
                 pzIsNegative_ = false; // Default to positive if not specified
@@ -203,7 +239,7 @@ namespace ParticleZoo::ROOT {
             }
         } else {
             if (directionalCosineZIsNegativeBranchName.length()>0 && tree->GetBranch(directionalCosineZIsNegativeBranchName.c_str())) {
-                tree->SetBranchAddress(directionalCosineZIsNegativeBranchName.c_str(), &pzIsNegative_);
+                bindBranch(directionalCosineZIsNegativeBranchName, pzIsNegative_);
             } else {
                 pzIsNegative_ = false; // Default to positive if not specified
                 std::cerr << "Warning: Branch '" << directionalCosineZIsNegativeBranchName << "' not found in TTree: " << treeName << ". The sign of the Z directional cosine will be assumed to be positive." << std::endl;
@@ -212,33 +248,35 @@ namespace ParticleZoo::ROOT {
 
         if (historyNumberBranchName.length()>0 && tree->GetBranch(historyNumberBranchName.c_str())) {
             treeHasHistoryNumber_ = true;
-            tree->SetBranchAddress(historyNumberBranchName.c_str(), &historyNumber_);
+            bindBranch(historyNumberBranchName, historyNumber_);
         } else if (historyNumberBranchName.length()>0) {
             std::cerr << "Warning: Branch '" << historyNumberBranchName << "' not found in TTree: " << treeName << ". Empty histories will not be accounted for." << std::endl;
         }
 
-        tree->SetCacheSize(256 * 1024 * 1024);       // 256 MB cache
-        tree->SetCacheLearnEntries(500);            // learn basket layout on first 500 entries
-        if (energyBranchName.length()>0) tree->AddBranchToCache(energyBranchName.c_str(), true);
-        if (positionXBranchName.length()>0) tree->AddBranchToCache(positionXBranchName.c_str(), true);
-        if (positionYBranchName.length()>0) tree->AddBranchToCache(positionYBranchName.c_str(), true);
-        if (positionZBranchName.length()>0) tree->AddBranchToCache(positionZBranchName.c_str(), true);
-        if (directionalCosineXBranchName.length()>0) tree->AddBranchToCache(directionalCosineXBranchName.c_str(), true);
-        if (directionalCosineYBranchName.length()>0) tree->AddBranchToCache(directionalCosineYBranchName.c_str(), true);
-        if (directionalCosineZBranchName.length()>0) tree->AddBranchToCache(directionalCosineZBranchName.c_str(), true);
-        if (directionalCosineZIsNegativeBranchName.length()>0) tree->AddBranchToCache(directionalCosineZIsNegativeBranchName.c_str(), true);
-        if (weightBranchName.length()>0) tree->AddBranchToCache(weightBranchName.c_str(), true);
-        if (pdgCodeBranchName.length()>0) tree->AddBranchToCache(pdgCodeBranchName.c_str(), true);
-        if (isNewHistoryBranchName.length()>0) tree->AddBranchToCache(isNewHistoryBranchName.c_str(), true);
-        if (historyNumberBranchName.length()>0) tree->AddBranchToCache(historyNumberBranchName.c_str(), true);
+        // Size the cache for two clusters of the bound branches rather than for the whole tree
+        constexpr Long64_t MINIMUM_CACHE_SIZE = 4 * 1024 * 1024;
+        constexpr Long64_t MAXIMUM_CACHE_SIZE = 256 * 1024 * 1024;
+        Long64_t boundBytes = 0;
+        for (const Column & column : columns_) boundBytes += column.branch->GetZipBytes();
+        Long64_t clusterBytes = boundBytes;
+        const Long64_t autoFlush = tree->GetAutoFlush();
+        if (autoFlush > 0 && numberOfParticles_ > 0) {
+            clusterBytes = static_cast<Long64_t>(static_cast<double>(boundBytes) / static_cast<double>(numberOfParticles_) * static_cast<double>(autoFlush));
+        } else if (autoFlush < 0 && tree->GetZipBytes() > 0) {
+            clusterBytes = static_cast<Long64_t>(static_cast<double>(-autoFlush) * static_cast<double>(boundBytes) / static_cast<double>(tree->GetZipBytes()));
+        }
+        tree->SetCacheSize(std::clamp(2 * clusterBytes, MINIMUM_CACHE_SIZE, MAXIMUM_CACHE_SIZE));
+        for (const Column & column : columns_) tree->AddBranchToCache(column.branch, false);
+        tree->StopCacheLearningPhase(); // the branches to read are known, no need to learn them
+        bytesReadFromFile_ = file->GetBytesRead();
 
         if (numberOfParticles_ > 0) {
             // determine the number of original histories in the file, if possible
             if (treeHasHistoryNumber_) { // if we have a history number branch, we can determine the number of original histories directly
                 int firstHistoryNumber, lastHistoryNumber;
-                tree->GetEntry(0);
+                readEntry(0);
                 firstHistoryNumber = historyNumber_;
-                tree->GetEntry(numberOfParticles_-1);
+                readEntry(numberOfParticles_-1);
                 lastHistoryNumber = historyNumber_;
                 int originalHistories = lastHistoryNumber - firstHistoryNumber + 1;
                 if (originalHistories <= 0) {
@@ -250,9 +288,11 @@ namespace ParticleZoo::ROOT {
                 }
                 historyNumber_ = firstHistoryNumber - 1; // Adjust initial history number for incremental histories
             } else if (treeHasNewHistoryMarker_) { // if we have a new history marker, we need to loop over all particles to count the number of histories
+                // only the marker has to be read, a basket at a time where the branch allows it
+                Column & markerColumn = *std::find_if(columns_.begin(), columns_.end(), [this](const Column & column) { return column.target == &isNewHistory_; });
                 numberOfOriginalHistories_ = 0;
                 for (std::uint64_t i=0; i<numberOfParticles_; ++i) {
-                    tree->GetEntry(i);
+                    loadColumn(markerColumn, static_cast<Long64_t>(i));
                     if (isNewHistory_) numberOfOriginalHistories_++;
                 }
                 historyNumber_ = -1; // Reset initial history number for incremental histories
@@ -292,101 +332,189 @@ namespace ParticleZoo::ROOT {
         };
     }
 
-    Particle Reader::readParticleManually()
-    {
-        std::uint64_t particlesRead = getParticlesRead(true);
-        if (particlesRead >= numberOfParticles_) throw std::runtime_error("Attempted to read more particles than available in the ROOT file.");
-
-        if (!treeHasHistoryNumber_) {
-            historyNumber_ = static_cast<int>(getHistoriesRead());
-        }
-        
-        int lastHistoryNumber = historyNumber_;
+    void Reader::bindBranch(const std::string & branchName, double & target) {
+        tree->SetBranchAddress(branchName.c_str(), &target);
+        addColumn(tree->GetBranch(branchName.c_str()), &target, Column::Target::DOUBLE);
+    }
 
-        tree->GetEntry(particlesRead++);
+    void Reader::bindBranch(const std::string & branchName, int & target) {
+        tree->SetBranchAddress(branchName.c_str(), &target);
+        addColumn(tree->GetBranch(branchName.c_str()), &target, Column::Target::INT);
+    }
 
-        if (!treeHasHistoryNumber_ && !treeHasNewHistoryMarker_) isNewHistory_ = true; // If no history info is available, assume each particle is a new history
+    void Reader::bindBranch(const std::string & branchName, bool & target) {
+        tree->SetBranchAddress(branchName.c_str(), &target);
+        addColumn(tree->GetBranch(branchName.c_str()), &target, Column::Target::BOOL);
+    }
 
-        ParticleType type = getParticleTypeFromPDGID(pdgCode_);
+    void Reader::addColumn(TBranch * branch, void * target, Column::Target targetType) {
+        Column column{ branch, target, targetType, kNoType_t, false, nullptr, 0, 0 };
 
-        if (!pzIsStored_) {
-            pz_ = calcThirdUnitComponent(px_, py_);
-            if (pzIsNegative_) { pz_ = -pz_; }
+        // Bulk I/O hands over the values of a basket as they are stored, so it is only used for the fundamental types converted below
+        TClass * expectedClass = nullptr;
+        EDataType leafType = kNoType_t;
+        if (branch->GetExpectedType(expectedClass, leafType) == 0 && !expectedClass) {
+            column.leafType = leafType;
+        }
+        switch (column.leafType) {
+            case kChar_t: case kUChar_t: case kShort_t: case kUShort_t: case kInt_t: case kUInt_t:
+            case kLong64_t: case kULong64_t: case kFloat_t: case kDouble_t: case kBool_t:
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,18,0)
+                column.bulk = branch->GetBulkRead().SupportsBulkRead();
+#endif
+                break;
+            default:
+                break;
+        }
+        if (column.bulk) {
+            column.buffer = std::make_unique<TBufferFile>(TBuffer::kWrite, 32 * 1024);
         }
 
-        int historyIncrement = historyNumber_ - lastHistoryNumber;
-        if (getHistoriesRead() == 0 || (historyIncrement == 0 && isNewHistory_)) historyIncrement = 1;
-        isNewHistory_ = historyIncrement > 0;
+        columns_.push_back(std::move(column));
+    }
 
-        Particle particle(type,
-                        energy_ * energyUnits_,
-                        x_ * xUnits_,
-                        y_ * yUnits_,
-                        z_ * zUnits_,
-                        px_,
-                        py_,
-                        pz_,
-                        isNewHistory_,
-                        weight_);
+    namespace {
+        template <typename T>
+        inline double columnValue(const char * values, Long64_t index) {
+            T value;
+            std::memcpy(&value, values + index * static_cast<Long64_t>(sizeof(T)), sizeof(T));
+            return static_cast<double>(value);
+        }
+    }
 
-        if (treeHasHistoryNumber_) {
-            particle.setIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER, historyIncrement);
+    void Reader::loadColumn(Column & column, Long64_t entry) {
+        if (column.bulk && (entry < column.firstEntry || entry >= column.firstEntry + column.numberOfEntries)) {
+            // The buffer is filled with the whole basket holding the entry, starting from the first entry of the basket
+            const Int_t numberOfEntries = column.branch->GetBulkRead().GetBulkEntries(entry, *column.buffer);
+            const Long64_t * basketFirstEntries = column.branch->GetBasketEntry();
+            const Long64_t basket = numberOfEntries > 0 ? TMath::BinarySearch(static_cast<Long64_t>(column.branch->GetWriteBasket()) + 1, basketFirstEntries, entry) : -1;
+            if (basket >= 0 && entry < basketFirstEntries[basket] + numberOfEntries) {
+                column.firstEntry = basketFirstEntries[basket];
+                column.numberOfEntries = numberOfEntries;
+            } else {
+                // fall back to reading the branch one entry at a time
+                column.bulk = false;
+                column.buffer.reset();
+            }
         }
 
-        return particle;
-    }
+        if (!column.bulk) {
+            if (column.branch->GetEntry(entry) < 0) {
+                throw std::runtime_error("Failed to read entry " + std::to_string(entry) + " of branch '" + column.branch->GetName() + "' in ROOT file: " + getFileName());
+            }
+            return;
+        }
 
-    Particle Reader::peekParticleManually()
-    {
-        std::uint64_t particlesRead = getParticlesRead(true);
-        if (particlesRead >= numberOfParticles_) throw std::runtime_error("Attempted to peek more particles than available in the ROOT file.");
+        const char * values = column.buffer->GetCurrent();
+        const Long64_t index = entry - column.firstEntry;
+        double value = 0;
+        switch (column.leafType) {
+            case kChar_t:    value = columnValue<Char_t>(values, index); break;
+            case kUChar_t:   value = columnValue<UChar_t>(values, index); break;
+            case kShort_t:   value = columnValue<Short_t>(values, index); break;
+            case kUShort_t:  value = columnValue<UShort_t>(values, index); break;
+            case kInt_t:     value = columnValue<Int_t>(values, index); break;
+            case kUInt_t:    value = columnValue<UInt_t>(values, index); break;
+            case kLong64_t:  value = columnValue<Long64_t>(values, index); break;
+            case kULong64_t: value = columnValue<ULong64_t>(values, index); break;
+            case kFloat_t:   value = columnValue<Float_t>(values, index); break;
+            case kDouble_t:  value = columnValue<Double_t>(values, index); break;
+            case kBool_t:    value = columnValue<Bool_t>(values, index); break;
+            default: break;
+        }
+        switch (column.targetType) {
+            case Column::Target::DOUBLE: *static_cast<double*>(column.target) = value; break;
+            case Column::Target::INT:    *static_cast<int*>(column.target) = static_cast<int>(value); break;
+            case Column::Target::BOOL:   *static_cast<bool*>(column.target) = value != 0; break;
+        }
+    }
 
-        if (!treeHasHistoryNumber_) {
-            historyNumber_ = static_cast<int>(getHistoriesRead());
+    void Reader::readEntry(std::uint64_t entry) {
+        {
+            ProfileTimer timer = timeIO();
+            tree->LoadTree(static_cast<Long64_t>(entry)); // lets the cache prefetch the clusters around the entry
+            for (Column & column : columns_) {
+                loadColumn(column, static_cast<Long64_t>(entry));
+            }
         }
-        
-        int lastHistoryNumber = historyNumber_;
-        bool lastIsNewHistory = isNewHistory_;
+        const Long64_t bytesReadFromFile = file->GetBytesRead();
+        if (bytesReadFromFile != bytesReadFromFile_) {
+            countBlockRead(static_cast<std::uint64_t>(bytesReadFromFile - bytesReadFromFile_));
+            bytesReadFromFile_ = bytesReadFromFile;
+        }
+    }
 
-        tree->GetEntry(particlesRead);
+    Particle Reader::particleFromEntry(std::uint64_t entry)
+    {
+        const int lastHistoryNumber = historyNumber_;
 
-        if (!treeHasHistoryNumber_ && !treeHasNewHistoryMarker_) isNewHistory_ = true; // If no history info is available, assume each particle is a new history
+        readEntry(entry);
 
         ParticleType type = getParticleTypeFromPDGID(pdgCode_);
 
-        double px = px_;
-        double py = py_;
         double pz = pz_;
         if (!pzIsStored_) {
-            pz = calcThirdUnitComponent(px, py);
+            pz = calcThirdUnitComponent(px_, py_);
             if (pzIsNegative_) { pz = -pz; }
         }
 
-        int historyIncrement = historyNumber_ - lastHistoryNumber;
-        if (getHistoriesRead() == 0 || (historyIncrement == 0 && isNewHistory_)) historyIncrement = 1;
-        isNewHistory_ = historyIncrement > 0;
+        // Without history numbers each particle is a new history unless the tree marks it otherwise
+        const bool markedAsNewHistory = treeHasNewHistoryMarker_ ? isNewHistory_ : !treeHasHistoryNumber_;
+        int historyIncrement = treeHasHistoryNumber_ ? historyNumber_ - lastHistoryNumber : 0;
+        if (historyIncrement <= 0 && (markedAsNewHistory || entry == 0)) historyIncrement = 1;
+        const bool isNewHistory = historyIncrement > 0;
 
         Particle particle(type,
                         energy_ * energyUnits_,
                         x_ * xUnits_,
                         y_ * yUnits_,
                         z_ * zUnits_,
-                        px,
-                        py,
+                        px_,
+                        py_,
                         pz,
-                        isNewHistory_,
+                        isNewHistory,
                         weight_);
 
         if (treeHasHistoryNumber_) {
             particle.setIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER, historyIncrement);
         }
 
+        return particle;
+    }
+
+    Particle Reader::readParticleManually()
+    {
+        std::uint64_t particlesRead = getParticlesRead(true);
+        if (particlesRead >= numberOfParticles_) throw std::runtime_error("Attempted to read more particles than available in the ROOT file.");
+
+        return particleFromEntry(particlesRead);
+    }
+
+    Particle Reader::peekParticleManually()
+    {
+        std::uint64_t particlesRead = getParticlesRead(true);
+        if (particlesRead >= numberOfParticles_) throw std::runtime_error("Attempted to peek more particles than available in the ROOT file.");
+
+        const int lastHistoryNumber = historyNumber_;
+        Particle particle = particleFromEntry(particlesRead);
         historyNumber_ = lastHistoryNumber; // Reset history number to previous value
-        isNewHistory_ = lastIsNewHistory;   // Reset isNewHistory to previous value
 
         return particle;
     }
 
+    void Reader::moveToParticleManually(std::uint64_t particleIndex)
+    {
+        if (treeHasHistoryNumber_) {
+            // the increment of the first particle read is counted from the history before it
+            if (particleIndex > 0) {
+                readEntry(particleIndex - 1);
+            } else {
+                readEntry(0);
+                historyNumber_--;
+            }
+        }
+    }
+
 
     // Implementation of Writer class
 
@@ -396,14 +524,28 @@ namespace ParticleZoo::ROOT {
     }
 
     Writer::Writer(const std::string & fileName, const std::map<std::string,BranchInfo> & branchNames, const UserOptions & options)
-    : ParticleZoo::PhaseSpaceFileWriter("ROOT", fileName, options, FormatType::NONE), branchNames_(branchNames)
+    : ParticleZoo::PhaseSpaceFileWriter("ROOT", fileName, options, FormatType::NONE),
+      compressionSettings_(getCompressionSettingsFromUserOptions(options)),
+      branchNames_(branchNames)
     {
+        const unsigned int basketSize = options.extractUIntOption(ROOTBasketSizeCommand, 32000);
+        if (basketSize == 0 || basketSize > static_cast<unsigned int>(std::numeric_limits<Int_t>::max())) {
+            throw std::runtime_error("Invalid ROOT basket size: " + std::to_string(basketSize));
+        }
+        basketSize_ = static_cast<Int_t>(basketSize);
+
+        ::ROOT::EnableThreadSafety(); // the shards of a sharded writer are written from threads of their own
+        if (options.contains(ROOTThreadsCommand) && !::ROOT::IsImplicitMTEnabled()) {
+            ::ROOT::EnableImplicitMT(options.extractUIntOption(ROOTThreadsCommand));
+        }
+
         file_ = TFile::Open(fileName.c_str(), "RECREATE");
         if (!file_ || !file_->IsOpen() || file_->IsZombie()) {
             int err = gSystem->GetErrno();
             throw std::runtime_error("Failed to open ROOT file for writing: " + fileName + " with error number " + std::to_string(err) + " (" + strerror(err) + ")");
         }
 
+        file_->SetCompressionSettings(compressionSettings_); // before the branches are made, they take their settings from the file
         file_->cd();
 
         std::string treeName = extractStringFromMap(branchNames_, "treeName");
@@ -423,47 +565,107 @@ namespace ParticleZoo::ROOT {
             if (branchKey == "treeName") {
                 continue; // Skip treeName as it is not a branch
             } else if (branchKey == "energy") {
-                tree_->Branch(branchName.c_str(), &energy_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &energy_, (branchName + "/D").c_str(), basketSize_);
                 inverseEnergyUnits_ = 1.0 / info.unitFactor; // Set the units for energy
             } else if (branchKey == "positionX") {
-                tree_->Branch(branchName.c_str(), &x_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &x_, (branchName + "/D").c_str(), basketSize_);
                 inverseXUnits_ = 1.0 / info.unitFactor; // Set the units for positionX
             } else if (branchKey == "positionY") {
-                tree_->Branch(branchName.c_str(), &y_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &y_, (branchName + "/D").c_str(), basketSize_);
                 inverseYUnits_ = 1.0 / info.unitFactor; // Set the units for positionY
             } else if (branchKey == "positionZ") {
-                tree_->Branch(branchName.c_str(), &z_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &z_, (branchName + "/D").c_str(), basketSize_);
                 inverseZUnits_ = 1.0 / info.unitFactor; // Set the units for positionZ
             } else if (branchKey == "directionalCosineX") {
-                tree_->Branch(branchName.c_str(), &px_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &px_, (branchName + "/D").c_str(), basketSize_);
             } else if (branchKey == "directionalCosineY") {
-                tree_->Branch(branchName.c_str(), &py_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &py_, (branchName + "/D").c_str(), basketSize_);
             } else if (branchKey == "directionalCosineZ") {
-                tree_->Branch(branchName.c_str(), &pz_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &pz_, (branchName + "/D").c_str(), basketSize_);
                 pzIsStored_ = true; // Indicate that pz is stored in the tree
             } else if (branchKey == "directionalCosineZIsNegative") {
-                tree_->Branch(branchName.c_str(), &pzIsNegative_, (branchName + "/O").c_str());
+                tree_->Branch(branchName.c_str(), &pzIsNegative_, (branchName + "/O").c_str(), basketSize_);
             } else if (branchKey == "weight") {
-                tree_->Branch(branchName.c_str(), &weight_, (branchName + "/D").c_str());
+                tree_->Branch(branchName.c_str(), &weight_, (branchName + "/D").c_str(), basketSize_);
             } else if (branchKey == "pdgCode") {
-                tree_->Branch(branchName.c_str(), &pdgCode_, (branchName + "/I").c_str());
+                tree_->Branch(branchName.c_str(), &pdgCode_, (branchName + "/I").c_str(), basketSize_);
             } else if (branchKey == "isNewHistory") {
-                tree_->Branch(branchName.c_str(), &isNewHistory_, (branchName + "/O").c_str());
+                tree_->Branch(branchName.c_str(), &isNewHistory_, (branchName + "/O").c_str(), basketSize_);
             } else if (branchKey == "historyNumber") {
-                tree_->Branch(branchName.c_str(), &historyNumber_, (branchName + "/I").c_str());
+                tree_->Branch(branchName.c_str(), &historyNumber_, (branchName + "/I").c_str(), basketSize_);
                 storeIncrementalHistories_ = true;
             }
         }
 
-        file_->SetCompressionLevel(0); // no compression results in faster I/O, performance is more important than file size
+        tree_->SetImplicitMT(true); // only takes effect once implicit multithreading is enabled
     }
 
     Writer::~Writer()
     {
-        if (file_) {
+        close();
+    }
+
+    void Writer::closeManually()
+    {
+        if (!file_) return;
+        {
+            ProfileTimer timer = timeIO();
+            file_->cd();
             tree_->Write();
             file_->Close();
-            delete file_;
+        }
+        countBytesWritten(static_cast<std::uint64_t>(file_->GetBytesWritten()));
+        delete file_; // the tree is deleted with the file
+        file_ = nullptr;
+        tree_ = nullptr;
+    }
+
+    void Writer::appendRecordsManually(const PhaseSpaceFileWriter & other)
+    {
+        const Writer & otherWriter = dynamic_cast<const Writer &>(other);
+        if (otherWriter.file_) {
+            throw std::runtime_error("The writer of " + other.getFileName() + " must be closed before its records can be appended.");
+        }
+        if (!file_) {
+            throw std::runtime_error("File is not open when attempting to append records.");
+        }
+        if (otherWriter.branchNames_.size() != branchNames_.size() || !std::equal(branchNames_.begin(), branchNames_.end(), otherWriter.branchNames_.begin(), [](const auto & a, const auto & b) { return a.first == b.first && a.second.branchName == b.second.branchName; })) {
+            throw std::runtime_error("Cannot append " + other.getFileName() + " to " + getFileName() + " since their branches differ.");
+        }
+
+        std::unique_ptr<TFile> input(TFile::Open(other.getFileName().c_str(), "READ"));
+        if (!input || !input->IsOpen() || input->IsZombie()) {
+            throw std::runtime_error("Failed to open ROOT file: " + other.getFileName());
+        }
+        TTree * inputTree = dynamic_cast<TTree*>(input->Get(tree_->GetName()));
+        if (!inputTree) {
+            throw std::runtime_error("TTree with name '" + std::string(tree_->GetName()) + "' not found in ROOT file: " + other.getFileName());
+        }
+
+        ProfileTimer timer = timeIO();
+        file_->cd();
+        if (!storeIncrementalHistories_) {
+            // the compressed baskets are copied as they are
+            if (tree_->CopyEntries(inputTree, -1, "fast") < 0) {
+                throw std::runtime_error("Failed to copy the entries of " + other.getFileName() + " to " + getFileName());
+            }
+        } else {
+            // the history numbers of the other file start from zero, so they are renumbered to carry on from those of this file
+            TIter nextBranch(tree_->GetListOfBranches());
+            while (TBranch * branch = static_cast<TBranch*>(nextBranch())) {
+                inputTree->SetBranchAddress(branch->GetName(), static_cast<void*>(branch->GetAddress()));
+            }
+            const int historyNumberOffset = historyNumber_;
+            const Long64_t numberOfEntries = inputTree->GetEntries();
+            for (Long64_t entry = 0; entry < numberOfEntries; entry++) {
+                if (inputTree->GetEntry(entry) <= 0) {
+                    throw std::runtime_error("Failed to read entry " + std::to_string(entry) + " of ROOT file: " + other.getFileName());
+                }
+                historyNumber_ += historyNumberOffset;
+                tree_->Fill();
+            }
+            historyNumber_ = historyNumberOffset + otherWriter.historyNumber_;
+            inputTree->ResetBranchAddresses();
         }
     }
 
@@ -481,7 +683,11 @@ namespace ParticleZoo::ROOT {
             ROOTDirectionalCosineZCommand,
             ROOTDirectionalCosineZIsNegativeCommand,
             ROOTPDGCodeCommand,
-            ROOTHistoryNumberCommand
+            ROOTHistoryNumberCommand,
+            ROOTCompressionCommand,
+            ROOTCompressionLevelCommand,
+            ROOTBasketSizeCommand,
+            ROOTThreadsCommand
         };
     }
 
@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include "particlezoo/ByteBuffer.h"
+#include "particlezoo/utilities/simd.h"
 
 namespace ParticleZoo::EGSphspFile
 {
@@ -15,8 +16,6 @@ namespace ParticleZoo::EGSphspFile
     CLICommand EGSParticleZValueCommand{ READER, "", "EGS-particleZ", "Specify the Z value for all particles in the EGS phase space file", { CLI_FLOAT }, { 0.0f } };
     CLICommand EGSModeCommand{ WRITER, "", "EGS-mode", "Specify the EGS phase space file mode (MODE0 or MODE2)", { CLI_STRING }, { std::string("MODE0") } };
 
-    constexpr float ELECTRON_REST_MASS_MEV = 0.5109989461f;    ///< Electron rest mass, stored explicitly in MeV for operating directly on the energy value in the file before conversion to internal units
-
     Reader::Reader(const std::string & fileName, const UserOptions & options)
     : PhaseSpaceFileReader("EGS", fileName, options), mode_(EGSMODE::MODE0), latchOption_(EGSLATCHOPTION::LATCH_OPTION_2), particleZValue_(0)
     {
@@ -58,6 +57,10 @@ namespace ParticleZoo::EGSphspFile
         return { EGSIgnoreHeaderCountCommand, EGSParticleZValueCommand, EGSLATCHOptionCommand };
     }
 
+    std::unique_ptr<PhaseSpaceFileReader> Reader::clone() const {
+        return std::unique_ptr<PhaseSpaceFileReader>(new Reader(*this));
+    }
+
     void Reader::readHeader(bool ignoreHeaderParticleCount)
     {
         ByteBuffer headerBuffer = getHeaderData();
@@ -79,6 +82,9 @@ namespace ParticleZoo::EGSphspFile
         numberOfParticles_ = headerBuffer.read<unsigned int>();
 
         if (ignoreHeaderParticleCount) {
+            if (IsStandardStream(getFileName())) {
+                throw std::runtime_error("The EGS header particle count cannot be ignored when reading standard input, since its size is not known.");
+            }
             std::cout << "Overriding header particle count " << numberOfParticles_;
             numberOfParticles_ = static_cast<unsigned int>((getFileSize() - getParticleRecordStartOffset()) / getParticleRecordLength());
             std::cout << " with " << numberOfParticles_ << std::endl;
@@ -143,6 +149,161 @@ namespace ParticleZoo::EGSphspFile
     }
 
 
+    bool Reader::rejectBinaryRecord(ByteBuffer & record, const ParticleFilter & filter, RejectedRecord & rejected)
+    {
+        // Work out the fields exactly as readBinaryParticle() does, but only as far as the filter needs them
+        const unsigned int LATCH = record.read<unsigned int>();
+        float energy = record.read<float>();
+        const bool isNewHistory = energy < 0;
+        if (isNewHistory) { energy = -energy; }
+
+        ParticleType type;
+        switch ((LATCH >> 29) & 3) {
+            case 0: // Neutral particle
+                type = ParticleType::Photon;
+                break;
+            case 1: // Negative particle
+                type = ParticleType::Electron;
+                energy -= ELECTRON_REST_MASS_MEV;
+                break;
+            case 2: // Positive particle
+                type = ParticleType::Positron;
+                energy -= ELECTRON_REST_MASS_MEV;
+                break;
+            default: // Invalid, leave it to the full decoder to report
+                return false;
+        };
+        energy *= MeV;
+
+        bool accepted = filter.acceptsParticleType(type) && filter.acceptsKineticEnergy(energy) && filter.acceptsLATCH(true, LATCH);
+        if (accepted && filter.usesGeneration()) {
+            // Only the comprehensive LATCH options tell primaries from secondaries, see ApplyLATCHToParticle()
+            const bool hasGeneration = latchOption_ == EGSLATCHOPTION::LATCH_OPTION_2 || latchOption_ == EGSLATCHOPTION::LATCH_OPTION_3;
+            const std::int32_t generation = ((LATCH >> 24) & 0x1F) != 0 ? 2 : 1;
+            accepted = filter.acceptsGeneration(hasGeneration, generation);
+        }
+        if (accepted && filter.usesPosition()) {
+            const float x = record.read<float>() * cm;
+            const float y = record.read<float>() * cm;
+            accepted = filter.acceptsPosition(x, y, particleZValue_);
+        }
+        if (accepted) return false;
+
+        rejected.type = type;
+        rejected.isNewHistory = isNewHistory;
+        rejected.incrementalHistories = 1;
+        return true;
+    }
+
+    std::size_t Reader::readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block)
+    {
+        const std::size_t recordLength = getParticleRecordLength();
+        if (records.remainingToRead() < numberOfRecords * recordLength) {
+            throw std::runtime_error("Not enough data to decode the requested number of EGS particle records.");
+        }
+
+        const std::size_t first = block.size();
+        block.resize(first + numberOfRecords);
+
+        ParticleType * types = block.getTypes().data() + first;
+        float * energies = block.getKineticEnergies().data() + first;
+        float * xs = block.getXPositions().data() + first;
+        float * ys = block.getYPositions().data() + first;
+        float * zs = block.getZPositions().data() + first;
+        float * us = block.getDirectionalCosinesX().data() + first;
+        float * vs = block.getDirectionalCosinesY().data() + first;
+        float * ws = block.getDirectionalCosinesZ().data() + first;
+        float * weights = block.getWeights().data() + first;
+        std::uint8_t * isNewHistory = block.getNewHistoryFlags().data() + first;
+        std::uint32_t * incrementalHistories = block.getIncrementalHistories().data() + first;
+
+        // Add every property column before taking references, adding a column may move the others
+        const bool hasGeneration = latchOption_ == EGSLATCHOPTION::LATCH_OPTION_2 || latchOption_ == EGSLATCHOPTION::LATCH_OPTION_3;
+        block.addIntColumn(IntPropertyType::EGS_LATCH);
+        block.addBoolColumn(BoolPropertyType::IS_MULTIPLE_CROSSER);
+        if (hasGeneration) {
+            block.addIntColumn(IntPropertyType::GENERATION);
+            block.addBoolColumn(BoolPropertyType::IS_SECONDARY_PARTICLE);
+        }
+        if (mode_ == EGSMODE::MODE2) block.addFloatColumn(FloatPropertyType::ZLAST);
+
+        ParticleBlock::IntColumn & latchColumn = block.addIntColumn(IntPropertyType::EGS_LATCH);
+        ParticleBlock::BoolColumn & multipleCrosserColumn = block.addBoolColumn(BoolPropertyType::IS_MULTIPLE_CROSSER);
+        ParticleBlock::IntColumn * generationColumn = hasGeneration ? &block.addIntColumn(IntPropertyType::GENERATION) : nullptr;
+        ParticleBlock::BoolColumn * secondaryColumn = hasGeneration ? &block.addBoolColumn(BoolPropertyType::IS_SECONDARY_PARTICLE) : nullptr;
+        ParticleBlock::FloatColumn * zlastColumn = mode_ == EGSMODE::MODE2 ? &block.addFloatColumn(FloatPropertyType::ZLAST) : nullptr;
+
+        // Gather the fixed stride records into the columns, a field at a time
+        records.peekColumn(std::span<std::int32_t>(latchColumn.values.data() + first, numberOfRecords), 0, recordLength); // the bits of the unsigned LATCH
+        records.peekColumn(std::span<float>(energies, numberOfRecords), 4, recordLength); // keep in explicit MeV for now, rest mass needs to be subtracted in a consistent way
+        records.peekColumn(std::span<float>(xs, numberOfRecords), 8, recordLength);
+        records.peekColumn(std::span<float>(ys, numberOfRecords), 12, recordLength);
+        records.peekColumn(std::span<float>(us, numberOfRecords), 16, recordLength);
+        records.peekColumn(std::span<float>(vs, numberOfRecords), 20, recordLength);
+        records.peekColumn(std::span<float>(weights, numberOfRecords), 24, recordLength);
+        if (zlastColumn) records.peekColumn(std::span<float>(zlastColumn->values.data() + first, numberOfRecords), 28, recordLength);
+        records.readBytes(numberOfRecords * recordLength);
+
+        CalcThirdUnitComponents(us, vs, ws, numberOfRecords);
+
+        // Branch free passes which the compiler can vectorize
+        for (std::size_t i = 0; i < numberOfRecords; i++) {
+            xs[i] *= cm;
+            ys[i] *= cm;
+            zs[i] = particleZValue_; // EGS format does not store the particle z value
+            const bool wSignIsNegative = weights[i] < 0;
+            ws[i] = wSignIsNegative ? -ws[i] : ws[i]; // restore w directional component sign
+            weights[i] = wSignIsNegative ? -weights[i] : weights[i]; // restore weight to positive
+            const bool newHistory = energies[i] < 0;
+            energies[i] = newHistory ? -energies[i] : energies[i];
+            isNewHistory[i] = newHistory ? 1 : 0;
+            incrementalHistories[i] = newHistory ? 1 : 0;
+        }
+        if (zlastColumn) {
+            for (std::size_t i = 0; i < numberOfRecords; i++) zlastColumn->values[first + i] *= cm;
+        }
+
+        NormalizeDirectionalCosines(us, vs, ws, numberOfRecords);
+
+        // Particle type, rest mass and LATCH derived properties
+        for (std::size_t i = 0; i < numberOfRecords; i++) {
+            const unsigned int LATCH = static_cast<unsigned int>(latchColumn.values[first + i]);
+            switch ((LATCH >> 29) & 3) {
+                case 0: // Neutral particle
+                    types[i] = ParticleType::Photon;
+                    break;
+                case 1: // Negative particle
+                    types[i] = ParticleType::Electron;
+                    energies[i] -= ELECTRON_REST_MASS_MEV; // Convert to kinetic energy
+                    break;
+                case 2: // Positive particle
+                    types[i] = ParticleType::Positron;
+                    energies[i] -= ELECTRON_REST_MASS_MEV; // Convert to kinetic energy
+                    break;
+                default: // Error
+                    block.resize(first);
+                    throw std::runtime_error("Invalid particle charge bits.");
+            }
+            energies[i] *= MeV; // Convert to internal units
+
+            latchColumn.isSet[first + i] = 1;
+            multipleCrosserColumn.values[first + i] = static_cast<std::uint8_t>((LATCH >> 31) & 1);
+            multipleCrosserColumn.isSet[first + i] = 1;
+            if (hasGeneration) {
+                // Particle is secondary if bits 24-28 are non-zero, otherwise primary
+                const int generation = ((LATCH >> 24) & 0x1F) != 0 ? 2 : 1;
+                generationColumn->values[first + i] = generation;
+                generationColumn->isSet[first + i] = 1;
+                secondaryColumn->values[first + i] = generation > 1 ? 1 : 0;
+                secondaryColumn->isSet[first + i] = 1;
+            }
+            if (zlastColumn) zlastColumn->isSet[first + i] = 1;
+        }
+
+        return numberOfRecords;
+    }
+
+
     // Writer class implementation
     Writer::Writer(const std::string & fileName, const UserOptions & options)
     : PhaseSpaceFileWriter("EGS", fileName, options), latchOption_(EGSLATCHOPTION::LATCH_OPTION_2)
@@ -208,13 +369,92 @@ namespace ParticleZoo::EGSphspFile
         buffer.write<float>(numberOfOriginalHistories_);
     }
 
-    void Writer::writeBinaryParticle(ByteBuffer & buffer, Particle & particle)
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileWriter & other)
+    {
+        const Writer & otherWriter = dynamic_cast<const Writer &>(other);
+        if (otherWriter.mode_ != mode_) {
+            throw std::runtime_error("Cannot merge EGS phase-space files written in different modes.");
+        }
+        numberOfParticles_ += otherWriter.numberOfParticles_;
+        numberOfPhotons_ += otherWriter.numberOfPhotons_;
+        maxKineticEnergy_ = std::max(maxKineticEnergy_, otherWriter.maxKineticEnergy_);
+        minElectronEnergy_ = std::min(minElectronEnergy_, otherWriter.minElectronEnergy_);
+        // The other file's count already covers the histories it recorded, see writeHeaderData()
+        numberOfOriginalHistories_ += otherWriter.numberOfOriginalHistories_;
+        historyCountManualSet_ = historyCountManualSet_ || otherWriter.historyCountManualSet_;
+    }
+
+    bool Writer::hasSameRecordLayout(const PhaseSpaceFileReader & reader) const
+    {
+        const Reader * egsReader = dynamic_cast<const Reader *>(&reader);
+        if (!egsReader || egsReader->getMode() != mode_) return false;
+        // Records beyond the particle count in the header would be copied without being counted
+        // (the header and records of a file in the same mode have the same lengths as this writer's)
+        const std::uint64_t recordBytes = egsReader->getNumberOfParticles() * getParticleRecordLength();
+        return egsReader->getFileSize() == getParticleRecordStartOffset() + recordBytes;
+    }
+
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileReader & reader)
+    {
+        const Reader & egsReader = dynamic_cast<const Reader &>(reader);
+        numberOfParticles_ += static_cast<unsigned int>(egsReader.getNumberOfParticles());
+        numberOfPhotons_ += egsReader.getNumberOfPhotons();
+        maxKineticEnergy_ = std::max(maxKineticEnergy_, egsReader.getMaxKineticEnergy());
+        minElectronEnergy_ = std::min(minElectronEnergy_, egsReader.getMinElectronEnergy());
+        numberOfOriginalHistories_ += static_cast<float>(egsReader.getNumberOfOriginalHistories());
+    }
+
+    void Writer::countParticleStats(const Particle & particle)
     {
         numberOfParticles_++;
         if (particle.getType() == ParticleType::Photon) {
             numberOfPhotons_++;
         }
 
+        // Update energy stats in internal units
+        float energy = particle.getKineticEnergy();
+        if (energy > maxKineticEnergy_) {
+            maxKineticEnergy_ = energy;
+        }
+        if (particle.getType() == ParticleType::Electron && energy < minElectronEnergy_) {
+            minElectronEnergy_ = energy;
+        }
+
+        if (particle.isNewHistory() && !historyCountManualSet_) {
+            numberOfOriginalHistories_++;
+        }
+    }
+
+    void Writer::countParticleBlockStats(const ParticleBlock & block)
+    {
+        std::span<const ParticleType> types = block.getTypes();
+        std::span<const float> energies = block.getKineticEnergies();
+        std::span<const std::uint8_t> isNewHistory = block.getNewHistoryFlags();
+
+        numberOfParticles_ += block.size();
+        for (std::size_t i = 0; i < block.size(); i++) {
+            if (types[i] == ParticleType::Photon) {
+                numberOfPhotons_++;
+            }
+
+            // Update energy stats in internal units
+            if (energies[i] > maxKineticEnergy_) {
+                maxKineticEnergy_ = energies[i];
+            }
+            if (types[i] == ParticleType::Electron && energies[i] < minElectronEnergy_) {
+                minElectronEnergy_ = energies[i];
+            }
+
+            if (isNewHistory[i] && !historyCountManualSet_) {
+                numberOfOriginalHistories_++;
+            }
+        }
+    }
+
+    void Writer::writeBinaryParticle(ByteBuffer & buffer, Particle & particle)
+    {
+        countParticleStats(particle);
+
         constexpr float inv_cm = 1.0f / cm;
         constexpr float inv_MeV = 1.0f / MeV;
 
@@ -230,14 +470,6 @@ namespace ParticleZoo::EGSphspFile
             weight = -weight; // store weight as negative to indicate negative w direction
         }
 
-        // Update energy stats in internal units
-        if (energy > maxKineticEnergy_) {
-            maxKineticEnergy_ = energy;
-        }
-        if (particle.getType() == ParticleType::Electron && energy < minElectronEnergy_) {
-            minElectronEnergy_ = energy;
-        }
-
         unsigned int LATCH = ExtractLATCHFromParticle(particle, latchOption_);
         
         energy *= inv_MeV; // Convert to MeV before adding rest mass if needed
@@ -257,7 +489,6 @@ namespace ParticleZoo::EGSphspFile
 
         if (particle.isNewHistory()) {
             energy *= -1;
-            if (!historyCountManualSet_) numberOfOriginalHistories_++;
         }
 
         buffer.write<unsigned int>(LATCH);
@@ -0,0 +1,263 @@
+
+#include "particlezoo/parallel/ChunkedParallelReader.h"
+
+#include "particlezoo/utilities/formats.h"
+
+#include <algorithm>
+
+namespace ParticleZoo {
+
+    ChunkedParallelReader::ChunkedParallelReader(const std::string& filename, const UserOptions& options, size_t numThreads, std::uint64_t historiesPerChunk)
+    : nextChunk_(0), hasGapsBetweenHistories_(false), historiesPerChunk_(historiesPerChunk), emptyHistoriesBetweenEachHistory_(0), perHistoryErrorContribution_(0)
+    {
+        if (numThreads < 1) {
+            throw std::invalid_argument("Number of threads must be at least 1 in ChunkedParallelReader");
+        }
+        if (historiesPerChunk < 1) {
+            throw std::invalid_argument("Number of histories per chunk must be at least 1 in ChunkedParallelReader");
+        }
+
+        // Create PhaseSpaceFileReader instances for each thread, cloning the first so that the header is only read once
+        readers_.reserve(numThreads);
+        auto firstReader = FormatRegistry::CreateReader(filename, options);
+        if (!firstReader) {
+            throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + filename);
+        }
+        readers_.emplace_back(std::move(firstReader));
+        for (size_t i = 1; i < numThreads; ++i) {
+            readers_.emplace_back(readers_[0]->clone());
+        }
+
+        // Detect if the format provides native represented history count or incremental history counters
+        hasNativeRepresentedHistoryCount_ = readers_[0]->hasNativeRepresentedHistoryCount();
+        hasNativeIncrementalHistoryCounters_ = readers_[0]->hasNativeIncrementalHistoryCounters();
+
+        // Use the history index sidecar if there is one, otherwise index the start of every chunk
+        historyIndex_ = HistoryIndex::Load(readers_[0]->getFileName());
+        if (!historyIndex_) {
+            historyIndex_ = readers_[0]->buildHistoryIndex(historiesPerChunk_);
+            readers_[0]->moveToParticle(0);
+        }
+
+        // Determine the number of represented histories
+        numberOfRepresentedHistories_ = hasNativeRepresentedHistoryCount_
+                                      ? readers_[0]->getNumberOfRepresentedHistories()
+                                      : historyIndex_->getNumberOfRepresentedHistories();
+
+        if (numberOfRepresentedHistories_ == 0) {
+            throw std::runtime_error("Phase space file contains zero represented histories: " + filename);
+        }
+
+        // Chunks can only cover histories that are in the index
+        const std::uint64_t indexedHistories = std::min(numberOfRepresentedHistories_, historyIndex_->getNumberOfRepresentedHistories());
+        numberOfChunks_ = (indexedHistories + historiesPerChunk_ - 1) / historiesPerChunk_;
+
+        // Get the number of original histories
+        numberOfOriginalHistories_ = readers_[0]->getNumberOfOriginalHistories();
+
+        // Get the number of particles in the phase space
+        numberOfParticlesInPhsp_ = readers_[0]->getNumberOfParticles();
+
+        // Determine if there are gaps between histories
+        std::uint64_t numberOfEmptyHistories = (numberOfRepresentedHistories_ < numberOfOriginalHistories_)
+                                            ? (numberOfOriginalHistories_ - numberOfRepresentedHistories_)
+                                            : 0;
+        hasGapsBetweenHistories_ = numberOfEmptyHistories > 0;
+
+        // Calculate gap distribution parameters if there are gaps
+        if (hasGapsBetweenHistories_) {
+            emptyHistoriesBetweenEachHistory_ = numberOfEmptyHistories / numberOfRepresentedHistories_;
+            perHistoryErrorContribution_ = numberOfEmptyHistories % numberOfRepresentedHistories_;
+        }
+
+        // Every reader starts at the first history, which is where the first chunk begins
+        threadStats_.reserve(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            threadStats_.emplace_back(std::make_unique<ThreadStatistics>());
+        }
+    }
+
+    bool ChunkedParallelReader::claimNextChunk(size_t threadIndex) {
+        const std::uint64_t chunk = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= numberOfChunks_) {
+            return false;
+        }
+
+        ThreadStatistics & stats = *threadStats_[threadIndex];
+        const std::uint64_t firstHistory = chunk * historiesPerChunk_;
+
+        // The reader is already in place if this chunk follows the one the thread just finished
+        if (stats.historiesRead != firstHistory) {
+            readers_[threadIndex]->moveToHistory(firstHistory, *historyIndex_);
+            stats.historiesRead = firstHistory;
+        }
+        stats.chunkEndHistory = std::min(firstHistory + historiesPerChunk_, numberOfRepresentedHistories_);
+
+        // Start the gap distribution where it would be had every history before this chunk been read in order
+        if (hasGapsBetweenHistories_) {
+            std::uint64_t initialError = numberOfRepresentedHistories_ / 2;
+            stats.emptyHistoryError = (initialError + firstHistory * perHistoryErrorContribution_) % numberOfRepresentedHistories_;
+        }
+
+        return true;
+    }
+
+    bool ChunkedParallelReader::hasMoreParticles(size_t threadIndex) {
+        // Validate thread index
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in hasMoreParticles()");
+        }
+
+        ThreadStatistics & stats = *threadStats_[threadIndex];
+
+        // check the cache first
+        if (stats.hasMoreParticlesCache != NEEDS_CHECKING) {
+            return stats.hasMoreParticlesCache == HAS_MORE_PARTICLES;
+        }
+
+        bool hasMoreParticles = false;
+        for (;;) {
+            // Check whether the current chunk has more particles, it ends at the first particle of the next chunk
+            if (stats.historiesRead < stats.chunkEndHistory) {
+                hasMoreParticles = readers_[threadIndex]->hasMoreParticles();
+            } else if (stats.chunkEndHistory > 0 && readers_[threadIndex]->hasMoreParticles()) {
+                hasMoreParticles = !readers_[threadIndex]->peekNextParticle().isNewHistory();
+            }
+            if (hasMoreParticles) break;
+
+            // Claim another chunk, stopping once there are none left
+            if (!claimNextChunk(threadIndex)) break;
+        }
+
+        // Update the cache
+        stats.hasMoreParticlesCache = hasMoreParticles ? HAS_MORE_PARTICLES : NO_MORE_PARTICLES;
+
+        return hasMoreParticles;
+    }
+
+    Particle ChunkedParallelReader::getNextParticle(size_t threadIndex) {
+        // Validate thread index
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getNextParticle()");
+        }
+        if (!hasMoreParticles(threadIndex)) {
+            throw std::runtime_error("No more particles to read in getNextParticle() for thread index " + std::to_string(threadIndex));
+        }
+
+        ThreadStatistics & stats = *threadStats_[threadIndex];
+
+        // reset the cache since we are consuming a particle
+        stats.hasMoreParticlesCache = NEEDS_CHECKING;
+
+        // Get the next particle from the appropriate reader
+        Particle particle = readers_[threadIndex]->getNextParticle();
+
+        // Update history count if this particle starts a new history
+        int32_t incrementalHistoryNumber = 0;
+        if (particle.isNewHistory()) {
+            if (hasGapsBetweenHistories_) {
+                stats.emptyHistoryError += perHistoryErrorContribution_;
+                if (stats.emptyHistoryError >= numberOfRepresentedHistories_) {
+                    incrementalHistoryNumber = static_cast<int32_t>(2 + emptyHistoriesBetweenEachHistory_);
+                    stats.emptyHistoryError -= numberOfRepresentedHistories_;
+                } else {
+                    incrementalHistoryNumber = static_cast<int32_t>(1 + emptyHistoriesBetweenEachHistory_);
+                }
+            } else {
+                incrementalHistoryNumber = 1;
+            }
+            stats.historiesRead++;
+        }
+
+        stats.particlesRead.add();
+        stats.totalHistoriesRead.add(static_cast<std::uint64_t>(incrementalHistoryNumber));
+
+        particle.setIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER, incrementalHistoryNumber);
+
+        return particle;
+    }
+
+    std::size_t ChunkedParallelReader::readParticles(size_t threadIndex, std::span<Particle> particles) {
+        std::size_t particlesRead = 0;
+        while (particlesRead < particles.size() && hasMoreParticles(threadIndex)) {
+            particles[particlesRead++] = getNextParticle(threadIndex);
+        }
+        return particlesRead;
+    }
+
+    Particle ChunkedParallelReader::peekNextParticle(size_t threadIndex) {
+        // Validate thread index
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in peekNextParticle()");
+        }
+        if (!hasMoreParticles(threadIndex)) {
+            throw std::runtime_error("No more particles to read in peekNextParticle() for thread index " + std::to_string(threadIndex));
+        }
+
+        // Peek at the next particle from the appropriate reader
+        return readers_[threadIndex]->peekNextParticle();
+    }
+
+    std::uint64_t ChunkedParallelReader::getHistoriesRead(size_t threadIndex) const {
+        // Validate thread index
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getHistoriesRead()");
+        }
+        return threadStats_[threadIndex]->totalHistoriesRead.load();
+    }
+
+    std::uint64_t ChunkedParallelReader::getParticlesRead(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getParticlesRead()");
+        }
+        return threadStats_[threadIndex]->particlesRead.load();
+    }
+
+    std::uint64_t ChunkedParallelReader::getTotalParticlesRead() const {
+        std::uint64_t total = 0;
+        for (size_t t = 0; t < readers_.size(); t++)
+            total += threadStats_[t]->particlesRead.load();
+        return total;
+    }
+
+    std::uint64_t ChunkedParallelReader::getTotalHistoriesRead() const {
+        std::uint64_t total = 0;
+        for (size_t t = 0; t < readers_.size(); t++)
+            total += threadStats_[t]->totalHistoriesRead.load();
+        return total;
+    }
+
+    IOProfile ChunkedParallelReader::getIOProfile(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getIOProfile()");
+        }
+        return readers_[threadIndex]->getIOProfile();
+    }
+
+    IOProfile ChunkedParallelReader::getTotalIOProfile() const {
+        IOProfile total;
+        for (const auto & reader : readers_) {
+            total += reader->getIOProfile();
+        }
+        return total;
+    }
+
+    bool ChunkedParallelReader::hasNativeRepresentedHistoryCount() const {
+        return hasNativeRepresentedHistoryCount_;
+    }
+
+    bool ChunkedParallelReader::hasNativeIncrementalHistoryCounters() const {
+        return hasNativeIncrementalHistoryCounters_;
+    }
+
+    void ChunkedParallelReader::close() {
+        for (auto& reader : readers_) {
+            reader->close();
+        }
+    }
+
+    ChunkedParallelReader::~ChunkedParallelReader() {
+        close();
+    }
+
+}  // namespace ParticleZoo
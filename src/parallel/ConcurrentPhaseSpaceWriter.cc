@@ -0,0 +1,198 @@
+#include "particlezoo/parallel/ConcurrentPhaseSpaceWriter.h"
+
+#include "particlezoo/utilities/formats.h"
+
+#include <fstream>
+
+namespace ParticleZoo {
+
+    struct ConcurrentPhaseSpaceWriter::Lane {
+        std::unique_ptr<PhaseSpaceFileWriter> encoder; // encodes the particles into the buffer of its writer and counts their statistics
+        std::fstream file;                              // handle of the thread on the output file, positioned independently of the others
+        std::vector<byte> history;                      // start of the current history, moved out of the buffer when it filled up
+        bool historyStarted = false;
+    };
+
+    ConcurrentPhaseSpaceWriter::ConcurrentPhaseSpaceWriter(const std::string& fileName, size_t numberOfThreads, const UserOptions& options, const FixedValues& fixedValues, const std::string& formatName)
+    : fileName_(fileName), maximumRecordLength_(0), endOffset_(0), closed_(false)
+    {
+        if (numberOfThreads < 1) {
+            throw std::invalid_argument("Number of threads must be at least 1 in ConcurrentPhaseSpaceWriter");
+        }
+        if (IsStandardStream(fileName_)) {
+            throw std::runtime_error("Particles cannot be written concurrently to standard output.");
+        }
+
+        auto createWriter = [&]() {
+            auto writer = formatName.empty()
+                        ? FormatRegistry::CreateWriter(fileName_, options, fixedValues)
+                        : FormatRegistry::CreateWriter(formatName, fileName_, options, fixedValues);
+            if (!writer) {
+                throw std::runtime_error("Failed to create PhaseSpaceFileWriter for file: " + fileName_);
+            }
+            return writer;
+        };
+
+        writer_ = createWriter();
+        switch (writer_->formatType_) {
+            case FormatType::BINARY:
+                maximumRecordLength_ = writer_->getParticleRecordLength();
+                break;
+            case FormatType::ASCII:
+                maximumRecordLength_ = writer_->getMaximumASCIILineLength();
+                break;
+            default:
+                throw std::runtime_error("Particles cannot be written concurrently to the " + writer_->getPHSPFormat() + " format, which writes its files through a library of its own.");
+        }
+        endOffset_ = writer_->getParticleRecordStartOffset();
+
+        // The encoders open the output file as well, which is closed again before anything is written to it
+        lanes_.reserve(numberOfThreads);
+        for (size_t i = 0; i < numberOfThreads; ++i) {
+            auto lane = std::make_unique<Lane>();
+            lane->encoder = createWriter();
+            lane->encoder->file_.close();
+            // A record can be written together with a pseudo-particle for the empty histories before it
+            if (lane->encoder->buffer_.capacity() < 2 * maximumRecordLength_) {
+                throw std::runtime_error("The write buffer is too small to write particles concurrently.");
+            }
+            lane->file.rdbuf()->pubsetbuf(nullptr, 0); // whole blocks are written at once
+            lane->file.open(fileName_, std::ios::in | std::ios::out | std::ios::binary);
+            if (!lane->file.is_open()) {
+                throw std::runtime_error("Failed to open file: " + fileName_);
+            }
+            lanes_.emplace_back(std::move(lane));
+        }
+    }
+
+    ConcurrentPhaseSpaceWriter::Lane & ConcurrentPhaseSpaceWriter::getLane(size_t threadIndex, const char * method) {
+        if (threadIndex >= lanes_.size()) {
+            throw std::out_of_range(std::string("Thread index out of range in ") + method);
+        }
+        return *lanes_[threadIndex];
+    }
+
+    void ConcurrentPhaseSpaceWriter::writeParticle(size_t threadIndex, const Particle& particle) {
+        Lane & lane = getLane(threadIndex, "writeParticle()");
+        Particle particleToWrite = particle;
+        writeParticleInLane(lane, particleToWrite);
+    }
+
+    void ConcurrentPhaseSpaceWriter::writeParticle(size_t threadIndex, Particle&& particle) {
+        writeParticleInLane(getLane(threadIndex, "writeParticle()"), particle);
+    }
+
+    void ConcurrentPhaseSpaceWriter::addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories) {
+        getLane(threadIndex, "addAdditionalHistories()").encoder->addAdditionalHistories(additionalHistories);
+    }
+
+    void ConcurrentPhaseSpaceWriter::writeParticleInLane(Lane & lane, Particle & particle) {
+        if (closed_) {
+            throw std::runtime_error("Attempting to write a particle to " + fileName_ + " after it was closed.");
+        }
+        if (!lane.historyStarted) {
+            if (!particle.isNewHistory()) {
+                throw std::runtime_error("The first particle written by each thread must start a new history.");
+            }
+            lane.historyStarted = true;
+        }
+
+        // Keep enough room for the encoder to write the particle without flushing its buffer itself
+        ByteBuffer & buffer = lane.encoder->buffer_;
+        if (buffer.remainingToWrite() < 2 * maximumRecordLength_) {
+            if (particle.isNewHistory()) {
+                writeBlock(lane);
+            } else {
+                lane.history.insert(lane.history.end(), buffer.data(), buffer.data() + buffer.length());
+                buffer.clear();
+            }
+        }
+        lane.encoder->writeParticle(std::move(particle));
+    }
+
+    void ConcurrentPhaseSpaceWriter::writeBlock(Lane & lane) {
+        PhaseSpaceFileWriter & encoder = *lane.encoder;
+        ByteBuffer & buffer = encoder.buffer_;
+        const std::uint64_t bytes = lane.history.size() + buffer.length();
+        if (bytes == 0) {
+            return;
+        }
+
+        const std::uint64_t offset = endOffset_.fetch_add(bytes, std::memory_order_relaxed);
+        {
+            ProfileTimer timer = encoder.timeIO();
+            lane.file.seekp(static_cast<std::streamoff>(offset));
+            lane.file.write(reinterpret_cast<const char*>(lane.history.data()), static_cast<std::streamsize>(lane.history.size()));
+            lane.file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.length()));
+        }
+        if (!lane.file) {
+            throw std::runtime_error("Failed to write particles to file: " + fileName_);
+        }
+        encoder.countBlockWritten(bytes);
+        lane.history.clear();
+        buffer.clear();
+    }
+
+    std::uint64_t ConcurrentPhaseSpaceWriter::getHistoriesWritten() const {
+        if (closed_) {
+            return writer_->getHistoriesWritten();
+        }
+        std::uint64_t total = 0;
+        for (const auto& lane : lanes_)
+            total += lane->encoder->getHistoriesWritten();
+        return total;
+    }
+
+    std::uint64_t ConcurrentPhaseSpaceWriter::getParticlesWritten() const {
+        if (closed_) {
+            return writer_->getParticlesWritten();
+        }
+        std::uint64_t total = 0;
+        for (const auto& lane : lanes_)
+            total += lane->encoder->getParticlesWritten();
+        return total;
+    }
+
+    IOProfile ConcurrentPhaseSpaceWriter::getIOProfile() const {
+        IOProfile total = writer_->getIOProfile();
+        for (const auto& lane : lanes_)
+            total += lane->encoder->getIOProfile();
+        return total;
+    }
+
+    void ConcurrentPhaseSpaceWriter::close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+
+        // Every history is complete once the threads are done, so the rest of each buffer is a block
+        std::uint64_t pendingHistories = 0;
+        for (auto& lane : lanes_) {
+            writeBlock(*lane);
+            lane->file.close();
+            if (lane->file.fail()) {
+                throw std::runtime_error("Failed to write particles to file: " + fileName_);
+            }
+
+            PhaseSpaceFileWriter & encoder = *lane->encoder;
+            writer_->mergeStatisticsFrom(encoder);
+            writer_->historiesWritten_ += encoder.historiesWritten_;
+            writer_->particlesWritten_ += encoder.particlesWritten_;
+            pendingHistories += encoder.getPendingHistories();
+        }
+        if (writer_->particlesWritten_ > writer_->getMaximumSupportedParticles()) {
+            throw std::runtime_error("Maximum number of particles reached for this writer (" + std::to_string(writer_->getMaximumSupportedParticles()) + ").");
+        }
+
+        // Anything the format writes for the empty histories left over goes after the records of the threads
+        writer_->file_.seekp(static_cast<std::streamoff>(endOffset_.load()));
+        writer_->addAdditionalHistories(pendingHistories);
+        writer_->close();
+    }
+
+    ConcurrentPhaseSpaceWriter::~ConcurrentPhaseSpaceWriter() {
+        close();
+    }
+
+}  // namespace ParticleZoo
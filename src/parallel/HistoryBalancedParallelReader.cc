@@ -3,54 +3,56 @@
 
 #include "particlezoo/utilities/formats.h"
 
+#include <utility>
+
 namespace ParticleZoo {
 
     HistoryBalancedParallelReader::HistoryBalancedParallelReader(const std::string& filename, const UserOptions& options, size_t numThreads)
-    : hasGapsBetweenHistories_(false), emptyHistoriesBetweenEachHistory_(0), perHistoryErrorContribution_(0)
+    : placement_(options, numThreads), hasGapsBetweenHistories_(false), emptyHistoriesBetweenEachHistory_(0), perHistoryErrorContribution_(0)
     {
         if (numThreads < 1) {
             throw std::invalid_argument("Number of threads must be at least 1 in HistoryBalancedParallelReader");
         }
+        createReaders(filename, options, numThreads);
+
+        // The readers find where the threads start between them, and are left there as far as the scan allows
+        setPartition(HistoryPartition::Compute(readers_, numThreads));
+    }
+
+    HistoryBalancedParallelReader::HistoryBalancedParallelReader(const std::string& filename, const UserOptions& options, const HistoryPartition& partition)
+    : placement_(options, partition.getNumberOfParts()), hasGapsBetweenHistories_(false), emptyHistoriesBetweenEachHistory_(0), perHistoryErrorContribution_(0)
+    {
+        createReaders(filename, options, partition.getNumberOfParts());
+        if (readers_[0]->getNumberOfParticles() != partition.getNumberOfParticles()) {
+            throw std::invalid_argument("The history partition given was computed for a file with " + std::to_string(partition.getNumberOfParticles()) + " particles, not for " + filename + " which has " + std::to_string(readers_[0]->getNumberOfParticles()) + ".");
+        }
+        setPartition(partition);
+    }
 
-        // Create PhaseSpaceFileReader instances for each thread
+    void HistoryBalancedParallelReader::createReaders(const std::string& filename, const UserOptions& options, size_t numThreads) {
+        // Create PhaseSpaceFileReader instances for each thread, cloning the first so that the header is only read once
         readers_.reserve(numThreads);
-        for (size_t i = 0; i < numThreads; ++i) {
-            auto reader = FormatRegistry::CreateReader(filename, options);
-            if (!reader) {
-                throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + filename);
-            }
-            readers_.emplace_back(std::move(reader));
+        auto firstReader = FormatRegistry::CreateReader(filename, options);
+        if (!firstReader) {
+            throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + filename);
+        }
+        readers_.emplace_back(std::move(firstReader));
+        for (size_t i = 1; i < numThreads; ++i) {
+            readers_.emplace_back(readers_[0]->clone());
         }
 
         // Detect if the format provides native represented history count or incremental history counters
         hasNativeRepresentedHistoryCount_ = readers_[0]->hasNativeRepresentedHistoryCount();
         hasNativeIncrementalHistoryCounters_ = readers_[0]->hasNativeIncrementalHistoryCounters();
+    }
 
-        // Determine the number of represented histories
-        if (hasNativeRepresentedHistoryCount_) {
-            numberOfRepresentedHistories_ = readers_[0]->getNumberOfRepresentedHistories();
-        } else {
-            // Manually count the number of represented histories by scanning the file
-            numberOfRepresentedHistories_ = 0;
-            auto reader = FormatRegistry::CreateReader(filename, options);
-            while (reader->hasMoreParticles()) {
-                const Particle particle = reader->getNextParticle();
-                if (particle.isNewHistory()) {
-                    numberOfRepresentedHistories_++;
-                }
-            }
-            reader->close();
-        }
-
-        if (numberOfRepresentedHistories_ == 0) {
-            throw std::runtime_error("Phase space file contains zero represented histories: " + filename);
-        }
-
-        // Get the number of original histories and adjust totalHistoriesToRead_ if necessary
-        numberOfOriginalHistories_ = readers_[0]->getNumberOfOriginalHistories();
-
-        // Get the number of particles in the phase space
-        numberOfParticlesInPhsp_ = readers_[0]->getNumberOfParticles();
+    void HistoryBalancedParallelReader::setPartition(const HistoryPartition& partition) {
+        const size_t numThreads = readers_.size();
+        numberOfRepresentedHistories_ = partition.getNumberOfRepresentedHistories();
+        numberOfOriginalHistories_ = partition.getNumberOfOriginalHistories();
+        numberOfParticlesInPhsp_ = partition.getNumberOfParticles();
+        endingHistory_ = partition.getEndHistory();
+        endingRecord_ = partition.getEndRecord();
 
         // Determine if there are gaps between histories
         std::uint64_t numberOfEmptyHistories = (numberOfRepresentedHistories_ < numberOfOriginalHistories_)
@@ -64,58 +66,74 @@ namespace ParticleZoo {
             perHistoryErrorContribution_ = numberOfEmptyHistories % numberOfRepresentedHistories_;
         }
 
-        // Calculate starting history for each thread
+        // Set up each thread at the starting history of its part
         startingHistorys_.reserve(numThreads);
+        startingRecords_.reserve(numThreads);
         threadStats_.reserve(numThreads);
         for (size_t i = 0; i < numThreads; ++i) {
+            const HistoryPartition::Part & part = partition.getPart(i);
             threadStats_.emplace_back(std::make_unique<ThreadStatistics>());
-        }
-        std::uint64_t historiesPerThread = numberOfRepresentedHistories_ / numThreads;
-        std::uint64_t remainderHistories = numberOfRepresentedHistories_ % numThreads;
-        std::uint64_t currentStartingHistory = 0;
-        for (size_t i = 0; i < numThreads; ++i) {
-            startingHistorys_.push_back(currentStartingHistory);
-            threadStats_[i]->historiesRead = currentStartingHistory;
+            startingHistorys_.push_back(part.firstHistory);
+            startingRecords_.push_back(part.firstRecord);
+            threadStats_[i]->historiesRead = part.firstHistory;
             // Calculate the correct initial error for this thread based on how many
             // represented histories have been "processed" before this thread's starting point
             if (hasGapsBetweenHistories_) {
                 std::uint64_t initialError = numberOfRepresentedHistories_ / 2;
-                threadStats_[i]->emptyHistoryError = (initialError + currentStartingHistory * perHistoryErrorContribution_) % numberOfRepresentedHistories_;
+                threadStats_[i]->emptyHistoryError = (initialError + part.firstHistory * perHistoryErrorContribution_) % numberOfRepresentedHistories_;
             }
-            currentStartingHistory += historiesPerThread;
-            if (i < remainderHistories) {
-                currentStartingHistory += 1; // Distribute remainder histories
+            if (readers_[i]->getNextRecordIndex() != part.firstRecord) {
+                readers_[i]->moveToParticle(part.firstRecord);
             }
         }
 
-        // Single-pass scan to find the particle index at each thread's starting history.
-        if (numThreads > 1) {
-            std::vector<std::uint64_t> startingParticleIndices(numThreads, 0);
-            {
-                auto scanner = FormatRegistry::CreateReader(filename, options);
-                std::uint64_t historyCount = 0;
-                std::uint64_t particleIndex = 0;
-                size_t nextThreadToFind = 1; // Thread 0 always starts at particle 0
-
-                while (nextThreadToFind < numThreads && scanner->hasMoreParticles()) {
-                    const Particle particle = scanner->getNextParticle();
-                    if (particle.isNewHistory()) {
-                        if (historyCount == startingHistorys_[nextThreadToFind]) {
-                            startingParticleIndices[nextThreadToFind] = particleIndex;
-                            nextThreadToFind++;
-                        }
-                        historyCount++;
-                    }
-                    particleIndex++;
-                }
-                scanner->close();
+        if (placement_.defersReaders()) {
+            // The last reader is kept to clone the others from, since it has seen the most of an ASCII file's line index
+            for (size_t i = numThreads; i-- > 0;) {
+                releaseReader(i);
             }
+        }
+    }
 
-            // Position each reader at its starting particle using direct seek
-            for (size_t i = 1; i < numThreads; ++i) {
-                readers_[i]->moveToParticle(startingParticleIndices[i]);
-            }
+    PhaseSpaceFileReader & HistoryBalancedParallelReader::getReader(size_t threadIndex) {
+        if (!readers_[threadIndex]) {
+            readers_[threadIndex] = placement_.openReader(threadIndex, *prototype_, startingRecords_[threadIndex]);
         }
+        return *readers_[threadIndex];
+    }
+
+    void HistoryBalancedParallelReader::releaseReader(size_t threadIndex) {
+        // A reader already at the end of the file is kept, there is nothing left for it to buffer
+        if (!readers_[threadIndex] || !readers_[threadIndex]->hasMoreParticles()) return;
+        if (!prototype_) {
+            prototype_ = std::move(readers_[threadIndex]);
+        } else {
+            readers_[threadIndex]->close();
+        }
+        readers_[threadIndex].reset();
+    }
+
+    void HistoryBalancedParallelReader::setThreadPlacement(size_t threadIndex, const ThreadPlacement & placement) {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in setThreadPlacement()");
+        }
+        if (getTotalParticlesRead() > 0) {
+            throw std::runtime_error("Thread placements must be set before any thread starts reading in HistoryBalancedParallelReader");
+        }
+        placement_.setPlacement(threadIndex, placement);
+        releaseReader(threadIndex);
+    }
+
+    std::pair<std::uint64_t, std::uint64_t> HistoryBalancedParallelReader::getByteRange(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getByteRange()");
+        }
+        const PhaseSpaceFileReader & reader = prototype_ ? *prototype_ : *readers_[0];
+        const std::uint64_t firstByte = reader.getRecordByteOffset(startingRecords_[threadIndex]);
+        const std::uint64_t endByte = threadIndex + 1 < readers_.size() ? reader.getRecordByteOffset(startingRecords_[threadIndex + 1])
+                                    : endingRecord_ != HistoryPartition::END_OF_FILE ? reader.getRecordByteOffset(endingRecord_)
+                                    : reader.getFileSize();
+        return { firstByte, endByte };
     }
 
     bool HistoryBalancedParallelReader::hasMoreParticles(size_t threadIndex) {
@@ -130,19 +148,20 @@ namespace ParticleZoo {
         }
 
         // Check if the reader has more particles
-        bool hasMoreParticles = readers_[threadIndex]->hasMoreParticles();
+        PhaseSpaceFileReader & reader = getReader(threadIndex);
+        bool hasMoreParticles = reader.hasMoreParticles();
 
         // Additionally check if we have reached the target number of histories for this thread
         if (hasMoreParticles) {
             // Determine the target number of represented histories for this thread
             std::uint64_t targetHistories = threadIndex < readers_.size() - 1
                                           ? startingHistorys_[threadIndex + 1]
-                                          : numberOfRepresentedHistories_;
+                                          : endingHistory_;
 
             // Check if we have completed all histories for this thread
             if (threadStats_[threadIndex]->historiesRead >= targetHistories) {
                 // Check if the next particle would start a new history
-                const Particle nextParticle = readers_[threadIndex]->peekNextParticle();
+                const Particle nextParticle = reader.peekNextParticle();
                 // If the next particle starts a new history, we have no more particles for this thread
                 hasMoreParticles = !nextParticle.isNewHistory();
             }
@@ -167,37 +186,41 @@ namespace ParticleZoo {
         threadStats_[threadIndex]->hasMoreParticlesCache = NEEDS_CHECKING;
 
         // Get the next particle from the appropriate reader
-        Particle particle = readers_[threadIndex]->getNextParticle();
+        Particle particle = getReader(threadIndex).getNextParticle();
 
         // Update history count if this particle starts a new history
+        ThreadStatistics & stats = *threadStats_[threadIndex];
         int32_t incrementalHistoryNumber = 0;
-        {
-            std::lock_guard<std::mutex> lock(threadStats_[threadIndex]->mutex);
-            threadStats_[threadIndex]->particlesRead++;
-
-            if (particle.isNewHistory()) {
-                if (hasGapsBetweenHistories_) {
-                    threadStats_[threadIndex]->emptyHistoryError += perHistoryErrorContribution_;
-                    if (threadStats_[threadIndex]->emptyHistoryError >= numberOfRepresentedHistories_) {
-                        incrementalHistoryNumber = 2 + emptyHistoriesBetweenEachHistory_;
-                        threadStats_[threadIndex]->emptyHistoryError -= numberOfRepresentedHistories_;
-                    } else {
-                        incrementalHistoryNumber = 1 + emptyHistoriesBetweenEachHistory_;
-                    }
+        if (particle.isNewHistory()) {
+            if (hasGapsBetweenHistories_) {
+                stats.emptyHistoryError += perHistoryErrorContribution_;
+                if (stats.emptyHistoryError >= numberOfRepresentedHistories_) {
+                    incrementalHistoryNumber = 2 + emptyHistoriesBetweenEachHistory_;
+                    stats.emptyHistoryError -= numberOfRepresentedHistories_;
                 } else {
-                    incrementalHistoryNumber = 1;
+                    incrementalHistoryNumber = 1 + emptyHistoriesBetweenEachHistory_;
                 }
-                threadStats_[threadIndex]->historiesRead++;
+            } else {
+                incrementalHistoryNumber = 1;
             }
-
-            threadStats_[threadIndex]->totalHistoriesRead += incrementalHistoryNumber;
+            stats.historiesRead++;
+            stats.totalHistoriesRead.add(incrementalHistoryNumber);
         }
+        stats.particlesRead.add();
 
         particle.setIntProperty(IntPropertyType::INCREMENTAL_HISTORY_NUMBER, incrementalHistoryNumber);
 
         return particle;
     }
 
+    std::size_t HistoryBalancedParallelReader::readParticles(size_t threadIndex, std::span<Particle> particles) {
+        std::size_t particlesRead = 0;
+        while (particlesRead < particles.size() && hasMoreParticles(threadIndex)) {
+            particles[particlesRead++] = getNextParticle(threadIndex);
+        }
+        return particlesRead;
+    }
+
     Particle HistoryBalancedParallelReader::peekNextParticle(size_t threadIndex) {
         // Validate thread index
         if (threadIndex >= readers_.size()) {
@@ -208,7 +231,7 @@ namespace ParticleZoo {
         }
 
         // Peek at the next particle from the appropriate reader
-        return readers_[threadIndex]->peekNextParticle();
+        return getReader(threadIndex).peekNextParticle();
     }
 
     std::uint64_t HistoryBalancedParallelReader::getHistoriesRead(size_t threadIndex) const {
@@ -216,34 +239,50 @@ namespace ParticleZoo {
         if (threadIndex >= readers_.size()) {
             throw std::out_of_range("Thread index out of range in getHistoriesRead()");
         }
-        return threadStats_[threadIndex]->totalHistoriesRead;
+        return threadStats_[threadIndex]->totalHistoriesRead.load();
     }
 
     std::uint64_t HistoryBalancedParallelReader::getParticlesRead(size_t threadIndex) const {
         if (threadIndex >= readers_.size()) {
             throw std::out_of_range("Thread index out of range in getParticlesRead()");
         }
-        return threadStats_[threadIndex]->particlesRead;
+        return threadStats_[threadIndex]->particlesRead.load();
     }
 
     std::uint64_t HistoryBalancedParallelReader::getTotalParticlesRead() const {
         std::uint64_t total = 0;
         for (size_t t = 0; t < readers_.size(); t++)
-            total += threadStats_[t]->particlesRead;
+            total += threadStats_[t]->particlesRead.load();
         return total;
     }
 
     std::uint64_t HistoryBalancedParallelReader::getTotalHistoriesRead() const {
         std::uint64_t total = 0;
         for (size_t t = 0; t < readers_.size(); t++)
-            total += threadStats_[t]->totalHistoriesRead;
+            total += threadStats_[t]->totalHistoriesRead.load();
+        return total;
+    }
+
+    IOProfile HistoryBalancedParallelReader::getIOProfile(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getIOProfile()");
+        }
+        return readers_[threadIndex] ? readers_[threadIndex]->getIOProfile() : IOProfile{};
+    }
+
+    IOProfile HistoryBalancedParallelReader::getTotalIOProfile() const {
+        IOProfile total;
+        for (const auto & reader : readers_) {
+            if (reader) total += reader->getIOProfile();
+        }
         return total;
     }
 
     void HistoryBalancedParallelReader::close() {
         for (auto& reader : readers_) {
-            reader->close();
+            if (reader) reader->close();
         }
+        if (prototype_) prototype_->close();
     }
 
     HistoryBalancedParallelReader::~HistoryBalancedParallelReader() {
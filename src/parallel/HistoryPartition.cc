@@ -0,0 +1,298 @@
+
+#include "particlezoo/parallel/HistoryPartition.h"
+
+#include "particlezoo/utilities/formats.h"
+
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+namespace ParticleZoo {
+
+    namespace {
+
+        constexpr std::size_t SCAN_BLOCK_SIZE = 65536;       // records decoded at a time while scanning
+        constexpr std::uint64_t SCAN_SAMPLE_STRIDE = 1024;   // histories between the positions kept for each range
+        constexpr std::size_t ENCODED_HEADER_SIZE = 6;       // values encoded ahead of the parts
+
+        // The histories found by one reader in its range of records
+        struct RangeScan {
+            std::uint64_t numberOfHistories = 0;
+            std::vector<std::uint64_t> historyStarts;  // record index of every SCAN_SAMPLE_STRIDE-th history starting in the range
+        };
+
+        // Run a task for every reader on its own thread, rethrowing the first error once all have finished
+        template <typename Task>
+        void RunOnEveryReader(const std::vector<std::shared_ptr<PhaseSpaceFileReader>> & readers, Task && task) {
+            std::vector<std::exception_ptr> errors(readers.size());
+            std::vector<std::thread> threads;
+            threads.reserve(readers.size());
+            for (std::size_t i = 0; i < readers.size(); ++i) {
+                threads.emplace_back([&, i]() {
+                    try {
+                        task(i, *readers[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+            }
+            for (auto & thread : threads) thread.join();
+            for (auto & error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+
+        // Read records [firstRecord, lastRecord) of a binary file, calling visitor(recordIndex) for every record that starts a history
+        // until it returns false. The last range of a file is open ended so that it still covers any records not counted in the header.
+        template <typename Visitor>
+        void ScanHistoryStarts(PhaseSpaceFileReader & reader, std::uint64_t firstRecord, std::uint64_t lastRecord, Visitor && visitor) {
+            reader.moveToParticle(firstRecord);
+            ParticleBlock block(static_cast<std::size_t>(std::min<std::uint64_t>(SCAN_BLOCK_SIZE, lastRecord - firstRecord)));
+            std::uint64_t recordIndex = firstRecord;
+            bool oneRecordPerParticle = true;
+            while (oneRecordPerParticle && recordIndex < lastRecord && reader.hasMoreParticles()) {
+                const std::size_t recordsToRead = static_cast<std::size_t>(std::min<std::uint64_t>(SCAN_BLOCK_SIZE, lastRecord - recordIndex));
+                const std::size_t particlesRead = reader.readParticleBlock(block, recordsToRead);
+                if (particlesRead == 0) break;
+                if (reader.getNextRecordIndex() - recordIndex != particlesRead) {
+                    // Some particles were read along with other records, such as the TOPAS pseudo-particles
+                    // standing for empty histories, so the record index of each has to be followed
+                    reader.moveToParticle(recordIndex);
+                    oneRecordPerParticle = false;
+                    break;
+                }
+                std::span<const std::uint8_t> isNewHistory = std::as_const(block).getNewHistoryFlags();
+                for (std::size_t i = 0; i < particlesRead; ++i) {
+                    if (isNewHistory[i] && !visitor(recordIndex + i)) return;
+                }
+                recordIndex = reader.getNextRecordIndex();
+            }
+            while (!oneRecordPerParticle && recordIndex < lastRecord && reader.hasMoreParticles()) {
+                const Particle particle = reader.getNextParticle();
+                if (particle.isNewHistory() && !visitor(recordIndex)) return;
+                recordIndex = reader.getNextRecordIndex();
+            }
+        }
+
+    }
+
+    HistoryPartition HistoryPartition::Compute(const std::string & fileName, const UserOptions & options, std::size_t numberOfParts, std::size_t numberOfScanThreads) {
+        if (numberOfScanThreads < 1) {
+            throw std::invalid_argument("Number of scanning threads must be at least 1 in HistoryPartition");
+        }
+
+        // Clone the first reader so that the header is only read once
+        std::vector<std::shared_ptr<PhaseSpaceFileReader>> readers;
+        readers.reserve(numberOfScanThreads);
+        auto firstReader = FormatRegistry::CreateReader(fileName, options);
+        if (!firstReader) {
+            throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + fileName);
+        }
+        readers.emplace_back(std::move(firstReader));
+        for (std::size_t i = 1; i < numberOfScanThreads; ++i) {
+            readers.emplace_back(readers[0]->clone());
+        }
+
+        HistoryPartition partition = Compute(readers, numberOfParts);
+        for (auto & reader : readers) {
+            reader->close();
+        }
+        return partition;
+    }
+
+    HistoryPartition HistoryPartition::Compute(const std::vector<std::shared_ptr<PhaseSpaceFileReader>> & readers, std::size_t numberOfParts) {
+        if (numberOfParts < 1) {
+            throw std::invalid_argument("Number of parts must be at least 1 in HistoryPartition");
+        }
+        if (readers.empty()) {
+            throw std::invalid_argument("At least one reader is needed to compute a HistoryPartition");
+        }
+        PhaseSpaceFileReader & firstReader = *readers[0];
+        const std::string & fileName = firstReader.getFileName();
+        const std::size_t numberOfRanges = readers.size();
+        const bool hasNativeRepresentedHistoryCount = firstReader.hasNativeRepresentedHistoryCount();
+
+        // Use the history index sidecar if there is one, it removes the need for both scanning passes below
+        const std::optional<HistoryIndex> historyIndex = HistoryIndex::Load(fileName);
+
+        // Otherwise files that can be seeked directly are scanned by all of the readers at once, each over an equal share of the records.
+        // Each reader counts the histories starting in its range and keeps a sparse sample of where they start.
+        const bool scanInParallel = !historyIndex
+                                 && firstReader.supportsRandomAccess()
+                                 && firstReader.getNumberOfRecords() > 0
+                                 && (!hasNativeRepresentedHistoryCount || numberOfParts > 1);
+        std::vector<RangeScan> rangeScans(numberOfRanges);
+        std::vector<std::uint64_t> rangeFirstRecords(numberOfRanges + 1, 0);
+        if (scanInParallel) {
+            const std::uint64_t numberOfRecords = firstReader.getNumberOfRecords();
+            for (std::size_t i = 0; i <= numberOfRanges; ++i) {
+                rangeFirstRecords[i] = i < numberOfRanges ? numberOfRecords * i / numberOfRanges : std::numeric_limits<std::uint64_t>::max();
+            }
+            RunOnEveryReader(readers, [&](std::size_t i, PhaseSpaceFileReader & reader) {
+                if (rangeFirstRecords[i] == rangeFirstRecords[i + 1]) return; // fewer records than threads
+                RangeScan & scan = rangeScans[i];
+                ScanHistoryStarts(reader, rangeFirstRecords[i], rangeFirstRecords[i + 1], [&scan](std::uint64_t recordIndex) {
+                    if (scan.numberOfHistories % SCAN_SAMPLE_STRIDE == 0) scan.historyStarts.push_back(recordIndex);
+                    scan.numberOfHistories++;
+                    return true;
+                });
+            });
+            firstReader.moveToParticle(0); // the first part starts at the beginning of the file
+        }
+
+        HistoryPartition partition;
+
+        // Determine the number of represented histories
+        if (hasNativeRepresentedHistoryCount) {
+            partition.numberOfRepresentedHistories_ = firstReader.getNumberOfRepresentedHistories();
+        } else if (historyIndex) {
+            partition.numberOfRepresentedHistories_ = historyIndex->getNumberOfRepresentedHistories();
+        } else if (scanInParallel) {
+            for (const RangeScan & scan : rangeScans) partition.numberOfRepresentedHistories_ += scan.numberOfHistories;
+        } else {
+            // Manually count the number of represented histories by scanning the file
+            auto reader = firstReader.clone();
+            while (reader->hasMoreParticles()) {
+                const Particle particle = reader->getNextParticle();
+                if (particle.isNewHistory()) {
+                    partition.numberOfRepresentedHistories_++;
+                }
+            }
+            reader->close();
+        }
+
+        if (partition.numberOfRepresentedHistories_ == 0) {
+            throw std::runtime_error("Phase space file contains zero represented histories: " + fileName);
+        }
+
+        partition.numberOfOriginalHistories_ = firstReader.getNumberOfOriginalHistories();
+        partition.numberOfParticles_ = firstReader.getNumberOfParticles();
+        partition.endHistory_ = partition.numberOfRepresentedHistories_;
+        partition.endRecord_ = END_OF_FILE;
+
+        // Calculate the first history of each part, distributing the remainder to the first parts
+        partition.parts_.resize(numberOfParts);
+        const std::uint64_t historiesPerPart = partition.numberOfRepresentedHistories_ / numberOfParts;
+        const std::uint64_t remainderHistories = partition.numberOfRepresentedHistories_ % numberOfParts;
+        std::uint64_t currentStartingHistory = 0;
+        for (std::size_t i = 0; i < numberOfParts; ++i) {
+            partition.parts_[i].firstHistory = currentStartingHistory;
+            currentStartingHistory += historiesPerPart;
+            if (i < remainderHistories) {
+                currentStartingHistory += 1;
+            }
+        }
+        std::vector<Part> & parts = partition.parts_;
+
+        // Find the record each part starts at, directly when the file is indexed
+        if (numberOfParts > 1 && historyIndex && historyIndex->getNumberOfRepresentedHistories() == partition.numberOfRepresentedHistories_) {
+            for (std::size_t i = 1; i < numberOfParts; ++i) {
+                PhaseSpaceFileReader & reader = *readers[i % numberOfRanges];
+                reader.moveToHistory(parts[i].firstHistory, *historyIndex);
+                parts[i].firstRecord = reader.getNextRecordIndex();
+            }
+        } else if (scanInParallel && numberOfParts > 1) {
+            // Stitch the per-range counts together to find the range and sample each starting history falls after,
+            // then have the readers read forward from those samples to the exact starting records, each for its own group of parts
+            std::vector<std::uint64_t> rangeFirstHistories(numberOfRanges + 1, 0);
+            for (std::size_t i = 0; i < numberOfRanges; ++i) {
+                rangeFirstHistories[i + 1] = rangeFirstHistories[i] + rangeScans[i].numberOfHistories;
+            }
+            if (rangeFirstHistories[numberOfRanges] < parts[numberOfParts - 1].firstHistory + 1) {
+                throw std::runtime_error("Phase space file contains fewer histories (" + std::to_string(rangeFirstHistories[numberOfRanges]) + ") than expected (" + std::to_string(partition.numberOfRepresentedHistories_) + "): " + fileName);
+            }
+            RunOnEveryReader(readers, [&](std::size_t r, PhaseSpaceFileReader & reader) {
+                const std::size_t firstPart = std::max<std::size_t>(1, r * numberOfParts / numberOfRanges);
+                const std::size_t endPart = (r + 1) * numberOfParts / numberOfRanges;
+                for (std::size_t i = firstPart; i < endPart; ++i) {
+                    const std::uint64_t startingHistory = parts[i].firstHistory;
+                    const std::size_t range = static_cast<std::size_t>(std::upper_bound(rangeFirstHistories.begin(), rangeFirstHistories.end(), startingHistory) - rangeFirstHistories.begin()) - 1;
+                    const std::uint64_t historyInRange = startingHistory - rangeFirstHistories[range];
+                    std::uint64_t historiesToSkip = historyInRange % SCAN_SAMPLE_STRIDE;
+                    std::uint64_t startingRecord = rangeScans[range].historyStarts[static_cast<std::size_t>(historyInRange / SCAN_SAMPLE_STRIDE)];
+                    if (historiesToSkip > 0) {
+                        ScanHistoryStarts(reader, startingRecord, std::numeric_limits<std::uint64_t>::max(), [&](std::uint64_t recordIndex) {
+                            startingRecord = recordIndex;
+                            return historiesToSkip-- > 0;
+                        });
+                    }
+                    reader.moveToParticle(startingRecord);
+                    parts[i].firstRecord = startingRecord;
+                }
+            });
+        } else if (numberOfParts > 1) {
+            // Single-pass scan to find the record at each part's starting history
+            auto scanner = firstReader.clone();
+            std::uint64_t historyCount = 0;
+            std::size_t nextPartToFind = 1; // The first part always starts at record 0
+
+            while (nextPartToFind < numberOfParts && scanner->hasMoreParticles()) {
+                const std::uint64_t recordIndex = scanner->getNextRecordIndex(); // records folded into the particle belong to its history
+                const Particle particle = scanner->getNextParticle();
+                if (particle.isNewHistory()) {
+                    if (historyCount == parts[nextPartToFind].firstHistory) {
+                        parts[nextPartToFind].firstRecord = recordIndex;
+                        nextPartToFind++;
+                    }
+                    historyCount++;
+                }
+            }
+            scanner->close();
+        }
+
+        return partition;
+    }
+
+    HistoryPartition HistoryPartition::Decode(std::span<const std::uint64_t> values) {
+        if (values.size() < ENCODED_HEADER_SIZE || values[5] == 0 || values.size() != ENCODED_HEADER_SIZE + 2 * values[5]) {
+            throw std::invalid_argument("The values given are not an encoded HistoryPartition.");
+        }
+        HistoryPartition partition;
+        partition.numberOfRepresentedHistories_ = values[0];
+        partition.numberOfOriginalHistories_ = values[1];
+        partition.numberOfParticles_ = values[2];
+        partition.endHistory_ = values[3];
+        partition.endRecord_ = values[4];
+        partition.parts_.resize(static_cast<std::size_t>(values[5]));
+        for (std::size_t i = 0; i < partition.parts_.size(); ++i) {
+            partition.parts_[i].firstHistory = values[ENCODED_HEADER_SIZE + 2 * i];
+            partition.parts_[i].firstRecord = values[ENCODED_HEADER_SIZE + 2 * i + 1];
+        }
+        return partition;
+    }
+
+    std::vector<std::uint64_t> HistoryPartition::encode() const {
+        std::vector<std::uint64_t> values;
+        values.reserve(ENCODED_HEADER_SIZE + 2 * parts_.size());
+        values.insert(values.end(), { numberOfRepresentedHistories_, numberOfOriginalHistories_, numberOfParticles_, endHistory_, endRecord_, static_cast<std::uint64_t>(parts_.size()) });
+        for (const Part & part : parts_) {
+            values.push_back(part.firstHistory);
+            values.push_back(part.firstRecord);
+        }
+        return values;
+    }
+
+    HistoryPartition HistoryPartition::slice(std::size_t firstPart, std::size_t numberOfParts) const {
+        if (numberOfParts < 1 || firstPart >= parts_.size() || numberOfParts > parts_.size() - firstPart) {
+            throw std::out_of_range("Parts " + std::to_string(firstPart) + " to " + std::to_string(firstPart + numberOfParts) + " are not in a partition of " + std::to_string(parts_.size()) + " parts.");
+        }
+        HistoryPartition partition = *this;
+        const std::size_t endPart = firstPart + numberOfParts;
+        partition.parts_.assign(parts_.begin() + static_cast<std::ptrdiff_t>(firstPart), parts_.begin() + static_cast<std::ptrdiff_t>(endPart));
+        if (endPart < parts_.size()) {
+            partition.endHistory_ = parts_[endPart].firstHistory;
+            partition.endRecord_ = parts_[endPart].firstRecord;
+        }
+        return partition;
+    }
+
+    const HistoryPartition::Part & HistoryPartition::getPart(std::size_t partIndex) const {
+        if (partIndex >= parts_.size()) {
+            throw std::out_of_range("Part index out of range in getPart()");
+        }
+        return parts_[partIndex];
+    }
+
+}  // namespace ParticleZoo
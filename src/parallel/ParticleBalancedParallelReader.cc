@@ -4,24 +4,26 @@
 #include "particlezoo/utilities/formats.h"
 
 #include <thread>
+#include <algorithm>
 
 namespace ParticleZoo {
 
     ParticleBalancedParallelReader::ParticleBalancedParallelReader(const std::string& filename, const UserOptions& options, size_t numThreads)
-    : filename_(filename), options_(options), numThreads_(numThreads)
+    : filename_(filename), options_(options), numThreads_(numThreads), placement_(options, numThreads)
     {
         if (numThreads < 1) {
             throw std::invalid_argument("Number of threads must be at least 1 in ParticleBalancedParallelReader");
         }
 
-        // Create PhaseSpaceFileReader instances for each thread
+        // Create PhaseSpaceFileReader instances for each thread, cloning the first so that the header is only read once
         readers_.reserve(numThreads);
-        for (size_t i = 0; i < numThreads; ++i) {
-            auto reader = FormatRegistry::CreateReader(filename, options);
-            if (!reader) {
-                throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + filename);
-            }
-            readers_.emplace_back(std::move(reader));
+        auto firstReader = FormatRegistry::CreateReader(filename, options);
+        if (!firstReader) {
+            throw std::runtime_error("Failed to create PhaseSpaceFileReader for file: " + filename);
+        }
+        readers_.emplace_back(std::move(firstReader));
+        for (size_t i = 1; i < numThreads; ++i) {
+            readers_.emplace_back(readers_[0]->clone());
         }
 
         // Get the number of original histories
@@ -76,6 +78,57 @@ namespace ParticleZoo {
             }
             startingParticleIndex_.push_back(targetParticleIndex);
         }
+
+        // Keep where each thread starts, so that a thread can open a reader of its own there
+        startingRecords_.reserve(numThreads);
+        for (const auto & reader : readers_) {
+            startingRecords_.push_back(reader->getNextRecordIndex());
+        }
+        if (placement_.defersReaders()) {
+            // The last reader is kept to clone the others from, since it has seen the most of an ASCII file's line index
+            for (size_t i = numThreads; i-- > 0;) {
+                releaseReader(i);
+            }
+        }
+    }
+
+    PhaseSpaceFileReader & ParticleBalancedParallelReader::getReader(size_t threadIndex) {
+        if (!readers_[threadIndex]) {
+            readers_[threadIndex] = placement_.openReader(threadIndex, *prototype_, startingRecords_[threadIndex]);
+        }
+        return *readers_[threadIndex];
+    }
+
+    void ParticleBalancedParallelReader::releaseReader(size_t threadIndex) {
+        // A reader already at the end of the file is kept, there is nothing left for it to buffer
+        if (!readers_[threadIndex] || !readers_[threadIndex]->hasMoreParticles()) return;
+        if (!prototype_) {
+            prototype_ = std::move(readers_[threadIndex]);
+        } else {
+            readers_[threadIndex]->close();
+        }
+        readers_[threadIndex].reset();
+    }
+
+    void ParticleBalancedParallelReader::setThreadPlacement(size_t threadIndex, const ThreadPlacement & placement) {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in setThreadPlacement()");
+        }
+        if (getTotalParticlesRead() > 0) {
+            throw std::runtime_error("Thread placements must be set before any thread starts reading in ParticleBalancedParallelReader");
+        }
+        placement_.setPlacement(threadIndex, placement);
+        releaseReader(threadIndex);
+    }
+
+    std::pair<std::uint64_t, std::uint64_t> ParticleBalancedParallelReader::getByteRange(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getByteRange()");
+        }
+        const PhaseSpaceFileReader & reader = prototype_ ? *prototype_ : *readers_[0];
+        const std::uint64_t firstByte = reader.getRecordByteOffset(startingRecords_[threadIndex]);
+        const std::uint64_t endByte = threadIndex + 1 < readers_.size() ? reader.getRecordByteOffset(startingRecords_[threadIndex + 1]) : reader.getFileSize();
+        return { firstByte, endByte };
     }
 
     bool ParticleBalancedParallelReader::hasMoreParticles(size_t threadIndex) {
@@ -85,13 +138,13 @@ namespace ParticleZoo {
         }
 
         // Check if the reader has more particles
-        bool hasMore = readers_[threadIndex]->hasMoreParticles();
+        bool hasMore = getReader(threadIndex).hasMoreParticles();
         if (hasMore) {
             std::uint64_t targetParticleIndex = (threadIndex < readers_.size() - 1)
                                             ? startingParticleIndex_[threadIndex + 1]
                                             : numberOfParticlesInPhsp_;
             // Check if we have completed all particles for this thread
-            if (threadStats_[threadIndex]->particlesRead >= (targetParticleIndex - startingParticleIndex_[threadIndex])) {
+            if (threadStats_[threadIndex]->particlesRead.load() >= (targetParticleIndex - startingParticleIndex_[threadIndex])) {
                 hasMore = false;
             }
         }
@@ -109,21 +162,53 @@ namespace ParticleZoo {
         }
 
         // Get the next particle from the appropriate reader
-        Particle particle = readers_[threadIndex]->getNextParticle();
-
-        {
-            std::lock_guard<std::mutex> lock(threadStats_[threadIndex]->mutex);
-            threadStats_[threadIndex]->particlesRead++;
+        Particle particle = getReader(threadIndex).getNextParticle();
 
-            if (particle.isNewHistory()) {
-                threadStats_[threadIndex]->representedHistoriesRead++;
-                threadStats_[threadIndex]->incrementalHistorySum += particle.getIncrementalHistories();
+        // Only the counter used by the history counting mode is kept up to date
+        ThreadStatistics & stats = *threadStats_[threadIndex];
+        if (particle.isNewHistory()) {
+            if (historyCountMode_ == HistoryCountMode::RATIO) {
+                stats.representedHistoriesRead.add();
+            } else {
+                stats.incrementalHistorySum.add(particle.getIncrementalHistories());
             }
         }
+        stats.particlesRead.add();
 
         return particle;
     }
 
+    std::size_t ParticleBalancedParallelReader::readParticles(size_t threadIndex, std::span<Particle> particles) {
+        // Validate thread index
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in readParticles()");
+        }
+
+        // Read no further than the end of the thread's partition
+        ThreadStatistics & stats = *threadStats_[threadIndex];
+        const std::uint64_t targetParticleIndex = (threadIndex < readers_.size() - 1)
+                                                ? startingParticleIndex_[threadIndex + 1]
+                                                : numberOfParticlesInPhsp_;
+        const std::uint64_t particlesInPartition = targetParticleIndex - startingParticleIndex_[threadIndex];
+        const std::uint64_t particlesLeft = particlesInPartition - std::min(particlesInPartition, stats.particlesRead.load());
+        const std::size_t particlesToRead = static_cast<std::size_t>(std::min<std::uint64_t>(particles.size(), particlesLeft));
+        if (particlesToRead == 0) return 0;
+        const std::size_t particlesRead = getReader(threadIndex).readParticles(particles.first(particlesToRead));
+
+        // Only the counter used by the history counting mode is kept up to date
+        for (std::size_t i = 0; i < particlesRead; i++) {
+            if (!particles[i].isNewHistory()) continue;
+            if (historyCountMode_ == HistoryCountMode::RATIO) {
+                stats.representedHistoriesRead.add();
+            } else {
+                stats.incrementalHistorySum.add(particles[i].getIncrementalHistories());
+            }
+        }
+        stats.particlesRead.add(particlesRead);
+
+        return particlesRead;
+    }
+
     Particle ParticleBalancedParallelReader::peekNextParticle(size_t threadIndex) {
         // Validate thread index
         if (threadIndex >= readers_.size()) {
@@ -134,19 +219,23 @@ namespace ParticleZoo {
         }
 
         // Peek at the next particle from the appropriate reader
-        return readers_[threadIndex]->peekNextParticle();
+        return getReader(threadIndex).peekNextParticle();
     }
 
     std::uint64_t ParticleBalancedParallelReader::getNumberOfRepresentedHistories() {
         if (numberOfRepresentedHistories_ == 0) {
             // Lazily compute the number of represented histories
-            if (readers_[0]->hasNativeRepresentedHistoryCount()) {
+            const PhaseSpaceFileReader & fileReader = prototype_ ? *prototype_ : *readers_[0];
+            if (fileReader.hasNativeRepresentedHistoryCount()) {
                 // Get the number of represented histories directly
-                numberOfRepresentedHistories_ = readers_[0]->getNumberOfRepresentedHistories();
+                numberOfRepresentedHistories_ = fileReader.getNumberOfRepresentedHistories();
+            } else if (const std::optional<HistoryIndex> historyIndex = HistoryIndex::Load(fileReader.getFileName())) {
+                // Take the count from the history index sidecar
+                numberOfRepresentedHistories_ = historyIndex->getNumberOfRepresentedHistories();
             } else {
                 // Manually count the number of represented histories if not supported
                 numberOfRepresentedHistories_ = 0;
-                auto reader = FormatRegistry::CreateReader(filename_, options_);
+                auto reader = fileReader.clone();
                 while (reader->hasMoreParticles()) {
                     const Particle particle = reader->getNextParticle();
                     if (particle.isNewHistory()) {
@@ -164,7 +253,7 @@ namespace ParticleZoo {
         if (threadIndex >= readers_.size()) {
             throw std::out_of_range("Thread index out of range in getHistoriesRead()");
         }
-        return threadStats_[threadIndex]->particlesRead;
+        return threadStats_[threadIndex]->particlesRead.load();
     }
 
     std::uint64_t ParticleBalancedParallelReader::getHistoriesRead(size_t threadIndex) const {
@@ -175,21 +264,21 @@ namespace ParticleZoo {
         switch (historyCountMode_) {
             case HistoryCountMode::RATIO:
             {
-                const std::uint64_t representedHistories = threadStats_[threadIndex]->representedHistoriesRead;
+                const std::uint64_t representedHistories = threadStats_[threadIndex]->representedHistoriesRead.load();
                 return (representedHistories * numberOfOriginalHistories_)
                        / numberOfRepresentedHistories_;
             }
             case HistoryCountMode::INCREMENTAL:
-                return threadStats_[threadIndex]->incrementalHistorySum;
+                return threadStats_[threadIndex]->incrementalHistorySum.load();
         }
         
-        return threadStats_[threadIndex]->representedHistoriesRead; // unreachable fallback
+        return threadStats_[threadIndex]->representedHistoriesRead.load(); // unreachable fallback
     }
 
     std::uint64_t ParticleBalancedParallelReader::getTotalParticlesRead() const {
         std::uint64_t total = 0;
         for (size_t t = 0; t < numThreads_; t++) {
-            total += threadStats_[t]->particlesRead;
+            total += threadStats_[t]->particlesRead.load();
         }
         return total;
     }
@@ -199,7 +288,7 @@ namespace ParticleZoo {
             case HistoryCountMode::RATIO: {
                 std::uint64_t totalRep = 0;
                 for (size_t t = 0; t < numThreads_; t++) {
-                    totalRep += threadStats_[t]->representedHistoriesRead;
+                    totalRep += threadStats_[t]->representedHistoriesRead.load();
                 }
                 return (totalRep * numberOfOriginalHistories_) / numberOfRepresentedHistories_;
             }
@@ -207,9 +296,8 @@ namespace ParticleZoo {
                 std::uint64_t total = 0;
                 std::uint64_t totalParticles = 0;
                 for (size_t t = 0; t < numThreads_; t++) {
-                    std::lock_guard<std::mutex> lock(threadStats_[t]->mutex);
-                    total += threadStats_[t]->incrementalHistorySum;
-                    totalParticles += threadStats_[t]->particlesRead;
+                    total += threadStats_[t]->incrementalHistorySum.load();
+                    totalParticles += threadStats_[t]->particlesRead.load();
                 }
                 if (totalParticles >= numberOfParticlesInPhsp_)
                     return numberOfOriginalHistories_;
@@ -219,6 +307,21 @@ namespace ParticleZoo {
         return 0;
     }
 
+    IOProfile ParticleBalancedParallelReader::getIOProfile(size_t threadIndex) const {
+        if (threadIndex >= readers_.size()) {
+            throw std::out_of_range("Thread index out of range in getIOProfile()");
+        }
+        return readers_[threadIndex] ? readers_[threadIndex]->getIOProfile() : IOProfile{};
+    }
+
+    IOProfile ParticleBalancedParallelReader::getTotalIOProfile() const {
+        IOProfile total;
+        for (const auto & reader : readers_) {
+            if (reader) total += reader->getIOProfile();
+        }
+        return total;
+    }
+
     bool ParticleBalancedParallelReader::hasNativeRepresentedHistoryCount() const {
         return hasNativeRepresentedHistoryCount_;
     }
@@ -229,8 +332,9 @@ namespace ParticleZoo {
 
     void ParticleBalancedParallelReader::close() {
         for (auto& reader : readers_) {
-            reader->close();
+            if (reader) reader->close();
         }
+        if (prototype_) prototype_->close();
     }
 
     ParticleBalancedParallelReader::~ParticleBalancedParallelReader() {
@@ -0,0 +1,136 @@
+
+#include "particlezoo/parallel/ShardedParallelWriter.h"
+
+#include "particlezoo/utilities/formats.h"
+
+#include <filesystem>
+
+namespace ParticleZoo {
+
+    ShardedParallelWriter::ShardedParallelWriter(const std::string& fileName, size_t numberOfShards, const UserOptions& options, const FixedValues& fixedValues, const std::string& formatName)
+    : fileName_(fileName), options_(options), fixedValues_(fixedValues), formatName_(formatName), concatenated_(false)
+    {
+        if (numberOfShards < 1) {
+            throw std::invalid_argument("Number of shards must be at least 1 in ShardedParallelWriter");
+        }
+
+        // Create a PhaseSpaceFileWriter instance for each shard
+        shards_.reserve(numberOfShards);
+        for (size_t i = 0; i < numberOfShards; ++i) {
+            const std::string shardFileName = ShardFileName(fileName_, i);
+            auto writer = formatName_.empty()
+                        ? FormatRegistry::CreateWriter(shardFileName, options_, fixedValues_)
+                        : FormatRegistry::CreateWriter(formatName_, shardFileName, options_, fixedValues_);
+            if (!writer) {
+                throw std::runtime_error("Failed to create PhaseSpaceFileWriter for file: " + shardFileName);
+            }
+            shards_.emplace_back(std::move(writer));
+        }
+    }
+
+    std::string ShardedParallelWriter::ShardFileName(const std::string& fileName, size_t shardIndex) {
+        const std::filesystem::path path(fileName);
+        std::filesystem::path shardName = path.stem();
+        shardName += "_shard" + std::to_string(shardIndex);
+        shardName += path.extension();
+        return (path.parent_path() / shardName).string();
+    }
+
+    void ShardedParallelWriter::writeParticle(size_t threadIndex, const Particle& particle) {
+        if (threadIndex >= shards_.size()) {
+            throw std::out_of_range("Thread index out of range in writeParticle()");
+        }
+        shards_[threadIndex]->writeParticle(particle);
+    }
+
+    void ShardedParallelWriter::writeParticle(size_t threadIndex, Particle&& particle) {
+        if (threadIndex >= shards_.size()) {
+            throw std::out_of_range("Thread index out of range in writeParticle()");
+        }
+        shards_[threadIndex]->writeParticle(std::move(particle));
+    }
+
+    void ShardedParallelWriter::addAdditionalHistories(size_t threadIndex, std::uint64_t additionalHistories) {
+        if (threadIndex >= shards_.size()) {
+            throw std::out_of_range("Thread index out of range in addAdditionalHistories()");
+        }
+        shards_[threadIndex]->addAdditionalHistories(additionalHistories);
+    }
+
+    PhaseSpaceFileWriter & ShardedParallelWriter::getShard(size_t shardIndex) {
+        if (shardIndex >= shards_.size()) {
+            throw std::out_of_range("Shard index out of range in getShard()");
+        }
+        return *shards_[shardIndex];
+    }
+
+    std::string ShardedParallelWriter::getShardFileName(size_t shardIndex) const {
+        if (shardIndex >= shards_.size()) {
+            throw std::out_of_range("Shard index out of range in getShardFileName()");
+        }
+        return shards_[shardIndex]->getFileName();
+    }
+
+    std::uint64_t ShardedParallelWriter::getHistoriesWritten() const {
+        std::uint64_t total = 0;
+        for (const auto& shard : shards_)
+            total += shard->getHistoriesWritten();
+        return total;
+    }
+
+    std::uint64_t ShardedParallelWriter::getParticlesWritten() const {
+        std::uint64_t total = 0;
+        for (const auto& shard : shards_)
+            total += shard->getParticlesWritten();
+        return total;
+    }
+
+    IOProfile ShardedParallelWriter::getIOProfile() const {
+        IOProfile total;
+        for (const auto& shard : shards_)
+            total += shard->getIOProfile();
+        return total;
+    }
+
+    void ShardedParallelWriter::close() {
+        for (auto& shard : shards_) {
+            shard->close();
+        }
+    }
+
+    void ShardedParallelWriter::concatenate(bool removeShards) {
+        if (concatenated_) {
+            throw std::runtime_error("The shards of " + fileName_ + " have already been concatenated.");
+        }
+
+        // Every shard has to be complete, headers included, before its records can be appended
+        close();
+
+        auto writer = formatName_.empty()
+                    ? FormatRegistry::CreateWriter(fileName_, options_, fixedValues_)
+                    : FormatRegistry::CreateWriter(formatName_, fileName_, options_, fixedValues_);
+        if (!writer) {
+            throw std::runtime_error("Failed to create PhaseSpaceFileWriter for file: " + fileName_);
+        }
+
+        for (auto& shard : shards_) {
+            writer->appendRecordsFrom(*shard);
+        }
+        writer->close();
+        concatenated_ = true;
+
+        // Only remove the shards once the output file is complete, so nothing is lost if appending fails
+        if (removeShards) {
+            for (const auto& shard : shards_) {
+                for (const std::string& shardFile : shard->getOutputFileNames()) {
+                    std::filesystem::remove(shardFile);
+                }
+            }
+        }
+    }
+
+    ShardedParallelWriter::~ShardedParallelWriter() {
+        close();
+    }
+
+}  // namespace ParticleZoo
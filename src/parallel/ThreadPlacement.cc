@@ -0,0 +1,112 @@
+
+#include "particlezoo/parallel/ThreadPlacement.h"
+
+#include "particlezoo/utilities/threadAffinity.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
+namespace ParticleZoo {
+
+    namespace {
+
+        ThreadPlacementPolicy GetPolicy(const UserOptions & options) {
+            if (!options.contains(ThreadPlacementCommand) || options.at(ThreadPlacementCommand).empty()) {
+                return ThreadPlacementPolicy::NONE;
+            }
+            std::string policy = std::get<std::string>(options.at(ThreadPlacementCommand).front());
+            std::transform(policy.begin(), policy.end(), policy.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (policy == "local") return ThreadPlacementPolicy::LOCAL;
+            if (policy == "spread") return ThreadPlacementPolicy::SPREAD;
+            if (policy == "compact") return ThreadPlacementPolicy::COMPACT;
+            if (policy == "cpu") return ThreadPlacementPolicy::CPU;
+            throw std::invalid_argument("Unknown thread placement '" + policy + "', must be one of local, spread, compact or cpu.");
+        }
+
+    }
+
+    ThreadReaderPlacement::ThreadReaderPlacement(const UserOptions & options, std::size_t numberOfThreads)
+    : policy_(GetPolicy(options)), placements_(numberOfThreads), hasPlacement_(numberOfThreads, false)
+    {}
+
+    ThreadPlacement ThreadReaderPlacement::getPlacement(std::size_t threadIndex) const {
+        if (threadIndex >= placements_.size()) {
+            throw std::out_of_range("Thread index out of range in getPlacement()");
+        }
+        if (hasPlacement_[threadIndex]) return placements_[threadIndex];
+
+        ThreadPlacement placement;
+        switch (policy_) {
+            case ThreadPlacementPolicy::NONE:
+            case ThreadPlacementPolicy::LOCAL:
+                break;
+            case ThreadPlacementPolicy::SPREAD:
+            {
+                const std::vector<unsigned int> nodes = GetNUMANodes();
+                placement.numaNode = static_cast<int>(nodes[threadIndex % nodes.size()]);
+                placement.pinThread = true;
+                break;
+            }
+            case ThreadPlacementPolicy::COMPACT:
+            {
+                // Consecutive threads read consecutive parts of the file, so they share a node
+                const std::vector<unsigned int> nodes = GetNUMANodes();
+                placement.numaNode = static_cast<int>(nodes[threadIndex * nodes.size() / placements_.size()]);
+                placement.pinThread = true;
+                break;
+            }
+            case ThreadPlacementPolicy::CPU:
+            {
+                const std::vector<unsigned int> cpus = GetAllowedCPUs();
+                placement.cpu = static_cast<int>(cpus[threadIndex % cpus.size()]);
+                placement.pinThread = true;
+                break;
+            }
+        }
+        return placement;
+    }
+
+    void ThreadReaderPlacement::setPlacement(std::size_t threadIndex, const ThreadPlacement & placement) {
+        if (threadIndex >= placements_.size()) {
+            throw std::out_of_range("Thread index out of range in setPlacement()");
+        }
+        if (placement.numaNode != ThreadPlacement::ANY) {
+            const std::vector<unsigned int> nodes = GetNUMANodes();
+            if (placement.numaNode < 0 || std::find(nodes.begin(), nodes.end(), static_cast<unsigned int>(placement.numaNode)) == nodes.end()) {
+                throw std::out_of_range("NUMA node " + std::to_string(placement.numaNode) + " does not exist or has no CPUs the process may run on.");
+            }
+        }
+        if (placement.cpu != ThreadPlacement::ANY) {
+            const std::vector<unsigned int> cpus = GetAllowedCPUs();
+            if (placement.cpu < 0 || !std::binary_search(cpus.begin(), cpus.end(), static_cast<unsigned int>(placement.cpu))) {
+                throw std::out_of_range("CPU " + std::to_string(placement.cpu) + " does not exist or the process may not run on it.");
+            }
+        }
+        placements_[threadIndex] = placement;
+        hasPlacement_[threadIndex] = true;
+    }
+
+    std::shared_ptr<PhaseSpaceFileReader> ThreadReaderPlacement::openReader(std::size_t threadIndex, const PhaseSpaceFileReader & prototype, std::uint64_t firstRecord) const {
+        const ThreadPlacement placement = getPlacement(threadIndex);
+        std::vector<unsigned int> cpus;
+        if (placement.cpu != ThreadPlacement::ANY) {
+            cpus = { static_cast<unsigned int>(placement.cpu) };
+        } else if (placement.numaNode != ThreadPlacement::ANY) {
+            cpus = GetNUMANodeCPUs(static_cast<unsigned int>(placement.numaNode));
+        }
+
+        // The buffers of the reader are allocated and zeroed by clone(), so they are placed on the node the thread is held to
+        ScopedThreadAffinity affinity(cpus);
+        if (placement.pinThread) affinity.keep();
+        std::shared_ptr<PhaseSpaceFileReader> reader;
+        {
+            std::lock_guard<std::mutex> lock(cloneMutex_);
+            reader = prototype.clone();
+        }
+        if (firstRecord > 0) reader->moveToParticle(firstRecord);
+        return reader;
+    }
+
+}  // namespace ParticleZoo
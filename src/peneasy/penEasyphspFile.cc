@@ -1,10 +1,10 @@
 #include "particlezoo/peneasy/penEasyphspFile.h"
 
-#include <format>
 #include <stdexcept>
+#include <charconv>
+#include <cstring>
 #include <cstddef>
 #include <cstdint>
-#include <sstream>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -12,6 +12,8 @@
 
 #include "particlezoo/Particle.h"
 #include "particlezoo/ByteBuffer.h"
+#include "particlezoo/utilities/asciiFields.h"
+#include "particlezoo/utilities/inputFileStream.h"
 #include "particlezoo/penelope/ILBArray.h"
 
 namespace ParticleZoo::penEasyphspFile
@@ -26,7 +28,7 @@ namespace ParticleZoo::penEasyphspFile
         buffer.writeString(std::string(FILE_HEADER));
     }
     
-    const std::string Writer::writeASCIIParticle(Particle & particle)
+    void Writer::writeASCIIParticle(ASCIILineWriter & line, Particle & particle)
     {
         int kpar;
         switch (particle.getType()) {
@@ -65,33 +67,45 @@ namespace ParticleZoo::penEasyphspFile
         }
 
         std::array<int, 5> ilb = Penelope::ExtractILBArrayFromParticle(particle);
-        
-        // Create a std::string with the maximum required capacity.
-        std::string formatted;
-        formatted.resize(MAX_ASCII_LINE_LENGTH);
-
-        // Write directly into the string's buffer.
-        auto result = std::format_to_n(
-            formatted.data(), formatted.size(),
-            "{} {:14.7e} {:14.7e} {:14.7e} {:14.7e} {:14.7e} {:14.7e} {:14.7e} {:14.7e} {} {} {} {} {} {}\n",
-            kpar, e, x, y, z, u, v, w, weight, static_cast<long long>(dn),
-            ilb[0], ilb[1], ilb[2], ilb[3], ilb[4]);
-
-        // Determine how many characters were actually written
-        std::size_t output_length = static_cast<std::size_t>(result.out - formatted.data());
-        if (output_length > MAX_ASCII_LINE_LENGTH) {
-            throw std::runtime_error("Particle data exceeded maximum length per particle.");
-        }
 
-        // Resize the string to the actual output length.
-        formatted.resize(output_length);
-        return formatted;
+        // KPAR E X Y Z U V W WGHT DeltaN ILB(1..5), with the floating point values as %14.7e
+        line.writeInteger(kpar);
+        for (float value : { e, x, y, z, u, v, w, weight }) {
+            line.write(' ');
+            line.writeScientific(value, 7, 14);
+        }
+        line.write(' ');
+        line.writeInteger(static_cast<long long>(dn));
+        for (int value : ilb) {
+            line.write(' ');
+            line.writeInteger(value);
+        }
+        line.write('\n');
     }
 
 
 
+    namespace {
+
+        // Adds the DeltaN (10th field) of a particle record to the total, lines where it cannot be parsed are skipped
+        void addDeltaN(std::string_view line, std::uint64_t & totalDeltaN) {
+            ASCIILineParser fields(line);
+            for (int i = 0; i < 9; i++) {
+                fields.nextField();
+            }
+            std::string_view field = fields.nextField();
+            if (!field.empty() && field.front() == '+') field.remove_prefix(1);
+            int deltaN;
+            const auto result = std::from_chars(field.data(), field.data() + field.size(), deltaN);
+            if (result.ec == std::errc()) {
+                totalDeltaN += deltaN;
+            }
+        }
+
+    }
+
     std::pair<std::size_t, std::uint64_t> countParticlesAndSumDeltaN(const std::string& filename) {
-        std::ifstream file(filename, std::ios::binary);
+        InputFileStream file(filename);
         if (!file.is_open()) {
             std::cerr << "Error: Could not open file " << filename << std::endl;
             return {0, 0};
@@ -100,44 +114,36 @@ namespace ParticleZoo::penEasyphspFile
         ByteBuffer buffer;
         std::size_t lineCount = 0;
         std::uint64_t totalDeltaN = 0;
-        std::string currentLine;
-        currentLine.reserve(256); // Reserve space for typical line length
+        std::string partialLine; // only used for a line split across two blocks
+
+        auto countLine = [&](std::string_view line) {
+            lineCount++;
+            // Skip header lines (first two lines)
+            if (lineCount > 2 && !line.empty()) {
+                addDeltaN(line, totalDeltaN);
+            }
+        };
 
         while (!file.eof()) {
             size_t bytesRead = buffer.setData(file);
-            const byte* data = buffer.data();
-            
-            for (size_t i = 0; i < bytesRead; ++i) {
-                char ch = static_cast<char>(data[i]);
-                
-                if (ch == '\n') {
-                    lineCount++;
-                    
-                    // Skip header lines (first two lines)
-                    if (lineCount > 2 && !currentLine.empty()) {
-                        // Parse DeltaN from the line (10th field)
-                        std::istringstream iss(currentLine);
-                        std::string field;
-                        int fieldCount = 0;
-                        
-                        // Skip first 9 fields, then read DeltaN
-                        while (fieldCount < 10 && iss >> field) {
-                            fieldCount++;
-                            if (fieldCount == 10) {
-                                try {
-                                    int deltaN = std::stoi(field);
-                                    totalDeltaN += deltaN;
-                                } catch (const std::exception&) {
-                                    // If parsing fails, skip this line
-                                }
-                                break;
-                            }
-                        }
-                    }
-                    currentLine.clear();
+            const char* data = reinterpret_cast<const char*>(buffer.data());
+            const char* end = data + bytesRead;
+
+            // Lines are viewed in place in the block, only the line spanning the end of the block is copied
+            while (data < end) {
+                const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+                if (!newline) {
+                    partialLine.append(data, end);
+                    break;
+                }
+                if (partialLine.empty()) {
+                    countLine(std::string_view(data, static_cast<std::size_t>(newline - data)));
                 } else {
-                    currentLine += ch;
+                    partialLine.append(data, newline);
+                    countLine(partialLine);
+                    partialLine.clear();
                 }
+                data = newline + 1;
             }
         }
 
@@ -146,27 +152,8 @@ namespace ParticleZoo::penEasyphspFile
         if (file.tellg() > 0) {
             if (lineCount == 0) {
                 lineCount = 1; // Single line file
-            } else if (!currentLine.empty()) {
-                lineCount++;
-                // Process the last line for DeltaN if it's a data line
-                if (lineCount > 2) {
-                    std::istringstream iss(currentLine);
-                    std::string field;
-                    int fieldCount = 0;
-                    
-                    while (fieldCount < 10 && iss >> field) {
-                        fieldCount++;
-                        if (fieldCount == 10) {
-                            try {
-                                int deltaN = std::stoi(field);
-                                totalDeltaN += deltaN;
-                            } catch (const std::exception&) {
-                                // If parsing fails, skip this line
-                            }
-                            break;
-                        }
-                    }
-                }
+            } else if (!partialLine.empty()) {
+                countLine(partialLine);
             }
         }
 
@@ -177,25 +164,31 @@ namespace ParticleZoo::penEasyphspFile
     Reader::Reader(const std::string & fileName, const UserOptions & options)
     : PhaseSpaceFileReader("penEasy", fileName, options, FormatType::ASCII)
     {
+        if (IsStandardStream(fileName)) {
+            throw std::runtime_error("penEasy files cannot be read from standard input, since their particles are counted by reading the whole file first.");
+        }
         auto [particleCount, totalDeltaN] = countParticlesAndSumDeltaN(fileName);
         numberOfParticles_ = particleCount;
         numberOfOriginalHistories_ = totalDeltaN;
     }
 
-    Particle Reader::readASCIIParticle(const std::string & line)
+    Particle Reader::readASCIIParticle(std::string_view line)
     {
         // Parse the line to extract particle data
-        int kpar;
-        float e, x, y, z, u, v, w, weight;
-        int dn;
+        ASCIILineParser fields(line);
+        int kpar = fields.next<int>();
+        float e = fields.next<float>();
+        float x = fields.next<float>();
+        float y = fields.next<float>();
+        float z = fields.next<float>();
+        float u = fields.next<float>();
+        float v = fields.next<float>();
+        float w = fields.next<float>();
+        float weight = fields.next<float>();
+        int dn = fields.next<int>();
         std::array<int,5> ilb;
-
-        // Use std::istringstream to parse the line
-        std::istringstream iss(line);
-        if (!(iss >> kpar >> e >> x >> y >> z >> u >> v >> w >> weight >> dn 
-                >> ilb[0] >> ilb[1] >> ilb[2] >> ilb[3] >> ilb[4]))
-        {
-            throw std::runtime_error("Failed to parse particle data from line: " + line);
+        for (int & value : ilb) {
+            value = fields.next<int>();
         }
 
         // Create a new Particle object and set its properties
@@ -0,0 +1,828 @@
+#include "particlezoo/pz/PZphspFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace ParticleZoo::PZphspFile
+{
+
+    CLICommand PZCompressionCommand{ WRITER, "", "PZ-compression", "Compression codec for ParticleZoo native phase space files (none, zstd or lz4, default: the best available)", { CLI_STRING } };
+    CLICommand PZCompressionLevelCommand{ WRITER, "", "PZ-compression-level", "Compression level for ParticleZoo native phase space files, 0 for the default of the codec", { CLI_INT }, { 0 } };
+    CLICommand PZBlockSizeCommand{ WRITER, "", "PZ-block-size", "Number of particles in each block of ParticleZoo native phase space files", { CLI_UINT }, { DEFAULT_PARTICLES_PER_BLOCK } };
+
+    namespace
+    {
+        // Columns a block section can hold
+        enum class Column : std::uint8_t {
+            TYPE = 1,
+            KINETIC_ENERGY = 2,
+            X = 3,
+            Y = 4,
+            Z = 5,
+            DIRECTION_X = 6,
+            DIRECTION_Y = 7,
+            DIRECTION_Z = 8,
+            WEIGHT = 9,
+            NEW_HISTORY = 10,
+            INCREMENTAL_HISTORIES = 11, // only for the particles starting a new history
+            INT_PROPERTY = 12,          // property columns start with a bit per particle telling if it has the property
+            FLOAT_PROPERTY = 13,
+            BOOL_PROPERTY = 14,
+            CUSTOM_INT_PROPERTY = 15,
+            CUSTOM_FLOAT_PROPERTY = 16,
+            CUSTOM_BOOL_PROPERTY = 17,
+            CUSTOM_STRING_PROPERTY = 18
+        };
+
+        // How the values of a section are encoded before compression
+        enum class Encoding : std::uint8_t {
+            CONSTANT = 0,   // a single 32-bit value shared by all
+            SHUFFLED = 1,   // 32-bit values with their bytes split into four planes
+            DICTIONARY = 2, // u8 number of distinct 32-bit values, the values, then a bit-packed index for each
+            BITS = 3,       // one bit each, least significant bit first
+            STRINGS = 4     // u32 length and characters of each
+        };
+
+        constexpr std::size_t BLOCK_HEADER_SIZE = 8;
+        constexpr std::size_t SECTION_HEADER_SIZE = 16;
+        constexpr std::size_t MINIMUM_SIZE_TO_COMPRESS = 64; // smaller sections are not worth compressing
+
+        template <typename T>
+        void appendLE(std::vector<byte> & out, T value) {
+            static_assert(std::is_integral_v<T>, "appendLE() requires an integral type");
+            using U = std::make_unsigned_t<T>;
+            const U bits = static_cast<U>(value);
+            for (std::size_t i = 0; i < sizeof(T); i++) {
+                out.push_back(static_cast<byte>(bits >> (8 * i)));
+            }
+        }
+
+        template <typename T>
+        void storeLE(byte * destination, T value) {
+            using U = std::make_unsigned_t<T>;
+            const U bits = static_cast<U>(value);
+            for (std::size_t i = 0; i < sizeof(T); i++) {
+                destination[i] = static_cast<byte>(bits >> (8 * i));
+            }
+        }
+
+        template <typename T>
+        T loadLE(const byte * source) {
+            using U = std::make_unsigned_t<T>;
+            U bits = 0;
+            for (std::size_t i = 0; i < sizeof(T); i++) {
+                bits |= static_cast<U>(static_cast<U>(source[i]) << (8 * i));
+            }
+            return static_cast<T>(bits);
+        }
+
+        // Bounds checked reading of the fields of a header, block or footer
+        class FieldReader
+        {
+            public:
+                FieldReader(std::span<const byte> data, const std::string & what) : data_(data), position_(0), what_(what) {}
+
+                template <typename T>
+                T next() {
+                    if constexpr (std::is_same_v<T, float>) {
+                        return std::bit_cast<float>(next<std::uint32_t>());
+                    } else if constexpr (std::is_same_v<T, double>) {
+                        return std::bit_cast<double>(next<std::uint64_t>());
+                    } else {
+                        return loadLE<T>(take(sizeof(T)).data());
+                    }
+                }
+
+                std::span<const byte> take(std::size_t size) {
+                    if (size > data_.size() - position_) {
+                        throw std::runtime_error("Truncated " + what_ + ".");
+                    }
+                    std::span<const byte> bytes = data_.subspan(position_, size);
+                    position_ += size;
+                    return bytes;
+                }
+
+
+            private:
+                std::span<const byte> data_;
+                std::size_t position_;
+                std::string what_;
+        };
+
+        void appendFloat(std::vector<byte> & out, float value) { appendLE(out, std::bit_cast<std::uint32_t>(value)); }
+        void appendDouble(std::vector<byte> & out, double value) { appendLE(out, std::bit_cast<std::uint64_t>(value)); }
+
+        // Encodes count 32-bit words as a constant or in shuffled byte planes
+        template <typename GetWord>
+        Encoding encodeWords(std::size_t count, GetWord && getWord, std::vector<byte> & out) {
+            const std::uint32_t first = count > 0 ? getWord(0) : 0;
+            std::size_t i = 1;
+            while (i < count && getWord(i) == first) i++;
+            if (i >= count) {
+                appendLE(out, first);
+                return Encoding::CONSTANT;
+            }
+            const std::size_t start = out.size();
+            out.resize(start + 4 * count);
+            byte * planes = out.data() + start;
+            for (std::size_t j = 0; j < count; j++) {
+                const std::uint32_t word = getWord(j);
+                planes[j]             = static_cast<byte>(word);
+                planes[count + j]     = static_cast<byte>(word >> 8);
+                planes[2 * count + j] = static_cast<byte>(word >> 16);
+                planes[3 * count + j] = static_cast<byte>(word >> 24);
+            }
+            return Encoding::SHUFFLED;
+        }
+
+        template <typename SetWord>
+        void decodeWords(Encoding encoding, std::span<const byte> data, std::size_t count, SetWord && setWord) {
+            if (encoding == Encoding::CONSTANT) {
+                if (data.size() != 4) throw std::runtime_error("Invalid constant column in block.");
+                const std::uint32_t word = loadLE<std::uint32_t>(data.data());
+                for (std::size_t j = 0; j < count; j++) setWord(j, word);
+            } else if (encoding == Encoding::SHUFFLED) {
+                if (data.size() != 4 * count) throw std::runtime_error("Invalid shuffled column in block.");
+                const byte * planes = data.data();
+                for (std::size_t j = 0; j < count; j++) {
+                    setWord(j, static_cast<std::uint32_t>(planes[j])
+                             | static_cast<std::uint32_t>(planes[count + j]) << 8
+                             | static_cast<std::uint32_t>(planes[2 * count + j]) << 16
+                             | static_cast<std::uint32_t>(planes[3 * count + j]) << 24);
+                }
+            } else {
+                throw std::runtime_error("Invalid encoding " + std::to_string(static_cast<int>(encoding)) + " for a column of 32-bit values.");
+            }
+        }
+
+        // Packs count values of bitsPerValue bits each, least significant bit first
+        template <typename GetValue>
+        void appendPackedBits(std::vector<byte> & out, std::size_t count, unsigned int bitsPerValue, GetValue && getValue) {
+            if (bitsPerValue == 0) return;
+            std::uint64_t accumulator = 0;
+            unsigned int bitsHeld = 0;
+            for (std::size_t j = 0; j < count; j++) {
+                accumulator |= static_cast<std::uint64_t>(getValue(j)) << bitsHeld;
+                bitsHeld += bitsPerValue;
+                while (bitsHeld >= 8) {
+                    out.push_back(static_cast<byte>(accumulator));
+                    accumulator >>= 8;
+                    bitsHeld -= 8;
+                }
+            }
+            if (bitsHeld > 0) out.push_back(static_cast<byte>(accumulator));
+        }
+
+        std::size_t packedSize(std::size_t count, unsigned int bitsPerValue) {
+            return (count * bitsPerValue + 7) / 8;
+        }
+
+        template <typename SetValue>
+        void unpackBits(std::span<const byte> data, std::size_t count, unsigned int bitsPerValue, SetValue && setValue) {
+            if (data.size() < packedSize(count, bitsPerValue)) throw std::runtime_error("Truncated bit-packed column in block.");
+            if (bitsPerValue == 0) {
+                for (std::size_t j = 0; j < count; j++) setValue(j, 0u);
+                return;
+            }
+            const std::uint32_t mask = (1u << bitsPerValue) - 1;
+            std::uint64_t accumulator = 0;
+            unsigned int bitsHeld = 0;
+            std::size_t next = 0;
+            for (std::size_t j = 0; j < count; j++) {
+                while (bitsHeld < bitsPerValue) {
+                    accumulator |= static_cast<std::uint64_t>(data[next++]) << bitsHeld;
+                    bitsHeld += 8;
+                }
+                setValue(j, static_cast<std::uint32_t>(accumulator) & mask);
+                accumulator >>= bitsPerValue;
+                bitsHeld -= bitsPerValue;
+            }
+        }
+
+        // Encodes the particle types as a dictionary of the distinct types and a packed index for each particle
+        Encoding encodeTypes(std::span<const ParticleType> types, std::vector<byte> & out) {
+            std::vector<std::uint32_t> dictionary;
+            std::vector<std::uint8_t> indices(types.size());
+            for (std::size_t j = 0; j < types.size(); j++) {
+                const std::uint32_t type = static_cast<std::uint32_t>(types[j]);
+                auto it = std::find(dictionary.begin(), dictionary.end(), type);
+                if (it == dictionary.end()) {
+                    if (dictionary.size() == 255) {
+                        // too many distinct types for a dictionary, unheard of in practice
+                        return encodeWords(types.size(), [&](std::size_t k) { return static_cast<std::uint32_t>(types[k]); }, out);
+                    }
+                    dictionary.push_back(type);
+                    it = dictionary.end() - 1;
+                }
+                indices[j] = static_cast<std::uint8_t>(it - dictionary.begin());
+            }
+            out.push_back(static_cast<byte>(dictionary.size()));
+            for (std::uint32_t type : dictionary) appendLE(out, type);
+            const unsigned int bitsPerIndex = dictionary.size() > 1 ? static_cast<unsigned int>(std::bit_width(dictionary.size() - 1)) : 0;
+            appendPackedBits(out, indices.size(), bitsPerIndex, [&](std::size_t j) { return indices[j]; });
+            return Encoding::DICTIONARY;
+        }
+
+        void decodeTypes(Encoding encoding, std::span<const byte> data, std::span<ParticleType> types) {
+            if (encoding != Encoding::DICTIONARY) {
+                decodeWords(encoding, data, types.size(), [&](std::size_t j, std::uint32_t word) { types[j] = static_cast<ParticleType>(static_cast<std::int32_t>(word)); });
+                return;
+            }
+            FieldReader reader(data, "particle type column");
+            const std::size_t dictionarySize = reader.next<std::uint8_t>();
+            std::vector<ParticleType> dictionary(dictionarySize);
+            for (ParticleType & type : dictionary) type = static_cast<ParticleType>(reader.next<std::int32_t>());
+            const unsigned int bitsPerIndex = dictionarySize > 1 ? static_cast<unsigned int>(std::bit_width(dictionarySize - 1)) : 0;
+            if (dictionarySize == 0 && !types.empty()) throw std::runtime_error("Empty particle type dictionary in block.");
+            std::span<const byte> packed = reader.take(packedSize(types.size(), bitsPerIndex));
+            unpackBits(packed, types.size(), bitsPerIndex, [&](std::size_t j, std::uint32_t index) {
+                if (index >= dictionarySize) throw std::runtime_error("Invalid particle type index in block.");
+                types[j] = dictionary[index];
+            });
+        }
+
+        std::uint32_t wordOf(float value) { return std::bit_cast<std::uint32_t>(value); }
+        std::uint32_t wordOf(std::int32_t value) { return static_cast<std::uint32_t>(value); }
+        void setFromWord(float & value, std::uint32_t word) { value = std::bit_cast<float>(word); }
+        void setFromWord(std::int32_t & value, std::uint32_t word) { value = static_cast<std::int32_t>(word); }
+
+        // Encodes the values of a property column after a bit per particle telling if it was set
+        template <typename PropertyColumn>
+        Encoding encodePropertyColumn(const PropertyColumn & column, std::vector<byte> & out) {
+            const std::size_t count = column.isSet.size();
+            appendPackedBits(out, count, 1, [&](std::size_t j) { return column.isSet[j] ? 1u : 0u; });
+            using T = typename decltype(column.values)::value_type;
+            if constexpr (std::is_same_v<T, std::uint8_t>) {
+                appendPackedBits(out, count, 1, [&](std::size_t j) { return column.values[j] ? 1u : 0u; });
+                return Encoding::BITS;
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                for (std::size_t j = 0; j < count; j++) {
+                    if (!column.isSet[j]) continue;
+                    appendLE(out, static_cast<std::uint32_t>(column.values[j].size()));
+                    out.insert(out.end(), column.values[j].begin(), column.values[j].end());
+                }
+                return Encoding::STRINGS;
+            } else {
+                return encodeWords(count, [&](std::size_t j) { return wordOf(column.values[j]); }, out);
+            }
+        }
+
+        template <typename PropertyColumn>
+        void decodePropertyColumn(Encoding encoding, std::span<const byte> data, PropertyColumn & column) {
+            const std::size_t count = column.isSet.size();
+            const std::size_t flagsSize = packedSize(count, 1);
+            if (data.size() < flagsSize) throw std::runtime_error("Truncated property column in block.");
+            unpackBits(data.first(flagsSize), count, 1, [&](std::size_t j, std::uint32_t bit) { column.isSet[j] = static_cast<std::uint8_t>(bit); });
+            std::span<const byte> values = data.subspan(flagsSize);
+
+            using T = typename decltype(column.values)::value_type;
+            if constexpr (std::is_same_v<T, std::uint8_t>) {
+                if (encoding != Encoding::BITS) throw std::runtime_error("Invalid encoding for a boolean property column.");
+                unpackBits(values, count, 1, [&](std::size_t j, std::uint32_t bit) { column.values[j] = static_cast<std::uint8_t>(bit); });
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                if (encoding != Encoding::STRINGS) throw std::runtime_error("Invalid encoding for a string property column.");
+                FieldReader reader(values, "string property column");
+                for (std::size_t j = 0; j < count; j++) {
+                    if (!column.isSet[j]) continue;
+                    std::span<const byte> characters = reader.take(reader.next<std::uint32_t>());
+                    column.values[j].assign(reinterpret_cast<const char*>(characters.data()), characters.size());
+                }
+            } else {
+                decodeWords(encoding, values, count, [&](std::size_t j, std::uint32_t word) { setFromWord(column.values[j], word); });
+            }
+        }
+
+        void checkMagic(std::span<const byte> magic, const std::string & fileName) {
+            if (!std::equal(magic.begin(), magic.end(), MAGIC.begin(), MAGIC.end(), [](byte b, char c) { return b == static_cast<byte>(c); })) {
+                throw std::runtime_error("Not a ParticleZoo native phase space file, or the file is incomplete: " + fileName);
+            }
+        }
+    }
+
+
+    // Implementations for the FileStatistics struct
+
+    void FileStatistics::addParticle(const Particle & particle) {
+        const float weight = particle.getWeight();
+        const float energy = particle.getKineticEnergy();
+        minX = std::min(minX, particle.getX());
+        maxX = std::max(maxX, particle.getX());
+        minY = std::min(minY, particle.getY());
+        maxY = std::max(maxY, particle.getY());
+        minZ = std::min(minZ, particle.getZ());
+        maxZ = std::max(maxZ, particle.getZ());
+        minWeight = std::min(minWeight, weight);
+        maxWeight = std::max(maxWeight, weight);
+
+        ParticleStatistics & stats = byType[particle.getType()];
+        stats.count++;
+        stats.weightSum += weight;
+        stats.weightedEnergySum += static_cast<double>(weight) * energy;
+        stats.minKineticEnergy = std::min(stats.minKineticEnergy, energy);
+        stats.maxKineticEnergy = std::max(stats.maxKineticEnergy, energy);
+    }
+
+
+    // Implementations for the Reader class
+
+    Reader::Reader(const std::string & fileName, const UserOptions & options)
+    :   PhaseSpaceFileReader("PZ", fileName, options, FormatType::NONE),
+        file_(fileName, std::ios::binary),
+        formatVersion_(0),
+        particlesPerBlock_(0),
+        codec_(CompressionCodec::NONE),
+        numberOfParticles_(0),
+        numberOfOriginalHistories_(0),
+        numberOfRepresentedHistories_(0),
+        currentBlock_(0),
+        positionInBlock_(0)
+    {
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open file: " + fileName);
+        }
+        readFooter();
+        currentBlock_ = blocks_.size();
+    }
+
+    std::vector<CLICommand> Reader::getFormatSpecificCLICommands() {
+        return {};
+    }
+
+    void Reader::readFooter() {
+        const std::string fileName = getFileName();
+        file_.seekg(0, std::ios::end);
+        const std::uint64_t fileSize = static_cast<std::uint64_t>(file_.tellg());
+        if (fileSize < FILE_HEADER_SIZE + FILE_TRAILER_SIZE) {
+            throw std::runtime_error("File is too small to be a ParticleZoo native phase space file: " + fileName);
+        }
+
+        auto readAt = [&](std::uint64_t offset, std::size_t size) {
+            std::vector<byte> data(size);
+            ProfileTimer timer = timeIO();
+            file_.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+            file_.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size));
+            if (!file_) {
+                throw std::runtime_error("Failed to read " + std::to_string(size) + " bytes at offset " + std::to_string(offset) + " of file: " + fileName);
+            }
+            countBytesRead(size);
+            return data;
+        };
+
+        const std::vector<byte> headerData = readAt(0, FILE_HEADER_SIZE);
+        FieldReader header(headerData, "file header");
+        checkMagic(header.take(MAGIC.size()), fileName);
+        formatVersion_ = header.next<std::uint32_t>();
+        particlesPerBlock_ = header.next<std::uint32_t>();
+        if (formatVersion_ == 0 || formatVersion_ > FORMAT_VERSION) {
+            throw std::runtime_error("Unsupported ParticleZoo native phase space file version " + std::to_string(formatVersion_) + " in file: " + fileName);
+        }
+
+        const std::vector<byte> trailerData = readAt(fileSize - FILE_TRAILER_SIZE, FILE_TRAILER_SIZE);
+        FieldReader trailer(trailerData, "file trailer");
+        const std::uint64_t footerOffset = trailer.next<std::uint64_t>();
+        const std::uint64_t footerSize = trailer.next<std::uint64_t>();
+        checkMagic(trailer.take(MAGIC.size()), fileName);
+        if (footerOffset < FILE_HEADER_SIZE || footerSize > fileSize || footerOffset != fileSize - FILE_TRAILER_SIZE - footerSize) {
+            throw std::runtime_error("Invalid footer position in file: " + fileName);
+        }
+
+        const std::vector<byte> footerData = readAt(footerOffset, static_cast<std::size_t>(footerSize));
+        FieldReader footer(footerData, "file footer");
+        numberOfParticles_ = footer.next<std::uint64_t>();
+        numberOfOriginalHistories_ = footer.next<std::uint64_t>();
+        numberOfRepresentedHistories_ = footer.next<std::uint64_t>();
+        codec_ = static_cast<CompressionCodec>(footer.next<std::uint8_t>());
+        footer.take(3); // reserved
+        statistics_.minX = footer.next<float>();
+        statistics_.maxX = footer.next<float>();
+        statistics_.minY = footer.next<float>();
+        statistics_.maxY = footer.next<float>();
+        statistics_.minZ = footer.next<float>();
+        statistics_.maxZ = footer.next<float>();
+        statistics_.minWeight = footer.next<float>();
+        statistics_.maxWeight = footer.next<float>();
+        const std::uint32_t numberOfTypes = footer.next<std::uint32_t>();
+        for (std::uint32_t t = 0; t < numberOfTypes; t++) {
+            const ParticleType type = static_cast<ParticleType>(footer.next<std::int32_t>());
+            ParticleStatistics & stats = statistics_.byType[type];
+            stats.count = footer.next<std::uint64_t>();
+            stats.weightSum = footer.next<double>();
+            stats.weightedEnergySum = footer.next<double>();
+            stats.minKineticEnergy = footer.next<float>();
+            stats.maxKineticEnergy = footer.next<float>();
+        }
+
+        const std::uint64_t numberOfBlocks = footer.next<std::uint64_t>();
+        if (numberOfBlocks > footerSize) {
+            throw std::runtime_error("Invalid block index in file: " + fileName);
+        }
+        blocks_.resize(static_cast<std::size_t>(numberOfBlocks));
+        blockFirstParticles_.reserve(blocks_.size() + 1);
+        blockFirstParticles_.push_back(0);
+        for (BlockIndexEntry & block : blocks_) {
+            block.offset = footer.next<std::uint64_t>();
+            block.size = footer.next<std::uint32_t>();
+            block.numberOfParticles = footer.next<std::uint32_t>();
+            block.representedHistories = footer.next<std::uint64_t>();
+            block.originalHistories = footer.next<std::uint64_t>();
+            if (block.offset < FILE_HEADER_SIZE || block.size < BLOCK_HEADER_SIZE || block.offset + block.size > footerOffset) {
+                throw std::runtime_error("Invalid block index in file: " + fileName);
+            }
+            blockFirstParticles_.push_back(blockFirstParticles_.back() + block.numberOfParticles);
+        }
+        if (blockFirstParticles_.back() != numberOfParticles_) {
+            throw std::runtime_error("The block index does not account for the " + std::to_string(numberOfParticles_) + " particles in file: " + fileName);
+        }
+
+        if (!IsCompressionCodecAvailable(codec_)) {
+            throw std::runtime_error("The file was compressed with " + CompressionCodecName(codec_) + ", which is not available in this build of ParticleZoo: " + fileName);
+        }
+    }
+
+    void Reader::loadBlock(std::size_t blockNumber) {
+        const BlockIndexEntry & entry = blocks_[blockNumber];
+        blockData_.resize(entry.size);
+        {
+            ProfileTimer timer = timeIO();
+            file_.clear();
+            file_.seekg(static_cast<std::streamoff>(entry.offset), std::ios::beg);
+            file_.read(reinterpret_cast<char*>(blockData_.data()), static_cast<std::streamsize>(entry.size));
+            if (!file_) {
+                throw std::runtime_error("Failed to read block " + std::to_string(blockNumber) + " of file: " + getFileName());
+            }
+        }
+        countBlockRead(entry.size);
+
+        const std::string blockName = "block " + std::to_string(blockNumber);
+        FieldReader reader(blockData_, blockName);
+        const std::size_t count = reader.next<std::uint32_t>();
+        const std::uint32_t numberOfSections = reader.next<std::uint32_t>();
+        if (count != entry.numberOfParticles) {
+            throw std::runtime_error("Block " + std::to_string(blockNumber) + " holds a different number of particles than the block index in file: " + getFileName());
+        }
+
+        // mark the block as not loaded until it has been decoded completely
+        currentBlock_ = blocks_.size();
+        block_.clear();
+        block_.resize(count);
+
+        std::span<std::uint8_t> newHistoryFlags = block_.getNewHistoryFlags();
+        std::span<std::uint32_t> incrementalHistories = block_.getIncrementalHistories();
+        std::uint32_t columnsFound = 0;
+        bool newHistoryFlagsDecoded = false;
+
+        for (std::uint32_t s = 0; s < numberOfSections; s++) {
+            const Column column = static_cast<Column>(reader.next<std::uint8_t>());
+            const Encoding encoding = static_cast<Encoding>(reader.next<std::uint8_t>());
+            const CompressionCodec codec = static_cast<CompressionCodec>(reader.next<std::uint8_t>());
+            reader.next<std::uint8_t>(); // reserved
+            const std::int32_t property = reader.next<std::int32_t>();
+            const std::uint32_t encodedSize = reader.next<std::uint32_t>();
+            const std::uint32_t storedSize = reader.next<std::uint32_t>();
+            std::span<const byte> stored = reader.take(storedSize);
+
+            std::span<const byte> data = stored;
+            if (codec != CompressionCodec::NONE) {
+                sectionData_.resize(encodedSize);
+                DecompressBytes(codec, stored, sectionData_);
+                data = sectionData_;
+            } else if (encodedSize != storedSize) {
+                throw std::runtime_error("Invalid uncompressed section in " + blockName + " of file: " + getFileName());
+            }
+
+            auto decodeFloats = [&](std::span<float> values) {
+                decodeWords(encoding, data, count, [&](std::size_t j, std::uint32_t word) { values[j] = std::bit_cast<float>(word); });
+            };
+
+            switch (column) {
+                case Column::TYPE:           decodeTypes(encoding, data, block_.getTypes()); break;
+                case Column::KINETIC_ENERGY: decodeFloats(block_.getKineticEnergies()); break;
+                case Column::X:              decodeFloats(block_.getXPositions()); break;
+                case Column::Y:              decodeFloats(block_.getYPositions()); break;
+                case Column::Z:              decodeFloats(block_.getZPositions()); break;
+                case Column::DIRECTION_X:    decodeFloats(block_.getDirectionalCosinesX()); break;
+                case Column::DIRECTION_Y:    decodeFloats(block_.getDirectionalCosinesY()); break;
+                case Column::DIRECTION_Z:    decodeFloats(block_.getDirectionalCosinesZ()); break;
+                case Column::WEIGHT:         decodeFloats(block_.getWeights()); break;
+                case Column::NEW_HISTORY:
+                    if (encoding != Encoding::BITS) throw std::runtime_error("Invalid encoding for the new history flags in " + blockName + " of file: " + getFileName());
+                    unpackBits(data, count, 1, [&](std::size_t j, std::uint32_t bit) { newHistoryFlags[j] = static_cast<std::uint8_t>(bit); });
+                    newHistoryFlagsDecoded = true;
+                    break;
+                case Column::INCREMENTAL_HISTORIES:
+                    {
+                        if (!newHistoryFlagsDecoded) throw std::runtime_error("Incremental histories before the new history flags in " + blockName + " of file: " + getFileName());
+                        // the values are only stored for the particles starting a new history
+                        std::vector<std::size_t> firstParticles;
+                        for (std::size_t j = 0; j < count; j++) {
+                            if (newHistoryFlags[j]) firstParticles.push_back(j);
+                        }
+                        std::fill(incrementalHistories.begin(), incrementalHistories.end(), 0u);
+                        decodeWords(encoding, data, firstParticles.size(), [&](std::size_t j, std::uint32_t word) { incrementalHistories[firstParticles[j]] = word; });
+                    }
+                    break;
+                case Column::INT_PROPERTY:           decodePropertyColumn(encoding, data, block_.addIntColumn(static_cast<IntPropertyType>(property))); break;
+                case Column::FLOAT_PROPERTY:         decodePropertyColumn(encoding, data, block_.addFloatColumn(static_cast<FloatPropertyType>(property))); break;
+                case Column::BOOL_PROPERTY:          decodePropertyColumn(encoding, data, block_.addBoolColumn(static_cast<BoolPropertyType>(property))); break;
+                case Column::CUSTOM_INT_PROPERTY:    decodePropertyColumn(encoding, data, block_.addCustomIntColumn()); break;
+                case Column::CUSTOM_FLOAT_PROPERTY:  decodePropertyColumn(encoding, data, block_.addCustomFloatColumn()); break;
+                case Column::CUSTOM_BOOL_PROPERTY:   decodePropertyColumn(encoding, data, block_.addCustomBoolColumn()); break;
+                case Column::CUSTOM_STRING_PROPERTY: decodePropertyColumn(encoding, data, block_.addCustomStringColumn()); break;
+                default:
+                    throw std::runtime_error("Unknown column " + std::to_string(static_cast<int>(column)) + " in " + blockName + " of file: " + getFileName());
+            }
+            if (static_cast<int>(column) <= static_cast<int>(Column::INCREMENTAL_HISTORIES)) {
+                columnsFound |= 1u << static_cast<int>(column);
+            }
+        }
+
+        constexpr std::uint32_t REQUIRED_COLUMNS = ((1u << (static_cast<int>(Column::INCREMENTAL_HISTORIES) + 1)) - 1) & ~1u;
+        if (columnsFound != REQUIRED_COLUMNS) {
+            throw std::runtime_error("Missing columns in " + blockName + " of file: " + getFileName());
+        }
+
+        currentBlock_ = blockNumber;
+        positionInBlock_ = 0;
+    }
+
+    void Reader::ensureParticleInBlock() {
+        while (currentBlock_ >= blocks_.size() || positionInBlock_ >= block_.size()) {
+            const std::size_t nextBlock = currentBlock_ >= blocks_.size() ? 0 : currentBlock_ + 1;
+            if (nextBlock >= blocks_.size()) {
+                throw std::runtime_error("No more particles to read.");
+            }
+            loadBlock(nextBlock);
+        }
+    }
+
+    Particle Reader::readParticleManually() {
+        ensureParticleInBlock();
+        return block_.getParticle(positionInBlock_++);
+    }
+
+    Particle Reader::peekParticleManually() {
+        ensureParticleInBlock();
+        return block_.getParticle(positionInBlock_);
+    }
+
+    void Reader::moveToParticleManually(std::uint64_t particleIndex) {
+        // The last block starting at or before the particle
+        const std::size_t blockNumber = static_cast<std::size_t>(std::upper_bound(blockFirstParticles_.begin(), blockFirstParticles_.end(), particleIndex) - blockFirstParticles_.begin()) - 1;
+        if (blockNumber != currentBlock_) {
+            loadBlock(blockNumber);
+        }
+        positionInBlock_ = static_cast<std::size_t>(particleIndex - blockFirstParticles_[blockNumber]);
+    }
+
+
+    // Implementations for the Writer class
+
+    Writer::Writer(const std::string & fileName, const UserOptions & options)
+    :   PhaseSpaceFileWriter("PZ", fileName, options, FormatType::NONE),
+        codec_(options.contains(PZCompressionCommand) ? CompressionCodecFromName(options.extractStringOption(PZCompressionCommand)) : DefaultCompressionCodec()),
+        compressionLevel_(options.extractIntOption(PZCompressionLevelCommand, 0)),
+        particlesPerBlock_(options.extractUIntOption(PZBlockSizeCommand, DEFAULT_PARTICLES_PER_BLOCK)),
+        bytesWritten_(0),
+        representedHistories_(0)
+    {
+        if (!IsCompressionCodecAvailable(codec_)) {
+            throw std::runtime_error("The " + CompressionCodecName(codec_) + " compression codec is not available in this build of ParticleZoo.");
+        }
+        if (particlesPerBlock_ == 0) {
+            throw std::runtime_error("The number of particles in each block must be positive.");
+        }
+
+        file_.open(fileName, std::ios::binary);
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open file: " + fileName);
+        }
+
+        std::vector<byte> header;
+        header.insert(header.end(), MAGIC.begin(), MAGIC.end());
+        appendLE(header, FORMAT_VERSION);
+        appendLE(header, particlesPerBlock_);
+        {
+            ProfileTimer timer = timeIO();
+            file_.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        }
+        countBytesWritten(header.size());
+        bytesWritten_ = header.size();
+
+        block_.reserve(particlesPerBlock_);
+    }
+
+    Writer::~Writer() {
+        close();
+    }
+
+    std::vector<CLICommand> Writer::getFormatSpecificCLICommands() {
+        return { PZCompressionCommand, PZCompressionLevelCommand, PZBlockSizeCommand };
+    }
+
+    void Writer::writeHeaderData(ByteBuffer & buffer) {
+        (void)buffer; // the header and footer are written by the writer itself
+    }
+
+    void Writer::writeParticleManually(Particle & particle) {
+        statistics_.addParticle(particle);
+        block_.addParticle(particle);
+        if (block_.size() >= particlesPerBlock_) {
+            writeBlock();
+        }
+    }
+
+    void Writer::closeManually() {
+        if (!file_.is_open()) return;
+        writeBlock();
+        writeFooter();
+        file_.close();
+        if (!file_) {
+            throw std::runtime_error("Failed to write file: " + getFileName());
+        }
+    }
+
+    void Writer::writeBlock() {
+        const std::size_t count = block_.size();
+        if (count == 0) return;
+
+        blockData_.clear();
+        appendLE(blockData_, static_cast<std::uint32_t>(count));
+        appendLE(blockData_, std::uint32_t{0}); // number of sections, filled in once known
+        std::uint32_t numberOfSections = 0;
+
+        // Appends the section held in sectionData_, compressing it if that makes it smaller
+        auto addSection = [&](Column column, Encoding encoding, std::int32_t property) {
+            const std::size_t headerOffset = blockData_.size();
+            blockData_.resize(headerOffset + SECTION_HEADER_SIZE);
+            CompressionCodec codec = CompressionCodec::NONE;
+            std::size_t storedSize = sectionData_.size();
+            if (codec_ != CompressionCodec::NONE && sectionData_.size() >= MINIMUM_SIZE_TO_COMPRESS) {
+                storedSize = CompressBytes(codec_, sectionData_, blockData_, compressionLevel_);
+                codec = codec_;
+                if (storedSize >= sectionData_.size()) {
+                    blockData_.resize(headerOffset + SECTION_HEADER_SIZE);
+                    codec = CompressionCodec::NONE;
+                    storedSize = sectionData_.size();
+                }
+            }
+            if (codec == CompressionCodec::NONE) {
+                blockData_.insert(blockData_.end(), sectionData_.begin(), sectionData_.end());
+            }
+            byte * header = blockData_.data() + headerOffset;
+            header[0] = static_cast<byte>(column);
+            header[1] = static_cast<byte>(encoding);
+            header[2] = static_cast<byte>(codec);
+            header[3] = 0;
+            storeLE(header + 4, property);
+            storeLE(header + 8, static_cast<std::uint32_t>(sectionData_.size()));
+            storeLE(header + 12, static_cast<std::uint32_t>(storedSize));
+            numberOfSections++;
+        };
+
+        const ParticleBlock & block = block_;
+
+        sectionData_.clear();
+        addSection(Column::TYPE, encodeTypes(block.getTypes(), sectionData_), 0);
+
+        auto addFloatSection = [&](Column column, std::span<const float> values) {
+            sectionData_.clear();
+            addSection(column, encodeWords(count, [&](std::size_t j) { return wordOf(values[j]); }, sectionData_), 0);
+        };
+        addFloatSection(Column::KINETIC_ENERGY, block.getKineticEnergies());
+        addFloatSection(Column::X, block.getXPositions());
+        addFloatSection(Column::Y, block.getYPositions());
+        addFloatSection(Column::Z, block.getZPositions());
+        addFloatSection(Column::DIRECTION_X, block.getDirectionalCosinesX());
+        addFloatSection(Column::DIRECTION_Y, block.getDirectionalCosinesY());
+        addFloatSection(Column::DIRECTION_Z, block.getDirectionalCosinesZ());
+        addFloatSection(Column::WEIGHT, block.getWeights());
+
+        // only the particles starting a new history have an incremental history number
+        std::span<const std::uint8_t> newHistoryFlags = block.getNewHistoryFlags();
+        std::span<const std::uint32_t> incrementalHistories = block.getIncrementalHistories();
+        std::vector<std::uint32_t> historyIncrements;
+        BlockIndexEntry entry;
+        for (std::size_t j = 0; j < count; j++) {
+            if (newHistoryFlags[j]) {
+                historyIncrements.push_back(incrementalHistories[j]);
+                entry.originalHistories += incrementalHistories[j];
+            }
+        }
+        entry.representedHistories = historyIncrements.size();
+
+        sectionData_.clear();
+        appendPackedBits(sectionData_, count, 1, [&](std::size_t j) { return newHistoryFlags[j] ? 1u : 0u; });
+        addSection(Column::NEW_HISTORY, Encoding::BITS, 0);
+        sectionData_.clear();
+        addSection(Column::INCREMENTAL_HISTORIES, encodeWords(historyIncrements.size(), [&](std::size_t j) { return historyIncrements[j]; }, sectionData_), 0);
+
+        for (const ParticleBlock::IntColumn & column : block.getIntColumns()) {
+            // the incremental history numbers are already stored in their own column
+            if (column.type == IntPropertyType::INCREMENTAL_HISTORY_NUMBER) continue;
+            sectionData_.clear();
+            addSection(Column::INT_PROPERTY, encodePropertyColumn(column, sectionData_), static_cast<std::int32_t>(column.type));
+        }
+        for (const ParticleBlock::FloatColumn & column : block.getFloatColumns()) {
+            sectionData_.clear();
+            addSection(Column::FLOAT_PROPERTY, encodePropertyColumn(column, sectionData_), static_cast<std::int32_t>(column.type));
+        }
+        for (const ParticleBlock::BoolColumn & column : block.getBoolColumns()) {
+            sectionData_.clear();
+            addSection(Column::BOOL_PROPERTY, encodePropertyColumn(column, sectionData_), static_cast<std::int32_t>(column.type));
+        }
+        for (const ParticleBlock::IntColumn & column : block.getCustomIntColumns()) {
+            sectionData_.clear();
+            addSection(Column::CUSTOM_INT_PROPERTY, encodePropertyColumn(column, sectionData_), 0);
+        }
+        for (const ParticleBlock::FloatColumn & column : block.getCustomFloatColumns()) {
+            sectionData_.clear();
+            addSection(Column::CUSTOM_FLOAT_PROPERTY, encodePropertyColumn(column, sectionData_), 0);
+        }
+        for (const ParticleBlock::BoolColumn & column : block.getCustomBoolColumns()) {
+            sectionData_.clear();
+            addSection(Column::CUSTOM_BOOL_PROPERTY, encodePropertyColumn(column, sectionData_), 0);
+        }
+        for (const ParticleBlock::StringColumn & column : block.getCustomStringColumns()) {
+            sectionData_.clear();
+            addSection(Column::CUSTOM_STRING_PROPERTY, encodePropertyColumn(column, sectionData_), 0);
+        }
+
+        storeLE(blockData_.data() + 4, numberOfSections);
+        if (blockData_.size() > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::runtime_error("Block too large for a ParticleZoo native phase space file, use a smaller block size.");
+        }
+
+        entry.offset = bytesWritten_;
+        entry.size = static_cast<std::uint32_t>(blockData_.size());
+        entry.numberOfParticles = static_cast<std::uint32_t>(count);
+        {
+            ProfileTimer timer = timeIO();
+            file_.write(reinterpret_cast<const char*>(blockData_.data()), static_cast<std::streamsize>(blockData_.size()));
+            if (!file_) {
+                throw std::runtime_error("Failed to write block to file: " + getFileName());
+            }
+        }
+        countBlockWritten(blockData_.size());
+        bytesWritten_ += blockData_.size();
+        representedHistories_ += entry.representedHistories;
+        blocks_.push_back(entry);
+
+        block_.clear();
+    }
+
+    // Footer layout, all little-endian:
+    //   u64 particles, u64 original histories, u64 represented histories, u8 codec, 3 reserved bytes,
+    //   f32 min/max X, min/max Y, min/max Z, min/max weight,
+    //   u32 particle types, then for each: i32 type, u64 count, f64 weight sum, f64 weighted energy sum, f32 min/max energy,
+    //   u64 blocks, then for each: u64 offset, u32 size, u32 particles, u64 represented histories, u64 original histories
+    void Writer::writeFooter() {
+        std::uint64_t numberOfParticles = 0;
+        for (const BlockIndexEntry & entry : blocks_) numberOfParticles += entry.numberOfParticles;
+
+        std::vector<byte> footer;
+        appendLE(footer, numberOfParticles);
+        appendLE(footer, getHistoriesWritten());
+        appendLE(footer, representedHistories_);
+        footer.push_back(static_cast<byte>(codec_));
+        footer.insert(footer.end(), 3, byte{0});
+        appendFloat(footer, statistics_.minX);
+        appendFloat(footer, statistics_.maxX);
+        appendFloat(footer, statistics_.minY);
+        appendFloat(footer, statistics_.maxY);
+        appendFloat(footer, statistics_.minZ);
+        appendFloat(footer, statistics_.maxZ);
+        appendFloat(footer, statistics_.minWeight);
+        appendFloat(footer, statistics_.maxWeight);
+        appendLE(footer, static_cast<std::uint32_t>(statistics_.byType.size()));
+        for (const auto & [type, stats] : statistics_.byType) {
+            appendLE(footer, static_cast<std::int32_t>(type));
+            appendLE(footer, stats.count);
+            appendDouble(footer, stats.weightSum);
+            appendDouble(footer, stats.weightedEnergySum);
+            appendFloat(footer, stats.minKineticEnergy);
+            appendFloat(footer, stats.maxKineticEnergy);
+        }
+        appendLE(footer, static_cast<std::uint64_t>(blocks_.size()));
+        for (const BlockIndexEntry & entry : blocks_) {
+            appendLE(footer, entry.offset);
+            appendLE(footer, entry.size);
+            appendLE(footer, entry.numberOfParticles);
+            appendLE(footer, entry.representedHistories);
+            appendLE(footer, entry.originalHistories);
+        }
+
+        const std::uint64_t footerOffset = bytesWritten_;
+        appendLE(footer, footerOffset);
+        appendLE(footer, static_cast<std::uint64_t>(footer.size() - sizeof(std::uint64_t)));
+        footer.insert(footer.end(), MAGIC.begin(), MAGIC.end());
+        {
+            ProfileTimer timer = timeIO();
+            file_.write(reinterpret_cast<const char*>(footer.data()), static_cast<std::streamsize>(footer.size()));
+        }
+        countBytesWritten(footer.size());
+        bytesWritten_ += footer.size();
+    }
+
+} // namespace ParticleZoo::PZphspFile
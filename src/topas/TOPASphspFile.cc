@@ -2,8 +2,8 @@
 #include "particlezoo/TOPAS/TOPASphspFile.h"
 #include "particlezoo/TOPAS/TOPASHeader.h"
 #include "particlezoo/Particle.h"
-#include <sstream>
-#include <iomanip>
+#include "particlezoo/utilities/asciiFields.h"
+#include "particlezoo/utilities/simd.h"
 
 namespace ParticleZoo::TOPASphspFile
 {
@@ -25,7 +25,7 @@ namespace ParticleZoo::TOPASphspFile
     }
 
     Reader::Reader(const std::string &filename, const UserOptions &options)
-        : Reader(filename, options, readHeader(filename))
+        : Reader(filename, options, readHeader(getHeaderFileSource(filename, options)))
     {}
 
     Reader::Reader(const std::string &filename, const UserOptions &options, std::pair<FormatType,Header> formatAndHeader)
@@ -34,18 +34,62 @@ namespace ParticleZoo::TOPASphspFile
       formatType_(header_.getTOPASFormat()),
       particleRecordLength_(header_.getRecordLength()),
       readFullDetails_(true),
-      emptyHistoriesCount_(0)
-    {}
+      emptyHistoriesCount_(0),
+      hasCustomColumns_(formatType_ == TOPASFormat::BINARY && header_.getColumnTypes().size() > 10),
+      endsWithPseudoParticle_(false),
+      blockDecoder_(nullptr)
+    {
+        // Pick the decoder of the record layout once rather than for every block
+        switch (formatType_) {
+            case TOPASFormat::BINARY: blockDecoder_ = &Reader::readStandardParticleBlock<TOPASFormat::BINARY>; break;
+            case TOPASFormat::LIMITED: blockDecoder_ = &Reader::readStandardParticleBlock<TOPASFormat::LIMITED>; break;
+            default: break;
+        }
+
+        // Look for a pseudo-particle closing the file, which readers moved into the file stop before
+        const std::size_t numberOfRecords = getNumberOfEntriesInFile();
+        if (formatType_ == TOPASFormat::BINARY && numberOfRecords > 0 && getStreamCompression() == StreamCompression::NONE && !IsStandardStream(filename)) {
+            std::ifstream file(filename, std::ios::binary);
+            file.seekg(static_cast<std::streamoff>(getRecordByteOffset(numberOfRecords - 1)));
+            ByteBuffer record(particleRecordLength_);
+            if (file && record.appendData(file, particleRecordLength_) == particleRecordLength_) {
+                record.moveTo(7 * sizeof(float)); // the type code follows the position, direction, energy and weight
+                endsWithPseudoParticle_ = record.read<std::int32_t>() == 0;
+            }
+        }
+    }
     
+    Reader::Reader(const Reader & other)
+    : PhaseSpaceFileReader(other),
+      header_(other.header_),
+      formatType_(other.formatType_),
+      particleRecordLength_(other.particleRecordLength_),
+      readFullDetails_(other.readFullDetails_),
+      emptyHistoriesCount_(0),
+      hasCustomColumns_(other.hasCustomColumns_),
+      endsWithPseudoParticle_(other.endsWithPseudoParticle_),
+      blockDecoder_(other.blockDecoder_)
+    {}
+
     std::vector<CLICommand> Reader::getFormatSpecificCLICommands() { return {}; }
 
-    Particle Reader::readASCIIParticle(const std::string & line)
+    std::unique_ptr<PhaseSpaceFileReader> Reader::clone() const {
+        return std::unique_ptr<PhaseSpaceFileReader>(new Reader(*this));
+    }
+
+    Particle Reader::readASCIIParticle(std::string_view line)
     {
-        std::istringstream iss(line);
-        float x, y, z, u, v, energy, weight;
-        std::int32_t typeCode;
-        bool wIsNegative, isNewHistory;
-        iss >> x >> y >> z >> u >> v >> energy >> weight >> typeCode >> wIsNegative >> isNewHistory;
+        ASCIILineParser fields(line);
+        float x = fields.next<float>();
+        float y = fields.next<float>();
+        float z = fields.next<float>();
+        float u = fields.next<float>();
+        float v = fields.next<float>();
+        float energy = fields.next<float>();
+        float weight = fields.next<float>();
+        std::int32_t typeCode = fields.next<std::int32_t>();
+        bool wIsNegative = fields.next<bool>();
+        bool isNewHistory = fields.next<bool>();
 
         float w = calcThirdUnitComponent(u, v);
         if (wIsNegative) {
@@ -66,38 +110,24 @@ namespace ParticleZoo::TOPASphspFile
                 const Header::DataColumn & column = columnTypes[idx];
                 switch (column.valueType_) {
                     case Header::DataType::BOOLEAN:
-                        bool boolValue;
-                        iss >> boolValue;
-                        particle.setBoolProperty(BoolPropertyType::CUSTOM, boolValue);
+                        particle.setBoolProperty(BoolPropertyType::CUSTOM, fields.next<bool>());
                         break;
                     case Header::DataType::FLOAT32:
-                        float floatValue;
-                        iss >> floatValue;
-                        particle.setFloatProperty(FloatPropertyType::CUSTOM, floatValue);
+                        particle.setFloatProperty(FloatPropertyType::CUSTOM, fields.next<float>());
                         break;
                     case Header::DataType::FLOAT64:
-                        double doubleValue;
-                        iss >> doubleValue;
-                        particle.setFloatProperty(FloatPropertyType::CUSTOM, static_cast<float>(doubleValue));
+                        particle.setFloatProperty(FloatPropertyType::CUSTOM, static_cast<float>(fields.next<double>()));
                         break;
                     case Header::DataType::INT8:
-                        std::int8_t int8Value;
-                        iss >> int8Value;
-                        particle.setIntProperty(IntPropertyType::CUSTOM, static_cast<std::int32_t>(int8Value));
+                        // written as a number, not as a character
+                        particle.setIntProperty(IntPropertyType::CUSTOM, static_cast<std::int32_t>(static_cast<std::int8_t>(fields.next<std::int32_t>())));
                         break;
                     case Header::DataType::INT32:
-                        std::int32_t int32Value;
-                        iss >> int32Value;
-                        particle.setIntProperty(IntPropertyType::CUSTOM, int32Value);
+                        particle.setIntProperty(IntPropertyType::CUSTOM, fields.next<std::int32_t>());
                         break;
                     case Header::DataType::STRING:
-                        {
-                            std::string stringValue;
-                            // read the string value, which is expected to be 22 characters long
-                            stringValue.resize(22);
-                            iss.read(stringValue.data(), 22);
-                            particle.setStringProperty(stringValue);
-                        }
+                        // the string value is written in a column 22 characters wide
+                        particle.setStringProperty(std::string(fields.nextChars(22)));
                         break;
                     default:
                         throw std::runtime_error("Unknown column data type in TOPAS ASCII phase space file: " + std::to_string(static_cast<int>(column.columnType_)));
@@ -208,6 +238,151 @@ namespace ParticleZoo::TOPASphspFile
         return Particle(type, energy, x, y, z, u, v, w, isNewHistory, weight);
     }
 
+    namespace {
+        // The positions of the fixed leading columns of the standard TOPAS binary record layouts
+        template <TOPASFormat Layout> struct StandardRecordLayout;
+
+        template <> struct StandardRecordLayout<TOPASFormat::BINARY> {
+            static constexpr std::size_t X = 0, Y = 4, Z = 8, U = 12, V = 16, ENERGY = 20, WEIGHT = 24;
+            static constexpr std::size_t TYPE = 28;          // PDG code, 0 for a pseudo-particle
+            static constexpr std::size_t W_IS_NEGATIVE = 32;
+            static constexpr std::size_t IS_NEW_HISTORY = 33;
+            static constexpr std::size_t LENGTH = 34;
+        };
+
+        template <> struct StandardRecordLayout<TOPASFormat::LIMITED> {
+            static constexpr std::size_t TYPE = 0;           // type code, negative if w is
+            static constexpr std::size_t ENERGY = 1;         // negative for a new history
+            static constexpr std::size_t X = 5, Y = 9, Z = 13, U = 17, V = 21, WEIGHT = 25;
+            static constexpr std::size_t LENGTH = 29;
+
+            // particle types of the type codes
+            static constexpr ParticleType TYPES[] = { ParticleType::Unsupported, ParticleType::Photon, ParticleType::Electron, ParticleType::Positron, ParticleType::Neutron, ParticleType::Proton };
+        };
+    }
+
+    std::size_t Reader::readBinaryParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block)
+    {
+        // custom columns are read by the generic column interpreter of readBinaryStandardParticle()
+        if (!blockDecoder_ || (readFullDetails_ && hasCustomColumns_)) return BINARY_PARTICLE_BLOCKS_UNSUPPORTED;
+        return (this->*blockDecoder_)(records, numberOfRecords, block);
+    }
+
+    template <TOPASFormat Layout>
+    std::size_t Reader::readStandardParticleBlock(ByteBuffer & records, std::size_t numberOfRecords, ParticleBlock & block)
+    {
+        using RecordLayout = StandardRecordLayout<Layout>;
+        const std::size_t recordLength = particleRecordLength_;
+        if (recordLength < RecordLayout::LENGTH || records.remainingToRead() / recordLength < numberOfRecords) {
+            throw std::runtime_error("Not enough data to decode the requested number of TOPAS particle records.");
+        }
+
+        const std::size_t first = block.size();
+        block.resize(first + numberOfRecords);
+
+        ParticleType * types = block.getTypes().data() + first;
+        float * energies = block.getKineticEnergies().data() + first;
+        float * xs = block.getXPositions().data() + first;
+        float * ys = block.getYPositions().data() + first;
+        float * zs = block.getZPositions().data() + first;
+        float * us = block.getDirectionalCosinesX().data() + first;
+        float * vs = block.getDirectionalCosinesY().data() + first;
+        float * ws = block.getDirectionalCosinesZ().data() + first;
+        float * weights = block.getWeights().data() + first;
+        std::uint8_t * isNewHistory = block.getNewHistoryFlags().data() + first;
+        std::uint32_t * incrementalHistories = block.getIncrementalHistories().data() + first;
+
+        wIsNegative_.resize(numberOfRecords);
+        std::uint8_t * wIsNegative = wIsNegative_.data();
+
+        // The particle types first, pseudo-particles at the end of the batch have no particle to fold into
+        std::size_t recordsDecoded = numberOfRecords;
+        bool hasPseudoParticles = false;
+        if constexpr (Layout == TOPASFormat::BINARY) {
+            typeCodes_.resize(numberOfRecords);
+            records.peekColumn(std::span<std::int32_t>(typeCodes_), RecordLayout::TYPE, recordLength);
+            while (recordsDecoded > 0 && typeCodes_[recordsDecoded - 1] == 0) recordsDecoded--; // left to readBinaryParticle()
+            for (std::size_t i = 0; i < recordsDecoded; i++) {
+                if (typeCodes_[i] == 0) {
+                    types[i] = ParticleType::PseudoParticle;
+                    hasPseudoParticles = true;
+                    continue;
+                }
+                types[i] = getParticleTypeFromPDGID(typeCodes_[i]);
+                if (types[i] == ParticleType::Unsupported) {
+                    throw std::runtime_error("Invalid particle type code in TOPAS phase space file: " + std::to_string(typeCodes_[i]));
+                }
+            }
+            records.peekColumn(std::span<std::uint8_t>(wIsNegative, recordsDecoded), RecordLayout::W_IS_NEGATIVE, recordLength);
+            records.peekColumn(std::span<std::uint8_t>(isNewHistory, recordsDecoded), RecordLayout::IS_NEW_HISTORY, recordLength);
+        } else {
+            records.peekColumn(std::span<std::uint8_t>(wIsNegative, recordsDecoded), RecordLayout::TYPE, recordLength);
+            for (std::size_t i = 0; i < recordsDecoded; i++) {
+                std::int8_t typeCode = static_cast<std::int8_t>(wIsNegative[i]);
+                wIsNegative[i] = typeCode < 0 ? 1 : 0;
+                typeCode = typeCode < 0 ? -typeCode : typeCode;
+                if (typeCode < 1 || typeCode > 5) {
+                    throw std::runtime_error("Invalid particle type ("+std::to_string(typeCode)+") in TOPAS Limited phase space file.");
+                }
+                types[i] = RecordLayout::TYPES[typeCode];
+            }
+        }
+
+        // Gather the other fields of the fixed stride records into the columns
+        records.peekColumn(std::span<float>(xs, recordsDecoded), RecordLayout::X, recordLength);
+        records.peekColumn(std::span<float>(ys, recordsDecoded), RecordLayout::Y, recordLength);
+        records.peekColumn(std::span<float>(zs, recordsDecoded), RecordLayout::Z, recordLength);
+        records.peekColumn(std::span<float>(us, recordsDecoded), RecordLayout::U, recordLength);
+        records.peekColumn(std::span<float>(vs, recordsDecoded), RecordLayout::V, recordLength);
+        records.peekColumn(std::span<float>(energies, recordsDecoded), RecordLayout::ENERGY, recordLength);
+        records.peekColumn(std::span<float>(weights, recordsDecoded), RecordLayout::WEIGHT, recordLength);
+        records.readBytes(recordsDecoded * recordLength);
+
+        CalcThirdUnitComponents(us, vs, ws, recordsDecoded);
+
+        // Branch free passes which the compiler can vectorize
+        for (std::size_t i = 0; i < recordsDecoded; i++) {
+            xs[i] *= cm;
+            ys[i] *= cm;
+            zs[i] *= cm;
+            ws[i] = wIsNegative[i] ? -ws[i] : ws[i]; // restore w directional component sign
+            if constexpr (Layout == TOPASFormat::LIMITED) {
+                isNewHistory[i] = energies[i] < 0 ? 1 : 0;
+                energies[i] = energies[i] < 0 ? -energies[i] : energies[i]; // restore energy
+            } else {
+                isNewHistory[i] = isNewHistory[i] ? 1 : 0;
+            }
+            energies[i] *= MeV;
+            incrementalHistories[i] = isNewHistory[i];
+        }
+
+        NormalizeDirectionalCosines(us, vs, ws, recordsDecoded);
+        block.resize(first + recordsDecoded);
+
+        if (hasPseudoParticles) {
+            // Fold the empty histories of each pseudo-particle into the particle after it, as readBinaryParticle() does
+            std::vector<std::uint8_t> & keep = wIsNegative_; // the signs are no longer needed
+            std::int32_t emptyHistories = 0;
+            for (std::size_t i = 0; i < recordsDecoded; i++) {
+                if (types[i] == ParticleType::PseudoParticle) {
+                    if (weights[i] >= 0) throw std::runtime_error("Invalid weight for pseudo particle in TOPAS binary file");
+                    emptyHistories += roundToInt32(-weights[i]);
+                    keep[i] = 0;
+                    continue;
+                }
+                if (emptyHistories > 0) {
+                    isNewHistory[i] = 1;
+                    incrementalHistories[i] = static_cast<std::uint32_t>(emptyHistories) + 1;
+                    emptyHistories = 0;
+                }
+                keep[i] = 1;
+            }
+            block.retainParticles(first, std::span<const std::uint8_t>(keep.data(), recordsDecoded));
+        }
+
+        return recordsDecoded;
+    }
+
     // Implementations for Writer
 
     inline FormatType getFormatTypeFromTOPASFormat(TOPASFormat format)
@@ -237,7 +412,7 @@ namespace ParticleZoo::TOPASphspFile
     {}
 
     Writer::Writer(const std::string &filename, const UserOptions &options, TOPASFormat formatType)
-        : PhaseSpaceFileWriter(Header::getTOPASFormatName(formatType), filename, options, getFormatTypeFromTOPASFormat(formatType)), formatType_(formatType), header_(filename, formatType)
+        : PhaseSpaceFileWriter(Header::getTOPASFormatName(formatType), filename, options, getFormatTypeFromTOPASFormat(formatType)), formatType_(formatType), header_(getHeaderFileSource(filename, options), formatType)
     {
         if (options.contains(TOPASWritePseudoParticleAtEndOnlyCommand)) {
             writePseudoParticleAtEndOnly_ = true;
@@ -260,7 +435,50 @@ namespace ParticleZoo::TOPASphspFile
         header_.writeHeader();
     }
 
-    const std::string Writer::writeASCIIParticle(Particle & particle)
+    void Writer::writeProvisionalHeader()
+    {
+        header_.writeHeader();
+    }
+
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileWriter & other)
+    {
+        const Writer & otherWriter = dynamic_cast<const Writer &>(other);
+        // The other header already holds the final history count of its file, see writeHeaderData()
+        header_.mergeParticleStats(otherWriter.header_);
+    }
+
+    bool Writer::hasSameRecordLayout(const PhaseSpaceFileReader & reader) const
+    {
+        const Reader * topasReader = dynamic_cast<const Reader *>(&reader);
+        return topasReader && header_.hasSameColumns(topasReader->getHeader());
+    }
+
+    void Writer::mergeStatisticsFrom(const PhaseSpaceFileReader & reader)
+    {
+        const Reader & topasReader = dynamic_cast<const Reader &>(reader);
+        // Empty histories pending from earlier files go before the copied records
+        writePseudoParticleForEmptyHistories();
+        header_.mergeParticleStats(topasReader.getHeader());
+    }
+
+    void Writer::countParticleStats(const Particle & particle)
+    {
+        // Empty histories pending from earlier particles go before the copied records
+        writePseudoParticleForEmptyHistories();
+        header_.countParticleStats(particle);
+    }
+
+    void Writer::countParticleBlockStats(const ParticleBlock & block)
+    {
+        header_.countParticleStats(block);
+    }
+
+    std::vector<std::string> Writer::getOutputFileNames() const
+    {
+        return { getFileName(), header_.getHeaderFileName() };
+    }
+
+    void Writer::writeASCIIParticle(ASCIILineWriter & line, Particle & particle)
     {
         if (particle.getType() == ParticleType::Unsupported) {
             throw std::runtime_error("Attempting to write particle with unsupported type to TOPAS ASCII phase space file.");
@@ -268,27 +486,27 @@ namespace ParticleZoo::TOPASphspFile
 
         if (particle.getType() == ParticleType::PseudoParticle) {
             header_.countParticleStats(particle);
-            return ""; // write nothing for pseudoparticles
+            return; // write nothing for pseudoparticles
         }
 
-        std::ostringstream oss;
-        oss << std::setw(12) << particle.getX() / cm << " "
-            << std::setw(12) << particle.getY() / cm << " "
-            << std::setw(12) << particle.getZ() / cm << " "
-            << std::setw(12) << particle.getDirectionalCosineX() << " "
-            << std::setw(12) << particle.getDirectionalCosineY() << " "
-            << std::setw(12) << particle.getKineticEnergy() / MeV << " "
-            << std::setw(12) << particle.getWeight() << " "
-            << std::setw(12) << getPDGIDFromParticleType(particle.getType()) << " "
-            << std::setw(2) << (particle.getDirectionalCosineZ() < 0 ? 1 : 0) << " "
-            << std::setw(2) << (particle.isNewHistory() ? 1 : 0);
+        // Values are written as a std::ostream would with std::setw(), floating point values in its default %g format
+        line.writeGeneral(particle.getX() / cm, 6, 12); line.write(' ');
+        line.writeGeneral(particle.getY() / cm, 6, 12); line.write(' ');
+        line.writeGeneral(particle.getZ() / cm, 6, 12); line.write(' ');
+        line.writeGeneral(particle.getDirectionalCosineX(), 6, 12); line.write(' ');
+        line.writeGeneral(particle.getDirectionalCosineY(), 6, 12); line.write(' ');
+        line.writeGeneral(particle.getKineticEnergy() / MeV, 6, 12); line.write(' ');
+        line.writeGeneral(particle.getWeight(), 6, 12); line.write(' ');
+        line.writeInteger(getPDGIDFromParticleType(particle.getType()), 12); line.write(' ');
+        line.writeInteger(particle.getDirectionalCosineZ() < 0 ? 1 : 0, 2); line.write(' ');
+        line.writeInteger(particle.isNewHistory() ? 1 : 0, 2);
 
         // Write any additional properties
         const std::vector<Header::DataColumn> & columnTypes = header_.getColumnTypes();
         if (columnTypes.size() > 10) {
-            const std::vector<bool> & customBoolProperties = particle.getCustomBoolProperties();
-            const std::vector<float> & customFloatProperties = particle.getCustomFloatProperties();
-            const std::vector<std::int32_t> & customIntProperties = particle.getCustomIntProperties();
+            std::span<const bool> customBoolProperties = particle.getCustomBoolProperties();
+            std::span<const float> customFloatProperties = particle.getCustomFloatProperties();
+            std::span<const std::int32_t> customIntProperties = particle.getCustomIntProperties();
             const std::vector<std::string> & customStringProperties = particle.getCustomStringProperties();
 
             std::size_t customBoolIndex = 0;
@@ -296,40 +514,36 @@ namespace ParticleZoo::TOPASphspFile
             std::size_t customIntIndex = 0;
             std::size_t customStringIndex = 0;
 
-            oss << " ";
+            line.write(' ');
             // skip the first 10 columns that we've already consumed
             for (std::size_t idx = 10; idx < columnTypes.size(); ++idx) {
                 const Header::DataColumn & column = columnTypes[idx];
                 switch (column.valueType_) {
                     case Header::DataType::STRING:
-                        oss << std::setw(22) << customStringProperties[customStringIndex++].substr(0,22) << " ";
+                        line.write(std::string_view(customStringProperties[customStringIndex++]).substr(0,22), 22);
                         break;
                     case Header::DataType::BOOLEAN:
-                        oss << std::setw(2) << (customBoolProperties[customBoolIndex++] ? 1 : 0) << " ";
+                        line.writeInteger(customBoolProperties[customBoolIndex++] ? 1 : 0, 2);
                         break;
                     case Header::DataType::INT8:
-                        {
-                            std::int8_t customIntValue = static_cast<std::int8_t>(customIntProperties[customIntIndex++]);
-                            oss << std::setw(12) << static_cast<int>(customIntValue) << " ";
-                        }
+                        line.writeInteger(static_cast<int>(static_cast<std::int8_t>(customIntProperties[customIntIndex++])), 12);
                         break;
                     case Header::DataType::INT32:
-                        oss << std::setw(12) << customIntProperties[customIntIndex++] << " ";
+                        line.writeInteger(customIntProperties[customIntIndex++], 12);
                         break;
                     case Header::DataType::FLOAT32:
-                        oss << std::setw(12) << customFloatProperties[customFloatIndex++] << " ";
+                        line.writeGeneral(customFloatProperties[customFloatIndex++], 6, 12);
                         break;
                     case Header::DataType::FLOAT64:
-                        oss << std::setw(12) << customFloatProperties[customFloatIndex++] << " ";
+                        line.writeGeneral(customFloatProperties[customFloatIndex++], 6, 12);
                         break;
                 }
+                line.write(' ');
             }
         }
-        oss << std::endl;
+        line.write('\n');
 
         header_.countParticleStats(particle);
-
-        return oss.str();
     }
 
     void Writer::writePseudoParticleForEmptyHistories()
@@ -387,9 +601,9 @@ namespace ParticleZoo::TOPASphspFile
         // Write any additional properties
         const std::vector<Header::DataColumn> & columnTypes = header_.getColumnTypes();
         if (columnTypes.size() > 10) {
-            const std::vector<bool> & customBoolProperties = particle.getCustomBoolProperties();
-            const std::vector<float> & customFloatProperties = particle.getCustomFloatProperties();
-            const std::vector<std::int32_t> & customIntProperties = particle.getCustomIntProperties();
+            std::span<const bool> customBoolProperties = particle.getCustomBoolProperties();
+            std::span<const float> customFloatProperties = particle.getCustomFloatProperties();
+            std::span<const std::int32_t> customIntProperties = particle.getCustomIntProperties();
             const std::vector<std::string> & customStringProperties = particle.getCustomStringProperties();
 
             std::size_t customBoolIndex = 0;
@@ -12,6 +12,50 @@
 
 namespace ParticleZoo {
 
+    namespace {
+
+        // Parses a value based on expected type
+        CLIValue ParseValue(const std::string& value, CLIArgType type) {
+            switch (type) {
+                case CLI_FLOAT:
+                    return std::stof(value);
+                case CLI_UINT:
+                    {
+                        // std::stoul with base 0 auto-detects: 0x prefix = hex, 0 prefix = octal, otherwise decimal
+                        unsigned long ulValue = std::stoul(value, nullptr, 0);
+                        if (ulValue > static_cast<unsigned long>(std::numeric_limits<unsigned int>::max())) {
+                            throw std::out_of_range("Value out of range for unsigned int");
+                        }
+                        return static_cast<unsigned int>(ulValue);
+                    }
+                case CLI_INT:
+                    return std::stoi(value);
+                case CLI_STRING:
+                    return value;
+                case CLI_BOOL:
+                    return (value == "true" || value == "1" || value == "yes");
+                case CLI_VALUELESS:
+                    return true; // presence of flag indicates true
+                default:
+                    throw std::runtime_error("Invalid CLI argument type");
+            }
+        }
+
+        // Finds a command by name
+        const CLICommand* FindCommand(const std::unordered_set<CLICommand>& commands, const std::string& name, bool isShort) {
+            for (const auto& cmd : commands) {
+                if (isShort && !cmd.shortName.empty() && cmd.shortName == name) {
+                    return &cmd;
+                }
+                if (!isShort && !cmd.longName.empty() && cmd.longName == name) {
+                    return &cmd;
+                }
+            }
+            return nullptr;
+        }
+
+    } // end anonymous namespace
+
     /// @brief Registers a command for argument parsing.
     /// @param command The command to register.
     void ArgParser::RegisterCommand(const CLICommand& command)
@@ -118,46 +162,6 @@ namespace ParticleZoo {
             std::exit(0);
         };
 
-        // Lambda to parse a value based on expected type
-        auto parseValue = [](const std::string& value, CLIArgType type) -> CLIValue {
-            switch (type) {
-                case CLI_FLOAT:
-                    return std::stof(value);
-                case CLI_UINT:
-                    {
-                        // std::stoul with base 0 auto-detects: 0x prefix = hex, 0 prefix = octal, otherwise decimal
-                        unsigned long ulValue = std::stoul(value, nullptr, 0);
-                        if (ulValue > static_cast<unsigned long>(std::numeric_limits<unsigned int>::max())) {
-                            throw std::out_of_range("Value out of range for unsigned int");
-                        }
-                        return static_cast<unsigned int>(ulValue);
-                    }
-                case CLI_INT:
-                    return std::stoi(value);
-                case CLI_STRING:
-                    return value;
-                case CLI_BOOL:
-                    return (value == "true" || value == "1" || value == "yes");
-                case CLI_VALUELESS:
-                    return true; // presence of flag indicates true
-                default:
-                    throw std::runtime_error("Invalid CLI argument type");
-            }
-        };
-
-        // Lambda to find a command by name
-        auto findCommand = [&commands](const std::string& name, bool isShort) -> const CLICommand* {
-            for (const auto& cmd : commands) {
-                if (isShort && !cmd.shortName.empty() && cmd.shortName == name) {
-                    return &cmd;
-                }
-                if (!isShort && !cmd.longName.empty() && cmd.longName == name) {
-                    return &cmd;
-                }
-            }
-            return nullptr;
-        };
-
         std::vector<CLIValue> positional;
         UserOptions & opts = parser.setOptions; // Start with default options
 
@@ -184,7 +188,7 @@ namespace ParticleZoo {
                     printVersion();
                 }
 
-                const CLICommand* cmd = findCommand(optName, false);
+                const CLICommand* cmd = FindCommand(commands, optName, false);
                 
                 if (!cmd) {
                     std::cerr << "Unknown option: --" << optName << std::endl;
@@ -203,7 +207,7 @@ namespace ParticleZoo {
                             PrintUsage(usageMessage);
                         }
                         try {
-                            CLIValue value = parseValue(argv[i], argType);
+                            CLIValue value = ParseValue(argv[i], argType);
                             values.push_back(value);
                         } catch (const std::exception&) {
                             std::cerr << "Invalid value for option --" << optName << ": " << argv[i] << std::endl;
@@ -234,7 +238,7 @@ namespace ParticleZoo {
                     printVersion();
                 }
 
-                const CLICommand* cmd = findCommand(optName, true);
+                const CLICommand* cmd = FindCommand(commands, optName, true);
                 
                 if (!cmd) {
                     std::cerr << "Unknown option: -" << optName << std::endl;
@@ -253,7 +257,7 @@ namespace ParticleZoo {
                             PrintUsage(usageMessage);
                         }
                         try {
-                            CLIValue value = parseValue(argv[i], argType);
+                            CLIValue value = ParseValue(argv[i], argType);
                             values.push_back(value);
                         } catch (const std::exception&) {
                             std::cerr << "Invalid value for option -" << optName << ": " << argv[i] << std::endl;
@@ -282,6 +286,62 @@ namespace ParticleZoo {
         return opts;
     }
 
+    /// @brief Parses a list of arguments based on registered commands, throwing on errors.
+    /// @param arguments The arguments to parse, not including a program name.
+    /// @param baseOptions Options to which the parsed options are added.
+    /// @return The base options with the parsed options and positional arguments in place of their own.
+    UserOptions ArgParser::ParseArgList(const std::vector<std::string>& arguments, const UserOptions& baseOptions)
+    {
+        const auto& commands = Instance().commands;
+
+        std::vector<CLIValue> positional;
+        UserOptions opts = baseOptions;
+
+        for (std::size_t i = 0; i < arguments.size(); i++) {
+            const std::string& arg = arguments[i];
+
+            const bool isLong = arg.rfind("--", 0) == 0;
+            const bool isShort = !isLong && arg.rfind("-", 0) == 0 && arg.length() > 1;
+            if (!isLong && !isShort) {
+                // Positional argument
+                positional.push_back(arg);
+                continue;
+            }
+
+            const std::string prefix = isLong ? "--" : "-";
+            const std::string optName = arg.substr(prefix.length());
+            const CLICommand* cmd = FindCommand(commands, optName, isShort);
+            if (!cmd) {
+                throw std::runtime_error("Unknown option: " + prefix + optName);
+            }
+
+            std::vector<CLIValue> values;
+
+            // Parse expected arguments based on command definition
+            for (auto argType : cmd->argTypes) {
+                if (argType == CLI_VALUELESS) {
+                    values.push_back(true);
+                } else {
+                    if (++i >= arguments.size()) {
+                        throw std::runtime_error("Option " + prefix + optName + " requires an additional argument");
+                    }
+                    try {
+                        values.push_back(ParseValue(arguments[i], argType));
+                    } catch (const std::exception&) {
+                        throw std::runtime_error("Invalid value for option " + prefix + optName + ": " + arguments[i]);
+                    }
+                }
+            }
+
+            opts[*cmd] = values;
+        }
+
+        // Store positional arguments
+        opts[CLI_POSITIONALS] = positional;
+
+        return opts;
+    }
+
     void ArgParser::PrintUsage(const std::string & usageMessage, const int exitCode) {
         PrintUsage(std::string_view(usageMessage), exitCode);
     }
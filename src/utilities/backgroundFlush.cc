@@ -0,0 +1,99 @@
+#include "particlezoo/utilities/backgroundFlush.h"
+
+#include <stdexcept>
+
+namespace ParticleZoo
+{
+
+    BackgroundFlusher::BackgroundFlusher(OutputFileStream & file, std::size_t queueDepth)
+    :   file_(file),
+        queueDepth_(queueDepth),
+        buffersInFlight_(0),
+        stopRequested_(false)
+    {
+        if (queueDepth_ == 0) {
+            throw std::runtime_error("Background flush queue depth must be positive.");
+        }
+        if (!file_.is_open()) {
+            throw std::runtime_error("File is not open when starting the background flusher.");
+        }
+        worker_ = std::thread(&BackgroundFlusher::run, this);
+    }
+
+    BackgroundFlusher::~BackgroundFlusher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopRequested_ = true;
+        }
+        bufferPending_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    void BackgroundFlusher::submit(ByteBuffer & buffer) {
+        if (buffer.length() == 0) return;
+
+        const std::size_t capacity = buffer.capacity();
+        const ByteOrder byteOrder = buffer.getByteOrder();
+        ByteBuffer replacement(1);
+        bool haveReplacement = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bufferWritten_.wait(lock, [this] { return buffersInFlight_ < queueDepth_ || error_; });
+            rethrowIfFailed();
+            if (!freeBuffers_.empty()) {
+                replacement = std::move(freeBuffers_.back());
+                freeBuffers_.pop_back();
+                haveReplacement = true;
+            }
+            pendingBuffers_.push_back(std::move(buffer));
+            buffersInFlight_++;
+        }
+        bufferPending_.notify_one();
+
+        // Allocate outside of the lock so that the I/O thread is not held up
+        if (haveReplacement && replacement.capacity() == capacity) {
+            replacement.setByteOrder(byteOrder);
+        } else {
+            replacement = ByteBuffer(capacity, byteOrder);
+        }
+        buffer = std::move(replacement);
+    }
+
+    void BackgroundFlusher::drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bufferWritten_.wait(lock, [this] { return buffersInFlight_ == 0 || error_; });
+        rethrowIfFailed();
+    }
+
+    void BackgroundFlusher::rethrowIfFailed() {
+        if (error_) std::rethrow_exception(error_);
+    }
+
+    void BackgroundFlusher::run() {
+        while (true) {
+            ByteBuffer buffer(1);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                bufferPending_.wait(lock, [this] { return stopRequested_ || !pendingBuffers_.empty(); });
+                if (pendingBuffers_.empty() || error_) return; // stop requested and nothing left to write
+                buffer = std::move(pendingBuffers_.front());
+                pendingBuffers_.pop_front();
+            }
+
+            // Write outside of the lock so that the producer can keep submitting buffers meanwhile
+            file_.write(reinterpret_cast<const char*>(buffer.data()), buffer.length());
+            buffer.clear();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (file_.fail() && !error_) {
+                    error_ = std::make_exception_ptr(std::runtime_error("Failed to write buffered data to file in the background."));
+                }
+                freeBuffers_.push_back(std::move(buffer));
+                buffersInFlight_--;
+            }
+            bufferWritten_.notify_all();
+        }
+    }
+
+} // namespace ParticleZoo
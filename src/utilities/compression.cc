@@ -0,0 +1,157 @@
+#include "particlezoo/utilities/compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        [[noreturn, maybe_unused]] void throwUnavailable(CompressionCodec codec) {
+            throw std::runtime_error("The " + CompressionCodecName(codec) + " compression codec is not available in this build of ParticleZoo.");
+        }
+    }
+
+    bool IsCompressionCodecAvailable(CompressionCodec codec) {
+        switch (codec) {
+            case CompressionCodec::NONE:
+                return true;
+            case CompressionCodec::ZSTD:
+            #ifdef USE_ZSTD
+                return true;
+            #else
+                return false;
+            #endif
+            case CompressionCodec::LZ4:
+            #ifdef USE_LZ4
+                return true;
+            #else
+                return false;
+            #endif
+        }
+        return false;
+    }
+
+    std::string CompressionCodecName(CompressionCodec codec) {
+        switch (codec) {
+            case CompressionCodec::NONE: return "none";
+            case CompressionCodec::ZSTD: return "zstd";
+            case CompressionCodec::LZ4:  return "lz4";
+        }
+        return "unknown (" + std::to_string(static_cast<int>(codec)) + ")";
+    }
+
+    CompressionCodec CompressionCodecFromName(const std::string & name) {
+        std::string lowerName(name);
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (lowerName == "none") return CompressionCodec::NONE;
+        if (lowerName == "zstd") return CompressionCodec::ZSTD;
+        if (lowerName == "lz4") return CompressionCodec::LZ4;
+        throw std::runtime_error("Unknown compression codec: " + name + " (expected none, zstd or lz4)");
+    }
+
+    CompressionCodec DefaultCompressionCodec() {
+        if (IsCompressionCodecAvailable(CompressionCodec::ZSTD)) return CompressionCodec::ZSTD;
+        if (IsCompressionCodecAvailable(CompressionCodec::LZ4)) return CompressionCodec::LZ4;
+        return CompressionCodec::NONE;
+    }
+
+    std::size_t CompressBytes(CompressionCodec codec, std::span<const byte> input, std::vector<byte> & output, [[maybe_unused]] int level) {
+        [[maybe_unused]] const std::size_t start = output.size();
+        switch (codec) {
+            case CompressionCodec::NONE:
+                output.insert(output.end(), input.begin(), input.end());
+                return input.size();
+            case CompressionCodec::ZSTD:
+            #ifdef USE_ZSTD
+                {
+                    output.resize(start + ZSTD_compressBound(input.size()));
+                    const std::size_t compressedSize = ZSTD_compress(output.data() + start, output.size() - start, input.data(), input.size(), level == 0 ? ZSTD_CLEVEL_DEFAULT : level);
+                    if (ZSTD_isError(compressedSize)) {
+                        output.resize(start);
+                        throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(compressedSize));
+                    }
+                    output.resize(start + compressedSize);
+                    return compressedSize;
+                }
+            #else
+                throwUnavailable(codec);
+            #endif
+            case CompressionCodec::LZ4:
+            #ifdef USE_LZ4
+                {
+                    if (input.size() > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE)) {
+                        throw std::runtime_error("Data too large to be compressed with lz4 in one piece.");
+                    }
+                    const int inputSize = static_cast<int>(input.size());
+                    output.resize(start + static_cast<std::size_t>(LZ4_compressBound(inputSize)));
+                    const int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(input.data()), reinterpret_cast<char*>(output.data() + start), inputSize, static_cast<int>(output.size() - start));
+                    if (compressedSize <= 0) {
+                        output.resize(start);
+                        throw std::runtime_error("lz4 compression failed.");
+                    }
+                    output.resize(start + static_cast<std::size_t>(compressedSize));
+                    return static_cast<std::size_t>(compressedSize);
+                }
+            #else
+                throwUnavailable(codec);
+            #endif
+        }
+        throw std::runtime_error("Unknown compression codec: " + CompressionCodecName(codec));
+    }
+
+    void DecompressBytes(CompressionCodec codec, std::span<const byte> input, std::span<byte> output) {
+        switch (codec) {
+            case CompressionCodec::NONE:
+                if (input.size() != output.size()) {
+                    throw std::runtime_error("Stored data is " + std::to_string(input.size()) + " bytes instead of the expected " + std::to_string(output.size()) + ".");
+                }
+                std::memcpy(output.data(), input.data(), input.size());
+                return;
+            case CompressionCodec::ZSTD:
+            #ifdef USE_ZSTD
+                {
+                    const std::size_t decompressedSize = ZSTD_decompress(output.data(), output.size(), input.data(), input.size());
+                    if (ZSTD_isError(decompressedSize)) {
+                        throw std::runtime_error(std::string("zstd decompression failed: ") + ZSTD_getErrorName(decompressedSize));
+                    }
+                    if (decompressedSize != output.size()) {
+                        throw std::runtime_error("zstd data decompressed to " + std::to_string(decompressedSize) + " bytes instead of the expected " + std::to_string(output.size()) + ".");
+                    }
+                    return;
+                }
+            #else
+                throwUnavailable(codec);
+            #endif
+            case CompressionCodec::LZ4:
+            #ifdef USE_LZ4
+                {
+                    if (input.size() > static_cast<std::size_t>(std::numeric_limits<int>::max()) || output.size() > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+                        throw std::runtime_error("Data too large to be decompressed with lz4 in one piece.");
+                    }
+                    const int decompressedSize = LZ4_decompress_safe(reinterpret_cast<const char*>(input.data()), reinterpret_cast<char*>(output.data()), static_cast<int>(input.size()), static_cast<int>(output.size()));
+                    if (decompressedSize < 0 || static_cast<std::size_t>(decompressedSize) != output.size()) {
+                        throw std::runtime_error("lz4 data is corrupt or does not decompress to the expected " + std::to_string(output.size()) + " bytes.");
+                    }
+                    return;
+                }
+            #else
+                throwUnavailable(codec);
+            #endif
+        }
+        throw std::runtime_error("Unknown compression codec: " + CompressionCodecName(codec));
+    }
+
+} // namespace ParticleZoo
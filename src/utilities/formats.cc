@@ -6,10 +6,13 @@
 #include "particlezoo/Particle.h"
 #include "particlezoo/PhaseSpaceFileReader.h"
 #include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/PhaseSpaceSet.h"
 #include "particlezoo/egs/egsphspFile.h"
 #include "particlezoo/IAEA/IAEAphspFile.h"
 #include "particlezoo/TOPAS/TOPASphspFile.h"
 #include "particlezoo/peneasy/penEasyphspFile.h"
+#include "particlezoo/pz/PZphspFile.h"
+#include "particlezoo/utilities/inputFileStream.h"
 
 #ifdef USE_ROOT
 #include "particlezoo/ROOT/ROOTphsp.h"
@@ -80,6 +83,20 @@ namespace ParticleZoo
                            return std::make_unique<ParticleZoo::EGSphspFile::Writer>(filename, options);
                        });
 
+        // Register the ParticleZoo native format
+        SupportedFormat pzFormat{"PZ", "ParticleZoo Native Phase Space File Format (compressed, columnar and seekable)", ".pzphsp"};
+        auto pzReaderCommands = PZphspFile::Reader::getFormatSpecificCLICommands();
+        auto pzWriterCommands = PZphspFile::Writer::getFormatSpecificCLICommands();
+        ArgParser::RegisterCommands(pzReaderCommands);
+        ArgParser::RegisterCommands(pzWriterCommands);
+        RegisterFormat(pzFormat,
+                       [](const std::string& filename, const UserOptions & options) {
+                           return std::make_unique<ParticleZoo::PZphspFile::Reader>(filename, options);
+                       },
+                       [](const std::string& filename, const UserOptions & options, const FixedValues &) {
+                           return std::make_unique<ParticleZoo::PZphspFile::Writer>(filename, options);
+                       });
+
     #ifdef USE_ROOT
         // Register ROOT format
         SupportedFormat rootFormat{"ROOT", "ROOT Phase Space File Format (TOPAS and OpenGATE templates available)", ".root"};
@@ -96,6 +113,16 @@ namespace ParticleZoo
                        });
     #endif
 
+        // Register phase space sets, lists of files of any of the formats above read as one
+        SupportedFormat setFormat{"PhaseSpaceSet", "Phase Space Set (list of phase space files read in order as one, read only)", ".pzset"};
+        RegisterFormat(setFormat,
+                       [](const std::string& filename, const UserOptions & options) {
+                           return std::make_unique<ParticleZoo::PhaseSpaceSet>(filename, options);
+                       },
+                       [](const std::string& filename, const UserOptions &, const FixedValues &) -> std::unique_ptr<PhaseSpaceFileWriter> {
+                           throw std::runtime_error("Phase space sets cannot be written, write each of the files separately instead: " + filename);
+                       });
+
     #ifdef PZ_USE_EXT
         RegisterExternalFormats();
     #endif
@@ -140,7 +167,10 @@ namespace ParticleZoo
 
     std::unique_ptr<PhaseSpaceFileReader> FormatRegistry::CreateReader(const std::string& filename, const UserOptions & options)
     {
-        std::filesystem::path p{filename};
+        if (IsStandardStream(filename)) {
+            throw std::runtime_error("The format of standard input cannot be told from its name, it has to be given explicitly.");
+        }
+        std::filesystem::path p{StripCompressionSuffix(filename)}; // beam.IAEAphsp.gz is read as an IAEA file
         auto ext = p.extension().string();
         if (ext.empty()) {
             throw std::runtime_error("Filename does not have an extension: " + filename);
@@ -154,17 +184,28 @@ namespace ParticleZoo
 
     std::unique_ptr<PhaseSpaceFileReader> FormatRegistry::CreateReader(const std::string& formatName, const std::string& filename, const UserOptions & options)
     {
-        FormatRegistry& registry = instance();
-        std::unique_lock lock(registry.mutex_);
-        auto it = registry.readerFactories_.find(formatName);
-        if (it == registry.readerFactories_.end()) {
-            throw std::runtime_error("Unsupported format: " + formatName);
+        // Call the factory without holding the lock, so that readers can open other readers (e.g. phase space sets)
+        ReaderFactoryFn factory;
+        {
+            FormatRegistry& registry = instance();
+            std::unique_lock lock(registry.mutex_);
+            auto it = registry.readerFactories_.find(formatName);
+            if (it == registry.readerFactories_.end()) {
+                throw std::runtime_error("Unsupported format: " + formatName);
+            }
+            factory = it->second;
         }
-        return it->second(filename, options);
+        return factory(filename, options);
     }
 
     std::unique_ptr<PhaseSpaceFileWriter> FormatRegistry::CreateWriter(const std::string& filename, const UserOptions & options, const FixedValues & fixedValues)
     {
+        if (HasCompressionSuffix(filename)) {
+            throw std::runtime_error("Writing compressed phase space files is not supported: " + filename);
+        }
+        if (IsStandardStream(filename)) {
+            throw std::runtime_error("The format of standard output cannot be told from its name, it has to be given explicitly.");
+        }
         std::filesystem::path p{filename};
         auto ext = p.extension().string();
         if (ext.empty()) {
@@ -179,13 +220,17 @@ namespace ParticleZoo
 
     std::unique_ptr<PhaseSpaceFileWriter> FormatRegistry::CreateWriter(const std::string& formatName, const std::string& filename, const UserOptions & options, const FixedValues & fixedValues)
     {
-        FormatRegistry& registry = instance();
-        std::unique_lock lock(registry.mutex_);
-        auto it = registry.writerFactories_.find(formatName);
-        if (it == registry.writerFactories_.end()) {
-            throw std::runtime_error("Unsupported format: " + formatName);
+        WriterFactoryFn factory;
+        {
+            FormatRegistry& registry = instance();
+            std::unique_lock lock(registry.mutex_);
+            auto it = registry.writerFactories_.find(formatName);
+            if (it == registry.writerFactories_.end()) {
+                throw std::runtime_error("Unsupported format: " + formatName);
+            }
+            factory = it->second;
         }
-        return it->second(filename, options, fixedValues);
+        return factory(filename, options, fixedValues);
     }
 
     std::vector<SupportedFormat> FormatRegistry::FormatsForExtension(const std::string& extension)
@@ -201,7 +246,7 @@ namespace ParticleZoo
             return out;
         };
 
-        std::string extLower = toLower(extension);
+        std::string extLower = toLower(StripCompressionSuffix(extension));
         std::vector<SupportedFormat> result;
         for (auto const& fmt : registry.formats_)
         {
@@ -0,0 +1,194 @@
+#include "particlezoo/utilities/historyIndex.h"
+
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include "particlezoo/ByteBuffer.h"
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        constexpr char INDEX_MAGIC[] = "PZHIDX02";
+        constexpr char INDEX_MAGIC_WITHOUT_BLOCK_STATISTICS[] = "PZHIDX01"; // written before block statistics were added, still loaded
+        constexpr std::size_t INDEX_MAGIC_LENGTH = sizeof(INDEX_MAGIC) - 1;
+        constexpr std::size_t BLOCK_STATISTICS_SIZE = 4 * sizeof(std::uint64_t) + 8 * sizeof(float);
+        constexpr std::size_t INDEX_HEADER_SIZE = INDEX_MAGIC_LENGTH + 6 * sizeof(std::uint64_t);
+        constexpr ByteOrder INDEX_BYTE_ORDER = ByteOrder::LittleEndian; // same on every platform so the sidecar can be shared
+
+        // The size and modification time of a phase space file, used to detect a stale index
+        std::pair<std::uint64_t, std::int64_t> GetFileSignature(const std::string & fileName) {
+            const std::filesystem::path path(fileName);
+            std::uint64_t fileSize = static_cast<std::uint64_t>(std::filesystem::file_size(path));
+            std::int64_t modificationTime = static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+            return { fileSize, modificationTime };
+        }
+
+        // Read fixed size items through a buffer refilled from a file
+        template <typename ReadItem>
+        void ReadItems(std::ifstream & file, ByteBuffer & items, std::size_t numberOfItems, std::size_t itemSize, ReadItem && readItem) {
+            for (std::size_t item = 0; item < numberOfItems; item++) {
+                while (items.remainingToRead() < itemSize) {
+                    items.compact();
+                    items.appendData(file); // throws once the file ends
+                }
+                readItem(items, item);
+            }
+        }
+    }
+
+    HistoryIndex::HistoryIndex(std::uint64_t stride, std::uint64_t numberOfRepresentedHistories, std::uint64_t numberOfParticles, std::vector<std::uint64_t> historyStarts, std::vector<HistoryBlockStatistics> blockStatistics)
+    :   stride_(stride),
+        numberOfRepresentedHistories_(numberOfRepresentedHistories),
+        numberOfParticles_(numberOfParticles),
+        historyStarts_(std::move(historyStarts)),
+        blockStatistics_(std::move(blockStatistics))
+    {
+        if (stride_ == 0) {
+            throw std::invalid_argument("History index stride must be positive.");
+        }
+        std::uint64_t expectedEntries = (numberOfRepresentedHistories_ + stride_ - 1) / stride_;
+        if (historyStarts_.size() != expectedEntries) {
+            throw std::invalid_argument("History index has " + std::to_string(historyStarts_.size()) + " entries but " + std::to_string(expectedEntries) + " are required for " + std::to_string(numberOfRepresentedHistories_) + " histories.");
+        }
+        if (!blockStatistics_.empty() && blockStatistics_.size() != historyStarts_.size()) {
+            throw std::invalid_argument("History index has statistics for " + std::to_string(blockStatistics_.size()) + " blocks but " + std::to_string(historyStarts_.size()) + " entries.");
+        }
+    }
+
+    std::optional<HistoryIndex> HistoryIndex::Load(const std::string & phspFileName) {
+        const std::string indexFileName = GetIndexFileName(phspFileName);
+        std::error_code error;
+        if (!std::filesystem::exists(indexFileName, error) || !std::filesystem::exists(phspFileName, error)) {
+            return std::nullopt;
+        }
+
+        // A sidecar that cannot be read in full is treated the same as a missing one
+        try {
+            std::ifstream file(indexFileName, std::ios::binary);
+            if (!file.is_open()) return std::nullopt;
+
+            ByteBuffer header(INDEX_HEADER_SIZE, INDEX_BYTE_ORDER);
+            if (header.setData(file) != INDEX_HEADER_SIZE) return std::nullopt;
+            const std::string magic = header.readString(INDEX_MAGIC_LENGTH);
+            const bool hasBlockStatistics = magic == std::string(INDEX_MAGIC, INDEX_MAGIC_LENGTH);
+            if (!hasBlockStatistics && magic != std::string(INDEX_MAGIC_WITHOUT_BLOCK_STATISTICS, INDEX_MAGIC_LENGTH)) return std::nullopt;
+
+            const std::uint64_t fileSize = header.read<std::uint64_t>();
+            const std::int64_t modificationTime = header.read<std::int64_t>();
+            if (std::make_pair(fileSize, modificationTime) != GetFileSignature(phspFileName)) {
+                return std::nullopt; // the phase space file has changed since the index was built
+            }
+
+            const std::uint64_t stride = header.read<std::uint64_t>();
+            const std::uint64_t numberOfRepresentedHistories = header.read<std::uint64_t>();
+            const std::uint64_t numberOfParticles = header.read<std::uint64_t>();
+            const std::uint64_t numberOfEntries = header.read<std::uint64_t>();
+            if (stride == 0 || numberOfEntries != (numberOfRepresentedHistories + stride - 1) / stride) return std::nullopt;
+
+            std::vector<std::uint64_t> historyStarts(static_cast<std::size_t>(numberOfEntries));
+            ByteBuffer items(DEFAULT_BUFFER_SIZE, INDEX_BYTE_ORDER);
+            ReadItems(file, items, historyStarts.size(), sizeof(std::uint64_t), [&historyStarts](ByteBuffer & entries, std::size_t entry) {
+                historyStarts[entry] = entries.read<std::uint64_t>();
+            });
+
+            // The statistics of every block follow the entries
+            std::vector<HistoryBlockStatistics> blockStatistics;
+            if (hasBlockStatistics) {
+                blockStatistics.resize(historyStarts.size());
+                ReadItems(file, items, blockStatistics.size(), BLOCK_STATISTICS_SIZE, [&blockStatistics](ByteBuffer & blocks, std::size_t block) {
+                    HistoryBlockStatistics & statistics = blockStatistics[block];
+                    statistics.numberOfRecords = blocks.read<std::uint64_t>();
+                    statistics.numberOfPseudoParticles = blocks.read<std::uint64_t>();
+                    statistics.numberOfHistories = blocks.read<std::uint64_t>();
+                    statistics.particleTypes = blocks.read<std::uint64_t>();
+                    statistics.minEnergy = blocks.read<float>();
+                    statistics.maxEnergy = blocks.read<float>();
+                    statistics.minX = blocks.read<float>();
+                    statistics.maxX = blocks.read<float>();
+                    statistics.minY = blocks.read<float>();
+                    statistics.maxY = blocks.read<float>();
+                    statistics.minZ = blocks.read<float>();
+                    statistics.maxZ = blocks.read<float>();
+                });
+            }
+
+            return HistoryIndex(stride, numberOfRepresentedHistories, numberOfParticles, std::move(historyStarts), std::move(blockStatistics));
+        } catch (const std::exception &) {
+            return std::nullopt;
+        }
+    }
+
+    void HistoryIndex::save(const std::string & phspFileName) const {
+        if (!std::filesystem::exists(phspFileName)) {
+            throw std::runtime_error("Cannot save history index, phase space file does not exist: " + phspFileName);
+        }
+        const auto [fileSize, modificationTime] = GetFileSignature(phspFileName);
+
+        const std::string indexFileName = GetIndexFileName(phspFileName);
+        std::ofstream file(indexFileName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open history index file for writing: " + indexFileName);
+        }
+
+        ByteBuffer buffer(DEFAULT_BUFFER_SIZE, INDEX_BYTE_ORDER);
+        const bool hasBlockStatistics = !blockStatistics_.empty();
+        buffer.writeString(hasBlockStatistics ? std::string(INDEX_MAGIC, INDEX_MAGIC_LENGTH) : std::string(INDEX_MAGIC_WITHOUT_BLOCK_STATISTICS, INDEX_MAGIC_LENGTH));
+        buffer.write<std::uint64_t>(fileSize);
+        buffer.write<std::int64_t>(modificationTime);
+        buffer.write<std::uint64_t>(stride_);
+        buffer.write<std::uint64_t>(numberOfRepresentedHistories_);
+        buffer.write<std::uint64_t>(numberOfParticles_);
+        buffer.write<std::uint64_t>(static_cast<std::uint64_t>(historyStarts_.size()));
+
+        for (std::uint64_t recordIndex : historyStarts_) {
+            if (buffer.remainingToWrite() < sizeof(std::uint64_t)) {
+                file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.length()));
+                buffer.clear();
+            }
+            buffer.write<std::uint64_t>(recordIndex);
+        }
+        for (const HistoryBlockStatistics & statistics : blockStatistics_) {
+            if (buffer.remainingToWrite() < BLOCK_STATISTICS_SIZE) {
+                file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.length()));
+                buffer.clear();
+            }
+            buffer.write<std::uint64_t>(statistics.numberOfRecords);
+            buffer.write<std::uint64_t>(statistics.numberOfPseudoParticles);
+            buffer.write<std::uint64_t>(statistics.numberOfHistories);
+            buffer.write<std::uint64_t>(statistics.particleTypes);
+            buffer.write<float>(statistics.minEnergy);
+            buffer.write<float>(statistics.maxEnergy);
+            buffer.write<float>(statistics.minX);
+            buffer.write<float>(statistics.maxX);
+            buffer.write<float>(statistics.minY);
+            buffer.write<float>(statistics.maxY);
+            buffer.write<float>(statistics.minZ);
+            buffer.write<float>(statistics.maxZ);
+        }
+        file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.length()));
+
+        file.close();
+        if (file.fail()) {
+            throw std::runtime_error("Failed to write history index file: " + indexFileName);
+        }
+    }
+
+    std::pair<std::uint64_t, std::uint64_t> HistoryIndex::findClosestHistory(std::uint64_t historyNumber) const {
+        if (historyNumber >= numberOfRepresentedHistories_) {
+            throw std::out_of_range("History number " + std::to_string(historyNumber) + " is out of range for a file with " + std::to_string(numberOfRepresentedHistories_) + " represented histories.");
+        }
+        const std::uint64_t entry = historyNumber / stride_;
+        return { entry * stride_, historyStarts_[static_cast<std::size_t>(entry)] };
+    }
+
+    const HistoryBlockStatistics & HistoryIndex::getBlockStatistics(std::size_t block) const {
+        if (blockStatistics_.empty()) {
+            throw std::logic_error("This history index does not hold the statistics of its blocks of histories.");
+        }
+        return blockStatistics_.at(block);
+    }
+
+} // namespace ParticleZoo
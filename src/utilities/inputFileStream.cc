@@ -0,0 +1,664 @@
+#include "particlezoo/utilities/inputFileStream.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        constexpr std::uint32_t ZSTD_FRAME_MAGIC = 0xFD2FB528;
+        constexpr std::uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184D2A50;       // the lowest 4 bits may take any value
+        constexpr std::uint32_t ZSTD_SEEK_TABLE_MAGIC = 0x184D2A5E;      // skippable frame holding the seek table of the seekable zstd format
+        constexpr std::uint32_t ZSTD_SEEKABLE_FOOTER_MAGIC = 0x8F92EAB1;
+        constexpr std::size_t   ZSTD_SEEKABLE_FOOTER_SIZE = 9;
+        constexpr std::uint8_t  GZIP_MAGIC[2] = { 0x1F, 0x8B };
+
+        constexpr std::size_t INPUT_BUFFER_SIZE = 1 << 17;
+        constexpr std::size_t OUTPUT_BUFFER_SIZE = 1 << 18;
+
+        constexpr std::array<const char*, 3> COMPRESSION_SUFFIXES = { ".gz", ".zst", ".zstd" };
+
+        std::uint32_t loadLE32(const unsigned char * bytes) {
+            return static_cast<std::uint32_t>(bytes[0]) | static_cast<std::uint32_t>(bytes[1]) << 8
+                 | static_cast<std::uint32_t>(bytes[2]) << 16 | static_cast<std::uint32_t>(bytes[3]) << 24;
+        }
+
+        std::uint64_t loadLE(const unsigned char * bytes, std::size_t size) {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < size; i++) value |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+            return value;
+        }
+
+        std::string lowerCase(const std::string & text) {
+            std::string lower(text);
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return lower;
+        }
+
+        StreamCompression detectCompression(std::filebuf & file) {
+            unsigned char magic[4] = {};
+            file.pubseekpos(0, std::ios::in);
+            const std::streamsize magicSize = file.sgetn(reinterpret_cast<char*>(magic), sizeof(magic));
+            file.pubseekpos(0, std::ios::in);
+            if (magicSize >= 2 && magic[0] == GZIP_MAGIC[0] && magic[1] == GZIP_MAGIC[1]) return StreamCompression::GZIP;
+            if (magicSize == 4) {
+                const std::uint32_t word = loadLE32(magic);
+                // a zstd file may start with a skippable frame
+                if (word == ZSTD_FRAME_MAGIC || (word & 0xFFFFFFF0) == ZSTD_SKIPPABLE_MAGIC) return StreamCompression::ZSTD;
+            }
+            return StreamCompression::NONE;
+        }
+
+
+        /**
+         * Decompressor of the frames (zstd) or members (gzip) of a compressed file, one after the other.
+         */
+        class Decoder
+        {
+            public:
+                virtual ~Decoder() = default;
+
+                // Get ready to decompress a frame from its start
+                virtual void reset() = 0;
+
+                // Decompress as much of the input into the output as possible, returning true when the end of a frame is reached
+                virtual bool decode(std::span<const char> input, std::size_t & consumed, std::span<char> output, std::size_t & produced) = 0;
+        };
+
+    #ifdef USE_ZLIB
+        class GzipDecoder : public Decoder
+        {
+            public:
+                GzipDecoder() : stream_{} {
+                    if (inflateInit2(&stream_, 15 + 32) != Z_OK) { // 32 to accept both gzip and zlib headers
+                        throw std::runtime_error("Failed to initialize gzip decompression.");
+                    }
+                }
+
+                ~GzipDecoder() override { inflateEnd(&stream_); }
+
+                void reset() override { inflateReset(&stream_); }
+
+                bool decode(std::span<const char> input, std::size_t & consumed, std::span<char> output, std::size_t & produced) override {
+                    const uInt inputSize = static_cast<uInt>(std::min<std::size_t>(input.size(), std::numeric_limits<uInt>::max()));
+                    const uInt outputSize = static_cast<uInt>(std::min<std::size_t>(output.size(), std::numeric_limits<uInt>::max()));
+                    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+                    stream_.avail_in = inputSize;
+                    stream_.next_out = reinterpret_cast<Bytef*>(output.data());
+                    stream_.avail_out = outputSize;
+                    const int result = inflate(&stream_, Z_NO_FLUSH);
+                    consumed = inputSize - stream_.avail_in;
+                    produced = outputSize - stream_.avail_out;
+                    if (result == Z_STREAM_END) return true;
+                    if (result != Z_OK && result != Z_BUF_ERROR) {
+                        throw std::runtime_error(std::string("gzip decompression failed: ") + (stream_.msg ? stream_.msg : "corrupt data"));
+                    }
+                    return false;
+                }
+
+            private:
+                z_stream stream_;
+        };
+    #endif
+
+    #ifdef USE_ZSTD
+        class ZstdDecoder : public Decoder
+        {
+            public:
+                ZstdDecoder() : context_(ZSTD_createDCtx()) {
+                    if (!context_) {
+                        throw std::runtime_error("Failed to initialize zstd decompression.");
+                    }
+                }
+
+                ~ZstdDecoder() override { ZSTD_freeDCtx(context_); }
+
+                void reset() override { ZSTD_DCtx_reset(context_, ZSTD_reset_session_only); }
+
+                bool decode(std::span<const char> input, std::size_t & consumed, std::span<char> output, std::size_t & produced) override {
+                    ZSTD_inBuffer in{ input.data(), input.size(), 0 };
+                    ZSTD_outBuffer out{ output.data(), output.size(), 0 };
+                    const std::size_t result = ZSTD_decompressStream(context_, &out, &in);
+                    if (ZSTD_isError(result)) {
+                        throw std::runtime_error(std::string("zstd decompression failed: ") + ZSTD_getErrorName(result));
+                    }
+                    consumed = in.pos;
+                    produced = out.pos;
+                    return result == 0;
+                }
+
+            private:
+                ZSTD_DCtx * context_;
+        };
+    #endif
+
+        std::unique_ptr<Decoder> createDecoder(StreamCompression compression) {
+            switch (compression) {
+                case StreamCompression::GZIP:
+                #ifdef USE_ZLIB
+                    return std::make_unique<GzipDecoder>();
+                #else
+                    break;
+                #endif
+                case StreamCompression::ZSTD:
+                #ifdef USE_ZSTD
+                    return std::make_unique<ZstdDecoder>();
+                #else
+                    break;
+                #endif
+                case StreamCompression::NONE:
+                    break;
+            }
+            throw std::runtime_error("Files compressed with " + StreamCompressionName(compression) + " cannot be read by this build of ParticleZoo.");
+        }
+
+
+        /**
+         * Stream buffer holding the decompressed data of a file, read through a Decoder.
+         *
+         * Keeps an index of where each frame starts in both the compressed and the decompressed
+         * data, so that seeking only needs to decompress the frame holding the new position up
+         * to that position.
+         */
+        class DecompressingStreamBuffer : public std::streambuf
+        {
+            public:
+                DecompressingStreamBuffer(std::filebuf & source, StreamCompression compression)
+                :   source_(source),
+                    compression_(compression),
+                    decoder_(createDecoder(compression)),
+                    input_(INPUT_BUFFER_SIZE),
+                    inputOffset_(0),
+                    inputPosition_(0),
+                    inputLength_(0),
+                    inFrame_(false),
+                    output_(OUTPUT_BUFFER_SIZE),
+                    outputOffset_(0),
+                    frames_{ Frame{0, 0} },
+                    indexed_(false),
+                    decompressedSize_(0)
+                {
+                    setg(output_.data(), output_.data(), output_.data());
+                }
+
+            protected:
+                int_type underflow() override {
+                    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+                    if (!decodeMore()) return traits_type::eof();
+                    return traits_type::to_int_type(*gptr());
+                }
+
+                pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+                    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+                    if (direction == std::ios_base::cur && offset == 0) return pos_type(static_cast<off_type>(position())); // tellg()
+
+                    std::int64_t base = 0;
+                    if (direction == std::ios_base::cur) {
+                        base = static_cast<std::int64_t>(position());
+                    } else if (direction == std::ios_base::end) {
+                        buildIndex();
+                        base = static_cast<std::int64_t>(decompressedSize_);
+                    }
+                    if (base + offset < 0) return pos_type(off_type(-1));
+                    return seekpos(pos_type(static_cast<off_type>(base + offset)), which);
+                }
+
+                pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+                    if (!(which & std::ios_base::in) || off_type(position) < 0) return pos_type(off_type(-1));
+                    const std::uint64_t target = static_cast<std::uint64_t>(off_type(position));
+
+                    // Already decompressed
+                    const std::uint64_t outputEnd = outputOffset_ + static_cast<std::uint64_t>(egptr() - eback());
+                    if (target >= outputOffset_ && target <= outputEnd) {
+                        setg(eback(), eback() + (target - outputOffset_), egptr());
+                        return position;
+                    }
+
+                    buildIndex();
+                    if (target > decompressedSize_) return pos_type(off_type(-1));
+
+                    // Decompress forward from here if the position is further on in the same frame, otherwise from the start of its frame
+                    const std::size_t targetFrame = frameHolding(target);
+                    if (target < outputEnd || frameHolding(outputEnd) != targetFrame) {
+                        restartAt(targetFrame);
+                    }
+                    while (this->position() < target) {
+                        if (gptr() == egptr() && !decodeMore()) return pos_type(off_type(-1));
+                        const std::uint64_t available = static_cast<std::uint64_t>(egptr() - gptr());
+                        gbump(static_cast<int>(std::min<std::uint64_t>(available, target - this->position())));
+                    }
+                    return position;
+                }
+
+            private:
+                struct Frame {
+                    std::uint64_t compressedOffset;     // where the frame starts in the file
+                    std::uint64_t decompressedOffset;   // where its data starts in the decompressed data
+                };
+
+                std::uint64_t position() const {
+                    return outputOffset_ + static_cast<std::uint64_t>(gptr() - eback());
+                }
+
+                std::size_t frameHolding(std::uint64_t decompressedOffset) const {
+                    auto it = std::upper_bound(frames_.begin(), frames_.end(), decompressedOffset,
+                                               [](std::uint64_t offset, const Frame & frame) { return offset < frame.decompressedOffset; });
+                    return static_cast<std::size_t>(it - frames_.begin()) - 1;
+                }
+
+                void restartAt(std::size_t frame) {
+                    inputOffset_ = frames_[frame].compressedOffset;
+                    inputPosition_ = inputLength_ = 0;
+                    if (source_.pubseekpos(static_cast<std::streamoff>(inputOffset_), std::ios::in) == std::streampos(std::streamoff(-1))) {
+                        throw std::runtime_error("Failed to seek in compressed file.");
+                    }
+                    decoder_->reset();
+                    inFrame_ = false;
+                    outputOffset_ = frames_[frame].decompressedOffset;
+                    setg(output_.data(), output_.data(), output_.data());
+                }
+
+                // Replace the decompressed data already read with more, returning false at the end of the file
+                bool decodeMore() {
+                    outputOffset_ += static_cast<std::uint64_t>(egptr() - eback());
+                    std::size_t outputLength = 0;
+                    while (outputLength < output_.size()) {
+                        if (inputPosition_ == inputLength_) {
+                            inputOffset_ += inputLength_;
+                            inputPosition_ = 0;
+                            inputLength_ = static_cast<std::size_t>(std::max<std::streamsize>(0, source_.sgetn(input_.data(), static_cast<std::streamsize>(input_.size()))));
+                            if (inputLength_ == 0) {
+                                if (inFrame_) {
+                                    throw std::runtime_error("Unexpected end of compressed file, the file may be truncated.");
+                                }
+                                if (outputLength > 0) break;
+                                if (!indexed_) {
+                                    // read through to the end from the start, so every frame has been seen
+                                    if (frames_.size() > 1 && frames_.back().compressedOffset == inputOffset_) frames_.pop_back();
+                                    decompressedSize_ = outputOffset_;
+                                    indexed_ = true;
+                                }
+                                setg(output_.data(), output_.data(), output_.data());
+                                return false;
+                            }
+                        }
+
+                        std::size_t consumed = 0;
+                        std::size_t produced = 0;
+                        const bool frameEnded = decoder_->decode(std::span<const char>(input_.data() + inputPosition_, inputLength_ - inputPosition_), consumed,
+                                                                 std::span<char>(output_.data() + outputLength, output_.size() - outputLength), produced);
+                        inputPosition_ += consumed;
+                        outputLength += produced;
+                        if (frameEnded) {
+                            inFrame_ = false;
+                            decoder_->reset();
+                            if (!indexed_) {
+                                frames_.push_back(Frame{ inputOffset_ + inputPosition_, outputOffset_ + outputLength });
+                            }
+                        } else if (consumed > 0 || produced > 0) {
+                            inFrame_ = true;
+                        } else {
+                            throw std::runtime_error("Decompression of " + StreamCompressionName(compression_) + " data made no progress, the file may be corrupt.");
+                        }
+                    }
+                    setg(output_.data(), output_.data(), output_.data() + outputLength);
+                    return true;
+                }
+
+                // Make sure every frame and the decompressed size are known
+                void buildIndex() {
+                    if (indexed_) return;
+                    if (compression_ == StreamCompression::ZSTD && (readSeekTable() || readZstdFrameHeaders())) {
+                        indexed_ = true;
+                        // the reads for the index moved the file away from the next input
+                        source_.pubseekpos(static_cast<std::streamoff>(inputOffset_ + inputLength_), std::ios::in);
+                        return;
+                    }
+
+                    // Decompress the whole file once, noting where the frames start on the way
+                    const std::uint64_t savedPosition = position();
+                    frames_.assign(1, Frame{0, 0});
+                    restartAt(0);
+                    while (decodeMore()) {}
+                    restartAt(frameHolding(savedPosition));
+                    while (position() < savedPosition && (gptr() < egptr() || decodeMore())) {
+                        gbump(static_cast<int>(std::min<std::uint64_t>(static_cast<std::uint64_t>(egptr() - gptr()), savedPosition - position())));
+                    }
+                }
+
+                bool readAt(std::uint64_t offset, std::span<unsigned char> bytes) {
+                    if (source_.pubseekpos(static_cast<std::streamoff>(offset), std::ios::in) == std::streampos(std::streamoff(-1))) return false;
+                    return source_.sgetn(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())) == static_cast<std::streamsize>(bytes.size());
+                }
+
+                std::uint64_t compressedSize() {
+                    const std::streampos end = source_.pubseekoff(0, std::ios::end, std::ios::in);
+                    return end == std::streampos(std::streamoff(-1)) ? 0 : static_cast<std::uint64_t>(std::streamoff(end));
+                }
+
+                // Index the frames from the seek table at the end of a file in the seekable zstd format
+                bool readSeekTable() {
+                    const std::uint64_t fileSize = compressedSize();
+                    unsigned char footer[ZSTD_SEEKABLE_FOOTER_SIZE];
+                    if (fileSize < ZSTD_SEEKABLE_FOOTER_SIZE + 8 || !readAt(fileSize - ZSTD_SEEKABLE_FOOTER_SIZE, footer)) return false;
+                    if (loadLE32(footer + 5) != ZSTD_SEEKABLE_FOOTER_MAGIC) return false;
+                    const std::uint64_t numberOfFrames = loadLE32(footer);
+                    const bool hasChecksums = (footer[4] & 0x80) != 0;
+                    const std::uint64_t entrySize = hasChecksums ? 12 : 8;
+                    const std::uint64_t tableSize = 8 + numberOfFrames * entrySize + ZSTD_SEEKABLE_FOOTER_SIZE;
+                    if (tableSize > fileSize) return false;
+
+                    std::vector<unsigned char> table(static_cast<std::size_t>(tableSize));
+                    if (!readAt(fileSize - tableSize, table)) return false;
+                    if (loadLE32(table.data()) != ZSTD_SEEK_TABLE_MAGIC || loadLE32(table.data() + 4) != tableSize - 8) return false;
+
+                    std::vector<Frame> frames{ Frame{0, 0} };
+                    for (std::uint64_t i = 0; i < numberOfFrames; i++) {
+                        const unsigned char * entry = table.data() + 8 + i * entrySize;
+                        const Frame & last = frames.back();
+                        frames.push_back(Frame{ last.compressedOffset + loadLE32(entry), last.decompressedOffset + loadLE32(entry + 4) });
+                    }
+                    if (frames.back().compressedOffset != fileSize - tableSize) return false;
+
+                    decompressedSize_ = frames.back().decompressedOffset;
+                    frames.pop_back();
+                    frames_ = std::move(frames);
+                    return true;
+                }
+
+                // Index the frames of a zstd file from their headers, if each of them records its decompressed size
+                bool readZstdFrameHeaders() {
+                    const std::uint64_t fileSize = compressedSize();
+                    std::vector<Frame> frames;
+                    std::uint64_t offset = 0;
+                    std::uint64_t decompressedOffset = 0;
+                    while (offset < fileSize) {
+                        unsigned char header[18]; // magic, descriptor, window, up to 4 bytes of dictionary id and 8 of content size
+                        const std::size_t headerSize = static_cast<std::size_t>(std::min<std::uint64_t>(sizeof(header), fileSize - offset));
+                        if (headerSize < 8 || !readAt(offset, std::span<unsigned char>(header, headerSize))) return false;
+                        const std::uint32_t magic = loadLE32(header);
+                        if ((magic & 0xFFFFFFF0) == ZSTD_SKIPPABLE_MAGIC) {
+                            offset += 8 + static_cast<std::uint64_t>(loadLE32(header + 4));
+                            continue;
+                        }
+                        if (magic != ZSTD_FRAME_MAGIC) return false;
+
+                        const unsigned char descriptor = header[4];
+                        const unsigned int contentSizeFlag = descriptor >> 6;
+                        const bool singleSegment = (descriptor & 0x20) != 0;
+                        const bool hasChecksum = (descriptor & 0x04) != 0;
+                        const std::size_t dictionaryIdSize = std::array<std::size_t, 4>{ 0, 1, 2, 4 }[descriptor & 0x03];
+                        const std::size_t contentSizeSize = std::array<std::size_t, 4>{ singleSegment ? 1u : 0u, 2, 4, 8 }[contentSizeFlag];
+                        if (contentSizeSize == 0) return false; // the decompressed size is not recorded, the frame has to be decompressed to know it
+                        const std::size_t contentSizeOffset = 5 + (singleSegment ? 0 : 1) + dictionaryIdSize;
+                        if (contentSizeOffset + contentSizeSize > headerSize) return false;
+                        std::uint64_t contentSize = loadLE(header + contentSizeOffset, contentSizeSize);
+                        if (contentSizeSize == 2) contentSize += 256;
+
+                        // walk the blocks of the frame to find where it ends
+                        std::uint64_t blockOffset = offset + contentSizeOffset + contentSizeSize;
+                        bool lastBlock = false;
+                        while (!lastBlock) {
+                            unsigned char blockHeader[3];
+                            if (!readAt(blockOffset, blockHeader)) return false;
+                            const std::uint32_t value = static_cast<std::uint32_t>(blockHeader[0]) | static_cast<std::uint32_t>(blockHeader[1]) << 8 | static_cast<std::uint32_t>(blockHeader[2]) << 16;
+                            lastBlock = (value & 1) != 0;
+                            const unsigned int blockType = (value >> 1) & 3;
+                            const std::uint64_t blockSize = value >> 3;
+                            if (blockType == 3) return false; // reserved, corrupt data
+                            blockOffset += 3 + (blockType == 1 ? 1 : blockSize); // an RLE block stores a single byte
+                            if (blockOffset > fileSize) return false;
+                        }
+                        frames.push_back(Frame{ offset, decompressedOffset });
+                        offset = blockOffset + (hasChecksum ? 4 : 0);
+                        decompressedOffset += contentSize;
+                    }
+                    if (offset != fileSize || frames.empty()) return false;
+
+                    decompressedSize_ = decompressedOffset;
+                    frames_ = std::move(frames);
+                    return true;
+                }
+
+                std::filebuf & source_;
+                const StreamCompression compression_;
+                std::unique_ptr<Decoder> decoder_;
+
+                std::vector<char> input_;
+                std::uint64_t inputOffset_;     // offset in the file of input_[0]
+                std::size_t inputPosition_;     // next byte of input_ to decompress
+                std::size_t inputLength_;       // bytes of input_ holding data
+                bool inFrame_;                  // part of the current frame has been decompressed
+
+                std::vector<char> output_;      // the get area
+                std::uint64_t outputOffset_;    // offset in the decompressed data of output_[0]
+
+                std::vector<Frame> frames_;     // the known frames in file order, the first starting at 0
+                bool indexed_;                  // frames_ holds every frame and decompressedSize_ is known
+                std::uint64_t decompressedSize_;
+        };
+
+
+        /**
+         * Reader of standard input in binary mode, which can only go forward.
+         */
+        class StandardInputBuffer : public std::streambuf
+        {
+            public:
+                StandardInputBuffer()
+                :   buffer_(INPUT_BUFFER_SIZE),
+                    bufferOffset_(0)
+                {
+                #ifdef _WIN32
+                    _setmode(_fileno(stdin), _O_BINARY); // no translation of line ends
+                #endif
+                    setg(buffer_.data(), buffer_.data(), buffer_.data());
+                }
+
+            protected:
+                int_type underflow() override {
+                    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+                    bufferOffset_ += static_cast<std::uint64_t>(egptr() - eback());
+                    const std::size_t bytesRead = readInput(buffer_.data(), buffer_.size());
+                    setg(buffer_.data(), buffer_.data(), buffer_.data() + bytesRead);
+                    if (bytesRead == 0) return traits_type::eof();
+                    return traits_type::to_int_type(*gptr());
+                }
+
+                std::streamsize xsgetn(char * destination, std::streamsize count) override {
+                    // Take what is buffered, then read the rest straight into the destination
+                    const std::streamsize buffered = std::min<std::streamsize>(count, egptr() - gptr());
+                    std::memcpy(destination, gptr(), static_cast<std::size_t>(buffered));
+                    setg(eback(), gptr() + buffered, egptr());
+                    if (buffered == count) return count;
+
+                    bufferOffset_ += static_cast<std::uint64_t>(egptr() - eback());
+                    setg(buffer_.data(), buffer_.data(), buffer_.data());
+                    const std::size_t bytesRead = readInput(destination + buffered, static_cast<std::size_t>(count - buffered));
+                    bufferOffset_ += bytesRead;
+                    return buffered + static_cast<std::streamsize>(bytesRead);
+                }
+
+                pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+                    // Only tellg() is supported
+                    if (!(which & std::ios_base::in) || direction != std::ios_base::cur || offset != 0) return pos_type(off_type(-1));
+                    return pos_type(static_cast<off_type>(bufferOffset_ + static_cast<std::uint64_t>(gptr() - eback())));
+                }
+
+                pos_type seekpos(pos_type, std::ios_base::openmode) override {
+                    return pos_type(off_type(-1));
+                }
+
+            private:
+                static std::size_t readInput(char * destination, std::size_t count) {
+                    const std::size_t bytesRead = std::fread(destination, 1, count, stdin); // blocks until count bytes or the end of the input
+                    if (bytesRead < count && std::ferror(stdin)) {
+                        throw std::runtime_error("Failed to read from standard input.");
+                    }
+                    return bytesRead;
+                }
+
+                std::vector<char> buffer_;
+                std::uint64_t bufferOffset_;    // offset in the input of buffer_[0]
+        };
+    }
+
+
+    StreamCompression DetectStreamCompression(const std::string & fileName) {
+        if (IsStandardStream(fileName)) return StreamCompression::NONE; // standard input is not read ahead to look
+        std::filebuf file;
+        if (!file.open(fileName, std::ios::in | std::ios::binary)) return StreamCompression::NONE;
+        return detectCompression(file);
+    }
+
+    bool IsStreamCompressionAvailable(StreamCompression compression) {
+        switch (compression) {
+            case StreamCompression::NONE:
+                return true;
+            case StreamCompression::GZIP:
+            #ifdef USE_ZLIB
+                return true;
+            #else
+                return false;
+            #endif
+            case StreamCompression::ZSTD:
+            #ifdef USE_ZSTD
+                return true;
+            #else
+                return false;
+            #endif
+        }
+        return false;
+    }
+
+    std::string StreamCompressionName(StreamCompression compression) {
+        switch (compression) {
+            case StreamCompression::NONE: return "none";
+            case StreamCompression::GZIP: return "gzip";
+            case StreamCompression::ZSTD: return "zstd";
+        }
+        return "unknown";
+    }
+
+    bool HasCompressionSuffix(const std::string & fileName) {
+        return StripCompressionSuffix(fileName).size() != fileName.size();
+    }
+
+    std::string StripCompressionSuffix(const std::string & fileName) {
+        const std::string lowerName = lowerCase(fileName);
+        for (const char * suffix : COMPRESSION_SUFFIXES) {
+            const std::size_t length = std::strlen(suffix);
+            if (lowerName.size() > length && lowerName.compare(lowerName.size() - length, length, suffix) == 0) {
+                return fileName.substr(0, fileName.size() - length);
+            }
+        }
+        return fileName;
+    }
+
+
+    bool IsStandardStream(const std::string & fileName) {
+        return fileName == "-";
+    }
+
+
+    InputFileStream::InputFileStream()
+    :   std::istream(nullptr),
+        compression_(StreamCompression::NONE)
+    {}
+
+    InputFileStream::InputFileStream(const std::string & fileName)
+    :   InputFileStream()
+    {
+        if (IsStandardStream(fileName)) {
+            standardInput_ = std::make_unique<StandardInputBuffer>();
+            rdbuf(standardInput_.get());
+            exceptions(std::ios::badbit); // so that read errors are not silently turned into the end of the stream
+            return;
+        }
+        file_ = std::make_unique<std::filebuf>();
+        if (!file_->open(fileName, std::ios::in | std::ios::binary)) {
+            file_.reset();
+            setstate(std::ios::failbit);
+            return;
+        }
+        compression_ = detectCompression(*file_);
+        if (compression_ == StreamCompression::NONE) {
+            rdbuf(file_.get());
+        } else {
+            if (!IsStreamCompressionAvailable(compression_)) {
+                throw std::runtime_error("The file " + fileName + " is compressed with " + StreamCompressionName(compression_) + ", which is not available in this build of ParticleZoo.");
+            }
+            decompressor_ = std::make_unique<DecompressingStreamBuffer>(*file_, compression_);
+            rdbuf(decompressor_.get());
+        }
+        exceptions(std::ios::badbit); // so that errors in compressed data are not silently turned into the end of the file
+    }
+
+    InputFileStream::InputFileStream(InputFileStream && other)
+    :   std::istream(std::move(other)),
+        file_(std::move(other.file_)),
+        decompressor_(std::move(other.decompressor_)),
+        standardInput_(std::move(other.standardInput_)),
+        compression_(other.compression_)
+    {
+        set_rdbuf(currentBuffer());
+        other.set_rdbuf(nullptr);
+    }
+
+    InputFileStream & InputFileStream::operator=(InputFileStream && other) {
+        std::istream::operator=(std::move(other));
+        file_ = std::move(other.file_);
+        decompressor_ = std::move(other.decompressor_);
+        standardInput_ = std::move(other.standardInput_);
+        compression_ = other.compression_;
+        set_rdbuf(currentBuffer());
+        other.set_rdbuf(nullptr);
+        return *this;
+    }
+
+    InputFileStream::~InputFileStream() = default;
+
+    std::streambuf * InputFileStream::currentBuffer() const {
+        if (standardInput_) return standardInput_.get();
+        return decompressor_ ? decompressor_.get() : file_.get();
+    }
+
+    bool InputFileStream::is_open() const {
+        return (file_ && file_->is_open()) || standardInput_;
+    }
+
+    void InputFileStream::close() {
+        exceptions(std::ios::goodbit);
+        rdbuf(nullptr);
+        decompressor_.reset();
+        standardInput_.reset(); // standard input itself stays open for the rest of the program
+        if (file_) {
+            file_->close();
+            file_.reset();
+        }
+    }
+
+} // namespace ParticleZoo
@@ -0,0 +1,121 @@
+#include "particlezoo/utilities/memoryMap.h"
+
+#include <stdexcept>
+#include <limits>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace ParticleZoo
+{
+
+#if defined(_WIN32)
+
+    MemoryMappedFile::MemoryMappedFile(const std::string & fileName)
+    :   fileName_(fileName),
+        data_(nullptr),
+        size_(0),
+        fileHandle_(INVALID_HANDLE_VALUE),
+        mappingHandle_(nullptr)
+    {
+        HANDLE file = CreateFileA(fileName_.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file for memory mapping: " + fileName_);
+        }
+        fileHandle_ = file;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to determine file size for memory mapping: " + fileName_);
+        }
+        size_ = static_cast<std::uint64_t>(fileSize.QuadPart);
+        if (size_ == 0) return; // empty files cannot be mapped, but there is nothing to read anyway
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to create file mapping for: " + fileName_);
+        }
+        mappingHandle_ = mapping;
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map view of file: " + fileName_);
+        }
+        data_ = static_cast<const byte*>(view);
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        if (data_) UnmapViewOfFile(data_);
+        if (mappingHandle_) CloseHandle(static_cast<HANDLE>(mappingHandle_));
+        if (fileHandle_ != INVALID_HANDLE_VALUE) CloseHandle(static_cast<HANDLE>(fileHandle_));
+    }
+
+    void MemoryMappedFile::adviseSequential() const { }
+    void MemoryMappedFile::adviseRandom() const { }
+
+#else
+
+    MemoryMappedFile::MemoryMappedFile(const std::string & fileName)
+    :   fileName_(fileName),
+        data_(nullptr),
+        size_(0),
+        fileDescriptor_(-1)
+    {
+        fileDescriptor_ = ::open(fileName_.c_str(), O_RDONLY);
+        if (fileDescriptor_ < 0) {
+            throw std::runtime_error("Failed to open file for memory mapping: " + fileName_);
+        }
+
+        struct stat fileStatus;
+        if (::fstat(fileDescriptor_, &fileStatus) != 0) {
+            ::close(fileDescriptor_);
+            throw std::runtime_error("Failed to determine file size for memory mapping: " + fileName_);
+        }
+        size_ = static_cast<std::uint64_t>(fileStatus.st_size);
+        if (size_ == 0) return; // empty files cannot be mapped, but there is nothing to read anyway
+        if (size_ > std::numeric_limits<std::size_t>::max()) {
+            ::close(fileDescriptor_);
+            throw std::runtime_error("File is too large to be memory mapped on this platform: " + fileName_);
+        }
+
+        void* view = ::mmap(nullptr, static_cast<std::size_t>(size_), PROT_READ, MAP_SHARED, fileDescriptor_, 0);
+        if (view == MAP_FAILED) {
+            ::close(fileDescriptor_);
+            throw std::runtime_error("Failed to memory map file: " + fileName_);
+        }
+        data_ = static_cast<const byte*>(view);
+        adviseSequential();
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        if (data_) ::munmap(const_cast<byte*>(data_), static_cast<std::size_t>(size_));
+        if (fileDescriptor_ >= 0) ::close(fileDescriptor_);
+    }
+
+    void MemoryMappedFile::adviseSequential() const {
+        if (data_) ::madvise(const_cast<byte*>(data_), static_cast<std::size_t>(size_), MADV_SEQUENTIAL);
+    }
+
+    void MemoryMappedFile::adviseRandom() const {
+        if (data_) ::madvise(const_cast<byte*>(data_), static_cast<std::size_t>(size_), MADV_RANDOM);
+    }
+
+#endif
+
+} // namespace ParticleZoo
@@ -0,0 +1,157 @@
+#include "particlezoo/utilities/outputFileStream.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        constexpr std::size_t OUTPUT_BUFFER_SIZE = 1 << 17;
+
+        /**
+         * Writer of standard output in binary mode, which can only go forward.
+         */
+        class StandardOutputBuffer : public std::streambuf
+        {
+            public:
+                StandardOutputBuffer()
+                :   buffer_(OUTPUT_BUFFER_SIZE),
+                    bytesWritten_(0)
+                {
+                #ifdef _WIN32
+                    _setmode(_fileno(stdout), _O_BINARY); // no translation of line ends
+                #endif
+                    setp(buffer_.data(), buffer_.data() + buffer_.size());
+                }
+
+                ~StandardOutputBuffer() override {
+                    sync();
+                }
+
+            protected:
+                int_type overflow(int_type character) override {
+                    if (!flushBuffer()) return traits_type::eof();
+                    if (!traits_type::eq_int_type(character, traits_type::eof())) {
+                        *pptr() = traits_type::to_char_type(character);
+                        pbump(1);
+                    }
+                    return traits_type::not_eof(character);
+                }
+
+                std::streamsize xsputn(const char * source, std::streamsize count) override {
+                    // Small writes are gathered in the buffer, large ones go straight out after it
+                    if (count <= epptr() - pptr()) {
+                        std::memcpy(pptr(), source, static_cast<std::size_t>(count));
+                        pbump(static_cast<int>(count));
+                        return count;
+                    }
+                    if (!flushBuffer()) return 0;
+                    const std::size_t written = std::fwrite(source, 1, static_cast<std::size_t>(count), stdout);
+                    bytesWritten_ += written;
+                    return static_cast<std::streamsize>(written);
+                }
+
+                int sync() override {
+                    if (!flushBuffer()) return -1;
+                    return std::fflush(stdout) == 0 ? 0 : -1;
+                }
+
+                pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+                    // Only tellp() is supported
+                    if (!(which & std::ios_base::out) || direction != std::ios_base::cur || offset != 0) return pos_type(off_type(-1));
+                    return pos_type(static_cast<off_type>(bytesWritten_ + static_cast<std::uint64_t>(pptr() - pbase())));
+                }
+
+                pos_type seekpos(pos_type, std::ios_base::openmode) override {
+                    return pos_type(off_type(-1));
+                }
+
+            private:
+                bool flushBuffer() {
+                    const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+                    const std::size_t written = pending > 0 ? std::fwrite(pbase(), 1, pending, stdout) : 0;
+                    bytesWritten_ += written;
+                    setp(buffer_.data(), buffer_.data() + buffer_.size());
+                    return written == pending;
+                }
+
+                std::vector<char> buffer_;
+                std::uint64_t bytesWritten_;    // bytes handed to standard output so far
+        };
+    }
+
+
+    OutputFileStream::OutputFileStream()
+    :   std::ostream(nullptr)
+    {}
+
+    OutputFileStream::OutputFileStream(const std::string & fileName)
+    :   OutputFileStream()
+    {
+        if (IsStandardStream(fileName)) {
+            standardOutput_ = std::make_unique<StandardOutputBuffer>();
+            rdbuf(standardOutput_.get());
+            return;
+        }
+        file_ = std::make_unique<std::filebuf>();
+        if (!file_->open(fileName, std::ios::out | std::ios::trunc | std::ios::binary)) {
+            file_.reset();
+            setstate(std::ios::failbit);
+            return;
+        }
+        rdbuf(file_.get());
+    }
+
+    OutputFileStream::OutputFileStream(OutputFileStream && other)
+    :   std::ostream(std::move(other)),
+        file_(std::move(other.file_)),
+        standardOutput_(std::move(other.standardOutput_))
+    {
+        set_rdbuf(currentBuffer());
+        other.set_rdbuf(nullptr);
+    }
+
+    OutputFileStream & OutputFileStream::operator=(OutputFileStream && other) {
+        std::ostream::operator=(std::move(other));
+        file_ = std::move(other.file_);
+        standardOutput_ = std::move(other.standardOutput_);
+        set_rdbuf(currentBuffer());
+        other.set_rdbuf(nullptr);
+        return *this;
+    }
+
+    OutputFileStream::~OutputFileStream() = default;
+
+    std::streambuf * OutputFileStream::currentBuffer() const {
+        if (standardOutput_) return standardOutput_.get();
+        return file_.get();
+    }
+
+    bool OutputFileStream::is_open() const {
+        return (file_ && file_->is_open()) || standardOutput_;
+    }
+
+    void OutputFileStream::close() {
+        if (standardOutput_) {
+            if (standardOutput_->pubsync() != 0) setstate(std::ios::badbit);
+            rdbuf(nullptr);
+            standardOutput_.reset();
+            return;
+        }
+        if (file_) {
+            if (!file_->close()) setstate(std::ios::failbit);
+            rdbuf(nullptr);
+            file_.reset();
+        }
+    }
+
+} // namespace ParticleZoo
@@ -0,0 +1,119 @@
+#include "particlezoo/utilities/prefetch.h"
+
+#include <stdexcept>
+
+namespace ParticleZoo
+{
+
+    BlockPrefetcher::BlockPrefetcher(const std::string & fileName, std::uint64_t startOffset, std::uint64_t endOffset, std::size_t blockSize, std::size_t queueDepth)
+    :   fileName_(fileName),
+        blockSize_(blockSize),
+        queueDepth_(queueDepth),
+        file_(fileName, std::ios::binary),
+        nextOffset_(startOffset),
+        endOffset_(endOffset),
+        blocksInFlight_(0),
+        stopRequested_(false),
+        finished_(false)
+    {
+        if (blockSize_ == 0) {
+            throw std::runtime_error("Prefetch block size must be positive.");
+        }
+        if (queueDepth_ == 0) {
+            throw std::runtime_error("Prefetch queue depth must be positive.");
+        }
+        if (!file_.is_open()) {
+            throw std::runtime_error("Failed to open file for prefetching: " + fileName_);
+        }
+        file_.seekg(static_cast<std::streamoff>(startOffset), std::ios::beg);
+        if (file_.fail()) {
+            throw std::runtime_error("Failed to seek to prefetch start offset in file: " + fileName_);
+        }
+        worker_ = std::thread(&BlockPrefetcher::run, this);
+    }
+
+    BlockPrefetcher::~BlockPrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopRequested_ = true;
+        }
+        spaceAvailable_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    std::size_t BlockPrefetcher::appendNextBlock(ByteBuffer & destination) {
+        if (destination.remainingToWrite() < blockSize_) {
+            throw std::runtime_error("Not enough room in the buffer to append a prefetched block.");
+        }
+
+        ByteBuffer block(1);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            blockReady_.wait(lock, [this] { return !readyBlocks_.empty() || finished_ || error_; });
+            if (readyBlocks_.empty()) {
+                if (error_) std::rethrow_exception(error_);
+                return 0; // reached the end of the range
+            }
+            block = std::move(readyBlocks_.front());
+            readyBlocks_.pop_front();
+        }
+
+        std::size_t bytesAppended = destination.appendData(block, true);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            freeBlocks_.push_back(std::move(block));
+            blocksInFlight_--;
+        }
+        spaceAvailable_.notify_one();
+
+        return bytesAppended;
+    }
+
+    void BlockPrefetcher::run() {
+        try {
+            while (true) {
+                ByteBuffer block(1);
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    spaceAvailable_.wait(lock, [this] { return stopRequested_ || blocksInFlight_ < queueDepth_; });
+                    if (stopRequested_) return;
+                    if (nextOffset_ >= endOffset_) break;
+                    if (freeBlocks_.empty()) {
+                        block = ByteBuffer(blockSize_);
+                    } else {
+                        block = std::move(freeBlocks_.back());
+                        freeBlocks_.pop_back();
+                    }
+                    blocksInFlight_++;
+                }
+
+                // Read outside of the lock so that the consumer can keep taking blocks meanwhile
+                std::size_t bytesThisRead = block.setData(file_);
+                if (bytesThisRead == 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    freeBlocks_.push_back(std::move(block));
+                    blocksInFlight_--;
+                    break; // the file ended before the expected end of the range
+                }
+                nextOffset_ += bytesThisRead;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    readyBlocks_.push_back(std::move(block));
+                }
+                blockReady_.notify_one();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+        }
+        blockReady_.notify_all();
+    }
+
+} // namespace ParticleZoo
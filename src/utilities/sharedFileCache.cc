@@ -0,0 +1,168 @@
+#include "particlezoo/utilities/sharedFileCache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <fcntl.h>
+    #include <sys/file.h>
+    #include <unistd.h>
+#endif
+
+namespace ParticleZoo
+{
+
+    namespace {
+
+        namespace fs = std::filesystem;
+
+        struct FileIdentity
+        {
+            fs::path path;         // canonical path of the file
+            std::uint64_t size;
+            std::string key;       // path, size and modification time, telling apart the versions of a file
+        };
+
+        FileIdentity IdentifyFile(const std::string & fileName) {
+            std::error_code error;
+            FileIdentity identity;
+            identity.path = fs::canonical(fileName, error);
+            if (!error) identity.size = static_cast<std::uint64_t>(fs::file_size(identity.path, error));
+            fs::file_time_type modified{};
+            if (!error) modified = fs::last_write_time(identity.path, error);
+            if (error) {
+                throw std::runtime_error("Failed to open file for memory mapping: " + fileName + " (" + error.message() + ")");
+            }
+            identity.key = identity.path.string() + '\n' + std::to_string(identity.size) + '\n' + std::to_string(modified.time_since_epoch().count());
+            return identity;
+        }
+
+        // FNV-1a, only used to name the cached copies
+        std::uint64_t HashKey(const std::string & key) {
+            std::uint64_t hash = 0xCBF29CE484222325ULL;
+            for (const char character : key) {
+                hash ^= static_cast<unsigned char>(character);
+                hash *= 0x100000001B3ULL;
+            }
+            return hash;
+        }
+
+        // Mappings in use in the process, shared by every reader of the same file
+        std::mutex mappingsMutex;
+        std::unordered_map<std::string, std::weak_ptr<const MemoryMappedFile>> mappings;
+
+        std::shared_ptr<const MemoryMappedFile> FindMapping(const std::string & key) {
+            auto mapping = mappings.find(key);
+            return mapping != mappings.end() ? mapping->second.lock() : nullptr;
+        }
+
+        std::shared_ptr<const MemoryMappedFile> AddMapping(const std::string & key, const std::string & fileName) {
+            std::shared_ptr<const MemoryMappedFile> mapping = std::make_shared<const MemoryMappedFile>(fileName);
+            mappings[key] = mapping;
+            return mapping;
+        }
+
+        /**
+         * Exclusive lock held by one process of the node at a time, so that only one copies a
+         * file into the cache. Released by the system if the process dies.
+         */
+    #if defined(_WIN32)
+        class CacheLock
+        {
+            public:
+                explicit CacheLock(const fs::path &) {} // processes may copy the same file at once, the copy renamed last is kept
+        };
+    #else
+        class CacheLock
+        {
+            public:
+                explicit CacheLock(const fs::path & lockPath)
+                :   fileDescriptor_(::open(lockPath.c_str(), O_RDWR | O_CREAT, 0666))
+                {
+                    if (fileDescriptor_ < 0) {
+                        throw std::runtime_error("Failed to create the shared cache lock file: " + lockPath.string());
+                    }
+                    while (::flock(fileDescriptor_, LOCK_EX) != 0) {
+                        if (errno != EINTR) {
+                            ::close(fileDescriptor_);
+                            throw std::runtime_error("Failed to lock the shared cache lock file: " + lockPath.string());
+                        }
+                    }
+                }
+                ~CacheLock() { ::close(fileDescriptor_); }
+            private:
+                int fileDescriptor_;
+        };
+    #endif
+
+        void CopyIntoCache(const FileIdentity & identity, const fs::path & cachedPath) {
+        #if defined(_WIN32)
+            const int processId = _getpid();
+        #else
+            const int processId = static_cast<int>(::getpid());
+        #endif
+            const fs::path partialPath = cachedPath.string() + ".partial" + std::to_string(processId);
+            std::error_code error;
+            fs::copy_file(identity.path, partialPath, fs::copy_options::overwrite_existing, error);
+            if (!error && fs::file_size(partialPath, error) != identity.size && !error) {
+                error = std::make_error_code(std::errc::io_error);
+            }
+            if (!error) fs::rename(partialPath, cachedPath, error);
+            if (error) {
+                std::error_code ignored;
+                fs::remove(partialPath, ignored);
+                throw std::runtime_error("Failed to copy " + identity.path.string() + " into the shared cache at " + cachedPath.string() + " (" + error.message() + ")");
+            }
+        }
+
+        bool IsCached(const fs::path & cachedPath, std::uint64_t size) {
+            std::error_code error;
+            return fs::is_regular_file(cachedPath, error) && fs::file_size(cachedPath, error) == size && !error;
+        }
+
+    }
+
+    std::shared_ptr<const MemoryMappedFile> MapSharedFile(const std::string & fileName) {
+        const FileIdentity identity = IdentifyFile(fileName);
+        std::lock_guard<std::mutex> lock(mappingsMutex);
+        if (std::shared_ptr<const MemoryMappedFile> mapping = FindMapping(identity.key)) return mapping;
+        return AddMapping(identity.key, identity.path.string());
+    }
+
+    std::shared_ptr<const MemoryMappedFile> MapCachedFile(const std::string & fileName, const std::string & cacheDirectory) {
+        const FileIdentity identity = IdentifyFile(fileName);
+        const fs::path directory = cacheDirectory.empty() ? fs::path(GetDefaultSharedCacheDirectory()) : fs::path(cacheDirectory);
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(HashKey(identity.key)));
+        const fs::path cachedPath = directory / ("particlezoo-" + std::string(hash) + "-" + identity.path.filename().string());
+        const std::string key = "cache\n" + cachedPath.string() + '\n' + identity.key;
+
+        // Threads of the process wait for one another here, processes of the node at the lock file
+        std::lock_guard<std::mutex> lock(mappingsMutex);
+        if (std::shared_ptr<const MemoryMappedFile> mapping = FindMapping(key)) return mapping;
+        if (!IsCached(cachedPath, identity.size)) {
+            std::error_code error;
+            fs::create_directories(directory, error);
+            CacheLock cacheLock(cachedPath.string() + ".lock");
+            if (!IsCached(cachedPath, identity.size)) CopyIntoCache(identity, cachedPath);
+        }
+        return AddMapping(key, cachedPath.string());
+    }
+
+    std::string GetDefaultSharedCacheDirectory() {
+        std::error_code error;
+        if (fs::is_directory("/dev/shm", error)) return "/dev/shm";
+        const fs::path temporary = fs::temp_directory_path(error);
+        if (error) throw std::runtime_error("No directory for the shared cache, set one explicitly.");
+        return temporary.string();
+    }
+
+} // namespace ParticleZoo
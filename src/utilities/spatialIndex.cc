@@ -0,0 +1,210 @@
+#include "particlezoo/utilities/spatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#include "particlezoo/ByteBuffer.h"
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        constexpr char INDEX_MAGIC[] = "PZSIDX01";
+        constexpr std::size_t INDEX_MAGIC_LENGTH = sizeof(INDEX_MAGIC) - 1;
+        constexpr std::size_t INDEX_HEADER_SIZE = INDEX_MAGIC_LENGTH + 4 * sizeof(std::uint64_t) + 4 * sizeof(float);
+        constexpr std::size_t TILE_SIZE = sizeof(std::uint32_t) + 3 * sizeof(std::uint64_t) + 4 * sizeof(float);
+        constexpr std::size_t RECORD_RANGE_SIZE = 3 * sizeof(std::uint64_t);
+        constexpr ByteOrder INDEX_BYTE_ORDER = ByteOrder::LittleEndian; // same on every platform so the sidecar can be shared
+
+        // The size and modification time of a phase space file, used to detect a stale index
+        std::pair<std::uint64_t, std::int64_t> GetFileSignature(const std::string & fileName) {
+            const std::filesystem::path path(fileName);
+            std::uint64_t fileSize = static_cast<std::uint64_t>(std::filesystem::file_size(path));
+            std::int64_t modificationTime = static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+            return { fileSize, modificationTime };
+        }
+
+        // Make sure the next bytes to read are in a buffer refilled from a file
+        void EnsureReadable(std::ifstream & file, ByteBuffer & items, std::size_t size) {
+            while (items.remainingToRead() < size) {
+                items.compact();
+                items.appendData(file); // throws once the file ends
+            }
+        }
+
+        // Make room for the next bytes to write in a buffer flushed to a file
+        void EnsureWritable(std::ofstream & file, ByteBuffer & items, std::size_t size) {
+            if (items.remainingToWrite() < size) {
+                file.write(reinterpret_cast<const char*>(items.data()), static_cast<std::streamsize>(items.length()));
+                items.clear();
+            }
+        }
+
+        // The cell of a position along one axis of a grid, positions outside of the axis going to the cell at its closest end
+        std::uint32_t GetCell(float position, float minimum, float maximum, std::uint32_t cells) {
+            if (!(maximum > minimum)) return 0;
+            const double cell = std::floor((static_cast<double>(position) - minimum) / (static_cast<double>(maximum) - minimum) * cells);
+            if (!(cell > 0)) return 0; // NaN positions included
+            if (cell >= cells) return cells - 1;
+            return static_cast<std::uint32_t>(cell);
+        }
+    }
+
+    std::uint32_t SpatialGrid::getTile(float x, float y) const {
+        const std::uint32_t cells = getTilesPerSide();
+        return MortonCode(GetCell(x, minX, maxX, cells), GetCell(y, minY, maxY, cells));
+    }
+
+    SpatialIndex::SpatialIndex(const SpatialGrid & grid, std::vector<SpatialTile> tiles)
+    :   grid_(grid),
+        tiles_(std::move(tiles))
+    {
+        if (grid_.level > SpatialGrid::MAXIMUM_LEVEL) {
+            throw std::invalid_argument("Spatial index grid level " + std::to_string(grid_.level) + " is above the maximum of " + std::to_string(SpatialGrid::MAXIMUM_LEVEL) + ".");
+        }
+        for (std::size_t i = 1; i < tiles_.size(); i++) {
+            if (tiles_[i - 1].tile >= tiles_[i].tile) {
+                throw std::invalid_argument("Spatial index tiles must be in increasing order of their Morton codes.");
+            }
+        }
+    }
+
+    std::optional<SpatialIndex> SpatialIndex::Load(const std::string & phspFileName) {
+        const std::string indexFileName = GetIndexFileName(phspFileName);
+        std::error_code error;
+        if (!std::filesystem::exists(indexFileName, error) || !std::filesystem::exists(phspFileName, error)) {
+            return std::nullopt;
+        }
+
+        // A sidecar that cannot be read in full is treated the same as a missing one
+        try {
+            std::ifstream file(indexFileName, std::ios::binary);
+            if (!file.is_open()) return std::nullopt;
+
+            ByteBuffer header(INDEX_HEADER_SIZE, INDEX_BYTE_ORDER);
+            if (header.setData(file) != INDEX_HEADER_SIZE) return std::nullopt;
+            if (header.readString(INDEX_MAGIC_LENGTH) != std::string(INDEX_MAGIC, INDEX_MAGIC_LENGTH)) return std::nullopt;
+
+            const std::uint64_t fileSize = header.read<std::uint64_t>();
+            const std::int64_t modificationTime = header.read<std::int64_t>();
+            if (std::make_pair(fileSize, modificationTime) != GetFileSignature(phspFileName)) {
+                return std::nullopt; // the phase space file has changed since the index was built
+            }
+
+            SpatialGrid grid;
+            grid.level = static_cast<unsigned int>(header.read<std::uint64_t>());
+            grid.minX = header.read<float>();
+            grid.maxX = header.read<float>();
+            grid.minY = header.read<float>();
+            grid.maxY = header.read<float>();
+            const std::uint64_t numberOfTiles = header.read<std::uint64_t>();
+            if (grid.level > SpatialGrid::MAXIMUM_LEVEL) return std::nullopt;
+
+            // Each tile is followed by its record ranges
+            std::vector<SpatialTile> tiles(static_cast<std::size_t>(numberOfTiles));
+            ByteBuffer items(DEFAULT_BUFFER_SIZE, INDEX_BYTE_ORDER);
+            for (SpatialTile & tile : tiles) {
+                EnsureReadable(file, items, TILE_SIZE);
+                tile.tile = items.read<std::uint32_t>();
+                tile.numberOfHistories = items.read<std::uint64_t>();
+                tile.numberOfRecords = items.read<std::uint64_t>();
+                tile.minX = items.read<float>();
+                tile.maxX = items.read<float>();
+                tile.minY = items.read<float>();
+                tile.maxY = items.read<float>();
+                tile.recordRanges.resize(static_cast<std::size_t>(items.read<std::uint64_t>()));
+                for (RecordRange & range : tile.recordRanges) {
+                    EnsureReadable(file, items, RECORD_RANGE_SIZE);
+                    range.firstRecord = items.read<std::uint64_t>();
+                    range.numberOfRecords = items.read<std::uint64_t>();
+                    range.numberOfHistories = items.read<std::uint64_t>();
+                }
+            }
+
+            return SpatialIndex(grid, std::move(tiles));
+        } catch (const std::exception &) {
+            return std::nullopt;
+        }
+    }
+
+    void SpatialIndex::save(const std::string & phspFileName) const {
+        if (!std::filesystem::exists(phspFileName)) {
+            throw std::runtime_error("Cannot save spatial index, phase space file does not exist: " + phspFileName);
+        }
+        const auto [fileSize, modificationTime] = GetFileSignature(phspFileName);
+
+        const std::string indexFileName = GetIndexFileName(phspFileName);
+        std::ofstream file(indexFileName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open spatial index file for writing: " + indexFileName);
+        }
+
+        ByteBuffer buffer(DEFAULT_BUFFER_SIZE, INDEX_BYTE_ORDER);
+        buffer.writeString(std::string(INDEX_MAGIC, INDEX_MAGIC_LENGTH));
+        buffer.write<std::uint64_t>(fileSize);
+        buffer.write<std::int64_t>(modificationTime);
+        buffer.write<std::uint64_t>(grid_.level);
+        buffer.write<float>(grid_.minX);
+        buffer.write<float>(grid_.maxX);
+        buffer.write<float>(grid_.minY);
+        buffer.write<float>(grid_.maxY);
+        buffer.write<std::uint64_t>(static_cast<std::uint64_t>(tiles_.size()));
+
+        for (const SpatialTile & tile : tiles_) {
+            EnsureWritable(file, buffer, TILE_SIZE);
+            buffer.write<std::uint32_t>(tile.tile);
+            buffer.write<std::uint64_t>(tile.numberOfHistories);
+            buffer.write<std::uint64_t>(tile.numberOfRecords);
+            buffer.write<float>(tile.minX);
+            buffer.write<float>(tile.maxX);
+            buffer.write<float>(tile.minY);
+            buffer.write<float>(tile.maxY);
+            buffer.write<std::uint64_t>(static_cast<std::uint64_t>(tile.recordRanges.size()));
+            for (const RecordRange & range : tile.recordRanges) {
+                EnsureWritable(file, buffer, RECORD_RANGE_SIZE);
+                buffer.write<std::uint64_t>(range.firstRecord);
+                buffer.write<std::uint64_t>(range.numberOfRecords);
+                buffer.write<std::uint64_t>(range.numberOfHistories);
+            }
+        }
+        file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.length()));
+
+        file.close();
+        if (file.fail()) {
+            throw std::runtime_error("Failed to write spatial index file: " + indexFileName);
+        }
+    }
+
+    std::uint64_t SpatialIndex::getNumberOfRecordRanges() const {
+        std::uint64_t numberOfRanges = 0;
+        for (const SpatialTile & tile : tiles_) numberOfRanges += tile.recordRanges.size();
+        return numberOfRanges;
+    }
+
+    std::vector<RecordRange> SpatialIndex::findRecordRanges(float minX, float maxX, float minY, float maxY) const {
+        std::vector<RecordRange> ranges;
+        for (const SpatialTile & tile : tiles_) {
+            if (tile.maxX < minX || tile.minX > maxX || tile.maxY < minY || tile.minY > maxY) continue;
+            ranges.insert(ranges.end(), tile.recordRanges.begin(), tile.recordRanges.end());
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const RecordRange & a, const RecordRange & b) { return a.firstRecord < b.firstRecord; });
+
+        // Join the ranges of histories that follow one another in the file
+        std::vector<RecordRange> joinedRanges;
+        for (const RecordRange & range : ranges) {
+            if (!joinedRanges.empty() && joinedRanges.back().firstRecord + joinedRanges.back().numberOfRecords == range.firstRecord) {
+                joinedRanges.back().numberOfRecords += range.numberOfRecords;
+                joinedRanges.back().numberOfHistories += range.numberOfHistories;
+            } else {
+                joinedRanges.push_back(range);
+            }
+        }
+        return joinedRanges;
+    }
+
+} // namespace ParticleZoo
@@ -0,0 +1,218 @@
+#include "particlezoo/utilities/threadAffinity.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <fstream>
+    #include <sched.h>
+#endif
+
+namespace ParticleZoo
+{
+
+    namespace
+    {
+        // Every CPU from 0 to the number of hardware threads, when nothing more is known
+        std::vector<unsigned int> GetHardwareCPUs() {
+            std::vector<unsigned int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+            for (unsigned int i = 0; i < cpus.size(); i++) cpus[i] = i;
+            return cpus;
+        }
+
+#if defined(_WIN32)
+        constexpr unsigned int CPUS_PER_GROUP = sizeof(KAFFINITY) * 8;
+
+        std::vector<unsigned int> GetGroupCPUs(const GROUP_AFFINITY & affinity) {
+            std::vector<unsigned int> cpus;
+            for (unsigned int bit = 0; bit < CPUS_PER_GROUP; bit++) {
+                if (affinity.Mask & (KAFFINITY{1} << bit)) cpus.push_back(affinity.Group * CPUS_PER_GROUP + bit);
+            }
+            return cpus;
+        }
+
+        // The CPUs given that are in the processor group of the first of them
+        GROUP_AFFINITY GetGroupAffinity(const std::vector<unsigned int> & cpus) {
+            GROUP_AFFINITY affinity{};
+            affinity.Group = static_cast<WORD>(cpus.front() / CPUS_PER_GROUP);
+            for (unsigned int cpu : cpus) {
+                if (cpu / CPUS_PER_GROUP == affinity.Group) affinity.Mask |= KAFFINITY{1} << (cpu % CPUS_PER_GROUP);
+            }
+            return affinity;
+        }
+#elif defined(__linux__)
+        constexpr char NODE_DIRECTORY[] = "/sys/devices/system/node/";
+
+        // Parse a list of CPUs or nodes in the format of the kernel, such as "0-3,8,10-11"
+        std::vector<unsigned int> ParseList(const std::string & list) {
+            std::vector<unsigned int> values;
+            std::size_t position = 0;
+            while (position < list.size()) {
+                std::size_t end = list.find(',', position);
+                if (end == std::string::npos) end = list.size();
+                const std::string range = list.substr(position, end - position);
+                position = end + 1;
+                if (range.empty()) continue;
+                try {
+                    const std::size_t dash = range.find('-');
+                    const unsigned long first = std::stoul(range.substr(0, dash));
+                    const unsigned long last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                    for (unsigned long value = first; value <= last; value++) values.push_back(static_cast<unsigned int>(value));
+                } catch (const std::exception &) {
+                    return {}; // not a list after all
+                }
+            }
+            return values;
+        }
+
+        // Read the list in a file of the node directory, empty if there is no such file
+        std::vector<unsigned int> ReadList(const std::string & fileName) {
+            std::ifstream file(NODE_DIRECTORY + fileName);
+            std::string list;
+            if (!file.is_open() || !std::getline(file, list)) return {};
+            return ParseList(list);
+        }
+
+        std::vector<unsigned int> GetCPUs(const cpu_set_t & set) {
+            std::vector<unsigned int> cpus;
+            for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+            return cpus;
+        }
+
+        cpu_set_t GetCPUSet(const std::vector<unsigned int> & cpus) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (unsigned int cpu : cpus) {
+                if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            return set;
+        }
+#endif
+    }
+
+    std::vector<unsigned int> GetAllowedCPUs() {
+#if defined(_WIN32)
+        std::vector<unsigned int> cpus;
+        const WORD numberOfGroups = GetActiveProcessorGroupCount();
+        for (WORD group = 0; group < numberOfGroups; group++) {
+            const DWORD cpusInGroup = GetActiveProcessorCount(group);
+            for (DWORD i = 0; i < cpusInGroup; i++) cpus.push_back(group * CPUS_PER_GROUP + i);
+        }
+        return cpus.empty() ? GetHardwareCPUs() : cpus;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) return GetHardwareCPUs();
+        std::vector<unsigned int> cpus = GetCPUs(set);
+        return cpus.empty() ? GetHardwareCPUs() : cpus;
+#else
+        return GetHardwareCPUs();
+#endif
+    }
+
+    std::vector<unsigned int> GetNUMANodeCPUs(unsigned int node) {
+#if defined(_WIN32)
+        GROUP_AFFINITY affinity{};
+        if (node > 0xFFFF || !GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+            return node == 0 ? GetAllowedCPUs() : std::vector<unsigned int>{};
+        }
+        return GetGroupCPUs(affinity);
+#elif defined(__linux__)
+        const std::vector<unsigned int> allowedCPUs = GetAllowedCPUs();
+        if (ReadList("online").empty()) {
+            return node == 0 ? allowedCPUs : std::vector<unsigned int>{}; // no NUMA support in the kernel
+        }
+        std::vector<unsigned int> cpus;
+        for (unsigned int cpu : ReadList("node" + std::to_string(node) + "/cpulist")) {
+            if (std::binary_search(allowedCPUs.begin(), allowedCPUs.end(), cpu)) cpus.push_back(cpu);
+        }
+        return cpus;
+#else
+        return node == 0 ? GetAllowedCPUs() : std::vector<unsigned int>{};
+#endif
+    }
+
+    std::vector<unsigned int> GetNUMANodes() {
+        std::vector<unsigned int> candidates;
+#if defined(_WIN32)
+        ULONG highestNode = 0;
+        if (GetNumaHighestNodeNumber(&highestNode)) {
+            for (unsigned int node = 0; node <= highestNode; node++) candidates.push_back(node);
+        }
+#elif defined(__linux__)
+        candidates = ReadList("online");
+#endif
+        // Nodes without CPUs the process may use, such as memory-only nodes, are left out
+        std::vector<unsigned int> nodes;
+        for (unsigned int node : candidates) {
+            if (!GetNUMANodeCPUs(node).empty()) nodes.push_back(node);
+        }
+        return nodes.empty() ? std::vector<unsigned int>{ 0 } : nodes;
+    }
+
+#if defined(_WIN32)
+
+    ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<unsigned int> & cpus)
+    :   applied_(false),
+        kept_(false)
+    {
+        if (cpus.empty()) return;
+        const GROUP_AFFINITY affinity = GetGroupAffinity(cpus);
+        GROUP_AFFINITY previousAffinity{};
+        if (SetThreadGroupAffinity(GetCurrentThread(), &affinity, &previousAffinity)) {
+            previousCPUs_ = GetGroupCPUs(previousAffinity);
+            applied_ = true;
+        }
+    }
+
+    ScopedThreadAffinity::~ScopedThreadAffinity() {
+        if (!applied_ || kept_ || previousCPUs_.empty()) return;
+        const GROUP_AFFINITY previousAffinity = GetGroupAffinity(previousCPUs_);
+        SetThreadGroupAffinity(GetCurrentThread(), &previousAffinity, nullptr);
+    }
+
+#elif defined(__linux__)
+
+    ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<unsigned int> & cpus)
+    :   applied_(false),
+        kept_(false)
+    {
+        if (cpus.empty()) return;
+        cpu_set_t previousSet;
+        CPU_ZERO(&previousSet);
+        if (sched_getaffinity(0, sizeof(previousSet), &previousSet) != 0) return;
+        const cpu_set_t set = GetCPUSet(cpus);
+        if (CPU_COUNT(&set) == 0 || sched_setaffinity(0, sizeof(set), &set) != 0) return; // the CPUs may be outside of the cpuset of the process
+        previousCPUs_ = GetCPUs(previousSet);
+        applied_ = true;
+    }
+
+    ScopedThreadAffinity::~ScopedThreadAffinity() {
+        if (!applied_ || kept_) return;
+        const cpu_set_t previousSet = GetCPUSet(previousCPUs_);
+        sched_setaffinity(0, sizeof(previousSet), &previousSet);
+    }
+
+#else
+
+    ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<unsigned int> &)
+    :   applied_(false),
+        kept_(false)
+    { }
+
+    ScopedThreadAffinity::~ScopedThreadAffinity() { }
+
+#endif
+
+} // namespace ParticleZoo
@@ -0,0 +1,652 @@
+#include "particlezoo/utilities/transcoders.h"
+
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "particlezoo/PhaseSpaceFileReader.h"
+#include "particlezoo/PhaseSpaceFileWriter.h"
+#include "particlezoo/PDGParticleCodes.h"
+#include "particlezoo/egs/egsphspFile.h"
+#include "particlezoo/egs/EGSLATCH.h"
+#include "particlezoo/IAEA/IAEAphspFile.h"
+#include "particlezoo/TOPAS/TOPASphspFile.h"
+#include "particlezoo/utilities/simd.h"
+#include "particlezoo/utilities/units.h"
+
+namespace ParticleZoo
+{
+
+    namespace {
+
+        // The basic property columns of a batch of particles
+        struct ParticleColumns
+        {
+            ParticleType * types;
+            float * energies;
+            float * xs;
+            float * ys;
+            float * zs;
+            float * us;
+            float * vs;
+            float * ws;
+            float * weights;
+            std::uint8_t * isNewHistory;
+            std::uint32_t * incrementalHistories;
+        };
+
+        ParticleColumns ResizeColumns(ParticleBlock & particles, std::size_t size)
+        {
+            particles.resize(size);
+            return { particles.getTypes().data(), particles.getKineticEnergies().data(),
+                     particles.getXPositions().data(), particles.getYPositions().data(), particles.getZPositions().data(),
+                     particles.getDirectionalCosinesX().data(), particles.getDirectionalCosinesY().data(), particles.getDirectionalCosinesZ().data(),
+                     particles.getWeights().data(), particles.getNewHistoryFlags().data(), particles.getIncrementalHistories().data() };
+        }
+
+        // The LATCH ExtractLATCHFromParticle() makes for a particle without any LATCH related properties
+        unsigned int ConstructLATCH(ParticleType type, EGSphspFile::EGSLATCHOPTION latchOption)
+        {
+            unsigned int LATCH = 0;
+            if (type == ParticleType::Electron) LATCH |= (1u << 29);
+            else if (type == ParticleType::Positron) LATCH |= (2u << 29);
+            if (latchOption == EGSphspFile::EGSLATCHOPTION::LATCH_OPTION_2 || latchOption == EGSphspFile::EGSLATCHOPTION::LATCH_OPTION_3) {
+                LATCH |= (1u << 24); // without a generation the particle counts as a secondary
+            }
+            return LATCH;
+        }
+
+        // Where the fields of an IAEA record are, worked out once from its header
+        struct IAEARecordLayout
+        {
+            static constexpr std::size_t NOT_STORED = std::numeric_limits<std::size_t>::max();
+
+            explicit IAEARecordLayout(const IAEAphspFile::IAEAHeader & header)
+            : wIsStored(header.wIsStored()),
+              constantX(header.xIsStored() ? 0.f : header.getConstantX()),
+              constantY(header.yIsStored() ? 0.f : header.getConstantY()),
+              constantZ(header.zIsStored() ? 0.f : header.getConstantZ()),
+              constantU(header.uIsStored() ? 0.f : header.getConstantU()),
+              constantV(header.vIsStored() ? 0.f : header.getConstantV()),
+              constantW(header.wIsStored() ? 0.f : header.getConstantW()),
+              constantWeight(header.weightIsStored() ? 0.f : header.getConstantWeight())
+            {
+                // The type code and energy come first, followed by the stored basic properties and the extra floats and longs
+                std::size_t offset = sizeof(signed_byte) + sizeof(float);
+                auto place = [&offset](bool isStored) {
+                    if (!isStored) return NOT_STORED;
+                    offset += sizeof(float);
+                    return offset - sizeof(float);
+                };
+                xOffset = place(header.xIsStored());
+                yOffset = place(header.yIsStored());
+                zOffset = place(header.zIsStored());
+                uOffset = place(header.uIsStored());
+                vOffset = place(header.vIsStored());
+                weightOffset = place(header.weightIsStored());
+
+                extraFloatsOffset = offset;
+                for (unsigned int i = 0; i < header.getNumberOfExtraFloats(); i++) extraFloatTypes.push_back(header.getExtraFloatType(i));
+                offset += extraFloatTypes.size() * sizeof(float);
+
+                extraLongsOffset = offset;
+                for (unsigned int i = 0; i < header.getNumberOfExtraLongs(); i++) extraLongTypes.push_back(header.getExtraLongType(i));
+                offset += extraLongTypes.size() * sizeof(std::int32_t);
+
+                recordLength = offset;
+                matchesHeader = recordLength == header.getRecordLength();
+            }
+
+            // The offset of the last extra float of a type, whose value is the one a reader keeps
+            std::size_t extraFloatOffset(IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE type) const
+            {
+                std::size_t found = NOT_STORED;
+                for (std::size_t i = 0; i < extraFloatTypes.size(); i++) {
+                    if (extraFloatTypes[i] == type) found = extraFloatsOffset + i * sizeof(float);
+                }
+                return found;
+            }
+
+            // The offset of the last extra long of a type, whose value is the one a reader keeps
+            std::size_t extraLongOffset(IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE type) const
+            {
+                std::size_t found = NOT_STORED;
+                for (std::size_t i = 0; i < extraLongTypes.size(); i++) {
+                    if (extraLongTypes[i] == type) found = extraLongsOffset + i * sizeof(std::int32_t);
+                }
+                return found;
+            }
+
+            // True if any extra long holds one of the PENELOPE ILB values, which are not mapped by the transcoders
+            bool hasPenelopeILBs() const
+            {
+                for (IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE type : extraLongTypes) {
+                    switch (type) {
+                        case IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB1:
+                        case IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB2:
+                        case IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB3:
+                        case IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB4:
+                        case IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::PENELOPE_ILB5:
+                            return true;
+                        default:
+                            break;
+                    }
+                }
+                return false;
+            }
+
+            // Gather a basic property into its column, or fill the column with its constant value
+            void gather(const ByteBuffer & records, std::size_t fieldOffset, float constant, float units, float * values, std::size_t count) const
+            {
+                if (fieldOffset == NOT_STORED) {
+                    for (std::size_t i = 0; i < count; i++) values[i] = constant;
+                    return;
+                }
+                records.peekColumn(std::span<float>(values, count), fieldOffset, recordLength);
+                for (std::size_t i = 0; i < count; i++) values[i] *= units;
+            }
+
+            std::size_t xOffset, yOffset, zOffset, uOffset, vOffset, weightOffset;
+            bool wIsStored;
+            float constantX, constantY, constantZ, constantU, constantV, constantW, constantWeight;
+            std::vector<IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE> extraFloatTypes;
+            std::vector<IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE> extraLongTypes;
+            std::size_t extraFloatsOffset;
+            std::size_t extraLongsOffset;
+            std::size_t recordLength;
+            bool matchesHeader;
+        };
+
+        // Encode the particles of a batch as IAEA records, as IAEAphspFile::Writer::writeBinaryParticle() does
+        void WriteIAEARecords(ByteBuffer & output, const IAEARecordLayout & layout, const ParticleColumns & particles, std::size_t count,
+                              std::span<const std::uint32_t> LATCHes, std::span<const float> ZLASTs)
+        {
+            constexpr float inverseEnergyUnits = 1.f / MeV;
+            constexpr float inverseDistanceUnits = 1.f / cm;
+            for (std::size_t i = 0; i < count; i++) {
+                signed_byte typeCode;
+                switch (particles.types[i]) {
+                    case ParticleType::Photon: typeCode = 1; break;
+                    case ParticleType::Electron: typeCode = 2; break;
+                    case ParticleType::Positron: typeCode = 3; break;
+                    case ParticleType::Neutron: typeCode = 4; break;
+                    default: typeCode = 5; break; // protons, the transcoders stop at any other type
+                }
+                if (particles.ws[i] < 0.f) typeCode = -typeCode; // the sign of the type code is that of w
+
+                float kineticEnergy = particles.energies[i] * inverseEnergyUnits;
+                if (particles.isNewHistory[i]) kineticEnergy *= -1.f;
+
+                output.write<signed_byte>(typeCode);
+                output.write<float>(kineticEnergy);
+                if (layout.xOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.xs[i] * inverseDistanceUnits);
+                if (layout.yOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.ys[i] * inverseDistanceUnits);
+                if (layout.zOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.zs[i] * inverseDistanceUnits);
+                if (layout.uOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.us[i]);
+                if (layout.vOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.vs[i]);
+                if (layout.weightOffset != IAEARecordLayout::NOT_STORED) output.write<float>(particles.weights[i]);
+
+                for (IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE type : layout.extraFloatTypes) {
+                    output.write<float>(type == IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE::ZLAST && !ZLASTs.empty() ? ZLASTs[i] : 0.f);
+                }
+                for (IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE type : layout.extraLongTypes) {
+                    std::int32_t value = 0;
+                    if (type == IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::EGS_LATCH) value = static_cast<std::int32_t>(LATCHes[i]);
+                    else if (type == IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER) value = static_cast<std::int32_t>(particles.incrementalHistories[i]);
+                    output.write<std::int32_t>(value);
+                }
+            }
+        }
+
+        /*
+         * EGS (MODE0 or MODE2) records to IAEA records. The LATCH is copied into an EGS_LATCH extra
+         * long, the charge bits give the type code, the rest mass is taken off the total energy of
+         * charged particles and the sign of w moves from the weight to the type code.
+         */
+        class EGSToIAEATranscoder : public RecordTranscoder
+        {
+        public:
+            EGSToIAEATranscoder(const EGSphspFile::Reader & reader, const IAEARecordLayout & output)
+            : hasZLAST_(reader.getMode() == EGSphspFile::EGSMODE::MODE2), particleZ_(reader.getFixedValues().constantZ), output_(output) {}
+
+            std::size_t transcodeRecords(ByteBuffer & records, std::size_t recordLength, std::size_t numberOfRecords, ByteBuffer & output, ParticleBlock & particles) override
+            {
+                ParticleColumns p = ResizeColumns(particles, numberOfRecords);
+                LATCHes_.resize(numberOfRecords);
+                ZLASTs_.resize(hasZLAST_ ? numberOfRecords : 0);
+
+                records.peekColumn(std::span<std::uint32_t>(LATCHes_), 0, recordLength);
+                records.peekColumn(std::span<float>(p.energies, numberOfRecords), 4, recordLength);
+                records.peekColumn(std::span<float>(p.xs, numberOfRecords), 8, recordLength);
+                records.peekColumn(std::span<float>(p.ys, numberOfRecords), 12, recordLength);
+                records.peekColumn(std::span<float>(p.us, numberOfRecords), 16, recordLength);
+                records.peekColumn(std::span<float>(p.vs, numberOfRecords), 20, recordLength);
+                records.peekColumn(std::span<float>(p.weights, numberOfRecords), 24, recordLength);
+                if (hasZLAST_) records.peekColumn(std::span<float>(ZLASTs_), 28, recordLength);
+
+                // The same passes as EGSphspFile::Reader::readBinaryParticleBlock()
+                CalcThirdUnitComponents(p.us, p.vs, p.ws, numberOfRecords);
+                for (std::size_t i = 0; i < numberOfRecords; i++) {
+                    p.xs[i] *= cm;
+                    p.ys[i] *= cm;
+                    p.zs[i] = particleZ_;
+                    const bool wSignIsNegative = p.weights[i] < 0;
+                    p.ws[i] = wSignIsNegative ? -p.ws[i] : p.ws[i];
+                    p.weights[i] = wSignIsNegative ? -p.weights[i] : p.weights[i];
+                    const bool newHistory = p.energies[i] < 0;
+                    p.energies[i] = newHistory ? -p.energies[i] : p.energies[i];
+                    p.isNewHistory[i] = newHistory ? 1 : 0;
+                    p.incrementalHistories[i] = newHistory ? 1 : 0;
+                }
+                for (float & ZLAST : ZLASTs_) ZLAST *= cm;
+                NormalizeDirectionalCosines(p.us, p.vs, p.ws, numberOfRecords);
+
+                // Stop at invalid charge bits, which the reader reports
+                std::size_t count = 0;
+                for (; count < numberOfRecords; count++) {
+                    const unsigned int chargeBits = (LATCHes_[count] >> 29) & 3;
+                    if (chargeBits == 3) break;
+                    if (chargeBits == 0) {
+                        p.types[count] = ParticleType::Photon;
+                    } else {
+                        p.types[count] = chargeBits == 1 ? ParticleType::Electron : ParticleType::Positron;
+                        p.energies[count] -= EGSphspFile::ELECTRON_REST_MASS_MEV; // Convert to kinetic energy
+                    }
+                    p.energies[count] *= MeV;
+                }
+
+                WriteIAEARecords(output, output_, p, count, LATCHes_, ZLASTs_);
+                particles.resize(count);
+                return count;
+            }
+
+        private:
+            const bool hasZLAST_;
+            const float particleZ_;
+            const IAEARecordLayout output_;
+            std::vector<std::uint32_t> LATCHes_;
+            std::vector<float> ZLASTs_;
+        };
+
+        /*
+         * IAEA records to EGS (MODE0 or MODE2) records. An EGS_LATCH extra long is copied into the
+         * LATCH, which is otherwise made from the particle type, a ZLAST extra float fills the ZLAST
+         * of MODE2 records and the sign of w moves from the type code to the weight.
+         */
+        class IAEAToEGSTranscoder : public RecordTranscoder
+        {
+        public:
+            IAEAToEGSTranscoder(const IAEARecordLayout & input, const EGSphspFile::Writer & writer)
+            : input_(input),
+              LATCHOffset_(input.extraLongOffset(IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::EGS_LATCH)),
+              incrementalHistoryOffset_(input.extraLongOffset(IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER)),
+              ZLASTOffset_(writer.getMode() == EGSphspFile::EGSMODE::MODE2 ? input.extraFloatOffset(IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE::ZLAST) : IAEARecordLayout::NOT_STORED),
+              latchOption_(writer.getLATCHOption()) {}
+
+            std::size_t transcodeRecords(ByteBuffer & records, std::size_t recordLength, std::size_t numberOfRecords, ByteBuffer & output, ParticleBlock & particles) override
+            {
+                ParticleColumns p = ResizeColumns(particles, numberOfRecords);
+                typeCodes_.resize(numberOfRecords);
+                records.peekColumn(std::span<signed_byte>(typeCodes_), 0, recordLength);
+                records.peekColumn(std::span<float>(p.energies, numberOfRecords), 1, recordLength);
+                input_.gather(records, input_.xOffset, input_.constantX, cm, p.xs, numberOfRecords);
+                input_.gather(records, input_.yOffset, input_.constantY, cm, p.ys, numberOfRecords);
+                input_.gather(records, input_.zOffset, input_.constantZ, cm, p.zs, numberOfRecords);
+                input_.gather(records, input_.uOffset, input_.constantU, 1.f, p.us, numberOfRecords);
+                input_.gather(records, input_.vOffset, input_.constantV, 1.f, p.vs, numberOfRecords);
+                input_.gather(records, input_.weightOffset, input_.constantWeight, 1.f, p.weights, numberOfRecords);
+                LATCHes_.resize(LATCHOffset_ != IAEARecordLayout::NOT_STORED ? numberOfRecords : 0);
+                if (!LATCHes_.empty()) records.peekColumn(std::span<std::uint32_t>(LATCHes_), LATCHOffset_, recordLength);
+                incrementalHistories_.resize(incrementalHistoryOffset_ != IAEARecordLayout::NOT_STORED ? numberOfRecords : 0);
+                if (!incrementalHistories_.empty()) records.peekColumn(std::span<std::int32_t>(incrementalHistories_), incrementalHistoryOffset_, recordLength);
+                ZLASTs_.resize(ZLASTOffset_ != IAEARecordLayout::NOT_STORED ? numberOfRecords : 0);
+                if (!ZLASTs_.empty()) records.peekColumn(std::span<float>(ZLASTs_), ZLASTOffset_, recordLength);
+
+                // w from u and v with the sign of the type code, or the constant w, as IAEAphspFile::Reader decodes it
+                if (input_.wIsStored) {
+                    CalcThirdUnitComponents(p.us, p.vs, p.ws, numberOfRecords);
+                    for (std::size_t i = 0; i < numberOfRecords; i++) p.ws[i] = typeCodes_[i] < 0 ? -p.ws[i] : p.ws[i];
+                } else {
+                    for (std::size_t i = 0; i < numberOfRecords; i++) p.ws[i] = input_.constantW;
+                }
+                NormalizeDirectionalCosines(p.us, p.vs, p.ws, numberOfRecords);
+
+                // Stop at types EGS cannot store and at invalid records, which the per-particle path reports
+                std::size_t count = 0;
+                for (; count < numberOfRecords; count++) {
+                    const signed_byte typeCode = typeCodes_[count] < 0 ? -typeCodes_[count] : typeCodes_[count];
+                    if (typeCode == 1) p.types[count] = ParticleType::Photon;
+                    else if (typeCode == 2) p.types[count] = ParticleType::Electron;
+                    else if (typeCode == 3) p.types[count] = ParticleType::Positron;
+                    else break;
+                    if (p.weights[count] < 0) break;
+
+                    bool newHistory = p.energies[count] < 0;
+                    p.energies[count] = (newHistory ? -p.energies[count] : p.energies[count]) * MeV;
+                    std::uint32_t incrementalHistories = 1;
+                    if (!incrementalHistories_.empty()) {
+                        // A positive incremental history number also marks a new history
+                        const std::int32_t value = incrementalHistories_[count];
+                        if (value > 0) newHistory = true;
+                        incrementalHistories = static_cast<std::uint32_t>(value);
+                    }
+                    p.isNewHistory[count] = newHistory ? 1 : 0;
+                    p.incrementalHistories[count] = newHistory ? incrementalHistories : 0;
+                }
+
+                // Encode the particles as EGSphspFile::Writer::writeBinaryParticle() does
+                constexpr float inv_cm = 1.0f / cm;
+                constexpr float inv_MeV = 1.0f / MeV;
+                for (std::size_t i = 0; i < count; i++) {
+                    float energy = p.energies[i] * inv_MeV;
+                    if (p.types[i] != ParticleType::Photon) energy += EGSphspFile::ELECTRON_REST_MASS_MEV; // Convert to total energy
+                    if (p.isNewHistory[i]) energy *= -1;
+                    const float weight = p.ws[i] < 0 ? -p.weights[i] : p.weights[i];
+
+                    output.write<unsigned int>(LATCHes_.empty() ? ConstructLATCH(p.types[i], latchOption_) : LATCHes_[i]);
+                    output.write<float>(energy);
+                    output.write<float>(p.xs[i] * inv_cm);
+                    output.write<float>(p.ys[i] * inv_cm);
+                    output.write<float>(p.us[i]);
+                    output.write<float>(p.vs[i]);
+                    output.write<float>(weight);
+                    if (!ZLASTs_.empty()) output.write<float>(ZLASTs_[i] * inv_cm);
+                }
+
+                particles.resize(count);
+                return count;
+            }
+
+        private:
+            const IAEARecordLayout input_;
+            const std::size_t LATCHOffset_;
+            const std::size_t incrementalHistoryOffset_;
+            const std::size_t ZLASTOffset_;
+            const EGSphspFile::EGSLATCHOPTION latchOption_;
+            std::vector<signed_byte> typeCodes_;
+            std::vector<std::uint32_t> LATCHes_;
+            std::vector<std::int32_t> incrementalHistories_;
+            std::vector<float> ZLASTs_;
+        };
+
+        // The byte offsets of the columns of a TOPAS binary record with the standard columns only
+        constexpr std::size_t TOPAS_STANDARD_COLUMNS = 10;
+        constexpr std::size_t TOPAS_TYPE_OFFSET = 28;
+        constexpr std::size_t TOPAS_W_IS_NEGATIVE_OFFSET = 32;
+        constexpr std::size_t TOPAS_NEW_HISTORY_OFFSET = 33;
+
+        /*
+         * IAEA records to TOPAS binary records. The type code becomes a PDG code and the sign of w
+         * moves into its own flag. Records carrying more than one history are left to the writer,
+         * which accounts for the empty histories with a pseudo-particle.
+         */
+        class IAEAToTOPASTranscoder : public RecordTranscoder
+        {
+        public:
+            explicit IAEAToTOPASTranscoder(const IAEARecordLayout & input)
+            : input_(input), incrementalHistoryOffset_(input.extraLongOffset(IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::INCREMENTAL_HISTORY_NUMBER)) {}
+
+            std::size_t transcodeRecords(ByteBuffer & records, std::size_t recordLength, std::size_t numberOfRecords, ByteBuffer & output, ParticleBlock & particles) override
+            {
+                ParticleColumns p = ResizeColumns(particles, numberOfRecords);
+                typeCodes_.resize(numberOfRecords);
+                records.peekColumn(std::span<signed_byte>(typeCodes_), 0, recordLength);
+                records.peekColumn(std::span<float>(p.energies, numberOfRecords), 1, recordLength);
+                input_.gather(records, input_.xOffset, input_.constantX, cm, p.xs, numberOfRecords);
+                input_.gather(records, input_.yOffset, input_.constantY, cm, p.ys, numberOfRecords);
+                input_.gather(records, input_.zOffset, input_.constantZ, cm, p.zs, numberOfRecords);
+                input_.gather(records, input_.uOffset, input_.constantU, 1.f, p.us, numberOfRecords);
+                input_.gather(records, input_.vOffset, input_.constantV, 1.f, p.vs, numberOfRecords);
+                input_.gather(records, input_.weightOffset, input_.constantWeight, 1.f, p.weights, numberOfRecords);
+                incrementalHistories_.resize(incrementalHistoryOffset_ != IAEARecordLayout::NOT_STORED ? numberOfRecords : 0);
+                if (!incrementalHistories_.empty()) records.peekColumn(std::span<std::int32_t>(incrementalHistories_), incrementalHistoryOffset_, recordLength);
+
+                if (input_.wIsStored) {
+                    CalcThirdUnitComponents(p.us, p.vs, p.ws, numberOfRecords);
+                    for (std::size_t i = 0; i < numberOfRecords; i++) p.ws[i] = typeCodes_[i] < 0 ? -p.ws[i] : p.ws[i];
+                } else {
+                    for (std::size_t i = 0; i < numberOfRecords; i++) p.ws[i] = input_.constantW;
+                }
+                NormalizeDirectionalCosines(p.us, p.vs, p.ws, numberOfRecords);
+
+                // Stop at invalid records and at those the writer splits into a pseudo-particle and a particle
+                std::size_t count = 0;
+                for (; count < numberOfRecords; count++) {
+                    const signed_byte typeCode = typeCodes_[count] < 0 ? -typeCodes_[count] : typeCodes_[count];
+                    if (typeCode < 1 || typeCode > 5) break;
+                    if (p.weights[count] < 0) break;
+                    constexpr ParticleType IAEATypes[] = { ParticleType::Photon, ParticleType::Electron, ParticleType::Positron, ParticleType::Neutron, ParticleType::Proton };
+                    p.types[count] = IAEATypes[typeCode - 1];
+
+                    bool newHistory = p.energies[count] < 0;
+                    p.energies[count] = (newHistory ? -p.energies[count] : p.energies[count]) * MeV;
+                    std::uint32_t incrementalHistories = 1;
+                    if (!incrementalHistories_.empty()) {
+                        const std::int32_t value = incrementalHistories_[count];
+                        if (value < 0 || value > 1) break;
+                        if (value > 0) newHistory = true;
+                        incrementalHistories = static_cast<std::uint32_t>(value);
+                    }
+                    p.isNewHistory[count] = newHistory ? 1 : 0;
+                    p.incrementalHistories[count] = newHistory ? incrementalHistories : 0;
+                }
+
+                // Encode the particles as TOPASphspFile::Writer::writeBinaryStandardParticle() does
+                for (std::size_t i = 0; i < count; i++) {
+                    output.write(p.xs[i] / cm);
+                    output.write(p.ys[i] / cm);
+                    output.write(p.zs[i] / cm);
+                    output.write(p.us[i]);
+                    output.write(p.vs[i]);
+                    output.write(p.energies[i] / MeV);
+                    output.write(p.weights[i]);
+                    output.write(getPDGIDFromParticleType(p.types[i]));
+                    output.write(p.ws[i] < 0 ? true : false);
+                    output.write(p.isNewHistory[i] != 0);
+                }
+
+                particles.resize(count);
+                return count;
+            }
+
+        private:
+            const IAEARecordLayout input_;
+            const std::size_t incrementalHistoryOffset_;
+            std::vector<signed_byte> typeCodes_;
+            std::vector<std::int32_t> incrementalHistories_;
+        };
+
+        /*
+         * TOPAS binary records to IAEA records. The PDG code becomes a type code and the w sign flag
+         * the sign of the type code. Pseudo-particles are left to the reader, which folds the empty
+         * histories they stand for into the next particle.
+         */
+        class TOPASToIAEATranscoder : public RecordTranscoder
+        {
+        public:
+            TOPASToIAEATranscoder(const IAEARecordLayout & output, EGSphspFile::EGSLATCHOPTION latchOption)
+            : output_(output), latchOption_(latchOption) {}
+
+            std::size_t transcodeRecords(ByteBuffer & records, std::size_t recordLength, std::size_t numberOfRecords, ByteBuffer & output, ParticleBlock & particles) override
+            {
+                ParticleColumns p = ResizeColumns(particles, numberOfRecords);
+                PDGCodes_.resize(numberOfRecords);
+                wIsNegative_.resize(numberOfRecords);
+                newHistory_.resize(numberOfRecords);
+                records.peekColumn(std::span<float>(p.xs, numberOfRecords), 0, recordLength);
+                records.peekColumn(std::span<float>(p.ys, numberOfRecords), 4, recordLength);
+                records.peekColumn(std::span<float>(p.zs, numberOfRecords), 8, recordLength);
+                records.peekColumn(std::span<float>(p.us, numberOfRecords), 12, recordLength);
+                records.peekColumn(std::span<float>(p.vs, numberOfRecords), 16, recordLength);
+                records.peekColumn(std::span<float>(p.energies, numberOfRecords), 20, recordLength);
+                records.peekColumn(std::span<float>(p.weights, numberOfRecords), 24, recordLength);
+                records.peekColumn(std::span<std::int32_t>(PDGCodes_), TOPAS_TYPE_OFFSET, recordLength);
+                records.peekColumn(std::span<std::uint8_t>(wIsNegative_), TOPAS_W_IS_NEGATIVE_OFFSET, recordLength);
+                records.peekColumn(std::span<std::uint8_t>(newHistory_), TOPAS_NEW_HISTORY_OFFSET, recordLength);
+
+                // The same passes as TOPASphspFile::Reader::readBinaryStandardParticle()
+                CalcThirdUnitComponents(p.us, p.vs, p.ws, numberOfRecords);
+                for (std::size_t i = 0; i < numberOfRecords; i++) {
+                    p.xs[i] *= cm;
+                    p.ys[i] *= cm;
+                    p.zs[i] *= cm;
+                    p.energies[i] *= MeV;
+                    p.ws[i] = wIsNegative_[i] ? -p.ws[i] : p.ws[i];
+                    p.isNewHistory[i] = newHistory_[i] ? 1 : 0;
+                    p.incrementalHistories[i] = newHistory_[i] ? 1 : 0;
+                }
+                NormalizeDirectionalCosines(p.us, p.vs, p.ws, numberOfRecords);
+
+                // Stop at pseudo-particles and at types IAEA cannot store
+                LATCHes_.resize(numberOfRecords);
+                std::size_t count = 0;
+                for (; count < numberOfRecords; count++) {
+                    const ParticleType type = PDGCodes_[count] == 0 ? ParticleType::PseudoParticle : getParticleTypeFromPDGID(PDGCodes_[count]);
+                    if (type != ParticleType::Photon && type != ParticleType::Electron && type != ParticleType::Positron
+                        && type != ParticleType::Neutron && type != ParticleType::Proton) break;
+                    p.types[count] = type;
+                    LATCHes_[count] = ConstructLATCH(type, latchOption_);
+                }
+
+                WriteIAEARecords(output, output_, p, count, LATCHes_, {});
+                particles.resize(count);
+                return count;
+            }
+
+        private:
+            const IAEARecordLayout output_;
+            const EGSphspFile::EGSLATCHOPTION latchOption_;
+            std::vector<std::int32_t> PDGCodes_;
+            std::vector<std::uint8_t> wIsNegative_;
+            std::vector<std::uint8_t> newHistory_;
+            std::vector<std::uint32_t> LATCHes_;
+        };
+
+        // True if the writer keeps no constant values the transcoders leave to writeParticle(), which
+        // only applies to writers that cannot store them (their values are then simply written)
+        bool WritesAllValues(const PhaseSpaceFileWriter & writer)
+        {
+            const FixedValues fixedValues = writer.getFixedValues();
+            return !fixedValues.xIsConstant && !fixedValues.yIsConstant && !fixedValues.zIsConstant
+                && !fixedValues.pxIsConstant && !fixedValues.pyIsConstant && !fixedValues.pzIsConstant && !fixedValues.weightIsConstant;
+        }
+
+        // True if an IAEA layout can be written by the transcoders, whose particles carry no ILB values
+        bool TranscodersCanWrite(const IAEARecordLayout & layout)
+        {
+            return layout.matchesHeader && !layout.hasPenelopeILBs();
+        }
+
+        // True if a TOPAS file holds the standard binary columns only, any other column being a custom property
+        bool HasStandardColumnsOnly(const TOPASphspFile::Header & header)
+        {
+            return header.getTOPASFormat() == TOPASphspFile::TOPASFormat::BINARY && header.getColumnTypes().size() == TOPAS_STANDARD_COLUMNS;
+        }
+
+    } // namespace
+
+
+    void TranscoderRegistry::RegisterStandardTranscoders()
+    {
+        static bool standardTranscodersRegistered = false;
+        if (standardTranscodersRegistered) return;
+        standardTranscodersRegistered = true;
+
+        // Register EGS to IAEA
+        RegisterTranscoder("EGS", "IAEA",
+                           [](const PhaseSpaceFileReader & reader, PhaseSpaceFileWriter & writer) -> std::unique_ptr<RecordTranscoder> {
+                               const auto * egsReader = dynamic_cast<const EGSphspFile::Reader *>(&reader);
+                               auto * iaeaWriter = dynamic_cast<IAEAphspFile::Writer *>(&writer);
+                               if (!egsReader || !iaeaWriter) return nullptr;
+                               const IAEARecordLayout layout(iaeaWriter->getHeader());
+                               if (!TranscodersCanWrite(layout)) return nullptr;
+                               return std::make_unique<EGSToIAEATranscoder>(*egsReader, layout);
+                           });
+
+        // Register IAEA to EGS
+        RegisterTranscoder("IAEA", "EGS",
+                           [](const PhaseSpaceFileReader & reader, PhaseSpaceFileWriter & writer) -> std::unique_ptr<RecordTranscoder> {
+                               const auto * iaeaReader = dynamic_cast<const IAEAphspFile::Reader *>(&reader);
+                               auto * egsWriter = dynamic_cast<EGSphspFile::Writer *>(&writer);
+                               if (!iaeaReader || !egsWriter || !WritesAllValues(writer)) return nullptr;
+                               const IAEARecordLayout layout(iaeaReader->getHeader());
+                               if (!layout.matchesHeader) return nullptr;
+                               // Without a LATCH of its own the LATCH is made from the particle, whose ILB values would count
+                               if (layout.hasPenelopeILBs() && layout.extraLongOffset(IAEAphspFile::IAEAHeader::EXTRA_LONG_TYPE::EGS_LATCH) == IAEARecordLayout::NOT_STORED) return nullptr;
+                               // MODE2 files need a ZLAST for every particle, the writer reports its absence
+                               if (egsWriter->getMode() == EGSphspFile::EGSMODE::MODE2 && layout.extraFloatOffset(IAEAphspFile::IAEAHeader::EXTRA_FLOAT_TYPE::ZLAST) == IAEARecordLayout::NOT_STORED) return nullptr;
+                               return std::make_unique<IAEAToEGSTranscoder>(layout, *egsWriter);
+                           });
+
+        // Register IAEA to TOPAS binary
+        RegisterTranscoder("IAEA", "TOPAS BINARY",
+                           [](const PhaseSpaceFileReader & reader, PhaseSpaceFileWriter & writer) -> std::unique_ptr<RecordTranscoder> {
+                               const auto * iaeaReader = dynamic_cast<const IAEAphspFile::Reader *>(&reader);
+                               auto * topasWriter = dynamic_cast<TOPASphspFile::Writer *>(&writer);
+                               if (!iaeaReader || !topasWriter || !WritesAllValues(writer) || !HasStandardColumnsOnly(topasWriter->getHeader())) return nullptr;
+                               const IAEARecordLayout layout(iaeaReader->getHeader());
+                               if (!layout.matchesHeader) return nullptr;
+                               return std::make_unique<IAEAToTOPASTranscoder>(layout);
+                           });
+
+        // Register TOPAS binary to IAEA
+        RegisterTranscoder("TOPAS BINARY", "IAEA",
+                           [](const PhaseSpaceFileReader & reader, PhaseSpaceFileWriter & writer) -> std::unique_ptr<RecordTranscoder> {
+                               const auto * topasReader = dynamic_cast<const TOPASphspFile::Reader *>(&reader);
+                               auto * iaeaWriter = dynamic_cast<IAEAphspFile::Writer *>(&writer);
+                               if (!topasReader || !iaeaWriter || !HasStandardColumnsOnly(topasReader->getHeader())) return nullptr;
+                               const IAEARecordLayout layout(iaeaWriter->getHeader());
+                               if (!TranscodersCanWrite(layout)) return nullptr;
+                               return std::make_unique<TOPASToIAEATranscoder>(layout, iaeaWriter->getLATCHOption());
+                           });
+    }
+
+
+    TranscoderRegistry& TranscoderRegistry::instance()
+    {
+        static TranscoderRegistry inst;
+        TranscoderRegistry::RegisterStandardTranscoders();
+        return inst;
+    }
+
+    void TranscoderRegistry::RegisterTranscoder(const std::string& inputFormat, const std::string& outputFormat, TranscoderFactoryFn factory)
+    {
+        TranscoderRegistry& registry = instance();
+        std::unique_lock lock(registry.mutex_);
+        // Validate the transcoder registration
+        if (inputFormat.empty() || outputFormat.empty() || factory == nullptr) {
+            throw std::invalid_argument("Invalid transcoder registration");
+        }
+
+        // Check if a transcoder is already registered for the pair
+        auto key = std::make_pair(inputFormat, outputFormat);
+        if (registry.factories_.find(key) != registry.factories_.end()) {
+            throw std::runtime_error("Transcoder already registered: " + inputFormat + " to " + outputFormat);
+        }
+
+        registry.factories_[key] = std::move(factory);
+    }
+
+    bool TranscoderRegistry::HasTranscoder(const std::string& inputFormat, const std::string& outputFormat)
+    {
+        TranscoderRegistry& registry = instance();
+        std::unique_lock lock(registry.mutex_);
+        return registry.factories_.find(std::make_pair(inputFormat, outputFormat)) != registry.factories_.end();
+    }
+
+    std::unique_ptr<RecordTranscoder> TranscoderRegistry::CreateTranscoder(const PhaseSpaceFileReader& reader, PhaseSpaceFileWriter& writer)
+    {
+        TranscoderFactoryFn factory;
+        {
+            TranscoderRegistry& registry = instance();
+            std::unique_lock lock(registry.mutex_);
+            auto it = registry.factories_.find(std::make_pair(reader.getPHSPFormat(), writer.getPHSPFormat()));
+            if (it == registry.factories_.end()) {
+                return nullptr;
+            }
+            factory = it->second;
+        }
+        return factory(reader, writer);
+    }
+
+} // namespace ParticleZoo